@@ -6,7 +6,6 @@
 in highp vec3 Normal;
 in highp vec3 BarycentricCoordinates;
 in highp vec3 ModelCoordinates;
-in vec4 Color;
 
 flat in uint ColorIndex;
 flat in int AreaHighlightMask;
@@ -19,7 +18,6 @@ uniform vec3 uAreaHighlightOrigin;
 uniform float uAreaHighlightSize;
 uniform bool uShowWireframe;
 uniform bool uAreaHighlightEnabled;
-uniform bool uOverridePalette;
 uniform float uGridOffset;
 uniform vec2 uPreviewMinMaxHeight;
 uniform mat4 ciModelMatrix;
@@ -85,11 +83,11 @@ void main() {
     float lightIntensity = lambert + ambient;
 
     float areaHighlightAlpha = getAreaHighlightAlpha();
-    vec3 materialColor = uOverridePalette ? Color.rgb : uColorPalette[ColorIndex].rgb;
+    vec3 materialColor = uColorPalette[ColorIndex].rgb;
     materialColor = mix(materialColor, uAreaHighlightColor, areaHighlightAlpha);
     vec3 wireframeColor = uShowWireframe ? getWireframeColor(materialColor) : materialColor;
     vec3 triangleColor = wireframe(materialColor, wireframeColor, 1.0);
 
-    oColor = vec4(vec3(lightIntensity * triangleColor), uOverridePalette ? Color.a : 1.0);
+    oColor = vec4(vec3(lightIntensity * triangleColor), 1.0);
 
 }
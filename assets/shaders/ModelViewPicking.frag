@@ -0,0 +1,9 @@
+#version 150
+
+// Face number + 1 of the draw call, 0 is left where no face is rendered
+out uint oFaceId;
+
+
+void main() {
+    oFaceId = uint(gl_PrimitiveID) + 1u;
+}
@@ -463,7 +463,13 @@ void PeprImGui::render() {
     if(mFramebuffer != nullptr) {
         mFramebuffer->bindFramebuffer();
     }
+    if(mRenderObserver) {
+        mRenderObserver(true);
+    }
     mRenderer->render(ImGui::GetDrawData());
+    if(mRenderObserver) {
+        mRenderObserver(false);
+    }
     if(mFramebuffer != nullptr) {
         mFramebuffer->unbindFramebuffer();
         ci::gl::draw(mFramebuffer->getTexture2d(GL_COLOR_ATTACHMENT0));
@@ -34,6 +34,7 @@
 
 #pragma once
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <vector>
@@ -156,6 +157,7 @@ class PeprImGui {
     ci::Timer mTimer;
     std::string mIniFilename;
     ci::gl::FboRef mFramebuffer;
+    std::function<void(bool)> mRenderObserver;
 
    public:
     void setup(cinder::app::AppBase* application, WindowRef window);
@@ -168,6 +170,12 @@ class PeprImGui {
         mFramebuffer = framebuffer;
     }
 
+    //! called right before (started == true) and after (started == false) the draw data is rendered, e.g., to
+    //! measure the rendering
+    void setRenderObserver(std::function<void(bool started)> observer) {
+        mRenderObserver = std::move(observer);
+    }
+
    private:
     void mouseDown(ci::app::MouseEvent& event);
     void mouseMove(ci::app::MouseEvent& event);
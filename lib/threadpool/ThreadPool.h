@@ -2,69 +2,371 @@
 #define THREAD_POOL_H
 
 #include <vector>
-#include <queue>
+#include <deque>
 #include <memory>
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 #include <future>
 #include <functional>
 #include <stdexcept>
+#include <exception>
+#include <iterator>
+#include <algorithm>
+#include <chrono>
 
+// Work-stealing thread pool.
+// Every worker owns a deque of tasks. Tasks submitted from a worker go to its own deque and are
+// executed LIFO by the owner, idle workers steal the oldest tasks from the other deques.
+// Tasks submitted from other threads go to a shared injection queue.
+// Threads waiting for a task of the pool (parallel_for, wait) execute pending tasks of at least their own
+// priority meanwhile, so nested submission does not deadlock even with a single worker.
+// Every task has a priority, a thread looking for work takes the most urgent pending task. Tasks are never
+// interrupted, a more urgent task starts once a thread finishes its current task (or chunk of a parallel loop).
 class ThreadPool {
 public:
+    // Priority lanes of the tasks, the most urgent first
+    enum class priority {
+        interactive,  // work the user waits for right now, e.g., painting
+        normal,
+        background,   // long jobs, e.g., saving or precomputation, limited by set_background_limit
+    };
+    static constexpr size_t priority_count = 3;
+
     ThreadPool(size_t);
+    // Enqueues with the priority of the calling thread, see current_priority
     template<class F, class... Args>
     auto enqueue(F&& f, Args&&... args)
         ->std::future<typename std::result_of<F(Args...)>::type>;
+    template<class F, class... Args>
+    auto enqueue(priority p, F&& f, Args&&... args)
+        ->std::future<typename std::result_of<F(Args...)>::type>;
     ~ThreadPool();
 
+    // Priority of the tasks submitted by the calling thread, including the chunks of its parallel loops.
+    // Inside a task it is the priority of the task, so nested work inherits it. Other threads use normal priority,
+    // unless changed by set_thread_priority or priority_scope.
+    static priority current_priority() { return context().current; }
+
+    // Change the priority of the tasks submitted by the calling thread from outside of any task, e.g., by the UI
+    static void set_thread_priority(priority p) { context().current = p; }
+
+    // Submits the tasks of the calling thread with another priority while it exists
+    class priority_scope {
+    public:
+        explicit priority_scope(priority p) : previous(context().current) { context().current = p; }
+        ~priority_scope() { context().current = previous; }
+        priority_scope(const priority_scope&) = delete;
+        priority_scope& operator=(const priority_scope&) = delete;
+    private:
+        priority previous;
+    };
+
+    // Number of threads that may run background tasks at once, at least 1. A thread already running a background
+    // task may also run the background tasks it waits for. Defaults to all workers.
+    void set_background_limit(size_t limit);
+    size_t get_background_limit() const { return background_limit.load(); }
+
+    // Calls f(*it) for each element of [begin, end), in chunks of `grain` elements.
+    // Grain of 0 picks a chunk size giving each thread a few chunks to balance the load.
+    // The calling thread takes part in the work. The first exception thrown by f is rethrown.
     template<class It, class Func>
-    void parallel_for(It begin, It end, Func f);
+    void parallel_for(It begin, It end, Func f, size_t grain = 0);
+
+    // Same as parallel_for, but balances the load using cost(*it), an estimate of the work for each element.
+    // The most expensive elements are started first and cheap elements are grouped into chunks of similar cost,
+    // so that a single expensive element started last does not delay the whole loop.
+    template<class It, class Func, class Cost>
+    void parallel_for_weighted(It begin, It end, Func f, Cost cost);
+
+    // Waits for a future of a task of this pool, executing other pending tasks of at least the priority of the
+    // calling thread meanwhile.
+    template<class T>
+    T wait(std::future<T>& future);
+
+    // Executes a single pending task in the calling thread, returns false if there was none.
+    bool run_pending_task();
+
+    size_t size() const { return workers.size(); }
+
+    // Called by the executing thread right before (started == true) and after (started == false) each task of
+    // any pool, e.g., to trace the activity of the threads. Tasks may nest while a thread waits for other tasks.
+    // Null by default, which costs a single atomic load per task.
+    using task_observer = void (*)(bool started);
+    static void set_task_observer(task_observer observer)
+    {
+        observer_slot().store(observer);
+    }
 private:
+    struct Task {
+        std::function<void()> function;
+        priority p;
+    };
+
+    struct TaskQueue {
+        // one deque per priority
+        std::deque<Task> tasks[priority_count];
+        std::mutex mutex;
+    };
+
+    struct WorkerContext {
+        ThreadPool* pool = nullptr;
+        size_t index = 0;
+        // priority of the running task, or of the thread outside of tasks
+        priority current = priority::normal;
+        // nesting of the background tasks running in this thread
+        size_t background_depth = 0;
+    };
+
+    static WorkerContext& context()
+    {
+        static thread_local WorkerContext ctx;
+        return ctx;
+    }
+
+    static std::atomic<task_observer>& observer_slot()
+    {
+        static std::atomic<task_observer> observer(nullptr);
+        return observer;
+    }
+
+    void submit(std::function<void()> task, priority p);
+    bool pop_local(size_t index, size_t lane, Task& task);
+    bool pop_global(size_t lane, Task& task);
+    bool steal(size_t thief, size_t lane, Task& task);
+    // Executes a pending task more urgent than lane_end, returns false if there was none
+    bool run_pending_task_before(size_t lane_end);
+    // Lanes a waiting thread helps with: those at least as urgent as its own priority, or all of them if no other
+    // thread of the pool could run the less urgent tasks it may be waiting for
+    size_t waiting_lane_end() const;
+    void run_task(Task& task);
+    // Reserves a background thread for the calling thread, false if the limit is reached
+    bool acquire_background();
+    void release_background();
+    // Is there a pending task that a sleeping worker may start?
+    bool has_startable_task() const;
+    void worker_loop(size_t index);
+
     // need to keep track of threads so we can join them
     std::vector< std::thread > workers;
-    // the task queue
-    std::queue< std::function<void()> > tasks;
+    // one deque per worker
+    std::vector< std::unique_ptr<TaskQueue> > queues;
+    // tasks submitted from outside of the pool
+    TaskQueue global;
 
-    // synchronization
-    std::mutex queue_mutex;
+    // number of tasks waiting in any of the queues per priority, may be briefly negative while a task is being pushed
+    std::atomic<long> pending[priority_count];
+
+    // threads running a background task and their limit
+    std::atomic<size_t> background_running;
+    std::atomic<size_t> background_limit;
+
+    // synchronization of sleeping workers
+    std::mutex sleep_mutex;
     std::condition_variable condition;
     bool stop;
 };
 
 // the constructor just launches some amount of workers
 inline ThreadPool::ThreadPool(size_t threads)
-    : stop(false)
+    : background_running(0), background_limit(std::max<size_t>(1, threads)), stop(false)
 {
+    for (std::atomic<long>& lanePending : pending)
+        lanePending = 0;
+    for (size_t i = 0; i < threads; ++i)
+        queues.emplace_back(std::make_unique<TaskQueue>());
     for (size_t i = 0; i < threads; ++i)
-        workers.emplace_back(
-            [this]
+        workers.emplace_back([this, i] { worker_loop(i); });
+}
+
+inline void ThreadPool::worker_loop(size_t index)
+{
+    context().pool = this;
+    context().index = index;
+
+    for (;;)
     {
-        for (;;)
-        {
-            std::function<void()> task;
+        if (run_pending_task())
+            continue;
 
-            {
-                std::unique_lock<std::mutex> lock(this->queue_mutex);
-                this->condition.wait(lock,
-                    [this] { return this->stop || !this->tasks.empty(); });
-                if (this->stop && this->tasks.empty())
-                    return;
-                task = std::move(this->tasks.front());
-                this->tasks.pop();
-            }
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        condition.wait(lock, [this] { return stop || has_startable_task(); });
+        if (stop && !has_startable_task())
+            return;
+    }
+}
+
+inline bool ThreadPool::has_startable_task() const
+{
+    const size_t background = static_cast<size_t>(priority::background);
+    for (size_t lane = 0; lane < background; ++lane)
+        if (pending[lane].load() > 0)
+            return true;
+    return pending[background].load() > 0 && background_running.load() < background_limit.load();
+}
+
+inline void ThreadPool::set_background_limit(size_t limit)
+{
+    {
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        background_limit = std::max<size_t>(1, limit);
+    }
+    condition.notify_all();
+}
+
+inline void ThreadPool::submit(std::function<void()> task, priority p)
+{
+    WorkerContext& ctx = context();
+    TaskQueue& queue = ctx.pool == this ? *queues[ctx.index] : global;
+    const size_t lane = static_cast<size_t>(p);
+    {
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        queue.tasks[lane].push_back(Task{std::move(task), p});
+    }
+    {
+        // increment under the sleep mutex, so that no worker misses the notification
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        ++pending[lane];
+    }
+    condition.notify_one();
+}
+
+inline bool ThreadPool::pop_local(size_t index, size_t lane, Task& task)
+{
+    TaskQueue& queue = *queues[index];
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    if (queue.tasks[lane].empty())
+        return false;
+    // newest first, its data is most likely still in the cache
+    task = std::move(queue.tasks[lane].back());
+    queue.tasks[lane].pop_back();
+    return true;
+}
+
+inline bool ThreadPool::pop_global(size_t lane, Task& task)
+{
+    std::unique_lock<std::mutex> lock(global.mutex);
+    if (global.tasks[lane].empty())
+        return false;
+    task = std::move(global.tasks[lane].front());
+    global.tasks[lane].pop_front();
+    return true;
+}
+
+inline bool ThreadPool::steal(size_t thief, size_t lane, Task& task)
+{
+    for (size_t offset = 1; offset <= queues.size(); ++offset)
+    {
+        TaskQueue& victim = *queues[(thief + offset) % queues.size()];
+        std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+        if (!lock.owns_lock() || victim.tasks[lane].empty())
+            continue;
+        // oldest first, it is usually the largest piece of work
+        task = std::move(victim.tasks[lane].front());
+        victim.tasks[lane].pop_front();
+        return true;
+    }
+    return false;
+}
+
+inline bool ThreadPool::acquire_background()
+{
+    if (context().background_depth > 0)
+        return true;
+    size_t running = background_running.load();
+    while (running < background_limit.load())
+    {
+        if (background_running.compare_exchange_weak(running, running + 1))
+            return true;
+    }
+    return false;
+}
+
+inline void ThreadPool::release_background()
+{
+    {
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        --background_running;
+    }
+    // a sleeping worker may start the next background task now
+    condition.notify_one();
+}
 
-            task();
+inline bool ThreadPool::run_pending_task()
+{
+    return run_pending_task_before(priority_count);
+}
+
+inline bool ThreadPool::run_pending_task_before(size_t lane_end)
+{
+    WorkerContext& ctx = context();
+    const bool isWorker = ctx.pool == this;
+    const size_t index = isWorker ? ctx.index : 0;
+    const size_t background = static_cast<size_t>(priority::background);
+
+    for (size_t lane = 0; lane < lane_end; ++lane)
+    {
+        if (pending[lane].load() <= 0)
+            continue;
+        const bool isReserved = lane == background && ctx.background_depth == 0;
+        if (lane == background && !acquire_background())
+            continue;
+
+        Task task;
+        if ((isWorker && pop_local(index, lane, task)) || pop_global(lane, task) || steal(index, lane, task))
+        {
+            --pending[lane];
+            run_task(task);
+            if (isReserved)
+                release_background();
+            return true;
         }
+        if (isReserved)
+            release_background();
     }
-    );
+    return false;
+}
+
+inline size_t ThreadPool::waiting_lane_end() const
+{
+    const bool isWorker = context().pool == this;
+    if (workers.size() <= (isWorker ? 1u : 0u))
+        return priority_count;
+    return static_cast<size_t>(current_priority()) + 1;
+}
+
+inline void ThreadPool::run_task(Task& task)
+{
+    WorkerContext& ctx = context();
+    const priority previous = ctx.current;
+    ctx.current = task.p;
+    if (task.p == priority::background)
+        ++ctx.background_depth;
+
+    const task_observer observer = observer_slot().load(std::memory_order_relaxed);
+    if (observer)
+        observer(true);
+    task.function();
+    if (observer)
+        observer(false);
+
+    if (task.p == priority::background)
+        --ctx.background_depth;
+    ctx.current = previous;
 }
 
 // add new work item to the pool
 template<class F, class... Args>
 auto ThreadPool::enqueue(F&& f, Args&&... args)
 -> std::future<typename std::result_of<F(Args...)>::type>
+{
+    return enqueue(current_priority(), std::forward<F>(f), std::forward<Args>(args)...);
+}
+
+template<class F, class... Args>
+auto ThreadPool::enqueue(priority p, F&& f, Args&&... args)
+-> std::future<typename std::result_of<F(Args...)>::type>
 {
     using return_type = typename std::result_of<F(Args...)>::type;
 
@@ -73,24 +375,36 @@ auto ThreadPool::enqueue(F&& f, Args&&... args)
         );
 
     std::future<return_type> res = task->get_future();
-    {
-        std::unique_lock<std::mutex> lock(queue_mutex);
 
-        // don't allow enqueueing after stopping the pool
+    // don't allow enqueueing after stopping the pool
+    {
+        std::unique_lock<std::mutex> lock(sleep_mutex);
         if (stop)
             throw std::runtime_error("enqueue on stopped ThreadPool");
-
-        tasks.emplace([task]() { (*task)(); });
     }
-    condition.notify_one();
+
+    submit([task]() { (*task)(); }, p);
     return res;
 }
 
+template<class T>
+T ThreadPool::wait(std::future<T>& future)
+{
+    // a waiting painting stroke must not run a long background job inline
+    const size_t lane_end = waiting_lane_end();
+    while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+        if (!run_pending_task_before(lane_end))
+            std::this_thread::yield();
+    }
+    return future.get();
+}
+
 // the destructor joins all threads
 inline ThreadPool::~ThreadPool()
 {
     {
-        std::unique_lock<std::mutex> lock(queue_mutex);
+        std::unique_lock<std::mutex> lock(sleep_mutex);
         stop = true;
     }
     condition.notify_all();
@@ -99,15 +413,164 @@ inline ThreadPool::~ThreadPool()
 }
 
 template<class It, class Func>
-void ThreadPool::parallel_for(It begin, It end, Func f)
+void ThreadPool::parallel_for(It begin, It end, Func f, size_t grain)
 {
-    std::vector<std::future<void>> futures;
+    const size_t count = static_cast<size_t>(std::distance(begin, end));
+    if (count == 0)
+        return;
+
+    if (grain == 0)
+    {
+        const size_t targetChunks = 4 * (workers.size() + 1);
+        grain = std::max<size_t>(1, (count + targetChunks - 1) / targetChunks);
+    }
+    const size_t chunks = (count + grain - 1) / grain;
+
+    // nothing to split, avoid the scheduling overhead
+    if (chunks == 1 || workers.empty())
+    {
+        std::for_each(begin, end, f);
+        return;
+    }
+
+    // shared by the chunks, lives on this stack frame until all of them finish
+    std::atomic<size_t> remaining(chunks);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto runChunk = [&f, &remaining, &error, &error_mutex](It chunkBegin, It chunkEnd) {
+        try
+        {
+            for (It it = chunkBegin; it != chunkEnd; ++it)
+                f(*it);
+        }
+        catch (...)
+        {
+            std::unique_lock<std::mutex> lock(error_mutex);
+            if (!error)
+                error = std::current_exception();
+        }
+        remaining.fetch_sub(1, std::memory_order_release);
+    };
+
+    // the first chunk is run by the calling thread, the others are published to the pool
+    const priority p = current_priority();
+    It firstEnd = begin;
+    std::advance(firstEnd, grain);
+    It chunkBegin = firstEnd;
+    for (size_t chunk = 1; chunk < chunks; ++chunk)
+    {
+        It chunkEnd = chunkBegin;
+        std::advance(chunkEnd, std::min(grain, count - chunk * grain));
+        submit([runChunk, chunkBegin, chunkEnd]() { runChunk(chunkBegin, chunkEnd); }, p);
+        chunkBegin = chunkEnd;
+    }
+    runChunk(begin, firstEnd);
+
+    // help with the remaining chunks (or anything as urgent) instead of blocking the thread
+    const size_t lane_end = waiting_lane_end();
+    while (remaining.load(std::memory_order_acquire) > 0)
+    {
+        if (!run_pending_task_before(lane_end))
+            std::this_thread::yield();
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+}
+template<class It, class Func, class Cost>
+void ThreadPool::parallel_for_weighted(It begin, It end, Func f, Cost cost)
+{
+    struct Item {
+        It it;
+        size_t cost;
+    };
+
+    std::vector<Item> items;
+    size_t totalCost = 0;
     for (It it = begin; it != end; ++it)
     {
-        futures.emplace_back(enqueue(f, *it));
+        // every element costs at least something, even if the estimate says otherwise
+        const size_t itemCost = std::max<size_t>(1, static_cast<size_t>(cost(*it)));
+        items.push_back(Item{it, itemCost});
+        totalCost += itemCost;
+    }
+    if (items.empty())
+        return;
+
+    if (items.size() == 1)
+    {
+        f(*items.front().it);
+        return;
+    }
+
+    // longest processing time first
+    std::stable_sort(items.begin(), items.end(),
+                     [](const Item& a, const Item& b) { return a.cost > b.cost; });
+
+    // group the sorted elements into chunks of about the same cost, expensive elements stay alone
+    const size_t targetChunks = 4 * (workers.size() + 1);
+    const size_t targetCost = std::max<size_t>(1, totalCost / targetChunks);
+    std::vector<size_t> chunkEnds;
+    size_t chunkCost = 0;
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        chunkCost += items[i].cost;
+        if (chunkCost >= targetCost)
+        {
+            chunkEnds.push_back(i + 1);
+            chunkCost = 0;
+        }
+    }
+    if (chunkEnds.empty() || chunkEnds.back() != items.size())
+        chunkEnds.push_back(items.size());
+
+    // all participating threads take the next chunk in order, so the expensive ones start first
+    std::atomic<size_t> nextChunk(0);
+    std::atomic<size_t> activeRunners(0);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    const priority p = current_priority();
+    auto runChunks = [&]() {
+        for (;;)
+        {
+            // let more urgent tasks go first at the chunk boundaries
+            while (run_pending_task_before(static_cast<size_t>(p)))
+                ;
+            const size_t chunk = nextChunk.fetch_add(1);
+            if (chunk >= chunkEnds.size())
+                break;
+            const size_t chunkBegin = chunk == 0 ? 0 : chunkEnds[chunk - 1];
+            try
+            {
+                for (size_t i = chunkBegin; i < chunkEnds[chunk]; ++i)
+                    f(*items[i].it);
+            }
+            catch (...)
+            {
+                std::unique_lock<std::mutex> lock(error_mutex);
+                if (!error)
+                    error = std::current_exception();
+            }
+        }
+        activeRunners.fetch_sub(1, std::memory_order_release);
+    };
+
+    const size_t helpers = std::min(workers.size(), chunkEnds.size() - 1);
+    activeRunners = helpers + 1;
+    for (size_t i = 0; i < helpers; ++i)
+        submit(runChunks, p);
+    runChunks();
+
+    const size_t lane_end = waiting_lane_end();
+    while (activeRunners.load(std::memory_order_acquire) > 0)
+    {
+        if (!run_pending_task_before(lane_end))
+            std::this_thread::yield();
     }
 
-    // Wait for all
-    std::for_each(futures.begin(), futures.end(), [](auto& f) { f.get(); });
+    if (error)
+        std::rethrow_exception(error);
 }
 #endif
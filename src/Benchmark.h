@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "peprassert.h"
+
+namespace pepr3d {
+
+/// Harness of the pepr3d_bench executable, which measures the hot paths of the Geometry without a window or an OpenGL
+/// context. Suites are registered by Benchmark::Registration in the *.bench.cpp files and run in the order of their
+/// names. Each case runs once to warm up and then the given number of timed repetitions; the setup before each run
+/// is not timed. Inputs are generated from fixed seeds, so the results of two builds are comparable.
+class Benchmark {
+   public:
+    using Clock = std::chrono::steady_clock;
+    using Suite = void (*)(Benchmark& benchmark);
+
+    struct Result {
+        /// "Suite/case"
+        std::string name;
+        size_t repetitions = 0;
+        double minMs = 0.0;
+        double medianMs = 0.0;
+        double meanMs = 0.0;
+        double maxMs = 0.0;
+    };
+
+    /// Registers a suite at namespace scope of a *.bench.cpp file
+    struct Registration {
+        Registration(const char* name, Suite suite) {
+            getSuites().emplace_back(name, suite);
+        }
+    };
+
+    /// Only the cases whose "Suite/case" names start with the filter are run, all of them for an empty filter
+    explicit Benchmark(std::string filter) : mFilter(std::move(filter)) {}
+
+    /// Runs the selected cases of all registered suites
+    void runSuites() {
+        std::vector<std::pair<std::string, Suite>> suites = getSuites();
+        std::sort(suites.begin(), suites.end());
+        for(const auto& suite : suites) {
+            // Suites build their inputs before the cases, so the unselected ones are skipped whole
+            const std::string prefix = suite.first + "/";
+            if(prefix.compare(0, mFilter.size(), mFilter) != 0 && mFilter.compare(0, prefix.size(), prefix) != 0) {
+                continue;
+            }
+            mSuite = suite.first;
+            suite.second(*this);
+        }
+    }
+
+    /// Whether the case of the current suite is selected by the filter, e.g., to skip building its inputs
+    bool isSelected(const std::string& caseName) const {
+        const std::string name = mSuite + "/" + caseName;
+        return name.compare(0, mFilter.size(), mFilter) == 0;
+    }
+
+    /// Measures run() after setup(), repetitions times after a warm-up
+    template <typename Setup, typename Run>
+    void measure(const std::string& caseName, const size_t repetitions, const Setup& setup, const Run& run) {
+        P_ASSERT(repetitions > 0);
+        if(!isSelected(caseName)) {
+            return;
+        }
+
+        setup();
+        run();
+
+        std::vector<double> durations;
+        durations.reserve(repetitions);
+        for(size_t i = 0; i < repetitions; ++i) {
+            setup();
+            const Clock::time_point start = Clock::now();
+            run();
+            durations.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        }
+        std::sort(durations.begin(), durations.end());
+
+        Result result;
+        result.name = mSuite + "/" + caseName;
+        result.repetitions = repetitions;
+        result.minMs = durations.front();
+        result.medianMs = durations.size() % 2 == 1
+                              ? durations[durations.size() / 2]
+                              : 0.5 * (durations[durations.size() / 2 - 1] + durations[durations.size() / 2]);
+        result.meanMs = std::accumulate(durations.begin(), durations.end(), 0.0) / durations.size();
+        result.maxMs = durations.back();
+        std::fprintf(stderr, "%-48s %10.3f ms (min %.3f, max %.3f)\n", result.name.c_str(), result.medianMs,
+                     result.minMs, result.maxMs);
+        mResults.push_back(std::move(result));
+    }
+
+    template <typename Run>
+    void measure(const std::string& caseName, const size_t repetitions, const Run& run) {
+        measure(caseName, repetitions, []() {}, run);
+    }
+
+    const std::vector<Result>& getResults() const {
+        return mResults;
+    }
+
+    /// Writes the results as JSON, to be compared across releases
+    /// @param threadCount Number of threads of the pool, the results only compare with the same count
+    static void writeJson(std::ostream& os, const std::vector<Result>& results, const size_t threadCount) {
+        os << "{\"threads\":" << threadCount << ",\"benchmarks\":[";
+        for(size_t i = 0; i < results.size(); ++i) {
+            const Result& result = results[i];
+            os << (i > 0 ? "," : "") << "\n{\"name\":\"";
+            for(const char c : result.name) {
+                if(c == '"' || c == '\\') {
+                    os << '\\';
+                }
+                os << c;
+            }
+            os << "\",\"repetitions\":" << result.repetitions << ",\"min_ms\":" << result.minMs
+               << ",\"median_ms\":" << result.medianMs << ",\"mean_ms\":" << result.meanMs
+               << ",\"max_ms\":" << result.maxMs << "}";
+        }
+        os << "\n]}\n";
+    }
+
+   private:
+    static std::vector<std::pair<std::string, Suite>>& getSuites() {
+        static std::vector<std::pair<std::string, Suite>> suites;
+        return suites;
+    }
+
+    std::string mFilter;
+    std::string mSuite;
+    std::vector<Result> mResults;
+};
+
+}  // namespace pepr3d
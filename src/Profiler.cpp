@@ -0,0 +1,290 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+
+#include "ThreadPool.h"
+#include "peprassert.h"
+
+namespace pepr3d {
+
+namespace {
+struct History {
+    std::array<float, Profiler::HISTORY_SIZE> values{};
+
+    /// Position of the next value, which is the oldest value once the history is full
+    size_t next = 0;
+    size_t count = 0;
+};
+
+/// Histories of all zones followed by those of the counters, recorded from any thread
+struct Histories {
+    std::mutex mutex;
+    std::array<History, Profiler::ZONE_COUNT + Profiler::COUNTER_COUNT> zones;
+
+    /// Amounts of the counters in the current frame
+    std::array<size_t, Profiler::COUNTER_COUNT> frameCounts{};
+};
+
+Histories& getHistories() {
+    static Histories histories;
+    return histories;
+}
+
+const std::array<const char*, Profiler::ZONE_COUNT> ZONE_NAMES{
+    "Frame",     "Buffer generation", "Buffer upload", "Picking",          "Painting", "Mesh rebuild", "Tree rebuild",
+    "GPU model", "GPU tool preview",  "GPU grid",      "GPU tool overlay", "GPU ImGui"};
+
+const std::array<const char*, Profiler::COUNTER_COUNT> COUNTER_NAMES{"Uploaded bytes"};
+
+size_t getHistoryIndex(const Profiler::Counter counter) {
+    return Profiler::ZONE_COUNT + static_cast<size_t>(counter);
+}
+
+/// Adds the value to the history, histories.mutex has to be locked
+void addToHistory(History& history, const float value) {
+    history.values[history.next] = value;
+    history.next = (history.next + 1) % Profiler::HISTORY_SIZE;
+    history.count = std::min(history.count + 1, Profiler::HISTORY_SIZE);
+}
+
+std::vector<float> getHistoryValues(const size_t historyIdx) {
+    Histories& histories = getHistories();
+    const std::lock_guard<std::mutex> lock(histories.mutex);
+    const History& history = histories.zones[historyIdx];
+
+    // The oldest value is at the next position once the history is full, at the start before
+    std::vector<float> values;
+    values.reserve(history.count);
+    const size_t oldest = history.count == Profiler::HISTORY_SIZE ? history.next : 0;
+    for(size_t i = 0; i < history.count; ++i) {
+        values.push_back(history.values[(oldest + i) % Profiler::HISTORY_SIZE]);
+    }
+    return values;
+}
+
+Profiler::Statistics computeStatistics(std::vector<float> values) {
+    Profiler::Statistics statistics;
+    statistics.count = values.size();
+    if(values.empty()) {
+        return statistics;
+    }
+
+    // Nearest-rank percentiles
+    const auto percentile = [&values](const size_t percent) {
+        const size_t rank = (percent * values.size() + 99) / 100;
+        const auto nth = values.begin() + (std::max<size_t>(rank, 1) - 1);
+        std::nth_element(values.begin(), nth, values.end());
+        return *nth;
+    };
+    statistics.median = percentile(50);
+    statistics.percentile95 = percentile(95);
+    statistics.max = *std::max_element(values.begin(), values.end());
+    return statistics;
+}
+
+struct TraceEvent {
+    const char* category;
+    std::string name;
+    Profiler::Clock::time_point start;
+    Profiler::Clock::time_point end;
+    size_t threadId;
+};
+
+/// Events of the current or the last trace, recorded from any thread
+struct Trace {
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+    Profiler::Clock::time_point start;
+    size_t mainThreadId = 0;
+    size_t droppedEventCount = 0;
+};
+
+Trace& getTrace() {
+    static Trace trace;
+    return trace;
+}
+
+std::atomic<bool> sIsTracing{false};
+
+/// Small sequential id of the calling thread, assigned on its first event
+size_t getThreadId() {
+    static std::atomic<size_t> nextThreadId{1};
+    thread_local const size_t threadId = nextThreadId++;
+    return threadId;
+}
+
+/// Observer of the ThreadPool tasks while a trace is being recorded
+void traceThreadPoolTask(const bool started) {
+    // Tasks of a thread nest while it waits for other tasks, the pool notifies both the start and the end of a task
+    thread_local std::vector<Profiler::Clock::time_point> taskStarts;
+    if(started) {
+        taskStarts.push_back(Profiler::Clock::now());
+    } else {
+        P_ASSERT(!taskStarts.empty());
+        const Profiler::Clock::time_point start = taskStarts.back();
+        taskStarts.pop_back();
+        Profiler::traceEvent("ThreadPool", "Task", start, Profiler::Clock::now());
+    }
+}
+
+void writeJsonString(std::ostream& os, const std::string& value) {
+    os << '"';
+    for(const char c : value) {
+        if(c == '"' || c == '\\') {
+            os << '\\' << c;
+        } else if(static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+            os << escaped;
+        } else {
+            os << c;
+        }
+    }
+    os << '"';
+}
+
+/// Microseconds since the start of the trace, the time unit of the format
+long long getTraceMicroseconds(const Trace& trace, const Profiler::Clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(time - trace.start).count();
+}
+}  // namespace
+
+const char* Profiler::getZoneName(const Zone zone) {
+    P_ASSERT(zone < Zone::Count);
+    return ZONE_NAMES[static_cast<size_t>(zone)];
+}
+
+const char* Profiler::getCounterName(const Counter counter) {
+    P_ASSERT(counter < Counter::Count);
+    return COUNTER_NAMES[static_cast<size_t>(counter)];
+}
+
+void Profiler::record(const Zone zone, const double milliseconds) {
+    P_ASSERT(zone < Zone::Count);
+    Histories& histories = getHistories();
+    const std::lock_guard<std::mutex> lock(histories.mutex);
+    addToHistory(histories.zones[static_cast<size_t>(zone)], static_cast<float>(milliseconds));
+}
+
+std::vector<float> Profiler::getHistory(const Zone zone) {
+    P_ASSERT(zone < Zone::Count);
+    return getHistoryValues(static_cast<size_t>(zone));
+}
+
+Profiler::Statistics Profiler::getStatistics(const Zone zone) {
+    return computeStatistics(getHistory(zone));
+}
+
+void Profiler::count(const Counter counter, const size_t amount) {
+    P_ASSERT(counter < Counter::Count);
+    Histories& histories = getHistories();
+    const std::lock_guard<std::mutex> lock(histories.mutex);
+    histories.frameCounts[static_cast<size_t>(counter)] += amount;
+}
+
+void Profiler::endFrame() {
+    Histories& histories = getHistories();
+    const std::lock_guard<std::mutex> lock(histories.mutex);
+    for(size_t counterIdx = 0; counterIdx < COUNTER_COUNT; ++counterIdx) {
+        addToHistory(histories.zones[getHistoryIndex(static_cast<Counter>(counterIdx))],
+                     static_cast<float>(histories.frameCounts[counterIdx]));
+    }
+    histories.frameCounts = {};
+}
+
+std::vector<float> Profiler::getHistory(const Counter counter) {
+    P_ASSERT(counter < Counter::Count);
+    return getHistoryValues(getHistoryIndex(counter));
+}
+
+Profiler::Statistics Profiler::getStatistics(const Counter counter) {
+    return computeStatistics(getHistory(counter));
+}
+
+void Profiler::clear() {
+    Histories& histories = getHistories();
+    const std::lock_guard<std::mutex> lock(histories.mutex);
+    histories.zones = {};
+    histories.frameCounts = {};
+}
+
+void Profiler::startTrace() {
+    Trace& trace = getTrace();
+    {
+        const std::lock_guard<std::mutex> lock(trace.mutex);
+        trace.events.clear();
+        trace.start = Clock::now();
+        trace.mainThreadId = getThreadId();
+        trace.droppedEventCount = 0;
+    }
+    ::ThreadPool::set_task_observer(&traceThreadPoolTask);
+    sIsTracing = true;
+}
+
+void Profiler::stopTrace() {
+    sIsTracing = false;
+    ::ThreadPool::set_task_observer(nullptr);
+}
+
+bool Profiler::isTracing() {
+    return sIsTracing.load(std::memory_order_relaxed);
+}
+
+void Profiler::traceEvent(const char* category, std::string_view name, const Clock::time_point start,
+                          const Clock::time_point end) {
+    if(!isTracing()) {
+        return;
+    }
+    const size_t threadId = getThreadId();
+    Trace& trace = getTrace();
+    const std::lock_guard<std::mutex> lock(trace.mutex);
+    if(start < trace.start) {
+        return;
+    }
+    if(trace.events.size() >= MAX_TRACE_EVENTS) {
+        ++trace.droppedEventCount;
+        return;
+    }
+    trace.events.push_back(TraceEvent{category, std::string(name), start, end, threadId});
+}
+
+void Profiler::writeTrace(std::ostream& os) {
+    Trace& trace = getTrace();
+    const std::lock_guard<std::mutex> lock(trace.mutex);
+
+    std::vector<size_t> threadIds{trace.mainThreadId};
+    for(const TraceEvent& event : trace.events) {
+        threadIds.push_back(event.threadId);
+    }
+    std::sort(threadIds.begin(), threadIds.end());
+    threadIds.erase(std::unique(threadIds.begin(), threadIds.end()), threadIds.end());
+
+    os << "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":" << trace.droppedEventCount << "},";
+    os << "\"traceEvents\":[\n";
+    bool isFirst = true;
+    for(const size_t threadId : threadIds) {
+        const std::string threadName =
+            threadId == trace.mainThreadId ? "Main thread" : "Thread " + std::to_string(threadId);
+        os << (isFirst ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << threadId
+           << ",\"args\":{\"name\":";
+        writeJsonString(os, threadName);
+        os << "}}";
+        isFirst = false;
+    }
+    for(const TraceEvent& event : trace.events) {
+        os << ",\n{\"name\":";
+        writeJsonString(os, event.name);
+        os << ",\"cat\":";
+        writeJsonString(os, event.category);
+        os << ",\"ph\":\"X\",\"ts\":" << getTraceMicroseconds(trace, event.start)
+           << ",\"dur\":" << getTraceMicroseconds(trace, event.end) - getTraceMicroseconds(trace, event.start)
+           << ",\"pid\":1,\"tid\":" << event.threadId << "}";
+    }
+    os << "\n]}\n";
+}
+
+}  // namespace pepr3d
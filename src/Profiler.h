@@ -0,0 +1,164 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace pepr3d {
+
+/// Lightweight instrumentation of the application, durations of the named zones are recorded into ring buffers of
+/// their recent history. Any thread may record, e.g., by a ScopedTimer around the measured code.
+/// While a trace is being recorded, the zones, TraceScopes and ThreadPool tasks of all threads are also kept as events
+/// of a timeline, which can be written in Chrome Trace Event format.
+class Profiler {
+   public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Zone : size_t {
+        Frame,             ///< update() and draw() of a single frame
+        BufferGeneration,  ///< Generating and updating the OpenGL buffers of the Geometry
+        BufferUpload,      ///< Uploading the OpenGL buffers of the Geometry to the GPU
+        Picking,           ///< Picking a triangle under the mouse
+        Painting,          ///< Painting commands
+        MeshRebuild,       ///< Building the polyhedron and the detailed mesh
+        TreeRebuild,       ///< Building the picking trees
+        GpuModel,          ///< GPU time of drawing the model, including its buffer uploads
+        GpuToolPreview,    ///< GPU time of drawing the preview of the tool, e.g., the text being painted
+        GpuGrid,           ///< GPU time of drawing the grid
+        GpuToolOverlay,    ///< GPU time of the highlights and lines the tools draw into the model view
+        GpuImGui,          ///< GPU time of drawing the user interface
+        Count
+    };
+
+    static constexpr size_t ZONE_COUNT = static_cast<size_t>(Zone::Count);
+
+    /// Amounts accumulated over a frame, recorded into their histories by endFrame()
+    enum class Counter : size_t {
+        UploadedBytes,  ///< Bytes uploaded to the GPU buffers
+        Count
+    };
+
+    static constexpr size_t COUNTER_COUNT = static_cast<size_t>(Counter::Count);
+
+    /// Number of the most recent durations kept for each zone
+    static constexpr size_t HISTORY_SIZE = 240;
+
+    static const char* getZoneName(Zone zone);
+
+    static const char* getCounterName(Counter counter);
+
+    /// Records the duration of its lifetime into the zone
+    class ScopedTimer {
+       public:
+        explicit ScopedTimer(Zone zone) : mZone(zone), mStart(Clock::now()) {}
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+        ~ScopedTimer() {
+            const Clock::time_point end = Clock::now();
+            record(mZone, std::chrono::duration<double, std::milli>(end - mStart).count());
+            if(isTracing()) {
+                traceEvent("Zone", getZoneName(mZone), mStart, end);
+            }
+        }
+
+        /// Milliseconds since the construction, e.g., to log them as well
+        double getMilliseconds() const {
+            return std::chrono::duration<double, std::milli>(Clock::now() - mStart).count();
+        }
+
+       private:
+        Zone mZone;
+        Clock::time_point mStart;
+    };
+
+    /// Adds the duration of its lifetime to the trace, if a trace is being recorded when it is constructed.
+    /// Costs a single check when no trace is being recorded.
+    class TraceScope {
+       public:
+        TraceScope(const char* category, std::string_view name) : mCategory(category) {
+            if(isTracing()) {
+                mName = name;
+                mStart = Clock::now();
+                mIsTracing = true;
+            }
+        }
+
+        TraceScope(const TraceScope&) = delete;
+        TraceScope& operator=(const TraceScope&) = delete;
+
+        ~TraceScope() {
+            if(mIsTracing) {
+                traceEvent(mCategory, mName, mStart, Clock::now());
+            }
+        }
+
+       private:
+        const char* mCategory;
+        std::string mName;
+        Clock::time_point mStart;
+        bool mIsTracing = false;
+    };
+
+    struct Statistics {
+        size_t count = 0;
+        float median = 0.f;
+        float percentile95 = 0.f;
+        float max = 0.f;
+    };
+
+    /// Adds the duration to the history of the zone, replacing the oldest one if the history is full
+    static void record(Zone zone, double milliseconds);
+
+    /// Returns the recorded durations of the zone in milliseconds, from the oldest
+    static std::vector<float> getHistory(Zone zone);
+
+    /// Returns the statistics of the recorded durations of the zone
+    static Statistics getStatistics(Zone zone);
+
+    /// Adds the amount to the counter in the current frame
+    static void count(Counter counter, size_t amount);
+
+    /// Adds the amounts of the current frame to the histories of the counters and starts the next frame
+    static void endFrame();
+
+    /// Returns the amounts of the counter in the recorded frames, from the oldest
+    static std::vector<float> getHistory(Counter counter);
+
+    /// Returns the statistics of the amounts of the counter in the recorded frames
+    static Statistics getStatistics(Counter counter);
+
+    /// Forgets all recorded durations and amounts
+    static void clear();
+
+    /// Maximum number of events of a trace, later events are dropped
+    static constexpr size_t MAX_TRACE_EVENTS = 2000000;
+
+    /// Starts recording a new trace, forgetting the events of the previous one.
+    /// The thread calling this is named as the main thread of the trace.
+    static void startTrace();
+
+    /// Stops recording the trace, its events are kept until the next startTrace()
+    static void stopTrace();
+
+    static bool isTracing();
+
+    /// Adds an event of the duration between start and end to the trace, if a trace is being recorded.
+    /// Events that started before the trace are dropped.
+    static void traceEvent(const char* category, std::string_view name, Clock::time_point start,
+                           Clock::time_point end);
+
+    /// Writes the events of the last trace as JSON in Chrome Trace Event format, e.g., for Perfetto or
+    /// chrome://tracing
+    static void writeTrace(std::ostream& os);
+
+   private:
+    /// Prevent this class from being constructed
+    Profiler() = default;
+};
+
+}  // namespace pepr3d
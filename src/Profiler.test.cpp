@@ -0,0 +1,155 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Profiler.h"
+#include "ThreadPool.h"
+
+using pepr3d::Profiler;
+
+TEST(Profiler, statistics) {
+    /**
+     * Test that the percentiles and the maximum are computed from the recorded durations
+     */
+
+    Profiler::clear();
+    EXPECT_EQ(Profiler::getStatistics(Profiler::Zone::Painting).count, 0);
+
+    for(int i = 100; i >= 1; --i) {
+        Profiler::record(Profiler::Zone::Painting, static_cast<double>(i));
+    }
+    const Profiler::Statistics statistics = Profiler::getStatistics(Profiler::Zone::Painting);
+    EXPECT_EQ(statistics.count, 100);
+    EXPECT_EQ(statistics.median, 50.f);
+    EXPECT_EQ(statistics.percentile95, 95.f);
+    EXPECT_EQ(statistics.max, 100.f);
+
+    // Other zones are independent
+    EXPECT_TRUE(Profiler::getHistory(Profiler::Zone::Picking).empty());
+    Profiler::clear();
+    EXPECT_TRUE(Profiler::getHistory(Profiler::Zone::Painting).empty());
+}
+
+TEST(Profiler, ringBuffer) {
+    /**
+     * Test that a full history replaces its oldest durations and returns them from the oldest
+     */
+
+    Profiler::clear();
+    const size_t extra = 10;
+    for(size_t i = 0; i < Profiler::HISTORY_SIZE + extra; ++i) {
+        Profiler::record(Profiler::Zone::Frame, static_cast<double>(i));
+    }
+    const std::vector<float> history = Profiler::getHistory(Profiler::Zone::Frame);
+    ASSERT_EQ(history.size(), Profiler::HISTORY_SIZE);
+    for(size_t i = 0; i < history.size(); ++i) {
+        EXPECT_EQ(history[i], static_cast<float>(i + extra));
+    }
+    Profiler::clear();
+}
+
+TEST(Profiler, scopedTimer) {
+    /**
+     * Test that scoped timers of several threads record their durations
+     */
+
+    Profiler::clear();
+    std::vector<std::thread> threads;
+    for(int i = 0; i < 4; ++i) {
+        threads.emplace_back([]() {
+            const Profiler::ScopedTimer timer(Profiler::Zone::TreeRebuild);
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            EXPECT_GE(timer.getMilliseconds(), 2.0);
+        });
+    }
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+    const Profiler::Statistics statistics = Profiler::getStatistics(Profiler::Zone::TreeRebuild);
+    EXPECT_EQ(statistics.count, 4);
+    EXPECT_GE(statistics.median, 2.f);
+    EXPECT_STREQ(Profiler::getZoneName(Profiler::Zone::TreeRebuild), "Tree rebuild");
+    Profiler::clear();
+}
+
+TEST(Profiler, counters) {
+    /**
+     * Test that the counters sum the amounts of each frame into their histories, independently of the zones
+     */
+
+    Profiler::clear();
+    Profiler::count(Profiler::Counter::UploadedBytes, 100);
+    Profiler::count(Profiler::Counter::UploadedBytes, 28);
+    EXPECT_TRUE(Profiler::getHistory(Profiler::Counter::UploadedBytes).empty());
+    Profiler::endFrame();
+    Profiler::endFrame();
+    Profiler::count(Profiler::Counter::UploadedBytes, 1);
+    Profiler::endFrame();
+
+    EXPECT_EQ(Profiler::getHistory(Profiler::Counter::UploadedBytes), std::vector<float>({128.f, 0.f, 1.f}));
+    EXPECT_EQ(Profiler::getStatistics(Profiler::Counter::UploadedBytes).max, 128.f);
+    EXPECT_TRUE(Profiler::getHistory(Profiler::Zone::Frame).empty());
+    EXPECT_STREQ(Profiler::getCounterName(Profiler::Counter::UploadedBytes), "Uploaded bytes");
+
+    // The amounts of an unfinished frame are forgotten as well
+    Profiler::count(Profiler::Counter::UploadedBytes, 5);
+    Profiler::clear();
+    Profiler::endFrame();
+    EXPECT_EQ(Profiler::getHistory(Profiler::Counter::UploadedBytes), std::vector<float>({0.f}));
+    Profiler::clear();
+}
+
+TEST(Profiler, trace) {
+    /**
+     * Test that a trace records the zones, scopes and thread pool tasks only while it is being recorded,
+     * and that it is written as Chrome trace events
+     */
+
+    ::ThreadPool threadPool(2);
+    const auto countOccurrences = [](const std::string& text, const std::string& pattern) {
+        size_t count = 0;
+        for(size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1)) {
+            ++count;
+        }
+        return count;
+    };
+
+    { const Profiler::TraceScope scope("Test", "Before the trace"); }
+    EXPECT_FALSE(Profiler::isTracing());
+
+    Profiler::startTrace();
+    EXPECT_TRUE(Profiler::isTracing());
+    { const Profiler::ScopedTimer timer(Profiler::Zone::Painting); }
+    { const Profiler::TraceScope scope("Test", "Quoted \"name\"\n"); }
+    std::future<void> task = threadPool.enqueue([]() { const Profiler::TraceScope scope("Test", "Inside a task"); });
+    threadPool.wait(task);
+    Profiler::stopTrace();
+    EXPECT_FALSE(Profiler::isTracing());
+    { const Profiler::TraceScope scope("Test", "After the trace"); }
+
+    std::stringstream trace;
+    Profiler::writeTrace(trace);
+    const std::string json = trace.str();
+    EXPECT_EQ(json.front(), '{');
+    EXPECT_EQ(countOccurrences(json, "\"ph\":\"X\""), 4);
+    EXPECT_EQ(countOccurrences(json, "\"name\":\"Painting\",\"cat\":\"Zone\""), 1);
+    EXPECT_EQ(countOccurrences(json, "\"name\":\"Quoted \\\"name\\\"\\u000a\""), 1);
+    EXPECT_EQ(countOccurrences(json, "\"name\":\"Inside a task\""), 1);
+    EXPECT_EQ(countOccurrences(json, "\"cat\":\"ThreadPool\""), 1);
+    EXPECT_EQ(countOccurrences(json, "\"name\":\"Main thread\""), 1);
+    EXPECT_EQ(countOccurrences(json, "the trace"), 0);
+
+    // The events are kept until the next trace starts
+    Profiler::startTrace();
+    Profiler::stopTrace();
+    std::stringstream emptyTrace;
+    Profiler::writeTrace(emptyTrace);
+    EXPECT_EQ(countOccurrences(emptyTrace.str(), "\"ph\":\"X\""), 0);
+    Profiler::clear();
+}
+
+#endif
@@ -0,0 +1,187 @@
+#include "commands/Autosave.h"
+
+#include <cinder/Log.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+#include "peprassert.h"
+
+namespace pepr3d {
+
+namespace {
+const std::string CHECKPOINT_EXTENSION = ".p3d";
+const std::string JOURNAL_EXTENSION = ".journal";
+
+/// Checkpoint being written, see writeProjectFile() in MainApplication
+const std::string PARTIAL_CHECKPOINT_EXTENSION = ".p3d.saving";
+
+std::string getFilePrefix(const ci::fs::path& projectPath) {
+    return projectPath.filename().string() + ".autosave-";
+}
+
+ci::fs::path getDirectory(const ci::fs::path& projectPath) {
+    const ci::fs::path directory = projectPath.parent_path();
+    return directory.empty() ? ci::fs::path(".") : directory;
+}
+
+ci::fs::path getAutosavePath(const ci::fs::path& projectPath, const uint64_t generation,
+                             const std::string& extension) {
+    return getDirectory(projectPath) / (getFilePrefix(projectPath) + std::to_string(generation) + extension);
+}
+}  // namespace
+
+Autosave::Autosave(const ci::fs::path& projectPath, CommandManager<Geometry>& commandManager,
+                   const size_t savedVersion)
+    : mProjectPath(projectPath), mCommandManager(commandManager), mCheckpointVersion(savedVersion) {
+    // Continue after the generations of a recovered autosave, they are removed with the first checkpoint
+    for(const std::string& extension : {CHECKPOINT_EXTENSION, JOURNAL_EXTENSION}) {
+        const std::vector<uint64_t> generations = findGenerations(mProjectPath, extension);
+        if(!generations.empty()) {
+            mGeneration = std::max(mGeneration, generations.back());
+        }
+    }
+}
+
+Autosave::~Autosave() {
+    if(mJournal != nullptr) {
+        mCommandManager.removeObserver(mJournal.get());
+        mJournal->close(false);
+    }
+}
+
+bool Autosave::needsCheckpoint() const {
+    if(mIsCheckpointInProgress || mIsStopped || mCommandManager.getVersionNumber() == mCheckpointVersion) {
+        return false;
+    }
+    return mJournal == nullptr || !mJournal->isReplayable() || mJournal->getEntryCount() >= CHECKPOINT_ENTRIES;
+}
+
+ci::fs::path Autosave::beginCheckpoint(const uint64_t modelHash) {
+    P_ASSERT(!mIsCheckpointInProgress && !mIsStopped);
+    const uint64_t generation = mGeneration + 1;
+    std::unique_ptr<CommandJournal> journal;
+    try {
+        journal = std::make_unique<CommandJournal>(getPath(generation, JOURNAL_EXTENSION).string(), modelHash);
+    } catch(const std::runtime_error&) {
+        mIsStopped = true;
+        throw;
+    }
+    if(mJournal != nullptr) {
+        // Recovered together with the new journal if the new checkpoint is not written
+        mCommandManager.removeObserver(mJournal.get());
+        mJournal->close(true);
+    }
+    mJournal = std::move(journal);
+    mCommandManager.addObserver(mJournal.get());
+
+    mGeneration = generation;
+    mCheckpointVersion = mCommandManager.getVersionNumber();
+    mIsCheckpointInProgress = true;
+    return getPath(generation, CHECKPOINT_EXTENSION);
+}
+
+void Autosave::finishCheckpoint(const bool isWritten) {
+    P_ASSERT(mIsCheckpointInProgress);
+    mIsCheckpointInProgress = false;
+    if(mIsStopped) {
+        removeFiles();  // Stopped while the checkpoint was being written
+    } else if(isWritten) {
+        removeGenerationsBefore(mProjectPath, mGeneration);
+    } else {
+        CI_LOG_E("Writing the autosave checkpoint failed, the autosave of " + mProjectPath.string() + " is stopped.");
+        mIsStopped = true;
+    }
+}
+
+void Autosave::removeFiles() {
+    if(mJournal != nullptr) {
+        mCommandManager.removeObserver(mJournal.get());
+        mJournal->close(false);
+        mJournal = nullptr;
+    }
+    mIsStopped = true;
+    discard(mProjectPath);
+}
+
+std::optional<Autosave::Recovery> Autosave::findRecovery(const ci::fs::path& projectPath) {
+    const std::vector<uint64_t> checkpoints = findGenerations(projectPath, CHECKPOINT_EXTENSION);
+    if(checkpoints.empty()) {
+        return {};
+    }
+
+    Recovery recovery;
+    recovery.checkpointPath = getAutosavePath(projectPath, checkpoints.back(), CHECKPOINT_EXTENSION);
+    for(uint64_t generation = checkpoints.back();; ++generation) {
+        std::ifstream is(getAutosavePath(projectPath, generation, JOURNAL_EXTENSION).string(), std::ios::binary);
+        if(!is.is_open()) {
+            break;
+        }
+        CommandJournal::Contents contents;
+        try {
+            contents = CommandJournal::read(is);
+        } catch(const std::runtime_error& e) {
+            CI_LOG_W("The autosave journal cannot be read: " << e.what());
+            break;
+        }
+        if(generation == checkpoints.back()) {
+            recovery.modelHash = contents.modelHash;
+        }
+        std::move(contents.entries.begin(), contents.entries.end(), std::back_inserter(recovery.entries));
+        if(!contents.isContinued) {
+            break;
+        }
+    }
+    return recovery;
+}
+
+void Autosave::discard(const ci::fs::path& projectPath) {
+    removeGenerationsBefore(projectPath, std::numeric_limits<uint64_t>::max());
+}
+
+ci::fs::path Autosave::getPath(const uint64_t generation, const std::string& extension) const {
+    return getAutosavePath(mProjectPath, generation, extension);
+}
+
+std::vector<uint64_t> Autosave::findGenerations(const ci::fs::path& projectPath, const std::string& extension) {
+    std::vector<uint64_t> generations;
+    const std::string prefix = getFilePrefix(projectPath);
+    try {
+        const ci::fs::path directory = getDirectory(projectPath);
+        if(!ci::fs::is_directory(directory)) {
+            return generations;
+        }
+        for(ci::fs::directory_iterator it(directory), end; it != end; ++it) {
+            const std::string name = it->path().filename().string();
+            if(name.size() <= prefix.size() + extension.size() || name.compare(0, prefix.size(), prefix) != 0 ||
+               name.compare(name.size() - extension.size(), extension.size(), extension) != 0) {
+                continue;
+            }
+            const std::string number = name.substr(prefix.size(), name.size() - prefix.size() - extension.size());
+            // Longer numbers are not generations, they do not fit into uint64_t
+            if(number.size() <= 18 &&
+               std::all_of(number.begin(), number.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+                generations.push_back(std::stoull(number));
+            }
+        }
+    } catch(const std::exception& e) {
+        CI_LOG_W("Could not list the autosave files of " + projectPath.string() + ": " + e.what());
+    }
+    std::sort(generations.begin(), generations.end());
+    return generations;
+}
+
+void Autosave::removeGenerationsBefore(const ci::fs::path& projectPath, const uint64_t generation) {
+    for(const std::string& extension : {CHECKPOINT_EXTENSION, JOURNAL_EXTENSION, PARTIAL_CHECKPOINT_EXTENSION}) {
+        for(const uint64_t oldGeneration : findGenerations(projectPath, extension)) {
+            if(oldGeneration < generation) {
+                std::remove(getAutosavePath(projectPath, oldGeneration, extension).string().c_str());
+            }
+        }
+    }
+}
+
+}  // namespace pepr3d
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cinder/Filesystem.h>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "commands/CommandJournal.h"
+#include "commands/CommandManager.h"
+#include "commands/SessionRecording.h"
+#include "geometry/Geometry.h"
+
+namespace pepr3d {
+
+/// Journaled autosave of a project, recovered after a crash.
+/// The commands are appended to a CommandJournal and a full checkpoint of the project is written only once the
+/// journal grows long or cannot replay an undo, so a command costs a small record instead of a project write.
+/// Each checkpoint starts a generation of the files next to the project, "<project>.autosave-<generation>.p3d" and
+/// ".journal". The journal of a generation records the commands from the moment its checkpoint is taken, the older
+/// generations are removed once the checkpoint is written. A crash while writing it is recovered from the previous
+/// checkpoint and the journals of both generations.
+/// The methods are called on the main thread, none of them while a command runs on a worker.
+class Autosave {
+   public:
+    /// Entries of a journal after which a new checkpoint is written
+    static const size_t CHECKPOINT_ENTRIES = 200;
+
+    /// Autosave left by a crash, see findRecovery()
+    struct Recovery {
+        /// Latest checkpoint, a project in the ProjectFile container
+        ci::fs::path checkpointPath;
+
+        /// Geometry::getModelHash() of the model of the checkpoint
+        uint64_t modelHash = 0;
+
+        /// Entries of the journals after the checkpoint, replay them by SessionRecording::applyEntry()
+        std::vector<SessionRecording::Entry> entries;
+    };
+
+    /// Autosaves the commands of the CommandManager, which must outlive the autosave, next to the project path
+    /// @param savedVersion CommandManager::getVersionNumber() of the state in the project file or the last recovered
+    /// checkpoint, a checkpoint is written once the version differs
+    Autosave(const ci::fs::path& projectPath, CommandManager<Geometry>& commandManager, size_t savedVersion);
+
+    ~Autosave();
+
+    Autosave(const Autosave&) = delete;
+    Autosave& operator=(const Autosave&) = delete;
+
+    const ci::fs::path& getProjectPath() const {
+        return mProjectPath;
+    }
+
+    /// Should a checkpoint be taken now, there are changes that no journal after the last checkpoint replays.
+    /// False while a checkpoint is being written, after writing one failed and after removeFiles().
+    bool needsCheckpoint() const;
+
+    /// Starts the next generation, its journal records the commands executed from now on.
+    /// Returns the path to write the checkpoint into, with the state of the Geometry at this moment.
+    /// Throws std::runtime_error if the journal cannot be created, the autosave is stopped then.
+    /// @param modelHash Geometry::getModelHash() of the model of the checkpoint
+    ci::fs::path beginCheckpoint(uint64_t modelHash);
+
+    /// Called once the checkpoint of the last beginCheckpoint() is written, then the older generations are removed.
+    /// If writing it failed, the autosave stops taking checkpoints.
+    void finishCheckpoint(bool isWritten);
+
+    /// Stops the autosave and removes its files, e.g., when the project is closed.
+    /// Call it before the CommandManager is destroyed if a checkpoint is still being written.
+    void removeFiles();
+
+    /// Finds the autosave of the project left by a crash, empty if there is none or it cannot be read
+    static std::optional<Recovery> findRecovery(const ci::fs::path& projectPath);
+
+    /// Removes the files of an autosave of the project that is not recovered, e.g., when its checkpoint is corrupted
+    static void discard(const ci::fs::path& projectPath);
+
+   private:
+    /// Path of the checkpoint or the journal of the generation
+    ci::fs::path getPath(uint64_t generation, const std::string& extension) const;
+
+    /// Generations of the autosave files of the project with the extension, sorted
+    static std::vector<uint64_t> findGenerations(const ci::fs::path& projectPath, const std::string& extension);
+
+    /// Removes the files of the generations of the project before the one given
+    static void removeGenerationsBefore(const ci::fs::path& projectPath, uint64_t generation);
+
+    ci::fs::path mProjectPath;
+    CommandManager<Geometry>& mCommandManager;
+
+    /// Journal of the last generation, observing the CommandManager, null before the first checkpoint
+    std::unique_ptr<CommandJournal> mJournal;
+    uint64_t mGeneration = 0;
+
+    /// Version of the CommandManager at the last checkpoint
+    size_t mCheckpointVersion;
+
+    bool mIsCheckpointInProgress = false;
+
+    /// The autosave does not take more checkpoints, after a failed one or removeFiles()
+    bool mIsStopped = false;
+};
+
+}  // namespace pepr3d
@@ -0,0 +1,153 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <cinder/Filesystem.h>
+#include <fstream>
+#include <future>
+#include <map>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "commands/Autosave.h"
+#include "commands/CmdColorManager.h"
+#include "commands/CmdPaintBrush.h"
+#include "commands/CmdPaintSingleColor.h"
+#include "commands/CommandManager.h"
+#include "geometry/Geometry.h"
+#include "geometry/ProjectFile.h"
+#include "geometry/TestGeometries.h"
+
+namespace pepr3d {
+namespace {
+/// Stands in for the project the application writes as the checkpoint
+void writeCheckpoint(const ci::fs::path& path) {
+    std::ofstream os(path.string(), std::ios::binary);
+    os << "checkpoint";
+}
+}  // namespace
+
+TEST(Autosave, checkpointsAndRecovery) {
+    /**
+     * Test that the commands after the last written checkpoint are recovered, also from the journals of two
+     * generations while the newer checkpoint is being written, and that an undo before the checkpoint needs a new one
+     */
+
+    const ci::fs::path directory = ci::fs::temp_directory_path() / "pepr3d_autosave_test";
+    ci::fs::remove_all(directory);
+    ci::fs::create_directories(directory);
+    const ci::fs::path projectPath = directory / "model.p3d";
+
+    Geometry geometry(test::getGeometryWithSquare());
+    CommandManager<Geometry> commandManager(geometry);
+    Autosave autosave(projectPath, commandManager, commandManager.getVersionNumber());
+    EXPECT_FALSE(autosave.needsCheckpoint());
+    EXPECT_FALSE(Autosave::findRecovery(projectPath).has_value());
+
+    commandManager.execute(std::make_unique<CmdPaintSingleColor>(size_t(0), 1));
+    ASSERT_TRUE(autosave.needsCheckpoint());
+    const ci::fs::path firstCheckpoint = autosave.beginCheckpoint(geometry.getModelHash());
+    EXPECT_FALSE(autosave.needsCheckpoint());
+    writeCheckpoint(firstCheckpoint);
+    autosave.finishCheckpoint(true);
+
+    commandManager.execute(std::make_unique<CmdPaintSingleColor>(size_t(1), 2));
+    EXPECT_FALSE(autosave.needsCheckpoint());
+    const ci::fs::path secondCheckpoint = autosave.beginCheckpoint(geometry.getModelHash());
+    commandManager.execute(std::make_unique<CmdColorManagerChangeColor>(0, glm::vec4(1.f)));
+
+    std::optional<Autosave::Recovery> recovery = Autosave::findRecovery(projectPath);
+    ASSERT_TRUE(recovery.has_value());
+    EXPECT_EQ(recovery->checkpointPath, firstCheckpoint);
+    EXPECT_EQ(recovery->modelHash, geometry.getModelHash());
+    ASSERT_EQ(recovery->entries.size(), 2);
+    EXPECT_EQ(recovery->entries[0].type, SessionRecording::EntryType::PaintSingleColor);
+    EXPECT_EQ(recovery->entries[1].type, SessionRecording::EntryType::ChangeColor);
+
+    writeCheckpoint(secondCheckpoint);
+    autosave.finishCheckpoint(true);
+    EXPECT_FALSE(ci::fs::exists(firstCheckpoint));
+    recovery = Autosave::findRecovery(projectPath);
+    ASSERT_TRUE(recovery.has_value());
+    EXPECT_EQ(recovery->checkpointPath, secondCheckpoint);
+    ASSERT_EQ(recovery->entries.size(), 1);
+
+    commandManager.undo();
+    EXPECT_FALSE(autosave.needsCheckpoint());
+    commandManager.undo();
+    EXPECT_TRUE(autosave.needsCheckpoint());
+
+    autosave.removeFiles();
+    EXPECT_FALSE(autosave.needsCheckpoint());
+    EXPECT_FALSE(Autosave::findRecovery(projectPath).has_value());
+    EXPECT_TRUE(ci::fs::is_empty(directory));
+    ci::fs::remove_all(directory);
+}
+
+TEST(Autosave, checkpointWhilePainting) {
+    /**
+     * Test that a checkpoint written on a worker while the brush strokes go on has the painted state of the moment
+     * it was taken, and that the journal recovers the strokes after it
+     */
+
+    const ci::fs::path directory = ci::fs::temp_directory_path() / "pepr3d_autosave_painting_test";
+    ci::fs::remove_all(directory);
+    ci::fs::create_directories(directory);
+    const ci::fs::path projectPath = directory / "model.p3d";
+
+    Geometry geometry(test::getGeometryWithSquare());
+    CommandManager<Geometry> commandManager(geometry);
+    Autosave autosave(projectPath, commandManager, commandManager.getVersionNumber());
+    BrushSettings settings;
+    settings.size = 0.1f;
+    settings.color = 1;
+    commandManager.execute(
+        std::make_unique<CmdPaintBrush>(ci::Ray(glm::vec3(0.3f, 0.6f, 2.f), glm::vec3(0.f, 0.f, -1.f)), settings));
+    ASSERT_TRUE(autosave.needsCheckpoint());
+
+    // Taken like MainApplication::updateAutosave() takes it
+    const ci::fs::path checkpointPath = autosave.beginCheckpoint(geometry.getModelHash());
+    const auto snapshot = std::make_shared<const Geometry::ProjectSnapshot>(geometry.createProjectSnapshot());
+    std::map<size_t, std::vector<ColorIndex>> expectedColors;
+    for(const auto& detail : snapshot->triangleDetails) {
+        expectedColors[detail.first] = detail.second->getTriangles().getColors();
+    }
+    ASSERT_FALSE(expectedColors.empty());
+
+    auto written = std::async(std::launch::async, [snapshot, checkpointPath]() {
+        std::ofstream os(checkpointPath.string(), std::ios::binary);
+        ProjectFile::write(os, *snapshot, Geometry::getThreadPool());
+    });
+    const size_t strokeCount = 20;
+    for(size_t stroke = 0; stroke < strokeCount; ++stroke) {
+        settings.color = 2 + stroke % 2;
+        const float x = 0.2f + 0.03f * static_cast<float>(stroke);
+        commandManager.execute(
+            std::make_unique<CmdPaintBrush>(ci::Ray(glm::vec3(x, 0.6f, 2.f), glm::vec3(0.f, 0.f, -1.f)), settings));
+    }
+    written.get();
+    autosave.finishCheckpoint(true);
+
+    const std::optional<Autosave::Recovery> recovery = Autosave::findRecovery(projectPath);
+    ASSERT_TRUE(recovery.has_value());
+    EXPECT_EQ(recovery->checkpointPath, checkpointPath);
+    EXPECT_EQ(recovery->entries.size(), strokeCount);
+    {
+        std::ifstream is(checkpointPath.string(), std::ios::binary);
+        Geometry::ProjectSnapshot checkpoint = ProjectFile::read(is, Geometry::getThreadPool());
+        std::map<size_t, std::vector<ColorIndex>> checkpointColors;
+        for(auto& detail : checkpoint.triangleDetails) {
+            detail.second.write().loadExactData();
+            checkpointColors[detail.first] = detail.second->getTriangles().getColors();
+        }
+        EXPECT_EQ(checkpointColors, expectedColors);
+        EXPECT_EQ(checkpoint.triangles.getColors(), snapshot->triangles.getColors());
+    }
+
+    autosave.removeFiles();
+    ci::fs::remove_all(directory);
+}
+
+}  // namespace pepr3d
+
+#endif
@@ -0,0 +1,292 @@
+#include "commands/BatchScript.h"
+
+#include <CGAL/squared_distance_3.h>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "commands/CmdPaintSingleColor.h"
+#include "commands/CmdPaintText.h"
+#include "geometry/FontRasterizer.h"
+
+namespace pepr3d {
+
+namespace {
+/// How far the text is placed from the model (normalized by model scale), the same as in the Text Editor
+const float TEXT_DISTANCE_SCALE = 0.02f;
+
+/// Limits of the Segmentation tool
+const int MIN_CLUSTERS = 2;
+const int MAX_CLUSTERS = 15;
+
+template <typename T>
+T readValue(std::istringstream& line, const std::string& name) {
+    T value;
+    if(!(line >> value)) {
+        throw std::runtime_error("expected " + name);
+    }
+    return value;
+}
+
+glm::vec3 readPoint(std::istringstream& line) {
+    const float x = readValue<float>(line, "the x coordinate");
+    const float y = readValue<float>(line, "the y coordinate");
+    const float z = readValue<float>(line, "the z coordinate");
+    return glm::vec3(x, y, z);
+}
+
+/// Reads a word or a "quoted string"
+std::string readString(std::istringstream& line, const std::string& name) {
+    std::string value;
+    if(!(line >> std::quoted(value))) {
+        throw std::runtime_error("expected " + name);
+    }
+    return value;
+}
+
+BatchScript::BucketFill parseBucketFill(std::istringstream& line) {
+    BatchScript::BucketFill fill;
+    fill.seed = readPoint(line);
+    fill.color = readValue<size_t>(line, "the color");
+    std::string option;
+    while(line >> option) {
+        if(option == "angle") {
+            fill.normalAngleDegrees = readValue<float>(line, "the angle in degrees");
+        } else if(option == "whole") {
+            fill.isWhole = true;
+        } else {
+            throw std::runtime_error("unknown option " + option);
+        }
+    }
+    return fill;
+}
+
+BatchScript::Segmentation parseSegmentation(std::istringstream& line) {
+    BatchScript::Segmentation segmentation;
+    segmentation.numberOfClusters = readValue<int>(line, "the number of clusters");
+    if(segmentation.numberOfClusters < MIN_CLUSTERS || segmentation.numberOfClusters > MAX_CLUSTERS) {
+        throw std::runtime_error("the number of clusters must be from " + std::to_string(MIN_CLUSTERS) + " to " +
+                                 std::to_string(MAX_CLUSTERS));
+    }
+    segmentation.smoothingLambda = readValue<float>(line, "the smoothing");
+    if(!(segmentation.smoothingLambda > 0.f && segmentation.smoothingLambda <= 1.f)) {
+        throw std::runtime_error("the smoothing must be greater than 0 and at most 1");
+    }
+    size_t color = 0;
+    while(line >> color) {
+        segmentation.colors.push_back(color);
+    }
+    if(segmentation.colors.empty() || !line.eof()) {
+        throw std::runtime_error("expected the colors of the segments");
+    }
+    return segmentation;
+}
+
+BatchScript::Text parseText(std::istringstream& line) {
+    BatchScript::Text text;
+    text.point = readPoint(line);
+    text.color = readValue<size_t>(line, "the color");
+    text.fontPath = readString(line, "the font file");
+    text.text = readString(line, "the text");
+    std::string option;
+    while(line >> option) {
+        if(option == "size") {
+            text.fontSize = readValue<int>(line, "the font size");
+        } else if(option == "bezier") {
+            text.bezierSteps = readValue<int>(line, "the bezier steps");
+        } else if(option == "scale") {
+            text.scale = readValue<float>(line, "the scale");
+        } else if(option == "rotation") {
+            text.rotationDegrees = readValue<float>(line, "the rotation in degrees");
+        } else {
+            throw std::runtime_error("unknown option " + option);
+        }
+    }
+    if(text.fontSize < 1 || text.bezierSteps < 1) {
+        throw std::runtime_error("the font size and the bezier steps must be positive");
+    }
+    return text;
+}
+
+void checkColor(const Geometry& geometry, const size_t color) {
+    if(color >= geometry.getColorManager().size()) {
+        throw std::runtime_error("The color " + std::to_string(color) + " is not in the palette of " +
+                                 std::to_string(geometry.getColorManager().size()) + " colors.");
+    }
+}
+
+/// The triangle of the detailed mesh closest to the point
+DetailedTriangleId findClosestTriangle(const Geometry& geometry, const glm::vec3& point) {
+    if(geometry.getTriangleCount() == 0) {
+        throw std::runtime_error("The model has no triangles.");
+    }
+    const DataTriangle::K::Point_3 cgalPoint(point.x, point.y, point.z);
+
+    size_t closestBase = 0;
+    double closestDistance = std::numeric_limits<double>::max();
+    for(size_t i = 0; i < geometry.getTriangleCount(); ++i) {
+        const double distance = CGAL::squared_distance(cgalPoint, geometry.getTriangle(i).getTri());
+        if(distance < closestDistance) {
+            closestDistance = distance;
+            closestBase = i;
+        }
+    }
+    if(geometry.isSimpleTriangle(closestBase)) {
+        return DetailedTriangleId(closestBase);
+    }
+
+    size_t closestDetail = 0;
+    closestDistance = std::numeric_limits<double>::max();
+    for(size_t i = 0; i < geometry.getTriangleDetailCount(closestBase); ++i) {
+        const DetailedTriangleId triangleId(closestBase, i);
+        const double distance = CGAL::squared_distance(cgalPoint, geometry.getTriangle(triangleId).getTri());
+        if(distance < closestDistance) {
+            closestDistance = distance;
+            closestDetail = i;
+        }
+    }
+    return DetailedTriangleId(closestBase, closestDetail);
+}
+
+void applyBucketFill(Geometry& geometry, CommandManager<Geometry>& commandManager,
+                     const BatchScript::BucketFill& fill) {
+    checkColor(geometry, fill.color);
+    const DetailedTriangleId startTriangle = findClosestTriangle(geometry, fill.seed);
+
+    std::vector<DetailedTriangleId> trianglesToPaint;
+    if(fill.isWhole) {
+        const auto doNotStop = [](const DetailedTriangleId, const DetailedTriangleId) { return true; };
+        trianglesToPaint = geometry.parallelBucket(startTriangle, doNotStop, Geometry::getThreadPool());
+    } else if(!fill.normalAngleDegrees) {
+        trianglesToPaint = geometry.getColorRegion(startTriangle);
+    } else {
+        // The same criteria as the Paint Bucket comparing the normals of neighbours
+        const float threshold = glm::cos(glm::radians(*fill.normalAngleDegrees));
+        const auto stopOnNormalAndColor = [&geometry, threshold](const DetailedTriangleId a,
+                                                                 const DetailedTriangleId b) {
+            if(geometry.getTriangle(a).getColor() != geometry.getTriangle(b).getColor()) {
+                return false;
+            }
+            return a.getBaseId() == b.getBaseId() || geometry.getNeighbourCosine(a, b) >= threshold;
+        };
+        trianglesToPaint = geometry.bucket(startTriangle, stopOnNormalAndColor);
+    }
+
+    if(!trianglesToPaint.empty()) {
+        commandManager.execute(std::make_unique<CmdPaintSingleColor>(std::move(trianglesToPaint), fill.color));
+    }
+}
+
+void applySegmentation(Geometry& geometry, CommandManager<Geometry>& commandManager,
+                       const BatchScript::Segmentation& segmentation) {
+    for(const size_t color : segmentation.colors) {
+        checkColor(geometry, color);
+    }
+    if(!geometry.polyhedronValid()) {
+        throw std::runtime_error("The model cannot be segmented, it is not a valid polyhedron.");
+    }
+    if(!geometry.isSdfComputed()) {
+        geometry.computeSdfValues();
+    }
+    // Segment the refined values, so the result does not depend on the timing of the refinement
+    while(geometry.isSdfRefining()) {
+        if(!geometry.updateSdfRefinement()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    const int numberOfClusters =
+        std::min<int>(segmentation.numberOfClusters, static_cast<int>(geometry.getTriangleCount()) - 2);
+    if(numberOfClusters < MIN_CLUSTERS) {
+        throw std::runtime_error("The model has too few triangles to be segmented.");
+    }
+    SegmentMap segments;
+    const size_t numberOfSegments = geometry.segmentation(numberOfClusters, segmentation.smoothingLambda, segments);
+    if(numberOfSegments == 0) {
+        throw std::runtime_error("The segmentation of the model failed.");
+    }
+
+    for(size_t segment = 0; segment < segments.getSegmentCount(); ++segment) {
+        const size_t color = segmentation.colors[segment % segmentation.colors.size()];
+        commandManager.execute(std::make_unique<CmdPaintSingleColor>(segments.copyTriangles(segment), color));
+    }
+}
+
+void applyText(Geometry& geometry, CommandManager<Geometry>& commandManager, const BatchScript::Text& text) {
+    checkColor(geometry, text.color);
+    FontRasterizer fontRasterizer(text.fontPath);
+    if(!fontRasterizer.isValid()) {
+        throw std::runtime_error("Failed to load the font " + text.fontPath);
+    }
+    std::vector<std::vector<FontRasterizer::Tri>> letters =
+        fontRasterizer.rasterizeText(text.text, static_cast<size_t>(text.fontSize),
+                                     static_cast<size_t>(text.bezierSteps), nullptr, &Geometry::getThreadPool());
+    if(letters.empty()) {
+        return;
+    }
+
+    const DetailedTriangleId closestTriangle = findClosestTriangle(geometry, text.point);
+    const glm::vec3 direction = glm::normalize(-geometry.getTriangle(closestTriangle.getBaseId()).getNormal());
+    const glm::vec3 modelSize = geometry.getBoundingBoxMax() - geometry.getBoundingBoxMin();
+    const float maxSize = std::max({modelSize.x, modelSize.y, modelSize.z});
+    const glm::vec3 origin = text.point - direction * TEXT_DISTANCE_SCALE * maxSize;
+
+    FontRasterizer::centerText(letters, text.scale);
+    FontRasterizer::placeText(letters, origin, direction, text.rotationDegrees);
+    commandManager.execute(std::make_unique<CmdPaintText>(ci::Ray(origin, direction), letters, text.color));
+}
+}  // namespace
+
+BatchScript BatchScript::parse(std::istream& is) {
+    BatchScript script;
+    std::string lineString;
+    size_t lineNumber = 0;
+    while(std::getline(is, lineString)) {
+        ++lineNumber;
+        std::istringstream line(lineString);
+        std::string command;
+        if(!(line >> command) || command[0] == '#') {
+            continue;
+        }
+
+        try {
+            if(command == "bucket") {
+                script.mSteps.emplace_back(parseBucketFill(line));
+            } else if(command == "segment") {
+                script.mSteps.emplace_back(parseSegmentation(line));
+            } else if(command == "text") {
+                script.mSteps.emplace_back(parseText(line));
+            } else {
+                throw std::runtime_error("unknown command " + command);
+            }
+        } catch(const std::runtime_error& e) {
+            throw std::runtime_error("Line " + std::to_string(lineNumber) + " of the script: " + e.what());
+        }
+    }
+    return script;
+}
+
+void BatchScript::apply(Geometry& geometry, CommandManager<Geometry>& commandManager,
+                        const std::function<void(size_t)>& afterStep) const {
+    for(size_t i = 0; i < mSteps.size(); ++i) {
+        const Step& step = mSteps[i];
+        if(const auto* fill = std::get_if<BucketFill>(&step)) {
+            applyBucketFill(geometry, commandManager, *fill);
+        } else if(const auto* segmentation = std::get_if<Segmentation>(&step)) {
+            applySegmentation(geometry, commandManager, *segmentation);
+        } else if(const auto* text = std::get_if<Text>(&step)) {
+            applyText(geometry, commandManager, *text);
+        }
+
+        if(afterStep) {
+            afterStep(i);
+        }
+    }
+}
+
+}  // namespace pepr3d
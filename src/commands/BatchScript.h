@@ -0,0 +1,77 @@
+#pragma once
+
+#include <functional>
+#include <glm/glm.hpp>
+#include <istream>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "commands/CommandManager.h"
+#include "geometry/Geometry.h"
+
+namespace pepr3d {
+
+/// Painting commands applied to a model without the application, e.g., by pepr3d_cli. The script has one command
+/// per line, colors are indices into the palette of the model and points are in the coordinates of the model:
+///
+///     # Comments start with #
+///     bucket <x> <y> <z> <color> [angle <degrees>] [whole]
+///     segment <clusters> <smoothing> <color>...
+///     text <x> <y> <z> <color> <font.ttf> "<text>" [size <font size>] [scale <scale>] [rotation <degrees>]
+///
+/// A bucket fill starts from the triangle closest to the point and stops on other colors like the Paint Bucket,
+/// on edges sharper than the angle if given, or nowhere with whole. A segmentation colors segment i with the
+/// i-th color, repeating the colors if there are more segments. A text is projected onto the model along the normal
+/// of the triangle closest to the point, like from the Text Editor.
+class BatchScript {
+   public:
+    struct BucketFill {
+        glm::vec3 seed{0.f};
+        size_t color = 0;
+
+        /// Also stop on the edges between triangles with normals further apart
+        std::optional<float> normalAngleDegrees;
+
+        /// Fill the whole connected component
+        bool isWhole = false;
+    };
+
+    struct Segmentation {
+        int numberOfClusters = 2;
+        float smoothingLambda = 0.5f;
+        std::vector<size_t> colors;
+    };
+
+    struct Text {
+        glm::vec3 point{0.f};
+        size_t color = 0;
+        std::string fontPath;
+        std::string text;
+        int fontSize = 12;
+        int bezierSteps = 3;
+        float scale = 0.2f;
+        float rotationDegrees = 0.f;
+    };
+
+    using Step = std::variant<BucketFill, Segmentation, Text>;
+
+    /// Throws std::runtime_error with the number of the line that cannot be parsed
+    static BatchScript parse(std::istream& is);
+
+    const std::vector<Step>& getSteps() const {
+        return mSteps;
+    }
+
+    /// Execute the steps in order through the CommandManager of the Geometry.
+    /// Throws std::runtime_error if a step cannot be applied to the model, e.g., its color is not in the palette.
+    /// @param afterStep Called after each step with its index, if set, e.g., to check the memory taken
+    void apply(Geometry& geometry, CommandManager<Geometry>& commandManager,
+               const std::function<void(size_t)>& afterStep = {}) const;
+
+   private:
+    std::vector<Step> mSteps;
+};
+
+}  // namespace pepr3d
@@ -0,0 +1,114 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "commands/BatchScript.h"
+#include "commands/CommandManager.h"
+#include "geometry/Geometry.h"
+
+namespace pepr3d {
+namespace {
+BatchScript parseScript(const std::string& text) {
+    std::istringstream is(text);
+    return BatchScript::parse(is);
+}
+
+/// Message of the exception thrown by parsing the text
+std::string getParseError(const std::string& text) {
+    try {
+        parseScript(text);
+    } catch(const std::runtime_error& e) {
+        return e.what();
+    }
+    return "";
+}
+}  // namespace
+
+TEST(BatchScript, parse) {
+    /**
+     * Test that all commands and their options are parsed, comments and empty lines are skipped
+     */
+
+    const BatchScript script = parseScript(
+        "# Coloring of a scan\n"
+        "\n"
+        "bucket 0 1.5 -2 1\n"
+        "  bucket 0 0 0 2 angle 30 whole\n"
+        "segment 4 0.3 1 2 3\n"
+        "text 1 2 3 2 fonts/OpenSans-Regular.ttf \"Pepr 3D\" size 24 scale 0.5 rotation 90\n");
+    ASSERT_EQ(script.getSteps().size(), 4);
+
+    const auto* fill = std::get_if<BatchScript::BucketFill>(&script.getSteps()[0]);
+    ASSERT_NE(fill, nullptr);
+    EXPECT_EQ(fill->seed, glm::vec3(0.f, 1.5f, -2.f));
+    EXPECT_EQ(fill->color, 1);
+    EXPECT_FALSE(fill->normalAngleDegrees);
+    EXPECT_FALSE(fill->isWhole);
+
+    fill = std::get_if<BatchScript::BucketFill>(&script.getSteps()[1]);
+    ASSERT_NE(fill, nullptr);
+    ASSERT_TRUE(fill->normalAngleDegrees);
+    EXPECT_FLOAT_EQ(*fill->normalAngleDegrees, 30.f);
+    EXPECT_TRUE(fill->isWhole);
+
+    const auto* segmentation = std::get_if<BatchScript::Segmentation>(&script.getSteps()[2]);
+    ASSERT_NE(segmentation, nullptr);
+    EXPECT_EQ(segmentation->numberOfClusters, 4);
+    EXPECT_FLOAT_EQ(segmentation->smoothingLambda, 0.3f);
+    EXPECT_EQ(segmentation->colors, (std::vector<size_t>{1, 2, 3}));
+
+    const auto* text = std::get_if<BatchScript::Text>(&script.getSteps()[3]);
+    ASSERT_NE(text, nullptr);
+    EXPECT_EQ(text->point, glm::vec3(1.f, 2.f, 3.f));
+    EXPECT_EQ(text->color, 2);
+    EXPECT_EQ(text->fontPath, "fonts/OpenSans-Regular.ttf");
+    EXPECT_EQ(text->text, "Pepr 3D");
+    EXPECT_EQ(text->fontSize, 24);
+    EXPECT_EQ(text->bezierSteps, 3);
+    EXPECT_FLOAT_EQ(text->scale, 0.5f);
+    EXPECT_FLOAT_EQ(text->rotationDegrees, 90.f);
+}
+
+TEST(BatchScript, parseErrors) {
+    /**
+     * Test that invalid lines are reported with their line number
+     */
+
+    EXPECT_EQ(getParseError("bucket 0 0 0 1\nfill 0 0 0 1\n"), "Line 2 of the script: unknown command fill");
+    EXPECT_EQ(getParseError("bucket 0 0 1\n"), "Line 1 of the script: expected the color");
+    EXPECT_EQ(getParseError("bucket 0 0 0 1 angel 30\n"), "Line 1 of the script: unknown option angel");
+    EXPECT_NE(getParseError("segment 1 0.5 1\n"), "");
+    EXPECT_NE(getParseError("segment 4 0 1\n"), "");
+    EXPECT_NE(getParseError("segment 4 0.5\n"), "");
+    EXPECT_NE(getParseError("segment 4 0.5 1 red\n"), "");
+    EXPECT_NE(getParseError("text 0 0 0 1 font.ttf\n"), "");
+    EXPECT_NE(getParseError("text 0 0 0 1 font.ttf Pepr3D size 0\n"), "");
+    EXPECT_EQ(getParseError("# bucket\n\n   \n"), "");
+}
+
+TEST(BatchScript, applyInvalidColor) {
+    /**
+     * Test that a step with a color out of the palette fails without painting
+     */
+
+    std::vector<DataTriangle> triangles;
+    triangles.emplace_back(glm::vec3(0, 0, 0), glm::vec3(1, 0, 0), glm::vec3(1, 1, 0), glm::vec3(0, 0, 1), 0);
+    Geometry geometry(std::move(triangles));
+    CommandManager<Geometry> commandManager(geometry);
+
+    const BatchScript script = parseScript("bucket 0 0 0 " + std::to_string(PEPR3D_MAX_PALETTE_COLORS) + "\n");
+    size_t appliedSteps = 0;
+    EXPECT_THROW(script.apply(geometry, commandManager, [&appliedSteps](size_t) { ++appliedSteps; }),
+                 std::runtime_error);
+    EXPECT_EQ(appliedSteps, 0);
+    EXPECT_FALSE(commandManager.canUndo());
+    EXPECT_EQ(geometry.getTriangleColor(0), 0);
+}
+
+}  // namespace pepr3d
+
+#endif
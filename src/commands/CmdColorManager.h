@@ -8,7 +8,7 @@
 
 namespace pepr3d {
 
-/// Command that changes a color in the palette
+/// Command that changes a color in the palette, colors are given by their palette positions in all these commands
 class CmdColorManagerChangeColor : public CommandBase<Geometry> {
    public:
     CmdColorManagerChangeColor(size_t colorIdx, glm::vec4 color)
@@ -18,9 +18,18 @@ class CmdColorManagerChangeColor : public CommandBase<Geometry> {
         return "Change a color in the palette";
     }
 
+    size_t getColorIdx() const {
+        return mColorIdx;
+    }
+
+    glm::vec4 getColor() const {
+        return mColor;
+    }
+
    protected:
     void run(Geometry& target) const override {
-        target.getColorManager().setColor(mColorIdx, mColor);
+        ColorManager& colorManager = target.getColorManager();
+        colorManager.setColor(colorManager.getColorIndexAt(mColorIdx), mColor);
     }
 
     bool joinCommand(const CommandBase& otherBase) override {
@@ -53,12 +62,22 @@ class CmdColorManagerSwapColors : public CommandBase<Geometry> {
         return "Swap 2 colors in the palette";
     }
 
+    size_t getColor1Idx() const {
+        return mColor1Idx;
+    }
+
+    size_t getColor2Idx() const {
+        return mColor2Idx;
+    }
+
    protected:
     void run(Geometry& target) const override {
         ColorManager& colorManager = target.getColorManager();
-        const glm::vec4 temp = colorManager.getColor(mColor1Idx);
-        colorManager.setColor(mColor1Idx, colorManager.getColor(mColor2Idx));
-        colorManager.setColor(mColor2Idx, temp);
+        const size_t color1Idx = colorManager.getColorIndexAt(mColor1Idx);
+        const size_t color2Idx = colorManager.getColorIndexAt(mColor2Idx);
+        const glm::vec4 temp = colorManager.getColor(color1Idx);
+        colorManager.setColor(color1Idx, colorManager.getColor(color2Idx));
+        colorManager.setColor(color2Idx, temp);
     }
 
     size_t mColor1Idx;
@@ -75,26 +94,18 @@ class CmdColorManagerReorderColors : public CommandBase<Geometry> {
         return "Reorder 2 colors in the palette";
     }
 
+    size_t getColor1Idx() const {
+        return mColor1Idx;
+    }
+
+    size_t getColor2Idx() const {
+        return mColor2Idx;
+    }
+
    protected:
     void run(Geometry& target) const override {
-        // the beginning is the same as in color swap:
-        ColorManager& colorManager = target.getColorManager();
-        const glm::vec4 temp = colorManager.getColor(mColor1Idx);
-        colorManager.setColor(mColor1Idx, colorManager.getColor(mColor2Idx));
-        colorManager.setColor(mColor2Idx, temp);
-
-        // unlike in color swap, we need to preserve model coloring, i.e., swap color IDs in the model:
-        const size_t color1Idx = mColor1Idx;  // Local copy to pass to lambda
-        const size_t color2Idx = mColor2Idx;
-        target.changeColorIds([color1Idx, color2Idx](size_t origColor) {
-            if(origColor == color1Idx) {
-                return color2Idx;
-            }
-            if(origColor == color2Idx) {
-                return color1Idx;
-            }
-            return origColor;
-        });
+        // Only the palette positions change, the model keeps its color indices
+        target.getColorManager().reorderColors(mColor1Idx, mColor2Idx);
     }
 
     size_t mColor1Idx;
@@ -110,52 +121,66 @@ class CmdColorManagerRemoveColor : public CommandBase<Geometry> {
         return "Remove a color from the palette";
     }
 
+    size_t getColorIdx() const {
+        return mColorIdx;
+    }
+
    protected:
     void run(Geometry& target) const override {
         ColorManager& colorManager = target.getColorManager();
         P_ASSERT(mColorIdx + 1 <= colorManager.size());
-        ColorManager::ColorMap& colorMap = colorManager.getColorMap();
-        colorMap.erase(colorMap.cbegin() + mColorIdx);
-        // replace the erased color in the model and shift remaining colors:
+        const size_t colorIdx = colorManager.getColorIndexAt(mColorIdx);
+        colorManager.removeColor(colorIdx);
         P_ASSERT(colorManager.size() > 0);
-        const size_t colorIdx = mColorIdx;  // Local copy for lambda
-        target.changeColorIds([colorIdx](size_t originalColor) {
+
+        // Replace the removed color in the model with the first one and shift the others,
+        // removing is the only palette change that rewrites the color indices of the model
+        const size_t firstColorIdx = colorManager.getColorIndexAt(0);
+        target.changeColorIds([colorIdx, firstColorIdx](size_t originalColor) {
             if(originalColor == colorIdx) {
-                return static_cast<size_t>(0);
+                return firstColorIdx;
             } else if(originalColor > colorIdx) {
                 return originalColor - 1;
             }
 
             return originalColor;
         });
-
-        // set new active (user selected) color:
-        if(colorManager.getActiveColorIndex() == mColorIdx) {
-            colorManager.setActiveColorIndex(0);
-        }
     }
 
     size_t mColorIdx;
 };
 
-/// Command that adds a new color to the palette
+/// Command that adds a new color to the palette, a random one unless it is given.
+/// The color is chosen once, so that redoing and replaying the command add the same color.
 class CmdColorManagerAddColor : public CommandBase<Geometry> {
    public:
-    CmdColorManagerAddColor() : CommandBase(false, false) {}
+    CmdColorManagerAddColor() : CmdColorManagerAddColor(getRandomColor()) {}
+
+    explicit CmdColorManagerAddColor(glm::vec4 color) : CommandBase(false, false), mColor(color) {}
 
     std::string_view getDescription() const override {
         return "Add a new color to the palette";
     }
 
+    glm::vec4 getColor() const {
+        return mColor;
+    }
+
    protected:
     void run(Geometry& target) const override {
         ColorManager& colorManager = target.getColorManager();
         P_ASSERT(colorManager.size() > 0);
+        colorManager.addColor(mColor);
+    }
+
+    static glm::vec4 getRandomColor() {
         std::random_device rd;   // Will be used to obtain a seed for the random number engine
         std::mt19937 gen(rd());  // Standard mersenne_twister_engine seeded with rd()
         std::uniform_real_distribution<> dis(0.0, 1.0);
-        colorManager.addColor(glm::vec4(dis(gen), dis(gen), dis(gen), 1.0f));
+        return glm::vec4(dis(gen), dis(gen), dis(gen), 1.0f);
     }
+
+    glm::vec4 mColor;
 };
 
 /// Command that resets all colors of the palette to the default 4 colors
@@ -170,7 +195,11 @@ class CmdColorManagerResetColors : public CommandBase<Geometry> {
    protected:
     void run(Geometry& target) const override {
         ColorManager& colorManager = target.getColorManager();
+        const size_t previousSize = colorManager.size();
         colorManager = ColorManager();
+        if(previousSize <= colorManager.size()) {
+            return;  // All color indices of the model are still in the palette
+        }
         const size_t maxColorId = colorManager.size() - 1;
         target.changeColorIds([maxColorId](size_t origColor) {
             if(origColor > maxColorId) {
@@ -2,12 +2,11 @@
 
 #include <vector>
 
+#include "Profiler.h"
 #include "commands/Command.h"
 #include "geometry/Geometry.h"
 #include "tools/Brush.h"
 
-#include <chrono>
-
 namespace pepr3d {
 
 /// Command that paints a stroke with a brush
@@ -24,14 +23,40 @@ class CmdPaintBrush : public CommandBase<Geometry> {
     CmdPaintBrush(ci::Ray ray, const BrushSettings settings)
         : CommandBase(true, true), mRays{ray}, mSettings(settings) {}
 
+    /// Paint all dabs of the rays at once
+    CmdPaintBrush(std::vector<ci::Ray> rays, const BrushSettings settings)
+        : CommandBase(true, true), mRays(std::move(rays)), mSettings(settings) {}
+
+    size_t getApproximateMemorySize() const override {
+        return mRays.capacity() * sizeof(ci::Ray);
+    }
+
+    bool canUndoByDelta() const override {
+        return true;
+    }
+
+    const std::vector<ci::Ray>& getRays() const {
+        return mRays;
+    }
+
+    const BrushSettings& getSettings() const {
+        return mSettings;
+    }
+
    protected:
     void run(Geometry& target) const override {
-        const auto start = std::chrono::high_resolution_clock::now();
+        const Profiler::ScopedTimer timer(Profiler::Zone::Painting);
 
-        for(const ci::Ray& ray : mRays) {
-            if(mSettings.spherical) {
-                target.paintAreaWithSphere(ray, mSettings);
-            } else {
+        if(mSettings.spherical) {
+            // Joined strokes are painted at once, each triangle detail is updated only once
+            target.paintAreaWithSpheres(mRays, mSettings);
+        } else {
+            // Shapes of the whole stroke are collected first and joined, each triangle detail is updated only once
+            std::vector<glm::vec3> directions;
+            std::vector<std::vector<Point3>> shapes;
+            directions.reserve(mRays.size());
+            shapes.reserve(mRays.size());
+            for(const ci::Ray& ray : mRays) {
                 glm::vec3 ro = ray.getOrigin();
                 glm::vec3 rd = ray.getDirection();
                 if(mSettings.alignToNormal) {
@@ -46,22 +71,27 @@ class CmdPaintBrush : public CommandBase<Geometry> {
                 // Create a shape to paint with
                 const Vector3 rayDirectionVector(rd.x, rd.y, rd.z);
                 const Circle circle(Point3(ro.x, ro.y, ro.z), mSettings.size * mSettings.size, rayDirectionVector);
-                const std::vector<Point3> circlePoints = GeometryUtils::pointsOnCircle(circle, mSettings.segments);
-
-                target.paintWithShape(ray, circlePoints, mSettings.color, mSettings.paintBackfaces);
+                directions.push_back(rd);
+                shapes.push_back(GeometryUtils::pointsOnCircle(circle, mSettings.segments));
             }
-        }
 
-        const auto end = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<double, std::milli> timeMs = end - start;
+            target.paintWithShapes(directions, shapes, mSettings.color, mSettings.paintBackfaces);
+        }
 
-        CI_LOG_I("Brush paint took " + std::to_string(timeMs.count()) + " ms");
+        CI_LOG_I("Brush paint took " + std::to_string(timer.getMilliseconds()) + " ms");
     }
 
     bool joinCommand(const CommandBase& otherBase) override {
         const auto* other = dynamic_cast<const CmdPaintBrush*>(&otherBase);
         if(other && other->mSettings == mSettings) {
-            mRays.insert(mRays.end(), other->mRays.begin(), other->mRays.end());
+            // A swept stroke continues from the last ray, which is joined only once
+            auto otherBegin = other->mRays.begin();
+            if(mSettings.sweptStroke && !mRays.empty() && otherBegin != other->mRays.end() &&
+               otherBegin->getOrigin() == mRays.back().getOrigin() &&
+               otherBegin->getDirection() == mRays.back().getDirection()) {
+                ++otherBegin;
+            }
+            mRays.insert(mRays.end(), otherBegin, other->mRays.end());
             return true;
         } else {
             return false;
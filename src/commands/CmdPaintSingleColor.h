@@ -2,6 +2,7 @@
 
 #include <vector>
 
+#include "Profiler.h"
 #include "commands/Command.h"
 #include "geometry/Geometry.h"
 
@@ -31,11 +32,40 @@ class CmdPaintSingleColor : public CommandBase<Geometry> {
         }
     }
 
+    size_t getApproximateMemorySize() const override {
+        return mTriangleIds.capacity() * sizeof(DetailedTriangleId);
+    }
+
+    bool canUndoByDelta() const override {
+        return true;
+    }
+
+    const std::vector<DetailedTriangleId>& getTriangleIds() const {
+        return mTriangleIds;
+    }
+
+    size_t getColorId() const {
+        return mColorId;
+    }
+
    protected:
     void run(Geometry& target) const override {
+        const Profiler::ScopedTimer timer(Profiler::Zone::Painting);
+        // Runs of whole base triangles are colored at once, detail triangles in between keep their order,
+        // since coloring their base triangle removes them
+        std::vector<size_t> baseTriangles;
         for(DetailedTriangleId triangleId : mTriangleIds) {
-            target.setTriangleColor(triangleId, mColorId);
+            if(triangleId.getDetailId()) {
+                target.setTriangleColors(std::move(baseTriangles), mColorId);
+                baseTriangles.clear();
+                target.setTriangleColor(triangleId, mColorId);
+            } else {
+                baseTriangles.push_back(triangleId.getBaseId());
+            }
         }
+        target.setTriangleColors(std::move(baseTriangles), mColorId);
+        // Only after all triangles are painted, the ids of detail triangles are valid until then
+        target.compactTriangleDetails();
     }
 
     bool joinCommand(const CommandBase& otherBase) override {
@@ -1,4 +1,5 @@
 #pragma once
+#include "Profiler.h"
 #include "geometry/Geometry.h"
 
 namespace pepr3d {
@@ -32,25 +33,45 @@ class CmdPaintText : public CommandBase<Geometry> {
         }
     }
 
-   protected:
-    void run(Geometry& target) const override {
-        const auto start = std::chrono::high_resolution_clock::now();
-
-        const size_t textLength = mText.size();
-        size_t progress = 0;
+    /// Paint the triangles of the letters, e.g., of a recorded text
+    CmdPaintText(ci::Ray ray, std::vector<std::vector<Triangle>> text, size_t color)
+        : CommandBase(true, false), mText(std::move(text)), mRay{ray}, mColor(color) {}
 
+    size_t getApproximateMemorySize() const override {
+        size_t memorySize = mText.capacity() * sizeof(std::vector<Triangle>);
         for(const std::vector<Triangle>& letter : mText) {
-            target.getProgress().paintTextPercentage = static_cast<float>(progress) / textLength;
-            target.paintWithShape(mRay, letter, mColor);
-            ++progress;
+            memorySize += letter.capacity() * sizeof(Triangle);
         }
+        return memorySize;
+    }
+
+    bool canUndoByDelta() const override {
+        return true;
+    }
+
+    const ci::Ray& getRay() const {
+        return mRay;
+    }
+
+    const std::vector<std::vector<Triangle>>& getText() const {
+        return mText;
+    }
+
+    size_t getColor() const {
+        return mColor;
+    }
+
+   protected:
+    void run(Geometry& target) const override {
+        const Profiler::ScopedTimer timer(Profiler::Zone::Painting);
 
-        const auto end = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<double, std::milli> timeMs = end - start;
+        // All letters at once, each triangle detail is painted only once
+        target.getProgress().paintTextPercentage = 0.0f;
+        target.paintWithText(mRay, mText, mColor);
 
         target.getProgress().paintTextPercentage = 1.0f;
 
-        CI_LOG_I("Text paint took " + std::to_string(timeMs.count()) + " ms");
+        CI_LOG_I("Text paint took " + std::to_string(timer.getMilliseconds()) + " ms");
     }
 
     std::vector<std::vector<Triangle>> mText;
@@ -32,6 +32,18 @@ class CommandBase {
         return mCanBeJoined;
     }
 
+    /// Rough estimate of the memory allocated by the command in bytes, besides the command object itself.
+    /// Commands keeping large data in the history should override this.
+    virtual size_t getApproximateMemorySize() const {
+        return 0;
+    }
+
+    /// Can the command be undone by restoring the state the target recorded while running it, instead of loading a
+    /// snapshot and replaying the commands after it. Only for commands changing nothing the target does not record.
+    virtual bool canUndoByDelta() const {
+        return false;
+    }
+
    protected:
     /// Run the command, applying the modifications to the target
     virtual void run(Target& target) const = 0;
@@ -0,0 +1,170 @@
+#include "commands/CommandJournal.h"
+
+#include <cinder/Log.h>
+#include <cstring>
+#include <stdexcept>
+
+namespace pepr3d {
+
+namespace {
+const char MAGIC[4] = {'P', '3', 'D', 'J'};
+
+/// Largest record read, to detect corrupted sizes before allocating them
+const uint32_t MAX_RECORD_SIZE = uint32_t(1) << 28;
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint64_t modelHash;
+};
+
+struct RecordHeader {
+    uint8_t type;
+    uint8_t reserved[3];
+    uint32_t size;
+
+    /// FNV-1a of the data of the record, to detect a record written only partially
+    uint32_t checksum;
+};
+static_assert(sizeof(Header) == 16 && sizeof(RecordHeader) == 12, "The headers are written without padding");
+
+uint32_t computeChecksum(const std::string& data) {
+    uint32_t hash = 2166136261u;
+    for(const char c : data) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+    return hash;
+}
+}  // namespace
+
+CommandJournal::CommandJournal(const std::string& path, const uint64_t modelHash)
+    : mFile(path, std::ios::binary | std::ios::trunc) {
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.modelHash = modelHash;
+    mFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    mFile.flush();
+    if(!mFile) {
+        throw std::runtime_error("Could not create the journal " + path);
+    }
+}
+
+void CommandJournal::onExecute(const CommandBase<Geometry>& command, const bool join) {
+    const SessionRecording::Entry entry = SessionRecording::createEntry(command, join);
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(entry.type == SessionRecording::EntryType::Skipped) {
+        CI_LOG_W("The journal cannot replay the command: " + entry.description);
+        mIsReplayable = false;
+    }
+    if(join && mUndoableCount == 0) {
+        // The checkpoint may end with the command this one joins, the replay starts a new command instead
+        mIsFirstCommandJoined = true;
+    }
+    if(!join || mUndoableCount == 0) {
+        ++mUndoableCount;
+    }
+    mRedoableCount = 0;
+    appendEntry(entry);
+}
+
+void CommandJournal::onUndo() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(mUndoableCount == 0 || (mUndoableCount == 1 && mIsFirstCommandJoined)) {
+        mIsReplayable = false;
+        return;
+    }
+    --mUndoableCount;
+    ++mRedoableCount;
+
+    SessionRecording::Entry entry;
+    entry.type = SessionRecording::EntryType::Undo;
+    entry.description = "Undo";
+    appendEntry(entry);
+}
+
+void CommandJournal::onRedo() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(mRedoableCount == 0) {
+        mIsReplayable = false;
+        return;
+    }
+    --mRedoableCount;
+    ++mUndoableCount;
+
+    SessionRecording::Entry entry;
+    entry.type = SessionRecording::EntryType::Redo;
+    entry.description = "Redo";
+    appendEntry(entry);
+}
+
+void CommandJournal::close(const bool isContinued) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(isContinued && mIsReplayable && mFile.is_open()) {
+        append(RecordType::Continued, std::string());
+    }
+    mFile.close();
+}
+
+void CommandJournal::appendEntry(const SessionRecording::Entry& entry) {
+    if(!mIsReplayable || !mFile.is_open()) {
+        return;
+    }
+    append(RecordType::Entry, SessionRecording::saveEntry(entry));
+    if(!mFile) {
+        CI_LOG_E("Could not write the journal, the commands are not journaled until the next checkpoint.");
+        mIsReplayable = false;
+        return;
+    }
+    ++mEntryCount;
+}
+
+void CommandJournal::append(const RecordType type, const std::string& data) {
+    RecordHeader header{};
+    header.type = static_cast<uint8_t>(type);
+    header.size = static_cast<uint32_t>(data.size());
+    header.checksum = computeChecksum(data);
+    mFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    mFile.write(data.data(), static_cast<std::streamsize>(data.size()));
+    mFile.flush();
+}
+
+CommandJournal::Contents CommandJournal::read(std::istream& is) {
+    Header header{};
+    if(!is.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+       std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("The file is not a journal.");
+    }
+    if(header.version != VERSION) {
+        throw std::runtime_error("Unsupported version " + std::to_string(header.version) + " of the journal.");
+    }
+
+    Contents contents;
+    contents.modelHash = header.modelHash;
+    RecordHeader recordHeader{};
+    while(is.read(reinterpret_cast<char*>(&recordHeader), sizeof(recordHeader))) {
+        if(recordHeader.size > MAX_RECORD_SIZE) {
+            break;
+        }
+        std::string data(recordHeader.size, '\0');
+        if(!is.read(&data[0], static_cast<std::streamsize>(data.size())) ||
+           computeChecksum(data) != recordHeader.checksum) {
+            break;  // Written only partially by a crash
+        }
+
+        if(recordHeader.type == static_cast<uint8_t>(RecordType::Continued)) {
+            contents.isContinued = true;
+            break;
+        } else if(recordHeader.type != static_cast<uint8_t>(RecordType::Entry)) {
+            break;
+        }
+        try {
+            contents.entries.push_back(SessionRecording::loadEntry(data));
+        } catch(const std::runtime_error&) {
+            break;
+        }
+    }
+    return contents;
+}
+
+}  // namespace pepr3d
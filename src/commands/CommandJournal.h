@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "commands/CommandManager.h"
+#include "commands/SessionRecording.h"
+#include "geometry/Geometry.h"
+
+namespace pepr3d {
+
+/// Append-only journal of the commands executed by a CommandManager<Geometry> after a checkpoint of the project,
+/// replayed on the checkpoint to recover from a crash, see Autosave. Each operation is appended as a record of its
+/// SessionRecording::Entry and flushed, which is a few hundred bytes instead of writing the whole project.
+/// A crash while appending leaves an incomplete last record, which read() ignores.
+/// Commands may be executed on a worker thread during slow operations, so the journal is guarded.
+class CommandJournal : public CommandManager<Geometry>::Observer {
+   public:
+    /// Version of the journal, written after the magic bytes
+    static const uint32_t VERSION = 1;
+
+    /// Journal read by read()
+    struct Contents {
+        /// Geometry::getModelHash() of the model of the checkpoint
+        uint64_t modelHash = 0;
+
+        std::vector<SessionRecording::Entry> entries;
+
+        /// Closed by close(true), the commands continue in the journal of the next checkpoint
+        bool isContinued = false;
+    };
+
+    /// Creates the journal, replacing the file. Throws std::runtime_error if it cannot be written.
+    /// @param modelHash Geometry::getModelHash() of the model of the checkpoint
+    CommandJournal(const std::string& path, uint64_t modelHash);
+
+    void onExecute(const CommandBase<Geometry>& command, bool join) override;
+
+    void onUndo() override;
+
+    void onRedo() override;
+
+    /// Do the records replay all commands since the checkpoint. An undo of a command before the checkpoint, a redo
+    /// of a command undone before it, or a command that is not recorded cannot be replayed. Nothing is written from
+    /// then on and a new checkpoint is needed.
+    bool isReplayable() const {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mIsReplayable;
+    }
+
+    /// Number of the entries written
+    size_t getEntryCount() const {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mEntryCount;
+    }
+
+    /// Stops writing the journal
+    /// @param isContinued The journal of the next checkpoint continues this one, only if it is replayable
+    void close(bool isContinued);
+
+    /// Reads a journal written by CommandJournal up to its first incomplete or damaged record.
+    /// Throws std::runtime_error if it is not a journal.
+    static Contents read(std::istream& is);
+
+   private:
+    enum class RecordType : uint8_t { Entry = 1, Continued = 2 };
+
+    /// Appends the record and flushes it, the mutex must be locked
+    void append(RecordType type, const std::string& data);
+
+    /// Appends the entry if the journal is still replayable, the mutex must be locked
+    void appendEntry(const SessionRecording::Entry& entry);
+
+    mutable std::mutex mMutex;
+    std::ofstream mFile;
+    bool mIsReplayable = true;
+    size_t mEntryCount = 0;
+
+    /// Commands the replay can undo and redo, each of them executed after the checkpoint. Commands executed with join
+    /// are not counted, as they are joined only if the last command accepts them, so the replay may have more.
+    size_t mUndoableCount = 0;
+    size_t mRedoableCount = 0;
+
+    /// The first command of the replay may have been joined into a command before the checkpoint, undoing it would
+    /// undo the older one too
+    bool mIsFirstCommandJoined = false;
+};
+
+}  // namespace pepr3d
@@ -0,0 +1,130 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <cinder/Filesystem.h>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "commands/CmdColorManager.h"
+#include "commands/CmdPaintSingleColor.h"
+#include "commands/CommandJournal.h"
+#include "commands/CommandManager.h"
+#include "geometry/Geometry.h"
+#include "geometry/TestGeometries.h"
+
+namespace pepr3d {
+namespace {
+std::string readFile(const ci::fs::path& path) {
+    std::ifstream is(path.string(), std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+}
+}  // namespace
+
+TEST(CommandJournal, replay) {
+    /**
+     * Test that the journal replays the commands, undos and redos to the same state, also when it ends with a record
+     * written only partially
+     */
+
+    const ci::fs::path path = ci::fs::temp_directory_path() / "pepr3d_test.journal";
+    Geometry geometry(test::getGeometryWithSquare());
+    CommandManager<Geometry> commandManager(geometry);
+    {
+        CommandJournal journal(path.string(), geometry.getModelHash());
+        commandManager.addObserver(&journal);
+        commandManager.execute(std::make_unique<CmdPaintSingleColor>(size_t(0), 1));
+        commandManager.execute(std::make_unique<CmdPaintSingleColor>(size_t(1), 2), true);
+        commandManager.execute(std::make_unique<CmdColorManagerChangeColor>(0, glm::vec4(1.f)));
+        commandManager.execute(std::make_unique<CmdColorManagerAddColor>());
+        commandManager.undo();
+        commandManager.undo();
+        commandManager.redo();
+        commandManager.removeObserver(&journal);
+        EXPECT_TRUE(journal.isReplayable());
+        EXPECT_EQ(journal.getEntryCount(), 7);
+        journal.close(true);
+    }
+
+    const std::string bytes = readFile(path);
+    std::remove(path.string().c_str());
+    std::istringstream is(bytes, std::ios::binary);
+    const CommandJournal::Contents contents = CommandJournal::read(is);
+    EXPECT_EQ(contents.modelHash, geometry.getModelHash());
+    EXPECT_TRUE(contents.isContinued);
+    ASSERT_EQ(contents.entries.size(), 7);
+    EXPECT_EQ(contents.entries[3].type, SessionRecording::EntryType::AddColor);
+    EXPECT_EQ(contents.entries[5].type, SessionRecording::EntryType::Undo);
+
+    Geometry replayedGeometry(test::getGeometryWithSquare());
+    CommandManager<Geometry> replayedCommandManager(replayedGeometry);
+    for(const SessionRecording::Entry& entry : contents.entries) {
+        SessionRecording::applyEntry(entry, replayedCommandManager);
+    }
+    EXPECT_EQ(replayedGeometry.getTriangleColor(0), geometry.getTriangleColor(0));
+    EXPECT_EQ(replayedGeometry.getTriangleColor(1), geometry.getTriangleColor(1));
+    EXPECT_EQ(replayedGeometry.getColorManager().size(), geometry.getColorManager().size());
+    EXPECT_EQ(replayedGeometry.getColorManager().getColor(0), glm::vec4(1.f));
+
+    // A crash while appending the last entry, without the record of the next journal
+    std::istringstream truncated(bytes.substr(0, bytes.size() - 13), std::ios::binary);
+    const CommandJournal::Contents truncatedContents = CommandJournal::read(truncated);
+    EXPECT_FALSE(truncatedContents.isContinued);
+    EXPECT_EQ(truncatedContents.entries.size(), 6);
+
+    std::istringstream notJournal("P3DC", std::ios::binary);
+    EXPECT_THROW(CommandJournal::read(notJournal), std::runtime_error);
+}
+
+TEST(CommandJournal, historyBeforeCheckpoint) {
+    /**
+     * Test that undoing a command before the checkpoint or redoing a command undone before it stops the journal
+     */
+
+    const ci::fs::path path = ci::fs::temp_directory_path() / "pepr3d_test_history.journal";
+    Geometry geometry(test::getGeometryWithSquare());
+    CommandManager<Geometry> commandManager(geometry);
+    commandManager.execute(std::make_unique<CmdPaintSingleColor>(size_t(0), 1));
+    {
+        CommandJournal journal(path.string(), geometry.getModelHash());
+        commandManager.addObserver(&journal);
+
+        // May be joined into the command before the checkpoint
+        commandManager.execute(std::make_unique<CmdPaintSingleColor>(size_t(1), 1), true);
+        commandManager.execute(std::make_unique<CmdPaintSingleColor>(size_t(0), 2));
+        commandManager.undo();
+        EXPECT_TRUE(journal.isReplayable());
+        commandManager.undo();
+        EXPECT_FALSE(journal.isReplayable());
+        EXPECT_EQ(journal.getEntryCount(), 3);
+
+        commandManager.execute(std::make_unique<CmdPaintSingleColor>(size_t(0), 3));
+        EXPECT_EQ(journal.getEntryCount(), 3);
+        commandManager.removeObserver(&journal);
+        journal.close(true);
+    }
+    {
+        std::ifstream is(path.string(), std::ios::binary);
+        EXPECT_FALSE(CommandJournal::read(is).isContinued);
+    }
+
+    commandManager.undo();
+    {
+        CommandJournal journal(path.string(), geometry.getModelHash());
+        commandManager.addObserver(&journal);
+        commandManager.redo();
+        EXPECT_FALSE(journal.isReplayable());
+        EXPECT_EQ(journal.getEntryCount(), 0);
+        commandManager.removeObserver(&journal);
+        journal.close(false);
+    }
+    std::remove(path.string().c_str());
+}
+
+}  // namespace pepr3d
+
+#endif
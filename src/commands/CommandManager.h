@@ -1,8 +1,16 @@
 #pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <stdexcept>
 #include <type_traits>
 #include <vector>
+#include "Profiler.h"
 #include "commands/Command.h"
 #include "peprassert.h"
 
@@ -11,6 +19,14 @@ namespace pepr3d {
 /// CommandManager handles all undoable operations on target in the form of commands See @see
 /// CommandBase. All commands must be executed via the CommandManager Requirements for Target: Target
 /// must have a saveState() and loadState(State) methods
+/// Target can have a getStateMemorySize(const State&) method returning the approximate size of a snapshot in bytes,
+/// otherwise the size of the State type is used.
+/// Target can also record the inverse of the commands that can be undone by it, see CommandBase::canUndoByDelta(),
+/// with beginDelta(Delta), Delta endDelta(), undoDelta(const Delta&) and getDeltaMemorySize(const Delta&) methods,
+/// Delta::empty() tells that nothing was changed. Such commands are undone in the time of their changes, without
+/// loading a snapshot and replaying.
+/// Target can also compress the snapshots far from the current position with a std::future<State>
+/// compressState(const State&) method, e.g., on a worker thread. loadState() must accept the compressed states.
 template <typename Target>
 class CommandManager {
    public:
@@ -20,18 +36,156 @@ class CommandManager {
     /// How often snapshots of the target should be saved (at minimum)
     static const int SNAPSHOT_FREQUENCY = 10;
 
+    /// Default memory budget for snapshots in bytes
+    static const size_t DEFAULT_MEMORY_BUDGET = size_t(512) * 1024 * 1024;
+
+    /// Replaying a slow command costs as much as replaying this many regular commands
+    static const size_t SLOW_COMMAND_REPLAY_COST = SNAPSHOT_FREQUENCY;
+
+    /// Maximum number of snapshots waiting for finalizeSnapshots(), execute() finalizes them itself above this
+    static const size_t MAX_PENDING_SNAPSHOTS = 2;
+
+    /// Default number of commands that can be undone, older ones are discarded
+    static const size_t DEFAULT_HISTORY_DEPTH = 1000;
+
+    /// Default distance in commands from the current position, past which snapshots get compressed
+    static const size_t DEFAULT_COLD_SNAPSHOT_DISTANCE = 3 * SNAPSHOT_FREQUENCY;
+
+    /// Notified of the operations of the command manager, e.g., to record them
+    class Observer {
+       public:
+        virtual ~Observer() = default;
+
+        /// Called before the command is executed or joined into the last one
+        virtual void onExecute(const CommandBaseType& command, bool join) = 0;
+
+        /// Called before a command is undone
+        virtual void onUndo() = 0;
+
+        /// Called before a command is redone
+        virtual void onRedo() = 0;
+    };
+
     /// Create a command manager that will be operating around a snapshottable target
     explicit CommandManager(Target& target) : mTarget(target) {}
 
+    /// Add an observer of the operations, notified in the order they were added.
+    /// It must outlive the command manager or be removed.
+    void addObserver(Observer* observer) {
+        P_ASSERT(observer != nullptr);
+        P_ASSERT(std::find(mObservers.begin(), mObservers.end(), observer) == mObservers.end());
+        mObservers.push_back(observer);
+    }
+
+    /// Remove an observer added by addObserver(), does nothing if it is not an observer
+    void removeObserver(Observer* observer) {
+        mObservers.erase(std::remove(mObservers.begin(), mObservers.end(), observer), mObservers.end());
+    }
+
+    /// Set memory budget for snapshots in bytes, 0 means unlimited.
+    /// When snapshots exceed the budget, intermediate snapshots are removed and undo has to replay more commands.
+    /// The first snapshot and the latest one are always kept, so the budget may still be exceeded.
+    void setMemoryBudget(size_t bytes) {
+        mMemoryBudget = bytes;
+        finalizeSnapshots();
+        enforceMemoryBudget();
+    }
+
+    size_t getMemoryBudget() const {
+        return mMemoryBudget;
+    }
+
+    /// Set the number of commands that can be undone at least, 0 means unlimited.
+    /// Past the depth, the oldest commands are discarded once a snapshot after them is saved, the snapshot becomes
+    /// the base of the history. Undo usually reaches up to SNAPSHOT_FREQUENCY commands deeper.
+    void setHistoryDepth(size_t commandCount) {
+        mHistoryDepth = commandCount;
+        compactHistory();
+    }
+
+    size_t getHistoryDepth() const {
+        return mHistoryDepth;
+    }
+
+    /// Set the distance in commands from the current position, past which snapshots are compressed by
+    /// finalizeSnapshots() if the target supports it, 0 means they are never compressed.
+    void setColdSnapshotDistance(size_t commandCount) {
+        mColdSnapshotDistance = commandCount;
+    }
+
+    size_t getColdSnapshotDistance() const {
+        return mColdSnapshotDistance;
+    }
+
+    /// Number of snapshots compressed by the target, including the ones still being compressed
+    size_t getCompressedSnapshotCount() const {
+        return static_cast<size_t>(std::count_if(mTargetSnapshots.begin(), mTargetSnapshots.end(),
+                                                 [](const SnapshotPair& snapshot) { return snapshot.isCompressed; }));
+    }
+
+    /// Approximate memory taken by all finalized snapshots in bytes
+    size_t getSnapshotMemorySize() const;
+
+    /// Approximate memory taken by the executed and redoable commands in bytes
+    size_t getHistoryMemorySize() const;
+
+    /// Number of executed and redoable commands
+    size_t getHistorySize() const {
+        return mCommandHistory.size();
+    }
+
+    /// Measure the snapshots saved since the last call and remove snapshots over the memory budget.
+    /// Starts the compression of cold snapshots and replaces the snapshots whose compression finished.
+    /// execute() only captures the state of the target, call this when idle to keep the bookkeeping off the
+    /// critical path. Must not be called while a command is being executed, undone or redone.
+    void finalizeSnapshots();
+
+    /// Number of stored snapshots of the target
+    size_t getSnapshotCount() const {
+        return mTargetSnapshots.size();
+    }
+
     /// Execute a command, saving it into a history and removing all currently redoable commands.
     /// @param join Try to join this command into the last one
     void execute(std::unique_ptr<CommandBaseType>&& command, bool join = false);
 
+    /// Creates the command of a stroke once it ends, see beginStroke()
+    using StrokeCommandFactory = std::function<std::unique_ptr<CommandBaseType>()>;
+
+    /// Begin a stroke, many small changes made by the caller directly on the target that are saved as a single
+    /// command once the stroke ends, e.g., the triangles painted while dragging the mouse.
+    /// The changes are recorded as the delta of the command, so they only have to patch the target, without a command
+    /// or an observer notification for each of them. A stroke recording no change saves no command and keeps the
+    /// commands to redo.
+    /// @param createCommand Called when the stroke ends, the command it returns must make the same changes when it is
+    /// replayed. It is saved into the history without running it.
+    void beginStroke(StrokeCommandFactory createCommand);
+
+    /// Is a stroke being made, nothing but the stroke may change the target until endStroke()
+    bool isStrokeInProgress() const {
+        return static_cast<bool>(mStrokeCommandFactory);
+    }
+
+    /// End the stroke, saving its command into the history. Observers are notified of the command here.
+    /// Executing, undoing or redoing a command ends the stroke first.
+    void endStroke();
+
     /// Undo a single command operation
-    void undo();
+    void undo() {
+        undo(1);
+    }
+
+    /// Undo count commands at once (as many as possible), replaying the commands only up to the final state
+    void undo(size_t count);
 
     /// Redo a single command (if possible)
-    void redo();
+    void redo() {
+        redo(1);
+    }
+
+    /// Redo count commands at once (as many as possible), loading a later snapshot when it is cheaper than running
+    /// the commands
+    void redo(size_t count);
 
     /// Is there a command that can be undoed? @see getLastCommand()
     bool canUndo() const;
@@ -51,14 +205,49 @@ class CommandManager {
     }
 
    private:
+    template <typename T, typename = void>
+    struct DeltaTraits {
+        using Type = std::nullptr_t;
+        static constexpr bool isSupported = false;
+    };
+
+    template <typename T>
+    struct DeltaTraits<T, std::void_t<decltype(std::declval<T&>().endDelta())>> {
+        using Type = decltype(std::declval<T&>().endDelta());
+        static constexpr bool isSupported = true;
+    };
+
+    using DeltaType = typename DeltaTraits<Target>::Type;
+
+    template <typename T, typename = void>
+    struct CompressionTraits {
+        static constexpr bool isSupported = false;
+    };
+
+    template <typename T>
+    struct CompressionTraits<T, std::void_t<decltype(std::declval<T&>().compressState(std::declval<StateType>()))>> {
+        static constexpr bool isSupported = true;
+    };
+
     Target& mTarget;
     /// Executed and possibly future commands
     std::vector<std::unique_ptr<CommandBaseType>> mCommandHistory;
 
+    /// Inverse of each command of mCommandHistory recorded by the target, empty for commands that do not support it
+    std::vector<std::optional<DeltaType>> mCommandDeltas;
+
     /// Saved states of the target and commandId after them
     struct SnapshotPair {
         StateType state;
         size_t nextCommandIdx;
+        /// Approximate size of the state in bytes, empty until the snapshot is finalized
+        std::optional<size_t> memorySize;
+
+        /// The state is compressed, or its compressed copy is being made
+        bool isCompressed = false;
+
+        /// Compressed copy of the state being made by the target, it replaces the state once it is ready
+        std::future<StateType> compressedState;
     };
 
     std::vector<SnapshotPair> mTargetSnapshots;
@@ -69,6 +258,68 @@ class CommandManager {
     /// Cumulative version number which gets incremented every single time a command is executed or Undo/Redo is done
     size_t mVersion = 0;
 
+    /// Memory budget for snapshots in bytes, 0 means unlimited
+    size_t mMemoryBudget = DEFAULT_MEMORY_BUDGET;
+
+    /// Number of commands that can be undone at least, 0 means unlimited
+    size_t mHistoryDepth = DEFAULT_HISTORY_DEPTH;
+
+    /// Distance from the current position past which snapshots get compressed, 0 means never
+    size_t mColdSnapshotDistance = DEFAULT_COLD_SNAPSHOT_DISTANCE;
+
+    std::vector<Observer*> mObservers;
+
+    /// Command of the stroke in progress, empty if there is none
+    StrokeCommandFactory mStrokeCommandFactory;
+
+    /// State of the target before the stroke in progress, saved as a snapshot if the stroke changes anything
+    std::optional<StateType> mStrokeState;
+
+    /// Save the current state of the target as a snapshot before the next command
+    void saveSnapshot() {
+        saveSnapshot(mTarget.saveState());
+    }
+
+    /// Save the state as the snapshot before the next command
+    void saveSnapshot(StateType state);
+
+    /// Run the command, recording its inverse if both the command and the target support it
+    /// @param delta Inverse of the command it is joined to, extended by this command
+    std::optional<DeltaType> runRecorded(const CommandBaseType& command, std::optional<DeltaType>&& delta);
+
+    /// Can all commands [beginIdx, endIdx) be undone by their deltas
+    bool hasDeltas(size_t beginIdx, size_t endIdx) const;
+
+    /// Remove intermediate snapshots until they fit into the memory budget, all snapshots must be finalized
+    void enforceMemoryBudget();
+
+    /// Discard the commands before the latest snapshot that leaves mHistoryDepth commands to undo
+    void compactHistory();
+
+    /// Measure the snapshots saved since the last finalization, returns true if there were any
+    bool measurePendingSnapshots();
+
+    /// Start compressing the snapshots further than mColdSnapshotDistance, and replace the snapshots whose compressed
+    /// copy is ready. Returns true if a snapshot was replaced, all snapshots must be finalized.
+    bool compressColdSnapshots();
+
+    /// Cost of replaying commands [beginIdx, endIdx) after loading a snapshot
+    size_t getReplayCost(size_t beginIdx, size_t endIdx) const;
+
+    /// Bring the target to the state with posFromEnd, from the last snapshot before it or from the current state
+    void moveInHistory(size_t posFromEnd);
+
+    template <typename T>
+    static auto getStateMemorySize(const T& target, const StateType& state, int)
+        -> decltype(target.getStateMemorySize(state)) {
+        return target.getStateMemorySize(state);
+    }
+
+    template <typename T>
+    static size_t getStateMemorySize(const T&, const StateType&, long) {
+        return sizeof(StateType);
+    }
+
     void clearFutureState();
 
     /// Get snapshot before current state
@@ -107,6 +358,13 @@ auto CommandManager<Target>::getPrevSnapshotIterator() const
 
 template <typename Target>
 void CommandManager<Target>::execute(std::unique_ptr<CommandBaseType>&& command, bool join) {
+    if(isStrokeInProgress()) {
+        endStroke();
+    }
+    const Profiler::TraceScope traceScope("Command", command->getDescription());
+    for(Observer* observer : mObservers) {
+        observer->onExecute(*command, join);
+    }
     clearFutureState();
 
     // Increment the version counter
@@ -116,58 +374,177 @@ void CommandManager<Target>::execute(std::unique_ptr<CommandBaseType>&& command,
     if(!join || !joinWithLastCommand(*command)) {
         // Save target's state every few commands
         if(shouldSaveState()) {
-            const size_t nextCommandIdx = mCommandHistory.size() - mPosFromEnd;
-            mTargetSnapshots.push_back({mTarget.saveState(), nextCommandIdx});
+            saveSnapshot();
         }
 
-        command->run(mTarget);
+        std::optional<DeltaType> delta = runRecorded(*command, std::nullopt);
         mCommandHistory.emplace_back(std::move(command));
+        mCommandDeltas.emplace_back(std::move(delta));
+        compactHistory();
+    } else if(mCommandDeltas.back()) {
+        // Joined commands are undone together, the delta keeps the state from before the first one
+        mCommandDeltas.back() = runRecorded(*command, std::move(mCommandDeltas.back()));
     } else {
         command->run(mTarget);
     }
 }
 
 template <typename Target>
-void CommandManager<Target>::undo() {
-    if(!canUndo())
-        return;
+void CommandManager<Target>::beginStroke(StrokeCommandFactory createCommand) {
+    P_ASSERT(createCommand);
+    if(isStrokeInProgress()) {
+        endStroke();
+    }
+    // The future commands are only cleared once the stroke changes something, the state is kept until then
+    P_ASSERT(!mStrokeState);
+    if(shouldSaveState()) {
+        mStrokeState = mTarget.saveState();
+    }
+    if constexpr(DeltaTraits<Target>::isSupported) {
+        mTarget.beginDelta(DeltaType{});
+    }
+    mStrokeCommandFactory = std::move(createCommand);
+}
 
-    // Increment the version counter
+template <typename Target>
+void CommandManager<Target>::endStroke() {
+    P_ASSERT(isStrokeInProgress());
+    const StrokeCommandFactory createCommand = std::move(mStrokeCommandFactory);
+    mStrokeCommandFactory = nullptr;
+
+    // The command may still change the target, e.g., to finish the changes at once
+    std::unique_ptr<CommandBaseType> command = createCommand();
+    P_ASSERT(command != nullptr);
+    std::optional<DeltaType> delta;
+    if constexpr(DeltaTraits<Target>::isSupported) {
+        DeltaType recordedDelta = mTarget.endDelta();
+        if(recordedDelta.empty()) {
+            // Nothing was changed, e.g., a click outside of the model, the history stays as it was
+            mStrokeState.reset();
+            return;
+        }
+        if(command->canUndoByDelta()) {
+            delta = std::move(recordedDelta);
+        }
+    }
+
+    clearFutureState();
+    if(mStrokeState) {
+        saveSnapshot(std::move(*mStrokeState));
+        mStrokeState.reset();
+    }
+
+    const Profiler::TraceScope traceScope("Command", command->getDescription());
+    for(Observer* observer : mObservers) {
+        observer->onExecute(*command, false);
+    }
     mVersion++;
+    mCommandHistory.emplace_back(std::move(command));
+    mCommandDeltas.emplace_back(std::move(delta));
+    compactHistory();
+}
 
-    mPosFromEnd++;
-    auto prevSnapshotIt = getPrevSnapshotIterator();
-    mTarget.loadState(prevSnapshotIt->state);
+template <typename Target>
+auto CommandManager<Target>::runRecorded(const CommandBaseType& command, std::optional<DeltaType>&& delta)
+    -> std::optional<DeltaType> {
+    if constexpr(DeltaTraits<Target>::isSupported) {
+        if(command.canUndoByDelta()) {
+            mTarget.beginDelta(delta ? std::move(*delta) : DeltaType{});
+            try {
+                command.run(mTarget);
+            } catch(...) {
+                mTarget.endDelta();
+                throw;
+            }
+            return mTarget.endDelta();
+        }
+    }
+    command.run(mTarget);
+    return std::nullopt;
+}
 
-    // Execute all commands between last snapshot and desired state
-    for(size_t i = prevSnapshotIt->nextCommandIdx; i < mCommandHistory.size() - mPosFromEnd; i++) {
-        mCommandHistory[i]->run(mTarget);
+template <typename Target>
+bool CommandManager<Target>::hasDeltas(size_t beginIdx, size_t endIdx) const {
+    P_ASSERT(beginIdx <= endIdx && endIdx <= mCommandDeltas.size());
+    return std::all_of(mCommandDeltas.begin() + beginIdx, mCommandDeltas.begin() + endIdx,
+                       [](const std::optional<DeltaType>& delta) { return delta.has_value(); });
+}
+
+template <typename Target>
+void CommandManager<Target>::undo(size_t count) {
+    if(isStrokeInProgress()) {
+        endStroke();
     }
+    count = std::min(count, mCommandHistory.size() - mPosFromEnd);
+    if(count == 0)
+        return;
+    const Profiler::TraceScope traceScope("Command", "Undo");
+    for(Observer* observer : mObservers) {
+        for(size_t i = 0; i < count; ++i) {
+            observer->onUndo();
+        }
+    }
+
+    // Increment the version counter
+    mVersion += count;
+
+    moveInHistory(mPosFromEnd + count);
 }
 
 template <typename Target>
-void CommandManager<Target>::redo() {
-    if(!canRedo())
+void CommandManager<Target>::redo(size_t count) {
+    if(isStrokeInProgress()) {
+        endStroke();
+    }
+    count = std::min(count, mPosFromEnd);
+    if(count == 0)
         return;
+    const Profiler::TraceScope traceScope("Command", "Redo");
+    for(Observer* observer : mObservers) {
+        for(size_t i = 0; i < count; ++i) {
+            observer->onRedo();
+        }
+    }
 
     // Increment the version counter
-    mVersion++;
+    mVersion += count;
 
-    const size_t nextCommandIdx = mCommandHistory.size() - mPosFromEnd;
-    if(mCommandHistory[nextCommandIdx]->isSlowCommand()) {
-        // Try to restore future snapshot to avoid doing a slow command again
-        auto nextSnapshotIt = std::next(getPrevSnapshotIterator());
-        if(nextSnapshotIt != mTargetSnapshots.end()) {
-            mTarget.loadState(nextSnapshotIt->state);
-        } else {
-            mCommandHistory[nextCommandIdx]->run(mTarget);
+    moveInHistory(mPosFromEnd - count);
+}
+
+template <typename Target>
+void CommandManager<Target>::moveInHistory(size_t posFromEnd) {
+    P_ASSERT(posFromEnd <= mCommandHistory.size());
+    const size_t currentIdx = mCommandHistory.size() - mPosFromEnd;
+    mPosFromEnd = posFromEnd;
+    const size_t targetIdx = mCommandHistory.size() - mPosFromEnd;
+
+    if constexpr(DeltaTraits<Target>::isSupported) {
+        // Undo the changes of the commands in reverse order, the snapshots stay valid for the other commands
+        if(targetIdx < currentIdx && hasDeltas(targetIdx, currentIdx)) {
+            const Profiler::TraceScope deltaTraceScope("Command", "Undo deltas");
+            for(size_t i = currentIdx; i > targetIdx; --i) {
+                mTarget.undoDelta(*mCommandDeltas[i - 1]);
+            }
+            return;
         }
+    }
 
-    } else {
-        mCommandHistory[nextCommandIdx]->run(mTarget);
+    // Going back always needs a snapshot, going forward only loads one to skip commands, e.g., a slow one
+    auto prevSnapshotIt = getPrevSnapshotIterator();
+    size_t replayIdx = currentIdx;
+    if(targetIdx < currentIdx ||
+       getReplayCost(prevSnapshotIt->nextCommandIdx, targetIdx) + 1 < getReplayCost(currentIdx, targetIdx)) {
+        const Profiler::TraceScope loadTraceScope("Command", "Load snapshot");
+        mTarget.loadState(prevSnapshotIt->state);
+        replayIdx = prevSnapshotIt->nextCommandIdx;
     }
 
-    mPosFromEnd--;
+    // Execute all commands between the loaded state and desired state, recording the deltas of this run again
+    for(size_t i = replayIdx; i < targetIdx; i++) {
+        const Profiler::TraceScope replayTraceScope("Replay", mCommandHistory[i]->getDescription());
+        mCommandDeltas[i] = runRecorded(*mCommandHistory[i], std::nullopt);
+    }
 }
 
 template <typename Target>
@@ -206,6 +583,7 @@ void CommandManager<Target>::clearFutureState() {
 
         // Clear all future commands
         mCommandHistory.erase(std::prev(mCommandHistory.end(), mPosFromEnd), mCommandHistory.end());
+        mCommandDeltas.erase(std::prev(mCommandDeltas.end(), mPosFromEnd), mCommandDeltas.end());
 
         mPosFromEnd = 0;
     }
@@ -239,6 +617,162 @@ bool CommandManager<Target>::joinWithLastCommand(CommandBaseType& command) {
     }
 }
 
+template <typename Target>
+size_t CommandManager<Target>::getSnapshotMemorySize() const {
+    size_t memorySize = 0;
+    for(const SnapshotPair& snapshot : mTargetSnapshots) {
+        memorySize += snapshot.memorySize.value_or(0);
+    }
+    return memorySize;
+}
+
+template <typename Target>
+size_t CommandManager<Target>::getHistoryMemorySize() const {
+    // The size of the derived command objects is not known, they are estimated by the size of the base
+    size_t memorySize = mCommandHistory.capacity() * sizeof(std::unique_ptr<CommandBaseType>);
+    for(const auto& command : mCommandHistory) {
+        memorySize += sizeof(CommandBaseType) + command->getApproximateMemorySize();
+    }
+    if constexpr(DeltaTraits<Target>::isSupported) {
+        memorySize += mCommandDeltas.capacity() * sizeof(std::optional<DeltaType>);
+        for(const std::optional<DeltaType>& delta : mCommandDeltas) {
+            if(delta) {
+                memorySize += static_cast<size_t>(mTarget.getDeltaMemorySize(*delta));
+            }
+        }
+    }
+    return memorySize;
+}
+
+template <typename Target>
+void CommandManager<Target>::finalizeSnapshots() {
+    bool anyFinalized = measurePendingSnapshots();
+    if constexpr(CompressionTraits<Target>::isSupported) {
+        anyFinalized |= compressColdSnapshots();
+    }
+
+    if(anyFinalized) {
+        enforceMemoryBudget();
+    }
+}
+
+template <typename Target>
+bool CommandManager<Target>::measurePendingSnapshots() {
+    // Snapshots are finalized in order, so the pending ones are at the end
+    bool anyFinalized = false;
+    for(auto it = mTargetSnapshots.rbegin(); it != mTargetSnapshots.rend() && !it->memorySize; ++it) {
+        it->memorySize = static_cast<size_t>(getStateMemorySize(mTarget, it->state, 0));
+        anyFinalized = true;
+    }
+    return anyFinalized;
+}
+
+template <typename Target>
+bool CommandManager<Target>::compressColdSnapshots() {
+    const size_t nextCommandIdx = mCommandHistory.size() - mPosFromEnd;
+    bool anyCompressed = false;
+    for(SnapshotPair& snapshot : mTargetSnapshots) {
+        if(snapshot.compressedState.valid()) {
+            if(snapshot.compressedState.wait_for(std::chrono::seconds(0)) == std::future_status::timeout) {
+                continue;
+            }
+            // A snapshot that failed to compress is kept as it is
+            try {
+                snapshot.state = snapshot.compressedState.get();
+            } catch(const std::exception&) {
+                continue;
+            }
+            snapshot.memorySize = static_cast<size_t>(getStateMemorySize(mTarget, snapshot.state, 0));
+            anyCompressed = true;
+        } else if(!snapshot.isCompressed && mColdSnapshotDistance > 0) {
+            const size_t distance = std::max(snapshot.nextCommandIdx, nextCommandIdx) -
+                                    std::min(snapshot.nextCommandIdx, nextCommandIdx);
+            if(distance > mColdSnapshotDistance) {
+                snapshot.compressedState = mTarget.compressState(snapshot.state);
+                snapshot.isCompressed = true;
+            }
+        }
+    }
+    return anyCompressed;
+}
+
+template <typename Target>
+void CommandManager<Target>::saveSnapshot(StateType state) {
+    // Only capture the state here, measuring it is left for finalizeSnapshots()
+    const size_t nextCommandIdx = mCommandHistory.size() - mPosFromEnd;
+    mTargetSnapshots.push_back({std::move(state), nextCommandIdx, std::nullopt, false, {}});
+
+    // Cold snapshots are only compressed by finalizeSnapshots()
+    const auto firstPendingIt = std::find_if(mTargetSnapshots.rbegin(), mTargetSnapshots.rend(),
+                                             [](const SnapshotPair& snapshot) { return snapshot.memorySize; });
+    if(static_cast<size_t>(std::distance(mTargetSnapshots.rbegin(), firstPendingIt)) > MAX_PENDING_SNAPSHOTS &&
+       measurePendingSnapshots()) {
+        enforceMemoryBudget();
+    }
+}
+
+template <typename Target>
+void CommandManager<Target>::enforceMemoryBudget() {
+    if(mMemoryBudget == 0) {
+        return;
+    }
+
+    size_t memorySize = getSnapshotMemorySize();
+    while(memorySize > mMemoryBudget && mTargetSnapshots.size() > 2) {
+        // Remove the intermediate snapshot whose removal makes the shortest replay for undo,
+        // this keeps the remaining snapshots spread evenly over the history
+        auto bestIt = std::next(mTargetSnapshots.begin());
+        size_t bestCost = std::numeric_limits<size_t>::max();
+        for(auto it = std::next(mTargetSnapshots.begin()); std::next(it) != mTargetSnapshots.end(); ++it) {
+            const size_t cost = getReplayCost(std::prev(it)->nextCommandIdx, std::next(it)->nextCommandIdx);
+            if(cost < bestCost) {
+                bestCost = cost;
+                bestIt = it;
+            }
+        }
+        memorySize -= *bestIt->memorySize;
+        mTargetSnapshots.erase(bestIt);
+    }
+}
+
+template <typename Target>
+void CommandManager<Target>::compactHistory() {
+    const size_t nextCommandIdx = mCommandHistory.size() - mPosFromEnd;
+    if(mHistoryDepth == 0 || nextCommandIdx <= mHistoryDepth) {
+        return;
+    }
+
+    // The first snapshot is before all commands, so there is always one to fold into
+    const size_t maxBaseIdx = nextCommandIdx - mHistoryDepth;
+    const auto baseIt = std::find_if(mTargetSnapshots.rbegin(), mTargetSnapshots.rend(),
+                                     [maxBaseIdx](const SnapshotPair& snapshot) {
+                                         return snapshot.nextCommandIdx <= maxBaseIdx;
+                                     });
+    P_ASSERT(baseIt != mTargetSnapshots.rend());
+    const size_t baseIdx = baseIt->nextCommandIdx;
+    if(baseIdx == 0) {
+        return;
+    }
+
+    // The state of the snapshot is all that is left of the discarded commands
+    mTargetSnapshots.erase(mTargetSnapshots.begin(), std::prev(baseIt.base()));
+    mCommandHistory.erase(mCommandHistory.begin(), mCommandHistory.begin() + baseIdx);
+    mCommandDeltas.erase(mCommandDeltas.begin(), mCommandDeltas.begin() + baseIdx);
+    for(SnapshotPair& snapshot : mTargetSnapshots) {
+        snapshot.nextCommandIdx -= baseIdx;
+    }
+}
+
+template <typename Target>
+size_t CommandManager<Target>::getReplayCost(size_t beginIdx, size_t endIdx) const {
+    P_ASSERT(beginIdx <= endIdx && endIdx <= mCommandHistory.size());
+    size_t cost = 0;
+    for(size_t i = beginIdx; i < endIdx; ++i) {
+        cost += mCommandHistory[i]->isSlowCommand() ? SLOW_COMMAND_REPLAY_COST : 1;
+    }
+    return cost;
+}
+
 template <typename Target>
 size_t CommandManager<Target>::getNumOfCommandsSinceSnapshot() const {
     const size_t nextCommandIdx = mCommandHistory.size() - mPosFromEnd;
@@ -1,6 +1,9 @@
 #include "commands/CommandManager.h"
 #ifdef _TEST_
 #include <gtest/gtest.h>
+#include <future>
+#include <map>
+#include <optional>
 #include <vector>
 
 namespace pepr3d {
@@ -16,6 +19,10 @@ struct MockTarget {
     void loadState(int newState) {
         mInnerValue = newState;
     }
+
+    size_t getStateMemorySize(int) const {
+        return 1000;
+    }
 };
 
 class CmdAddValue : public CommandBase<MockTarget> {
@@ -34,6 +41,28 @@ class CmdAddValue : public CommandBase<MockTarget> {
     int mAddedValue;
 };
 
+class CmdAddValues : public CommandBase<MockTarget> {
+   public:
+    virtual std::string_view getDescription() const override {
+        return "IncreaseVals";
+    }
+
+    explicit CmdAddValues(std::vector<int> addedValues) : mAddedValues(std::move(addedValues)) {}
+
+    virtual size_t getApproximateMemorySize() const override {
+        return mAddedValues.capacity() * sizeof(int);
+    }
+
+   protected:
+    virtual void run(MockTarget& target) const override {
+        for(const int addedValue : mAddedValues) {
+            target.mInnerValue += addedValue;
+        }
+    }
+
+    std::vector<int> mAddedValues;
+};
+
 class CmdAddValueSlow : public CommandBase<MockTarget> {
    public:
     virtual std::string_view getDescription() const override {
@@ -110,6 +139,128 @@ class CmdAddValueJoinableSlow : public CommandBase<MockTarget> {
     int mAddedValue;
 };
 
+/// Target recording the previous values of the changed elements, counting the loaded snapshots
+struct MockDeltaTarget {
+    using Delta = std::map<size_t, int>;
+
+    std::vector<int> mValues = std::vector<int>(10, 0);
+    std::optional<Delta> mRecordedDelta;
+    int mLoadCount = 0;
+
+    std::vector<int> saveState() const {
+        return mValues;
+    }
+
+    void loadState(const std::vector<int>& state) {
+        mValues = state;
+        ++mLoadCount;
+    }
+
+    void setValue(size_t index, int value) {
+        if(mRecordedDelta && mRecordedDelta->count(index) == 0) {
+            (*mRecordedDelta)[index] = mValues[index];
+        }
+        mValues[index] = value;
+    }
+
+    void beginDelta(Delta delta) {
+        mRecordedDelta = std::move(delta);
+    }
+
+    Delta endDelta() {
+        Delta delta = std::move(*mRecordedDelta);
+        mRecordedDelta.reset();
+        return delta;
+    }
+
+    void undoDelta(const Delta& delta) {
+        for(const auto& value : delta) {
+            mValues[value.first] = value.second;
+        }
+    }
+
+    size_t getDeltaMemorySize(const Delta& delta) const {
+        return delta.size() * sizeof(Delta::value_type);
+    }
+};
+
+class CmdSetValue : public CommandBase<MockDeltaTarget> {
+   public:
+    virtual std::string_view getDescription() const override {
+        return "SetValue";
+    }
+
+    CmdSetValue(size_t index, int value, bool canUndoByDelta)
+        : CommandBase(false, true), mIndices{index}, mValue(value), mCanUndoByDelta(canUndoByDelta) {}
+
+    CmdSetValue(std::vector<size_t> indices, int value, bool canUndoByDelta)
+        : CommandBase(false, true), mIndices(std::move(indices)), mValue(value), mCanUndoByDelta(canUndoByDelta) {}
+
+    virtual bool canUndoByDelta() const override {
+        return mCanUndoByDelta;
+    }
+
+   protected:
+    virtual void run(MockDeltaTarget& target) const override {
+        for(const size_t index : mIndices) {
+            target.setValue(index, mValue);
+        }
+    }
+
+    virtual bool joinCommand(const CommandBase<MockDeltaTarget>& otherBase) override {
+        const auto* other = dynamic_cast<const CmdSetValue*>(&otherBase);
+        if(other && other->mValue == mValue) {
+            mIndices.insert(mIndices.end(), other->mIndices.begin(), other->mIndices.end());
+            return true;
+        }
+        return false;
+    }
+
+    std::vector<size_t> mIndices;
+    int mValue;
+    bool mCanUndoByDelta;
+};
+
+struct MockCompressedTarget {
+    struct State {
+        int value = 0;
+        bool isCompressed = false;
+    };
+
+    int mInnerValue = 0;
+    int mCompressCount = 0;
+
+    State saveState() const {
+        return {mInnerValue, false};
+    }
+
+    void loadState(const State& state) {
+        mInnerValue = state.value;
+    }
+
+    size_t getStateMemorySize(const State& state) const {
+        return state.isCompressed ? 100 : 1000;
+    }
+
+    // Deferred, so the compression runs in finalizeSnapshots()
+    std::future<State> compressState(const State& state) {
+        ++mCompressCount;
+        return std::async(std::launch::deferred, [state]() { return State{state.value, true}; });
+    }
+};
+
+class CmdAddCompressedValue : public CommandBase<MockCompressedTarget> {
+   public:
+    virtual std::string_view getDescription() const override {
+        return "IncreaseVal";
+    }
+
+   protected:
+    virtual void run(MockCompressedTarget& target) const override {
+        target.mInnerValue += 1;
+    }
+};
+
 TEST(CommandManager, Undo) {
     /**
      * Test that undo is available and undoes the correct command
@@ -233,6 +384,56 @@ TEST(CommandManager, SlowCommandsRedo) {
     EXPECT_FALSE(cm.canRedo());
 }
 
+TEST(CommandManager, MultiStepUndoRedo) {
+    /**
+     * Test undoing and redoing several commands at once, including more than there are
+     */
+
+    MockTarget target;
+    CommandManager<MockTarget> cm(target);
+
+    std::vector<int> valueHistory = {target.mInnerValue};
+    const auto maxSteps = 3 * CommandManager<MockTarget>::SNAPSHOT_FREQUENCY + 2;
+    for(int i = 0; i < maxSteps; i++) {
+        if(i % 5 == 0) {
+            cm.execute(make_unique<CmdAddValueSlow>(i));
+        } else {
+            cm.execute(make_unique<CmdAddValue>(i));
+        }
+        valueHistory.push_back(target.mInnerValue);
+    }
+
+    size_t pos = maxSteps;
+    size_t version = cm.getVersionNumber();
+    for(const size_t steps : {3, 7, 1, 12}) {
+        cm.undo(steps);
+        pos -= steps;
+        version += steps;
+        EXPECT_EQ(target.mInnerValue, valueHistory[pos]);
+        EXPECT_EQ(cm.getVersionNumber(), version);
+    }
+    for(const size_t steps : {2, 9, 4}) {
+        cm.redo(steps);
+        pos += steps;
+        version += steps;
+        EXPECT_EQ(target.mInnerValue, valueHistory[pos]);
+        EXPECT_EQ(cm.getVersionNumber(), version);
+    }
+
+    cm.redo(maxSteps);
+    EXPECT_EQ(target.mInnerValue, valueHistory.back());
+    EXPECT_FALSE(cm.canRedo());
+    cm.undo(maxSteps + 1);
+    EXPECT_EQ(target.mInnerValue, valueHistory.front());
+    EXPECT_FALSE(cm.canUndo());
+    version += maxSteps - pos + maxSteps;
+    EXPECT_EQ(cm.getVersionNumber(), version);
+
+    // Nothing to undo does not change the version
+    cm.undo(1);
+    EXPECT_EQ(cm.getVersionNumber(), version);
+}
+
 TEST(CommandManager, SlowCommandsFutureClear) {
     /**
      * Test the overwrite future funcionality - if you undo several times, and perform a new stroke, you cannot redo
@@ -349,5 +550,382 @@ TEST(CommandManager, JoinRemovesSnapshot) {
     EXPECT_EQ(target.mInnerValue, 11);
 }
 
+TEST(CommandManager, MemoryBudget) {
+    /*
+     * Test that snapshots are thinned out to fit the memory budget and undo still restores the correct values
+     */
+
+    MockTarget target{};
+    CommandManager<MockTarget> cm(target);
+    cm.setMemoryBudget(3000);
+
+    int counter = 0;
+    std::vector<int> counterHistory = {counter};
+    const auto maxSteps = 10 * CommandManager<MockTarget>::SNAPSHOT_FREQUENCY + 1;
+    for(int i = 0; i < maxSteps; i++) {
+        cm.execute(make_unique<CmdAddValue>(i));
+        cm.finalizeSnapshots();
+        counter += i;
+        counterHistory.push_back(counter);
+
+        EXPECT_LE(cm.getSnapshotCount(), 3);
+        EXPECT_LE(cm.getSnapshotMemorySize(), 3000);
+    }
+
+    for(int i = 0; i < maxSteps; i++) {
+        ASSERT_TRUE(cm.canUndo());
+        cm.undo();
+        counterHistory.pop_back();
+        EXPECT_EQ(target.mInnerValue, counterHistory.back());
+    }
+    EXPECT_FALSE(cm.canUndo());
+
+    // Lowering the budget removes the snapshots right away, the first one is always kept
+    cm.setMemoryBudget(1);
+    EXPECT_LE(cm.getSnapshotCount(), 2);
+
+    // Unlimited budget keeps all snapshots
+    cm.setMemoryBudget(0);
+    for(int i = 0; i < maxSteps; i++) {
+        cm.execute(make_unique<CmdAddValue>(i));
+    }
+    EXPECT_GT(cm.getSnapshotCount(), 3);
+}
+
+TEST(CommandManager, PendingSnapshots) {
+    /*
+     * Test that snapshots are measured only once finalized, or once too many of them are pending
+     */
+
+    MockTarget target{};
+    CommandManager<MockTarget> cm(target);
+    cm.setMemoryBudget(1);
+
+    const auto maxSteps = 10 * CommandManager<MockTarget>::SNAPSHOT_FREQUENCY + 1;
+    for(int i = 0; i < maxSteps; i++) {
+        cm.execute(make_unique<CmdAddValue>(1));
+        EXPECT_LE(cm.getSnapshotCount(), 2 + CommandManager<MockTarget>::MAX_PENDING_SNAPSHOTS);
+    }
+
+    cm.finalizeSnapshots();
+    EXPECT_EQ(cm.getSnapshotCount(), 2);
+    EXPECT_EQ(cm.getSnapshotMemorySize(), 2000);
+
+    for(int i = 0; i < maxSteps; i++) {
+        ASSERT_TRUE(cm.canUndo());
+        cm.undo();
+        EXPECT_EQ(target.mInnerValue, maxSteps - i - 1);
+    }
+}
+
+TEST(CommandManager, HistoryMemorySize) {
+    /*
+     * Test that the memory of the history includes the data of the commands and forgets the cleared future
+     */
+
+    MockTarget target{};
+    CommandManager<MockTarget> cm(target);
+    EXPECT_EQ(cm.getHistoryMemorySize(), 0);
+
+    cm.execute(make_unique<CmdAddValue>(1));
+    const size_t commandSize = cm.getHistoryMemorySize();
+    EXPECT_GE(commandSize, sizeof(CommandBase<MockTarget>));
+
+    cm.execute(make_unique<CmdAddValues>(std::vector<int>(1000, 1)));
+    EXPECT_EQ(cm.getHistorySize(), 2);
+    EXPECT_GE(cm.getHistoryMemorySize(), commandSize + 1000 * sizeof(int));
+    EXPECT_EQ(target.mInnerValue, 1001);
+
+    // Redoable commands are kept until a new command is executed
+    cm.undo();
+    EXPECT_EQ(cm.getHistorySize(), 2);
+    cm.execute(make_unique<CmdAddValue>(1));
+    EXPECT_EQ(cm.getHistorySize(), 2);
+    EXPECT_LT(cm.getHistoryMemorySize(), commandSize + 1000 * sizeof(int));
+}
+
+TEST(CommandManager, Observer) {
+    /*
+     * Test that the observers see the executed commands with their join flag, and only the undos and redos that
+     * happen while they are added
+     */
+
+    struct RecordingObserver : public CommandManager<MockTarget>::Observer {
+        std::vector<std::string> operations;
+
+        void onExecute(const CommandBase<MockTarget>& command, bool join) override {
+            operations.push_back(std::string(command.getDescription()) + (join ? " joined" : ""));
+        }
+
+        void onUndo() override {
+            operations.push_back("Undo");
+        }
+
+        void onRedo() override {
+            operations.push_back("Redo");
+        }
+    };
+
+    MockTarget target{};
+    CommandManager<MockTarget> cm(target);
+    RecordingObserver observer;
+    RecordingObserver laterObserver;
+    cm.addObserver(&observer);
+
+    cm.undo();
+    cm.execute(make_unique<CmdAddValue>(1));
+    cm.execute(make_unique<CmdAddValue>(2), true);
+    cm.undo();
+    cm.addObserver(&laterObserver);
+    cm.redo();
+    cm.redo();
+    EXPECT_EQ(target.mInnerValue, 3);
+    EXPECT_EQ(observer.operations,
+              std::vector<std::string>({"IncreaseVal", "IncreaseVal joined", "Undo", "Redo"}));
+    EXPECT_EQ(laterObserver.operations, std::vector<std::string>({"Redo"}));
+
+    cm.removeObserver(&observer);
+    cm.undo();
+    EXPECT_EQ(observer.operations.size(), 4);
+    EXPECT_EQ(laterObserver.operations, std::vector<std::string>({"Redo", "Undo"}));
+    cm.removeObserver(&laterObserver);
+}
+
+TEST(CommandManager, UndoByDelta) {
+    /*
+     * Test that commands with deltas are undone without loading snapshots, also when joined, replayed and redone,
+     * and that a command without a delta falls back to the snapshots
+     */
+
+    MockDeltaTarget target;
+    CommandManager<MockDeltaTarget> cm(target);
+    std::vector<std::vector<int>> valueHistory = {target.mValues};
+    const auto maxSteps = 2 * CommandManager<MockDeltaTarget>::SNAPSHOT_FREQUENCY + 1;
+    for(int i = 0; i < maxSteps; i++) {
+        cm.execute(make_unique<CmdSetValue>(static_cast<size_t>(i) % 10, i + 1, true));
+        valueHistory.push_back(target.mValues);
+    }
+
+    cm.undo(3);
+    EXPECT_EQ(target.mValues, valueHistory[maxSteps - 3]);
+    cm.redo(2);
+    EXPECT_EQ(target.mValues, valueHistory[maxSteps - 1]);
+    cm.undo(static_cast<size_t>(maxSteps));
+    EXPECT_EQ(target.mValues, valueHistory.front());
+    EXPECT_EQ(target.mLoadCount, 0);
+    EXPECT_GT(cm.getHistoryMemorySize(), 0);
+
+    // A joined command is undone at once, back to the value before the first part
+    cm.execute(make_unique<CmdSetValue>(0, 7, true));
+    cm.execute(make_unique<CmdSetValue>(1, 7, true), true);
+    cm.execute(make_unique<CmdSetValue>(0, 7, true), true);
+    EXPECT_EQ(target.mValues[0], 7);
+    EXPECT_EQ(target.mValues[1], 7);
+    cm.undo();
+    EXPECT_EQ(target.mValues, valueHistory.front());
+    EXPECT_EQ(target.mLoadCount, 0);
+
+    // Undoing over a command without a delta loads a snapshot
+    cm.redo();
+    cm.execute(make_unique<CmdSetValue>(2, 8, false));
+    cm.execute(make_unique<CmdSetValue>(3, 9, true));
+    cm.undo();
+    EXPECT_EQ(target.mLoadCount, 0);
+    EXPECT_EQ(target.mValues[3], 0);
+    cm.undo();
+    EXPECT_EQ(target.mLoadCount, 1);
+    EXPECT_EQ(target.mValues[2], 0);
+    EXPECT_EQ(target.mValues[0], 7);
+}
+
+TEST(CommandManager, Stroke) {
+    /*
+     * Test that the changes of a stroke are saved as a single command, undone by the delta recorded during the stroke
+     * or by replaying the command, and that a stroke is ended by executing another command
+     */
+
+    MockDeltaTarget target;
+    CommandManager<MockDeltaTarget> cm(target);
+    cm.execute(make_unique<CmdSetValue>(0, 1, true));
+    cm.undo();
+    const size_t version = cm.getVersionNumber();
+
+    std::vector<size_t> strokeIndices;
+    cm.beginStroke([&strokeIndices]() { return make_unique<CmdSetValue>(std::move(strokeIndices), 5, true); });
+    EXPECT_TRUE(cm.isStrokeInProgress());
+    // The command to redo is only dropped once the stroke changes something
+    EXPECT_TRUE(cm.canRedo());
+    for(size_t i = 2; i < 6; ++i) {
+        target.setValue(i, 5);
+        strokeIndices.push_back(i);
+    }
+    EXPECT_EQ(cm.getVersionNumber(), version);
+    cm.endStroke();
+    EXPECT_FALSE(cm.isStrokeInProgress());
+    EXPECT_FALSE(cm.canRedo());
+    EXPECT_EQ(cm.getHistorySize(), 1);
+    EXPECT_EQ(cm.getVersionNumber(), version + 1);
+
+    cm.undo();
+    EXPECT_EQ(target.mValues, std::vector<int>(10, 0));
+    EXPECT_EQ(target.mLoadCount, 0);
+    cm.redo();
+    EXPECT_EQ(target.mValues[2], 5);
+    EXPECT_EQ(target.mValues[5], 5);
+
+    // A stroke whose command cannot be undone by a delta is undone by the snapshot before it
+    cm.beginStroke([&target]() { return make_unique<CmdSetValue>(size_t(7), target.mValues[7], false); });
+    target.setValue(7, 3);
+    cm.execute(make_unique<CmdSetValue>(8, 4, true));
+    EXPECT_FALSE(cm.isStrokeInProgress());
+    EXPECT_EQ(cm.getHistorySize(), 3);
+    cm.undo(2);
+    EXPECT_EQ(target.mValues[7], 0);
+    EXPECT_EQ(target.mValues[8], 0);
+    EXPECT_EQ(target.mValues[2], 5);
+    cm.redo(2);
+    EXPECT_EQ(target.mValues[7], 3);
+    EXPECT_EQ(target.mValues[8], 4);
+}
+
+TEST(CommandManager, EmptyStroke) {
+    /*
+     * Test that a stroke that changes nothing saves no command, keeps the commands to redo and the version
+     */
+
+    MockDeltaTarget target;
+    CommandManager<MockDeltaTarget> cm(target);
+    cm.execute(make_unique<CmdSetValue>(0, 1, true));
+    cm.execute(make_unique<CmdSetValue>(1, 2, true));
+    cm.undo();
+    const size_t version = cm.getVersionNumber();
+    const size_t historySize = cm.getHistorySize();
+
+    for(int i = 0; i < 2 * static_cast<int>(CommandManager<MockDeltaTarget>::SNAPSHOT_FREQUENCY); ++i) {
+        cm.beginStroke([]() { return make_unique<CmdSetValue>(std::vector<size_t>{}, 5, true); });
+        cm.endStroke();
+    }
+    EXPECT_FALSE(cm.isStrokeInProgress());
+    EXPECT_TRUE(cm.canUndo());
+    ASSERT_TRUE(cm.canRedo());
+    EXPECT_EQ(cm.getHistorySize(), historySize);
+    EXPECT_EQ(cm.getVersionNumber(), version);
+
+    cm.redo();
+    EXPECT_EQ(target.mValues[1], 2);
+    cm.undo(2);
+    EXPECT_EQ(target.mValues, std::vector<int>(10, 0));
+}
+
+TEST(CommandManager, HistoryDepth) {
+    /*
+     * Test that the commands past the history depth are discarded into a snapshot, undo still reaches the depth and
+     * the redoable commands are kept
+     */
+
+    MockTarget target{};
+    CommandManager<MockTarget> cm(target);
+    const size_t depth = 2 * CommandManager<MockTarget>::SNAPSHOT_FREQUENCY;
+    cm.setHistoryDepth(depth);
+    EXPECT_EQ(cm.getHistoryDepth(), depth);
+
+    const int maxSteps = 10 * CommandManager<MockTarget>::SNAPSHOT_FREQUENCY;
+    for(int i = 0; i < maxSteps; i++) {
+        cm.execute(make_unique<CmdAddValue>(1));
+        EXPECT_LE(cm.getHistorySize(), depth + CommandManager<MockTarget>::SNAPSHOT_FREQUENCY + 1);
+    }
+    const size_t historySize = cm.getHistorySize();
+    EXPECT_GE(historySize, depth);
+
+    // Undo goes back to the base snapshot, not further
+    cm.undo(maxSteps);
+    EXPECT_FALSE(cm.canUndo());
+    EXPECT_EQ(target.mInnerValue, maxSteps - static_cast<int>(historySize));
+    cm.redo(maxSteps);
+    EXPECT_EQ(target.mInnerValue, maxSteps);
+
+    // Only the commands before the current one count, the redoable ones are not discarded
+    cm.undo(depth);
+    cm.setHistoryDepth(depth / 2);
+    EXPECT_EQ(cm.getHistorySize(), historySize);
+    cm.redo(depth);
+    EXPECT_EQ(target.mInnerValue, maxSteps);
+
+    // Strokes are compacted as well
+    cm.setHistoryDepth(1);
+    EXPECT_LT(cm.getHistorySize(), historySize);
+    for(int i = 0; i < maxSteps; i++) {
+        cm.beginStroke([]() { return make_unique<CmdAddValue>(1); });
+        target.mInnerValue += 1;
+        cm.endStroke();
+    }
+    EXPECT_LE(cm.getHistorySize(), CommandManager<MockTarget>::SNAPSHOT_FREQUENCY + 1);
+    while(cm.canUndo()) {
+        cm.undo();
+    }
+    cm.redo(maxSteps);
+    EXPECT_EQ(target.mInnerValue, 2 * maxSteps);
+
+    // Unlimited depth keeps all commands
+    cm.setHistoryDepth(0);
+    const size_t compactedSize = cm.getHistorySize();
+    for(int i = 0; i < maxSteps; i++) {
+        cm.execute(make_unique<CmdAddValue>(1));
+    }
+    EXPECT_EQ(cm.getHistorySize(), compactedSize + maxSteps);
+}
+
+TEST(CommandManager, ColdSnapshots) {
+    /*
+     * Test that the snapshots far from the current position are compressed once when finalized, and that undo and
+     * redo load the compressed states
+     */
+
+    MockCompressedTarget target;
+    CommandManager<MockCompressedTarget> cm(target);
+    cm.setMemoryBudget(0);
+
+    const int maxSteps = 10 * CommandManager<MockCompressedTarget>::SNAPSHOT_FREQUENCY;
+    for(int i = 0; i < maxSteps; i++) {
+        cm.execute(make_unique<CmdAddCompressedValue>());
+    }
+    EXPECT_EQ(cm.getCompressedSnapshotCount(), 0);
+    const size_t snapshotMemorySize = cm.getSnapshotMemorySize();
+
+    // The snapshots close to the current position stay as they are, the rest is replaced once compressed
+    cm.finalizeSnapshots();
+    const size_t compressedCount = cm.getCompressedSnapshotCount();
+    EXPECT_GT(compressedCount, 0);
+    EXPECT_LT(compressedCount, cm.getSnapshotCount());
+    EXPECT_EQ(cm.getSnapshotMemorySize(), snapshotMemorySize);
+    cm.finalizeSnapshots();
+    EXPECT_LT(cm.getSnapshotMemorySize(), snapshotMemorySize);
+    EXPECT_EQ(target.mCompressCount, static_cast<int>(compressedCount));
+
+    for(int i = 0; i < maxSteps; i++) {
+        ASSERT_TRUE(cm.canUndo());
+        cm.undo();
+        EXPECT_EQ(target.mInnerValue, maxSteps - i - 1);
+    }
+    cm.redo(maxSteps);
+    EXPECT_EQ(target.mInnerValue, maxSteps);
+
+    // Moving to the beginning makes the latest snapshots cold
+    cm.undo(maxSteps);
+    cm.finalizeSnapshots();
+    EXPECT_GT(cm.getCompressedSnapshotCount(), compressedCount);
+    cm.redo(maxSteps);
+    EXPECT_EQ(target.mInnerValue, maxSteps);
+
+    // Disabled compression leaves new snapshots as they are
+    cm.setColdSnapshotDistance(0);
+    const int compressCount = target.mCompressCount;
+    for(int i = 0; i < maxSteps; i++) {
+        cm.execute(make_unique<CmdAddCompressedValue>());
+    }
+    cm.finalizeSnapshots();
+    EXPECT_EQ(target.mCompressCount, compressCount);
+}
+
 }  // namespace pepr3d
 #endif
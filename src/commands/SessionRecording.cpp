@@ -0,0 +1,385 @@
+#include "commands/SessionRecording.h"
+
+#ifdef _MSC_VER
+// because cereal json does not conform to C++17
+#pragma warning(push)
+#pragma warning(disable : 4996)
+#endif
+#include <cereal/archives/json.hpp>
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
+
+#include <cinder/Log.h>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#include "Profiler.h"
+#include "commands/CmdColorManager.h"
+#include "commands/CmdPaintBrush.h"
+#include "commands/CmdPaintSingleColor.h"
+#include "commands/CmdPaintText.h"
+#include "geometry/GlmSerialization.h"
+
+namespace pepr3d {
+
+namespace {
+/// Version of the recording files, increase when the entries change.
+/// Version 2 added the commands of the palette, version 3 the swept brush strokes, both read the older recordings.
+const int RECORDING_VERSION = 3;
+
+/// Takes the place of a command that is not recorded, so that undo and redo replay the same commands
+class CmdSkipped : public CommandBase<Geometry> {
+   public:
+    std::string_view getDescription() const override {
+        return "Skipped command";
+    }
+
+   protected:
+    void run(Geometry&) const override {}
+};
+
+std::unique_ptr<CommandBase<Geometry>> createCommand(const SessionRecording::Entry& entry) {
+    using Triangle = DataTriangle::Triangle;
+    using Point = DataTriangle::Point;
+
+    switch(entry.type) {
+    case SessionRecording::EntryType::PaintBrush:
+    case SessionRecording::EntryType::PaintSweptBrush:
+        return std::make_unique<CmdPaintBrush>(entry.rays, entry.brushSettings);
+    case SessionRecording::EntryType::PaintSingleColor:
+        return std::make_unique<CmdPaintSingleColor>(std::vector<DetailedTriangleId>(entry.triangleIds),
+                                                     entry.color);
+    case SessionRecording::EntryType::PaintText: {
+        std::vector<std::vector<Triangle>> text(entry.text.size());
+        for(size_t i = 0; i < entry.text.size(); ++i) {
+            const std::vector<glm::vec3>& letter = entry.text[i];
+            text[i].reserve(letter.size() / 3);
+            for(size_t j = 0; j + 2 < letter.size(); j += 3) {
+                text[i].emplace_back(Point(letter[j].x, letter[j].y, letter[j].z),
+                                     Point(letter[j + 1].x, letter[j + 1].y, letter[j + 1].z),
+                                     Point(letter[j + 2].x, letter[j + 2].y, letter[j + 2].z));
+            }
+        }
+        return std::make_unique<CmdPaintText>(entry.ray, std::move(text), entry.color);
+    }
+    case SessionRecording::EntryType::ChangeColor:
+        return std::make_unique<CmdColorManagerChangeColor>(entry.palettePosition, entry.paletteColor);
+    case SessionRecording::EntryType::SwapColors:
+        return std::make_unique<CmdColorManagerSwapColors>(entry.palettePosition, entry.otherPalettePosition);
+    case SessionRecording::EntryType::ReorderColors:
+        return std::make_unique<CmdColorManagerReorderColors>(entry.palettePosition, entry.otherPalettePosition);
+    case SessionRecording::EntryType::RemoveColor:
+        return std::make_unique<CmdColorManagerRemoveColor>(entry.palettePosition);
+    case SessionRecording::EntryType::AddColor: return std::make_unique<CmdColorManagerAddColor>(entry.paletteColor);
+    case SessionRecording::EntryType::ResetColors: return std::make_unique<CmdColorManagerResetColors>();
+    default: return std::make_unique<CmdSkipped>();
+    }
+}
+
+void writeJsonString(std::ostream& os, const std::string& value) {
+    os << '"';
+    for(const char c : value) {
+        if(c == '"' || c == '\\') {
+            os << '\\';
+        }
+        os << c;
+    }
+    os << '"';
+}
+}  // namespace
+
+/// Only the data of the type of the entry is saved
+template <class Archive>
+void save(Archive& archive, const SessionRecording::Entry& entry) {
+    archive(cereal::make_nvp("type", entry.type), cereal::make_nvp("join", entry.join),
+            cereal::make_nvp("description", entry.description));
+    switch(entry.type) {
+    case SessionRecording::EntryType::PaintBrush:
+    case SessionRecording::EntryType::PaintSweptBrush: {
+        std::vector<glm::vec3> origins;
+        std::vector<glm::vec3> directions;
+        for(const ci::Ray& ray : entry.rays) {
+            origins.push_back(ray.getOrigin());
+            directions.push_back(ray.getDirection());
+        }
+        archive(cereal::make_nvp("origins", origins), cereal::make_nvp("directions", directions),
+                cereal::make_nvp("settings", entry.brushSettings));
+        break;
+    }
+    case SessionRecording::EntryType::PaintSingleColor: {
+        std::vector<size_t> baseIds;
+        std::vector<size_t> detailIds;
+        for(const DetailedTriangleId& triangleId : entry.triangleIds) {
+            baseIds.push_back(triangleId.getBaseId());
+            detailIds.push_back(triangleId.getDetailId().value_or(SessionRecording::NO_DETAIL));
+        }
+        archive(cereal::make_nvp("baseIds", baseIds), cereal::make_nvp("detailIds", detailIds),
+                cereal::make_nvp("color", entry.color));
+        break;
+    }
+    case SessionRecording::EntryType::PaintText: {
+        glm::vec3 origin = entry.ray.getOrigin();
+        glm::vec3 direction = entry.ray.getDirection();
+        archive(cereal::make_nvp("origin", origin), cereal::make_nvp("direction", direction),
+                cereal::make_nvp("text", entry.text), cereal::make_nvp("color", entry.color));
+        break;
+    }
+    case SessionRecording::EntryType::ChangeColor:
+        archive(cereal::make_nvp("position", entry.palettePosition), cereal::make_nvp("color", entry.paletteColor));
+        break;
+    case SessionRecording::EntryType::SwapColors:
+    case SessionRecording::EntryType::ReorderColors:
+        archive(cereal::make_nvp("position", entry.palettePosition),
+                cereal::make_nvp("otherPosition", entry.otherPalettePosition));
+        break;
+    case SessionRecording::EntryType::RemoveColor:
+        archive(cereal::make_nvp("position", entry.palettePosition));
+        break;
+    case SessionRecording::EntryType::AddColor: archive(cereal::make_nvp("color", entry.paletteColor)); break;
+    default: break;
+    }
+}
+
+template <class Archive>
+void load(Archive& archive, SessionRecording::Entry& entry) {
+    archive(cereal::make_nvp("type", entry.type), cereal::make_nvp("join", entry.join),
+            cereal::make_nvp("description", entry.description));
+    switch(entry.type) {
+    case SessionRecording::EntryType::PaintBrush:
+    case SessionRecording::EntryType::PaintSweptBrush: {
+        std::vector<glm::vec3> origins;
+        std::vector<glm::vec3> directions;
+        archive(cereal::make_nvp("origins", origins), cereal::make_nvp("directions", directions),
+                cereal::make_nvp("settings", entry.brushSettings));
+        entry.brushSettings.sweptStroke = entry.type == SessionRecording::EntryType::PaintSweptBrush;
+        if(origins.size() != directions.size()) {
+            throw std::runtime_error("The rays of a recorded brush stroke are corrupted.");
+        }
+        for(size_t i = 0; i < origins.size(); ++i) {
+            entry.rays.emplace_back(origins[i], directions[i]);
+        }
+        break;
+    }
+    case SessionRecording::EntryType::PaintSingleColor: {
+        std::vector<size_t> baseIds;
+        std::vector<size_t> detailIds;
+        archive(cereal::make_nvp("baseIds", baseIds), cereal::make_nvp("detailIds", detailIds),
+                cereal::make_nvp("color", entry.color));
+        if(baseIds.size() != detailIds.size()) {
+            throw std::runtime_error("The triangles of a recorded command are corrupted.");
+        }
+        for(size_t i = 0; i < baseIds.size(); ++i) {
+            if(detailIds[i] == SessionRecording::NO_DETAIL) {
+                entry.triangleIds.emplace_back(baseIds[i]);
+            } else {
+                entry.triangleIds.emplace_back(baseIds[i], detailIds[i]);
+            }
+        }
+        break;
+    }
+    case SessionRecording::EntryType::PaintText: {
+        glm::vec3 origin;
+        glm::vec3 direction;
+        archive(cereal::make_nvp("origin", origin), cereal::make_nvp("direction", direction),
+                cereal::make_nvp("text", entry.text), cereal::make_nvp("color", entry.color));
+        entry.ray = ci::Ray(origin, direction);
+        break;
+    }
+    case SessionRecording::EntryType::ChangeColor:
+        archive(cereal::make_nvp("position", entry.palettePosition), cereal::make_nvp("color", entry.paletteColor));
+        break;
+    case SessionRecording::EntryType::SwapColors:
+    case SessionRecording::EntryType::ReorderColors:
+        archive(cereal::make_nvp("position", entry.palettePosition),
+                cereal::make_nvp("otherPosition", entry.otherPalettePosition));
+        break;
+    case SessionRecording::EntryType::RemoveColor:
+        archive(cereal::make_nvp("position", entry.palettePosition));
+        break;
+    case SessionRecording::EntryType::AddColor: archive(cereal::make_nvp("color", entry.paletteColor)); break;
+    default: break;
+    }
+}
+
+void SessionRecording::save(std::ostream& os) const {
+    cereal::JSONOutputArchive archive(os);
+    archive(cereal::make_nvp("version", RECORDING_VERSION), cereal::make_nvp("modelHash", mModelHash),
+            cereal::make_nvp("entries", mEntries));
+}
+
+SessionRecording SessionRecording::load(std::istream& is) {
+    SessionRecording recording;
+    try {
+        cereal::JSONInputArchive archive(is);
+        int version = 0;
+        archive(cereal::make_nvp("version", version));
+        if(version < 1 || version > RECORDING_VERSION) {
+            throw std::runtime_error("Unsupported version " + std::to_string(version) + " of the session recording.");
+        }
+        archive(cereal::make_nvp("modelHash", recording.mModelHash), cereal::make_nvp("entries", recording.mEntries));
+    } catch(const cereal::Exception& e) {
+        throw std::runtime_error(std::string("The session recording is corrupted: ") + e.what());
+    }
+    return recording;
+}
+
+std::vector<SessionRecording::Timing> SessionRecording::replay(Geometry& geometry,
+                                                               CommandManager<Geometry>& commandManager) const {
+    if(geometry.getModelHash() != mModelHash) {
+        throw std::runtime_error("The session was recorded on a different model.");
+    }
+
+    std::vector<Timing> timings;
+    timings.reserve(mEntries.size());
+    for(const Entry& entry : mEntries) {
+        const Profiler::Clock::time_point start = Profiler::Clock::now();
+        applyEntry(entry, commandManager);
+        const Profiler::Clock::time_point commandEnd = Profiler::Clock::now();
+        geometry.updateOpenGlBuffers();
+        const Profiler::Clock::time_point buffersEnd = Profiler::Clock::now();
+
+        Timing timing;
+        timing.description = entry.description;
+        timing.commandMilliseconds = std::chrono::duration<double, std::milli>(commandEnd - start).count();
+        timing.buffersMilliseconds = std::chrono::duration<double, std::milli>(buffersEnd - commandEnd).count();
+        timings.push_back(std::move(timing));
+
+        // The application does this while idle between the commands
+        commandManager.finalizeSnapshots();
+    }
+    return timings;
+}
+
+void SessionRecording::writeTimings(std::ostream& os, const std::vector<Timing>& timings) {
+    double commandTotal = 0.0;
+    double buffersTotal = 0.0;
+    os << "{\"commands\":[";
+    for(size_t i = 0; i < timings.size(); ++i) {
+        const Timing& timing = timings[i];
+        os << (i > 0 ? "," : "") << "\n{\"description\":";
+        writeJsonString(os, timing.description);
+        os << ",\"command_ms\":" << timing.commandMilliseconds << ",\"buffers_ms\":" << timing.buffersMilliseconds
+           << "}";
+        commandTotal += timing.commandMilliseconds;
+        buffersTotal += timing.buffersMilliseconds;
+    }
+    os << "\n],\"total_command_ms\":" << commandTotal << ",\"total_buffers_ms\":" << buffersTotal << "}\n";
+}
+
+SessionRecording::Entry SessionRecording::createEntry(const CommandBase<Geometry>& command, const bool join) {
+    Entry entry;
+    entry.join = join;
+    entry.description = std::string(command.getDescription());
+    if(const auto* brush = dynamic_cast<const CmdPaintBrush*>(&command)) {
+        entry.rays = brush->getRays();
+        entry.brushSettings = brush->getSettings();
+        entry.type = entry.brushSettings.sweptStroke ? EntryType::PaintSweptBrush : EntryType::PaintBrush;
+    } else if(const auto* singleColor = dynamic_cast<const CmdPaintSingleColor*>(&command)) {
+        entry.type = EntryType::PaintSingleColor;
+        entry.triangleIds = singleColor->getTriangleIds();
+        entry.color = singleColor->getColorId();
+    } else if(const auto* text = dynamic_cast<const CmdPaintText*>(&command)) {
+        entry.type = EntryType::PaintText;
+        entry.ray = text->getRay();
+        entry.color = text->getColor();
+        for(const auto& letter : text->getText()) {
+            std::vector<glm::vec3> vertices;
+            vertices.reserve(3 * letter.size());
+            for(const auto& triangle : letter) {
+                for(int k = 0; k < 3; ++k) {
+                    const auto& vertex = triangle.vertex(k);
+                    vertices.emplace_back(CGAL::to_double(vertex.x()), CGAL::to_double(vertex.y()),
+                                          CGAL::to_double(vertex.z()));
+                }
+            }
+            entry.text.push_back(std::move(vertices));
+        }
+    } else if(const auto* changeColor = dynamic_cast<const CmdColorManagerChangeColor*>(&command)) {
+        entry.type = EntryType::ChangeColor;
+        entry.palettePosition = changeColor->getColorIdx();
+        entry.paletteColor = changeColor->getColor();
+    } else if(const auto* swapColors = dynamic_cast<const CmdColorManagerSwapColors*>(&command)) {
+        entry.type = EntryType::SwapColors;
+        entry.palettePosition = swapColors->getColor1Idx();
+        entry.otherPalettePosition = swapColors->getColor2Idx();
+    } else if(const auto* reorderColors = dynamic_cast<const CmdColorManagerReorderColors*>(&command)) {
+        entry.type = EntryType::ReorderColors;
+        entry.palettePosition = reorderColors->getColor1Idx();
+        entry.otherPalettePosition = reorderColors->getColor2Idx();
+    } else if(const auto* removeColor = dynamic_cast<const CmdColorManagerRemoveColor*>(&command)) {
+        entry.type = EntryType::RemoveColor;
+        entry.palettePosition = removeColor->getColorIdx();
+    } else if(const auto* addColor = dynamic_cast<const CmdColorManagerAddColor*>(&command)) {
+        entry.type = EntryType::AddColor;
+        entry.paletteColor = addColor->getColor();
+    } else if(dynamic_cast<const CmdColorManagerResetColors*>(&command) != nullptr) {
+        entry.type = EntryType::ResetColors;
+    } else {
+        entry.type = EntryType::Skipped;
+    }
+    return entry;
+}
+
+void SessionRecording::applyEntry(const Entry& entry, CommandManager<Geometry>& commandManager) {
+    if(entry.type == EntryType::Undo) {
+        commandManager.undo();
+    } else if(entry.type == EntryType::Redo) {
+        commandManager.redo();
+    } else {
+        commandManager.execute(createCommand(entry), entry.join);
+    }
+}
+
+std::string SessionRecording::saveEntry(const Entry& entry) {
+    std::ostringstream os(std::ios::binary);
+    {
+        cereal::BinaryOutputArchive archive(os);
+        archive(entry);
+    }
+    return os.str();
+}
+
+SessionRecording::Entry SessionRecording::loadEntry(const std::string& data) {
+    Entry entry;
+    std::istringstream is(data, std::ios::binary);
+    try {
+        cereal::BinaryInputArchive archive(is);
+        archive(entry);
+    } catch(const cereal::Exception& e) {
+        throw std::runtime_error(std::string("The entry is corrupted: ") + e.what());
+    }
+    return entry;
+}
+
+void SessionRecorder::onExecute(const CommandBase<Geometry>& command, const bool join) {
+    SessionRecording::Entry entry = SessionRecording::createEntry(command, join);
+    if(entry.type == SessionRecording::EntryType::Skipped) {
+        CI_LOG_W("The session recording does not replay the command: " + entry.description);
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRecording.addEntry(std::move(entry));
+}
+
+void SessionRecorder::onUndo() {
+    SessionRecording::Entry entry;
+    entry.type = SessionRecording::EntryType::Undo;
+    entry.description = "Undo";
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRecording.addEntry(std::move(entry));
+}
+
+void SessionRecorder::onRedo() {
+    SessionRecording::Entry entry;
+    entry.type = SessionRecording::EntryType::Redo;
+    entry.description = "Redo";
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRecording.addEntry(std::move(entry));
+}
+
+}  // namespace pepr3d
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cinder/Ray.h>
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "commands/CommandManager.h"
+#include "geometry/Geometry.h"
+#include "tools/Brush.h"
+
+namespace pepr3d {
+
+/// Painting session recorded from the commands executed by a CommandManager<Geometry>, with undos and redos.
+/// It can be saved into a file and replayed on the same model without the application, with the commands timed one
+/// by one, e.g., to reproduce slowdowns of long sessions. The commands are deterministic, so the replay paints the
+/// same triangles as the session did. The entries are also the records of the autosave journal, see CommandJournal.
+class SessionRecording {
+   public:
+    enum class EntryType : int {
+        PaintBrush,        ///< CmdPaintBrush, its rays and settings
+        PaintSingleColor,  ///< CmdPaintSingleColor, e.g., of a bucket fill or a segmentation
+        PaintText,         ///< CmdPaintText, its ray and the triangles of the letters
+        Undo,
+        Redo,
+        Skipped,        ///< A command that is not recorded, replayed as a command doing nothing
+        ChangeColor,    ///< CmdColorManagerChangeColor, its palette position and color
+        SwapColors,     ///< CmdColorManagerSwapColors, its 2 palette positions
+        ReorderColors,  ///< CmdColorManagerReorderColors, its 2 palette positions
+        RemoveColor,    ///< CmdColorManagerRemoveColor, its palette position
+        AddColor,       ///< CmdColorManagerAddColor, its color
+        ResetColors,    ///< CmdColorManagerResetColors
+        PaintSweptBrush  ///< CmdPaintBrush with BrushSettings::sweptStroke, saved like PaintBrush
+    };
+
+    /// Detail of a DetailedTriangleId without one
+    static constexpr size_t NO_DETAIL = std::numeric_limits<size_t>::max();
+
+    struct Entry {
+        EntryType type = EntryType::Skipped;
+
+        /// Joined into the last command, as CommandManager::execute() was called
+        bool join = false;
+
+        /// Description of the command for the timings
+        std::string description;
+
+        /// PaintBrush and PaintSweptBrush
+        std::vector<ci::Ray> rays;
+        BrushSettings brushSettings;
+
+        /// PaintSingleColor
+        std::vector<DetailedTriangleId> triangleIds;
+
+        /// PaintSingleColor and PaintText
+        size_t color = 0;
+
+        /// PaintText, 3 consecutive vertices of each triangle of each letter
+        ci::Ray ray;
+        std::vector<std::vector<glm::vec3>> text;
+
+        /// Commands of the palette, the positions of the colors in the palette and the new color
+        size_t palettePosition = 0;
+        size_t otherPalettePosition = 0;
+        glm::vec4 paletteColor = glm::vec4(0.f);
+    };
+
+    /// Duration of a replayed entry
+    struct Timing {
+        std::string description;
+
+        /// Executing, undoing or redoing the command
+        double commandMilliseconds = 0.0;
+
+        /// Updating the buffers of the Geometry afterwards, as ModelView does before the next frame
+        double buffersMilliseconds = 0.0;
+    };
+
+    SessionRecording() = default;
+
+    /// @param modelHash Geometry::getModelHash() of the model of the session
+    explicit SessionRecording(uint64_t modelHash) : mModelHash(modelHash) {}
+
+    uint64_t getModelHash() const {
+        return mModelHash;
+    }
+
+    const std::vector<Entry>& getEntries() const {
+        return mEntries;
+    }
+
+    void addEntry(Entry entry) {
+        mEntries.push_back(std::move(entry));
+    }
+
+    /// Writes the recording as JSON
+    void save(std::ostream& os) const;
+
+    /// Reads a recording written by save(), throws std::runtime_error if it cannot be read
+    static SessionRecording load(std::istream& is);
+
+    /// Replays the entries on the Geometry through its CommandManager, which should be new, and returns the duration
+    /// of each entry. Throws std::runtime_error if the Geometry is not the model of the recording.
+    std::vector<Timing> replay(Geometry& geometry, CommandManager<Geometry>& commandManager) const;
+
+    /// Writes the timings of a replay as JSON
+    static void writeTimings(std::ostream& os, const std::vector<Timing>& timings);
+
+    /// Entry of the command, Skipped if the command is not recorded
+    static Entry createEntry(const CommandBase<Geometry>& command, bool join);
+
+    /// Executes, undoes or redoes the entry through the CommandManager
+    static void applyEntry(const Entry& entry, CommandManager<Geometry>& commandManager);
+
+    /// Writes the entry as a binary archive, e.g., into a record of a journal
+    static std::string saveEntry(const Entry& entry);
+
+    /// Reads an entry written by saveEntry(), throws std::runtime_error if it cannot be read
+    static Entry loadEntry(const std::string& data);
+
+   private:
+    uint64_t mModelHash = 0;
+    std::vector<Entry> mEntries;
+};
+
+/// Records the commands of a CommandManager<Geometry> into a SessionRecording while it is its observer.
+/// Commands may be executed on a worker thread during slow operations, so the recording is guarded.
+class SessionRecorder : public CommandManager<Geometry>::Observer {
+   public:
+    explicit SessionRecorder(uint64_t modelHash) : mRecording(modelHash) {}
+
+    void onExecute(const CommandBase<Geometry>& command, bool join) override;
+
+    void onUndo() override;
+
+    void onRedo() override;
+
+    /// Copy of the entries recorded so far
+    SessionRecording getRecording() const {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mRecording;
+    }
+
+    size_t getEntryCount() const {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mRecording.getEntries().size();
+    }
+
+   private:
+    mutable std::mutex mMutex;
+    SessionRecording mRecording;
+};
+
+}  // namespace pepr3d
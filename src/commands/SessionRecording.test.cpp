@@ -0,0 +1,176 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include "commands/CmdColorManager.h"
+#include "commands/CmdPaintBrush.h"
+#include "commands/CmdPaintSingleColor.h"
+#include "commands/CommandManager.h"
+#include "commands/SessionRecording.h"
+#include "geometry/Geometry.h"
+#include "geometry/TestGeometries.h"
+
+namespace pepr3d {
+namespace {
+/// Command that the session recording does not know
+class CmdNotRecorded : public CommandBase<Geometry> {
+   public:
+    std::string_view getDescription() const override {
+        return "Not recorded";
+    }
+
+   protected:
+    void run(Geometry&) const override {}
+};
+}  // namespace
+
+TEST(SessionRecording, recordAndReplay) {
+    /**
+     * Test that a recorded session saved to JSON replays to the same colors and palette, including the undos,
+     * redos and the commands that are not recorded
+     */
+
+    Geometry geometry(test::getGeometryWithSquare());
+    CommandManager<Geometry> commandManager(geometry);
+    SessionRecorder recorder(geometry.getModelHash());
+    commandManager.addObserver(&recorder);
+
+    commandManager.execute(std::make_unique<CmdPaintSingleColor>(size_t(0), 1));
+    commandManager.execute(std::make_unique<CmdPaintSingleColor>(size_t(1), 1), true);
+    commandManager.execute(std::make_unique<CmdColorManagerChangeColor>(0, glm::vec4(1.f)));
+    commandManager.execute(std::make_unique<CmdNotRecorded>());
+    commandManager.execute(std::make_unique<CmdPaintSingleColor>(size_t(1), 2));
+    commandManager.undo();
+    commandManager.undo();
+    commandManager.redo();
+    commandManager.removeObserver(&recorder);
+    EXPECT_EQ(geometry.getTriangleColor(0), 1);
+    EXPECT_EQ(geometry.getTriangleColor(1), 1);
+
+    std::stringstream stream;
+    recorder.getRecording().save(stream);
+    const SessionRecording recording = SessionRecording::load(stream);
+    ASSERT_EQ(recording.getEntries().size(), 8);
+    EXPECT_EQ(recording.getEntries()[1].type, SessionRecording::EntryType::PaintSingleColor);
+    EXPECT_TRUE(recording.getEntries()[1].join);
+    EXPECT_EQ(recording.getEntries()[2].type, SessionRecording::EntryType::ChangeColor);
+    EXPECT_EQ(recording.getEntries()[3].type, SessionRecording::EntryType::Skipped);
+    EXPECT_EQ(recording.getEntries()[5].type, SessionRecording::EntryType::Undo);
+    EXPECT_EQ(recording.getEntries()[7].type, SessionRecording::EntryType::Redo);
+
+    Geometry replayedGeometry(test::getGeometryWithSquare());
+    CommandManager<Geometry> replayedCommandManager(replayedGeometry);
+    const std::vector<SessionRecording::Timing> timings =
+        recording.replay(replayedGeometry, replayedCommandManager);
+    ASSERT_EQ(timings.size(), 8);
+    EXPECT_EQ(timings[5].description, "Undo");
+    for(const SessionRecording::Timing& timing : timings) {
+        EXPECT_GE(timing.commandMilliseconds, 0.0);
+        EXPECT_GE(timing.buffersMilliseconds, 0.0);
+    }
+    EXPECT_EQ(replayedGeometry.getTriangleColor(0), geometry.getTriangleColor(0));
+    EXPECT_EQ(replayedGeometry.getTriangleColor(1), geometry.getTriangleColor(1));
+    EXPECT_EQ(replayedGeometry.getColorManager().getColor(0), glm::vec4(1.f));
+    EXPECT_EQ(replayedCommandManager.getHistorySize(), commandManager.getHistorySize());
+
+    std::stringstream timingsStream;
+    SessionRecording::writeTimings(timingsStream, timings);
+    EXPECT_NE(timingsStream.str().find("\"description\":\"Undo\""), std::string::npos);
+}
+
+TEST(SessionRecording, saveEntries) {
+    /**
+     * Test that the data of the brush, text and detailed triangle entries is saved and loaded
+     */
+
+    SessionRecording recording(42);
+    SessionRecording::Entry brush;
+    brush.type = SessionRecording::EntryType::PaintBrush;
+    brush.description = "Paint with a brush";
+    brush.rays = {ci::Ray(glm::vec3(0.f, 0.f, 2.f), glm::vec3(0.f, 0.f, -1.f))};
+    brush.brushSettings.size = 0.5f;
+    brush.brushSettings.spherical = false;
+    recording.addEntry(brush);
+
+    SessionRecording::Entry singleColor;
+    singleColor.type = SessionRecording::EntryType::PaintSingleColor;
+    singleColor.triangleIds = {DetailedTriangleId(3), DetailedTriangleId(4, 2)};
+    singleColor.color = 3;
+    recording.addEntry(singleColor);
+
+    SessionRecording::Entry text;
+    text.type = SessionRecording::EntryType::PaintText;
+    text.ray = ci::Ray(glm::vec3(1.f), glm::vec3(-1.f, 0.f, 0.f));
+    text.text = {{glm::vec3(0.f), glm::vec3(1.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f)}};
+    text.color = 2;
+    recording.addEntry(text);
+
+    std::stringstream stream;
+    recording.save(stream);
+    const SessionRecording loaded = SessionRecording::load(stream);
+    EXPECT_EQ(loaded.getModelHash(), 42);
+    ASSERT_EQ(loaded.getEntries().size(), 3);
+
+    const SessionRecording::Entry& loadedBrush = loaded.getEntries()[0];
+    EXPECT_EQ(loadedBrush.description, brush.description);
+    EXPECT_TRUE(loadedBrush.brushSettings == brush.brushSettings);
+    ASSERT_EQ(loadedBrush.rays.size(), 1);
+    EXPECT_EQ(loadedBrush.rays[0].getOrigin(), brush.rays[0].getOrigin());
+    EXPECT_EQ(loadedBrush.rays[0].getDirection(), brush.rays[0].getDirection());
+
+    EXPECT_EQ(loaded.getEntries()[1].triangleIds, singleColor.triangleIds);
+    EXPECT_EQ(loaded.getEntries()[1].color, 3);
+
+    EXPECT_EQ(loaded.getEntries()[2].text, text.text);
+    EXPECT_EQ(loaded.getEntries()[2].ray.getOrigin(), text.ray.getOrigin());
+    EXPECT_EQ(loaded.getEntries()[2].color, 2);
+
+    std::stringstream corrupted("{\"version\": 1, \"modelHash\": \"none\"}");
+    EXPECT_THROW(SessionRecording::load(corrupted), std::runtime_error);
+}
+
+TEST(SessionRecording, differentModel) {
+    /**
+     * Test that a session is not replayed on a different model
+     */
+
+    Geometry geometry(test::getGeometryWithSquare());
+    Geometry otherGeometry(test::getGeometryWithSquare(1.f));
+    EXPECT_EQ(geometry.getModelHash(), Geometry(test::getGeometryWithSquare()).getModelHash());
+    EXPECT_NE(geometry.getModelHash(), otherGeometry.getModelHash());
+
+    const SessionRecording recording(geometry.getModelHash());
+    CommandManager<Geometry> commandManager(otherGeometry);
+    EXPECT_THROW(recording.replay(otherGeometry, commandManager), std::runtime_error);
+}
+
+TEST(SessionRecording, saveSweptBrush) {
+    /**
+     * Test that a swept brush stroke is recorded as its own entry type and keeps its setting when loaded
+     */
+
+    BrushSettings settings;
+    settings.sweptStroke = true;
+    const CmdPaintBrush command(ci::Ray(glm::vec3(0.f, 0.f, 2.f), glm::vec3(0.f, 0.f, -1.f)), settings);
+    SessionRecording recording(42);
+    recording.addEntry(SessionRecording::createEntry(command, false));
+    EXPECT_EQ(recording.getEntries()[0].type, SessionRecording::EntryType::PaintSweptBrush);
+
+    std::stringstream stream;
+    recording.save(stream);
+    const SessionRecording loaded = SessionRecording::load(stream);
+    ASSERT_EQ(loaded.getEntries().size(), 1);
+    EXPECT_TRUE(loaded.getEntries()[0].brushSettings == settings);
+
+    const SessionRecording::Entry journalEntry = SessionRecording::loadEntry(SessionRecording::saveEntry(
+        SessionRecording::createEntry(CmdPaintBrush(command.getRays(), BrushSettings()), false)));
+    EXPECT_EQ(journalEntry.type, SessionRecording::EntryType::PaintBrush);
+    EXPECT_FALSE(journalEntry.brushSettings.sweptStroke);
+}
+
+}  // namespace pepr3d
+
+#endif
@@ -0,0 +1,569 @@
+#include "geometry/BinaryMeshImporter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <boost/functional/hash.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cctype>
+#include <cstring>
+#include <numeric>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+
+#include "geometry/VertexWelder.h"
+#include "peprassert.h"
+
+namespace pepr3d {
+
+namespace {
+const size_t STL_HEADER_SIZE = 80;
+const size_t STL_RECORD_SIZE = 50;
+
+/// Records decoded by a single item of parallel_for
+const size_t CHUNK_RECORDS = 16384;
+
+bool isLittleEndianHost() {
+    const std::uint16_t one = 1;
+    std::uint8_t firstByte;
+    std::memcpy(&firstByte, &one, 1);
+    return firstByte == 1;
+}
+
+template <typename T>
+T readValue(const char* data) {
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+glm::vec3 readVec3(const char* data) {
+    return glm::vec3(readValue<float>(data), readValue<float>(data + 4), readValue<float>(data + 8));
+}
+
+/// Items for parallel_for, each one the chunk of records [CHUNK_RECORDS * id, CHUNK_RECORDS * (id + 1))
+std::vector<size_t> getChunkIds(const size_t count) {
+    std::vector<size_t> chunkIds((count + CHUNK_RECORDS - 1) / CHUNK_RECORDS);
+    std::iota(chunkIds.begin(), chunkIds.end(), 0);
+    return chunkIds;
+}
+
+template <typename Func>
+void forEachInChunks(const size_t count, ::ThreadPool& threadPool, Func func) {
+    const std::vector<size_t> chunkIds = getChunkIds(count);
+    threadPool.parallel_for(chunkIds.begin(), chunkIds.end(), [&func, count](const size_t chunk) {
+        const size_t end = std::min(count, CHUNK_RECORDS * (chunk + 1));
+        for(size_t i = CHUNK_RECORDS * chunk; i < end; ++i) {
+            func(i);
+        }
+    });
+}
+
+/// Write the kept records to consecutive outputs in their order. The records are tested by isKept(i) in parallel,
+/// allocate(keptCount) prepares the outputs or returns false to stop, then write(i, outputIdx) writes in parallel.
+template <typename IsKept, typename Allocate, typename Write>
+bool compactRecords(const size_t count, ::ThreadPool& threadPool, IsKept isKept, Allocate allocate, Write write) {
+    const std::vector<size_t> chunkIds = getChunkIds(count);
+    std::vector<size_t> chunkOffsets(chunkIds.size() + 1, 0);
+    std::vector<std::uint8_t> kept(count);
+    threadPool.parallel_for(chunkIds.begin(), chunkIds.end(), [&](const size_t chunk) {
+        const size_t end = std::min(count, CHUNK_RECORDS * (chunk + 1));
+        size_t keptCount = 0;
+        for(size_t i = CHUNK_RECORDS * chunk; i < end; ++i) {
+            kept[i] = isKept(i) ? 1 : 0;
+            keptCount += kept[i];
+        }
+        chunkOffsets[chunk + 1] = keptCount;
+    });
+    std::partial_sum(chunkOffsets.begin(), chunkOffsets.end(), chunkOffsets.begin());
+
+    if(!allocate(chunkOffsets.back())) {
+        return false;
+    }
+    threadPool.parallel_for(chunkIds.begin(), chunkIds.end(), [&](const size_t chunk) {
+        const size_t end = std::min(count, CHUNK_RECORDS * (chunk + 1));
+        size_t outputIdx = chunkOffsets[chunk];
+        for(size_t i = CHUNK_RECORDS * chunk; i < end; ++i) {
+            if(kept[i]) {
+                write(i, outputIdx++);
+            }
+        }
+    });
+    return true;
+}
+
+std::string getLowerCaseExtension(const std::string& path) {
+    const size_t dot = path.find_last_of('.');
+    if(dot == std::string::npos) {
+        return "";
+    }
+    std::string extension = path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](const unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension;
+}
+
+enum class PlyType { INVALID, INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT32, FLOAT64 };
+
+PlyType getPlyType(const std::string& name) {
+    if(name == "char" || name == "int8") {
+        return PlyType::INT8;
+    } else if(name == "uchar" || name == "uint8") {
+        return PlyType::UINT8;
+    } else if(name == "short" || name == "int16") {
+        return PlyType::INT16;
+    } else if(name == "ushort" || name == "uint16") {
+        return PlyType::UINT16;
+    } else if(name == "int" || name == "int32") {
+        return PlyType::INT32;
+    } else if(name == "uint" || name == "uint32") {
+        return PlyType::UINT32;
+    } else if(name == "float" || name == "float32") {
+        return PlyType::FLOAT32;
+    } else if(name == "double" || name == "float64") {
+        return PlyType::FLOAT64;
+    }
+    return PlyType::INVALID;
+}
+
+size_t getPlyTypeSize(const PlyType type) {
+    switch(type) {
+        case PlyType::INT8:
+        case PlyType::UINT8: return 1;
+        case PlyType::INT16:
+        case PlyType::UINT16: return 2;
+        case PlyType::INT32:
+        case PlyType::UINT32:
+        case PlyType::FLOAT32: return 4;
+        case PlyType::FLOAT64: return 8;
+        default: return 0;
+    }
+}
+
+bool isPlyInteger(const PlyType type) {
+    return type != PlyType::INVALID && type != PlyType::FLOAT32 && type != PlyType::FLOAT64;
+}
+
+double readPlyValue(const PlyType type, const char* data) {
+    switch(type) {
+        case PlyType::INT8: return readValue<std::int8_t>(data);
+        case PlyType::UINT8: return readValue<std::uint8_t>(data);
+        case PlyType::INT16: return readValue<std::int16_t>(data);
+        case PlyType::UINT16: return readValue<std::uint16_t>(data);
+        case PlyType::INT32: return readValue<std::int32_t>(data);
+        case PlyType::UINT32: return readValue<std::uint32_t>(data);
+        case PlyType::FLOAT32: return readValue<float>(data);
+        case PlyType::FLOAT64: return readValue<double>(data);
+        default: P_ASSERT(false); return 0.0;
+    }
+}
+
+struct PlyProperty {
+    std::string name;
+
+    /// Type of the value, or of the items of a list
+    PlyType type = PlyType::INVALID;
+
+    bool isList = false;
+    PlyType countType = PlyType::INVALID;
+
+    /// Offset within the record of the element
+    size_t offset = 0;
+};
+
+struct PlyElement {
+    std::string name;
+    size_t count = 0;
+    std::vector<PlyProperty> properties;
+
+    /// Size of each record, lists are expected to have 3 items
+    size_t recordSize = 0;
+
+    const PlyProperty* findProperty(const std::string& propertyName) const {
+        const auto found = std::find_if(properties.begin(), properties.end(),
+                                        [&propertyName](const PlyProperty& p) { return p.name == propertyName; });
+        return found == properties.end() ? nullptr : &*found;
+    }
+};
+}  // namespace
+
+bool BinaryMeshImporter::hasSupportedExtension(const std::string& path) {
+    const std::string extension = getLowerCaseExtension(path);
+    return extension == "stl" || extension == "ply";
+}
+
+std::optional<BinaryMeshImporter::Mesh> BinaryMeshImporter::import(const std::string& path,
+                                                                   GeometryProgress* progress,
+                                                                   ::ThreadPool& threadPool) {
+    if(!hasSupportedExtension(path)) {
+        return {};
+    }
+    const bool isPly = getLowerCaseExtension(path) == "ply";
+
+    try {
+        const boost::interprocess::file_mapping file(path.c_str(), boost::interprocess::read_only);
+        const boost::interprocess::mapped_region region(file, boost::interprocess::read_only);
+        return importFromMemory(static_cast<const char*>(region.get_address()), region.get_size(), isPly, progress,
+                                threadPool);
+    } catch(const boost::interprocess::interprocess_exception&) {
+        // Empty or unreadable files are reported by ModelImporter
+        return {};
+    }
+}
+
+std::optional<BinaryMeshImporter::Mesh> BinaryMeshImporter::importFromMemory(const char* data, const size_t size,
+                                                                             const bool isPly,
+                                                                             GeometryProgress* progress,
+                                                                             ::ThreadPool& threadPool) {
+    if(!isLittleEndianHost()) {
+        return {};
+    }
+
+    std::optional<Soup> soup = isPly ? readPly(data, size, threadPool) : readStl(data, size, threadPool);
+    if(!soup || soup->triangleVertices.empty()) {
+        return {};
+    }
+    return finish(std::move(*soup), progress, threadPool);
+}
+
+std::optional<BinaryMeshImporter::Soup> BinaryMeshImporter::readStl(const char* data, const size_t size,
+                                                                    ::ThreadPool& threadPool) {
+    if(size < STL_HEADER_SIZE + 4) {
+        return {};
+    }
+    const size_t count = readValue<std::uint32_t>(data + STL_HEADER_SIZE);
+    const size_t expectedSize = STL_HEADER_SIZE + 4 + STL_RECORD_SIZE * count;
+
+    // ASCII files start with "solid", binary files may too, but then their size has to match exactly
+    const bool startsWithSolid = std::string_view(data, 5) == "solid";
+    if(size < expectedSize || (startsWithSolid && size != expectedSize)) {
+        return {};
+    }
+
+    // Vertices follow the normal of each record, the attribute bytes are at the end
+    const char* const records = data + STL_HEADER_SIZE + 4;
+    std::atomic<bool> hasAttributes{false};
+    Soup soup;
+    const bool isRead = compactRecords(
+        count, threadPool,
+        [records, &hasAttributes](const size_t i) {
+            const char* const record = records + STL_RECORD_SIZE * i;
+            if(readValue<std::uint16_t>(record + 48) != 0) {
+                hasAttributes = true;
+            }
+            return !isDegenerate(readVec3(record + 12), readVec3(record + 24), readVec3(record + 36));
+        },
+        [&soup, &hasAttributes](const size_t keptCount) {
+            // The colors of the attributes are left to Assimp
+            if(hasAttributes) {
+                return false;
+            }
+            soup.triangleVertices.resize(3 * keptCount);
+            return true;
+        },
+        [records, &soup](const size_t i, const size_t outputIdx) {
+            const char* const record = records + STL_RECORD_SIZE * i;
+            for(size_t k = 0; k < 3; ++k) {
+                soup.triangleVertices[3 * outputIdx + k] = readVec3(record + 12 + 12 * k);
+            }
+        });
+    if(!isRead) {
+        return {};
+    }
+    return soup;
+}
+
+std::optional<BinaryMeshImporter::Soup> BinaryMeshImporter::readPly(const char* data, const size_t size,
+                                                                    ::ThreadPool& threadPool) {
+    const std::string_view file(data, size);
+    if(file.substr(0, 3) != "ply") {
+        return {};
+    }
+    const size_t headerEnd = file.find("end_header");
+    if(headerEnd == std::string_view::npos) {
+        return {};
+    }
+    const size_t dataStart = file.find('\n', headerEnd);
+    if(dataStart == std::string_view::npos) {
+        return {};
+    }
+
+    // Elements with their records in the order of the file
+    std::vector<PlyElement> elements;
+    bool isBinaryLittleEndian = false;
+    std::istringstream header{std::string(file.substr(0, headerEnd))};
+    std::string line;
+    while(std::getline(header, line)) {
+        std::istringstream words(line);
+        std::string keyword;
+        words >> keyword;
+        if(keyword == "format") {
+            std::string format;
+            words >> format;
+            isBinaryLittleEndian = format == "binary_little_endian";
+        } else if(keyword == "element") {
+            PlyElement element;
+            if(!(words >> element.name >> element.count)) {
+                return {};
+            }
+            elements.push_back(element);
+        } else if(keyword == "property") {
+            if(elements.empty()) {
+                return {};
+            }
+            PlyElement& element = elements.back();
+            PlyProperty property;
+            std::string type;
+            words >> type;
+            if(type == "list") {
+                std::string countType, itemType;
+                words >> countType >> itemType;
+                property.isList = true;
+                property.countType = getPlyType(countType);
+                property.type = getPlyType(itemType);
+            } else {
+                property.type = getPlyType(type);
+            }
+            words >> property.name;
+            if(property.type == PlyType::INVALID || (property.isList && property.countType == PlyType::INVALID)) {
+                return {};
+            }
+            property.offset = element.recordSize;
+            element.recordSize += property.isList
+                                      ? getPlyTypeSize(property.countType) + 3 * getPlyTypeSize(property.type)
+                                      : getPlyTypeSize(property.type);
+            element.properties.push_back(property);
+        }
+    }
+    if(!isBinaryLittleEndian) {
+        return {};
+    }
+
+    // Only the faces may have a list, which is fixed-size if all of them are triangles
+    const char* vertexData = nullptr;
+    const char* faceData = nullptr;
+    const PlyElement* vertexElement = nullptr;
+    const PlyElement* faceElement = nullptr;
+    size_t offset = dataStart + 1;
+    for(const PlyElement& element : elements) {
+        const bool hasList = std::any_of(element.properties.begin(), element.properties.end(),
+                                         [](const PlyProperty& p) { return p.isList; });
+        if(element.name == "vertex" && !hasList) {
+            vertexElement = &element;
+            vertexData = data + offset;
+        } else if(element.name == "face" && hasList) {
+            faceElement = &element;
+            faceData = data + offset;
+        } else if(hasList) {
+            return {};
+        }
+        if(element.recordSize > 0 && element.count > (size - offset) / element.recordSize) {
+            return {};
+        }
+        offset += element.count * element.recordSize;
+    }
+    if(vertexElement == nullptr || faceElement == nullptr) {
+        return {};
+    }
+
+    const PlyProperty* const coordinates[3] = {vertexElement->findProperty("x"), vertexElement->findProperty("y"),
+                                               vertexElement->findProperty("z")};
+    const PlyProperty* const colors[3] = {vertexElement->findProperty("red"), vertexElement->findProperty("green"),
+                                          vertexElement->findProperty("blue")};
+    const PlyProperty* indices = faceElement->findProperty("vertex_indices");
+    if(indices == nullptr) {
+        indices = faceElement->findProperty("vertex_index");
+    }
+    if(std::find(std::begin(coordinates), std::end(coordinates), nullptr) != std::end(coordinates) ||
+       indices == nullptr || !indices->isList || !isPlyInteger(indices->type) || !isPlyInteger(indices->countType) ||
+       std::count_if(faceElement->properties.begin(), faceElement->properties.end(),
+                     [](const PlyProperty& p) { return p.isList; }) != 1) {
+        return {};
+    }
+    const bool hasColors = colors[0] != nullptr && colors[1] != nullptr && colors[2] != nullptr;
+    if(hasColors && std::any_of(std::begin(colors), std::end(colors),
+                                [](const PlyProperty* p) { return p->type != PlyType::UINT8; })) {
+        // Assimp scales other types of colors differently
+        return {};
+    }
+
+    const size_t vertexCount = vertexElement->count;
+    std::vector<glm::vec3> positions(vertexCount);
+    std::vector<glm::vec4> vertexColors(hasColors ? vertexCount : 0);
+    forEachInChunks(vertexCount, threadPool, [&](const size_t vertexIdx) {
+        const char* const record = vertexData + vertexElement->recordSize * vertexIdx;
+        for(size_t k = 0; k < 3; ++k) {
+            positions[vertexIdx][k] =
+                static_cast<float>(readPlyValue(coordinates[k]->type, record + coordinates[k]->offset));
+        }
+        if(hasColors) {
+            vertexColors[vertexIdx] = glm::vec4(readValue<std::uint8_t>(record + colors[0]->offset) / 255.f,
+                                                readValue<std::uint8_t>(record + colors[1]->offset) / 255.f,
+                                                readValue<std::uint8_t>(record + colors[2]->offset) / 255.f, 1.f);
+        }
+    });
+
+    const size_t countSize = getPlyTypeSize(indices->countType);
+    const size_t indexSize = getPlyTypeSize(indices->type);
+    const auto readFace = [&](const size_t faceIdx, std::array<size_t, 3>& face) {
+        const char* const list = faceData + faceElement->recordSize * faceIdx + indices->offset;
+        if(readPlyValue(indices->countType, list) != 3.0) {
+            return false;
+        }
+        for(size_t k = 0; k < 3; ++k) {
+            const double index = readPlyValue(indices->type, list + countSize + indexSize * k);
+            if(index < 0.0 || index >= static_cast<double>(vertexCount)) {
+                return false;
+            }
+            face[k] = static_cast<size_t>(index);
+        }
+        return true;
+    };
+
+    std::atomic<bool> isFixedSize{true};
+    Soup soup;
+    const bool isRead = compactRecords(
+        faceElement->count, threadPool,
+        [&](const size_t faceIdx) {
+            std::array<size_t, 3> face;
+            if(!readFace(faceIdx, face)) {
+                isFixedSize = false;
+                return false;
+            }
+            return !isDegenerate(positions[face[0]], positions[face[1]], positions[face[2]]);
+        },
+        [&](const size_t keptCount) {
+            // Faces other than triangles, or indices out of bounds
+            if(!isFixedSize) {
+                return false;
+            }
+            soup.triangleVertices.resize(3 * keptCount);
+            soup.triangleColors.resize(hasColors ? keptCount : 0);
+            return true;
+        },
+        [&](const size_t faceIdx, const size_t outputIdx) {
+            std::array<size_t, 3> face;
+            readFace(faceIdx, face);
+            for(size_t k = 0; k < 3; ++k) {
+                soup.triangleVertices[3 * outputIdx + k] = positions[face[k]];
+            }
+            if(hasColors) {
+                soup.triangleColors[outputIdx] = vertexColors[face[0]];
+            }
+        });
+    if(!isRead) {
+        return {};
+    }
+    return soup;
+}
+
+BinaryMeshImporter::Mesh BinaryMeshImporter::finish(Soup soup, GeometryProgress* progress,
+                                                    ::ThreadPool& threadPool) {
+    Mesh mesh;
+    mesh.triangleVertices = std::move(soup.triangleVertices);
+    std::vector<glm::vec3>& vertices = mesh.triangleVertices;
+    const size_t triangleCount = vertices.size() / 3;
+    if(progress != nullptr) {
+        progress->importRenderPercentage = 0.5f;
+    }
+
+    mesh.triangleNormals.resize(triangleCount);
+    forEachInChunks(triangleCount, threadPool, [&](const size_t triIdx) {
+        const glm::vec3& first = vertices[3 * triIdx];
+        mesh.triangleNormals[triIdx] =
+            glm::normalize(glm::cross(vertices[3 * triIdx + 1] - first, vertices[3 * triIdx + 2] - first));
+    });
+    if(isFacingInwards(vertices, mesh.triangleNormals, threadPool)) {
+        forEachInChunks(triangleCount, threadPool, [&](const size_t triIdx) {
+            std::swap(vertices[3 * triIdx + 1], vertices[3 * triIdx + 2]);
+            mesh.triangleNormals[triIdx] = -mesh.triangleNormals[triIdx];
+        });
+    }
+
+    // The palette in the order of the first triangle of each color, as ModelImporter builds it
+    mesh.triangleColors.assign(triangleCount, 0);
+    std::unordered_map<std::array<float, 3>, std::uint8_t, boost::hash<std::array<float, 3>>> colorLookup;
+    for(size_t triIdx = 0; triIdx < soup.triangleColors.size(); ++triIdx) {
+        const glm::vec4& color = soup.triangleColors[triIdx];
+        const std::array<float, 3> rgb = {color.r, color.g, color.b};
+        auto found = colorLookup.find(rgb);
+        if(found == colorLookup.end()) {
+            if(mesh.paletteColors.size() < MAX_COLORS) {
+                mesh.paletteColors.push_back(color);
+            }
+            found = colorLookup.insert({rgb, static_cast<std::uint8_t>(mesh.paletteColors.size() - 1)}).first;
+        }
+        mesh.triangleColors[triIdx] = found->second;
+    }
+    if(progress != nullptr) {
+        progress->importRenderPercentage = 1.0f;
+        progress->importComputePercentage = 0.0f;
+    }
+
+    const VertexWelder welder(vertices, threadPool);
+    mesh.vertexBuffer = welder.getVertices();
+    mesh.indexBuffer.resize(triangleCount);
+    const std::vector<size_t>& weldedIndices = welder.getIndices();
+    forEachInChunks(triangleCount, threadPool, [&](const size_t triIdx) {
+        mesh.indexBuffer[triIdx] = {weldedIndices[3 * triIdx], weldedIndices[3 * triIdx + 1],
+                                    weldedIndices[3 * triIdx + 2]};
+    });
+    if(progress != nullptr) {
+        progress->importComputePercentage = 1.0f;
+    }
+    return mesh;
+}
+
+bool BinaryMeshImporter::isDegenerate(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    const double length = glm::length(glm::cross(b - a, c - a));
+    const bool verticesAreDifferent = a != b && a != c && b != c;
+    return !verticesAreDifferent || std::abs(length) < 0.000001 || std::isnan(length);
+}
+
+bool BinaryMeshImporter::isFacingInwards(const std::vector<glm::vec3>& triangleVertices,
+                                         const std::vector<glm::vec3>& triangleNormals, ::ThreadPool& threadPool) {
+    // Bounding boxes of the vertices and of the vertices moved along the normals, for each chunk of triangles
+    const size_t triangleCount = triangleNormals.size();
+    const std::vector<size_t> chunkIds = getChunkIds(triangleCount);
+    std::vector<std::array<glm::vec3, 4>> chunkBoxes(chunkIds.size());
+    threadPool.parallel_for(chunkIds.begin(), chunkIds.end(), [&](const size_t chunk) {
+        std::array<glm::vec3, 4> box = {glm::vec3(1e10f), glm::vec3(-1e10f), glm::vec3(1e10f), glm::vec3(-1e10f)};
+        const size_t end = std::min(triangleCount, CHUNK_RECORDS * (chunk + 1));
+        for(size_t triIdx = CHUNK_RECORDS * chunk; triIdx < end; ++triIdx) {
+            for(size_t k = 0; k < 3; ++k) {
+                const glm::vec3& vertex = triangleVertices[3 * triIdx + k];
+                box[0] = glm::min(box[0], vertex);
+                box[1] = glm::max(box[1], vertex);
+                box[2] = glm::min(box[2], vertex + triangleNormals[triIdx]);
+                box[3] = glm::max(box[3], vertex + triangleNormals[triIdx]);
+            }
+        }
+        chunkBoxes[chunk] = box;
+    });
+
+    std::array<glm::vec3, 4> box = {glm::vec3(1e10f), glm::vec3(-1e10f), glm::vec3(1e10f), glm::vec3(-1e10f)};
+    for(const auto& chunkBox : chunkBoxes) {
+        box[0] = glm::min(box[0], chunkBox[0]);
+        box[1] = glm::max(box[1], chunkBox[1]);
+        box[2] = glm::min(box[2], chunkBox[2]);
+        box[3] = glm::max(box[3], chunkBox[3]);
+    }
+    const glm::vec3 delta = box[1] - box[0];
+    const glm::vec3 deltaAlongNormals = box[3] - box[2];
+
+    // The boxes have to overlap and the mesh must not be planar
+    for(int axis = 0; axis < 3; ++axis) {
+        if((deltaAlongNormals[axis] > 0.f) != (delta[axis] > 0.f)) {
+            return false;
+        }
+    }
+    if(delta.x < 0.05f * std::sqrt(delta.y * delta.z) || delta.y < 0.05f * std::sqrt(delta.z * delta.x) ||
+       delta.z < 0.05f * std::sqrt(delta.y * delta.x)) {
+        return false;
+    }
+    return std::abs(deltaAlongNormals.x * deltaAlongNormals.y * deltaAlongNormals.z) <
+           std::abs(delta.x * delta.y * delta.z);
+}
+
+}  // namespace pepr3d
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "geometry/GeometryProgress.h"
+
+namespace pepr3d {
+
+/// Native import of binary STL and binary little endian PLY files, the usual output of 3D scanners.
+/// The file is memory mapped, its fixed-size records are decoded on the thread pool and written directly into the
+/// buffers of the Geometry, without the intermediate aiScene of ModelImporter. The result matches ModelImporter:
+/// degenerate triangles are left out, inward facing meshes are turned outwards, triangles take the color of their
+/// first vertex and identical vertices are welded.
+/// Other files are left to ModelImporter, also STL files with colored facets and PLY files with faces other than
+/// triangles, since their records do not have a fixed size.
+class BinaryMeshImporter {
+   public:
+    /// Limit of the palette, colors above it take the last color, as in ModelImporter
+    static constexpr size_t MAX_COLORS = 16;
+
+    struct Mesh {
+        /// 3 consecutive vertices of each triangle
+        std::vector<glm::vec3> triangleVertices;
+
+        /// Normal of each triangle
+        std::vector<glm::vec3> triangleNormals;
+
+        /// Index of the color of each triangle in paletteColors, 0 if the file has no colors
+        std::vector<std::uint8_t> triangleColors;
+
+        /// Colors of the file in the order of their first triangle, empty if the file has no colors
+        std::vector<glm::vec4> paletteColors;
+
+        /// Welded vertices and the triangles indexing them, the same triangles as above
+        std::vector<glm::vec3> vertexBuffer;
+        std::vector<std::array<size_t, 3>> indexBuffer;
+    };
+
+    /// Whether the extension of the path is one of the supported formats
+    static bool hasSupportedExtension(const std::string& path);
+
+    /// Import the file, empty if it cannot be read or is not supported. Reports to importRenderPercentage while
+    /// decoding the triangles and to importComputePercentage while welding the vertices.
+    static std::optional<Mesh> import(const std::string& path, GeometryProgress* progress, ::ThreadPool& threadPool);
+
+    /// Import from file contents already in memory, see import()
+    /// @param isPly Whether the contents are a PLY file, otherwise an STL file
+    static std::optional<Mesh> importFromMemory(const char* data, size_t size, bool isPly, GeometryProgress* progress,
+                                                ::ThreadPool& threadPool);
+
+   private:
+    /// Triangles of the file before the orientation and the welding
+    struct Soup {
+        std::vector<glm::vec3> triangleVertices;
+
+        /// Color of the first vertex of each triangle, empty if the file has no colors
+        std::vector<glm::vec4> triangleColors;
+    };
+
+    static std::optional<Soup> readStl(const char* data, size_t size, ::ThreadPool& threadPool);
+    static std::optional<Soup> readPly(const char* data, size_t size, ::ThreadPool& threadPool);
+
+    /// Compute the normals, turn the mesh outwards, assign the palette and weld the vertices
+    static Mesh finish(Soup soup, GeometryProgress* progress, ::ThreadPool& threadPool);
+
+    /// Same test as ModelImporter, triangles with identical vertices or a tiny area are left out
+    static bool isDegenerate(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c);
+
+    /// The heuristic of Assimp's aiProcess_FixInfacingNormals: the mesh faces inwards if moving its vertices along
+    /// their normals shrinks its bounding box
+    static bool isFacingInwards(const std::vector<glm::vec3>& triangleVertices,
+                                const std::vector<glm::vec3>& triangleNormals, ::ThreadPool& threadPool);
+};
+
+}  // namespace pepr3d
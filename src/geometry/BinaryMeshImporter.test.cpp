@@ -0,0 +1,220 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "geometry/BinaryMeshImporter.h"
+
+namespace {
+/// Closed mesh with its triangles oriented outwards
+struct Shape {
+    std::vector<glm::vec3> corners;
+    std::vector<std::array<uint32_t, 3>> triangles;
+    glm::vec3 center;
+};
+
+/// A 2 x 3 x 4 box, the bottom corners first. Moving its vertices along the face normals keeps its bounding box, so
+/// the box is never turned.
+Shape getBox() {
+    return {{glm::vec3(0, 0, 0), glm::vec3(2, 0, 0), glm::vec3(2, 3, 0), glm::vec3(0, 3, 0), glm::vec3(0, 0, 4),
+             glm::vec3(2, 0, 4), glm::vec3(2, 3, 4), glm::vec3(0, 3, 4)},
+            {{0, 2, 1}, {0, 3, 2}, {4, 5, 6}, {4, 6, 7}, {0, 1, 5}, {0, 5, 4}, {1, 2, 6}, {1, 6, 5}, {2, 3, 7},
+             {2, 7, 6}, {3, 0, 4}, {3, 4, 7}},
+            glm::vec3(1.f, 1.5f, 2.f)};
+}
+
+/// Octahedron with the corners +x, -x, +y, -y, +z, -z
+Shape getOctahedron() {
+    Shape octahedron{{glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, -1, 0),
+                      glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)},
+                     {},
+                     glm::vec3(0.f)};
+    for(uint32_t x = 0; x < 2; ++x) {
+        for(uint32_t y = 2; y < 4; ++y) {
+            for(uint32_t z = 4; z < 6; ++z) {
+                // An odd number of negative axes turns the winding
+                const bool isTurned = (x + y + z) % 2 == 1;
+                octahedron.triangles.push_back(isTurned ? std::array<uint32_t, 3>{x, z, y}
+                                                        : std::array<uint32_t, 3>{x, y, z});
+            }
+        }
+    }
+    return octahedron;
+}
+
+template <typename T>
+void append(std::string& data, const T value) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    data.append(bytes, sizeof(T));
+}
+
+/// Binary STL of the shape with a degenerate triangle, inwards if isInverted
+std::string getStl(const Shape& shape, const bool isInverted, const uint16_t attribute = 0) {
+    std::string data(80, ' ');
+    append(data, static_cast<uint32_t>(shape.triangles.size() + 1));
+    for(size_t triIdx = 0; triIdx <= shape.triangles.size(); ++triIdx) {
+        // The normals of the file are ignored
+        append(data, 0.f);
+        append(data, 0.f);
+        append(data, 0.f);
+        std::array<uint32_t, 3> triangle =
+            triIdx < shape.triangles.size() ? shape.triangles[triIdx] : std::array<uint32_t, 3>{0, 1, 1};
+        if(isInverted) {
+            std::swap(triangle[1], triangle[2]);
+        }
+        for(const uint32_t corner : triangle) {
+            append(data, shape.corners[corner].x);
+            append(data, shape.corners[corner].y);
+            append(data, shape.corners[corner].z);
+        }
+        append(data, attribute);
+    }
+    return data;
+}
+
+/// Binary PLY of the box, the top corners are red, the bottom ones white
+std::string getBoxPly(const uint8_t faceSize = 3) {
+    std::string data =
+        "ply\nformat binary_little_endian 1.0\ncomment box\nelement vertex 8\nproperty float x\nproperty float y\n"
+        "property float z\nproperty uchar red\nproperty uchar green\nproperty uchar blue\nelement face 12\n"
+        "property list uchar int vertex_indices\nproperty uchar flags\nend_header\n";
+    const Shape box = getBox();
+    for(size_t cornerIdx = 0; cornerIdx < box.corners.size(); ++cornerIdx) {
+        append(data, box.corners[cornerIdx].x);
+        append(data, box.corners[cornerIdx].y);
+        append(data, box.corners[cornerIdx].z);
+        const uint8_t greenBlue = cornerIdx < 4 ? 255 : 0;
+        append<uint8_t>(data, 255);
+        append(data, greenBlue);
+        append(data, greenBlue);
+    }
+    for(const auto& triangle : box.triangles) {
+        append(data, faceSize);
+        for(const uint32_t corner : triangle) {
+            append(data, static_cast<int32_t>(corner));
+        }
+        append<uint8_t>(data, 0);
+    }
+    return data;
+}
+
+/// Test that the mesh is the shape with outward normals and welded vertices
+void expectShape(const pepr3d::BinaryMeshImporter::Mesh& mesh, const Shape& shape) {
+    const size_t triangleCount = shape.triangles.size();
+    ASSERT_EQ(mesh.triangleVertices.size(), 3 * triangleCount);
+    ASSERT_EQ(mesh.triangleNormals.size(), triangleCount);
+    ASSERT_EQ(mesh.triangleColors.size(), triangleCount);
+    ASSERT_EQ(mesh.indexBuffer.size(), triangleCount);
+    EXPECT_EQ(mesh.vertexBuffer.size(), shape.corners.size());
+
+    for(size_t triIdx = 0; triIdx < triangleCount; ++triIdx) {
+        const glm::vec3 centroid = (mesh.triangleVertices[3 * triIdx] + mesh.triangleVertices[3 * triIdx + 1] +
+                                    mesh.triangleVertices[3 * triIdx + 2]) *
+                                   (1.f / 3.f);
+        EXPECT_GT(glm::dot(mesh.triangleNormals[triIdx], centroid - shape.center), 0.f);
+        const glm::vec3 winding =
+            glm::cross(mesh.triangleVertices[3 * triIdx + 1] - mesh.triangleVertices[3 * triIdx],
+                       mesh.triangleVertices[3 * triIdx + 2] - mesh.triangleVertices[3 * triIdx]);
+        EXPECT_GT(glm::dot(winding, mesh.triangleNormals[triIdx]), 0.f);
+        for(size_t k = 0; k < 3; ++k) {
+            EXPECT_EQ(mesh.vertexBuffer[mesh.indexBuffer[triIdx][k]], mesh.triangleVertices[3 * triIdx + k]);
+        }
+    }
+}
+}  // namespace
+
+TEST(BinaryMeshImporter, stl) {
+    /**
+     * Test that a binary STL is read without its degenerate triangle, and turned outwards if it faces inwards
+     */
+
+    ::ThreadPool threadPool(2);
+    for(const Shape& shape : {getBox(), getOctahedron()}) {
+        const std::string stl = getStl(shape, false);
+        const auto mesh =
+            pepr3d::BinaryMeshImporter::importFromMemory(stl.data(), stl.size(), false, nullptr, threadPool);
+        ASSERT_TRUE(mesh);
+        expectShape(*mesh, shape);
+        EXPECT_TRUE(mesh->paletteColors.empty());
+    }
+    const std::string inverted = getStl(getOctahedron(), true);
+    const auto turned =
+        pepr3d::BinaryMeshImporter::importFromMemory(inverted.data(), inverted.size(), false, nullptr, threadPool);
+    ASSERT_TRUE(turned);
+    expectShape(*turned, getOctahedron());
+
+    // Colored facets, truncated and ASCII files are left to Assimp
+    const std::string colored = getStl(getBox(), false, 0x8000 | 31);
+    EXPECT_FALSE(pepr3d::BinaryMeshImporter::importFromMemory(colored.data(), colored.size(), false, nullptr,
+                                                              threadPool));
+    const std::string truncated = getStl(getBox(), false).substr(0, 200);
+    EXPECT_FALSE(pepr3d::BinaryMeshImporter::importFromMemory(truncated.data(), truncated.size(), false, nullptr,
+                                                              threadPool));
+    const std::string ascii =
+        "solid box\nfacet normal 0 0 1\nouter loop\nvertex 0 0 0\nvertex 1 0 0\nvertex 0 1 0\nendloop\nendfacet\n"
+        "endsolid box\n";
+    EXPECT_FALSE(pepr3d::BinaryMeshImporter::importFromMemory(ascii.data(), ascii.size(), false, nullptr, threadPool));
+}
+
+TEST(BinaryMeshImporter, ply) {
+    /**
+     * Test that a binary PLY is read with the colors of the first vertices, and that other faces are left to Assimp
+     */
+
+    ::ThreadPool threadPool(2);
+    pepr3d::GeometryProgress progress;
+    const std::string ply = getBoxPly();
+    const auto mesh = pepr3d::BinaryMeshImporter::importFromMemory(ply.data(), ply.size(), true, &progress, threadPool);
+    ASSERT_TRUE(mesh);
+    expectShape(*mesh, getBox());
+    EXPECT_EQ(progress.importRenderPercentage, 1.f);
+    EXPECT_EQ(progress.importComputePercentage, 1.f);
+
+    // The first triangle starts at a bottom corner
+    ASSERT_EQ(mesh->paletteColors.size(), 2);
+    EXPECT_EQ(mesh->paletteColors[0], glm::vec4(1.f, 1.f, 1.f, 1.f));
+    EXPECT_EQ(mesh->paletteColors[1], glm::vec4(1.f, 0.f, 0.f, 1.f));
+    for(size_t triIdx = 0; triIdx < 12; ++triIdx) {
+        EXPECT_EQ(mesh->triangleColors[triIdx], getBox().triangles[triIdx][0] < 4 ? 0 : 1);
+    }
+
+    const std::string quads = getBoxPly(4);
+    EXPECT_FALSE(pepr3d::BinaryMeshImporter::importFromMemory(quads.data(), quads.size(), true, nullptr, threadPool));
+    std::string ascii = ply;
+    ascii.replace(ascii.find("binary_little_endian"), 20, "ascii");
+    EXPECT_FALSE(pepr3d::BinaryMeshImporter::importFromMemory(ascii.data(), ascii.size(), true, nullptr, threadPool));
+}
+
+TEST(BinaryMeshImporter, mappedFile) {
+    /**
+     * Test that files are memory mapped by their extension
+     */
+
+    EXPECT_TRUE(pepr3d::BinaryMeshImporter::hasSupportedExtension("C:/models/Scan.STL"));
+    EXPECT_TRUE(pepr3d::BinaryMeshImporter::hasSupportedExtension("scan.ply"));
+    EXPECT_FALSE(pepr3d::BinaryMeshImporter::hasSupportedExtension("scan.obj"));
+    EXPECT_FALSE(pepr3d::BinaryMeshImporter::hasSupportedExtension("stl"));
+
+    ::ThreadPool threadPool(2);
+    const std::string path = ::testing::TempDir() + "pepr3d_binary_mesh_importer.stl";
+    {
+        std::ofstream file(path, std::ios::binary);
+        const std::string stl = getStl(getBox(), false);
+        file.write(stl.data(), stl.size());
+    }
+    const auto mesh = pepr3d::BinaryMeshImporter::import(path, nullptr, threadPool);
+    ASSERT_TRUE(mesh);
+    expectShape(*mesh, getBox());
+    std::remove(path.c_str());
+
+    EXPECT_FALSE(pepr3d::BinaryMeshImporter::import(path, nullptr, threadPool));
+}
+
+#endif
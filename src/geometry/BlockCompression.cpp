@@ -0,0 +1,247 @@
+#include "geometry/BlockCompression.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace pepr3d {
+namespace BlockCompression {
+
+namespace {
+/// Limits of the LZ4 block format
+const size_t MIN_MATCH = 4;
+const size_t MAX_OFFSET = 65535;
+
+/// The last bytes of a block are always literals and the last match starts at least MATCH_START_LIMIT bytes
+/// before the end
+const size_t LAST_LITERALS = 5;
+const size_t MATCH_START_LIMIT = 12;
+
+/// Length stored in the 4 bits of the token, longer lengths continue in the following bytes
+const size_t TOKEN_LENGTH_MASK = 15;
+
+const int HASH_BITS = 16;
+
+/// Misses after which the search skips more bytes at once, so that incompressible data is passed quickly
+const int SKIP_TRIGGER = 6;
+
+uint32_t read32(const unsigned char* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+size_t hashSequence(const uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+void writeLength(std::string& out, size_t length) {
+    for(; length >= 255; length -= 255) {
+        out.push_back(static_cast<char>(255));
+    }
+    out.push_back(static_cast<char>(length));
+}
+
+/// Writes the literals followed by a match, or only the literals if matchLength is 0
+void writeSequence(std::string& out, const unsigned char* literals, const size_t literalLength, const size_t offset,
+                   const size_t matchLength) {
+    const size_t matchCode = matchLength > 0 ? matchLength - MIN_MATCH : 0;
+    const size_t token = (std::min(literalLength, TOKEN_LENGTH_MASK) << 4) | std::min(matchCode, TOKEN_LENGTH_MASK);
+    out.push_back(static_cast<char>(token));
+    if(literalLength >= TOKEN_LENGTH_MASK) {
+        writeLength(out, literalLength - TOKEN_LENGTH_MASK);
+    }
+    out.append(reinterpret_cast<const char*>(literals), literalLength);
+    if(matchLength == 0) {
+        return;
+    }
+
+    out.push_back(static_cast<char>(offset & 0xFF));
+    out.push_back(static_cast<char>(offset >> 8));
+    if(matchCode >= TOKEN_LENGTH_MASK) {
+        writeLength(out, matchCode - TOKEN_LENGTH_MASK);
+    }
+}
+
+class Reader {
+   public:
+    explicit Reader(const std::string& data)
+        : mData(reinterpret_cast<const unsigned char*>(data.data())), mSize(data.size()) {}
+
+    bool isAtEnd() const {
+        return mPosition == mSize;
+    }
+
+    unsigned char readByte() {
+        require(1);
+        return mData[mPosition++];
+    }
+
+    /// Length continued after a token value of TOKEN_LENGTH_MASK
+    size_t readLength(size_t length) {
+        if(length < TOKEN_LENGTH_MASK) {
+            return length;
+        }
+        unsigned char byte;
+        do {
+            byte = readByte();
+            length += byte;
+        } while(byte == 255);
+        return length;
+    }
+
+    const unsigned char* readBytes(const size_t count) {
+        require(count);
+        const unsigned char* bytes = mData + mPosition;
+        mPosition += count;
+        return bytes;
+    }
+
+   private:
+    void require(const size_t count) const {
+        if(count > mSize - mPosition) {
+            throw std::runtime_error("The compressed data is truncated.");
+        }
+    }
+
+    const unsigned char* mData;
+    size_t mSize;
+    size_t mPosition = 0;
+};
+}  // namespace
+
+size_t getMaxCompressedSize(const size_t rawSize) {
+    return rawSize + rawSize / 255 + 16;
+}
+
+std::string compress(const std::string& data) {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(data.data());
+    const size_t size = data.size();
+    std::string out;
+    out.reserve(getMaxCompressedSize(size));
+
+    size_t anchor = 0;
+    if(size > MATCH_START_LIMIT) {
+        // Positions of the last occurrences of the hashed sequences, false matches are rejected by the comparison
+        std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0);
+        const size_t matchStartEnd = size - MATCH_START_LIMIT;
+        const size_t matchEnd = size - LAST_LITERALS;
+
+        size_t position = 1;
+        table[hashSequence(read32(in))] = 0;
+        int misses = 0;
+        while(position < matchStartEnd) {
+            const uint32_t sequence = read32(in + position);
+            const size_t hash = hashSequence(sequence);
+            const size_t candidate = table[hash];
+            table[hash] = static_cast<uint32_t>(position);
+            if(position - candidate > MAX_OFFSET || read32(in + candidate) != sequence) {
+                position += 1 + (misses++ >> SKIP_TRIGGER);
+                continue;
+            }
+            misses = 0;
+
+            // Extend the match backwards over the literals and forwards up to the last literals
+            size_t matchStart = position;
+            size_t matchSource = candidate;
+            while(matchStart > anchor && matchSource > 0 && in[matchStart - 1] == in[matchSource - 1]) {
+                --matchStart;
+                --matchSource;
+            }
+            size_t matchLength = position + MIN_MATCH - matchStart;
+            while(matchStart + matchLength < matchEnd &&
+                  in[matchSource + matchLength] == in[matchStart + matchLength]) {
+                ++matchLength;
+            }
+
+            writeSequence(out, in + anchor, matchStart - anchor, matchStart - matchSource, matchLength);
+            position = matchStart + matchLength;
+            anchor = position;
+            if(position < matchStartEnd) {
+                table[hashSequence(read32(in + position - 2))] = static_cast<uint32_t>(position - 2);
+            }
+        }
+    }
+
+    writeSequence(out, in + anchor, size - anchor, 0, 0);
+    return out;
+}
+
+std::string decompress(const std::string& data, const size_t rawSize) {
+    std::string out(rawSize, '\0');
+    unsigned char* result = reinterpret_cast<unsigned char*>(&out[0]);
+    size_t position = 0;
+
+    Reader reader(data);
+    while(true) {
+        const unsigned char token = reader.readByte();
+        const size_t literalLength = reader.readLength(token >> 4);
+        if(literalLength > rawSize - position) {
+            throw std::runtime_error("The compressed data is longer than expected.");
+        }
+        std::memcpy(result + position, reader.readBytes(literalLength), literalLength);
+        position += literalLength;
+        if(reader.isAtEnd()) {
+            break;
+        }
+
+        const unsigned char* offsetBytes = reader.readBytes(2);
+        const size_t offset = offsetBytes[0] | (size_t(offsetBytes[1]) << 8);
+        const size_t matchLength = reader.readLength(token & TOKEN_LENGTH_MASK) + MIN_MATCH;
+        if(offset == 0 || offset > position) {
+            throw std::runtime_error("The compressed data refers outside of the block.");
+        }
+        if(matchLength > rawSize - position) {
+            throw std::runtime_error("The compressed data is longer than expected.");
+        }
+
+        // The match may overlap the bytes it writes, e.g., a repeated byte has the offset 1
+        const unsigned char* source = result + position - offset;
+        if(offset >= matchLength) {
+            std::memcpy(result + position, source, matchLength);
+        } else {
+            for(size_t i = 0; i < matchLength; ++i) {
+                result[position + i] = source[i];
+            }
+        }
+        position += matchLength;
+    }
+
+    if(position != rawSize) {
+        throw std::runtime_error("The compressed data is shorter than expected.");
+    }
+    return out;
+}
+
+std::string shuffleBytes(const char* data, const size_t size, const size_t elementSize) {
+    std::string out(size, '\0');
+    const size_t count = elementSize > 0 ? size / elementSize : 0;
+    for(size_t byteIdx = 0; byteIdx < elementSize; ++byteIdx) {
+        char* plane = &out[0] + byteIdx * count;
+        for(size_t elementIdx = 0; elementIdx < count; ++elementIdx) {
+            plane[elementIdx] = data[elementIdx * elementSize + byteIdx];
+        }
+    }
+    const size_t shuffledSize = count * elementSize;
+    std::copy(data + shuffledSize, data + size, out.begin() + shuffledSize);
+    return out;
+}
+
+std::string unshuffleBytes(const std::string& data, const size_t elementSize) {
+    std::string out(data.size(), '\0');
+    const size_t count = elementSize > 0 ? data.size() / elementSize : 0;
+    for(size_t byteIdx = 0; byteIdx < elementSize; ++byteIdx) {
+        const char* plane = data.data() + byteIdx * count;
+        for(size_t elementIdx = 0; elementIdx < count; ++elementIdx) {
+            out[elementIdx * elementSize + byteIdx] = plane[elementIdx];
+        }
+    }
+    const size_t shuffledSize = count * elementSize;
+    std::copy(data.begin() + shuffledSize, data.end(), out.begin() + shuffledSize);
+    return out;
+}
+
+}  // namespace BlockCompression
+}  // namespace pepr3d
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace pepr3d {
+
+/// Fast lossless compression of independent blocks of bytes, in the LZ4 block format.
+/// Each block is compressed on its own, so the blocks of a file can be compressed and decompressed in parallel.
+namespace BlockCompression {
+
+/// Largest size of the compressed data of a block of the size, for incompressible data
+size_t getMaxCompressedSize(size_t rawSize);
+
+/// Compress the data, a greedy single pass over it with a hash table of the recent 4-byte sequences
+std::string compress(const std::string& data);
+
+/// Decompress data compressed by compress(), throws std::runtime_error if the data is corrupted or does not
+/// decompress into exactly rawSize bytes
+std::string decompress(const std::string& data, size_t rawSize);
+
+/// Transpose the bytes of an array of elements, so that the first bytes of all elements come first, then the second
+/// bytes, etc. Arrays of numbers compress much better after it, as their high bytes are often similar.
+/// Trailing bytes that do not form a whole element are kept at the end.
+std::string shuffleBytes(const char* data, size_t size, size_t elementSize);
+
+/// Inverse of shuffleBytes()
+std::string unshuffleBytes(const std::string& data, size_t elementSize);
+
+}  // namespace BlockCompression
+
+}  // namespace pepr3d
@@ -0,0 +1,88 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "geometry/BlockCompression.h"
+
+namespace pepr3d {
+
+TEST(BlockCompression, roundTrip) {
+    /**
+     * Test that data of all kinds decompresses into the original, and that repetitive data gets much smaller
+     */
+
+    std::mt19937 generator(7);
+    std::uniform_int_distribution<int> byteDistribution(0, 255);
+    std::string randomData(100000, '\0');
+    for(char& byte : randomData) {
+        byte = static_cast<char>(byteDistribution(generator));
+    }
+
+    std::string repetitiveData;
+    for(int i = 0; i < 20000; ++i) {
+        repetitiveData += "pepr" + std::to_string(i % 97);
+    }
+
+    // Long matches and literals need the extended lengths, short blocks have no matches at all
+    const std::vector<std::string> blocks = {"",
+                                             "a",
+                                             "abcdabcdabcd",
+                                             std::string(100000, 'x'),
+                                             randomData.substr(0, 300) + randomData.substr(0, 300),
+                                             randomData,
+                                             repetitiveData};
+    for(const std::string& block : blocks) {
+        const std::string compressed = BlockCompression::compress(block);
+        EXPECT_LE(compressed.size(), BlockCompression::getMaxCompressedSize(block.size()));
+        EXPECT_EQ(BlockCompression::decompress(compressed, block.size()), block);
+    }
+    EXPECT_LT(BlockCompression::compress(std::string(100000, 'x')).size(), 1000);
+    EXPECT_LT(BlockCompression::compress(repetitiveData).size(), repetitiveData.size() / 4);
+}
+
+TEST(BlockCompression, corruptedData) {
+    /**
+     * Test that corrupted data is rejected instead of being read or written out of bounds
+     */
+
+    const std::string block = "The quick brown fox jumps over the lazy dog, the quick brown fox jumps again.";
+    const std::string compressed = BlockCompression::compress(block);
+    EXPECT_THROW(BlockCompression::decompress(compressed, block.size() - 1), std::runtime_error);
+    EXPECT_THROW(BlockCompression::decompress(compressed, block.size() + 1), std::runtime_error);
+    EXPECT_THROW(BlockCompression::decompress(compressed.substr(0, compressed.size() - 10), block.size()),
+                 std::runtime_error);
+    EXPECT_THROW(BlockCompression::decompress("", 0), std::runtime_error);
+
+    // A match before the start of the block
+    const std::string farOffset = {static_cast<char>(0x10), 'a', static_cast<char>(0x10), static_cast<char>(0x00)};
+    EXPECT_THROW(BlockCompression::decompress(farOffset, 20), std::runtime_error);
+}
+
+TEST(BlockCompression, shuffleBytes) {
+    /**
+     * Test that the bytes of the elements are grouped and restored, including the bytes of an incomplete element
+     */
+
+    const std::string data = "abcdABCD12";
+    const std::string shuffled = BlockCompression::shuffleBytes(data.data(), data.size(), 4);
+    EXPECT_EQ(shuffled, "aAbBcCdD12");
+    EXPECT_EQ(BlockCompression::unshuffleBytes(shuffled, 4), data);
+
+    std::vector<float> values;
+    for(int i = 0; i < 1000; ++i) {
+        values.push_back(1.f + 0.001f * static_cast<float>(i));
+    }
+    const std::string floats = BlockCompression::shuffleBytes(reinterpret_cast<const char*>(values.data()),
+                                                              values.size() * sizeof(float), sizeof(float));
+    EXPECT_EQ(BlockCompression::unshuffleBytes(floats, sizeof(float)),
+              std::string(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float)));
+}
+
+}  // namespace pepr3d
+
+#endif
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "peprassert.h"
+
+namespace pepr3d {
+
+/// Bounding volume hierarchy over spheres, used for range queries over bounding spheres of triangles.
+/// Every node stores a sphere enclosing the spheres below it, so that any object with a distance function
+/// (a point, a line, ...) can be queried. Query cost scales with the number of nodes close to the object,
+/// not with the number of spheres.
+class BoundingSphereTree {
+   public:
+    /// Maximum number of spheres in a leaf node
+    static const size_t LEAF_SIZE = 8;
+
+    /// Build the tree over the spheres, sphere indices are the positions in the vectors
+    void build(const std::vector<glm::dvec3>& centers, const std::vector<double>& radii) {
+        P_ASSERT(centers.size() == radii.size());
+        mCenters = centers;
+        mRadii = radii;
+        mIndices.resize(mCenters.size());
+        for(size_t i = 0; i < mIndices.size(); ++i) {
+            mIndices[i] = static_cast<uint32_t>(i);
+        }
+        mNodes.clear();
+        if(!mIndices.empty()) {
+            mNodes.reserve(2 * (mIndices.size() / LEAF_SIZE + 1));
+            buildNode(0, mIndices.size());
+        }
+        // The nodes keep everything the queries need, the callers own the spheres
+        mCenters = {};
+        mRadii = {};
+    }
+
+    void clear() {
+        mCenters.clear();
+        mRadii.clear();
+        mIndices.clear();
+        mNodes.clear();
+    }
+
+    size_t size() const {
+        return mIndices.size();
+    }
+
+    bool empty() const {
+        return mIndices.empty();
+    }
+
+    /// Rough estimate of the memory taken by the tree in bytes
+    size_t getApproximateMemorySize() const {
+        return sizeof(BoundingSphereTree) + mCenters.capacity() * sizeof(glm::dvec3) +
+               mRadii.capacity() * sizeof(double) + mIndices.capacity() * sizeof(uint32_t) +
+               mNodes.capacity() * sizeof(Node);
+    }
+
+    /// Call callback(sphereIdx) for the spheres that may be closer than radius to an object.
+    /// Only the nodes are tested, the callback has to do the exact test of the sphere.
+    /// @param squaredDistance functor double(const glm::dvec3&), squared distance of the object to a point
+    template <typename SquaredDistance, typename Callback>
+    void query(const double radius, const SquaredDistance& squaredDistance, Callback&& callback) const {
+        if(mNodes.empty()) {
+            return;
+        }
+
+        std::vector<uint32_t> stack{0};
+        while(!stack.empty()) {
+            const uint32_t nodeIdx = stack.back();
+            stack.pop_back();
+            const Node& node = mNodes[nodeIdx];
+
+            const double limit = radius + node.radius;
+            if(squaredDistance(node.center) > limit * limit) {
+                continue;
+            }
+
+            if(node.isLeaf()) {
+                for(uint32_t i = node.begin; i < node.end; ++i) {
+                    callback(static_cast<size_t>(mIndices[i]));
+                }
+            } else {
+                // Left child directly follows its parent
+                stack.push_back(node.right);
+                stack.push_back(nodeIdx + 1);
+            }
+        }
+    }
+
+   private:
+    struct Node {
+        /// Sphere enclosing all spheres of this subtree
+        glm::dvec3 center;
+        double radius;
+
+        /// Range of mIndices of this subtree
+        uint32_t begin;
+        uint32_t end;
+
+        /// Index of the right child, 0 for leaves
+        uint32_t right;
+
+        bool isLeaf() const {
+            return right == 0;
+        }
+    };
+
+    uint32_t buildNode(const size_t begin, const size_t end) {
+        P_ASSERT(begin < end);
+
+        // Bounding box of the spheres
+        glm::dvec3 boxMin = mCenters[mIndices[begin]] - mRadii[mIndices[begin]];
+        glm::dvec3 boxMax = mCenters[mIndices[begin]] + mRadii[mIndices[begin]];
+        glm::dvec3 centerMin = mCenters[mIndices[begin]];
+        glm::dvec3 centerMax = centerMin;
+        for(size_t i = begin + 1; i < end; ++i) {
+            const glm::dvec3& center = mCenters[mIndices[i]];
+            boxMin = glm::min(boxMin, center - mRadii[mIndices[i]]);
+            boxMax = glm::max(boxMax, center + mRadii[mIndices[i]]);
+            centerMin = glm::min(centerMin, center);
+            centerMax = glm::max(centerMax, center);
+        }
+
+        Node node;
+        node.center = 0.5 * (boxMin + boxMax);
+        node.radius = 0.0;
+        for(size_t i = begin; i < end; ++i) {
+            const double distance = glm::length(mCenters[mIndices[i]] - node.center);
+            node.radius = std::max(node.radius, distance + mRadii[mIndices[i]]);
+        }
+        // Keep the bound conservative despite rounding
+        node.radius *= 1.0 + 1e-9;
+        node.begin = static_cast<uint32_t>(begin);
+        node.end = static_cast<uint32_t>(end);
+        node.right = 0;
+
+        const uint32_t nodeIdx = static_cast<uint32_t>(mNodes.size());
+        mNodes.push_back(node);
+
+        if(end - begin <= LEAF_SIZE) {
+            return nodeIdx;
+        }
+
+        // Median split along the longest axis of the sphere centers
+        const glm::dvec3 extent = centerMax - centerMin;
+        const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+        const size_t middle = begin + (end - begin) / 2;
+        std::nth_element(mIndices.begin() + begin, mIndices.begin() + middle, mIndices.begin() + end,
+                         [this, axis](uint32_t a, uint32_t b) { return mCenters[a][axis] < mCenters[b][axis]; });
+
+        buildNode(begin, middle);
+        const uint32_t right = buildNode(middle, end);
+        mNodes[nodeIdx].right = right;
+        return nodeIdx;
+    }
+
+    /// Copies of the spheres while building
+    std::vector<glm::dvec3> mCenters;
+    std::vector<double> mRadii;
+
+    /// Sphere indices, ordered so that each node covers a continuous range
+    std::vector<uint32_t> mIndices;
+
+    /// Nodes in depth-first order, the root is the first one
+    std::vector<Node> mNodes;
+};
+
+}  // namespace pepr3d
@@ -0,0 +1,60 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+#include "geometry/BoundingSphereTree.h"
+
+TEST(BoundingSphereTree, matchesLinearScan) {
+    /**
+     * Test that the tree finds the same spheres as testing all of them, for a point and a line query
+     */
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<double> position(-10.0, 10.0);
+    std::uniform_real_distribution<double> size(0.01, 0.5);
+
+    std::vector<glm::dvec3> centers;
+    std::vector<double> radii;
+    for(size_t i = 0; i < 1000; ++i) {
+        centers.emplace_back(position(generator), position(generator), position(generator));
+        radii.push_back(size(generator));
+    }
+    pepr3d::BoundingSphereTree tree;
+    tree.build(centers, radii);
+    ASSERT_EQ(tree.size(), centers.size());
+
+    const glm::dvec3 origin(1.0, -2.0, 0.5);
+    const glm::dvec3 direction = glm::normalize(glm::dvec3(1.0, 2.0, -0.5));
+    const auto pointDistance = [&origin](const glm::dvec3& p) { return glm::dot(p - origin, p - origin); };
+    const auto lineDistance = [&origin, &direction](const glm::dvec3& p) {
+        const glm::dvec3 offset = glm::cross(p - origin, direction);
+        return glm::dot(offset, offset);
+    };
+
+    const auto compare = [&](const auto& squaredDistance, const double radius) {
+        std::vector<size_t> expected;
+        for(size_t i = 0; i < centers.size(); ++i) {
+            if(squaredDistance(centers[i]) <= (radius + radii[i]) * (radius + radii[i])) {
+                expected.push_back(i);
+            }
+        }
+
+        std::vector<size_t> found;
+        tree.query(radius, squaredDistance, [&](const size_t i) {
+            if(squaredDistance(centers[i]) <= (radius + radii[i]) * (radius + radii[i])) {
+                found.push_back(i);
+            }
+        });
+        std::sort(found.begin(), found.end());
+
+        EXPECT_FALSE(expected.empty());
+        EXPECT_EQ(found, expected);
+    };
+
+    compare(pointDistance, 3.0);
+    compare(lineDistance, 1.0);
+}
+
+#endif
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cmath>
+#include <glm/glm.hpp>
+#include <limits>
+#include <vector>
+
+#include "peprassert.h"
+
+namespace pepr3d {
+
+/// Spheres stored as packed float arrays of the center coordinates and the radii (structure of arrays),
+/// so that batched tests can load the same coordinate of consecutive spheres at once.
+/// The float spheres are rounded outwards, each encloses the sphere it was set from.
+class BoundingSpheres {
+   public:
+    void resize(const size_t count) {
+        mCentersX.resize(count);
+        mCentersY.resize(count);
+        mCentersZ.resize(count);
+        mRadii.resize(count);
+    }
+
+    void clear() {
+        resize(0);
+    }
+
+    size_t size() const {
+        return mRadii.size();
+    }
+
+    bool empty() const {
+        return mRadii.empty();
+    }
+
+    /// Store the sphere at index, spheres at different indices can be set from different threads
+    void set(const size_t index, const glm::dvec3& center, const double radius) {
+        P_ASSERT(index < size());
+        const glm::vec3 floatCenter(center);
+        mCentersX[index] = floatCenter.x;
+        mCentersY[index] = floatCenter.y;
+        mCentersZ[index] = floatCenter.z;
+
+        // Grow the radius by the rounding of the center and round it up, so the original sphere stays inside
+        const double enclosingRadius = radius + glm::length(center - glm::dvec3(floatCenter));
+        float floatRadius = static_cast<float>(enclosingRadius);
+        if(static_cast<double>(floatRadius) < enclosingRadius) {
+            floatRadius = std::nextafter(floatRadius, std::numeric_limits<float>::infinity());
+        }
+        mRadii[index] = floatRadius;
+    }
+
+    glm::vec3 getCenter(const size_t index) const {
+        P_ASSERT(index < size());
+        return glm::vec3(mCentersX[index], mCentersY[index], mCentersZ[index]);
+    }
+
+    float getRadius(const size_t index) const {
+        P_ASSERT(index < size());
+        return mRadii[index];
+    }
+
+    const std::vector<float>& getCentersX() const {
+        return mCentersX;
+    }
+
+    const std::vector<float>& getCentersY() const {
+        return mCentersY;
+    }
+
+    const std::vector<float>& getCentersZ() const {
+        return mCentersZ;
+    }
+
+    const std::vector<float>& getRadii() const {
+        return mRadii;
+    }
+
+    /// Rough estimate of the memory taken by the spheres in bytes
+    size_t getApproximateMemorySize() const {
+        const size_t floatCount =
+            mCentersX.capacity() + mCentersY.capacity() + mCentersZ.capacity() + mRadii.capacity();
+        return sizeof(BoundingSpheres) + floatCount * sizeof(float);
+    }
+
+   private:
+    std::vector<float> mCentersX;
+    std::vector<float> mCentersY;
+    std::vector<float> mCentersZ;
+    std::vector<float> mRadii;
+};
+
+}  // namespace pepr3d
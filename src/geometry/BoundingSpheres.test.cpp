@@ -0,0 +1,40 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <random>
+
+#include "geometry/BoundingSpheres.h"
+
+TEST(BoundingSpheres, enclosesDoubleSpheres) {
+    /**
+     * Test that the rounded float spheres enclose the double spheres they were set from
+     */
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<double> position(-1000.0, 1000.0);
+    std::uniform_real_distribution<double> size(1e-6, 1.0);
+
+    pepr3d::BoundingSpheres spheres;
+    spheres.resize(1000);
+    ASSERT_EQ(spheres.size(), 1000);
+    std::vector<glm::dvec3> centers;
+    std::vector<double> radii;
+    for(size_t i = 0; i < spheres.size(); ++i) {
+        centers.emplace_back(position(generator), position(generator), position(generator));
+        radii.push_back(size(generator));
+        spheres.set(i, centers.back(), radii.back());
+    }
+
+    for(size_t i = 0; i < spheres.size(); ++i) {
+        const glm::dvec3 center(spheres.getCenter(i));
+        EXPECT_EQ(spheres.getCentersX()[i], spheres.getCenter(i).x);
+        EXPECT_EQ(spheres.getRadii()[i], spheres.getRadius(i));
+        EXPECT_GE(static_cast<double>(spheres.getRadius(i)), glm::length(centers[i] - center) + radii[i]);
+        EXPECT_NEAR(spheres.getRadius(i), radii[i], 1e-3);
+    }
+
+    spheres.clear();
+    EXPECT_TRUE(spheres.empty());
+}
+
+#endif
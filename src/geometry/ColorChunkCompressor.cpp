@@ -0,0 +1,94 @@
+#include "geometry/ColorChunkCompressor.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "geometry/BlockCompression.h"
+#include "peprassert.h"
+
+namespace pepr3d {
+
+uint64_t ColorChunkCompressor::computeChecksum(const std::vector<std::uint8_t>& chunk) {
+    uint64_t hash = 14695981039346656037ull;
+    for(const std::uint8_t byte : chunk) {
+        hash = (hash ^ byte) * 1099511628211ull;
+    }
+    return hash;
+}
+
+auto ColorChunkCompressor::compress(const std::vector<PackedColorChunk>& chunks) -> std::vector<CompressedChunkRef> {
+    std::vector<CompressedChunkRef> compressedChunks;
+    compressedChunks.reserve(chunks.size());
+    for(const PackedColorChunk& chunk : chunks) {
+        P_ASSERT(chunk != nullptr);
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            const auto found = mCompressedChunks.find(chunk.get());
+            if(found != mCompressedChunks.end() && found->second.rawChunk.lock() == chunk) {
+                if(CompressedChunkRef compressedChunk = found->second.compressedChunk.lock()) {
+                    compressedChunks.push_back(std::move(compressedChunk));
+                    continue;
+                }
+            }
+        }
+
+        // Compressed outside of the lock, another thread compressing the same chunk only costs time
+        auto compressedChunk = std::make_shared<CompressedChunk>();
+        compressedChunk->data = BlockCompression::compress(std::string(chunk->begin(), chunk->end()));
+        compressedChunk->rawSize = chunk->size();
+        compressedChunk->checksum = computeChecksum(*chunk);
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mCompressedChunks[chunk.get()] = {chunk, compressedChunk};
+        }
+        compressedChunks.push_back(std::move(compressedChunk));
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    for(auto it = mCompressedChunks.begin(); it != mCompressedChunks.end();) {
+        if(it->second.rawChunk.expired() || it->second.compressedChunk.expired()) {
+            it = mCompressedChunks.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return compressedChunks;
+}
+
+auto ColorChunkCompressor::decompress(const std::vector<CompressedChunkRef>& chunks) -> std::vector<PackedColorChunk> {
+    std::vector<PackedColorChunk> rawChunks;
+    rawChunks.reserve(chunks.size());
+    for(const CompressedChunkRef& chunk : chunks) {
+        P_ASSERT(chunk != nullptr);
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            const auto found = std::find_if(
+                mDecompressedChunks.begin(), mDecompressedChunks.end(),
+                [&chunk](const DecompressedEntry& entry) { return entry.compressedChunk.lock() == chunk; });
+            if(found != mDecompressedChunks.end()) {
+                mDecompressedChunks.splice(mDecompressedChunks.begin(), mDecompressedChunks, found);
+                rawChunks.push_back(found->rawChunk);
+                continue;
+            }
+        }
+
+        const std::string data = BlockCompression::decompress(chunk->data, chunk->rawSize);
+        auto rawChunk = std::make_shared<const std::vector<std::uint8_t>>(data.begin(), data.end());
+        if(computeChecksum(*rawChunk) != chunk->checksum) {
+            throw std::runtime_error("Compressed undo snapshot is corrupted, its checksum does not match");
+        }
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mDecompressedChunks.push_front({chunk, rawChunk});
+            if(mDecompressedChunks.size() > CACHED_CHUNK_COUNT) {
+                mDecompressedChunks.pop_back();
+            }
+            // Snapshots taken after the chunk is loaded share it, it does not have to be compressed again
+            mCompressedChunks[rawChunk.get()] = {rawChunk, chunk};
+        }
+        rawChunks.push_back(std::move(rawChunk));
+    }
+    return rawChunks;
+}
+
+}  // namespace pepr3d
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace pepr3d {
+
+/// Compresses the packed color chunks of cold undo snapshots, see TriangleStore::getPackedColorChunks().
+/// A chunk shared by several snapshots is compressed once and its compressed copy is shared as well.
+/// The recently decompressed chunks are cached, so undoing and redoing over the same snapshot decompresses once.
+/// All methods are thread-safe.
+class ColorChunkCompressor {
+   public:
+    using PackedColorChunk = std::shared_ptr<const std::vector<std::uint8_t>>;
+
+    struct CompressedChunk {
+        /// Chunk compressed by BlockCompression::compress()
+        std::string data;
+        size_t rawSize = 0;
+
+        /// FNV-1a hash of the raw chunk, checked after decompressing
+        uint64_t checksum = 0;
+    };
+    using CompressedChunkRef = std::shared_ptr<const CompressedChunk>;
+
+    /// Number of decompressed chunks kept in the cache
+    static constexpr size_t CACHED_CHUNK_COUNT = 256;
+
+    /// Compress the chunks, each of them only once while its compressed copy is in use
+    std::vector<CompressedChunkRef> compress(const std::vector<PackedColorChunk>& chunks);
+
+    /// Decompress the output of compress(), throws std::runtime_error if a chunk does not match its checksum
+    std::vector<PackedColorChunk> decompress(const std::vector<CompressedChunkRef>& chunks);
+
+    /// Number of chunks in the cache of decompress()
+    size_t getCachedChunkCount() const {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mDecompressedChunks.size();
+    }
+
+    static uint64_t computeChecksum(const std::vector<std::uint8_t>& chunk);
+
+   private:
+    struct CompressedEntry {
+        /// Identifies the raw chunk, its address may be reused once it is freed
+        std::weak_ptr<const std::vector<std::uint8_t>> rawChunk;
+        std::weak_ptr<const CompressedChunk> compressedChunk;
+    };
+
+    struct DecompressedEntry {
+        std::weak_ptr<const CompressedChunk> compressedChunk;
+        PackedColorChunk rawChunk;
+    };
+
+    mutable std::mutex mMutex;
+
+    /// Compressed copies of the raw chunks, expired entries are removed by compress()
+    std::map<const void*, CompressedEntry> mCompressedChunks;
+
+    /// Recently decompressed chunks, the most recent first
+    std::list<DecompressedEntry> mDecompressedChunks;
+};
+
+}  // namespace pepr3d
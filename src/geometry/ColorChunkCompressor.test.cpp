@@ -0,0 +1,85 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "geometry/ColorChunkCompressor.h"
+
+namespace pepr3d {
+
+using PackedColorChunk = ColorChunkCompressor::PackedColorChunk;
+
+TEST(ColorChunkCompressor, roundTrip) {
+    /**
+     * Test that the chunks decompress into the original colors and that shared chunks stay shared
+     */
+
+    std::vector<std::uint8_t> stripes(4096);
+    for(size_t i = 0; i < stripes.size(); ++i) {
+        stripes[i] = static_cast<std::uint8_t>((i / 100) % 3 * 0x11);
+    }
+    const PackedColorChunk uniform = std::make_shared<const std::vector<std::uint8_t>>(4096, 0x22);
+    const PackedColorChunk striped = std::make_shared<const std::vector<std::uint8_t>>(stripes);
+    const PackedColorChunk last = std::make_shared<const std::vector<std::uint8_t>>(3, 0x01);
+    const std::vector<PackedColorChunk> chunks = {uniform, striped, uniform, last};
+
+    ColorChunkCompressor compressor;
+    const auto compressed = compressor.compress(chunks);
+    ASSERT_EQ(compressed.size(), chunks.size());
+    EXPECT_EQ(compressed[0], compressed[2]);
+    EXPECT_LT(compressed[0]->data.size(), uniform->size() / 10);
+    EXPECT_LT(compressed[1]->data.size(), striped->size() / 4);
+
+    // A snapshot sharing the chunks shares their compressed copies
+    const auto compressedAgain = compressor.compress({striped});
+    EXPECT_EQ(compressedAgain[0], compressed[1]);
+
+    const auto decompressed = compressor.decompress(compressed);
+    ASSERT_EQ(decompressed.size(), chunks.size());
+    for(size_t i = 0; i < chunks.size(); ++i) {
+        EXPECT_EQ(*decompressed[i], *chunks[i]);
+    }
+    EXPECT_EQ(decompressed[0], decompressed[2]);
+    EXPECT_EQ(compressor.getCachedChunkCount(), 3);
+
+    // Cached chunks are returned again, and they are not compressed again once loaded
+    const auto decompressedAgain = compressor.decompress(compressed);
+    EXPECT_EQ(decompressedAgain[1], decompressed[1]);
+    EXPECT_EQ(compressor.compress({decompressed[1]})[0], compressed[1]);
+}
+
+TEST(ColorChunkCompressor, cacheLimit) {
+    /**
+     * Test that the cache of decompressed chunks keeps only the most recent ones
+     */
+
+    ColorChunkCompressor compressor;
+    std::vector<PackedColorChunk> chunks;
+    for(size_t i = 0; i < ColorChunkCompressor::CACHED_CHUNK_COUNT + 10; ++i) {
+        chunks.push_back(std::make_shared<const std::vector<std::uint8_t>>(64, static_cast<std::uint8_t>(i)));
+    }
+    const auto compressed = compressor.compress(chunks);
+    const auto decompressed = compressor.decompress(compressed);
+    EXPECT_EQ(compressor.getCachedChunkCount(), ColorChunkCompressor::CACHED_CHUNK_COUNT);
+    EXPECT_EQ(compressor.decompress({compressed.back()})[0], decompressed.back());
+    EXPECT_NE(compressor.decompress({compressed.front()})[0], decompressed.front());
+}
+
+TEST(ColorChunkCompressor, corruptedChunk) {
+    /**
+     * Test that a chunk that does not match its checksum is rejected
+     */
+
+    ColorChunkCompressor compressor;
+    const PackedColorChunk chunk = std::make_shared<const std::vector<std::uint8_t>>(1000, 0x13);
+    auto corrupted = std::make_shared<ColorChunkCompressor::CompressedChunk>(*compressor.compress({chunk})[0]);
+    corrupted->checksum ^= 1;
+    EXPECT_THROW(compressor.decompress({corrupted}), std::runtime_error);
+}
+
+}  // namespace pepr3d
+
+#endif
@@ -2,6 +2,8 @@
 
 #include <cereal/archives/binary.hpp>
 #include <cereal/types/vector.hpp>
+#include <algorithm>
+#include <numeric>
 #include <random>
 #include <vector>
 #include "cinder/Color.h"
@@ -12,7 +14,9 @@
 
 namespace pepr3d {
 
-/// Represents a color palette, i.e., all colors and a selected active color
+/// Represents a color palette, i.e., all colors and a selected active color.
+/// Triangles store indices of the colors, the palette shows them in the order of the palette positions, so that
+/// reordering the palette does not change the stored indices.
 class ColorManager {
    public:
     using ColorMap = std::vector<glm::vec4>;
@@ -24,6 +28,9 @@ class ColorManager {
     /// Index of a currently selected / active color
     size_t mActiveColorIndex = 0;
 
+    /// Index of the color shown at each palette position, a permutation of the indices of mColorMap
+    std::vector<size_t> mColorOrder;
+
     friend class cereal::access;
 
    public:
@@ -33,6 +40,7 @@ class ColorManager {
         mColorMap.push_back(static_cast<glm::vec4>(ci::ColorA::hex(0xF2994A)));
         mColorMap.push_back(static_cast<glm::vec4>(ci::ColorA::hex(0x292E33)));
         P_ASSERT(mColorMap.size() <= PEPR3D_MAX_PALETTE_COLORS);
+        resetColorOrder();
     }
 
     ColorManager(const ColorMap::const_iterator start, const ColorMap::const_iterator end) {
@@ -41,6 +49,7 @@ class ColorManager {
 
     explicit ColorManager(const size_t number) {
         generateColors(number, mColorMap);
+        resetColorOrder();
     }
 
     /// Return the i-th color
@@ -62,11 +71,13 @@ class ColorManager {
     /// Clears all colors and becomes empty
     void clear() {
         mColorMap.clear();
+        mColorOrder.clear();
     }
 
     /// Adds a new color if not above limit
     void addColor(const glm::vec4 newColor) {
         if(size() < PEPR3D_MAX_PALETTE_COLORS) {
+            mColorOrder.push_back(mColorMap.size());
             mColorMap.push_back(newColor);
         }
         P_ASSERT(mColorMap.size() <= PEPR3D_MAX_PALETTE_COLORS);
@@ -87,6 +98,7 @@ class ColorManager {
             mColorMap.push_back(*it);
             ++it;
         }
+        resetColorOrder();
         if(mActiveColorIndex >= size()) {
             mActiveColorIndex = size() - 1;
         }
@@ -98,6 +110,7 @@ class ColorManager {
         if(mColorMap.size() > PEPR3D_MAX_PALETTE_COLORS) {
             mColorMap.resize(PEPR3D_MAX_PALETTE_COLORS);
         }
+        resetColorOrder();
         if(mActiveColorIndex >= size()) {
             mActiveColorIndex = size() - 1;
         }
@@ -117,6 +130,54 @@ class ColorManager {
         return mColorMap[mActiveColorIndex];
     }
 
+    /// Index of the color shown at the palette position
+    size_t getColorIndexAt(const size_t position) const {
+        P_ASSERT(position < mColorOrder.size());
+        return mColorOrder[position];
+    }
+
+    /// Indices of the colors in the order of the palette positions
+    const std::vector<size_t>& getColorOrder() const {
+        return mColorOrder;
+    }
+
+    /// Show the colors in this order, ignored unless it is a permutation of the color indices
+    void setColorOrder(const std::vector<size_t>& colorOrder) {
+        std::vector<bool> isUsed(mColorMap.size(), false);
+        for(const size_t colorIdx : colorOrder) {
+            if(colorIdx >= isUsed.size() || isUsed[colorIdx]) {
+                return;
+            }
+            isUsed[colorIdx] = true;
+        }
+        if(colorOrder.size() == mColorMap.size()) {
+            mColorOrder = colorOrder;
+        }
+    }
+
+    /// Swap the palette positions of two colors, the color indices stay the same
+    void reorderColors(const size_t position1, const size_t position2) {
+        P_ASSERT(position1 < mColorOrder.size() && position2 < mColorOrder.size());
+        std::swap(mColorOrder[position1], mColorOrder[position2]);
+    }
+
+    /// Remove the color, the indices of all colors after it decrease by one
+    void removeColor(const size_t colorIdx) {
+        P_ASSERT(colorIdx < mColorMap.size());
+        mColorMap.erase(mColorMap.begin() + colorIdx);
+        mColorOrder.erase(std::find(mColorOrder.begin(), mColorOrder.end(), colorIdx));
+        for(size_t& orderedIdx : mColorOrder) {
+            if(orderedIdx > colorIdx) {
+                --orderedIdx;
+            }
+        }
+        if(mActiveColorIndex > colorIdx) {
+            --mActiveColorIndex;
+        } else if(mActiveColorIndex == colorIdx && !mColorOrder.empty()) {
+            mActiveColorIndex = mColorOrder.front();
+        }
+    }
+
     ColorMap& getColorMap() {
         return mColorMap;
     }
@@ -145,10 +206,23 @@ class ColorManager {
     }
 
    private:
+    void resetColorOrder() {
+        mColorOrder.resize(mColorMap.size());
+        std::iota(mColorOrder.begin(), mColorOrder.end(), 0);
+    }
+
+    /// The order is saved by the Geometry, so that the palette stays readable by older versions
+    template <class Archive>
+    void save(Archive& ar) const {
+        ar(mColorMap);
+        ar(mActiveColorIndex);
+    }
+
     template <class Archive>
-    void serialize(Archive& ar) {
+    void load(Archive& ar) {
         ar(mColorMap);
         ar(mActiveColorIndex);
+        resetColorOrder();
     }
 };
 
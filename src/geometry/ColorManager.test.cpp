@@ -208,4 +208,42 @@ TEST(ColorManager, constructor_color_generation) {
     pepr3d::ColorManager cm(PEPR3D_MAX_PALETTE_COLORS);
     EXPECT_EQ(cm.size(), PEPR3D_MAX_PALETTE_COLORS);
 }
+
+TEST(ColorManager, colorOrder) {
+    /**
+     * Test that reordering changes only the palette positions and removing keeps the order of the rest
+     */
+
+    pepr3d::ColorManager cm;
+    const auto color0 = cm.getColor(0);
+    const auto color2 = cm.getColor(2);
+    EXPECT_EQ(cm.getColorOrder(), (std::vector<size_t>{0, 1, 2, 3}));
+
+    cm.reorderColors(0, 2);
+    EXPECT_EQ(cm.getColorOrder(), (std::vector<size_t>{2, 1, 0, 3}));
+    EXPECT_EQ(cm.getColor(0), color0);
+    EXPECT_EQ(cm.getColor(cm.getColorIndexAt(0)), color2);
+
+    cm.setActiveColorIndex(3);
+    cm.removeColor(1);
+    EXPECT_EQ(cm.size(), 3);
+    EXPECT_EQ(cm.getColorOrder(), (std::vector<size_t>{1, 0, 2}));
+    EXPECT_EQ(cm.getColor(1), color2);
+    EXPECT_EQ(cm.getActiveColorIndex(), 2);
+
+    // The active color is removed, the first color of the palette becomes active
+    cm.removeColor(2);
+    EXPECT_EQ(cm.getActiveColorIndex(), 1);
+
+    cm.addColor(glm::vec4(1, 1, 0, 1));
+    EXPECT_EQ(cm.getColorOrder(), (std::vector<size_t>{1, 0, 2}));
+
+    cm.setColorOrder({0, 0, 1});
+    EXPECT_EQ(cm.getColorOrder(), (std::vector<size_t>{1, 0, 2}));
+    cm.setColorOrder({2, 1, 0});
+    EXPECT_EQ(cm.getColorOrder(), (std::vector<size_t>{2, 1, 0}));
+
+    cm.replaceColors(std::vector<glm::vec4>(2, glm::vec4(1)));
+    EXPECT_EQ(cm.getColorOrder(), (std::vector<size_t>{0, 1}));
+}
 #endif
\ No newline at end of file
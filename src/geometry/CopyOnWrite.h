@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cereal/access.hpp>
+#include <memory>
+#include <utility>
+
+#include "peprassert.h"
+
+namespace pepr3d {
+
+/// Value wrapper sharing its data between copies until one of them is modified.
+/// Copies are cheap, so undo snapshots of large objects only cost what changed since the last snapshot.
+/// Read access is through operator* and operator->, modifying access has to go through write().
+template <typename T>
+class CopyOnWrite {
+   public:
+    CopyOnWrite() : mData(std::make_shared<T>()) {}
+
+    explicit CopyOnWrite(T&& value) : mData(std::make_shared<T>(std::move(value))) {}
+
+    explicit CopyOnWrite(const T& value) : mData(std::make_shared<T>(value)) {}
+
+    const T& operator*() const {
+        P_ASSERT(mData);
+        return *mData;
+    }
+
+    const T* operator->() const {
+        P_ASSERT(mData);
+        return mData.get();
+    }
+
+    /// Get modifiable data, making a private copy first if the data is shared with another wrapper.
+    /// Copies of the same wrapper must not be modified from multiple threads at once.
+    T& write() {
+        P_ASSERT(mData);
+        if(mData.use_count() > 1) {
+            mData = std::make_shared<T>(*mData);
+        }
+        return *mData;
+    }
+
+    /// Do the wrappers share the same data
+    bool isSharedWith(const CopyOnWrite& other) const {
+        return mData == other.mData;
+    }
+
+    /// Number of wrappers sharing the data, including this one
+    size_t getShareCount() const {
+        return static_cast<size_t>(mData.use_count());
+    }
+
+   private:
+    std::shared_ptr<T> mData;
+
+    friend class cereal::access;
+
+    /// Serialized as the bare value, to stay compatible with existing files
+    template <class Archive>
+    void save(Archive& archive) const {
+        archive(*mData);
+    }
+
+    template <class Archive>
+    void load(Archive& archive) {
+        T value;
+        archive(value);
+        mData = std::make_shared<T>(std::move(value));
+    }
+};
+
+}  // namespace pepr3d
@@ -0,0 +1,28 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "geometry/CopyOnWrite.h"
+
+TEST(CopyOnWrite, sharesUntilWrite) {
+    /**
+     * Test that copies share the data until one of them is modified
+     */
+
+    pepr3d::CopyOnWrite<std::vector<int>> original(std::vector<int>{1, 2, 3});
+    const pepr3d::CopyOnWrite<std::vector<int>> snapshot = original;
+    EXPECT_TRUE(original.isSharedWith(snapshot));
+
+    original.write().push_back(4);
+    EXPECT_FALSE(original.isSharedWith(snapshot));
+    EXPECT_EQ(original->size(), 4);
+    EXPECT_EQ(*snapshot, std::vector<int>({1, 2, 3}));
+
+    // Unshared data is modified in place
+    const std::vector<int>* data = &*original;
+    original.write().push_back(5);
+    EXPECT_EQ(&*original, data);
+}
+
+#endif
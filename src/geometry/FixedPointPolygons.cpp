@@ -0,0 +1,916 @@
+#include "geometry/FixedPointPolygons.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <optional>
+
+#include "peprassert.h"
+
+namespace pepr3d {
+
+namespace {
+/// Rounds of snap rounding, each one adds the crossings left by the previous one as new hot pixels.
+/// Snap rounding does not leave any crossings, the rounds only guard against the rare degenerate cases.
+const size_t MAX_SNAP_ROUNDS = 8;
+
+/// Largest number of cells along a side of a Grid
+const size_t MAX_GRID_CELLS = 512;
+
+/// Point with 64 bit coordinates, also used for doubled coordinates of midpoints and pixel corners
+struct Point64 {
+    int64_t x;
+    int64_t y;
+
+    bool operator==(const Point64& other) const {
+        return x == other.x && y == other.y;
+    }
+
+    bool operator!=(const Point64& other) const {
+        return !(*this == other);
+    }
+
+    bool operator<(const Point64& other) const {
+        return x < other.x || (x == other.x && y < other.y);
+    }
+};
+
+Point64 toPoint64(const FixedPoint& point) {
+    return {point.x, point.y};
+}
+
+FixedPoint toFixedPoint(const Point64& point) {
+    return {static_cast<int32_t>(point.x), static_cast<int32_t>(point.y)};
+}
+
+Point64 doubled(const Point64& point) {
+    return {2 * point.x, 2 * point.y};
+}
+
+/// Twice the signed area of the triangle (a, b, c), positive if c is left of the line a -> b
+int64_t orientation(const Point64& a, const Point64& b, const Point64& c) {
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+int64_t dot(const Point64& start, const Point64& end, const Point64& point) {
+    return (end.x - start.x) * (point.x - start.x) + (end.y - start.y) * (point.y - start.y);
+}
+
+int sign(const int64_t value) {
+    return (value > 0) - (value < 0);
+}
+
+int64_t floorHalf(const int64_t value) {
+    return value >= 0 ? value / 2 : -((1 - value) / 2);
+}
+
+/// Unsigned 128 bit integer, holds the products of the crossings of two edges
+struct UInt128 {
+    uint64_t high;
+    uint64_t low;
+};
+
+UInt128 multiply(const uint64_t a, const uint64_t b) {
+    const uint64_t mask = 0xffffffffu;
+    const uint64_t lowLow = (a & mask) * (b & mask);
+    const uint64_t lowHigh = (a & mask) * (b >> 32);
+    const uint64_t highLow = (a >> 32) * (b & mask);
+    const uint64_t highHigh = (a >> 32) * (b >> 32);
+    const uint64_t middle = (lowLow >> 32) + (lowHigh & mask) + (highLow & mask);
+    return {highHigh + (lowHigh >> 32) + (highLow >> 32) + (middle >> 32), (middle << 32) | (lowLow & mask)};
+}
+
+UInt128 add(const UInt128& a, const uint64_t b) {
+    const uint64_t low = a.low + b;
+    return {a.high + (low < a.low ? 1 : 0), low};
+}
+
+UInt128 subtract(const UInt128& a, const uint64_t b) {
+    return {a.high - (a.low < b ? 1 : 0), a.low - b};
+}
+
+/// Quotient rounded down, it must fit into 64 bits. The divisor is below 2^63.
+uint64_t divide(const UInt128& dividend, const uint64_t divisor) {
+    uint64_t remainder = 0;
+    uint64_t quotient = 0;
+    for(int bit = 127; bit >= 0; --bit) {
+        const uint64_t next = bit >= 64 ? (dividend.high >> (bit - 64)) & 1 : (dividend.low >> bit) & 1;
+        remainder = (remainder << 1) | next;
+        quotient <<= 1;
+        if(remainder >= divisor) {
+            remainder -= divisor;
+            quotient |= 1;
+        }
+    }
+    return quotient;
+}
+
+uint64_t magnitude(const int64_t value) {
+    return value < 0 ? uint64_t(0) - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+}
+
+/// a * b / c rounded to the closest integer, halves up, without overflowing. c is positive.
+int64_t roundQuotient(const int64_t a, const int64_t b, const int64_t c) {
+    P_ASSERT(c > 0);
+    // floor((2 a b + c) / (2 c))
+    const UInt128 product = multiply(magnitude(a), magnitude(b));
+    const UInt128 twice{(product.high << 1) | (product.low >> 63), product.low << 1};
+    const uint64_t divisor = 2 * static_cast<uint64_t>(c);
+    const bool isNegative = (a < 0) != (b < 0);
+    if(!isNegative) {
+        return static_cast<int64_t>(divide(add(twice, static_cast<uint64_t>(c)), divisor));
+    }
+    if(twice.high == 0 && twice.low <= static_cast<uint64_t>(c)) {
+        return static_cast<int64_t>((static_cast<uint64_t>(c) - twice.low) / divisor);
+    }
+    return -static_cast<int64_t>(divide(add(subtract(twice, static_cast<uint64_t>(c)), divisor - 1), divisor));
+}
+
+struct Segment {
+    Point64 start;
+    Point64 end;
+};
+
+Point64 getMin(const Segment& segment) {
+    return {std::min(segment.start.x, segment.end.x), std::min(segment.start.y, segment.end.y)};
+}
+
+Point64 getMax(const Segment& segment) {
+    return {std::max(segment.start.x, segment.end.x), std::max(segment.start.y, segment.end.y)};
+}
+
+/// The crossing rounded to the closest integer point, if the segments cross in a single point inside both of them.
+/// Segments touching at an end point or overlapping are left to the hot pixels of their end points.
+std::optional<Point64> findCrossing(const Segment& first, const Segment& second) {
+    const int firstStartSide = sign(orientation(second.start, second.end, first.start));
+    const int firstEndSide = sign(orientation(second.start, second.end, first.end));
+    const int secondStartSide = sign(orientation(first.start, first.end, second.start));
+    const int secondEndSide = sign(orientation(first.start, first.end, second.end));
+    if(firstStartSide * firstEndSide >= 0 || secondStartSide * secondEndSide >= 0) {
+        return {};
+    }
+
+    // first.start + t * (first.end - first.start), t = numerator / denominator
+    const Point64 direction{first.end.x - first.start.x, first.end.y - first.start.y};
+    const Point64 secondDirection{second.end.x - second.start.x, second.end.y - second.start.y};
+    int64_t denominator = direction.x * secondDirection.y - direction.y * secondDirection.x;
+    int64_t numerator =
+        (second.start.x - first.start.x) * secondDirection.y - (second.start.y - first.start.y) * secondDirection.x;
+    if(denominator < 0) {
+        denominator = -denominator;
+        numerator = -numerator;
+    }
+    return Point64{first.start.x + roundQuotient(direction.x, numerator, denominator),
+                   first.start.y + roundQuotient(direction.y, numerator, denominator)};
+}
+
+/// Does the segment touch the closed unit square around the center
+bool intersectsPixel(const Segment& segment, const Point64& center) {
+    const Point64 min = getMin(segment);
+    const Point64 max = getMax(segment);
+    if(2 * max.x < 2 * center.x - 1 || 2 * min.x > 2 * center.x + 1 || 2 * max.y < 2 * center.y - 1 ||
+       2 * min.y > 2 * center.y + 1) {
+        return false;
+    }
+
+    // The line crosses the square unless all of its corners are on the same side
+    const Point64 start = doubled(segment.start);
+    const Point64 end = doubled(segment.end);
+    const Point64 doubledCenter = doubled(center);
+    int sides = 0;
+    for(const Point64 offset : {Point64{-1, -1}, Point64{1, -1}, Point64{1, 1}, Point64{-1, 1}}) {
+        sides |= 1 << (sign(orientation(start, end, {doubledCenter.x + offset.x, doubledCenter.y + offset.y})) + 1);
+    }
+    return sides != 1 && sides != 4;
+}
+
+/// Is the point inside the segment, besides its end points
+bool isInside(const Segment& segment, const Point64& point) {
+    return orientation(segment.start, segment.end, point) == 0 && dot(segment.start, segment.end, point) > 0 &&
+           dot(segment.end, segment.start, point) > 0;
+}
+
+/// Uniform grid of cells over a bounding box, finds the items close to a box
+class Grid {
+   public:
+    Grid(const Point64& min, const Point64& max, const size_t itemCount, const bool hasColumns, const bool hasRows)
+        : mMin(min) {
+        const size_t cells = std::clamp<size_t>(static_cast<size_t>(std::sqrt(static_cast<double>(itemCount))), 1,
+                                                MAX_GRID_CELLS);
+        mColumns = hasColumns ? cells : 1;
+        mRows = hasRows ? cells : 1;
+        mCellWidth = (max.x - min.x) / static_cast<int64_t>(mColumns) + 1;
+        mCellHeight = (max.y - min.y) / static_cast<int64_t>(mRows) + 1;
+        mCells.resize(mColumns * mRows);
+    }
+
+    void insert(const uint32_t item, const Point64& min, const Point64& max) {
+        forEachCell(min, max, [item](std::vector<uint32_t>& cell) { cell.push_back(item); });
+    }
+
+    std::vector<uint32_t>& getCell(const Point64& point) {
+        return mCells[getRow(point.y) * mColumns + getColumn(point.x)];
+    }
+
+    /// Call f on the items of each cell overlapping the box
+    template <typename Func>
+    void forEachCell(const Point64& min, const Point64& max, Func f) {
+        const size_t lastRow = getRow(max.y);
+        const size_t lastColumn = getColumn(max.x);
+        for(size_t row = getRow(min.y); row <= lastRow; ++row) {
+            for(size_t column = getColumn(min.x); column <= lastColumn; ++column) {
+                f(mCells[row * mColumns + column]);
+            }
+        }
+    }
+
+   private:
+    size_t getColumn(const int64_t x) const {
+        return static_cast<size_t>(std::clamp<int64_t>((x - mMin.x) / mCellWidth, 0, mColumns - 1));
+    }
+
+    size_t getRow(const int64_t y) const {
+        return static_cast<size_t>(std::clamp<int64_t>((y - mMin.y) / mCellHeight, 0, mRows - 1));
+    }
+
+    Point64 mMin;
+    int64_t mCellWidth;
+    int64_t mCellHeight;
+    size_t mColumns;
+    size_t mRows;
+    std::vector<std::vector<uint32_t>> mCells;
+};
+
+/// Add the rounded crossings of the segments to the points
+void findCrossings(const std::vector<Segment>& segments, const Point64& min, const Point64& max,
+                   std::vector<Point64>& points) {
+    Grid grid(min, max, segments.size(), true, true);
+    for(uint32_t segmentIdx = 0; segmentIdx < segments.size(); ++segmentIdx) {
+        grid.insert(segmentIdx, getMin(segments[segmentIdx]), getMax(segments[segmentIdx]));
+    }
+
+    for(uint32_t segmentIdx = 0; segmentIdx < segments.size(); ++segmentIdx) {
+        const Segment& segment = segments[segmentIdx];
+        const Point64 segmentMin = getMin(segment);
+        const Point64 segmentMax = getMax(segment);
+        grid.forEachCell(segmentMin, segmentMax, [&](const std::vector<uint32_t>& cell) {
+            for(const uint32_t otherIdx : cell) {
+                if(otherIdx <= segmentIdx) {
+                    continue;
+                }
+                const Point64 otherMin = getMin(segments[otherIdx]);
+                const Point64 otherMax = getMax(segments[otherIdx]);
+                const Point64 overlapMin{std::max(segmentMin.x, otherMin.x), std::max(segmentMin.y, otherMin.y)};
+                const Point64 overlapMax{std::min(segmentMax.x, otherMax.x), std::min(segmentMax.y, otherMax.y)};
+                // Each pair is tested only in the cell of the corner of the overlap of their boxes
+                if(overlapMin.x > overlapMax.x || overlapMin.y > overlapMax.y || &grid.getCell(overlapMin) != &cell) {
+                    continue;
+                }
+                if(const std::optional<Point64> crossing = findCrossing(segment, segments[otherIdx])) {
+                    points.push_back(*crossing);
+                }
+            }
+        });
+    }
+}
+
+/// Piece of a rounded edge of an operand from its lower to its higher point. The winding is +1 if the edge goes from
+/// the lower point to the higher one, -1 otherwise.
+struct Fragment {
+    Point64 low;
+    Point64 high;
+    uint32_t operand;
+    int32_t winding;
+};
+
+/// Edges of the snap rounded arrangement of all operands, they meet each other only at their end points
+struct Arrangement {
+    struct Edge {
+        Point64 low;
+        Point64 high;
+
+        /// Range of the windings of the edge, only the operands with a non-zero sum of windings along it are kept
+        uint32_t windingsBegin;
+        uint32_t windingsEnd;
+    };
+
+    std::vector<Edge> edges;
+
+    /// Operands and the sums of the windings of their fragments along the edges
+    std::vector<std::pair<uint32_t, int32_t>> windings;
+};
+
+/// Split the segment at the hot pixels it passes through, adding the pieces to the fragments
+void snapSegment(const Segment& segment, const uint32_t operand, const std::vector<Point64>& hotPixels,
+                 Grid& pixelGrid, std::vector<Fragment>& fragments) {
+    std::vector<std::pair<int64_t, Point64>> path;
+    const Point64 min = getMin(segment);
+    const Point64 max = getMax(segment);
+    pixelGrid.forEachCell({min.x - 1, min.y - 1}, {max.x + 1, max.y + 1}, [&](const std::vector<uint32_t>& cell) {
+        for(const uint32_t pixelIdx : cell) {
+            const Point64& pixel = hotPixels[pixelIdx];
+            if(pixel != segment.start && pixel != segment.end && intersectsPixel(segment, pixel)) {
+                path.emplace_back(dot(segment.start, segment.end, pixel), pixel);
+            }
+        }
+    });
+    std::sort(path.begin(), path.end());
+
+    Point64 previous = segment.start;
+    const auto addFragment = [&](const Point64& next) {
+        if(next == previous) {
+            return;
+        }
+        const bool isForward = previous < next;
+        fragments.push_back({isForward ? previous : next, isForward ? next : previous, operand, isForward ? 1 : -1});
+        previous = next;
+    };
+    for(const auto& pixel : path) {
+        addFragment(pixel.second);
+    }
+    addFragment(segment.end);
+}
+
+/// Pieces of the fragments between the hot pixels on them, which the snapped segments passed through without snapping
+std::vector<Fragment> splitAtHotPixels(const std::vector<Fragment>& fragments, const std::vector<Point64>& hotPixels,
+                                       Grid& pixelGrid) {
+    std::vector<Fragment> pieces;
+    pieces.reserve(fragments.size());
+    std::vector<std::pair<int64_t, Point64>> splits;
+    for(const Fragment& fragment : fragments) {
+        const Segment segment{fragment.low, fragment.high};
+        splits.clear();
+        pixelGrid.forEachCell(getMin(segment), getMax(segment), [&](const std::vector<uint32_t>& cell) {
+            for(const uint32_t pixelIdx : cell) {
+                if(isInside(segment, hotPixels[pixelIdx])) {
+                    splits.emplace_back(dot(fragment.low, fragment.high, hotPixels[pixelIdx]), hotPixels[pixelIdx]);
+                }
+            }
+        });
+        if(splits.empty()) {
+            pieces.push_back(fragment);
+            continue;
+        }
+
+        // Points along the fragment from its lower point are higher themselves
+        std::sort(splits.begin(), splits.end());
+        Point64 previous = fragment.low;
+        for(const auto& split : splits) {
+            pieces.push_back({previous, split.second, fragment.operand, fragment.winding});
+            previous = split.second;
+        }
+        pieces.push_back({previous, fragment.high, fragment.operand, fragment.winding});
+    }
+    return pieces;
+}
+
+/// Merge the fragments along the same edge, dropping the edges where the windings of every operand cancel out
+Arrangement mergeFragments(std::vector<Fragment>& fragments) {
+    std::sort(fragments.begin(), fragments.end(), [](const Fragment& first, const Fragment& second) {
+        if(first.low != second.low) {
+            return first.low < second.low;
+        }
+        return first.high != second.high ? first.high < second.high : first.operand < second.operand;
+    });
+
+    Arrangement arrangement;
+    for(size_t fragmentIdx = 0; fragmentIdx < fragments.size();) {
+        const Fragment& first = fragments[fragmentIdx];
+        Arrangement::Edge edge{first.low, first.high, static_cast<uint32_t>(arrangement.windings.size()), 0};
+        while(fragmentIdx < fragments.size() && fragments[fragmentIdx].low == edge.low &&
+              fragments[fragmentIdx].high == edge.high) {
+            const uint32_t operand = fragments[fragmentIdx].operand;
+            int32_t winding = 0;
+            for(; fragmentIdx < fragments.size() && fragments[fragmentIdx].low == edge.low &&
+                  fragments[fragmentIdx].high == edge.high && fragments[fragmentIdx].operand == operand;
+                ++fragmentIdx) {
+                winding += fragments[fragmentIdx].winding;
+            }
+            if(winding != 0) {
+                arrangement.windings.emplace_back(operand, winding);
+            }
+        }
+        edge.windingsEnd = static_cast<uint32_t>(arrangement.windings.size());
+        if(edge.windingsEnd != edge.windingsBegin) {
+            arrangement.edges.push_back(edge);
+        }
+    }
+    return arrangement;
+}
+
+/// Snap rounded arrangement of the rings of all operands
+Arrangement buildArrangement(const std::vector<const std::vector<FixedPointRing>*>& operands) {
+    std::vector<Segment> segments;
+    std::vector<uint32_t> segmentOperands;
+    Point64 min{std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::max()};
+    Point64 max{std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::min()};
+    for(uint32_t operand = 0; operand < operands.size(); ++operand) {
+        for(const FixedPointRing& ring : *operands[operand]) {
+            for(size_t pointIdx = 0; pointIdx < ring.size(); ++pointIdx) {
+                const Point64 start = toPoint64(ring[pointIdx]);
+                const Point64 end = toPoint64(ring[(pointIdx + 1) % ring.size()]);
+                P_ASSERT(std::abs(start.x) <= FixedPointPolygonSet::MAX_COORDINATE &&
+                         std::abs(start.y) <= FixedPointPolygonSet::MAX_COORDINATE);
+                if(start != end) {
+                    segments.push_back({start, end});
+                    segmentOperands.push_back(operand);
+                    min = {std::min(min.x, start.x), std::min(min.y, start.y)};
+                    max = {std::max(max.x, start.x), std::max(max.y, start.y)};
+                }
+            }
+        }
+    }
+    if(segments.empty()) {
+        return {};
+    }
+
+    // Hot pixels around the end points and the crossings, the crossings are rounded inside the bounding box
+    std::vector<Point64> hotPixels;
+    hotPixels.reserve(2 * segments.size());
+    for(const Segment& segment : segments) {
+        hotPixels.push_back(segment.start);
+    }
+    findCrossings(segments, min, max, hotPixels);
+
+    Arrangement arrangement;
+    std::vector<Fragment> fragments;
+    for(size_t round = 0; round < MAX_SNAP_ROUNDS; ++round) {
+        std::sort(hotPixels.begin(), hotPixels.end());
+        hotPixels.erase(std::unique(hotPixels.begin(), hotPixels.end()), hotPixels.end());
+        Grid pixelGrid(min, max, hotPixels.size(), true, true);
+        for(uint32_t pixelIdx = 0; pixelIdx < hotPixels.size(); ++pixelIdx) {
+            pixelGrid.insert(pixelIdx, hotPixels[pixelIdx], hotPixels[pixelIdx]);
+        }
+
+        fragments.clear();
+        for(size_t segmentIdx = 0; segmentIdx < segments.size(); ++segmentIdx) {
+            snapSegment(segments[segmentIdx], segmentOperands[segmentIdx], hotPixels, pixelGrid, fragments);
+        }
+        // Overlapping fragments are split at the end points of each other before they are merged
+        fragments = splitAtHotPixels(fragments, hotPixels, pixelGrid);
+        arrangement = mergeFragments(fragments);
+
+        std::vector<Segment> edges(arrangement.edges.size());
+        std::transform(arrangement.edges.begin(), arrangement.edges.end(), edges.begin(),
+                       [](const Arrangement::Edge& edge) { return Segment{edge.low, edge.high}; });
+        const size_t pixelCount = hotPixels.size();
+        findCrossings(edges, min, max, hotPixels);
+        if(hotPixels.size() == pixelCount) {
+            break;
+        }
+    }
+    return arrangement;
+}
+
+/// Windings of all operands left and right of each edge, found by casting a ray from the middle of the edge.
+/// The rays are vertical, except for vertical edges.
+/// @return Winding of operand i on side s of edge e at [(2 * e + s) * operandCount + i], left side first
+std::vector<int32_t> computeSideWindings(const Arrangement& arrangement, const size_t operandCount) {
+    const std::vector<Arrangement::Edge>& edges = arrangement.edges;
+    Point64 min{std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::max()};
+    Point64 max{std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::min()};
+    for(const Arrangement::Edge& edge : edges) {
+        min = {std::min(min.x, edge.low.x), std::min({min.y, edge.low.y, edge.high.y})};
+        max = {std::max(max.x, edge.high.x), std::max({max.y, edge.low.y, edge.high.y})};
+    }
+    // Vertical strips of the edges which are not vertical, horizontal strips of the edges which are not horizontal
+    Grid columns(min, max, edges.size(), true, false);
+    Grid rows(min, max, edges.size(), false, true);
+    for(uint32_t edgeIdx = 0; edgeIdx < edges.size(); ++edgeIdx) {
+        const Segment segment{edges[edgeIdx].low, edges[edgeIdx].high};
+        if(segment.start.x != segment.end.x) {
+            columns.insert(edgeIdx, getMin(segment), getMax(segment));
+        }
+        if(segment.start.y != segment.end.y) {
+            rows.insert(edgeIdx, getMin(segment), getMax(segment));
+        }
+    }
+
+    std::vector<int32_t> windings(2 * edges.size() * operandCount, 0);
+    const auto addWindings = [&arrangement](const Arrangement::Edge& edge, const int32_t sign, int32_t* side) {
+        for(uint32_t windingIdx = edge.windingsBegin; windingIdx < edge.windingsEnd; ++windingIdx) {
+            side[arrangement.windings[windingIdx].first] += sign * arrangement.windings[windingIdx].second;
+        }
+    };
+    for(uint32_t edgeIdx = 0; edgeIdx < edges.size(); ++edgeIdx) {
+        const Arrangement::Edge& edge = edges[edgeIdx];
+        const Point64 middle{edge.low.x + edge.high.x, edge.low.y + edge.high.y};
+        int32_t* left = &windings[2 * edgeIdx * operandCount];
+        int32_t* right = left + operandCount;
+        if(edge.low.x != edge.high.x) {
+            // The edge goes right, its left side is above. Edges going right above the middle wind clockwise.
+            for(const uint32_t otherIdx : columns.getCell({floorHalf(middle.x), min.y})) {
+                const Arrangement::Edge& other = edges[otherIdx];
+                if(otherIdx != edgeIdx && 2 * other.low.x <= middle.x && middle.x < 2 * other.high.x &&
+                   orientation(doubled(other.low), doubled(other.high), middle) < 0) {
+                    addWindings(other, -1, left);
+                }
+            }
+            std::copy(left, left + operandCount, right);
+            addWindings(edge, -1, right);
+        } else {
+            // The edge goes up, the ray goes right from its right side. Edges going up right of it wind clockwise.
+            for(const uint32_t otherIdx : rows.getCell({min.x, floorHalf(middle.y)})) {
+                const Arrangement::Edge& other = edges[otherIdx];
+                const bool isUpward = other.low.y < other.high.y;
+                const Point64& bottom = isUpward ? other.low : other.high;
+                const Point64& top = isUpward ? other.high : other.low;
+                if(otherIdx != edgeIdx && 2 * bottom.y <= middle.y && middle.y < 2 * top.y &&
+                   orientation(doubled(bottom), doubled(top), middle) > 0) {
+                    addWindings(other, isUpward ? 1 : -1, right);
+                }
+            }
+            std::copy(right, right + operandCount, left);
+            addWindings(edge, 1, left);
+        }
+    }
+    return windings;
+}
+
+/// Is the direction b reached before c when turning counter-clockwise from the direction a, all of them non-zero
+bool isCloserCounterClockwise(const Point64& a, const Point64& b, const Point64& c) {
+    const Point64 origin{0, 0};
+    // Directions in [0, pi) from a are in the first half
+    const auto getHalf = [&](const Point64& direction) {
+        const int64_t side = orientation(origin, a, direction);
+        return side > 0 || (side == 0 && a.x * direction.x + a.y * direction.y > 0) ? 0 : 1;
+    };
+    const int bHalf = getHalf(b);
+    const int cHalf = getHalf(c);
+    if(bHalf != cHalf) {
+        return bHalf < cHalf;
+    }
+    return orientation(origin, b, c) > 0;
+}
+
+/// Closed walks along the directed edges, each with the region on its left, split into simple rings
+std::vector<FixedPointRing> traceRings(std::vector<Segment>& directedEdges) {
+    std::sort(directedEdges.begin(), directedEdges.end(),
+              [](const Segment& first, const Segment& second) { return first.start < second.start; });
+    const auto getOutgoing = [&directedEdges](const Point64& point) {
+        return std::equal_range(directedEdges.begin(), directedEdges.end(), Segment{point, point},
+                                [](const Segment& first, const Segment& second) { return first.start < second.start; });
+    };
+
+    std::vector<FixedPointRing> rings;
+    std::vector<bool> isUsed(directedEdges.size(), false);
+    std::vector<Point64> walk;
+    for(size_t firstIdx = 0; firstIdx < directedEdges.size(); ++firstIdx) {
+        if(isUsed[firstIdx]) {
+            continue;
+        }
+        isUsed[firstIdx] = true;
+        walk.clear();
+        size_t currentIdx = firstIdx;
+        bool isClosed = false;
+        while(!isClosed) {
+            const Segment& current = directedEdges[currentIdx];
+            walk.push_back(current.start);
+
+            // The region is left of the edges, the next edge is the first one clockwise from the way back
+            const Point64 back{current.start.x - current.end.x, current.start.y - current.end.y};
+            std::optional<size_t> nextIdx;
+            Point64 nextDirection{0, 0};
+            const auto outgoing = getOutgoing(current.end);
+            for(auto it = outgoing.first; it != outgoing.second; ++it) {
+                const size_t candidateIdx = static_cast<size_t>(it - directedEdges.begin());
+                if(isUsed[candidateIdx] && candidateIdx != firstIdx) {
+                    continue;
+                }
+                const Point64 direction{it->end.x - it->start.x, it->end.y - it->start.y};
+                if(!nextIdx || isCloserCounterClockwise(back, nextDirection, direction)) {
+                    nextIdx = candidateIdx;
+                    nextDirection = direction;
+                }
+            }
+            if(!nextIdx) {
+                // Only possible if the rounding left a crossing, the walk is dropped
+                break;
+            }
+            isClosed = *nextIdx == firstIdx;
+            isUsed[*nextIdx] = true;
+            currentIdx = *nextIdx;
+        }
+        if(!isClosed) {
+            continue;
+        }
+
+        // A walk visiting a point twice, e.g., around a hole touching the outer boundary, is split at the point
+        std::vector<Point64> stack;
+        std::map<Point64, size_t> positions;
+        const auto addRing = [&rings](std::vector<Point64>::const_iterator begin,
+                                      std::vector<Point64>::const_iterator end) {
+            FixedPointRing ring(static_cast<size_t>(end - begin));
+            std::transform(begin, end, ring.begin(), toFixedPoint);
+            rings.push_back(std::move(ring));
+        };
+        for(const Point64& point : walk) {
+            const auto found = positions.find(point);
+            if(found == positions.end()) {
+                positions.emplace(point, stack.size());
+                stack.push_back(point);
+                continue;
+            }
+            addRing(stack.begin() + found->second, stack.end());
+            for(size_t i = found->second + 1; i < stack.size(); ++i) {
+                positions.erase(stack[i]);
+            }
+            stack.resize(found->second + 1);
+        }
+        addRing(stack.begin(), stack.end());
+    }
+    return rings;
+}
+
+int64_t getRingDoubleArea(const FixedPointRing& ring) {
+    int64_t area = 0;
+    for(size_t pointIdx = 0; pointIdx < ring.size(); ++pointIdx) {
+        const FixedPoint& point = ring[pointIdx];
+        const FixedPoint& next = ring[(pointIdx + 1) % ring.size()];
+        area += int64_t(point.x) * next.y - int64_t(point.y) * next.x;
+    }
+    return area;
+}
+
+/// Is the point inside the simple ring, the point is given in doubled coordinates and must not lie on the ring
+bool isInsideRing(const FixedPointRing& ring, const Point64& doubledPoint) {
+    bool isInside = false;
+    for(size_t pointIdx = 0; pointIdx < ring.size(); ++pointIdx) {
+        Point64 a = doubled(toPoint64(ring[pointIdx]));
+        Point64 b = doubled(toPoint64(ring[(pointIdx + 1) % ring.size()]));
+        if(a.y > b.y) {
+            std::swap(a, b);
+        }
+        // Edges crossing the ray to the right of the point
+        if(a.y <= doubledPoint.y && doubledPoint.y < b.y && orientation(a, b, doubledPoint) > 0) {
+            isInside = !isInside;
+        }
+    }
+    return isInside;
+}
+
+/// Boundaries of several regions over one arrangement of the operands, the regions share the rounding of the edges.
+/// @param isInside Is a point with the windings of the operands inside the region, called as
+///                 isInside(regionIdx, const int32_t* windings) with a winding for each operand
+template <typename IsInside>
+std::vector<std::vector<FixedPointRing>> computeRegions(const std::vector<const std::vector<FixedPointRing>*>& operands,
+                                                        const size_t regionCount, const IsInside& isInside) {
+    const Arrangement arrangement = buildArrangement(operands);
+    const std::vector<int32_t> sideWindings = computeSideWindings(arrangement, operands.size());
+
+    std::vector<std::vector<FixedPointRing>> regions(regionCount);
+    std::vector<Segment> boundary;
+    for(size_t regionIdx = 0; regionIdx < regionCount; ++regionIdx) {
+        // The boundary of the region, directed so that the region is on its left
+        boundary.clear();
+        for(size_t edgeIdx = 0; edgeIdx < arrangement.edges.size(); ++edgeIdx) {
+            const Arrangement::Edge& edge = arrangement.edges[edgeIdx];
+            const int32_t* left = &sideWindings[2 * edgeIdx * operands.size()];
+            const bool isLeftInside = isInside(regionIdx, left);
+            if(isLeftInside != isInside(regionIdx, left + operands.size())) {
+                boundary.push_back(isLeftInside ? Segment{edge.low, edge.high} : Segment{edge.high, edge.low});
+            }
+        }
+
+        for(FixedPointRing& ring : traceRings(boundary)) {
+            if(ring.size() >= 3 && getRingDoubleArea(ring) != 0) {
+                regions[regionIdx].push_back(std::move(ring));
+            }
+        }
+    }
+    return regions;
+}
+}  // namespace
+
+FixedPointPolygonSet::FixedPointPolygonSet(const std::vector<FixedPointRing>& rings) {
+    overlay(rings, Operation::Join);
+}
+
+std::vector<FixedPointPolygonSet::PolygonWithHoles> FixedPointPolygonSet::getPolygonsWithHoles() const {
+    std::vector<PolygonWithHoles> polygons;
+    std::vector<int64_t> areas;
+    std::vector<const FixedPointRing*> holes;
+    for(const FixedPointRing& ring : mRings) {
+        const int64_t area = getRingDoubleArea(ring);
+        if(area > 0) {
+            polygons.push_back({ring, {}});
+            areas.push_back(area);
+        } else {
+            holes.push_back(&ring);
+        }
+    }
+
+    for(const FixedPointRing* hole : holes) {
+        // The middle of an edge of the hole is not on any other ring
+        const Point64 middle{int64_t((*hole)[0].x) + (*hole)[1].x, int64_t((*hole)[0].y) + (*hole)[1].y};
+        std::optional<size_t> ownerIdx;
+        for(size_t polygonIdx = 0; polygonIdx < polygons.size(); ++polygonIdx) {
+            if((!ownerIdx || areas[polygonIdx] < areas[*ownerIdx]) &&
+               isInsideRing(polygons[polygonIdx].outerBoundary, middle)) {
+                ownerIdx = polygonIdx;
+            }
+        }
+        P_ASSERT(ownerIdx);
+        if(ownerIdx) {
+            polygons[*ownerIdx].holes.push_back(*hole);
+        }
+    }
+    return polygons;
+}
+
+int64_t FixedPointPolygonSet::getDoubleArea() const {
+    int64_t area = 0;
+    for(const FixedPointRing& ring : mRings) {
+        area += getRingDoubleArea(ring);
+    }
+    return area;
+}
+
+std::pair<FixedPoint, FixedPoint> FixedPointPolygonSet::getBoundingBox() const {
+    if(mRings.empty()) {
+        return {};
+    }
+    FixedPoint min = mRings.front().front();
+    FixedPoint max = min;
+    for(const FixedPointRing& ring : mRings) {
+        for(const FixedPoint& point : ring) {
+            min = {std::min(min.x, point.x), std::min(min.y, point.y)};
+            max = {std::max(max.x, point.x), std::max(max.y, point.y)};
+        }
+    }
+    return {min, max};
+}
+
+void FixedPointPolygonSet::join(const FixedPointPolygonSet& other) {
+    if(other.isEmpty()) {
+        return;
+    }
+    if(isEmpty()) {
+        mRings = other.mRings;
+    } else if(isSeparated(other)) {
+        mRings.insert(mRings.end(), other.mRings.begin(), other.mRings.end());
+    } else {
+        overlay(other.mRings, Operation::Join);
+    }
+}
+
+void FixedPointPolygonSet::intersection(const FixedPointPolygonSet& other) {
+    if(isEmpty() || other.isEmpty() || isSeparated(other)) {
+        mRings.clear();
+    } else {
+        overlay(other.mRings, Operation::Intersection);
+    }
+}
+
+void FixedPointPolygonSet::difference(const FixedPointPolygonSet& other) {
+    if(!isEmpty() && !other.isEmpty() && !isSeparated(other)) {
+        overlay(other.mRings, Operation::Difference);
+    }
+}
+
+bool FixedPointPolygonSet::isSeparated(const FixedPointPolygonSet& other) const {
+    const auto box = getBoundingBox();
+    const auto otherBox = other.getBoundingBox();
+    return box.second.x < otherBox.first.x || otherBox.second.x < box.first.x || box.second.y < otherBox.first.y ||
+           otherBox.second.y < box.first.y;
+}
+
+std::vector<FixedPointPolygonSet> FixedPointPolygonSet::paint(const std::vector<std::vector<FixedPointRing>>& layers,
+                                                           const size_t paintedIdx,
+                                                           const FixedPointPolygonSet& shape) {
+    P_ASSERT(paintedIdx < layers.size());
+
+    // The shape is the last operand
+    std::vector<const std::vector<FixedPointRing>*> operands;
+    for(const std::vector<FixedPointRing>& layer : layers) {
+        operands.push_back(&layer);
+    }
+    operands.push_back(&shape.mRings);
+    auto regions = computeRegions(operands, layers.size(), [&layers, paintedIdx](const size_t layerIdx,
+                                                                                 const int32_t* windings) {
+        const bool isInsideShape = windings[layers.size()] != 0;
+        return layerIdx == paintedIdx ? windings[layerIdx] != 0 || isInsideShape
+                                      : windings[layerIdx] != 0 && !isInsideShape;
+    });
+    std::vector<FixedPointPolygonSet> painted(layers.size());
+    for(size_t layerIdx = 0; layerIdx < layers.size(); ++layerIdx) {
+        painted[layerIdx].mRings = std::move(regions[layerIdx]);
+    }
+    return painted;
+}
+
+void FixedPointPolygonSet::overlay(const std::vector<FixedPointRing>& otherRings, const Operation operation) {
+    auto regions = computeRegions({&mRings, &otherRings}, 1, [operation](size_t, const int32_t* windings) {
+        const bool isInsideThis = windings[0] != 0;
+        const bool isInsideOther = windings[1] != 0;
+        switch(operation) {
+            case Operation::Join: return isInsideThis || isInsideOther;
+            case Operation::Intersection: return isInsideThis && isInsideOther;
+            case Operation::Difference: return isInsideThis && !isInsideOther;
+        }
+        return false;
+    });
+    mRings = std::move(regions.front());
+}
+
+FixedPointFrame::FixedPointFrame(const std::array<glm::dvec2, 3>& vertices) : mVertices(vertices) {
+    const glm::dmat2 edges(vertices[1] - vertices[0], vertices[2] - vertices[0]);
+    P_ASSERT(glm::determinant(edges) > 0.0);
+    mInverseEdges = glm::inverse(edges);
+}
+
+glm::dvec2 FixedPointFrame::getWeights(const glm::dvec2& point) const {
+    return mInverseEdges * (point - mVertices[0]);
+}
+
+FixedPoint FixedPointFrame::roundWeights(const glm::dvec2& weights) {
+    const double scale = static_cast<double>(SCALE);
+    std::array<double, 3> scaled;
+    scaled[1] = std::clamp(weights.x * scale, double(MIN_COORDINATE), double(MAX_COORDINATE));
+    scaled[2] = std::clamp(weights.y * scale, double(MIN_COORDINATE), double(MAX_COORDINATE));
+    scaled[0] = scale - scaled[1] - scaled[2];
+
+    // Round down, the weights with the largest remainders get the rest of the sum
+    std::array<int64_t, 3> rounded;
+    std::array<double, 3> remainders;
+    int64_t missing = SCALE;
+    for(size_t i = 0; i < 3; ++i) {
+        const double floor = std::floor(scaled[i]);
+        rounded[i] = static_cast<int64_t>(floor);
+        remainders[i] = scaled[i] - floor;
+        missing -= rounded[i];
+    }
+    std::array<size_t, 3> order{0, 1, 2};
+    std::stable_sort(order.begin(), order.end(), [&remainders](const size_t first, const size_t second) {
+        return remainders[first] > remainders[second];
+    });
+    for(size_t i = 0; i < 3 && missing > 0; ++i, --missing) {
+        ++rounded[order[i]];
+    }
+    return {static_cast<int32_t>(rounded[1]), static_cast<int32_t>(rounded[2])};
+}
+
+FixedPoint FixedPointFrame::toFixed(const glm::dvec2& point) const {
+    return roundWeights(getWeights(point));
+}
+
+FixedPointRing FixedPointFrame::toFixed(const std::vector<glm::dvec2>& ring) const {
+    std::vector<glm::dvec2> weights(ring.size());
+    std::transform(ring.begin(), ring.end(), weights.begin(),
+                   [this](const glm::dvec2& point) { return getWeights(point); });
+
+    // Clip by the sides of the box of the coordinates, the scaled weights stay far from the limits of the integers
+    const double low = static_cast<double>(MIN_COORDINATE) / SCALE;
+    const double high = static_cast<double>(MAX_COORDINATE) / SCALE;
+    std::vector<glm::dvec2> clipped;
+    for(size_t axis = 0; axis < 2; ++axis) {
+        for(const double limit : {low, high}) {
+            const auto isInside = [axis, limit, low](const glm::dvec2& point) {
+                return limit == low ? point[axis] >= limit : point[axis] <= limit;
+            };
+            clipped.clear();
+            for(size_t pointIdx = 0; pointIdx < weights.size(); ++pointIdx) {
+                const glm::dvec2& point = weights[pointIdx];
+                const glm::dvec2& next = weights[(pointIdx + 1) % weights.size()];
+                if(isInside(point)) {
+                    clipped.push_back(point);
+                }
+                if(isInside(point) != isInside(next)) {
+                    const double t = (limit - point[axis]) / (next[axis] - point[axis]);
+                    clipped.push_back(point + (next - point) * t);
+                }
+            }
+            weights.swap(clipped);
+        }
+    }
+
+    FixedPointRing fixedRing;
+    fixedRing.reserve(weights.size());
+    for(const glm::dvec2& point : weights) {
+        const FixedPoint fixedPoint = roundWeights(point);
+        if(fixedRing.empty() || fixedRing.back() != fixedPoint) {
+            fixedRing.push_back(fixedPoint);
+        }
+    }
+    while(fixedRing.size() > 1 && fixedRing.back() == fixedRing.front()) {
+        fixedRing.pop_back();
+    }
+    if(fixedRing.size() < 3) {
+        fixedRing.clear();
+    }
+    return fixedRing;
+}
+
+glm::dvec2 FixedPointFrame::toPlane(const FixedPoint& point) const {
+    const double scale = static_cast<double>(SCALE);
+    return mVertices[0] + (mVertices[1] - mVertices[0]) * (point.x / scale) +
+           (mVertices[2] - mVertices[0]) * (point.y / scale);
+}
+
+FixedPointPolygonSet FixedPointFrame::getBounds() {
+    static const FixedPointPolygonSet bounds({{FixedPoint{0, 0}, FixedPoint{SCALE, 0}, FixedPoint{0, SCALE}}});
+    return bounds;
+}
+
+}  // namespace pepr3d
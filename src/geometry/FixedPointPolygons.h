@@ -0,0 +1,147 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <utility>
+#include <vector>
+
+namespace pepr3d {
+
+/// Point with integer coordinates, see FixedPointFrame
+struct FixedPoint {
+    int32_t x = 0;
+    int32_t y = 0;
+
+    bool operator==(const FixedPoint& other) const {
+        return x == other.x && y == other.y;
+    }
+
+    bool operator!=(const FixedPoint& other) const {
+        return !(*this == other);
+    }
+
+    bool operator<(const FixedPoint& other) const {
+        return x < other.x || (x == other.x && y < other.y);
+    }
+};
+
+/// Closed boundary of a polygon, the last point is connected to the first one
+using FixedPointRing = std::vector<FixedPoint>;
+
+/// Polygons with holes with integer coordinates and Boolean operations on them, an alternative to CGAL::Polygon_set_2
+/// without exact numbers. The crossings of the edges are rounded to integers by snap rounding: every edge passing
+/// through the unit square around a vertex or a crossing is bent through its center. The rounded edges never cross,
+/// so the operations never fail on degenerate input, and the vertices of the result are computed in integers only.
+/// The result moves by at most a unit from the exact result.
+class FixedPointPolygonSet {
+   public:
+    struct PolygonWithHoles {
+        /// Counter-clockwise
+        FixedPointRing outerBoundary;
+
+        /// Clockwise, inside the outer boundary
+        std::vector<FixedPointRing> holes;
+    };
+
+    /// Largest absolute value of a coordinate, all products of the operations fit into 64 bits
+    static constexpr int32_t MAX_COORDINATE = 1 << 28;
+
+    FixedPointPolygonSet() = default;
+
+    /// Region enclosed by the rings by the non-zero winding rule. The rings may overlap and intersect themselves.
+    explicit FixedPointPolygonSet(const std::vector<FixedPointRing>& rings);
+
+    bool isEmpty() const {
+        return mRings.empty();
+    }
+
+    /// Boundaries of the region, outer boundaries counter-clockwise and holes clockwise. The rings are simple and
+    /// meet each other at most in vertices.
+    const std::vector<FixedPointRing>& getRings() const {
+        return mRings;
+    }
+
+    /// Rings grouped into polygons, each hole belongs to the smallest outer boundary around it
+    std::vector<PolygonWithHoles> getPolygonsWithHoles() const;
+
+    /// Twice the area of the region
+    int64_t getDoubleArea() const;
+
+    /// Smallest and largest coordinates of the rings, both zero for an empty set
+    std::pair<FixedPoint, FixedPoint> getBoundingBox() const;
+
+    /// Add the other region to this one
+    void join(const FixedPointPolygonSet& other);
+
+    /// Keep only the part of this region inside the other one
+    void intersection(const FixedPointPolygonSet& other);
+
+    /// Remove the other region from this one
+    void difference(const FixedPointPolygonSet& other);
+
+    /// Paint the shape over disjoint layers of colors: it is added to the painted layer and removed from the others.
+    /// All layers are rounded in one arrangement, so the boundaries they share stay the same in all of them.
+    /// @param layers Rings of each layer by the non-zero winding rule, like the rings of the constructor
+    static std::vector<FixedPointPolygonSet> paint(const std::vector<std::vector<FixedPointRing>>& layers,
+                                                   size_t paintedIdx, const FixedPointPolygonSet& shape);
+
+   private:
+    enum class Operation { Join, Intersection, Difference };
+
+    /// Replace the rings by the boundary of the result, the rings of both sets are read by the non-zero rule
+    void overlay(const std::vector<FixedPointRing>& otherRings, Operation operation);
+
+    /// Do the bounding boxes of the sets have no point in common
+    bool isSeparated(const FixedPointPolygonSet& other) const;
+
+    std::vector<FixedPointRing> mRings;
+};
+
+/// Fixed point barycentric coordinates of a triangle: x and y are the weights of its second and third vertex times
+/// SCALE, the weight of the first vertex is SCALE - x - y. The weights of a point are rounded together so that they
+/// keep their sum, a weight that is zero stays zero. Points on an edge of the triangle stay on it and a point of an
+/// edge shared by two triangles gets the same weights of the two vertices of the edge in both of them.
+class FixedPointFrame {
+   public:
+    /// Sum of the weights, the resolution of the coordinates inside the triangle
+    static constexpr int32_t SCALE = 1 << 26;
+
+    /// @param vertices Counter-clockwise vertices of the triangle in its plane
+    explicit FixedPointFrame(const std::array<glm::dvec2, 3>& vertices);
+
+    /// Rounded coordinates of a point, points far outside of the triangle are clamped
+    FixedPoint toFixed(const glm::dvec2& point) const;
+
+    /// Rounded ring of a polygon. Its parts far outside of the triangle are clipped, to stay within the coordinates.
+    FixedPointRing toFixed(const std::vector<glm::dvec2>& ring) const;
+
+    /// Point of the plane with the coordinates, up to the rounding of doubles
+    glm::dvec2 toPlane(const FixedPoint& point) const;
+
+    /// Weights of the three vertices, their sum is SCALE
+    static std::array<int64_t, 3> getWeights(const FixedPoint& point) {
+        return {int64_t(SCALE) - point.x - point.y, point.x, point.y};
+    }
+
+    /// Region of the triangle itself
+    static FixedPointPolygonSet getBounds();
+
+   private:
+    /// Smallest and largest coordinate kept by toFixed(), well outside of the triangle
+    static constexpr int32_t MIN_COORDINATE = -SCALE;
+    static constexpr int32_t MAX_COORDINATE = 2 * SCALE;
+
+    /// Weights of the second and the third vertex, not rounded
+    glm::dvec2 getWeights(const glm::dvec2& point) const;
+
+    /// Rounded coordinates from the weights of the second and the third vertex
+    static FixedPoint roundWeights(const glm::dvec2& weights);
+
+    std::array<glm::dvec2, 3> mVertices;
+
+    /// Inverse of the matrix with the edges from the first vertex as columns
+    glm::dmat2 mInverseEdges;
+};
+
+}  // namespace pepr3d
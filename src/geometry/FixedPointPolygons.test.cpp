@@ -0,0 +1,194 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <array>
+#include <cmath>
+#include <random>
+#include <glm/gtc/constants.hpp>
+#include <vector>
+
+#include "geometry/FixedPointPolygons.h"
+
+namespace {
+using pepr3d::FixedPoint;
+using pepr3d::FixedPointFrame;
+using pepr3d::FixedPointPolygonSet;
+using pepr3d::FixedPointRing;
+
+FixedPointPolygonSet getSquare(const int32_t x, const int32_t y, const int32_t size) {
+    return FixedPointPolygonSet({{{x, y}, {x + size, y}, {x + size, y + size}, {x, y + size}}});
+}
+
+/// Star shaped polygon with random radii around the center
+FixedPointRing getRandomStar(std::mt19937& generator, const FixedPoint center, const size_t pointCount) {
+    std::uniform_real_distribution<double> radius(1000.0, 100000.0);
+    FixedPointRing ring;
+    for(size_t i = 0; i < pointCount; ++i) {
+        const double angle = 2.0 * glm::pi<double>() * static_cast<double>(i) / static_cast<double>(pointCount);
+        const double r = radius(generator);
+        ring.push_back({center.x + static_cast<int32_t>(std::lround(r * std::cos(angle))),
+                        center.y + static_cast<int32_t>(std::lround(r * std::sin(angle)))});
+    }
+    return ring;
+}
+}  // namespace
+
+TEST(FixedPointPolygons, SquareOperations) {
+    FixedPointPolygonSet joined = getSquare(0, 0, 10);
+    joined.join(getSquare(5, 5, 10));
+    EXPECT_EQ(joined.getDoubleArea(), 2 * 175);
+    EXPECT_EQ(joined.getPolygonsWithHoles().size(), 1);
+
+    FixedPointPolygonSet intersected = getSquare(0, 0, 10);
+    intersected.intersection(getSquare(5, 5, 10));
+    EXPECT_EQ(intersected.getDoubleArea(), 2 * 25);
+
+    FixedPointPolygonSet difference = getSquare(0, 0, 10);
+    difference.difference(getSquare(5, 5, 10));
+    EXPECT_EQ(difference.getDoubleArea(), 2 * 75);
+
+    FixedPointPolygonSet separated = getSquare(0, 0, 10);
+    separated.intersection(getSquare(20, 0, 10));
+    EXPECT_TRUE(separated.isEmpty());
+}
+
+TEST(FixedPointPolygons, Holes) {
+    FixedPointPolygonSet polygon = getSquare(0, 0, 10);
+    polygon.difference(getSquare(3, 3, 3));
+    EXPECT_EQ(polygon.getDoubleArea(), 2 * (100 - 9));
+    const auto polygons = polygon.getPolygonsWithHoles();
+    ASSERT_EQ(polygons.size(), 1);
+    ASSERT_EQ(polygons[0].holes.size(), 1);
+
+    // Filling the hole back leaves the square without any holes
+    polygon.join(getSquare(3, 3, 3));
+    EXPECT_EQ(polygon.getDoubleArea(), 2 * 100);
+    ASSERT_EQ(polygon.getPolygonsWithHoles().size(), 1);
+    EXPECT_TRUE(polygon.getPolygonsWithHoles()[0].holes.empty());
+}
+
+TEST(FixedPointPolygons, DegenerateInput) {
+    // Squares touching in a corner stay two polygons
+    FixedPointPolygonSet corner = getSquare(0, 0, 5);
+    corner.join(getSquare(5, 5, 5));
+    EXPECT_EQ(corner.getDoubleArea(), 2 * 50);
+    EXPECT_EQ(corner.getPolygonsWithHoles().size(), 2);
+
+    // Squares sharing an edge merge into one
+    FixedPointPolygonSet edge = getSquare(0, 0, 10);
+    edge.join(getSquare(10, 0, 10));
+    EXPECT_EQ(edge.getDoubleArea(), 2 * 200);
+    EXPECT_EQ(edge.getPolygonsWithHoles().size(), 1);
+
+    FixedPointPolygonSet touching = getSquare(0, 0, 10);
+    touching.intersection(getSquare(10, 0, 10));
+    EXPECT_TRUE(touching.isEmpty());
+
+    // Self-intersecting ring, both of its triangles are inside by the non-zero rule
+    const FixedPointPolygonSet bowtie({{{0, 0}, {10, 10}, {10, 0}, {0, 10}}});
+    EXPECT_EQ(bowtie.getDoubleArea(), 2 * 50);
+    for(const FixedPointRing& ring : bowtie.getRings()) {
+        EXPECT_GT(ring.size(), 2);
+    }
+}
+
+TEST(FixedPointPolygons, RandomOperations) {
+    std::mt19937 generator(7);
+    for(size_t iteration = 0; iteration < 20; ++iteration) {
+        const FixedPointPolygonSet first({getRandomStar(generator, {0, 0}, 40)});
+        const FixedPointPolygonSet second({getRandomStar(generator, {30000, 10000}, 40)});
+
+        FixedPointPolygonSet joined = first;
+        joined.join(second);
+        FixedPointPolygonSet intersected = first;
+        intersected.intersection(second);
+        FixedPointPolygonSet difference = first;
+        difference.difference(second);
+
+        // Snap rounding moves the edges by less than a unit, each area changes by less than the perimeters of the
+        // operands. Both stars are shorter than 40 edges of 2 * 100000.
+        const double tolerance = 2.0 * 2.0 * 40.0 * 2.0 * 100000.0;
+        EXPECT_NEAR(static_cast<double>(joined.getDoubleArea() + intersected.getDoubleArea()),
+                    static_cast<double>(first.getDoubleArea() + second.getDoubleArea()), tolerance);
+        EXPECT_NEAR(static_cast<double>(difference.getDoubleArea() + intersected.getDoubleArea()),
+                    static_cast<double>(first.getDoubleArea()), tolerance);
+        EXPECT_GE(joined.getDoubleArea(), first.getDoubleArea() - tolerance);
+
+        for(const auto& polygon : joined.getPolygonsWithHoles()) {
+            EXPECT_GT(FixedPointPolygonSet({polygon.outerBoundary}).getDoubleArea(), 0);
+        }
+    }
+}
+
+TEST(FixedPointPolygons, PaintLayers) {
+    // Three layers tiling a square, the shape crosses all of them at points off the grid
+    const std::vector<std::vector<FixedPointRing>> layers{
+        {{{0, 0}, {100000, 0}, {100000, 30001}, {0, 30001}}},
+        {{{0, 30001}, {100000, 30001}, {100000, 70003}, {0, 70003}}},
+        {{{0, 70003}, {100000, 70003}, {100000, 100000}, {0, 100000}}}};
+    std::mt19937 generator(5);
+    for(size_t iteration = 0; iteration < 10; ++iteration) {
+        FixedPointRing star = getRandomStar(generator, {50000, 50000}, 30);
+        for(FixedPoint& point : star) {
+            point = {(point.x - 50000) / 2 + 50000, (point.y - 50000) / 2 + 50000};
+        }
+        const std::vector<FixedPointPolygonSet> painted =
+            FixedPointPolygonSet::paint(layers, 1, FixedPointPolygonSet({star}));
+        ASSERT_EQ(painted.size(), 3);
+
+        // The layers still tile the square exactly
+        int64_t area = 0;
+        for(size_t first = 0; first < painted.size(); ++first) {
+            area += painted[first].getDoubleArea();
+            for(size_t second = first + 1; second < painted.size(); ++second) {
+                FixedPointPolygonSet overlap = painted[first];
+                overlap.intersection(painted[second]);
+                EXPECT_EQ(overlap.getDoubleArea(), 0);
+            }
+        }
+        EXPECT_EQ(area, int64_t(2) * 100000 * 100000);
+        EXPECT_GT(painted[1].getDoubleArea(), int64_t(2) * 100000 * 40002);
+    }
+}
+
+TEST(FixedPointPolygons, FramePoints) {
+    const std::array<glm::dvec2, 3> vertices{glm::dvec2(0.0, 0.0), glm::dvec2(3.0, 0.5), glm::dvec2(1.0, 2.0)};
+    const FixedPointFrame frame(vertices);
+    EXPECT_EQ(frame.toFixed(vertices[0]), (FixedPoint{0, 0}));
+    EXPECT_EQ(frame.toFixed(vertices[1]), (FixedPoint{FixedPointFrame::SCALE, 0}));
+    EXPECT_EQ(frame.toFixed(vertices[2]), (FixedPoint{0, FixedPointFrame::SCALE}));
+
+    std::mt19937 generator(3);
+    std::uniform_int_distribution<int32_t> coordinate(0, FixedPointFrame::SCALE / 2);
+    for(size_t i = 0; i < 1000; ++i) {
+        const FixedPoint point{coordinate(generator), coordinate(generator)};
+        EXPECT_EQ(frame.toFixed(frame.toPlane(point)), point);
+    }
+
+    // A point of an edge shared with another triangle gets the same weights of the vertices of the edge
+    const FixedPointFrame neighbour({vertices[1], vertices[0], glm::dvec2(1.5, -2.0)});
+    for(size_t i = 0; i < 100; ++i) {
+        const double t = static_cast<double>(i) / 99.0;
+        const glm::dvec2 point = vertices[0] + (vertices[1] - vertices[0]) * t;
+        const auto weights = FixedPointFrame::getWeights(frame.toFixed(point));
+        const auto neighbourWeights = FixedPointFrame::getWeights(neighbour.toFixed(point));
+        EXPECT_EQ(weights[2], 0);
+        EXPECT_EQ(neighbourWeights[2], 0);
+        EXPECT_EQ(weights[0], neighbourWeights[1]);
+        EXPECT_EQ(weights[1], neighbourWeights[0]);
+    }
+}
+
+TEST(FixedPointPolygons, FrameClipping) {
+    const FixedPointFrame frame({glm::dvec2(0.0, 0.0), glm::dvec2(1.0, 0.0), glm::dvec2(0.0, 1.0)});
+    const FixedPointRing ring =
+        frame.toFixed({glm::dvec2(-100.0, -100.0), glm::dvec2(100.0, -100.0), glm::dvec2(0.0, 100.0)});
+    ASSERT_FALSE(ring.empty());
+    FixedPointPolygonSet shape({ring});
+    shape.intersection(FixedPointFrame::getBounds());
+    EXPECT_EQ(shape.getDoubleArea(), FixedPointFrame::getBounds().getDoubleArea());
+
+    EXPECT_TRUE(frame.toFixed({glm::dvec2(0.1, 0.1), glm::dvec2(0.1, 0.1), glm::dvec2(0.1, 0.1)}).empty());
+}
+
+#endif
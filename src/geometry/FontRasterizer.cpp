@@ -1,10 +1,19 @@
 #include "FontRasterizer.h"
 
+#include <glm/gtx/rotate_vector.hpp>
+#include <limits>
+#include <numeric>
+#include <set>
+#include <utility>
+#include "peprassert.h"
+
 namespace pepr3d {
 
 std::vector<std::vector<FontRasterizer::Tri>> FontRasterizer::rasterizeText(const std::string textString,
                                                                             const size_t fontHeight,
-                                                                            const size_t bezierSteps) {
+                                                                            const size_t bezierSteps,
+                                                                            const std::atomic<bool>* isCancelled,
+                                                                            ::ThreadPool* threadPool) {
     mPrevCharIndex = 0;
     mCurCharIndex = 0;
     mPrev_rsb_delta = 0;
@@ -12,12 +21,24 @@ std::vector<std::vector<FontRasterizer::Tri>> FontRasterizer::rasterizeText(cons
     const FT_F26Dot6 converted = static_cast<FT_F26Dot6>(fontHeight << 6);
     FT_Set_Char_Size(mFace, converted, converted, 96, 96);
 
+    // Only the pen advance depends on the previous letters, so the glyphs are triangulated first, then placed in order
+    std::vector<FT_UInt> glyphIndices(textString.size());
+    for(size_t i = 0; i < textString.size(); i++) {
+        glyphIndices[i] = FT_Get_Char_Index(mFace, textString[i]);
+    }
+    if(!cacheGlyphs(glyphIndices, fontHeight, bezierSteps, isCancelled, threadPool)) {
+        return {};
+    }
+
     std::vector<std::vector<Tri>> trianglesPerLetter;
 
     double offset = 0;
     for(size_t i = 0; i < textString.size(); i++) {
+        if(isCancelled != nullptr && *isCancelled) {
+            return {};
+        }
         trianglesPerLetter.push_back({});
-        offset = addOneCharacter(textString[i], bezierSteps, offset, trianglesPerLetter.back());
+        offset = addOneCharacter(glyphIndices[i], fontHeight, bezierSteps, offset, trianglesPerLetter.back());
     }
 
     // postprocess by offsetting y-axis to positive numbers
@@ -26,6 +47,97 @@ std::vector<std::vector<FontRasterizer::Tri>> FontRasterizer::rasterizeText(cons
     return trianglesPerLetter;
 }
 
+void FontRasterizer::centerText(std::vector<std::vector<Tri>>& text, const float scale) {
+    for(auto& letter : text) {
+        for(auto& t : letter) {
+            t.a *= scale;
+            t.b *= scale;
+            t.c *= scale;
+        }
+    }
+
+    std::pair<float, float> max = {std::numeric_limits<float>::min(), std::numeric_limits<float>::min()};
+    std::pair<float, float> min = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+
+    auto updateMinMax = [&min, &max](glm::vec3 pt) {
+        if(pt.x > max.first) {
+            max.first = pt.x;
+        }
+        if(pt.y > max.second) {
+            max.second = pt.y;
+        }
+
+        if(pt.x < min.first) {
+            min.first = pt.x;
+        }
+        if(pt.y < min.second) {
+            min.second = pt.y;
+        }
+    };
+
+    for(auto& letter : text) {
+        for(auto& t : letter) {
+            updateMinMax(t.a);
+            updateMinMax(t.b);
+            updateMinMax(t.c);
+        }
+    }
+
+    for(auto& letter : text) {
+        for(auto& t : letter) {
+            t.a.x = t.a.x - min.first - max.first / 2.f;
+            t.a.y = t.a.y - min.second - max.second / 2.f;
+            t.a.z = 0.f;
+
+            t.b.x = t.b.x - min.first - max.first / 2.f;
+            t.b.y = t.b.y - min.second - max.second / 2.f;
+            t.b.z = 0.f;
+
+            t.c.x = t.c.x - min.first - max.first / 2.f;
+            t.c.y = t.c.y - min.second - max.second / 2.f;
+            t.c.z = 0.f;
+
+            t.a.y *= -1;
+            t.b.y *= -1;
+            t.c.y *= -1;
+        }
+    }
+}
+
+glm::vec3 FontRasterizer::getPlaneBaseVector(const glm::vec3& direction, const float rotationDegrees) {
+    P_ASSERT(glm::abs(glm::length(direction) - 1) < 0.01);  // Is normalized
+
+    const glm::vec3 upVector(0.f, 0.f, 1.f);
+
+    glm::vec3 otherDirection{};
+
+    // Test if direction is already pointing upwards or downwards
+    if(glm::abs(glm::dot(direction, upVector)) > 0.98) {
+        otherDirection = glm::vec3(1.f, 0.f, 0.f);  // World right vector
+    } else {
+        otherDirection = upVector;
+    }
+
+    const auto baseVector = glm::cross(direction, otherDirection);
+    return glm::normalize(glm::rotate(baseVector, glm::radians(rotationDegrees), direction));
+}
+
+void FontRasterizer::placeText(std::vector<std::vector<Tri>>& text, const glm::vec3& origin,
+                               const glm::vec3& direction, const float rotationDegrees) {
+    const glm::vec3 planeBase1 = getPlaneBaseVector(direction, rotationDegrees);
+    const glm::vec3 planeBase2 = glm::cross(planeBase1, direction);
+
+    glm::mat3 rotationMat(planeBase1, planeBase2, direction);
+
+    for(auto& letter : text) {
+        for(auto& tri : letter) {
+            tri.a = origin + rotationMat * tri.a;
+            tri.b = origin + rotationMat * tri.b;
+            tri.c = origin + rotationMat * tri.c;
+        }
+    }
+}
+
 void FontRasterizer::outlinePostprocess(std::vector<std::vector<Tri>>& trianglesPerLetter) const {
     float min = std::numeric_limits<float>::max();
 
@@ -76,36 +188,21 @@ void FontRasterizer::outlinePostprocess(std::vector<std::vector<Tri>>& triangles
 }
 
 /// The following code originated from https://github.com/codetiger/Font23D and was modified by the Pepr team
-std::vector<p2t::Point*> FontRasterizer::triangulateContour(Vectoriser* vectoriser, const int c, const float offset) {
+std::vector<p2t::Point*> FontRasterizer::triangulateContour(Vectoriser* vectoriser, const int c) {
     std::vector<p2t::Point*> polyline;
     const Contour* contour = vectoriser->GetContour(c);
     for(size_t p = 0; p < contour->PointCount(); ++p) {
         const double* d = contour->GetPoint(p);
-        polyline.push_back(new p2t::Point((d[0] / 64.0f) + offset, d[1] / 64.0f));
+        polyline.push_back(new p2t::Point(d[0] / 64.0f, d[1] / 64.0f));
     }
     return polyline;
 }
 
 /// The following code originated from https://github.com/codetiger/Font23D and was modified by the Pepr team
-double FontRasterizer::addOneCharacter(const char ch, const size_t bezierSteps, const double offset,
-                                       std::vector<Tri>& outTriangles) {
-    std::vector<Tri> trianglesLetter;
-
-    mCurCharIndex = FT_Get_Char_Index(mFace, ch);
-    if(FT_Load_Glyph(mFace, mCurCharIndex, FT_LOAD_DEFAULT)) {
-        throw std::runtime_error("FT_Load_Glyph failed");
-    }
-
-    FT_Glyph glyph;
-    if(FT_Get_Glyph(mFace->glyph, &glyph)) {
-        throw std::runtime_error("FT_Get_Glyph failed");
-    }
-
-    if(glyph->format != FT_GLYPH_FORMAT_OUTLINE) {
-        throw std::runtime_error("Invalid Glyph Format");
-    }
-
-    const short nCountour = mFace->glyph->outline.n_contours;
+double FontRasterizer::addOneCharacter(const FT_UInt glyphIndex, const size_t fontHeight, const size_t bezierSteps,
+                                       const double offset, std::vector<Tri>& outTriangles) {
+    mCurCharIndex = glyphIndex;
+    const CachedGlyph& glyph = mGlyphCache.at(std::make_tuple(mCurCharIndex, fontHeight, bezierSteps));
 
     double modifiedOffset = offset;
 
@@ -115,16 +212,119 @@ double FontRasterizer::addOneCharacter(const char ch, const size_t bezierSteps,
         modifiedOffset += kerning.x >> 6;
     }
 
-    if(mPrev_rsb_delta - mFace->glyph->lsb_delta >= 32) {
+    if(mPrev_rsb_delta - glyph.lsbDelta >= 32) {
         modifiedOffset -= 1.0f;
-    } else if(mPrev_rsb_delta - mFace->glyph->lsb_delta < -32) {
+    } else if(mPrev_rsb_delta - glyph.lsbDelta < -32) {
         modifiedOffset += 1.0f;
     }
 
-    mPrev_rsb_delta = mFace->glyph->rsb_delta;
+    mPrev_rsb_delta = glyph.rsbDelta;
+
+    // The same rounding of the offset as when the contours were triangulated at it
+    const double glyphOffset = static_cast<float>(modifiedOffset);
+    const auto getVertex = [glyphOffset](const std::array<double, 2>& vertex) {
+        return glm::vec3(static_cast<float>(vertex[0] + glyphOffset), static_cast<float>(-vertex[1]), 0.0f);
+    };
+
+    std::vector<Tri> trianglesLetter;
+    trianglesLetter.reserve(glyph.vertices.size() / 3);
+    for(size_t i = 0; i + 2 < glyph.vertices.size(); i += 3) {
+        Tri t1;
+        t1.a = getVertex(glyph.vertices[i]);
+        t1.b = getVertex(glyph.vertices[i + 1]);
+        t1.c = getVertex(glyph.vertices[i + 2]);
+        trianglesLetter.push_back(t1);
+    }
+
+    mPrevCharIndex = mCurCharIndex;
+    const double chSize = static_cast<double>(glyph.advance >> 6);
+    outTriangles = std::move(trianglesLetter);
+    return modifiedOffset + chSize;
+}
+
+bool FontRasterizer::cacheGlyphs(const std::vector<FT_UInt>& glyphIndices, const size_t fontHeight,
+                                 const size_t bezierSteps, const std::atomic<bool>* isCancelled,
+                                 ::ThreadPool* threadPool) {
+    using GlyphPtr = std::unique_ptr<FT_GlyphRec, void (*)(FT_Glyph)>;
+    struct PendingGlyph {
+        std::tuple<FT_UInt, size_t, size_t> key;
+
+        /// Copy of the outline loaded by the face, owned by the glyph
+        GlyphPtr ftGlyph;
+        CachedGlyph glyph;
+        bool isTriangulated = false;
+    };
+
+    // Load the outlines one by one, on the face
+    std::vector<PendingGlyph> pending;
+    std::set<FT_UInt> pendingIndices;
+    for(const FT_UInt glyphIndex : glyphIndices) {
+        const auto key = std::make_tuple(glyphIndex, fontHeight, bezierSteps);
+        if(mGlyphCache.count(key) > 0 || !pendingIndices.insert(glyphIndex).second) {
+            continue;
+        }
+        if(isCancelled != nullptr && *isCancelled) {
+            return false;
+        }
+
+        if(FT_Load_Glyph(mFace, glyphIndex, FT_LOAD_DEFAULT)) {
+            throw std::runtime_error("FT_Load_Glyph failed");
+        }
+
+        FT_Glyph loadedGlyph;
+        if(FT_Get_Glyph(mFace->glyph, &loadedGlyph)) {
+            throw std::runtime_error("FT_Get_Glyph failed");
+        }
+        GlyphPtr ftGlyph(loadedGlyph, &FT_Done_Glyph);
+        if(ftGlyph->format != FT_GLYPH_FORMAT_OUTLINE) {
+            throw std::runtime_error("Invalid Glyph Format");
+        }
+
+        CachedGlyph glyph;
+        glyph.advance = mFace->glyph->advance.x;
+        glyph.lsbDelta = mFace->glyph->lsb_delta;
+        glyph.rsbDelta = mFace->glyph->rsb_delta;
+        pending.push_back({key, std::move(ftGlyph), std::move(glyph)});
+    }
+
+    // Triangulate the copies of the outlines, the most complex glyphs first
+    const auto triangulate = [&](const size_t pendingIdx) {
+        if(isCancelled != nullptr && *isCancelled) {
+            return;
+        }
+        PendingGlyph& glyph = pending[pendingIdx];
+        const FT_Outline& outline = reinterpret_cast<FT_OutlineGlyph>(glyph.ftGlyph.get())->outline;
+        triangulateOutline(outline, bezierSteps, glyph.glyph);
+        glyph.isTriangulated = true;
+    };
+    std::vector<size_t> pendingIds(pending.size());
+    std::iota(pendingIds.begin(), pendingIds.end(), 0);
+    if(threadPool != nullptr) {
+        threadPool->parallel_for_weighted(pendingIds.begin(), pendingIds.end(), triangulate, [&](const size_t idx) {
+            return reinterpret_cast<FT_OutlineGlyph>(pending[idx].ftGlyph.get())->outline.n_points * bezierSteps;
+        });
+    } else {
+        for(const size_t pendingIdx : pendingIds) {
+            triangulate(pendingIdx);
+        }
+    }
+
+    // The glyphs triangulated before a cancellation are kept
+    for(PendingGlyph& glyph : pending) {
+        if(glyph.isTriangulated) {
+            mGlyphCache.emplace(glyph.key, std::move(glyph.glyph));
+        }
+    }
+    return isCancelled == nullptr || !*isCancelled;
+}
 
+/// The following code originated from https://github.com/codetiger/Font23D and was modified by the Pepr team
+void FontRasterizer::triangulateOutline(const FT_Outline& outline, const size_t bezierSteps, CachedGlyph& outGlyph) {
+    // Vectoriser only reads the outline of the slot
+    FT_GlyphSlotRec slot{};
+    slot.outline = outline;
     std::unique_ptr<Vectoriser> vectoriser =
-        std::make_unique<Vectoriser>(mFace->glyph, static_cast<unsigned short>(bezierSteps));
+        std::make_unique<Vectoriser>(&slot, static_cast<unsigned short>(bezierSteps));
     for(size_t c = 0; c < vectoriser->ContourCount(); ++c) {
         const Contour* contour = vectoriser->GetContour(c);
 
@@ -145,8 +345,7 @@ double FontRasterizer::addOneCharacter(const char ch, const size_t bezierSteps,
         if(contour->GetDirection()) {
             // CAREFUL, this vector is filled with pointers INTO the CDT structure, do NOT delete this as the CDT will
             // crash.
-            std::vector<p2t::Point*> polyline =
-                triangulateContour(vectoriser.get(), static_cast<int>(c), static_cast<float>(modifiedOffset));
+            std::vector<p2t::Point*> polyline = triangulateContour(vectoriser.get(), static_cast<int>(c));
             std::unique_ptr<p2t::CDT> cdt = std::make_unique<p2t::CDT>(polyline);
 
             for(size_t cm = 0; cm < vectoriser->ContourCount(); ++cm) {
@@ -154,8 +353,7 @@ double FontRasterizer::addOneCharacter(const char ch, const size_t bezierSteps,
                 if(c != cm && !sm->GetDirection() && sm->IsInside(contour)) {
                     // CAREFUL, this vector is filled with pointers INTO the CDT structure, do NOT delete this as the
                     // CDT will crash.
-                    std::vector<p2t::Point*> pl =
-                        triangulateContour(vectoriser.get(), static_cast<int>(cm), static_cast<float>(modifiedOffset));
+                    std::vector<p2t::Point*> pl = triangulateContour(vectoriser.get(), static_cast<int>(cm));
                     cdt->AddHole(pl);
                 }
             }
@@ -164,25 +362,13 @@ double FontRasterizer::addOneCharacter(const char ch, const size_t bezierSteps,
             std::vector<p2t::Triangle*> ts = cdt->GetTriangles();
             for(size_t i = 0; i < ts.size(); i++) {
                 p2t::Triangle* ot = ts[i];
-                Tri t1;
-                t1.a.x = static_cast<float>(ot->GetPoint(0)->x);
-                t1.a.y = static_cast<float>(-ot->GetPoint(0)->y);
-                t1.a.z = static_cast<float>(0.0f);
-                t1.b.x = static_cast<float>(ot->GetPoint(1)->x);
-                t1.b.y = static_cast<float>(-ot->GetPoint(1)->y);
-                t1.b.z = static_cast<float>(0.0f);
-                t1.c.x = static_cast<float>(ot->GetPoint(2)->x);
-                t1.c.y = static_cast<float>(-ot->GetPoint(2)->y);
-                t1.c.z = static_cast<float>(0.0f);
-                trianglesLetter.push_back(t1);
+                for(int j = 0; j < 3; j++) {
+                    outGlyph.vertices.push_back({ot->GetPoint(j)->x, ot->GetPoint(j)->y});
+                }
             }
         }
     }
 
-    mPrevCharIndex = mCurCharIndex;
-    const double chSize = static_cast<double>(mFace->glyph->advance.x >> 6);
-    outTriangles = std::move(trianglesLetter);
-    return modifiedOffset + chSize;
 }
 
-}  // namespace pepr3d
\ No newline at end of file
+}  // namespace pepr3d
@@ -12,13 +12,20 @@
 #include "poly2tri/poly2tri.h"
 #pragma warning(pop)
 
+#include <array>
+#include <atomic>
 #include <exception>
+#include <map>
 #include <memory>
 #include <string>
+#include <tuple>
+#include <vector>
 
 #include <cinder/gl/gl.h>
 #include "cinder/Log.h"
 
+#include "ThreadPool.h"
+
 namespace pepr3d {
 
 /// Used for triangulating a font outline
@@ -32,12 +39,27 @@ class FontRasterizer {
     std::string mFontFile;
     bool mFontLoaded = false;
 
-    FT_Library mLibrary;
-    FT_Face mFace;
+    FT_Library mLibrary = nullptr;
+    FT_Face mFace = nullptr;
 
     FT_UInt mPrevCharIndex = 0, mCurCharIndex = 0;
     FT_Pos mPrev_rsb_delta = 0;
 
+    /// Triangulated outline and metrics of a glyph at one font size, with the pen at the origin
+    struct CachedGlyph {
+        /// Vertices of the triangles, 3 per triangle, in the coordinates of poly2tri
+        std::vector<std::array<double, 2>> vertices;
+
+        FT_Pos advance;
+        FT_Pos lsbDelta;
+        FT_Pos rsbDelta;
+    };
+
+    /// Glyphs by (glyph index, font height, bezier steps). The size is a part of the key, since FreeType hints the
+    /// outlines at each size. Pen offsets are whole pixels, so moving a cached outline gives the same coordinates as
+    /// triangulating it at the offset.
+    std::map<std::tuple<FT_UInt, size_t, size_t>, CachedGlyph> mGlyphCache;
+
    public:
     FontRasterizer(const std::string fontFile) : mFontFile(fontFile) {
         mFontLoaded = true;
@@ -53,6 +75,18 @@ class FontRasterizer {
         }
     };
 
+    ~FontRasterizer() {
+        if(mFace != nullptr) {
+            FT_Done_Face(mFace);
+        }
+        if(mLibrary != nullptr) {
+            FT_Done_FreeType(mLibrary);
+        }
+    }
+
+    FontRasterizer(const FontRasterizer&) = delete;
+    FontRasterizer& operator=(const FontRasterizer&) = delete;
+
     std::string getCurrentFont() const {
         return mFontFile;
     }
@@ -61,15 +95,43 @@ class FontRasterizer {
         return mFontLoaded;
     }
 
+    /// Triangulate the text, the glyphs are triangulated once and reused by later calls with the same size.
+    /// Empty if cancelled.
+    /// @param isCancelled Checked before each letter, if not null
+    /// @param threadPool Triangulates the glyphs not triangulated yet in parallel, if not null
     std::vector<std::vector<FontRasterizer::Tri>> rasterizeText(const std::string textString, const size_t fontHeight,
-                                                                const size_t bezierSteps);
+                                                                const size_t bezierSteps,
+                                                                const std::atomic<bool>* isCancelled = nullptr,
+                                                                ::ThreadPool* threadPool = nullptr);
+
+    /// Scale the triangulated text and center it around the origin of the xy plane, with the y axis pointing up
+    static void centerText(std::vector<std::vector<Tri>>& text, float scale);
+
+    /// Get vector perpendicular to the direction, that is pointing towards the right halfplane, rotated around the
+    /// direction by the angle in degrees
+    static glm::vec3 getPlaneBaseVector(const glm::vec3& direction, float rotationDegrees);
+
+    /// Move the centered text to the plane through the origin facing the direction, e.g., to project it along the
+    /// direction onto the model
+    static void placeText(std::vector<std::vector<Tri>>& text, const glm::vec3& origin, const glm::vec3& direction,
+                          float rotationDegrees);
 
    private:
-    double addOneCharacter(const char ch, const size_t bezierSteps, double offset, std::vector<Tri>& outTriangles);
+    double addOneCharacter(FT_UInt glyphIndex, const size_t fontHeight, const size_t bezierSteps, double offset,
+                           std::vector<Tri>& outTriangles);
+
+    /// Load the glyphs missing in the cache at the current size and triangulate them, in parallel on the thread pool
+    /// if not null. The face is only used to load the outlines, each glyph is triangulated from its own copy of the
+    /// outline, since FT_Face is not thread-safe. Returns false if cancelled.
+    bool cacheGlyphs(const std::vector<FT_UInt>& glyphIndices, size_t fontHeight, size_t bezierSteps,
+                     const std::atomic<bool>* isCancelled, ::ThreadPool* threadPool);
+
+    /// Triangulate the outline into the vertices of the glyph
+    static void triangulateOutline(const FT_Outline& outline, size_t bezierSteps, CachedGlyph& outGlyph);
 
     void outlinePostprocess(std::vector<std::vector<Tri>>& trianglesPerLetter) const;
 
-    static std::vector<p2t::Point*> triangulateContour(Vectoriser* vectoriser, int c, float offset);
+    static std::vector<p2t::Point*> triangulateContour(Vectoriser* vectoriser, int c);
 };
 
 }  // namespace pepr3d
\ No newline at end of file
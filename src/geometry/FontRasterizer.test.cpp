@@ -246,5 +246,82 @@ TEST(FontRasterizer, addOneCharacter_kerningCheck) {
     }
 }
 
+TEST(FontRasterizer, rasterizeText_cachedGlyphs) {
+    /**
+     * Test that the cached glyphs give the same triangles as the first rasterization, also after another size
+     */
+
+    FontRasterizer fr(getAssetPath("fonts/OpenSans-Regular.ttf"));
+    EXPECT_TRUE(fr.isValid());
+
+    const auto first = fr.rasterizeText("WAR WAR", 170, 1);
+    const auto otherSize = fr.rasterizeText("WAR WAR", 12, 1);
+    const auto second = fr.rasterizeText("WAR WAR", 170, 1);
+
+    ASSERT_EQ(first.size(), 7);
+    ASSERT_EQ(second.size(), first.size());
+    EXPECT_NE(otherSize.front().front().a, first.front().front().a);
+    for(size_t letter = 0; letter < first.size(); ++letter) {
+        ASSERT_EQ(second[letter].size(), first[letter].size());
+        for(size_t i = 0; i < first[letter].size(); ++i) {
+            EXPECT_EQ(second[letter][i].a, first[letter][i].a);
+            EXPECT_EQ(second[letter][i].b, first[letter][i].b);
+            EXPECT_EQ(second[letter][i].c, first[letter][i].c);
+        }
+    }
+
+    // The second "WAR" is the first one moved by whole pixels
+    const float shift = first.at(4).front().a.x - first.front().front().a.x;
+    EXPECT_EQ(shift, std::floor(shift));
+    for(size_t i = 0; i < first.front().size(); ++i) {
+        EXPECT_EQ(first.at(4)[i].a.x - first.front()[i].a.x, shift);
+        EXPECT_EQ(first.at(4)[i].a.y, first.front()[i].a.y);
+    }
+}
+
+TEST(FontRasterizer, rasterizeText_cancelled) {
+    /**
+     * Test that a cancelled rasterization is empty and does not affect the next one
+     */
+
+    FontRasterizer fr(getAssetPath("fonts/SourceSansPro-SemiBold.ttf"));
+    EXPECT_TRUE(fr.isValid());
+
+    std::atomic<bool> isCancelled(true);
+    EXPECT_TRUE(fr.rasterizeText("TT", 90, 3, &isCancelled).empty());
+
+    isCancelled = false;
+    const auto trisByLetters = fr.rasterizeText("TT", 90, 3, &isCancelled);
+    EXPECT_EQ(trisByLetters.size(), 2);
+    EXPECT_EQ(trisByLetters.front().size(), 6);
+}
+
+TEST(FontRasterizer, rasterizeText_threadPool) {
+    /**
+     * Test that the glyphs triangulated on the thread pool give the same triangles as the serial triangulation
+     */
+
+    FontRasterizer serial(getAssetPath("fonts/OpenSans-Regular.ttf"));
+    FontRasterizer parallel(getAssetPath("fonts/OpenSans-Regular.ttf"));
+    EXPECT_TRUE(serial.isValid());
+    EXPECT_TRUE(parallel.isValid());
+
+    ::ThreadPool threadPool(4);
+    const std::string text = "Pepr3D: WAVE tokens, 0123456789!";
+    const auto expected = serial.rasterizeText(text, 90, 3);
+    const auto result = parallel.rasterizeText(text, 90, 3, nullptr, &threadPool);
+
+    ASSERT_EQ(result.size(), text.size());
+    ASSERT_EQ(result.size(), expected.size());
+    for(size_t letter = 0; letter < expected.size(); ++letter) {
+        ASSERT_EQ(result[letter].size(), expected[letter].size());
+        for(size_t i = 0; i < expected[letter].size(); ++i) {
+            EXPECT_EQ(result[letter][i].a, expected[letter][i].a);
+            EXPECT_EQ(result[letter][i].b, expected[letter][i].b);
+            EXPECT_EQ(result[letter][i].c, expected[letter][i].c);
+        }
+    }
+}
+
 }  // namespace pepr3d
 #endif
@@ -0,0 +1,311 @@
+#ifdef _BENCH_
+
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/memory.hpp>
+#include <cinder/Filesystem.h>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Benchmark.h"
+#include "geometry/Geometry.h"
+#include "geometry/GeometryUtils.h"
+#include "geometry/MeshFileWriter.h"
+#include "geometry/ModelExporter.h"
+#include "geometry/ModelImporter.h"
+#include "geometry/ProjectFile.h"
+#include "tools/Brush.h"
+
+namespace pepr3d {
+namespace {
+
+struct IndexedMesh {
+    std::vector<glm::vec3> vertices;
+    std::vector<std::array<size_t, 3>> indices;
+};
+
+/// Unit sphere of 20 * 4^subdivisions triangles, facing outwards
+IndexedMesh createIcosphere(const int subdivisions) {
+    IndexedMesh mesh;
+    const float t = (1.f + std::sqrt(5.f)) / 2.f;
+    mesh.vertices = {{-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0}, {0, -1, t}, {0, 1, t},
+                     {0, -1, -t}, {0, 1, -t}, {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1}};
+    mesh.indices = {{0, 11, 5}, {0, 5, 1},  {0, 1, 7},   {0, 7, 10}, {0, 10, 11}, {1, 5, 9}, {5, 11, 4},
+                    {11, 10, 2}, {10, 7, 6}, {7, 1, 8},   {3, 9, 4},  {3, 4, 2},   {3, 2, 6}, {3, 6, 8},
+                    {3, 8, 9},  {4, 9, 5},  {2, 4, 11},  {6, 2, 10}, {8, 6, 7},   {9, 8, 1}};
+
+    for(int level = 0; level < subdivisions; ++level) {
+        std::map<std::pair<size_t, size_t>, size_t> midpoints;
+        const auto getMidpoint = [&mesh, &midpoints](const size_t a, const size_t b) {
+            const auto inserted = midpoints.emplace(std::minmax(a, b), mesh.vertices.size());
+            if(inserted.second) {
+                mesh.vertices.push_back(0.5f * (mesh.vertices[a] + mesh.vertices[b]));
+            }
+            return inserted.first->second;
+        };
+
+        std::vector<std::array<size_t, 3>> indices;
+        indices.reserve(4 * mesh.indices.size());
+        for(const auto& triangle : mesh.indices) {
+            const size_t ab = getMidpoint(triangle[0], triangle[1]);
+            const size_t bc = getMidpoint(triangle[1], triangle[2]);
+            const size_t ca = getMidpoint(triangle[2], triangle[0]);
+            indices.push_back({triangle[0], ab, ca});
+            indices.push_back({triangle[1], bc, ab});
+            indices.push_back({triangle[2], ca, bc});
+            indices.push_back({ab, bc, ca});
+        }
+        mesh.indices = std::move(indices);
+    }
+
+    for(glm::vec3& vertex : mesh.vertices) {
+        vertex = glm::normalize(vertex);
+    }
+    return mesh;
+}
+
+void writeStl(const IndexedMesh& mesh, const std::string& path) {
+    MeshFileWriter::write(path, MeshFileWriter::Format::Stl, mesh.indices.size(),
+                          [&mesh](const size_t triIdx, const size_t k, glm::vec3& position, glm::vec3& normal) {
+                              position = mesh.vertices[mesh.indices[triIdx][k]];
+                              normal = position;
+                          },
+                          nullptr);
+}
+
+void writeObj(const IndexedMesh& mesh, const std::string& path) {
+    std::ofstream os(path);
+    for(const glm::vec3& vertex : mesh.vertices) {
+        os << "v " << vertex.x << " " << vertex.y << " " << vertex.z << "\n";
+    }
+    for(const auto& triangle : mesh.indices) {
+        os << "f " << triangle[0] + 1 << " " << triangle[1] + 1 << " " << triangle[2] + 1 << "\n";
+    }
+    if(!os) {
+        throw std::runtime_error("Could not write the benchmark model " + path);
+    }
+}
+
+/// Rays towards the unit sphere from random directions, the same on every run
+std::vector<ci::Ray> createRays(const size_t count, const unsigned seed) {
+    std::mt19937 random(seed);
+    std::normal_distribution<float> normal;
+    std::uniform_real_distribution<float> jitter(-0.2f, 0.2f);
+    std::vector<ci::Ray> rays;
+    rays.reserve(count);
+    for(size_t i = 0; i < count; ++i) {
+        const glm::vec3 direction = glm::normalize(glm::vec3(normal(random), normal(random), normal(random)));
+        const glm::vec3 target = direction * 0.5f + glm::vec3(jitter(random), jitter(random), jitter(random));
+        const glm::vec3 origin = 3.f * direction;
+        rays.emplace_back(origin, glm::normalize(target - origin));
+    }
+    return rays;
+}
+
+/// The refinement runs on the workers of the pool while the main thread polls it like MainApplication does
+void waitForSdfRefinement(Geometry& geometry) {
+    while(geometry.isSdfRefining()) {
+        if(!geometry.updateSdfRefinement()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+/// Number of rays of a hover loop, about a few seconds of mouse movement
+const size_t HOVER_RAY_COUNT = 4096;
+
+/// Number of dabs of a painted stroke
+const size_t DAB_COUNT = 64;
+
+void benchmarkMesh(Benchmark& benchmark, const int subdivisions, const ci::fs::path& directory) {
+    const IndexedMesh mesh = createIcosphere(subdivisions);
+    const std::string triangleCount = std::to_string(mesh.indices.size());
+    const std::string suffix = "/" + triangleCount;
+    const std::string stlPath = (directory / ("sphere" + triangleCount + ".stl")).string();
+    const std::string objPath = (directory / ("sphere" + triangleCount + ".obj")).string();
+    writeStl(mesh, stlPath);
+    ::ThreadPool& threadPool = Geometry::getThreadPool();
+
+    // Assimp reads the text formats, binary STL files are read natively by loadNewGeometry()
+    if(benchmark.isSelected("ModelImporter" + suffix)) {
+        writeObj(mesh, objPath);
+        benchmark.measure("ModelImporter" + suffix, 3, [&]() {
+            GeometryProgress progress;
+            const ModelImporter importer(objPath, &progress, threadPool);
+            if(!importer.isModelLoaded()) {
+                throw std::runtime_error("Could not import the benchmark model " + objPath);
+            }
+        });
+        ci::fs::remove(objPath);
+    }
+
+    benchmark.measure("loadNewGeometry" + suffix, 3, [&]() {
+        Geometry geometry;
+        geometry.loadNewGeometry(stlPath);
+    });
+
+    std::shared_ptr<Geometry> geometry = std::make_shared<Geometry>();
+    geometry->loadNewGeometry(stlPath);
+    const auto cleanState = geometry->saveState();
+    const std::vector<ci::Ray> rays = createRays(HOVER_RAY_COUNT, 59);
+
+    benchmark.measure("intersectMesh" + suffix, 10, [&]() {
+        size_t hits = 0;
+        for(const ci::Ray& ray : rays) {
+            hits += geometry->intersectMesh(ray).has_value() ? 1 : 0;
+        }
+        if(hits == 0) {
+            throw std::runtime_error("The rays missed the benchmark model");
+        }
+    });
+
+    BrushSettings brush;
+    brush.color = 1;
+    brush.size = 0.1f;
+    const auto paintDabs = [&]() {
+        for(size_t i = 0; i < DAB_COUNT; ++i) {
+            geometry->paintAreaWithSphere(rays[i], brush);
+        }
+    };
+    benchmark.measure("paintAreaWithSphere" + suffix, 5, [&]() { geometry->loadState(cleanState); }, paintDabs);
+
+    TriangleDetail::setBooleanBackend(TriangleDetail::BooleanBackend::FixedPoint);
+    benchmark.measure("paintAreaWithSphereFixedPoint" + suffix, 5, [&]() { geometry->loadState(cleanState); },
+                      paintDabs);
+    TriangleDetail::setBooleanBackend(TriangleDetail::BooleanBackend::Exact);
+
+    benchmark.measure("paintWithShape" + suffix, 5, [&]() { geometry->loadState(cleanState); },
+                      [&]() {
+                          for(size_t i = 0; i < DAB_COUNT; ++i) {
+                              const glm::vec3 origin = rays[i].getOrigin();
+                              const glm::vec3 direction = rays[i].getDirection();
+                              const Geometry::Circle circle(Geometry::Point3(origin.x, origin.y, origin.z),
+                                                            brush.size * brush.size,
+                                                            Geometry::Vector3(direction.x, direction.y, direction.z));
+                              geometry->paintWithShape(rays[i], GeometryUtils::pointsOnCircle(circle, brush.segments),
+                                                       brush.color);
+                          }
+                      });
+
+    // The rest runs on the model painted by the dabs
+    geometry->loadState(cleanState);
+    paintDabs();
+    const auto paintedState = geometry->saveState();
+
+    benchmark.measure("intersectDetailedMesh" + suffix, 10, [&]() {
+        size_t hits = 0;
+        for(const ci::Ray& ray : rays) {
+            hits += geometry->intersectDetailedMesh(ray).has_value() ? 1 : 0;
+        }
+        if(hits == 0) {
+            throw std::runtime_error("The rays missed the benchmark model");
+        }
+    });
+
+    benchmark.measure("updateDetailedMesh" + suffix, 5, [&]() { geometry->loadState(paintedState); },
+                      [&]() {
+                          geometry->updateDetailedMesh();
+                          geometry->updateDetailedNormalsAndBorders();
+                      });
+
+    // Fills a hemisphere of the base triangles, and the whole mesh in parallel
+    const glm::vec3 startNormal = geometry->getTriangle(size_t(0)).getNormal();
+    benchmark.measure("bucket" + suffix, 10, [&]() {
+        const auto sameSide = [&](const size_t neighbour, size_t) {
+            return glm::dot(geometry->getTriangle(neighbour).getNormal(), startNormal) > 0.f;
+        };
+        geometry->bucket(size_t(0), sameSide);
+    });
+    benchmark.measure("parallelBucket" + suffix, 10, [&]() {
+        geometry->parallelBucket(std::vector<size_t>{0}, [](size_t, size_t) { return true; }, threadPool);
+    });
+
+    benchmark.measure("saveModel" + suffix, 3, [&]() { geometry->updateDetailedMesh(); },
+                      [&]() {
+                          ModelExporter exporter(geometry.get(), nullptr, threadPool);
+                          exporter.saveModel(directory.string(), "export", "stl", ExportType::Surface);
+                      });
+    benchmark.measure("saveModelFormats" + suffix, 3, [&]() { geometry->updateDetailedMesh(); },
+                      [&]() {
+                          ModelExporter exporter(geometry.get(), nullptr, threadPool);
+                          const std::vector<std::string> fileTypes = {"stl", "ply", "obj"};
+                          exporter.saveModel(directory.string(), "export", fileTypes, ExportType::Surface);
+                      });
+    benchmark.measure("saveModelNonPolyFormats" + suffix, 3, [&]() {
+        ModelExporter exporter(geometry.get(), nullptr, threadPool);
+        const std::vector<std::string> fileTypes = {"stl", "ply", "obj"};
+        exporter.saveModel(directory.string(), "export", fileTypes, ExportType::NonPolySurface);
+    });
+
+    // Projects written by MainApplication, their details are decoded only when they are painted
+    std::string projectFile;
+    benchmark.measure("saveProjectFile" + suffix, 5, [&]() {
+        std::ostringstream os(std::ios::binary);
+        ProjectFile::write(os, geometry->createProjectSnapshot(), threadPool);
+        projectFile = os.str();
+    });
+    benchmark.measure("loadProjectFile" + suffix, 5, [&]() {
+        std::istringstream is(projectFile, std::ios::binary);
+        Geometry loadedGeometry;
+        loadedGeometry.loadProjectSnapshot(ProjectFile::read(is, threadPool));
+    });
+    projectFile.clear();
+
+    // Projects saved before the container, a single cereal archive of the Geometry
+    std::string project;
+    const auto saveProject = [&]() {
+        std::ostringstream os;
+        {
+            cereal::BinaryOutputArchive saveArchive(os);
+            saveArchive(geometry);
+        }
+        project = os.str();
+    };
+    benchmark.measure("saveProject" + suffix, 5, saveProject);
+    if(project.empty()) {
+        saveProject();
+    }
+
+    std::shared_ptr<Geometry> loadedGeometry;
+    const auto loadProject = [&]() {
+        std::istringstream is(project);
+        cereal::BinaryInputArchive loadArchive(is);
+        loadArchive(loadedGeometry);
+    };
+    benchmark.measure("loadProject" + suffix, 5, loadProject);
+    benchmark.measure("recomputeFromData" + suffix, 3, loadProject, [&]() { loadedGeometry->recomputeFromData(); });
+    loadedGeometry = nullptr;
+
+    // Too slow for the large meshes to repeat
+    if(subdivisions <= 5) {
+        benchmark.measure("computeSdfValues" + suffix, 3, [&]() {
+            geometry->computeSdfValues();
+            waitForSdfRefinement(*geometry);
+        });
+    }
+}
+
+void benchmarkGeometry(Benchmark& benchmark) {
+    const ci::fs::path directory = ci::fs::temp_directory_path() / "pepr3d_bench";
+    ci::fs::create_directories(directory);
+    // 20480 and 327680 triangles, a small model and a large scan
+    benchmarkMesh(benchmark, 5, directory);
+    benchmarkMesh(benchmark, 7, directory);
+    ci::fs::remove_all(directory);
+}
+
+const Benchmark::Registration registration("Geometry", benchmarkGeometry);
+
+}  // namespace
+}  // namespace pepr3d
+
+#endif
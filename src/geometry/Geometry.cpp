@@ -1,58 +1,331 @@
 #include "geometry/Geometry.h"
 #include "GeometryUtils.h"
+#include "Profiler.h"
 #include "tools/Brush.h"
-#include "ui/MainApplication.h"
 
 #include <CGAL/Sphere_3.h>
 #include <CGAL/Spherical_kernel_3.h>
+#include <CGAL/boost/graph/Euler_operations.h>
+#include <CGAL/boost/graph/iterator.h>
+#include <glm/gtc/epsilon.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <functional>
+#include <numeric>
 #include <set>
+#include <tuple>
+#include <type_traits>
 #include <unordered_map>
+#include "geometry/BinaryMeshImporter.h"
+#include "geometry/RegionFill.h"
 #include "geometry/SdfValuesException.h"
+#include "geometry/SurfaceMeshBuilder.h"
+#include "geometry/VertexWelder.h"
 
 namespace pepr3d {
 
+namespace {
+/// Elements of a buffer filled by a single item of parallel_for
+const size_t BUFFER_CHUNK_ELEMENTS = 65536;
+
+/// Calls func(begin, end) on the thread pool for the consecutive chunks of [0, count)
+template <typename Func>
+void forEachBufferChunk(const size_t count, const Func& func) {
+    // Items for parallel_for
+    std::vector<size_t> chunkIds((count + BUFFER_CHUNK_ELEMENTS - 1) / BUFFER_CHUNK_ELEMENTS);
+    std::iota(chunkIds.begin(), chunkIds.end(), 0);
+    Geometry::getThreadPool().parallel_for(
+        chunkIds.begin(), chunkIds.end(),
+        [count, &func](const size_t chunk) {
+            func(BUFFER_CHUNK_ELEMENTS * chunk, std::min(count, BUFFER_CHUNK_ELEMENTS * (chunk + 1)));
+        },
+        1);
+}
+
+/// Lexicographic order of vertices
+bool isVertexLess(const glm::vec3& a, const glm::vec3& b) {
+    return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+}
+
+template <typename T>
+size_t getVectorMemorySize(const std::vector<T>& vector) {
+    return vector.capacity() * sizeof(T);
+}
+
+/// Rough estimate of the memory of a std::map, each tree node holds 3 pointers and a color besides its value
+template <typename Map>
+size_t getMapMemorySize(const Map& map) {
+    return map.size() * (sizeof(typename Map::value_type) + 4 * sizeof(void*));
+}
+
+/// Rough estimate of the memory of a std::unordered_map, a node per value and a pointer per bucket
+template <typename Map>
+size_t getUnorderedMapMemorySize(const Map& map) {
+    return map.size() * (sizeof(typename Map::value_type) + sizeof(void*)) + map.bucket_count() * sizeof(void*);
+}
+
+/// Rough estimate of the memory of the connectivity and the points of a Surface_mesh, without other properties
+size_t getMeshMemorySize(const PolyhedronData::Mesh& mesh) {
+    using Index = PolyhedronData::vertex_descriptor;
+    // Each vertex and face refers to a halfedge, each halfedge to its next and previous halfedge, vertex and face
+    return mesh.num_vertices() * (sizeof(PolyhedronData::Mesh::Point) + sizeof(Index)) +
+           mesh.num_halfedges() * 4 * sizeof(Index) + mesh.num_faces() * sizeof(Index);
+}
+
+/// Axis aligned 2D box, empty until a point is added
+struct Box2 {
+    glm::dvec2 min{std::numeric_limits<double>::max()};
+    glm::dvec2 max{std::numeric_limits<double>::lowest()};
+
+    void add(const glm::dvec2& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void enlarge(const double margin) {
+        min -= glm::dvec2(margin);
+        max += glm::dvec2(margin);
+    }
+
+    bool overlaps(const Box2& other) const {
+        return min.x <= other.max.x && other.min.x <= max.x && min.y <= other.max.y && other.min.y <= max.y;
+    }
+};
+
+/// Uniform grid of 2D boxes, each cell lists the boxes overlapping it
+class BoxGrid {
+   public:
+    explicit BoxGrid(std::vector<Box2> boxes) : mBoxes(std::move(boxes)) {
+        for(const Box2& box : mBoxes) {
+            mBounds.add(box.min);
+            mBounds.add(box.max);
+        }
+
+        // About one box per cell
+        mCellsPerAxis = std::max<size_t>(1, static_cast<size_t>(std::sqrt(static_cast<double>(mBoxes.size()))));
+        mCells.resize(mCellsPerAxis * mCellsPerAxis);
+        for(size_t boxIdx = 0; boxIdx < mBoxes.size(); ++boxIdx) {
+            forEachCell(mBoxes[boxIdx], [this, boxIdx](const size_t cell) { mCells[cell].push_back(boxIdx); });
+        }
+    }
+
+    const Box2& getBounds() const {
+        return mBounds;
+    }
+
+    /// Indices of the boxes overlapping the box, in increasing order
+    std::vector<size_t> findOverlapping(const Box2& box) const {
+        std::vector<size_t> result;
+        if(!box.overlaps(mBounds)) {
+            return result;
+        }
+        forEachCell(box, [this, &box, &result](const size_t cell) {
+            for(const size_t boxIdx : mCells[cell]) {
+                if(mBoxes[boxIdx].overlaps(box)) {
+                    result.push_back(boxIdx);
+                }
+            }
+        });
+
+        // A box spanning multiple cells is listed in each of them
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return result;
+    }
+
+   private:
+    std::vector<Box2> mBoxes;
+    Box2 mBounds;
+    size_t mCellsPerAxis;
+    std::vector<std::vector<size_t>> mCells;
+
+    /// Calls func(cell) for each cell overlapping the box, cells outside of the bounds are clamped to the grid
+    template <typename Func>
+    void forEachCell(const Box2& box, const Func& func) const {
+        const auto toCell = [this](const double coord, const double min, const double max) {
+            if(!(max > min)) {
+                return size_t(0);
+            }
+            const double cell = std::floor((coord - min) / (max - min) * static_cast<double>(mCellsPerAxis));
+            return static_cast<size_t>(std::clamp(cell, 0.0, static_cast<double>(mCellsPerAxis - 1)));
+        };
+        const size_t minX = toCell(box.min.x, mBounds.min.x, mBounds.max.x);
+        const size_t maxX = toCell(box.max.x, mBounds.min.x, mBounds.max.x);
+        const size_t minY = toCell(box.min.y, mBounds.min.y, mBounds.max.y);
+        const size_t maxY = toCell(box.max.y, mBounds.min.y, mBounds.max.y);
+        for(size_t y = minY; y <= maxY; ++y) {
+            for(size_t x = minX; x <= maxX; ++x) {
+                func(y * mCellsPerAxis + x);
+            }
+        }
+    }
+};
+}  // namespace
+
 /* -------------------- Commands -------------------- */
 
 Geometry::GeometryState Geometry::saveState() const {
     // Save only necessary data to keep snapshot size low
-    std::vector<size_t> triangleColors;
-    triangleColors.reserve(mTriangles.size());
-    for(const DataTriangle& tri : mTriangles) {
-        triangleColors.push_back(tri.getColor());
+    // Unchanged triangle details and color chunks are shared with the previous snapshots
+    return GeometryState{mTriangles.getPackedColorChunks(), {}, copyTriangleDetails(),
+                         ColorManager::ColorMap(mColorManager.getColorMap()), mColorManager.getColorOrder()};
+}
+
+size_t Geometry::getStateMemorySize(const GeometryState& state) const {
+    size_t memorySize = sizeof(GeometryState) + state.colorMap.size() * sizeof(glm::vec4) +
+                        state.colorOrder.size() * sizeof(size_t);
+    for(const auto& chunk : state.triangleColorChunks) {
+        memorySize += sizeof(chunk) + chunk->size() / static_cast<size_t>(chunk.use_count());
+    }
+    for(const auto& chunk : state.compressedColorChunks) {
+        memorySize += sizeof(chunk) + chunk->data.size() / static_cast<size_t>(chunk.use_count());
+    }
+    for(const auto& detail : state.triangleDetails) {
+        memorySize += detail.second->getApproximateMemorySize() / detail.second.getShareCount();
+    }
+    return memorySize;
+}
+
+std::future<Geometry::GeometryState> Geometry::compressState(const GeometryState& state) const {
+    P_ASSERT(state.compressedColorChunks.empty());
+    // The details are copied here, so that their share count is right while the worker holds the copy
+    GeometryState compressedState{{}, {}, state.triangleDetails, state.colorMap, state.colorOrder};
+    return getThreadPool().enqueue(
+        ::ThreadPool::priority::background,
+        [compressor = mColorChunkCompressor, chunks = state.triangleColorChunks,
+         compressedState = std::move(compressedState)]() mutable {
+            compressedState.compressedColorChunks = compressor->compress(chunks);
+            return std::move(compressedState);
+        });
+}
+
+Geometry::MemoryUsage Geometry::getMemoryUsage() const {
+    MemoryUsage usage;
+    usage.triangles = mTriangles.getApproximateMemorySize();
+
+    usage.triangleDetails = mTriangleDetailSlots.getApproximateMemorySize();
+    for(const auto& slot : mTriangleDetailSlots) {
+        if(slot.second.detail) {
+            const CopyOnWrite<TriangleDetail>& detail = *slot.second.detail;
+            usage.triangleDetails += detail->getApproximateMemorySize() / detail.getShareCount();
+        }
+    }
+
+    usage.openGlBuffers = getVectorMemorySize(mOgl.vertexBuffer) + getVectorMemorySize(mOgl.indexBuffer) +
+                          getVectorMemorySize(mOgl.colorBuffer) + getVectorMemorySize(mOgl.faceTriangles) +
+                          getVectorMemorySize(mOgl.highlightMask) + getMapMemorySize(mDetailBufferSlotOwners) +
+                          getVectorMemorySize(mSimplifiedMesh.vertices) + getVectorMemorySize(mSimplifiedMesh.indices) +
+                          getVectorMemorySize(mSimplifiedMesh.sourceTriangles);
+
+    usage.pickingTrees = mPickingTree.getApproximateMemorySize() + mTriangleBounds.getApproximateMemorySize() +
+                         mTriangleBoundsTree.getApproximateMemorySize() + getMapMemorySize(mDetailPicking);
+    if(mSdfProxy != nullptr) {
+        usage.pickingTrees += mSdfProxy->getBvh().getApproximateMemorySize();
     }
+    for(const auto& picking : mDetailPicking) {
+        usage.pickingTrees += picking.second.getApproximateMemorySize();
+    }
+
+    usage.polyhedron = getVectorMemorySize(mPolyhedronData.vertices) + getVectorMemorySize(mPolyhedronData.indices) +
+                       getVectorMemorySize(mPolyhedronData.sdfValues) +
+                       getVectorMemorySize(mPolyhedronData.faceAdjacency) +
+                       getVectorMemorySize(mPolyhedronData.faceNeighbours) +
+                       getVectorMemorySize(mPolyhedronData.faceNeighbourCosines);
 
-    return GeometryState{triangleColors, mTriangleDetails, ColorManager::ColorMap(mColorManager.getColorMap())};
+    if(mMeshDetailed != nullptr) {
+        usage.detailedMesh = getMeshMemorySize(*mMeshDetailed) +
+                             mMeshDetailed->num_faces() * sizeof(DetailedTriangleId) +
+                             getUnorderedMapMemorySize(mMeshDetailedFaceDescs);
+    }
+    return usage;
 }
 
 void Geometry::loadState(const GeometryState& state) {
     // mTriangles only possibly changes color
-    P_ASSERT(mTriangles.size() == state.triangleColors.size());
-    for(size_t triIdx = 0; triIdx < mTriangles.size(); triIdx++) {
-        mTriangles[triIdx].setColor(state.triangleColors[triIdx]);
+    if(!state.compressedColorChunks.empty()) {
+        mTriangles.setPackedColorChunks(mColorChunkCompressor->decompress(state.compressedColorChunks));
+    } else {
+        mTriangles.setPackedColorChunks(state.triangleColorChunks);
     }
-    mTriangleDetails = state.triangleDetails;
+    replaceTriangleDetails(state.triangleDetails);
+    mDetailsToCompact.clear();
+    mDetailPickingNeedsRebuild = true;
 
     mColorManager.replaceColors(state.colorMap.begin(), state.colorMap.end());
+    mColorManager.setColorOrder(state.colorOrder);
     P_ASSERT(!mColorManager.empty());
 
     // Set opengl state to dirty so it gets updated eventually
     // Note: Updating straight away would hide this change from ModelView
-    mOgl.isDirty = true;
+    invalidateOpenGlBuffers();
 
     // Tree is built from the original geometry, that is the same
-    P_ASSERT(mTree->size() == mTriangles.size());
+    P_ASSERT(mPickingTree.size() == mTriangles.size());
     invalidateTemporaryDetailedData();
 }
 
+void Geometry::beginDelta(GeometryDelta delta) {
+    P_ASSERT(!mRecordedDelta);
+    mRecordedDelta = std::move(delta);
+}
+
+Geometry::GeometryDelta Geometry::endDelta() {
+    P_ASSERT(mRecordedDelta);
+    GeometryDelta delta = std::move(*mRecordedDelta);
+    mRecordedDelta.reset();
+    return delta;
+}
+
+void Geometry::undoDelta(const GeometryDelta& delta) {
+    P_ASSERT(!mRecordedDelta);
+    for(const auto& triangle : delta.triangles) {
+        const size_t triangleIdx = triangle.first;
+        // Marked before the detail is replaced, like in removeTriangleDetail()
+        markDetailDirty(triangleIdx);
+        if(triangle.second.detail) {
+            setTriangleDetail(triangleIdx, *triangle.second.detail);
+        } else {
+            eraseTriangleDetail(triangleIdx);
+        }
+
+        mTriangles.setColor(triangleIdx, triangle.second.color);
+        if(isSimpleTriangle(triangleIdx) && !mOglNeedsRebuild) {
+            setColorBufferFace(triangleIdx, triangle.second.color);
+        }
+    }
+    // The recorded details were already compacted after their commands
+    mDetailsToCompact.clear();
+}
+
+size_t Geometry::getDeltaMemorySize(const GeometryDelta& delta) const {
+    size_t memorySize = sizeof(GeometryDelta) + getMapMemorySize(delta.triangles);
+    for(const auto& triangle : delta.triangles) {
+        const std::optional<CopyOnWrite<TriangleDetail>>& detail = triangle.second.detail;
+        if(detail) {
+            memorySize += (*detail)->getApproximateMemorySize() / detail->getShareCount();
+        }
+    }
+    return memorySize;
+}
+
 /* -------------------- Mesh loading -------------------- */
 
 void Geometry::recomputeFromData() {
-    ::ThreadPool& threadPool = MainApplication::getThreadPool();
+    DetailedTriangleId::checkBaseTriangleCount(mTriangles.size());
+    ::ThreadPool& threadPool = getThreadPool();
     // We already loaded the model
     P_ASSERT(mProgress->importRenderPercentage == 1.0f);
     P_ASSERT(mProgress->importComputePercentage == 1.0f);
 
+    /// The buffers and the bounding box come first, the model is displayed as soon as they exist, while the
+    /// polyhedron and the tree are still being built
+    mProgress->buffersPercentage = 0.0f;
+    computeBoundingBox();
+    generateOpenGlBuffers(nullptr);
+    mProgress->buffersPercentage = 1.0f;
+
     /// Async build the polyhedron data structure
     auto buildPolyhedronFuture = threadPool.enqueue([this]() {
         P_ASSERT(!mPolyhedronData.vertices.empty());
@@ -60,295 +333,600 @@ void Geometry::recomputeFromData() {
         buildPolyhedron();
     });
 
-    /// Async build the AABB tree
+    /// Async build the picking tree
     auto buildTreeFuture = threadPool.enqueue([this]() {
+        const Profiler::ScopedTimer timer(Profiler::Zone::TreeRebuild);
         mProgress->aabbTreePercentage = 0.0f;
 
-        buildTree();
-        P_ASSERT(mTree->size() == mTriangles.size());
-
-        /// Get the new bounding box
-        if(!mTree->empty()) {
-            mBoundingBox = std::make_unique<BoundingBox>(mTree->bbox());
+        // Picking tree loaded from a project file is already built over these triangles
+        if(!mIsPickingTreeLoaded || mPickingTree.size() != mTriangles.size()) {
+            mPickingTree.build(mTriangles.getVertices(), &getThreadPool());
         }
+        mIsPickingTreeLoaded = false;
+        P_ASSERT(mPickingTree.size() == mTriangles.size());
 
         mProgress->aabbTreePercentage = 1.0f;
     });
 
-    mProgress->buffersPercentage = 0.0f;
-
-    /// Generate new vertex buffer
-    generateVertexBuffer();
-    mProgress->buffersPercentage = 0.25f;
-
-    /// Generate new index buffer
-    generateIndexBuffer();
-    mProgress->buffersPercentage = 0.50f;
-
-    /// Generate new color buffer from triangle color data
-    generateColorBuffer();
-    mProgress->buffersPercentage = 0.75f;
-
-    /// Generate new normal buffer, copying the triangle normal to each vertex
-    generateNormalBuffer();
-    mProgress->buffersPercentage = 1.0f;
+    /// Async build the proxy drawn instead of large meshes while the camera moves
+    mSimplifiedMesh = {};
+    mSdfProxy.reset();
+    auto simplifyFuture = threadPool.enqueue([this, &threadPool]() {
+        // The source triangles are polyhedron faces, which match the base triangles
+        if(mTriangles.size() >= SIMPLIFIED_MESH_MIN_TRIANGLES && mPolyhedronData.indices.size() == mTriangles.size()) {
+            mSimplifiedMesh = MeshSimplifier::simplify(mPolyhedronData.vertices, mPolyhedronData.indices,
+                                                       SIMPLIFIED_MESH_TRIANGLES, threadPool);
+        }
+    });
 
     generateTriangleBounds();
 
-    /// Wait for building the polyhedron and tree
-    buildTreeFuture.get();
-    buildPolyhedronFuture.get();
+    /// Wait for building the polyhedron, tree and proxy, helping with other tasks meanwhile
+    threadPool.wait(simplifyFuture);
+    threadPool.wait(buildTreeFuture);
+    threadPool.wait(buildPolyhedronFuture);
 }
 
 void Geometry::buildTree() {
-    mTree = std::make_unique<Tree>();
+    const Profiler::ScopedTimer timer(Profiler::Zone::TreeRebuild);
+    // Subtrees of large meshes are built in parallel
+    mPickingTree.build(mTriangles.getVertices(), &getThreadPool());
+    computeBoundingBox();
+}
 
-    for(size_t triIdx = 0; triIdx < mTriangles.size(); triIdx++) {
-        mTree->insert(DataTriangleAABBPrimitive(this, DetailedTriangleId(triIdx)));
+void Geometry::computeBoundingBox() {
+    mBoundingBox.reset();
+    const std::vector<glm::vec3>& vertices = mTriangles.getVertices();
+    if(vertices.empty()) {
+        return;
     }
 
-    mTree->build();
+    // Bounds of each chunk of the vertices, reduced afterwards
+    const size_t chunkCount = (vertices.size() + BUFFER_CHUNK_ELEMENTS - 1) / BUFFER_CHUNK_ELEMENTS;
+    std::vector<std::pair<glm::vec3, glm::vec3>> chunkBounds(chunkCount);
+    forEachBufferChunk(vertices.size(), [&vertices, &chunkBounds](const size_t begin, const size_t end) {
+        glm::vec3 boxMin = vertices[begin];
+        glm::vec3 boxMax = vertices[begin];
+        for(size_t vertexIdx = begin + 1; vertexIdx < end; ++vertexIdx) {
+            boxMin = glm::min(boxMin, vertices[vertexIdx]);
+            boxMax = glm::max(boxMax, vertices[vertexIdx]);
+        }
+        chunkBounds[begin / BUFFER_CHUNK_ELEMENTS] = {boxMin, boxMax};
+    });
+
+    glm::vec3 boxMin = chunkBounds.front().first;
+    glm::vec3 boxMax = chunkBounds.front().second;
+    for(const auto& bounds : chunkBounds) {
+        boxMin = glm::min(boxMin, bounds.first);
+        boxMax = glm::max(boxMax, bounds.second);
+    }
+    mBoundingBox = std::make_unique<BoundingBox>(boxMin.x, boxMin.y, boxMin.z, boxMax.x, boxMax.y, boxMax.z);
 }
 
 void Geometry::loadNewGeometry(const std::string& fileName) {
     // Reset progress
     mProgress->resetLoad();
 
-    /// Import the object via Assimp
-    ModelImporter modelImporter(fileName, mProgress.get(), MainApplication::getThreadPool());  // only first mesh [0]
+    /// Binary STL and PLY files are read natively, straight into the buffers, other files via Assimp
+    std::optional<BinaryMeshImporter::Mesh> binaryMesh =
+        BinaryMeshImporter::import(fileName, mProgress.get(), getThreadPool());
+    if(binaryMesh) {
+        static_assert(BinaryMeshImporter::MAX_COLORS == PEPR3D_MAX_PALETTE_COLORS,
+                      "The native import keeps the palette limit of ModelImporter");
+        static_assert(std::is_same_v<ColorIndex, std::uint8_t>, "The native import stores colors as bytes");
+        mTriangles.assign(std::move(binaryMesh->triangleVertices), std::move(binaryMesh->triangleNormals),
+                          std::move(binaryMesh->triangleColors));
+        mPolyhedronData.vertices = std::move(binaryMesh->vertexBuffer);
+        mPolyhedronData.indices = std::move(binaryMesh->indexBuffer);
+
+        mColorManager = ColorManager();  // default colors if the file has none
+        if(!binaryMesh->paletteColors.empty()) {
+            mColorManager.replaceColors(binaryMesh->paletteColors);
+        }
+    } else {
+        /// Import the object via Assimp
+        ModelImporter modelImporter(fileName, mProgress.get(), getThreadPool());  // all meshes merged
+
+        if(!modelImporter.isModelLoaded()) {
+            CI_LOG_E("Model not loaded --> write out message for user");
+            throw std::runtime_error("Model loading failed.");
+        }
 
-    if(modelImporter.isModelLoaded()) {
         /// Fill triangle data to compute AABB
-        mTriangles = modelImporter.getTriangles();
+        mTriangles.assign(modelImporter.getTriangles());
 
         /// Fill Polyhedron data to compute SurfaceMesh
-        mPolyhedronData.vertices.clear();
-        mPolyhedronData.indices.clear();
         mPolyhedronData.vertices = modelImporter.getVertexBuffer();
         mPolyhedronData.indices = modelImporter.getIndexBuffer();
 
         /// Get the generated color palette of the model, replace the current one
         mColorManager = modelImporter.getColorManager();
-        P_ASSERT(!mColorManager.empty());
-
-        /// Do the computations in parallel
-        recomputeFromData();
-    } else {
-        throw std::runtime_error("Model loading failed.");
-        CI_LOG_E("Model not loaded --> write out message for user");
     }
-}
+    P_ASSERT(!mColorManager.empty());
 
-void Geometry::generateVertexBuffer() {
-    mOgl.vertexBuffer.clear();
-    mOgl.vertexBuffer.reserve(3 * mTriangles.size());
+    reorderTrianglesSpatially();
 
-    for(size_t idx = 0; idx < mTriangles.size(); ++idx) {
-        const auto& triangle = mTriangles[idx];
+    /// Nothing computed for the previous model applies to this one
+    mPolyhedronData.faceAdjacency.clear();
+    mLoadedSdfValues.clear();
+    mIsPickingTreeLoaded = false;
+    mDetailsToCompact.clear();
 
-        if(isSimpleTriangle(idx)) {
-            mOgl.vertexBuffer.push_back(triangle.getVertex(0));
-            mOgl.vertexBuffer.push_back(triangle.getVertex(1));
-            mOgl.vertexBuffer.push_back(triangle.getVertex(2));
-        } else {
-            // Pass dummy triangle to keep triangleIdx consistent with array position
-            mOgl.vertexBuffer.push_back(glm::vec3{0, 0, 0});
-            mOgl.vertexBuffer.push_back(glm::vec3{0, 0, 0});
-            mOgl.vertexBuffer.push_back(glm::vec3{0, 0, 0});
+    /// Do the computations in parallel
+    recomputeFromData();
+}
+
+void Geometry::reorderTrianglesSpatially() {
+    const std::vector<size_t> order =
+        MortonOrder::getTriangleOrder(mTriangles.getVertices(), getThreadPool());
+    const size_t triangleCount = order.size();
+
+    std::vector<glm::vec3> vertices(3 * triangleCount);
+    std::vector<glm::vec3> normals(triangleCount);
+    std::vector<ColorIndex> colors(triangleCount);
+    for(size_t triIdx = 0; triIdx < triangleCount; ++triIdx) {
+        const size_t sourceIdx = order[triIdx];
+        for(size_t i = 0; i < 3; ++i) {
+            vertices[3 * triIdx + i] = mTriangles.getVertices()[3 * sourceIdx + i];
         }
+        normals[triIdx] = mTriangles.getNormals()[sourceIdx];
+        colors[triIdx] = mTriangles.getColors()[sourceIdx];
     }
+    mTriangles.assign(std::move(vertices), std::move(normals), std::move(colors));
 
-    for(auto& it : mTriangleDetails) {
-        const auto& detailTriangles = it.second.getTriangles();
-
-        for(const auto& triangle : detailTriangles) {
-            mOgl.vertexBuffer.push_back(triangle.getVertex(0));
-            mOgl.vertexBuffer.push_back(triangle.getVertex(1));
-            mOgl.vertexBuffer.push_back(triangle.getVertex(2));
+    // The faces of the polyhedron are the triangles, if the import produced one for each
+    if(mPolyhedronData.indices.size() == triangleCount) {
+        std::vector<std::array<size_t, 3>> indices(triangleCount);
+        for(size_t triIdx = 0; triIdx < triangleCount; ++triIdx) {
+            indices[triIdx] = mPolyhedronData.indices[order[triIdx]];
         }
+        mPolyhedronData.indices = std::move(indices);
     }
 }
 
-void Geometry::generateIndexBuffer() {
-    mOgl.indexBuffer.clear();
-    mOgl.indexBuffer.reserve(mOgl.vertexBuffer.size());
+void Geometry::updateOpenGlBuffers(OpenGlData::MappedStorage* const storage) {
+    P_ASSERT(mOgl.isDirty);  // Called unnecessarily. Most likely by error.
+
+    const Profiler::ScopedTimer timer(Profiler::Zone::BufferGeneration);
 
-    for(uint32_t i = 0; i < mOgl.vertexBuffer.size(); ++i) {
-        mOgl.indexBuffer.push_back(i);
+    // Moving details around leaves holes in the buffers, compact them once they take too much space
+    const bool tooManyUnused = mOglUnusedTriangles > mOgl.faceCount / 4;
+    // The vectors or the storage do not hold the buffers written to the other one
+    const bool isStorageChanged = mOgl.isMapped != (storage != nullptr);
+
+    if(mOglNeedsRebuild || tooManyUnused || isStorageChanged) {
+        generateOpenGlBuffers(storage);
+    } else if(updateDirtyDetailBuffers(storage)) {
+        // Keep the color flag, in-place updates outside of the dirty ranges still need an upload
+        mOgl.isDirty = false;
+    } else {
+        generateOpenGlBuffers(storage);
     }
+
+    CI_LOG_I("Generating buffers took " + std::to_string(timer.getMilliseconds()) + " ms");
+}
+
+void Geometry::generateOpenGlBuffers(OpenGlData::MappedStorage* const storage) {
+    layoutOpenGlBuffers();
+    bindOpenGlStorage(storage);
+    fillOpenGlBuffers();
+    generateHighlightBuffer();
+
+    mOglNeedsRebuild = false;
+    mOglDirtyDetails.clear();
+    mOgl.info.didLayoutChange = true;
+    mOgl.info.unsetColorFlag();
+    mOgl.info.dirtyFaceRanges.clear();
+    mOgl.info.dirtyVertexRanges.clear();
+    mOgl.isDirty = false;
 }
 
-void Geometry::generateColorBuffer() {
-    mOgl.colorBuffer.clear();
-    mOgl.colorBuffer.reserve(mOgl.vertexBuffer.size());
-    mTriangleDetailColorBufferStart.clear();
+bool Geometry::bindOpenGlStorage(OpenGlData::MappedStorage* const storage) {
+    mOgl.colorBuffer.resize(mOgl.faceCount, 0);
+    mOgl.isMapped = storage != nullptr;
+    if(storage == nullptr) {
+        mOgl.vertexBuffer.resize(mOgl.vertexCount, glm::vec3(0));
+        mOgl.indexBuffer.resize(3 * mOgl.faceCount, 0);
+        mOgl.faceTriangles.resize(mOgl.faceCount, 0);
+        mOglVertices = mOgl.vertexBuffer.data();
+        mOglIndices = mOgl.indexBuffer.data();
+        mOglFaceTriangles = mOgl.faceTriangles.data();
+        return true;
+    }
+
+    // The model would be kept twice otherwise
+    mOgl.vertexBuffer = {};
+    mOgl.indexBuffer = {};
+    mOgl.faceTriangles = {};
+    const bool isKept = storage->map(mOgl.vertexCount, mOgl.faceCount);
+    mOglVertices = storage->getVertices();
+    mOglIndices = storage->getIndices();
+    mOglFaceTriangles = storage->getFaceTriangles();
+    P_ASSERT(mOglVertices != nullptr && mOglIndices != nullptr && mOglFaceTriangles != nullptr);
+    return isKept;
+}
 
-    for(size_t idx = 0; idx < mTriangles.size(); ++idx) {
-        const auto& triangle = mTriangles[idx];
-        const ColorIndex triColorIndex = static_cast<ColorIndex>(triangle.getColor());
-        mOgl.colorBuffer.push_back(triColorIndex);
-        mOgl.colorBuffer.push_back(triColorIndex);
-        mOgl.colorBuffer.push_back(triColorIndex);
+bool Geometry::updateDirtyDetailBuffers(OpenGlData::MappedStorage* const storage) {
+    P_ASSERT(mOgl.colorBuffer.size() == mOgl.faceCount);
+    auto& dirtyFaceRanges = mOgl.info.dirtyFaceRanges;
+    auto& dirtyVertexRanges = mOgl.info.dirtyVertexRanges;
+
+    // The details that do not fit their slot move to new slots at the end, the buffers grow by all of them before
+    // anything is written, so the storage is mapped once
+    const size_t faceCount = mOgl.faceCount;
+    const size_t vertexCount = mOgl.vertexCount;
+    for(const size_t triangleIdx : mOglDirtyDetails) {
+        const CopyOnWrite<TriangleDetail>* const detail = findTriangleDetail(triangleIdx);
+        if(detail == nullptr) {
+            continue;
+        }
+        const size_t detailTriangleCount = (*detail)->getTriangles().size();
+        const DetailBufferSlot* const oldSlot = findDetailBufferSlot(triangleIdx);
+        if(oldSlot == nullptr || oldSlot->capacity < detailTriangleCount) {
+            const size_t capacity = getDetailBufferCapacity(detailTriangleCount);
+            mOgl.faceCount += capacity;
+            mOgl.vertexCount += 3 * capacity;
+        }
+    }
+    if(!bindOpenGlStorage(storage)) {
+        mOgl.faceCount = faceCount;
+        mOgl.vertexCount = vertexCount;
+        return false;
     }
 
-    for(auto& it : mTriangleDetails) {
-        const auto& detailTriangles = it.second.getTriangles();
+    size_t nextFace = faceCount;
+    size_t nextVertex = vertexCount;
+    for(const size_t triangleIdx : mOglDirtyDetails) {
+        P_ASSERT(triangleIdx < mTriangles.size());
+        const CopyOnWrite<TriangleDetail>* const detail = findTriangleDetail(triangleIdx);
+
+        // Base triangle is displayed only when it has no detail, its shared vertices never change
+        if(detail == nullptr) {
+            writeBaseFace(triangleIdx);
+        } else {
+            clearFaceRange(triangleIdx, triangleIdx + 1);
+        }
+        dirtyFaceRanges.add(triangleIdx, triangleIdx + 1);
+
+        // Release the slot if the detail was removed or does not fit anymore
+        const size_t detailTriangleCount = detail == nullptr ? 0 : (*detail)->getTriangles().size();
+        const DetailBufferSlot* oldSlot = findDetailBufferSlot(triangleIdx);
+        if(oldSlot != nullptr && (detail == nullptr || oldSlot->capacity < detailTriangleCount)) {
+            clearFaceRange(oldSlot->faceStart, oldSlot->faceStart + oldSlot->capacity);
+            dirtyFaceRanges.add(oldSlot->faceStart, oldSlot->faceStart + oldSlot->capacity);
+            mOglUnusedTriangles += oldSlot->capacity;
+            mDetailBufferSlotOwners.erase(oldSlot->faceStart);
+            if(detail == nullptr) {
+                mTriangleDetailSlots.erase(triangleIdx);
+                continue;
+            }
+            mTriangleDetailSlots.find(triangleIdx)->bufferSlot.reset();
+        }
+
+        if(detail == nullptr) {
+            continue;
+        }
+
+        // Take a new slot at the end of the buffers
+        TriangleDetailSlot& detailSlot = *mTriangleDetailSlots.find(triangleIdx);
+        if(!detailSlot.bufferSlot) {
+            const DetailBufferSlot slot{nextFace, nextVertex, getDetailBufferCapacity(detailTriangleCount)};
+            nextFace += slot.capacity;
+            nextVertex += 3 * slot.capacity;
+            P_ASSERT(nextFace <= mOgl.faceCount && nextVertex <= mOgl.vertexCount);
+            // Vertices of unused faces do not matter, the face triangles of the whole slot are its triangle
+            std::fill(mOglFaceTriangles + slot.faceStart, mOglFaceTriangles + slot.faceStart + slot.capacity,
+                      static_cast<GLuint>(triangleIdx));
+            detailSlot.bufferSlot = slot;
+            mDetailBufferSlotOwners.emplace(slot.faceStart, triangleIdx);
+        }
 
-        mTriangleDetailColorBufferStart[it.first] = mOgl.colorBuffer.size();
-        for(const auto& triangle : detailTriangles) {
-            const ColorIndex triColorIndex = static_cast<ColorIndex>(triangle.getColor());
-            mOgl.colorBuffer.push_back(triColorIndex);
-            mOgl.colorBuffer.push_back(triColorIndex);
-            mOgl.colorBuffer.push_back(triColorIndex);
+        const DetailBufferSlot& slot = *detailSlot.bufferSlot;
+        const auto& detailTriangles = (*detail)->getTriangles();
+        for(size_t detailIdx = 0; detailIdx < detailTriangles.size(); ++detailIdx) {
+            writeDetailFace(slot, detailIdx, **detail, triangleIdx);
         }
+        clearFaceRange(slot.faceStart + detailTriangles.size(), slot.faceStart + slot.capacity);
+        dirtyFaceRanges.add(slot.faceStart, slot.faceStart + slot.capacity);
+        dirtyVertexRanges.add(slot.vertexStart, slot.vertexStart + 3 * detailTriangles.size());
     }
+    P_ASSERT(nextFace == mOgl.faceCount && nextVertex == mOgl.vertexCount);
+    mOglDirtyDetails.clear();
+
+    dirtyFaceRanges.merge();
+    dirtyVertexRanges.merge();
+    return true;
+}
 
-    P_ASSERT(mOgl.colorBuffer.size() == mOgl.vertexBuffer.size());
+void Geometry::writeBaseFace(const size_t triangleIdx) {
+    P_ASSERT(triangleIdx < mTriangles.size());
+    const std::array<uint32_t, 3> indices = getBaseFaceIndices(triangleIdx);
+    std::copy(indices.begin(), indices.end(), mOglIndices + 3 * triangleIdx);
+    mOgl.colorBuffer[triangleIdx] = static_cast<ColorIndex>(mTriangles.getColor(triangleIdx));
+    mOglFaceTriangles[triangleIdx] = static_cast<GLuint>(triangleIdx);
 }
 
-void Geometry::generateNormalBuffer() {
-    mOgl.normalBuffer.clear();
-    mOgl.normalBuffer.reserve(mOgl.vertexBuffer.size());
-    for(size_t idx = 0; idx < mTriangles.size(); ++idx) {
-        const auto& triangle = mTriangles[idx];
-        mOgl.normalBuffer.push_back(triangle.getNormal());
-        mOgl.normalBuffer.push_back(triangle.getNormal());
-        mOgl.normalBuffer.push_back(triangle.getNormal());
+void Geometry::writeDetailFace(const DetailBufferSlot& slot, const size_t detailIdx, const TriangleDetail& detail,
+                               const size_t triangleIdx) {
+    P_ASSERT(detailIdx < slot.capacity);
+    const size_t face = slot.faceStart + detailIdx;
+    const size_t vertexPosition = slot.vertexStart + 3 * detailIdx;
+    P_ASSERT(vertexPosition + 2 < mOgl.vertexCount);
+    const std::vector<glm::vec3>& vertices = detail.getVertices();
+    for(size_t i = 0; i < 3; ++i) {
+        mOglVertices[vertexPosition + i] = vertices[3 * detailIdx + i];
+        mOglIndices[3 * face + i] = static_cast<uint32_t>(vertexPosition + i);
     }
+    mOgl.colorBuffer[face] = detail.getTriangles().getColors()[detailIdx];
+    mOglFaceTriangles[face] = static_cast<GLuint>(triangleIdx);
+}
 
-    for(auto& it : mTriangleDetails) {
-        const auto& detailTriangles = it.second.getTriangles();
-        glm::vec3 normal = it.second.getOriginal().getNormal();
+void Geometry::clearFaceRange(const size_t faceBegin, const size_t faceEnd) {
+    P_ASSERT(faceEnd <= mOgl.faceCount);
+    // All indices pointing to the same vertex make a degenerate triangle, that is not rasterized
+    std::fill(mOglIndices + 3 * faceBegin, mOglIndices + 3 * faceEnd, 0);
+    std::fill(mOgl.colorBuffer.begin() + faceBegin, mOgl.colorBuffer.begin() + faceEnd, 0);
+}
+
+std::pair<glm::vec3, glm::vec3> Geometry::getOpenGlFaceBounds(const size_t faceBegin, const size_t faceEnd) const {
+    P_ASSERT(faceBegin <= faceEnd && faceEnd <= mOgl.faceCount);
+    glm::vec3 boxMin(std::numeric_limits<float>::max());
+    glm::vec3 boxMax(std::numeric_limits<float>::lowest());
+    const auto addVertex = [&boxMin, &boxMax](const glm::vec3& vertex) {
+        boxMin = glm::min(boxMin, vertex);
+        boxMax = glm::max(boxMax, vertex);
+    };
+
+    // Faces of the base triangles, the faces of the triangles with a detail are degenerate
+    const std::vector<glm::vec3>& baseVertices =
+        mOglSharedVertices ? mPolyhedronData.vertices : mTriangles.getVertices();
+    for(size_t face = faceBegin; face < std::min(faceEnd, mTriangles.size()); ++face) {
+        if(isSimpleTriangle(face)) {
+            for(const uint32_t index : getBaseFaceIndices(face)) {
+                addVertex(baseVertices[index]);
+            }
+        }
+    }
 
-        for(const auto& triangle : detailTriangles) {
-            mOgl.normalBuffer.push_back(normal);
-            mOgl.normalBuffer.push_back(normal);
-            mOgl.normalBuffer.push_back(normal);
+    // Used faces of the slots overlapping the range, the slot starting before the range first
+    auto owner = mDetailBufferSlotOwners.upper_bound(faceBegin);
+    if(owner != mDetailBufferSlotOwners.begin()) {
+        --owner;
+    }
+    for(; owner != mDetailBufferSlotOwners.end() && owner->first < faceEnd; ++owner) {
+        const CopyOnWrite<TriangleDetail>* const detail = findTriangleDetail(owner->second);
+        const DetailBufferSlot* const slot = findDetailBufferSlot(owner->second);
+        if(detail == nullptr || slot == nullptr) {
+            continue;
+        }
+        const size_t usedEnd = slot->faceStart + std::min(slot->capacity, (*detail)->getTriangles().size());
+        const std::vector<glm::vec3>& vertices = (*detail)->getVertices();
+        for(size_t face = std::max(faceBegin, slot->faceStart); face < std::min(faceEnd, usedEnd); ++face) {
+            for(size_t i = 0; i < 3; ++i) {
+                addVertex(vertices[3 * (face - slot->faceStart) + i]);
+            }
         }
     }
-    P_ASSERT(mOgl.normalBuffer.size() == mOgl.vertexBuffer.size());
+    return {boxMin, boxMax};
 }
 
-void Geometry::generateHighlightBuffer() {
-    std::set<size_t>& paintSet = mAreaHighlight.triangles;
-    const BrushSettings& settings = mAreaHighlight.settings;
+std::array<uint32_t, 3> Geometry::getBaseFaceIndices(const size_t triangleIdx) const {
+    if(!mOglSharedVertices) {
+        const auto firstVertex = static_cast<uint32_t>(3 * triangleIdx);
+        return {firstVertex, firstVertex + 1, firstVertex + 2};
+    }
+    P_ASSERT(triangleIdx < mPolyhedronData.indices.size());
+    const auto& indices = mPolyhedronData.indices[triangleIdx];
+    return {static_cast<uint32_t>(indices[0]), static_cast<uint32_t>(indices[1]), static_cast<uint32_t>(indices[2])};
+}
 
-    mOgl.highlightMask.clear();
-    // Mark all triangles with attribute assigned to vertex
-    mOgl.highlightMask.reserve(mTriangles.size() * 3);
-    for(size_t triangleIdx = 0; triangleIdx < mTriangles.size(); triangleIdx++) {
-        // Fill 3 vertices of a triangle
-        if(settings.continuous && paintSet.find(triangleIdx) == paintSet.end()) {
-            mOgl.highlightMask.emplace_back(0);
-            mOgl.highlightMask.emplace_back(0);
-            mOgl.highlightMask.emplace_back(0);
+bool Geometry::getHighlightMaskValue(const size_t triangleIdx) const {
+    // Without a continuous surface the shader does not read the mask
+    const auto& paintSet = mAreaHighlight.triangles;
+    return paintSet.find(triangleIdx) != paintSet.end();
+}
 
-        } else {
-            mOgl.highlightMask.emplace_back(1);
-            mOgl.highlightMask.emplace_back(1);
-            mOgl.highlightMask.emplace_back(1);
-        }
+void Geometry::layoutOpenGlBuffers() {
+    // Simple triangles share the vertices of the original mesh, if we have one that matches the triangle soup
+    mOglSharedVertices =
+        !mPolyhedronData.vertices.empty() && mPolyhedronData.indices.size() == mTriangles.size();
+    const size_t baseVertexCount =
+        mOglSharedVertices ? mPolyhedronData.vertices.size() : mTriangles.getVertices().size();
+
+    // Lay out a slot with some spare space for each detail after the base triangles, the prefix sums of the slot
+    // capacities are the offsets of the details in the buffers
+    mTriangleDetailSlots.eraseIf([](size_t, const TriangleDetailSlot& slot) { return !slot.detail; });
+    mDetailBufferSlotOwners.clear();
+    mOglUnusedTriangles = 0;
+    size_t faceCount = mTriangles.size();
+    size_t vertexCount = baseVertexCount;
+    for(auto& it : mTriangleDetailSlots) {
+        const DetailBufferSlot slot{faceCount, vertexCount,
+                                    getDetailBufferCapacity((*it.second.detail)->getTriangles().size())};
+        it.second.bufferSlot = slot;
+        mDetailBufferSlotOwners.emplace(slot.faceStart, it.first);
+        faceCount += slot.capacity;
+        vertexCount += 3 * slot.capacity;
     }
 
-    // If the original triangle has highlight enabled also enable for detail
-    for(auto& it : mTriangleDetails) {
-        const size_t triangleIdx = it.first;
-        const auto& detailTriangles = it.second.getTriangles();
+    // Every element is written by fillOpenGlBuffers(), once the buffers are bound by bindOpenGlStorage()
+    mOgl.vertexCount = vertexCount;
+    mOgl.faceCount = faceCount;
+}
 
-        const bool enableHighlight = !settings.continuous || paintSet.find(triangleIdx) != paintSet.end();
+void Geometry::fillOpenGlBuffers() {
+    P_ASSERT(mOgl.colorBuffer.size() == mOgl.faceCount);
+    const std::vector<glm::vec3>& baseVertices =
+        mOglSharedVertices ? mPolyhedronData.vertices : mTriangles.getVertices();
+    forEachBufferChunk(baseVertices.size(), [this, &baseVertices](const size_t begin, const size_t end) {
+        std::copy(baseVertices.begin() + begin, baseVertices.begin() + end, mOglVertices + begin);
+    });
 
-        for(const auto& triangle : detailTriangles) {
-            if(enableHighlight) {
-                mOgl.highlightMask.emplace_back(1);
-                mOgl.highlightMask.emplace_back(1);
-                mOgl.highlightMask.emplace_back(1);
+    forEachBufferChunk(mTriangles.size(), [this](const size_t begin, const size_t end) {
+        for(size_t idx = begin; idx < end; ++idx) {
+            if(isSimpleTriangle(idx)) {
+                writeBaseFace(idx);
             } else {
-                mOgl.highlightMask.emplace_back(0);
-                mOgl.highlightMask.emplace_back(0);
-                mOgl.highlightMask.emplace_back(0);
+                // Triangles with a detail keep a degenerate face to keep triangleIdx consistent with array position
+                std::fill(mOglIndices + 3 * idx, mOglIndices + 3 * (idx + 1), 0);
+                mOgl.colorBuffer[idx] = static_cast<ColorIndex>(mTriangles.getColor(idx));
+                mOglFaceTriangles[idx] = static_cast<GLuint>(idx);
             }
         }
+    });
+
+    // Slots do not overlap, each detail fills its own one from its plain vertices
+    std::vector<std::pair<size_t, const TriangleDetail*>> details;
+    details.reserve(mTriangleDetailSlots.size());
+    for(const auto& it : mTriangleDetailSlots) {
+        if(it.second.detail) {
+            details.emplace_back(it.first, &**it.second.detail);
+        }
     }
+    getThreadPool().parallel_for_weighted(
+        details.begin(), details.end(),
+        [this](const std::pair<size_t, const TriangleDetail*>& detail) {
+            const DetailBufferSlot& slot = *findDetailBufferSlot(detail.first);
+            const size_t detailTriangleCount = detail.second->getTriangles().size();
+            for(size_t detailIdx = 0; detailIdx < detailTriangleCount; ++detailIdx) {
+                writeDetailFace(slot, detailIdx, *detail.second, detail.first);
+            }
+            // Unused faces are degenerate, their vertices and triangle do not matter
+            const size_t unusedFace = slot.faceStart + detailTriangleCount;
+            const size_t slotEnd = slot.faceStart + slot.capacity;
+            clearFaceRange(unusedFace, slotEnd);
+            std::fill(mOglFaceTriangles + unusedFace, mOglFaceTriangles + slotEnd, static_cast<GLuint>(detail.first));
+            std::fill(mOglVertices + slot.vertexStart + 3 * detailTriangleCount,
+                      mOglVertices + slot.vertexStart + 3 * slot.capacity, glm::vec3(0));
+        },
+        [this](const std::pair<size_t, const TriangleDetail*>& detail) {
+            return findDetailBufferSlot(detail.first)->capacity;
+        });
+
+    P_ASSERT(mOgl.colorBuffer.size() == mOgl.faceCount);
+}
+
+void Geometry::generateHighlightBuffer() {
+    // Detail triangles share the bit of their base triangle, so the size does not depend on the details
+    mOgl.highlightMask.clear();
+    mOgl.highlightMask.resize(getHighlightMaskSize(mTriangles.size()), 0);
 
-    P_ASSERT(mOgl.highlightMask.size() == mOgl.vertexBuffer.size());
+    for(const size_t triangleIdx : mAreaHighlight.triangles) {
+        P_ASSERT(triangleIdx < mTriangles.size());
+        mOgl.highlightMask[triangleIdx / 32] |= GLuint(1) << (triangleIdx % 32);
+    }
 
+    mAreaHighlight.dirty = false;
     mOgl.info.didHighlightUpdate = true;
+    mOgl.info.highlightRanges.clear();
+    mOgl.info.highlightRanges.add(0, mOgl.highlightMask.size());
 }
 
-void Geometry::generateTriangleBounds() {
-    mTriangleBounds.clear();
-    for(const DataTriangle& dataTri : mTriangles) {
-        const auto& tri = dataTri.getTri();
-        mTriangleBounds.push_back(GeometryUtils::getBoundingSphere(tri));
+void Geometry::setHighlightMask(const size_t triangleIdx, const bool highlight) {
+    const size_t element = triangleIdx / 32;
+    P_ASSERT(element < mOgl.highlightMask.size());
+    const GLuint bit = GLuint(1) << (triangleIdx % 32);
+    if(highlight) {
+        mOgl.highlightMask[element] |= bit;
+    } else {
+        mOgl.highlightMask[element] &= ~bit;
     }
+    mOgl.info.highlightRanges.add(element, element + 1);
+    mOgl.info.didHighlightUpdate = true;
+}
+
+void Geometry::setColorBufferFace(const size_t face, const size_t color) {
+    // Color buffer has 1 ColorIndex for each face
+    P_ASSERT(face < mOgl.faceCount);
+    mOgl.colorBuffer[face] = static_cast<ColorIndex>(color);
+    mOgl.info.colorRanges.add(face, face + 1);
+    mOgl.info.didColorUpdate = true;
+}
+
+void Geometry::generateTriangleBounds() {
+    mTriangleBounds.resize(mTriangles.size());
+    std::vector<glm::dvec3> centers(mTriangles.size());
+    std::vector<double> radii(mTriangles.size());
+    forEachBufferChunk(mTriangles.size(), [this, &centers, &radii](const size_t begin, const size_t end) {
+        for(size_t triangleIdx = begin; triangleIdx < end; ++triangleIdx) {
+            const auto bound = GeometryUtils::getBoundingSphere(mTriangles.getCgalTriangle(triangleIdx));
+            mTriangleBounds.set(triangleIdx, glm::dvec3(bound.first.x(), bound.first.y(), bound.first.z()),
+                                bound.second);
+            // The tree is built over the rounded spheres, so it never skips a sphere the exact test accepts
+            centers[triangleIdx] = glm::dvec3(mTriangleBounds.getCenter(triangleIdx));
+            radii[triangleIdx] = mTriangleBounds.getRadius(triangleIdx);
+        }
+    });
+    mTriangleBoundsTree.build(centers, radii);
 }
 
 /* -------------------- Tool support -------------------- */
 
 std::optional<size_t> Geometry::intersectMesh(const ci::Ray& ray) const {
-    if(mTree->empty()) {
+    const std::optional<TriangleBvh::Hit> hit = mPickingTree.intersect(ray.getOrigin(), ray.getDirection());
+    if(!hit) {
+        /// No intersection detected.
         return {};
     }
 
-    const glm::vec3 source = ray.getOrigin();
-    const glm::vec3 direction = ray.getDirection();
-
-    const pepr3d::Geometry::Ray rayQuery(pepr3d::DataTriangle::Point(source.x, source.y, source.z),
-                                         pepr3d::Geometry::Direction(direction.x, direction.y, direction.z));
-
-    // Find the two intersection parameters - place and triangle
-    Ray_intersection intersection = mTree->first_intersection(rayQuery);
-    if(intersection) {
-        // The intersected triangle
-        const DetailedTriangleId triangleId = boost::get<DataTriangleAABBPrimitive::Id>(intersection->second).second;
-
-        P_ASSERT(triangleId.getBaseId() < mTriangles.size());
-        P_ASSERT(!triangleId.getDetailId());  // We are intersecting base mesh, there should be no detail
-
-        return triangleId.getBaseId();
-    }
-
-    /// No intersection detected.
-    return {};
+    P_ASSERT(hit->triangleIdx < mTriangles.size());
+    return hit->triangleIdx;
 }
 
 std::optional<size_t> Geometry::intersectMesh(const ci::Ray& ray, glm::vec3& outPos) const {
-    auto intersection = intersectMesh(ray);
-
-    if(intersection) {
-        // Calculate intersection point of the ray with the triangle
-        const DataTriangle& tri = getTriangle(*intersection);
+    const std::optional<TriangleBvh::Hit> hit = mPickingTree.intersect(ray.getOrigin(), ray.getDirection());
+    if(!hit) {
+        return {};
+    }
 
-        auto intersectionPoint = GeometryUtils::triangleRayIntersection(tri, ray);
+    P_ASSERT(hit->triangleIdx < mTriangles.size());
+    outPos = ray.calcPosition(hit->distance);
+    return hit->triangleIdx;
+}
 
-        if(intersectionPoint)
-            outPos = *intersectionPoint;
+std::optional<DetailedTriangleId> Geometry::getTriangleIdOfFace(const size_t face) const {
+    P_ASSERT(!mOgl.isDirty);
+    if(face < mTriangles.size()) {
+        // Base faces of triangles with a detail are degenerate
+        if(!isSimpleTriangle(face)) {
+            return {};
+        }
+        return DetailedTriangleId(face);
     }
 
-    return intersection;
+    // Detail faces belong to the slot starting closest before them
+    auto ownerIt = mDetailBufferSlotOwners.upper_bound(face);
+    if(ownerIt == mDetailBufferSlotOwners.begin()) {
+        return {};
+    }
+    --ownerIt;
+    const size_t baseId = ownerIt->second;
+    const size_t detailId = face - ownerIt->first;
+    // Faces of released slots or unused faces at the end of a slot
+    if(isSimpleTriangle(baseId) || detailId >= getTriangleDetailCount(baseId)) {
+        return {};
+    }
+    return DetailedTriangleId(baseId, detailId);
 }
 
 std::optional<DetailedTriangleId> Geometry::intersectDetailedMesh(const ci::Ray& ray) {
-    if(mTree->empty()) {
+    if(mPickingTree.empty()) {
         return {};
     }
 
-    if(!isTemporaryDetailedDataValid()) {
-        updateTemporaryDetailedData();
-        P_ASSERT(mTreeDetailed);
-    }
-
-    const glm::vec3 source = ray.getOrigin();
-    const glm::vec3 direction = ray.getDirection();
-
-    const pepr3d::Geometry::Ray rayQuery(pepr3d::DataTriangle::Point(source.x, source.y, source.z),
-                                         pepr3d::Geometry::Direction(direction.x, direction.y, direction.z));
+    // Picked detail triangles have to stay the same when the detailed mesh gets built later
+    correctSharedVertices();
+    updateDetailPicking();
 
-    // Find the two intersection parameters - place and triangle
-    Ray_intersection intersection = mTreeDetailed->first_intersection(rayQuery);
-    if(intersection) {
+    // Find the base triangle first, detail triangles cover the same area
+    const std::optional<TriangleBvh::Hit> hit = mPickingTree.intersect(ray.getOrigin(), ray.getDirection());
+    if(hit) {
         // The intersected triangle
-        const DetailedTriangleId triangleId = boost::get<DataTriangleAABBPrimitive::Id>(intersection->second).second;
+        const size_t baseId = hit->triangleIdx;
+        const DetailedTriangleId triangleId =
+            isSimpleTriangle(baseId)
+                ? DetailedTriangleId(baseId)
+                : DetailedTriangleId(baseId, intersectDetail(baseId, ray.calcPosition(hit->distance)));
 
         P_ASSERT(triangleId.getBaseId() < mTriangles.size());
         P_ASSERT(!(triangleId.getDetailId() && isSimpleTriangle(triangleId.getBaseId())));
@@ -365,71 +943,276 @@ std::optional<DetailedTriangleId> Geometry::intersectDetailedMesh(const ci::Ray&
     return {};
 }
 
-std::vector<size_t> Geometry::getTrianglesUnderBrush(const glm::vec3& originPoint, const glm::vec3& insideDirection,
-                                                     size_t startTriangle, const struct BrushSettings& settings) {
-    const double sizeSquared = settings.size * settings.size;
+std::vector<DetailedTriangleId> Geometry::getColorRegion(const DetailedTriangleId startTriangle) {
+    if(!mPolyhedronData.valid) {
+        return {};
+    }
+
+    if(!isDetailedMeshValid()) {
+        updateDetailedMesh();
+    }
+    if(!mMeshDetailed) {
+        return {};
+    }
 
-    /// Stop when the triangle has no intersection with the area highlight
-    auto stoppingCriterionSingleTri = [this, originPoint, sizeSquared, insideDirection, startTriangle,
-                                       settings](const size_t triId) -> bool {
-        // Always accept the first triangle
-        if(triId == startTriangle)
-            return true;
+    const auto startIt = mMeshDetailedFaceDescs.find(startTriangle);
+    P_ASSERT(startIt != mMeshDetailedFaceDescs.end());
+    if(startIt == mMeshDetailedFaceDescs.end()) {
+        return {};
+    }
 
-        const auto& tri = getTriangle(triId);
-        const auto a = tri.getVertex(0);
-        const auto b = tri.getVertex(1);
-        const auto c = tri.getVertex(2);
+    updateColorRegions();
+    const uint32_t region = mColorRegions.faceRegions[static_cast<size_t>(startIt->second)];
+    P_ASSERT(region != ColorRegions::NO_REGION);
 
-        if(!settings.paintBackfaces && glm::dot(tri.getNormal(), insideDirection) > 0.f)
-            return false;  // stop on triangles facing away from the ray
+    const std::vector<PolyhedronData::face_descriptor>& faces = mColorRegions.regionFaces[region];
+    std::vector<DetailedTriangleId> triangles;
+    triangles.reserve(faces.size());
+    for(const PolyhedronData::face_descriptor face : faces) {
+        triangles.push_back(mMeshDetailedIdMap[face]);
+    }
+    return triangles;
+}
 
-        // If triangle's bounding sphere is out of range no need to test further
-        if(!isTriangleInRadius(Point3(originPoint.x, originPoint.y, originPoint.z), settings.size, triId)) {
-            return false;
+void Geometry::updateColorRegions() {
+    P_ASSERT(mMeshDetailed);
+    const auto& mesh = *mMeshDetailed;
+    auto& regions = mColorRegions;
+    auto& faceRegions = regions.faceRegions;
+
+    const auto forEachNeighbour = [&mesh](const PolyhedronData::face_descriptor face, const auto& callback) {
+        for(const auto halfedge : CGAL::halfedges_around_face(mesh.halfedge(face), mesh)) {
+            const auto oppositeEdge = mesh.opposite(halfedge);
+            if(oppositeEdge.is_valid() && !mesh.is_border(oppositeEdge)) {
+                callback(mesh.face(oppositeEdge));
+            }
+        }
+    };
+
+    // Faces to label, all of them or those of the changed triangles and of the regions around them
+    std::vector<PolyhedronData::face_descriptor> toLabel;
+    if(!regions.isValid) {
+        regions.clear();
+        faceRegions.assign(mesh.num_faces(), ColorRegions::NO_REGION);
+        toLabel.reserve(mesh.number_of_faces());
+        for(const PolyhedronData::face_descriptor face : mesh.faces()) {
+            toLabel.push_back(face);
+        }
+        regions.isValid = true;
+    } else {
+        if(regions.dirtyTriangles.empty() && regions.brokenRegions.empty()) {
+            return;
         }
+        faceRegions.resize(mesh.num_faces(), ColorRegions::NO_REGION);
+
+        // A changed face may split its region and join the regions of its neighbours
+        std::vector<uint32_t> changedRegions = std::move(regions.brokenRegions);
+        for(const size_t triangleIdx : regions.dirtyTriangles) {
+            for(const PolyhedronData::face_descriptor face : getDetailedMeshFaces(triangleIdx)) {
+                toLabel.push_back(face);
+                changedRegions.push_back(faceRegions[static_cast<size_t>(face)]);
+                forEachNeighbour(face, [&](const PolyhedronData::face_descriptor neighbour) {
+                    changedRegions.push_back(faceRegions[static_cast<size_t>(neighbour)]);
+                });
+            }
+        }
+        std::sort(changedRegions.begin(), changedRegions.end());
+        changedRegions.erase(std::unique(changedRegions.begin(), changedRegions.end()), changedRegions.end());
 
-        // If any side has intersection with the brush keep the triangle
-        if(GeometryUtils::segmentPointDistanceSquared(a, b, originPoint) < sizeSquared)
-            return true;
-        if(GeometryUtils::segmentPointDistanceSquared(b, c, originPoint) < sizeSquared)
-            return true;
-        if(GeometryUtils::segmentPointDistanceSquared(c, a, originPoint) < sizeSquared)
-            return true;
+        for(const uint32_t region : changedRegions) {
+            if(region == ColorRegions::NO_REGION) {
+                continue;
+            }
+            for(const PolyhedronData::face_descriptor face : regions.regionFaces[region]) {
+                // Faces removed from the region are listed anyway, they were unlabelled on removal
+                if(!mesh.is_removed(face) && faceRegions[static_cast<size_t>(face)] == region) {
+                    toLabel.push_back(face);
+                }
+            }
+            regions.regionFaces[region].clear();
+            regions.freeRegions.push_back(region);
+        }
+        for(const PolyhedronData::face_descriptor face : toLabel) {
+            faceRegions[static_cast<size_t>(face)] = ColorRegions::NO_REGION;
+        }
+    }
+    regions.brokenRegions.clear();
+    regions.dirtyTriangles.clear();
 
-        return false;
-    };
+    // Flood fill each region, the fill stays within the unlabelled faces
+    for(const PolyhedronData::face_descriptor start : toLabel) {
+        if(faceRegions[static_cast<size_t>(start)] != ColorRegions::NO_REGION) {
+            continue;
+        }
 
-    const auto stoppingCriterion = [&stoppingCriterionSingleTri, this](const size_t a, const size_t b) -> bool {
-        return stoppingCriterionSingleTri(a) && stoppingCriterionSingleTri(b);
+        uint32_t region;
+        if(regions.freeRegions.empty()) {
+            region = static_cast<uint32_t>(regions.regionFaces.size());
+            regions.regionFaces.emplace_back();
+        } else {
+            region = regions.freeRegions.back();
+            regions.freeRegions.pop_back();
+        }
+
+        const size_t color = getTriangleColor(mMeshDetailedIdMap[start]);
+        std::vector<PolyhedronData::face_descriptor>& faces = regions.regionFaces[region];
+        P_ASSERT(faces.empty());
+        faces.push_back(start);
+        faceRegions[static_cast<size_t>(start)] = region;
+        for(size_t head = 0; head < faces.size(); ++head) {
+            forEachNeighbour(faces[head], [&](const PolyhedronData::face_descriptor neighbour) {
+                const size_t neighbourIdx = static_cast<size_t>(neighbour);
+                if(faceRegions[neighbourIdx] == ColorRegions::NO_REGION &&
+                   getTriangleColor(mMeshDetailedIdMap[neighbour]) == color) {
+                    faceRegions[neighbourIdx] = region;
+                    faces.push_back(neighbour);
+                }
+            });
+        }
+    }
+}
+
+std::vector<size_t> Geometry::getTrianglesUnderBrush(const glm::vec3& originPoint, const glm::vec3& insideDirection,
+                                                     size_t startTriangle, const struct BrushSettings& settings) {
+    const auto isFacingBrush = [this, insideDirection, settings](const size_t triId) -> bool {
+        // Stop on triangles facing away from the ray
+        return settings.paintBackfaces || glm::dot(mTriangles.getNormal(triId), insideDirection) <= 0.f;
     };
 
     if(settings.continuous) {
+        /// Stop when the triangle has no intersection with the area highlight
+        auto stoppingCriterionSingleTri = [this, originPoint, startTriangle, settings,
+                                           &isFacingBrush](const size_t triId) -> bool {
+            // Always accept the first triangle
+            if(triId == startTriangle)
+                return true;
+
+            if(!isFacingBrush(triId))
+                return false;
+
+            // If triangle's bounding sphere is out of range no need to test further
+            if(!isTriangleInRadius(Point3(originPoint.x, originPoint.y, originPoint.z), settings.size, triId)) {
+                return false;
+            }
+
+            // If any side has intersection with the brush keep the triangle
+            return GeometryUtils::classifyTriangle(mTriangles.getVertex(triId, 0), mTriangles.getVertex(triId, 1),
+                                                   mTriangles.getVertex(triId, 2), originPoint,
+                                                   settings.size) != SphereCoverage::Outside;
+        };
+
+        const auto stoppingCriterion = [&stoppingCriterionSingleTri](const size_t a, const size_t b) -> bool {
+            return stoppingCriterionSingleTri(a) && stoppingCriterionSingleTri(b);
+        };
         return bucket(startTriangle, stoppingCriterion);
     } else {
         std::vector<size_t> trianglesInRadius =
             getTrianglesInRadius(Point3(originPoint.x, originPoint.y, originPoint.z), settings.size);
 
-        std::vector<size_t> result;
-        std::copy_if(trianglesInRadius.begin(), trianglesInRadius.end(), std::back_inserter(result),
-                     stoppingCriterionSingleTri);
+        // Classify all candidates facing the brush at once, the first triangle is always accepted
+        std::vector<size_t> candidates;
+        candidates.reserve(trianglesInRadius.size());
+        std::copy_if(trianglesInRadius.begin(), trianglesInRadius.end(), std::back_inserter(candidates),
+                     [startTriangle, &isFacingBrush](const size_t triId) {
+                         return triId == startTriangle || isFacingBrush(triId);
+                     });
+        const std::vector<SphereCoverage> coverage =
+            GeometryUtils::classifyTriangles(mTriangles.getVertices(), candidates, originPoint, settings.size);
 
+        std::vector<size_t> result;
+        result.reserve(candidates.size());
+        for(size_t i = 0; i < candidates.size(); ++i) {
+            if(candidates[i] == startTriangle || coverage[i] != SphereCoverage::Outside) {
+                result.push_back(candidates[i]);
+            }
+        }
         return result;
     }
 }
 
-void Geometry::highlightArea(const ci::Ray& ray, const BrushSettings& settings) {
-    const glm::vec3 source = ray.getOrigin();
-    const glm::vec3 rayDirection = ray.getDirection();
-
-    glm::vec3 intersectionPoint{};
-    auto intersectedTri = intersectMesh(ray, intersectionPoint);
-    if(intersectedTri) {
-        std::vector<size_t> trianglesToPaint;
+std::vector<std::pair<size_t, SphereCoverage>> Geometry::getTrianglesUnderStroke(const glm::vec3& start,
+                                                                                 const glm::vec3& end,
+                                                                                 const glm::vec3& insideDirection,
+                                                                                 size_t startTriangle,
+                                                                                 const BrushSettings& settings) {
+    const auto isFacingBrush = [this, insideDirection, settings](const size_t triId) -> bool {
+        // Stop on triangles facing away from the ray
+        return settings.paintBackfaces || glm::dot(mTriangles.getNormal(triId), insideDirection) <= 0.f;
+    };
+    const auto classify = [this, &start, &end, &settings](const size_t triId) {
+        return GeometryUtils::classifyTriangleAgainstCapsule(mTriangles.getVertex(triId, 0),
+                                                             mTriangles.getVertex(triId, 1),
+                                                             mTriangles.getVertex(triId, 2), start, end, settings.size);
+    };
+    const Segment3 axis(Point3(start.x, start.y, start.z), Point3(end.x, end.y, end.z));
 
-        if(settings.continuous) {
-            trianglesToPaint = getTrianglesUnderBrush(intersectionPoint, rayDirection, *intersectedTri, settings);
-        }
+    std::vector<size_t> candidates;
+    if(settings.continuous) {
+        /// Stop when the triangle has no intersection with the capsule
+        auto stoppingCriterionSingleTri = [this, &axis, startTriangle, settings, &isFacingBrush,
+                                           &classify](const size_t triId) -> bool {
+            // Always accept the first triangle
+            if(triId == startTriangle)
+                return true;
+
+            if(!isFacingBrush(triId) || !isTriangleInRadius(axis, settings.size, triId)) {
+                return false;
+            }
+            return classify(triId) != SphereCoverage::Outside;
+        };
+
+        const auto stoppingCriterion = [&stoppingCriterionSingleTri](const size_t a, const size_t b) -> bool {
+            return stoppingCriterionSingleTri(a) && stoppingCriterionSingleTri(b);
+        };
+        candidates = bucket(startTriangle, stoppingCriterion);
+    } else {
+        candidates = getTrianglesInRadius(axis, settings.size);
+    }
+
+    std::vector<std::pair<size_t, SphereCoverage>> result;
+    result.reserve(candidates.size());
+    for(const size_t triId : candidates) {
+        if(triId != startTriangle && !isFacingBrush(triId)) {
+            continue;
+        }
+        const SphereCoverage coverage = classify(triId);
+        if(triId == startTriangle || coverage != SphereCoverage::Outside) {
+            result.emplace_back(triId, coverage);
+        }
+    }
+    return result;
+}
+
+void Geometry::highlightArea(const ci::Ray& ray, const BrushSettings& settings) {
+    glm::vec3 intersectionPoint{};
+    const std::optional<size_t> intersectedTri = intersectMesh(ray, intersectionPoint);
+    highlightArea(ray, intersectedTri, intersectionPoint, settings);
+}
+
+void Geometry::highlightArea(const ci::Ray& ray, const std::optional<size_t> intersectedTri,
+                             const glm::vec3& intersectionPoint, const BrushSettings& settings) {
+    const glm::vec3 rayDirection = ray.getDirection();
+
+    if(intersectedTri) {
+        // Small moves over the same triangle change only a few triangles at the border of the highlight, the shader
+        // follows the brush center exactly, so the previous continuous surface can be kept
+        const bool isSameHighlight = mAreaHighlight.enabled && !mAreaHighlight.dirty &&
+                                     mAreaHighlight.startTriangle == *intersectedTri &&
+                                     mAreaHighlight.settings == settings;
+        if(isSameHighlight && glm::distance(intersectionPoint, mAreaHighlight.trianglesOrigin) <
+                                  HIGHLIGHT_REUSE_DISTANCE * settings.size) {
+            mAreaHighlight.origin = intersectionPoint;
+            mAreaHighlight.direction = ray.getDirection();
+            return;
+        }
+
+        std::vector<size_t> trianglesToPaint;
+
+        if(settings.continuous) {
+            trianglesToPaint = getTrianglesUnderBrush(intersectionPoint, rayDirection, *intersectedTri, settings);
+        }
+
+        const std::set<size_t> previousTriangles = std::move(mAreaHighlight.triangles);
 
         mAreaHighlight.triangles = std::set<size_t>(trianglesToPaint.begin(), trianglesToPaint.end());
         trianglesToPaint.clear();
@@ -437,79 +1220,199 @@ void Geometry::highlightArea(const ci::Ray& ray, const BrushSettings& settings)
         mAreaHighlight.size = settings.size;
         mAreaHighlight.origin = intersectionPoint;
         mAreaHighlight.direction = ray.getDirection();
+        mAreaHighlight.startTriangle = *intersectedTri;
+        mAreaHighlight.trianglesOrigin = intersectionPoint;
         mAreaHighlight.enabled = true;
-        mAreaHighlight.dirty = true;
 
-        // Generate highlight buffer only if our openGlBuffers are valid
-        // Otherwise delay until everything is generated again
-        if(!mOgl.isDirty) {
+        // The shader tests the distance to the origin, only the continuous surface is stored in the mask.
+        // The mask is indexed by base triangles, so it stays valid even while the other buffers are dirty.
+        if(mAreaHighlight.dirty || mOgl.highlightMask.size() != getHighlightMaskSize(mTriangles.size())) {
             generateHighlightBuffer();
+        } else {
+            // Only the triangles that entered or left the highlight change their bit
+            std::vector<size_t> changedTriangles;
+            std::set_symmetric_difference(previousTriangles.begin(), previousTriangles.end(),
+                                          mAreaHighlight.triangles.begin(), mAreaHighlight.triangles.end(),
+                                          std::back_inserter(changedTriangles));
+            for(const size_t triangleIdx : changedTriangles) {
+                setHighlightMask(triangleIdx, getHighlightMaskValue(triangleIdx));
+            }
         }
-
-        // TODO: Improvement: Try to avoid doing all this if we are highlighting the same triangle with the same
-        // size
     } else {
         mAreaHighlight.enabled = false;
     }
 }
 
+void Geometry::highlightTriangles(const std::vector<size_t>& triangles) {
+    mAreaHighlight.triangles.clear();
+    mAreaHighlight.settings = BrushSettings();
+    mAreaHighlight.settings.continuous = true;
+    // The shader highlights the masked faces closer to the origin than the size, i.e., all of them
+    mAreaHighlight.origin = (getBoundingBoxMin() + getBoundingBoxMax()) / 2.f;
+    mAreaHighlight.size = glm::distance(getBoundingBoxMin(), getBoundingBoxMax()) + 1.0;
+    mAreaHighlight.enabled = true;
+    // The mask no longer matches the triangles, the next highlightArea() generates it again
+    mAreaHighlight.dirty = true;
+
+    mOgl.highlightMask.assign(getHighlightMaskSize(mTriangles.size()), 0);
+    for(const size_t triangleIdx : triangles) {
+        P_ASSERT(triangleIdx < mTriangles.size());
+        mOgl.highlightMask[triangleIdx / 32] |= GLuint(1) << (triangleIdx % 32);
+    }
+    mOgl.info.didHighlightUpdate = true;
+    mOgl.info.highlightRanges.clear();
+    mOgl.info.highlightRanges.add(0, mOgl.highlightMask.size());
+}
+
 void Geometry::paintWithShape(const ci::Ray& ray, const std::vector<Point3>& shape, size_t color, bool paintBackfaces) {
-    const std::pair<Point3, double> shapeBounds = GeometryUtils::getBoundingSphere(shape);
-    const auto rd = ray.getDirection();
-    const Line3 rayLine(shapeBounds.first, Vector3(rd.x, rd.y, rd.z));
+    paintWithShapes({ray.getDirection()}, {shape}, color, paintBackfaces);
+}
 
-    std::vector<size_t> trianglesInCylinder = getTrianglesInRadius(rayLine, shapeBounds.second);
+void Geometry::paintWithShapes(const std::vector<glm::vec3>& directions, const std::vector<std::vector<Point3>>& shapes,
+                               size_t color, bool paintBackfaces) {
+    P_ASSERT(directions.size() == shapes.size());
 
-    // Gather all the TriangleDetails that we want to update
-    std::vector<size_t> detailsToUpdate;
-    for(size_t triIdx : trianglesInCylinder) {
-        const auto& cgalTri = getTriangle(triIdx).getTri();
+    // Collect the shapes touching each triangle first, so that each triangle detail is changed only once
+    std::map<size_t, std::vector<TriangleDetail::ShapeProjection>> detailShapes;
+    for(size_t shapeIdx = 0; shapeIdx < shapes.size(); ++shapeIdx) {
+        const std::pair<Point3, double> shapeBounds = GeometryUtils::getBoundingSphere(shapes[shapeIdx]);
+        const glm::vec3& rd = directions[shapeIdx];
+        const Line3 rayLine(shapeBounds.first, Vector3(rd.x, rd.y, rd.z));
 
-        if(glm::dot(rd, getTriangle(triIdx).getNormal()) > 0 && !paintBackfaces) {
-            continue;  // Skip triangles facing away
-        }
+        std::vector<size_t> trianglesInCylinder = getTrianglesInRadius(rayLine, shapeBounds.second);
 
-        if(isSimpleTriangle(triIdx) && getTriangleColor(triIdx) == color) {
-            continue;  // Do not paint simple triangles of the same color
+        for(size_t triIdx : trianglesInCylinder) {
+            if(glm::dot(rd, getTriangle(triIdx).getNormal()) > 0 && !paintBackfaces) {
+                continue;  // Skip triangles facing away
+            }
+
+            if(isSimpleTriangle(triIdx) && getTriangleColor(triIdx) == color) {
+                continue;  // Do not paint simple triangles of the same color
+            }
+
+            detailShapes[triIdx].push_back({&shapes[shapeIdx], rayLine.direction().vector()});
         }
+    }
 
-        detailsToUpdate.emplace_back(triIdx);
-        getTriangleDetail(triIdx);  // Make sure triangle detail is created
+    if(detailShapes.empty()) {
+        return;
     }
 
-    if(!detailsToUpdate.empty()) {
-        invalidateTemporaryDetailedData();
+    std::vector<size_t> detailsToUpdate;
+    detailsToUpdate.reserve(detailShapes.size());
+    for(const auto& projections : detailShapes) {
+        detailsToUpdate.push_back(projections.first);
+        getTriangleDetail(projections.first);  // Make sure triangle detail is created
     }
 
     // Update in parallel
-    auto& threadPool = MainApplication::getThreadPool();
-    threadPool.parallel_for(detailsToUpdate.begin(), detailsToUpdate.end(),
-                            [this, &shape, color, &rayLine](size_t triIdx) {
-                                getTriangleDetail(triIdx)->paintShape(shape, rayLine.direction().vector(), color);
-                            });
-
-    mOgl.isDirty = true;
+    auto& threadPool = getThreadPool();
+    threadPool.parallel_for_weighted(
+        detailsToUpdate.begin(), detailsToUpdate.end(),
+        [this, &detailShapes, color](size_t triIdx) {
+            getTriangleDetail(triIdx)->paintShapes(detailShapes.at(triIdx), color);
+        },
+        [this](size_t triIdx) { return getTriangleDetailComplexity(triIdx); });
+
+    for(const size_t triIdx : detailsToUpdate) {
+        markDetailDirty(triIdx);
+    }
+    mDetailsToCompact.insert(detailsToUpdate.begin(), detailsToUpdate.end());
+    compactTriangleDetails();
 }
 
-void Geometry::paintWithShape(const ci::Ray& ray, const std::vector<DataTriangle::Triangle>& triangles, size_t color) {
-    CI_LOG_I(std::string("Shape of ") + std::to_string(triangles.size()) + std::string(" triangles"));
+void Geometry::paintWithText(const ci::Ray& ray, const std::vector<std::vector<DataTriangle::Triangle>>& letters,
+                             size_t color) {
+    const auto rd = ray.getDirection();
+    const Vector3 direction(rd.x, rd.y, rd.z);
+    auto& threadPool = getThreadPool();
 
-    const std::pair<Point3, double> shapeBounds = GeometryUtils::getBoundingSphere(triangles);
+    // Each letter is joined once, its outlines are projected onto the triangle details instead of its triangles
+    std::vector<std::vector<TriangleDetail::ShapeOutline>> letterOutlines(letters.size());
+    std::vector<size_t> letterIds(letters.size());
+    std::iota(letterIds.begin(), letterIds.end(), 0);
+    try {
+        threadPool.parallel_for(
+            letterIds.begin(), letterIds.end(),
+            [&](const size_t letterIdx) {
+                letterOutlines[letterIdx] = TriangleDetail::unionTriangles(letters[letterIdx], direction);
+            },
+            1);
+    } catch(const std::exception& e) {
+        CI_LOG_E(e.what());
+        throw;
+    }
 
-    CI_LOG_I(std::string("Bounds size: ") + std::to_string(shapeBounds.second));
+    // The outlines of the letters, and each triangle as an outline of its own
+    std::vector<const TriangleDetail::ShapeOutline*> outlines;
+    std::vector<size_t> outlineLetters;
+    std::vector<Point3> outlinePoints;
+    for(size_t letterIdx = 0; letterIdx < letters.size(); ++letterIdx) {
+        for(const TriangleDetail::ShapeOutline& outline : letterOutlines[letterIdx]) {
+            outlines.push_back(&outline);
+            outlineLetters.push_back(letterIdx);
+            outlinePoints.insert(outlinePoints.end(), outline.outerBoundary.begin(), outline.outerBoundary.end());
+        }
+    }
+    std::vector<TriangleDetail::ShapeOutline> triangleOutlines;
+    std::vector<size_t> triangleLetters;
+    for(size_t letterIdx = 0; letterIdx < letters.size(); ++letterIdx) {
+        for(const DataTriangle::Triangle& tri : letters[letterIdx]) {
+            triangleOutlines.push_back({{tri.vertex(0), tri.vertex(1), tri.vertex(2)}, {}});
+            triangleLetters.push_back(letterIdx);
+        }
+    }
+    CI_LOG_I(std::string("Text of ") + std::to_string(letters.size()) + std::string(" letters, ") +
+             std::to_string(outlines.size()) + std::string(" outlines"));
+    if(outlines.empty()) {
+        return;
+    }
 
-    const auto rd = ray.getDirection();
-    const Line3 rayLine(shapeBounds.first, Vector3(rd.x, rd.y, rd.z));
+    // Bounds of the outlines and of the triangles in a plane perpendicular to the projection, bucketed into grids
+    const glm::dvec3 planeNormal = glm::normalize(glm::dvec3(rd));
+    const glm::dvec3 otherDirection = std::abs(planeNormal.x) < 0.9 ? glm::dvec3(1, 0, 0) : glm::dvec3(0, 1, 0);
+    const glm::dvec3 planeBase1 = glm::normalize(glm::cross(planeNormal, otherDirection));
+    const glm::dvec3 planeBase2 = glm::cross(planeNormal, planeBase1);
+    const auto getPlaneBounds = [&planeBase1, &planeBase2](const std::vector<Point3>& points) {
+        Box2 bounds;
+        for(const Point3& point : points) {
+            const glm::dvec3 position(point.x(), point.y(), point.z());
+            bounds.add(glm::dvec2(glm::dot(position, planeBase1), glm::dot(position, planeBase2)));
+        }
+        return bounds;
+    };
+
+    std::vector<Box2> outlineBounds;
+    std::vector<size_t> outlineCorners;
+    for(const TriangleDetail::ShapeOutline* outline : outlines) {
+        outlineBounds.push_back(getPlaneBounds(outline->outerBoundary));
+        outlineCorners.push_back(outline->outerBoundary.size());
+        for(const std::vector<Point3>& hole : outline->holes) {
+            outlineCorners.back() += hole.size();
+        }
+    }
+    const BoxGrid outlineGrid(std::move(outlineBounds));
+
+    std::vector<Box2> triangleBounds;
+    for(const TriangleDetail::ShapeOutline& outline : triangleOutlines) {
+        triangleBounds.push_back(getPlaneBounds(outline.outerBoundary));
+    }
+    const BoxGrid triangleGrid(std::move(triangleBounds));
+
+    // Footprints are enlarged to stay on the safe side of the rounding errors
+    const glm::dvec2 textSize = outlineGrid.getBounds().max - outlineGrid.getBounds().min;
+    const double margin = 1e-6 * std::max(textSize.x, textSize.y);
 
+    const std::pair<Point3, double> shapeBounds = GeometryUtils::getBoundingSphere(outlinePoints);
+    const Line3 rayLine(shapeBounds.first, direction);
     std::vector<size_t> trianglesInCylinder = getTrianglesInRadius(rayLine, shapeBounds.second);
     CI_LOG_I(std::string("Triangles in radius: ") + std::to_string(trianglesInCylinder.size()));
 
-    // Gather all the TriangleDetails that we want to update
-    std::vector<size_t> detailsToUpdate;
+    // Collect the outlines overlapping the footprint of each triangle, so that each triangle detail is changed once
+    std::map<size_t, std::vector<TriangleDetail::OutlineProjection>> detailOutlines;
     for(size_t triIdx : trianglesInCylinder) {
-        const auto& cgalTri = getTriangle(triIdx).getTri();
-
-        if(glm::dot(rd, getTriangle(triIdx).getNormal()) >= 0) {
+        const TriangleView triangle = getTriangle(triIdx);
+        if(glm::dot(rd, triangle.getNormal()) >= 0) {
             continue;  // Skip triangles facing away
         }
 
@@ -517,28 +1420,80 @@ void Geometry::paintWithShape(const ci::Ray& ray, const std::vector<DataTriangle
             continue;  // Do not paint simple triangles of the same color
         }
 
-        detailsToUpdate.emplace_back(triIdx);
-        getTriangleDetail(triIdx);  // Make sure triangle detail is created
+        std::vector<Point3> corners;
+        for(size_t i = 0; i < 3; ++i) {
+            const glm::vec3 vertex = triangle.getVertex(i);
+            corners.emplace_back(vertex.x, vertex.y, vertex.z);
+        }
+        Box2 footprint = getPlaneBounds(corners);
+        footprint.enlarge(margin);
+
+        const std::vector<size_t> overlappingTriangles = triangleGrid.findOverlapping(footprint);
+        if(overlappingTriangles.empty()) {
+            continue;
+        }
+        const std::vector<size_t> overlappingOutlines = outlineGrid.findOverlapping(footprint);
+
+        // Corners of the overlapping outlines and triangles of each letter. A letter is projected by its outlines,
+        // unless its triangles overlapping the footprint have much fewer corners, e.g. on small triangles.
+        std::map<size_t, std::pair<size_t, size_t>> letterCorners;
+        for(const size_t outlineIdx : overlappingOutlines) {
+            letterCorners[outlineLetters[outlineIdx]].first += outlineCorners[outlineIdx];
+        }
+        for(const size_t triangleOutlineIdx : overlappingTriangles) {
+            letterCorners[triangleLetters[triangleOutlineIdx]].second += 3;
+        }
+        const auto isProjectedByOutlines = [&letterCorners](const size_t letterIdx) {
+            const std::pair<size_t, size_t>& corners = letterCorners.at(letterIdx);
+            return corners.first > 0 && corners.second > 0 && corners.first <= 2 * corners.second;
+        };
+
+        std::vector<TriangleDetail::OutlineProjection>& projections = detailOutlines[triIdx];
+        for(const size_t outlineIdx : overlappingOutlines) {
+            if(isProjectedByOutlines(outlineLetters[outlineIdx])) {
+                projections.push_back({outlines[outlineIdx], rayLine.direction().vector()});
+            }
+        }
+        for(const size_t triangleOutlineIdx : overlappingTriangles) {
+            if(!isProjectedByOutlines(triangleLetters[triangleOutlineIdx])) {
+                projections.push_back({&triangleOutlines[triangleOutlineIdx], rayLine.direction().vector()});
+            }
+        }
+    }
+    CI_LOG_I(std::string("Triangles to paint: ") + std::to_string(detailOutlines.size()));
+
+    if(detailOutlines.empty()) {
+        return;
     }
-    CI_LOG_I(std::string("Triangles to paint: ") + std::to_string(detailsToUpdate.size()));
-    if(!detailsToUpdate.empty()) {
-        invalidateTemporaryDetailedData();
+
+    std::vector<size_t> detailsToUpdate;
+    detailsToUpdate.reserve(detailOutlines.size());
+    for(const auto& projections : detailOutlines) {
+        detailsToUpdate.push_back(projections.first);
+        getTriangleDetail(projections.first);  // Make sure triangle detail is created
     }
 
     // Update in parallel
+    std::atomic<size_t> paintedDetails{0};
     try {
-        auto& threadPool = MainApplication::getThreadPool();
-        threadPool.parallel_for(
-            detailsToUpdate.begin(), detailsToUpdate.end(), [this, &triangles, color, &rayLine](size_t triIdx) {
-                getTriangleDetail(triIdx)->paintShape(triangles, rayLine.direction().vector(), color);
-            });
-
+        threadPool.parallel_for_weighted(
+            detailsToUpdate.begin(), detailsToUpdate.end(),
+            [this, &detailOutlines, color, &paintedDetails, &detailsToUpdate](size_t triIdx) {
+                getTriangleDetail(triIdx)->paintOutlines(detailOutlines.at(triIdx), color);
+                mProgress->paintTextPercentage =
+                    static_cast<float>(++paintedDetails) / static_cast<float>(detailsToUpdate.size());
+            },
+            [this](size_t triIdx) { return getTriangleDetailComplexity(triIdx); });
     } catch(const std::exception& e) {
         CI_LOG_E(e.what());
         throw;
     }
 
-    mOgl.isDirty = true;
+    for(const size_t triIdx : detailsToUpdate) {
+        markDetailDirty(triIdx);
+    }
+    mDetailsToCompact.insert(detailsToUpdate.begin(), detailsToUpdate.end());
+    compactTriangleDetails();
 }
 
 void Geometry::paintAreaWithSphere(const ci::Ray& ray, const BrushSettings& settings) {
@@ -551,18 +1506,21 @@ void Geometry::paintAreaWithSphere(const ci::Ray& ray, const BrushSettings& sett
 
     const auto trisInBrush = getTrianglesUnderBrush(intersectionPoint, ray.getDirection(), *intersectedTri, settings);
 
+    const std::vector<SphereCoverage> coverage =
+        GeometryUtils::classifyTriangles(mTriangles.getVertices(), trisInBrush, intersectionPoint, settings.size);
     std::vector<size_t> detailsToUpdate;
 
-    for(const size_t triangleIdx : trisInBrush) {
-        const auto& cgalTri = getTriangle(triangleIdx).getTri();
+    std::vector<size_t> trianglesToColor;
 
-        if(GeometryUtils::isFullyInsideASphere(cgalTri, intersectionPoint, settings.size)) {
+    for(size_t i = 0; i < trisInBrush.size(); ++i) {
+        const size_t triangleIdx = trisInBrush[i];
+        if(coverage[i] == SphereCoverage::Inside) {
             // Triangles fully inside are colored whole
-            setTriangleColor(triangleIdx, settings.color);
+            trianglesToColor.push_back(triangleIdx);
         } else {
             if(settings.respectOriginalTriangles) {
                 if(settings.paintOuterRing) {
-                    setTriangleColor(triangleIdx, settings.color);
+                    trianglesToColor.push_back(triangleIdx);
                 }
 
             } else {
@@ -575,56 +1533,210 @@ void Geometry::paintAreaWithSphere(const ci::Ray& ray, const BrushSettings& sett
         }
     }
 
-    if(!detailsToUpdate.empty()) {
-        invalidateTemporaryDetailedData();
-    }
+    setTriangleColors(std::move(trianglesToColor), settings.color);
 
     const Sphere brushShape(Point3(intersectionPoint.x, intersectionPoint.y, intersectionPoint.z),
                             settings.size * settings.size);
 
     try {
-        auto& threadPool = MainApplication::getThreadPool();
-        threadPool.parallel_for(
-            detailsToUpdate.begin(), detailsToUpdate.end(), [this, &brushShape, &settings](size_t triIdx) {
+        auto& threadPool = getThreadPool();
+        threadPool.parallel_for_weighted(
+            detailsToUpdate.begin(), detailsToUpdate.end(),
+            [this, &brushShape, &settings](size_t triIdx) {
                 getTriangleDetail(triIdx)->paintSphere(brushShape, settings.segments, settings.color);
-            });
+            },
+            [this](size_t triIdx) { return getTriangleDetailComplexity(triIdx); });
+    } catch(const std::exception& e) {
+        CI_LOG_E(e.what());
+        throw;
+    }
+
+    for(const size_t triIdx : detailsToUpdate) {
+        markDetailDirty(triIdx);
+    }
+    mDetailsToCompact.insert(detailsToUpdate.begin(), detailsToUpdate.end());
+    compactTriangleDetails();
+}
+
+void Geometry::paintAreaWithSpheres(const std::vector<ci::Ray>& rays, const BrushSettings& settings) {
+    std::vector<glm::vec3> origins;
+    std::vector<glm::vec3> directions;
+    origins.reserve(rays.size());
+    directions.reserve(rays.size());
+    for(const ci::Ray& ray : rays) {
+        origins.emplace_back(ray.getOrigin());
+        directions.emplace_back(ray.getDirection());
+    }
+    const std::vector<std::optional<TriangleBvh::Hit>> hits = mPickingTree.intersect(origins, directions);
+    std::vector<std::optional<glm::vec3>> hitPoints(rays.size());
+    for(size_t rayIdx = 0; rayIdx < rays.size(); ++rayIdx) {
+        if(hits[rayIdx]) {
+            hitPoints[rayIdx] = rays[rayIdx].calcPosition(hits[rayIdx]->distance);
+        }
+    }
+
+    // Collect the union of the triangles under all dabs first, so that each triangle is changed only once
+    std::set<size_t> trianglesToColor;
+    std::map<size_t, std::vector<Sphere>> detailDabs;
+    std::map<size_t, std::vector<TriangleDetail::PeprCapsule>> detailSegments;
+
+    /// Color the triangles inside the brush, returns true if the brush has to be painted onto the triangle detail
+    const auto isDetailPainted = [this, &settings, &trianglesToColor](const size_t triangleIdx,
+                                                                       const SphereCoverage coverage) -> bool {
+        if(coverage == SphereCoverage::Inside) {
+            trianglesToColor.insert(triangleIdx);
+        } else if(settings.respectOriginalTriangles) {
+            if(settings.paintOuterRing) {
+                trianglesToColor.insert(triangleIdx);
+            }
+        } else {
+            return !isSimpleTriangle(triangleIdx) || getTriangle(triangleIdx).getColor() != settings.color;
+        }
+        return false;
+    };
+
+    /// Are the hits of the rays connected by a segment of a swept stroke
+    const auto isConnected = [&hitPoints, &settings](const size_t firstRayIdx, const size_t secondRayIdx) {
+        return settings.sweptStroke && hitPoints[firstRayIdx] && hitPoints[secondRayIdx] &&
+               glm::distance(*hitPoints[firstRayIdx], *hitPoints[secondRayIdx]) <=
+                   SWEPT_STROKE_MAX_GAP * settings.size;
+    };
+
+    for(size_t rayIdx = 0; rayIdx < rays.size(); ++rayIdx) {
+        if(!hitPoints[rayIdx]) {
+            continue;
+        }
+        const glm::vec3 intersectionPoint = *hitPoints[rayIdx];
+        const Point3 center(intersectionPoint.x, intersectionPoint.y, intersectionPoint.z);
+
+        if(rayIdx + 1 < rays.size() && isConnected(rayIdx, rayIdx + 1)) {
+            // The capsule contains the dabs at both of its ends
+            const glm::vec3 nextPoint = *hitPoints[rayIdx + 1];
+            const TriangleDetail::PeprCapsule segment{center, Point3(nextPoint.x, nextPoint.y, nextPoint.z),
+                                                      settings.size * settings.size};
+            for(const auto& triangle : getTrianglesUnderStroke(intersectionPoint, nextPoint, directions[rayIdx + 1],
+                                                               hits[rayIdx]->triangleIdx, settings)) {
+                if(isDetailPainted(triangle.first, triangle.second)) {
+                    detailSegments[triangle.first].push_back(segment);
+                }
+            }
+            continue;
+        }
+        if(rayIdx > 0 && isConnected(rayIdx - 1, rayIdx)) {
+            continue;
+        }
+
+        const auto trisInBrush =
+            getTrianglesUnderBrush(intersectionPoint, directions[rayIdx], hits[rayIdx]->triangleIdx, settings);
+        const std::vector<SphereCoverage> coverage =
+            GeometryUtils::classifyTriangles(mTriangles.getVertices(), trisInBrush, intersectionPoint, settings.size);
+
+        for(size_t i = 0; i < trisInBrush.size(); ++i) {
+            if(!isDetailPainted(trisInBrush[i], coverage[i])) {
+                continue;
+            }
+            if(settings.sweptStroke) {
+                // A dab not connected to the stroke is a capsule of a single point
+                detailSegments[trisInBrush[i]].push_back({center, center, settings.size * settings.size});
+            } else {
+                detailDabs[trisInBrush[i]].emplace_back(center, settings.size * settings.size);
+            }
+        }
+    }
+
+    // Coloring the whole triangle covers all dabs painted onto its detail
+    for(const size_t triangleIdx : trianglesToColor) {
+        detailDabs.erase(triangleIdx);
+        detailSegments.erase(triangleIdx);
+    }
+    setTriangleColors(std::vector<size_t>(trianglesToColor.begin(), trianglesToColor.end()), settings.color);
+
+    if(detailDabs.empty() && detailSegments.empty()) {
+        return;
+    }
+
+    // Only one of the maps is used, depending on the stroke
+    std::vector<size_t> detailsToUpdate;
+    detailsToUpdate.reserve(detailDabs.size() + detailSegments.size());
+    for(const auto& dabs : detailDabs) {
+        detailsToUpdate.push_back(dabs.first);
+    }
+    for(const auto& segments : detailSegments) {
+        detailsToUpdate.push_back(segments.first);
+    }
+    for(const size_t triIdx : detailsToUpdate) {
+        getTriangleDetail(triIdx);  // Create triangle detail so that we dont modify the map in parallel
+    }
+
+    try {
+        auto& threadPool = getThreadPool();
+        threadPool.parallel_for_weighted(
+            detailsToUpdate.begin(), detailsToUpdate.end(),
+            [this, &detailDabs, &detailSegments, &settings](size_t triIdx) {
+                TriangleDetail* detail = getTriangleDetail(triIdx);
+                if(settings.sweptStroke) {
+                    detail->paintCapsules(detailSegments.at(triIdx), settings.segments, settings.color);
+                } else {
+                    detail->paintSpheres(detailDabs.at(triIdx), settings.segments, settings.color);
+                }
+            },
+            [this](size_t triIdx) { return getTriangleDetailComplexity(triIdx); });
     } catch(const std::exception& e) {
         CI_LOG_E(e.what());
         throw;
     }
 
-    mOgl.isDirty = true;
+    for(const size_t triIdx : detailsToUpdate) {
+        markDetailDirty(triIdx);
+    }
+    mDetailsToCompact.insert(detailsToUpdate.begin(), detailsToUpdate.end());
+    compactTriangleDetails();
 }
 
 TriangleDetail* Geometry::createTriangleDetail(size_t triangleIdx) {
-    auto result = mTriangleDetails.emplace(triangleIdx, TriangleDetail(getTriangle(triangleIdx)));
+    TriangleDetailSlot& slot = mTriangleDetailSlots[triangleIdx];
+    if(!slot.detail) {
+        slot.detail.emplace(TriangleDetail(mTriangles.getDataTriangle(triangleIdx)));
+    }
+    markDetailDirty(triangleIdx);
 
-    return &(result.first->second);
+    return &(slot.detail->write());
 }
 
 void Geometry::removeTriangleDetail(const size_t triangleIndex) {
-    mOgl.isDirty = true;
-    mTriangleDetails.erase(triangleIndex);
+    recordTriangleState(triangleIndex);
+    markDetailDirty(triangleIndex);
+    eraseTriangleDetail(triangleIndex);
+}
 
-    // Chaning triangle detail invalidates detailed tree and mesh
-    invalidateTemporaryDetailedData();
+std::map<size_t, CopyOnWrite<TriangleDetail>> Geometry::copyTriangleDetails() const {
+    std::map<size_t, CopyOnWrite<TriangleDetail>> details;
+    for(const auto& slot : mTriangleDetailSlots) {
+        if(slot.second.detail) {
+            details.emplace(slot.first, *slot.second.detail);
+        }
+    }
+    return details;
+}
+
+void Geometry::replaceTriangleDetails(const std::map<size_t, CopyOnWrite<TriangleDetail>>& details) {
+    mTriangleDetailSlots.eraseIf([](size_t, TriangleDetailSlot& slot) {
+        slot.detail.reset();
+        return !slot.bufferSlot;
+    });
+    for(const auto& detail : details) {
+        setTriangleDetail(detail.first, detail.second);
+    }
 }
 
 void Geometry::setTriangleColor(const size_t triangleIndex, const size_t newColor) {
+    recordTriangleState(triangleIndex);
+    markColorRegionDirty(triangleIndex);
     if(isSimpleTriangle(triangleIndex)) {
-        if(!mOgl.isDirty) {
+        // Base triangles never move in the buffers, so we can write as long as the layout is valid
+        if(!mOglNeedsRebuild) {
             // Change it in the buffer
-            // Color buffer has 1 ColorA for each vertex, each triangle has 3 vertices
-            const size_t vertexPosition = triangleIndex * 3;
-
-            // Change all vertices of the triangle to the same new color
-            P_ASSERT(vertexPosition + 2 < mOgl.colorBuffer.size());
-
-            ColorIndex newColorIndex = static_cast<ColorIndex>(newColor);
-            mOgl.colorBuffer[vertexPosition] = newColorIndex;
-            mOgl.colorBuffer[vertexPosition + 1] = newColorIndex;
-            mOgl.colorBuffer[vertexPosition + 2] = newColorIndex;
-            mOgl.info.didColorUpdate = true;
+            setColorBufferFace(triangleIndex, newColor);
         }
     } else {
         removeTriangleDetail(triangleIndex);
@@ -632,7 +1744,33 @@ void Geometry::setTriangleColor(const size_t triangleIndex, const size_t newColo
 
     /// Change it in the triangle soup
     P_ASSERT(triangleIndex < mTriangles.size());
-    mTriangles[triangleIndex].setColor(newColor);
+    mTriangles.setColor(triangleIndex, newColor);
+}
+
+void Geometry::setTriangleColors(std::vector<size_t> triangleIndices, const size_t newColor) {
+    std::sort(triangleIndices.begin(), triangleIndices.end());
+    triangleIndices.erase(std::unique(triangleIndices.begin(), triangleIndices.end()), triangleIndices.end());
+    if(triangleIndices.empty()) {
+        return;
+    }
+    P_ASSERT(triangleIndices.back() < mTriangles.size());
+
+    recordTriangleStates(triangleIndices);
+    const bool isBufferValid = !mOglNeedsRebuild;
+    for(const size_t triangleIndex : triangleIndices) {
+        markColorRegionDirty(triangleIndex);
+        if(isSimpleTriangle(triangleIndex)) {
+            // Base triangles never move in the buffers, consecutive faces extend the same dirty range
+            if(isBufferValid) {
+                setColorBufferFace(triangleIndex, newColor);
+            }
+        } else {
+            // The state is already recorded
+            markDetailDirty(triangleIndex);
+            eraseTriangleDetail(triangleIndex);
+        }
+        mTriangles.setColor(triangleIndex, newColor);
+    }
 }
 
 void Geometry::setTriangleColor(const DetailedTriangleId triangleId, const size_t newColor) {
@@ -646,15 +1784,14 @@ void Geometry::setTriangleColor(const DetailedTriangleId triangleId, const size_
 
         TriangleDetail* detail = getTriangleDetail(baseId);
         detail->setColor(detailId, newColor);
+        mDetailsToCompact.insert(baseId);
+        markColorRegionDirty(baseId);
 
-        if(!mOgl.isDirty) {
-            const size_t vertexPosition =
-                mTriangleDetailColorBufferStart[triangleId.getBaseId()] + 3 * (*triangleId.getDetailId());
-            ColorIndex newColorIndex = static_cast<ColorIndex>(newColor);
-            mOgl.colorBuffer[vertexPosition] = newColorIndex;
-            mOgl.colorBuffer[vertexPosition + 1] = newColorIndex;
-            mOgl.colorBuffer[vertexPosition + 2] = newColorIndex;
-            mOgl.info.didColorUpdate = true;
+        const DetailBufferSlot* slot = findDetailBufferSlot(baseId);
+        if(!mOglNeedsRebuild && slot != nullptr && detailId < slot->capacity) {
+            setColorBufferFace(slot->faceStart + detailId, newColor);
+        } else {
+            markDetailDirty(baseId);
         }
     } else {
         // No detail ID, do the baseID behavior
@@ -662,186 +1799,718 @@ void Geometry::setTriangleColor(const DetailedTriangleId triangleId, const size_
     }
 }
 
+void Geometry::compactTriangleDetails() {
+    // Details of a single color, by their color
+    std::map<size_t, size_t> uniformDetails;
+    for(const size_t triIdx : mDetailsToCompact) {
+        const CopyOnWrite<TriangleDetail>* detail = findTriangleDetail(triIdx);
+        if(detail == nullptr) {
+            continue;
+        }
+        const std::optional<size_t> color = (*detail)->getUniformColor();
+        if(color) {
+            uniformDetails.emplace(triIdx, *color);
+        }
+    }
+    mDetailsToCompact.clear();
+
+    if(uniformDetails.empty() || !mPolyhedronData.valid) {
+        return;
+    }
+
+    // A simple triangle has no vertices inside its edges. Detailed neighbours that stay must not share any.
+    // Keeping one detail can keep its neighbours, repeat until no more details are kept.
+    bool isKeptAny = true;
+    while(isKeptAny) {
+        isKeptAny = false;
+        for(auto it = uniformDetails.begin(); it != uniformDetails.end();) {
+            const TriangleDetail& detail = **findTriangleDetail(it->first);
+            bool isKept = false;
+            for(const int neighbour : gatherNeighbours(it->first)) {
+                const size_t neighbourIdx = static_cast<size_t>(neighbour);
+                if(neighbour < 0 || isSimpleTriangle(neighbourIdx) || uniformDetails.count(neighbourIdx) > 0) {
+                    continue;
+                }
+                if(detail.hasPointsInsideSharedEdge(**findTriangleDetail(neighbourIdx))) {
+                    isKept = true;
+                    break;
+                }
+            }
+
+            if(isKept) {
+                it = uniformDetails.erase(it);
+                isKeptAny = true;
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    for(const auto& uniformDetail : uniformDetails) {
+        setTriangleColor(uniformDetail.first, uniformDetail.second);
+    }
+
+    if(!uniformDetails.empty()) {
+        CI_LOG_I("Replaced " + std::to_string(uniformDetails.size()) + " triangle details of a single color");
+    }
+}
+
 void Geometry::buildPolyhedron() {
+    const Profiler::ScopedTimer timer(Profiler::Zone::MeshRebuild);
+    mSdfRefinement.reset();
+    invalidateSegmentations();
     mProgress->polyhedronPercentage = 0.0f;
-    mPolyhedronData.mMesh.clear();
-    mPolyhedronData.mMesh.remove_property_map(mPolyhedronData.mIdMap);
-    mPolyhedronData.mMesh.remove_property_map(mPolyhedronData.sdf_property_map);
+    mPolyhedronData.sdfValues.clear();
     mPolyhedronData.isSdfComputed = false;
     mPolyhedronData.valid = false;
-    mPolyhedronData.mFaceDescs.clear();
-
-    std::vector<PolyhedronData::vertex_descriptor> vertDescs;
-    vertDescs.reserve(mPolyhedronData.vertices.size());
-    mPolyhedronData.mMesh.reserve(static_cast<PolyhedronData::Mesh::size_type>(mPolyhedronData.vertices.size()),
-                                  static_cast<PolyhedronData::Mesh::size_type>(mPolyhedronData.indices.size() * 3 / 2),
-                                  static_cast<PolyhedronData::Mesh::size_type>(mPolyhedronData.indices.size()));
+    mPolyhedronData.faceNeighbours.clear();
+    mPolyhedronData.faceNeighbourCosines.clear();
+    invalidateTemporaryDetailedData();
 
-    for(const auto& vertex : mPolyhedronData.vertices) {
-        PolyhedronData::vertex_descriptor v =
-            mPolyhedronData.mMesh.add_vertex(DataTriangle::Point(vertex.x, vertex.y, vertex.z));
-        vertDescs.push_back(v);
+    // Manifold meshes are built in bulk, others face by face, so that CGAL handles or refuses them as usual.
+    // The mesh is only needed for the neighbours, it is released once they are known.
+    PolyhedronData::Mesh mesh;
+    std::vector<PolyhedronData::face_descriptor> faceDescs;
+    bool meshHasNull = false;
+    SurfaceMeshBuilder<PolyhedronData::Mesh> bulkBuilder(mPolyhedronData.vertices, mPolyhedronData.indices);
+    if(!mPolyhedronData.faceAdjacency.empty()) {
+        bulkBuilder.setFaceAdjacency(std::move(mPolyhedronData.faceAdjacency));
     }
+    mPolyhedronData.faceAdjacency.clear();
+    if(bulkBuilder.build(mesh, getThreadPool())) {
+        mPolyhedronData.faceAdjacency = bulkBuilder.getFaceAdjacency();
+        faceDescs.reserve(mPolyhedronData.indices.size());
+        for(size_t faceIdx = 0; faceIdx < mPolyhedronData.indices.size(); ++faceIdx) {
+            faceDescs.emplace_back(static_cast<PolyhedronData::Mesh::size_type>(faceIdx));
+        }
+    } else {
+        std::vector<PolyhedronData::vertex_descriptor> vertDescs;
+        vertDescs.reserve(mPolyhedronData.vertices.size());
+        mesh.reserve(
+            static_cast<PolyhedronData::Mesh::size_type>(mPolyhedronData.vertices.size()),
+            static_cast<PolyhedronData::Mesh::size_type>(mPolyhedronData.indices.size() * 3 / 2),
+            static_cast<PolyhedronData::Mesh::size_type>(mPolyhedronData.indices.size()));
+
+        for(const auto& vertex : mPolyhedronData.vertices) {
+            PolyhedronData::vertex_descriptor v = mesh.add_vertex(DataTriangle::Point(vertex.x, vertex.y, vertex.z));
+            vertDescs.push_back(v);
+        }
 
-    mPolyhedronData.mFaceDescs.reserve(mPolyhedronData.indices.size());
-    bool meshHasNull = false;
-    for(const auto& tri : mPolyhedronData.indices) {
-        auto f = mPolyhedronData.mMesh.add_face(vertDescs[tri[0]], vertDescs[tri[1]], vertDescs[tri[2]]);
-        if(f == PolyhedronData::Mesh::null_face()) {
-            // Adding a non-valid face, the model is wrong and we stop.
-            meshHasNull = true;
-            break;
-        } else {
-            P_ASSERT(f != PolyhedronData::Mesh::null_face());
-            mPolyhedronData.mFaceDescs.push_back(f);
+        faceDescs.reserve(mPolyhedronData.indices.size());
+        for(const auto& tri : mPolyhedronData.indices) {
+            auto f = mesh.add_face(vertDescs[tri[0]], vertDescs[tri[1]], vertDescs[tri[2]]);
+            if(f == PolyhedronData::Mesh::null_face()) {
+                // Adding a non-valid face, the model is wrong and we stop.
+                meshHasNull = true;
+                break;
+            } else {
+                P_ASSERT(f != PolyhedronData::Mesh::null_face());
+                faceDescs.push_back(f);
+            }
         }
     }
     // If the build failed, clear, set invalid and exit;
     if(meshHasNull) {
-        mPolyhedronData.mMesh.clear();
         mPolyhedronData.valid = false;
         mProgress->polyhedronPercentage = -1.0f;
+        mLoadedSdfValues.clear();
         return;
     }
 
-    bool created;
-    boost::tie(mPolyhedronData.mIdMap, created) =
-        mPolyhedronData.mMesh.add_property_map<PolyhedronData::face_descriptor, size_t>(
-            "f:idOfEachTriangle", std::numeric_limits<size_t>::max() - 1);
-    P_ASSERT(created);
-
-    // Add the IDs
-    size_t i = 0;
-    for(const PolyhedronData::face_descriptor& face : mPolyhedronData.mFaceDescs) {
-        mPolyhedronData.mIdMap[face] = i;
-        ++i;
-    }
+    computeFaceNeighbours(mesh, faceDescs);
     CI_LOG_I("Polyhedral mesh built, vertices: " + std::to_string(mPolyhedronData.vertices.size()) +
              ", faces: " + std::to_string(mPolyhedronData.indices.size()));
     mPolyhedronData.valid = true;
+    restoreLoadedSdfValues();
     mProgress->polyhedronPercentage = 1.0f;
 }
 
-void Geometry::buildDetailedTree() {
-    mTreeDetailed = std::make_unique<Tree>();
+void Geometry::restoreLoadedSdfValues() {
+    if(mLoadedSdfValues.empty()) {
+        return;
+    }
+    if(mLoadedSdfValues.size() == mPolyhedronData.indices.size()) {
+        mPolyhedronData.sdfValues = std::move(mLoadedSdfValues);
+        mPolyhedronData.isSdfComputed = true;
+        mPolyhedronData.sdfValuesValid = true;
+        mProgress->sdfPercentage = 1.0f;
 
-    for(size_t triangleIdx = 0; triangleIdx < mTriangles.size(); triangleIdx++) {
-        if(isSimpleTriangle(triangleIdx)) {
-            // Insert Original triangle
-            mTreeDetailed->insert(DataTriangleAABBPrimitive(this, DetailedTriangleId(triangleIdx)));
-        } else {
-            // Insert all detail triangles for this tri
-            const TriangleDetail* detail = getTriangleDetail(triangleIdx);
-            P_ASSERT(detail);
-            const auto& detailTriangles = detail->getTriangles();
-            for(size_t detailIdx = 0; detailIdx < detailTriangles.size(); detailIdx++) {
-                mTreeDetailed->insert(DataTriangleAABBPrimitive(this, DetailedTriangleId(triangleIdx, detailIdx)));
+        for(CachedSegmentation& segmentation : mLoadedSegmentations) {
+            if(segmentation.triangleSegments.size() == mTriangles.size()) {
+                mSegmentationCache.push_back(std::move(segmentation));
             }
         }
     }
-
-    mTreeDetailed->build();
+    mLoadedSdfValues.clear();
+    mLoadedSegmentations.clear();
 }
 
-void Geometry::buildDetailedMesh() {
-    if(!mPolyhedronData.valid) {
-        CI_LOG_E("Attempted to build detailed mesh when basic mash is not available");
-        return;
+Geometry::ProjectSnapshot Geometry::createProjectSnapshot() const {
+    // The exact kernel objects of TriangleDetail are not thread safe even for read-only access, and painting copies
+    // those of the details shared with the undo states. The snapshot is saved on a worker, so its details are lazy
+    // copies with their exact representation encoded here, see TriangleDetail::createLazyCopy().
+    std::map<size_t, CopyOnWrite<TriangleDetail>> triangleDetails;
+    for(const auto& slot : mTriangleDetailSlots) {
+        if(slot.second.detail) {
+            triangleDetails.emplace(slot.first, (*slot.second.detail)->createLazyCopy());
+        }
     }
 
-    mMeshDetailed = std::make_unique<PolyhedronData::Mesh>();
-    mMeshDetailedFaceDescs.clear();
-    mMeshDetailedIdMap.reset();
-    bool created;
-    boost::tie(mMeshDetailedIdMap, created) =
-        mMeshDetailed->add_property_map<PolyhedronData::face_descriptor, DetailedTriangleId>("f:idOfEachTriangle",
-                                                                                             DetailedTriangleId());
-    /**
-     *  Yes, we are about to hash floating point values.
-     *  These values come from CGAL exact kernel, so they should be bit-equal and safe to hash.
-     *  There is no betters way to get indices before this, as different color parts are stored in different polygons.
-     */
-    auto hashFunc = [](const glm::vec3& vec) {
-        return std::hash<float>{}(vec.x) ^ std::hash<float>{}(vec.y) ^ std::hash<float>{}(vec.z);
-    };
-
-    std::unordered_map<glm::vec3, PolyhedronData::vertex_descriptor, decltype(hashFunc)> ptToVertexDesc(
-        3 * mTriangles.size(), hashFunc);
-
-    P_ASSERT(created);
-    std::vector<PolyhedronData::vertex_descriptor> vertDescs;
-    vertDescs.reserve(mPolyhedronData.vertices.size());
+    return ProjectSnapshot{mColorManager,
+                           mTriangles,
+                           std::move(triangleDetails),
+                           mPolyhedronData.vertices,
+                           mPolyhedronData.indices,
+                           mPickingTree,
+                           mPolyhedronData.faceAdjacency,
+                           getSdfValuesToSave(),
+                           mSdfSettings,
+                           mSdfValuesSettings,
+                           mSegmentationCache};
+}
 
-    // Add original vertices
-    for(const auto& vertex : mPolyhedronData.vertices) {
-        PolyhedronData::vertex_descriptor v =
-            mMeshDetailed->add_vertex(DataTriangle::Point(vertex.x, vertex.y, vertex.z));
-        ptToVertexDesc[vertex] = v;
-        vertDescs.push_back(v);
+std::shared_ptr<const Geometry> Geometry::createExportSnapshot() const {
+    auto snapshot = std::make_shared<Geometry>();
+    snapshot->mTriangles = mTriangles;
+    snapshot->replaceTriangleDetails(copyTriangleDetails());
+    snapshot->mColorManager = mColorManager;
+    if(mBoundingBox != nullptr) {
+        snapshot->mBoundingBox = std::make_unique<BoundingBox>(*mBoundingBox);
     }
 
-    // Add original simple faces
-    for(size_t i = 0; i < mPolyhedronData.indices.size(); i++) {
-        const auto& tri = mPolyhedronData.indices[i];
+    // The connectivity takes as much memory as the export needs, nothing of it is read
+    snapshot->mPolyhedronData.vertices = mPolyhedronData.vertices;
+    snapshot->mPolyhedronData.indices = mPolyhedronData.indices;
+    snapshot->mPolyhedronData.sdfValues = mPolyhedronData.sdfValues;
+    snapshot->mPolyhedronData.isSdfComputed = mPolyhedronData.isSdfComputed;
+    snapshot->mPolyhedronData.sdfValuesValid = mPolyhedronData.sdfValuesValid;
+    snapshot->mPolyhedronData.valid = mPolyhedronData.valid;
+
+    if(mMeshDetailed != nullptr) {
+        snapshot->mMeshDetailed = std::make_unique<PolyhedronData::Mesh>(*mMeshDetailed);
+        bool found;
+        boost::tie(snapshot->mMeshDetailedIdMap, found) =
+            snapshot->mMeshDetailed->property_map<PolyhedronData::face_descriptor, DetailedTriangleId>(
+                "f:idOfEachTriangle");
+        P_ASSERT(found);
+        snapshot->mMeshDetailedFaceDescs = mMeshDetailedFaceDescs;
+        snapshot->mMeshDetailedVertexPositions = mMeshDetailedVertexPositions;
+        snapshot->mMeshDetailedDirty = mMeshDetailedDirty;
+        snapshot->mSharedVerticesDirty = mSharedVerticesDirty;
+        snapshot->mSharedVerticesNeedFullCorrection = mSharedVerticesNeedFullCorrection;
+        snapshot->mDetailedNormalsAndBorders = mDetailedNormalsAndBorders;
+    }
+    return snapshot;
+}
 
-        if(isSimpleTriangle(i)) {
-            auto f = mMeshDetailed->add_face(vertDescs[tri[0]], vertDescs[tri[1]], vertDescs[tri[2]]);
-            if(f == PolyhedronData::Mesh::null_face()) {
-                // Adding a non-valid face, the model is wrong and we stop.
-                mMeshDetailed.reset();
-                return;
-            } else {
-                P_ASSERT(f != PolyhedronData::Mesh::null_face());
-                mMeshDetailedFaceDescs[DetailedTriangleId(i)] = f;
-                mMeshDetailedIdMap[f] = DetailedTriangleId(i);
-            }
+void Geometry::loadProjectSnapshot(ProjectSnapshot&& snapshot) {
+    mColorManager = std::move(snapshot.colorManager);
+    mTriangles = std::move(snapshot.triangles);
+    replaceTriangleDetails(snapshot.triangleDetails);
+    mDetailPickingNeedsRebuild = true;
+    mPolyhedronData.vertices = std::move(snapshot.vertices);
+    mPolyhedronData.indices = std::move(snapshot.indices);
+    mSdfSettings = snapshot.sdfSettings;
+    mSdfValuesSettings = snapshot.sdfValuesSettings;
+
+    const bool isMatching = snapshot.derivedDataHash && *snapshot.derivedDataHash == computeDerivedDataHash() &&
+                            snapshot.pickingTree.size() == mTriangles.size();
+    if(isMatching) {
+        mPickingTree = std::move(snapshot.pickingTree);
+        mPolyhedronData.faceAdjacency = std::move(snapshot.faceAdjacency);
+        mLoadedSdfValues = std::move(snapshot.sdfValues);
+        mLoadedSegmentations = std::move(snapshot.segmentations);
+    } else {
+        if(snapshot.derivedDataHash) {
+            CI_LOG_W("Derived data does not match the geometry of the project, it will be recomputed.");
         }
+        mPickingTree.clear();
+        mPolyhedronData.faceAdjacency.clear();
+        mLoadedSdfValues.clear();
+        mLoadedSegmentations.clear();
     }
+    mIsPickingTreeLoaded = isMatching;
 
-    // Add detailed faces
-    for(const auto& triDetailIt : mTriangleDetails) {
-        const size_t triangleId = triDetailIt.first;
-        const auto& detailTriangles = triDetailIt.second.getTriangles();
+    // Reset progress
+    mProgress->resetLoad();
+    mProgress->importRenderPercentage = 1.0f;
+    mProgress->importComputePercentage = 1.0f;
 
-        // Add detail triangles while combining common vertices
-        for(size_t detailTriangleIdx = 0; detailTriangleIdx < detailTriangles.size(); detailTriangleIdx++) {
-            const DataTriangle& detail = detailTriangles[detailTriangleIdx];
+    // Shared vertices and the detailed mesh wait until a tool needs them
+    invalidateTemporaryDetailedData();
 
-            P_ASSERT(!detail.getTri().is_degenerate());
+    P_ASSERT(!mTriangles.empty());
+    P_ASSERT(!mColorManager.empty());
+    P_ASSERT(!mPolyhedronData.vertices.empty());
+    P_ASSERT(!mPolyhedronData.indices.empty());
+}
 
-            // Vertex descriptors of current detail triangle
-            std::array<PolyhedronData::vertex_descriptor, 3> vertDescriptors;
+std::vector<double> Geometry::getSdfValuesToSave() const {
+    if(isSdfComputed() && mPolyhedronData.sdfValuesValid) {
+        return mPolyhedronData.sdfValues;
+    }
+    return {};
+}
 
-            for(int i = 0; i < 3; i++) {
-                // Get iterator to vertex ID for current vertex
-                auto it = ptToVertexDesc.find(detail.getVertex(i));
-                if(it == ptToVertexDesc.end()) {
-                    auto vertexDesc = mMeshDetailed->add_vertex(detail.getTri().vertex(i));
-                    P_ASSERT(vertexDesc != PolyhedronData::Mesh::null_vertex());
-                    it = ptToVertexDesc.insert(std::make_pair(detail.getVertex(i), vertexDesc)).first;
-                }
+uint64_t Geometry::computeDerivedDataHash(const std::vector<glm::vec3>& triangleVertices,
+                                          const std::vector<glm::vec3>& vertices,
+                                          const std::vector<std::array<size_t, 3>>& indices) {
+    // FNV-1a over 64-bit words, fast enough for large meshes and only used to detect mismatching data
+    uint64_t hash = 14695981039346656037ull;
+    const auto addBytes = [&hash](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for(; size >= sizeof(uint64_t); size -= sizeof(uint64_t), bytes += sizeof(uint64_t)) {
+            uint64_t word;
+            std::memcpy(&word, bytes, sizeof(uint64_t));
+            hash = (hash ^ word) * 1099511628211ull;
+        }
+        for(; size > 0; --size, ++bytes) {
+            hash = (hash ^ *bytes) * 1099511628211ull;
+        }
+    };
 
-                vertDescriptors[i] = it->second;
-            }
+    const uint64_t sizes[] = {triangleVertices.size(), vertices.size(), indices.size()};
+    addBytes(sizes, sizeof(sizes));
+    addBytes(triangleVertices.data(), triangleVertices.size() * sizeof(glm::vec3));
+    addBytes(vertices.data(), vertices.size() * sizeof(glm::vec3));
+    addBytes(indices.data(), indices.size() * sizeof(std::array<size_t, 3>));
+    return hash;
+}
 
-            auto faceDesc = mMeshDetailed->add_face(vertDescriptors);
-            P_ASSERT(faceDesc != PolyhedronData::Mesh::null_face());
-            if(faceDesc != PolyhedronData::Mesh::null_face()) {
-                mMeshDetailedFaceDescs.insert(
-                    std::make_pair(DetailedTriangleId(triangleId, detailTriangleIdx), faceDesc));
-                mMeshDetailedIdMap[faceDesc] = DetailedTriangleId(triangleId, detailTriangleIdx);
-            } else {
-                const double sqrdArea = detail.getTri().squared_area();
-                CI_LOG_E("A null face was generated in the detailed mesh. This should not happen");
-                CI_LOG_E(std::to_string(sqrdArea));
+void Geometry::updateDetailPicking() {
+    if(mDetailPickingDirty.empty() && !mDetailPickingNeedsRebuild) {
+        return;
+    }
+    const Profiler::ScopedTimer timer(Profiler::Zone::TreeRebuild);
+
+    if(mDetailPickingNeedsRebuild) {
+        mDetailPicking.clear();
+        mDetailPickingDirty.clear();
+        for(const auto& slot : mTriangleDetailSlots) {
+            if(slot.second.detail) {
+                mDetailPickingDirty.insert(slot.first);
+            }
+        }
+        mDetailPickingNeedsRebuild = false;
+    }
+
+    // The map is changed on this thread, the pickings of the details are then filled in parallel
+    std::vector<std::pair<size_t, DetailPicking*>> dirtyPickings;
+    for(const size_t triangleIdx : mDetailPickingDirty) {
+        mDetailPicking.erase(triangleIdx);
+        if(findTriangleDetail(triangleIdx) != nullptr) {
+            dirtyPickings.emplace_back(triangleIdx, &mDetailPicking[triangleIdx]);
+        }
+    }
+
+    // Plain vertices of the details can be read from several threads, unlike their CGAL triangles.
+    // Read-only access, does not unshare the details from undo snapshots.
+    getThreadPool().parallel_for_weighted(
+        dirtyPickings.begin(), dirtyPickings.end(),
+        [this](const std::pair<size_t, DetailPicking*>& dirtyPicking) {
+            const size_t triangleIdx = dirtyPicking.first;
+            dirtyPicking.second->build(
+                (*findTriangleDetail(triangleIdx))->getVertices(),
+                {mTriangles.getVertex(triangleIdx, 0), mTriangles.getVertex(triangleIdx, 1),
+                 mTriangles.getVertex(triangleIdx, 2)});
+        },
+        [this](const std::pair<size_t, DetailPicking*>& dirtyPicking) {
+            return (*findTriangleDetail(dirtyPicking.first))->getVertices().size();
+        });
+    mDetailPickingDirty.clear();
+}
+
+void Geometry::DetailPicking::build(std::vector<glm::vec3> detailVertices,
+                                    const std::array<glm::vec3, 3>& baseVertices) {
+    vertices = std::move(detailVertices);
+    origin = baseVertices[0];
+    axisX = glm::normalize(baseVertices[1] - baseVertices[0]);
+    axisY = glm::normalize(glm::cross(glm::cross(axisX, baseVertices[2] - baseVertices[0]), axisX));
+
+    points.clear();
+    points.reserve(vertices.size());
+    glm::vec2 gridMax(std::numeric_limits<float>::lowest());
+    gridMin = glm::vec2(std::numeric_limits<float>::max());
+    for(const glm::vec3& vertex : vertices) {
+        const glm::vec3 offset = vertex - origin;
+        points.emplace_back(glm::dot(offset, axisX), glm::dot(offset, axisY));
+        gridMin = glm::min(gridMin, points.back());
+        gridMax = glm::max(gridMax, points.back());
+    }
+
+    const size_t triangleCount = points.size() / 3;
+    gridSize = static_cast<uint32_t>(std::clamp(
+        std::ceil(std::sqrt(static_cast<double>(triangleCount) / DETAIL_PICKING_TRIANGLES_PER_CELL)), 1.0, 256.0));
+    cellSize = glm::max((gridMax - gridMin) / static_cast<float>(gridSize), glm::vec2(1e-20f));
+
+    // Cells overlapped by the bounds of each triangle, counted first and then filled
+    const auto getCellRange = [this](const size_t triangleIdx) {
+        glm::vec2 min = points[3 * triangleIdx];
+        glm::vec2 max = min;
+        for(size_t i = 1; i < 3; ++i) {
+            min = glm::min(min, points[3 * triangleIdx + i]);
+            max = glm::max(max, points[3 * triangleIdx + i]);
+        }
+        const glm::ivec2 limit(static_cast<int>(gridSize) - 1);
+        return std::make_pair(glm::clamp(glm::ivec2(glm::floor((min - gridMin) / cellSize)), glm::ivec2(0), limit),
+                              glm::clamp(glm::ivec2(glm::floor((max - gridMin) / cellSize)), glm::ivec2(0), limit));
+    };
+    cellStarts.assign(gridSize * gridSize + 1, 0);
+    for(size_t triangleIdx = 0; triangleIdx < triangleCount; ++triangleIdx) {
+        const auto range = getCellRange(triangleIdx);
+        for(int y = range.first.y; y <= range.second.y; ++y) {
+            for(int x = range.first.x; x <= range.second.x; ++x) {
+                ++cellStarts[y * gridSize + x + 1];
+            }
+        }
+    }
+    std::partial_sum(cellStarts.begin(), cellStarts.end(), cellStarts.begin());
+    cellTriangles.resize(cellStarts.back());
+    std::vector<uint32_t> cellEnds(cellStarts.begin(), cellStarts.end() - 1);
+    for(size_t triangleIdx = 0; triangleIdx < triangleCount; ++triangleIdx) {
+        const auto range = getCellRange(triangleIdx);
+        for(int y = range.first.y; y <= range.second.y; ++y) {
+            for(int x = range.first.x; x <= range.second.x; ++x) {
+                cellTriangles[cellEnds[y * gridSize + x]++] = static_cast<uint32_t>(triangleIdx);
+            }
+        }
+    }
+}
+
+std::optional<size_t> Geometry::DetailPicking::locate(const glm::vec3& point) const {
+    if(gridSize == 0) {
+        return {};
+    }
+    const glm::vec3 offset = point - origin;
+    const glm::dvec2 location(glm::dot(offset, axisX), glm::dot(offset, axisY));
+    const glm::ivec2 cell = glm::clamp(glm::ivec2(glm::floor((glm::vec2(location) - gridMin) / cellSize)),
+                                       glm::ivec2(0), glm::ivec2(static_cast<int>(gridSize) - 1));
+    const size_t cellIdx = cell.y * gridSize + cell.x;
+
+    // Twice the signed area of the triangle (a, b, p)
+    const auto orientation = [](const glm::dvec2& a, const glm::dvec2& b, const glm::dvec2& p) {
+        return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+    };
+    for(uint32_t i = cellStarts[cellIdx]; i < cellStarts[cellIdx + 1]; ++i) {
+        const size_t triangleIdx = cellTriangles[i];
+        const glm::dvec2 a = points[3 * triangleIdx];
+        const glm::dvec2 b = points[3 * triangleIdx + 1];
+        const glm::dvec2 c = points[3 * triangleIdx + 2];
+
+        // Points on the edges are inside, whatever the orientation of the triangle
+        const double area = orientation(a, b, c);
+        const double tolerance = 1e-6 * std::abs(area);
+        const double sign = area < 0. ? -1. : 1.;
+        if(sign * orientation(a, b, location) >= -tolerance && sign * orientation(b, c, location) >= -tolerance &&
+           sign * orientation(c, a, location) >= -tolerance) {
+            return triangleIdx;
+        }
+    }
+    return {};
+}
+
+size_t Geometry::DetailPicking::getApproximateMemorySize() const {
+    return getVectorMemorySize(vertices) + getVectorMemorySize(points) + getVectorMemorySize(cellStarts) +
+           getVectorMemorySize(cellTriangles);
+}
+
+size_t Geometry::intersectDetail(const size_t triangleIdx, const glm::vec3& hitPoint) const {
+    const DetailPicking& picking = mDetailPicking.at(triangleIdx);
+    const size_t detailCount = picking.vertices.size() / 3;
+    P_ASSERT(detailCount == getTriangleDetailCount(triangleIdx));
+    P_ASSERT(detailCount > 0);
+
+    const std::optional<size_t> detailIdx = picking.locate(hitPoint);
+    if(detailIdx) {
+        return *detailIdx;
+    }
+
+    // The base triangle was hit, but float rounding of the detail vertices left a gap.
+    // Take the detail triangle with the closest centroid.
+    size_t closestIdx = 0;
+    float closestDistance = std::numeric_limits<float>::max();
+    for(size_t detailIdx = 0; detailIdx < detailCount; ++detailIdx) {
+        const glm::vec3 centroid = (picking.vertices[3 * detailIdx] + picking.vertices[3 * detailIdx + 1] +
+                                    picking.vertices[3 * detailIdx + 2]) /
+                                   3.f;
+        const float distance = glm::distance(centroid, hitPoint);
+        if(distance < closestDistance) {
+            closestDistance = distance;
+            closestIdx = detailIdx;
+        }
+    }
+    return closestIdx;
+}
+
+void Geometry::buildDetailedMesh(const std::atomic<bool>* isCancelled) {
+    if(!mPolyhedronData.valid) {
+        CI_LOG_E("Attempted to build detailed mesh when basic mash is not available");
+        return;
+    }
+
+    if(mMeshDetailed) {
+        if(patchDetailedMesh()) {
+            mMeshDetailedDirty.clear();
+            return;
+        }
+        CI_LOG_W("Patching the detailed mesh failed, building it from scratch");
+    }
+
+    mMeshDetailed = std::make_unique<PolyhedronData::Mesh>();
+    mMeshDetailedFaceDescs.clear();
+    mColorRegions.clear();
+    mDetailedNormalsAndBorders.clear();
+    mMeshDetailedIdMap.reset();
+    mMeshDetailedVertexDescs.clear();
+    mMeshDetailedVertexDescs.reserve(3 * mTriangles.size());
+    mMeshDetailedVertexPositions.clear();
+    mMeshDetailedDirty.clear();
+    bool created;
+    boost::tie(mMeshDetailedIdMap, created) =
+        mMeshDetailed->add_property_map<PolyhedronData::face_descriptor, DetailedTriangleId>("f:idOfEachTriangle",
+                                                                                             DetailedTriangleId());
+    P_ASSERT(created);
+
+    // Corners of the original vertices and of all detail triangles. The details export plain floats,
+    // so the corners are gathered and welded in parallel, only the mesh itself is built on a single thread.
+    // The details are added by their base triangle, so that the mesh does not depend on the order of the slots
+    std::vector<std::pair<size_t, const TriangleDetail*>> sortedDetails;
+    for(const auto& slot : mTriangleDetailSlots) {
+        if(slot.second.detail) {
+            sortedDetails.emplace_back(slot.first, &**slot.second.detail);
+        }
+    }
+    std::sort(sortedDetails.begin(), sortedDetails.end());
+    std::vector<const TriangleDetail*> details;
+    std::vector<size_t> detailCornerStarts;
+    size_t cornerCount = mPolyhedronData.vertices.size();
+    for(const auto& detailIt : sortedDetails) {
+        details.push_back(detailIt.second);
+        detailCornerStarts.push_back(cornerCount);
+        cornerCount += detailIt.second->getVertices().size();
+    }
+    std::vector<glm::vec3> corners(cornerCount);
+    std::copy(mPolyhedronData.vertices.begin(), mPolyhedronData.vertices.end(), corners.begin());
+    std::vector<size_t> detailIds(details.size());
+    std::iota(detailIds.begin(), detailIds.end(), 0);
+    ::ThreadPool& threadPool = getThreadPool();
+    threadPool.parallel_for(detailIds.begin(), detailIds.end(), [&](const size_t detailId) {
+        const std::vector<glm::vec3>& vertices = details[detailId]->getVertices();
+        std::copy(vertices.begin(), vertices.end(), corners.begin() + detailCornerStarts[detailId]);
+    });
+    const VertexWelder welder(corners, threadPool);
+
+    // The welded vertices keep the order of their first corner, the same order as adding them one by one
+    std::vector<PolyhedronData::vertex_descriptor> weldedVertexDescs;
+    weldedVertexDescs.reserve(welder.getVertices().size());
+    for(const glm::vec3& vertex : welder.getVertices()) {
+        weldedVertexDescs.push_back(getDetailedMeshVertex(vertex, DataTriangle::Point(vertex.x, vertex.y, vertex.z)));
+    }
+    const auto getCornerVertex = [&](const size_t cornerIdx) {
+        return weldedVertexDescs[welder.getIndices()[cornerIdx]];
+    };
+
+    // Add original simple faces, then the detailed faces
+    for(size_t i = 0; i < mPolyhedronData.indices.size(); i++) {
+        const auto& tri = mPolyhedronData.indices[i];
+        if(isSimpleTriangle(i) &&
+           !addDetailedMeshFace(DetailedTriangleId(i),
+                                {getCornerVertex(tri[0]), getCornerVertex(tri[1]), getCornerVertex(tri[2])})) {
+            // Adding a non-valid face, the model is wrong and we stop.
+            mMeshDetailed.reset();
+            return;
+        }
+    }
+    size_t detailId = 0;
+    for(const auto& detailIt : sortedDetails) {
+        const size_t detailTriangleCount = detailIt.second->getTriangles().size();
+        for(size_t detailTriangleIdx = 0; detailTriangleIdx < detailTriangleCount; ++detailTriangleIdx) {
+            const size_t firstCorner = detailCornerStarts[detailId] + 3 * detailTriangleIdx;
+            const DetailedTriangleId triangleId(detailIt.first, detailTriangleIdx);
+            if(!addDetailedMeshFace(triangleId, {getCornerVertex(firstCorner), getCornerVertex(firstCorner + 1),
+                                                 getCornerVertex(firstCorner + 2)})) {
                 mMeshDetailed.reset();
                 return;
             }
         }
+        ++detailId;
+        if(isCancelled != nullptr && *isCancelled) {
+            CI_LOG_I("Building the detailed mesh was cancelled");
+            mMeshDetailed.reset();
+            return;
+        }
+    }
+#ifdef PEPR3D_COLLECT_DEBUG_DATA
+    logVertexWeldingStatistics();
+#endif
+}
+
+#ifdef PEPR3D_COLLECT_DEBUG_DATA
+void Geometry::logVertexWeldingStatistics() const {
+    const auto& vertexDescs = mMeshDetailedVertexDescs;
+    if(vertexDescs.empty()) {
+        return;
+    }
+
+    // Each lookup of a present vertex compares the keys before it in its bucket and the key itself
+    size_t collidingVertices = 0;
+    size_t longestChain = 0;
+    size_t totalProbes = 0;
+    for(size_t bucket = 0; bucket < vertexDescs.bucket_count(); ++bucket) {
+        const size_t chain = vertexDescs.bucket_size(bucket);
+        collidingVertices += chain > 1 ? chain - 1 : 0;
+        longestChain = std::max(longestChain, chain);
+        totalProbes += chain * (chain + 1) / 2;
+    }
+    const double averageProbes = static_cast<double>(totalProbes) / static_cast<double>(vertexDescs.size());
+    CI_LOG_D("Detailed mesh vertex welding: " + std::to_string(vertexDescs.size()) + " vertices in " +
+             std::to_string(vertexDescs.bucket_count()) + " buckets, " + std::to_string(collidingVertices) +
+             " colliding, longest chain " + std::to_string(longestChain) + ", average probes " +
+             std::to_string(averageProbes));
+}
+#endif
+
+bool Geometry::patchDetailedMesh() {
+    P_ASSERT(mMeshDetailed);
+    // Remove all changed faces first, so that the new faces of neighbouring details fit together
+    for(const size_t triangleIdx : mMeshDetailedDirty) {
+        removeDetailedMeshFaces(triangleIdx);
+    }
+    for(const size_t triangleIdx : mMeshDetailedDirty) {
+        if(!addDetailedMeshFaces(triangleIdx)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Geometry::addDetailedMeshFaces(const size_t triangleIdx) {
+    if(isSimpleTriangle(triangleIdx)) {
+        const auto& tri = mPolyhedronData.indices[triangleIdx];
+        std::array<PolyhedronData::vertex_descriptor, 3> vertDescriptors;
+        for(int i = 0; i < 3; i++) {
+            const glm::vec3& vertex = mPolyhedronData.vertices[tri[i]];
+            vertDescriptors[i] = getDetailedMeshVertex(vertex, DataTriangle::Point(vertex.x, vertex.y, vertex.z));
+        }
+        return addDetailedMeshFace(DetailedTriangleId(triangleIdx), vertDescriptors);
+    }
+
+    // Add detail triangles while combining common vertices
+    const std::vector<glm::vec3>& detailVertices = (*findTriangleDetail(triangleIdx))->getVertices();
+    for(size_t detailTriangleIdx = 0; 3 * detailTriangleIdx < detailVertices.size(); detailTriangleIdx++) {
+        // Vertex descriptors of current detail triangle
+        std::array<PolyhedronData::vertex_descriptor, 3> vertDescriptors;
+        for(size_t i = 0; i < 3; i++) {
+            const glm::vec3& vertex = detailVertices[3 * detailTriangleIdx + i];
+            vertDescriptors[i] = getDetailedMeshVertex(vertex, DataTriangle::Point(vertex.x, vertex.y, vertex.z));
+        }
+        if(!addDetailedMeshFace(DetailedTriangleId(triangleIdx, detailTriangleIdx), vertDescriptors)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Geometry::addDetailedMeshFace(const DetailedTriangleId triangleId,
+                                   const std::array<PolyhedronData::vertex_descriptor, 3>& vertDescriptors) {
+    const PolyhedronData::face_descriptor faceDesc = mMeshDetailed->add_face(vertDescriptors);
+    // Detail triangles are not degenerate and fit together, only the original triangles may be wrong
+    P_ASSERT(!triangleId.getDetailId() || faceDesc != PolyhedronData::Mesh::null_face());
+    if(faceDesc == PolyhedronData::Mesh::null_face()) {
+        if(triangleId.getDetailId()) {
+            CI_LOG_E("A null face was generated in the detailed mesh. This should not happen");
+        }
+        return false;
+    }
+    mMeshDetailedFaceDescs[triangleId] = faceDesc;
+    mMeshDetailedIdMap[faceDesc] = triangleId;
+    return true;
+}
+
+std::vector<PolyhedronData::face_descriptor> Geometry::getDetailedMeshFaces(const size_t triangleIdx) const {
+    std::vector<PolyhedronData::face_descriptor> faces;
+    const auto simpleIt = mMeshDetailedFaceDescs.find(DetailedTriangleId(triangleIdx));
+    if(simpleIt != mMeshDetailedFaceDescs.end()) {
+        faces.push_back(simpleIt->second);
+    }
+    for(size_t detailTriangleIdx = 0;; ++detailTriangleIdx) {
+        const auto detailIt = mMeshDetailedFaceDescs.find(DetailedTriangleId(triangleIdx, detailTriangleIdx));
+        if(detailIt == mMeshDetailedFaceDescs.end()) {
+            break;
+        }
+        faces.push_back(detailIt->second);
+    }
+    return faces;
+}
+
+void Geometry::removeDetailedMeshFaces(const size_t triangleIdx) {
+    const std::vector<PolyhedronData::face_descriptor> faces = getDetailedMeshFaces(triangleIdx);
+    mMeshDetailedFaceDescs.erase(DetailedTriangleId(triangleIdx));
+    for(size_t detailTriangleIdx = 0; detailTriangleIdx < faces.size(); ++detailTriangleIdx) {
+        mMeshDetailedFaceDescs.erase(DetailedTriangleId(triangleIdx, detailTriangleIdx));
+    }
+
+    // Face indices get reused by new faces, their regions are labelled again
+    auto& faceRegions = mColorRegions.faceRegions;
+    for(const PolyhedronData::face_descriptor face : faces) {
+        const size_t faceIdx = static_cast<size_t>(face);
+        if(faceIdx < faceRegions.size() && faceRegions[faceIdx] != ColorRegions::NO_REGION) {
+            mColorRegions.brokenRegions.push_back(faceRegions[faceIdx]);
+            faceRegions[faceIdx] = ColorRegions::NO_REGION;
+        }
+    }
+
+    // Vertices and neighbours that stay get their normals and color borders updated again
+    const bool hasNormalsAndBorders = mDetailedNormalsAndBorders.isValid;
+    std::vector<PolyhedronData::vertex_descriptor> faceVertices;
+    faceVertices.reserve(3 * faces.size());
+    for(const PolyhedronData::face_descriptor face : faces) {
+        for(const PolyhedronData::halfedge_descriptor halfedge :
+            CGAL::halfedges_around_face(mMeshDetailed->halfedge(face), *mMeshDetailed)) {
+            faceVertices.push_back(mMeshDetailed->target(halfedge));
+            const PolyhedronData::halfedge_descriptor opposite = mMeshDetailed->opposite(halfedge);
+            if(hasNormalsAndBorders && !mMeshDetailed->is_border(opposite)) {
+                mDetailedNormalsAndBorders.dirtyFaces.push_back(mMeshDetailed->face(opposite));
+            }
+        }
+        if(hasNormalsAndBorders) {
+            mDetailedNormalsAndBorders.dirtyVertices.insert(mDetailedNormalsAndBorders.dirtyVertices.end(),
+                                                            faceVertices.end() - 3, faceVertices.end());
+        }
+        // Removes the edges and vertices left without faces as well
+        CGAL::Euler::remove_face(mMeshDetailed->halfedge(face), *mMeshDetailed);
+    }
+
+    // Removed vertices get reused by new vertices, they cannot be found by their position anymore
+    for(const PolyhedronData::vertex_descriptor vertex : faceVertices) {
+        if(mMeshDetailed->is_removed(vertex)) {
+            const auto it = mMeshDetailedVertexDescs.find(mMeshDetailedVertexPositions[static_cast<size_t>(vertex)]);
+            if(it != mMeshDetailedVertexDescs.end() && it->second == vertex) {
+                mMeshDetailedVertexDescs.erase(it);
+            }
+        }
     }
 }
 
+PolyhedronData::vertex_descriptor Geometry::getDetailedMeshVertex(const glm::vec3& position,
+                                                                  const DataTriangle::Point& point) {
+    auto it = mMeshDetailedVertexDescs.find(position);
+    if(it == mMeshDetailedVertexDescs.end()) {
+        const PolyhedronData::vertex_descriptor vertexDesc = mMeshDetailed->add_vertex(point);
+        P_ASSERT(vertexDesc != PolyhedronData::Mesh::null_vertex());
+        if(static_cast<size_t>(vertexDesc) >= mMeshDetailedVertexPositions.size()) {
+            mMeshDetailedVertexPositions.resize(static_cast<size_t>(vertexDesc) + 1);
+        }
+        mMeshDetailedVertexPositions[static_cast<size_t>(vertexDesc)] = position;
+        it = mMeshDetailedVertexDescs.insert(std::make_pair(position, vertexDesc)).first;
+    }
+    return it->second;
+}
+
 void Geometry::correctSharedVertices() {
+    if(!needsSharedVertexCorrection()) {
+        return;
+    }
     if(!mPolyhedronData.valid) {
         CI_LOG_E("Cannot correct shared vertices when original polyhedron is unavailable");
         return;
@@ -855,216 +2524,623 @@ void Geometry::correctSharedVertices() {
     // This can be done in parallel
     std::set<size_t> detailsToTriangulate;
 
-    const auto& mesh = mPolyhedronData.mMesh;
-
-    for(const PolyhedronData::edge_descriptor edge : mesh.edges()) {
-        const auto firstHalfEdge = mesh.halfedge(edge, 0);
-        const auto secondHalfEdge = mesh.halfedge(edge, 1);
-
-        if(firstHalfEdge == PolyhedronData::Mesh::null_halfedge() ||
-           secondHalfEdge == PolyhedronData::Mesh::null_halfedge()) {
-            continue;
+    // Only edges of detailed triangles can need a correction, each of them is corrected once.
+    // Edges between unchanged triangles were already corrected by the previous update.
+    std::vector<std::pair<size_t, size_t>> edges;
+    const auto addEdgesOf = [&edges, this](const size_t triIdx) {
+        for(const uint32_t neighbour : mPolyhedronData.faceNeighbours[triIdx]) {
+            if(neighbour != PolyhedronData::NO_NEIGHBOUR) {
+                edges.emplace_back(std::min<size_t>(triIdx, neighbour), std::max<size_t>(triIdx, neighbour));
+            }
         }
-
-        const auto firstFace = mesh.face(firstHalfEdge);
-        const auto secondFace = mesh.face(secondHalfEdge);
-        if(firstFace == PolyhedronData::Mesh::null_face() || secondFace == PolyhedronData::Mesh::null_face()) {
+    };
+    if(mSharedVerticesNeedFullCorrection) {
+        for(const auto& slot : mTriangleDetailSlots) {
+            if(slot.second.detail) {
+                addEdgesOf(slot.first);
+            }
+        }
+    } else {
+        for(const size_t triIdx : mSharedVerticesDirty) {
+            addEdgesOf(triIdx);
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    // Pairs of neighbouring triangles to correct, at least one of them has a TriangleDetail
+    std::vector<std::pair<size_t, size_t>> trianglePairs;
+    std::vector<std::pair<TriangleDetail*, TriangleDetail*>> detailPairs;
+    std::set<size_t> createdDetails;
+    for(const auto& [firstTriIdx, secondTriIdx] : edges) {
+        if(isUndecodedEdgeMatching(firstTriIdx, secondTriIdx)) {
             continue;
         }
+        if(!isSimpleTriangle(firstTriIdx) || !isSimpleTriangle(secondTriIdx)) {
+            // Create the missing detail here, the map of details must not change while correcting in parallel
+            for(const size_t triIdx : {firstTriIdx, secondTriIdx}) {
+                if(isSimpleTriangle(triIdx)) {
+                    createdDetails.insert(triIdx);
+                }
+            }
+            trianglePairs.emplace_back(firstTriIdx, secondTriIdx);
+            detailPairs.emplace_back(getTriangleDetail(firstTriIdx), getTriangleDetail(secondTriIdx));
+        }
+    }
 
-        const size_t firstTriIdx = mPolyhedronData.mIdMap[firstFace];
-        const size_t secondTriIdx = mPolyhedronData.mIdMap[secondFace];
+    // Greedy edge coloring, pairs of the same color share no TriangleDetail and are corrected in parallel.
+    // Each triangle is in at most 3 pairs, so at most 5 colors are used.
+    std::unordered_map<size_t, uint32_t> usedColors;
+    std::vector<std::vector<size_t>> pairsOfColor;
+    for(size_t pairIdx = 0; pairIdx < trianglePairs.size(); ++pairIdx) {
+        uint32_t& firstUsed = usedColors[trianglePairs[pairIdx].first];
+        uint32_t& secondUsed = usedColors[trianglePairs[pairIdx].second];
+        size_t color = 0;
+        while((firstUsed | secondUsed) & (1u << color)) {
+            ++color;
+        }
+        P_ASSERT(color < 32);
+        firstUsed |= 1u << color;
+        secondUsed |= 1u << color;
+        if(color >= pairsOfColor.size()) {
+            pairsOfColor.resize(color + 1);
+        }
+        pairsOfColor[color].push_back(pairIdx);
+    }
 
-        if(!isSimpleTriangle(firstTriIdx) || !isSimpleTriangle(secondTriIdx)) {
-            std::pair<bool, bool> didAdd =
-                getTriangleDetail(firstTriIdx)->correctSharedVertices(*getTriangleDetail(secondTriIdx));
+    ThreadPool& threadPool = getThreadPool();
+    std::vector<std::pair<bool, bool>> didAdd(trianglePairs.size());
+    for(const std::vector<size_t>& pairs : pairsOfColor) {
+        threadPool.parallel_for_weighted(
+            pairs.begin(), pairs.end(),
+            [&detailPairs, &didAdd](size_t pairIdx) {
+                didAdd[pairIdx] = detailPairs[pairIdx].first->correctSharedVertices(*detailPairs[pairIdx].second);
+            },
+            [this, &trianglePairs](size_t pairIdx) {
+                return getTriangleDetailComplexity(trianglePairs[pairIdx].first) +
+                       getTriangleDetailComplexity(trianglePairs[pairIdx].second);
+            });
+    }
 
-            // Mark to triangulate later if any points added
-            if(didAdd.first) {
-                detailsToTriangulate.insert(firstTriIdx);
-            }
+    // Mark to triangulate later if any points added
+    for(size_t pairIdx = 0; pairIdx < trianglePairs.size(); ++pairIdx) {
+        if(didAdd[pairIdx].first) {
+            detailsToTriangulate.insert(trianglePairs[pairIdx].first);
+        }
+        if(didAdd[pairIdx].second) {
+            detailsToTriangulate.insert(trianglePairs[pairIdx].second);
+        }
+    }
 
-            if(didAdd.second) {
-                detailsToTriangulate.insert(secondTriIdx);
-            }
+    // Details created for the correction that got no points are the original triangle, keep them simple
+    for(const size_t triIdx : createdDetails) {
+        if(detailsToTriangulate.count(triIdx) == 0) {
+            eraseTriangleDetail(triIdx);
         }
     }
 
     // Triangulate details in parallel
-    std::vector<std::future<void>> tasks;
-    ThreadPool& threadPool = MainApplication::getThreadPool();
-    for(size_t triIdx : detailsToTriangulate) {
-        tasks.emplace_back(threadPool.enqueue([](TriangleDetail* detail) { detail->updateTrianglesFromPolygons(); },
-                                              getTriangleDetail(triIdx)));
-    }
+    threadPool.parallel_for_weighted(
+        detailsToTriangulate.begin(), detailsToTriangulate.end(),
+        [this](size_t triIdx) { getTriangleDetail(triIdx)->updateTrianglesFromPolygons(); },
+        [this](size_t triIdx) { return getTriangleDetailComplexity(triIdx); });
 
-    std::for_each(tasks.begin(), tasks.end(), [](auto& t) { t.get(); });
+    for(const size_t triIdx : detailsToTriangulate) {
+        markDetailDirty(triIdx);
+    }
+    // Details changed here only got points on the corrected edges, they do not need another correction
+    mSharedVerticesDirty.clear();
+    mSharedVerticesNeedFullCorrection = false;
 
     const auto endTime = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double, std::milli> timeMs = endTime - startTime;
 
-    mOgl.isDirty = true;
     CI_LOG_I("Correcting shared vertices took " + std::to_string(timeMs.count()) + " ms");
 }
 
-void Geometry::updateTemporaryDetailedData() {
-    const auto start = std::chrono::high_resolution_clock::now();
+bool Geometry::isUndecodedEdgeMatching(const size_t firstTriIdx, const size_t secondTriIdx) const {
+    const CopyOnWrite<TriangleDetail>* firstDetail = findTriangleDetail(firstTriIdx);
+    const CopyOnWrite<TriangleDetail>* secondDetail = findTriangleDetail(secondTriIdx);
+    const bool isFirstDecoded = firstDetail == nullptr || (*firstDetail)->hasExactData();
+    const bool isSecondDecoded = secondDetail == nullptr || (*secondDetail)->hasExactData();
+    if(isFirstDecoded && isSecondDecoded) {
+        return false;
+    }
+
+    // End points of the shared edge, the neighbours share the vertices of the polyhedron
+    std::array<glm::vec3, 2> edge;
+    size_t commonCount = 0;
+    for(size_t i = 0; i < 3; ++i) {
+        const glm::vec3 vertex = mTriangles.getVertex(firstTriIdx, i);
+        for(size_t j = 0; j < 3 && commonCount < 2; ++j) {
+            if(vertex == mTriangles.getVertex(secondTriIdx, j)) {
+                edge[commonCount++] = vertex;
+                break;
+            }
+        }
+    }
+    if(commonCount < 2) {
+        return false;
+    }
+
+    const glm::vec3 direction = edge[1] - edge[0];
+    const float length = glm::length(direction);
+    if(length == 0.f) {
+        return false;
+    }
+
+    // Vertices rounded from the exact points on the edge lie within a small distance of it. A vertex off the edge
+    // within the distance only makes the edge look mismatching, which is always safe.
+    float scale = length;
+    for(int axis = 0; axis < 3; ++axis) {
+        scale = std::max({scale, std::abs(edge[0][axis]), std::abs(edge[1][axis])});
+    }
+    const float tolerance = 1e-5f * scale;
+    const auto gatherEdgeVertices = [&edge, &direction, length, tolerance, this](const size_t triIdx) {
+        const CopyOnWrite<TriangleDetail>* detail = findTriangleDetail(triIdx);
+        if(detail == nullptr) {
+            return std::vector<glm::vec3>{std::min(edge[0], edge[1], isVertexLess),
+                                          std::max(edge[0], edge[1], isVertexLess)};
+        }
+        std::vector<glm::vec3> vertices;
+        for(const glm::vec3& vertex : (*detail)->getVertices()) {
+            const float distanceAlong = glm::dot(vertex - edge[0], direction) / length;
+            const glm::vec3 offset = vertex - edge[0] - direction * (distanceAlong / length);
+            if(distanceAlong >= -tolerance && distanceAlong <= length + tolerance &&
+               glm::dot(offset, offset) <= tolerance * tolerance) {
+                vertices.push_back(vertex);
+            }
+        }
+        std::sort(vertices.begin(), vertices.end(), isVertexLess);
+        vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+        return vertices;
+    };
+
+    // The detailed mesh is built from the plain vertices, so matching plain vertices give a closed mesh
+    return gatherEdgeVertices(firstTriIdx) == gatherEdgeVertices(secondTriIdx);
+}
+
+void Geometry::updateDetailedMesh(const std::atomic<bool>* isCancelled) {
+    const Profiler::ScopedTimer timer(Profiler::Zone::MeshRebuild);
 
     correctSharedVertices();
-    // Important! Do this in a single thread. Epeck kernel used by TriangleDetail
-    // is not thread safe even for read-only access
-    buildDetailedMesh();
-    buildDetailedTree();
+    // The exact kernel objects of TriangleDetail are not thread safe even for read-only access, so the detailed
+    // mesh is built only from their plain vertices, see TriangleDetail::getVertices()
+    buildDetailedMesh(isCancelled);
+
+    CI_LOG_I("Updating the detailed mesh took " + std::to_string(timer.getMilliseconds()) + " ms");
+}
+
+void Geometry::updateDetailedNormalsAndBorders(const std::atomic<bool>* isCancelled) {
+    if(!isDetailedMeshValid()) {
+        updateDetailedMesh(isCancelled);
+    }
+    if(!mMeshDetailed) {
+        return;
+    }
+    const auto& mesh = *mMeshDetailed;
+    auto& data = mDetailedNormalsAndBorders;
+
+    // Vertices to compute the normals of and faces to compute the borders of, all of them or those around changes
+    std::vector<PolyhedronData::vertex_descriptor> vertices;
+    std::vector<PolyhedronData::face_descriptor> faces;
+    if(!data.isValid) {
+        data.clear();
+        vertices.reserve(mesh.number_of_vertices());
+        for(const PolyhedronData::vertex_descriptor vertex : mesh.vertices()) {
+            vertices.push_back(vertex);
+        }
+        faces.reserve(mesh.number_of_faces());
+        for(const PolyhedronData::face_descriptor face : mesh.faces()) {
+            faces.push_back(face);
+        }
+        data.isValid = true;
+    } else {
+        vertices = std::move(data.dirtyVertices);
+        faces = std::move(data.dirtyFaces);
+        for(const size_t triangleIdx : data.dirtyTriangles) {
+            for(const PolyhedronData::face_descriptor face : getDetailedMeshFaces(triangleIdx)) {
+                faces.push_back(face);
+                for(const PolyhedronData::vertex_descriptor vertex :
+                    CGAL::vertices_around_face(mesh.halfedge(face), mesh)) {
+                    vertices.push_back(vertex);
+                }
+            }
+        }
+    }
+    data.dirtyTriangles.clear();
+    data.dirtyVertices.clear();
+    data.dirtyFaces.clear();
+    data.vertexNormals.resize(mesh.num_vertices(), glm::vec3(0.f));
+    data.isColorBorder.resize(mesh.num_halfedges(), 0);
+
+    for(const PolyhedronData::vertex_descriptor vertex : vertices) {
+        // Removed vertices and faces may be listed, their indices may not have been reused yet
+        if(!mesh.is_removed(vertex)) {
+            data.vertexNormals[static_cast<size_t>(vertex)] = computeDetailedVertexNormal(vertex);
+        }
+    }
 
-    const auto end = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<double, std::milli> timeMs = end - start;
-    CI_LOG_I("Updating temporary detailed data took " + std::to_string(timeMs.count()) + " ms");
+    const auto isColorBorder = [&](const PolyhedronData::halfedge_descriptor halfedge) {
+        if(mesh.is_border(halfedge)) {
+            return false;
+        }
+        const PolyhedronData::halfedge_descriptor opposite = mesh.opposite(halfedge);
+        // A hole in the model is a border as well
+        return mesh.is_border(opposite) || getTriangleColor(mMeshDetailedIdMap[mesh.face(halfedge)]) !=
+                                               getTriangleColor(mMeshDetailedIdMap[mesh.face(opposite)]);
+    };
+    for(const PolyhedronData::face_descriptor face : faces) {
+        if(mesh.is_removed(face)) {
+            continue;
+        }
+        // Both sides of each edge, the opposite side may have lost its face
+        for(const PolyhedronData::halfedge_descriptor halfedge :
+            CGAL::halfedges_around_face(mesh.halfedge(face), mesh)) {
+            const PolyhedronData::halfedge_descriptor opposite = mesh.opposite(halfedge);
+            data.isColorBorder[static_cast<size_t>(halfedge)] = isColorBorder(halfedge) ? 1 : 0;
+            data.isColorBorder[static_cast<size_t>(opposite)] = isColorBorder(opposite) ? 1 : 0;
+        }
+    }
+}
+
+glm::vec3 Geometry::computeDetailedVertexNormal(const PolyhedronData::vertex_descriptor vertex) const {
+    P_ASSERT(mMeshDetailed);
+    const auto& mesh = *mMeshDetailed;
+
+    // Faces of the same orientation fanned around the vertex count once
+    std::vector<glm::vec3> faceNormals;
+    glm::vec3 summedNormal(0.f);
+    for(const PolyhedronData::halfedge_descriptor halfedge : CGAL::halfedges_around_target(vertex, mesh)) {
+        if(mesh.is_border(halfedge)) {
+            continue;
+        }
+        const glm::vec3 normal = getTriangle(mMeshDetailedIdMap[mesh.face(halfedge)]).getNormal();
+        const bool isEpsSameNormal =
+            std::any_of(faceNormals.begin(), faceNormals.end(), [&normal](const glm::vec3& faceNormal) {
+                return glm::all(glm::epsilonEqual(normal, faceNormal, glm::epsilon<float>()));
+            });
+        faceNormals.push_back(normal);
+        if(!isEpsSameNormal) {
+            summedNormal += normal;
+        }
+    }
+    return glm::normalize(summedNormal);
 }
 
 void Geometry::invalidateTemporaryDetailedData() {
-    mTreeDetailed.reset();
+    // Detail picking is updated per detail through markDetailDirty()
     mMeshDetailed.reset();
+    mMeshDetailedDirty.clear();
+    mColorRegions.clear();
+    mDetailedNormalsAndBorders.clear();
+    mSharedVerticesDirty.clear();
+    mSharedVerticesNeedFullCorrection = true;
+}
+
+void Geometry::computeFaceNeighbours(const PolyhedronData::Mesh& mesh,
+                                     const std::vector<PolyhedronData::face_descriptor>& faceDescs) {
+    // Triangle of each face of the mesh
+    std::vector<size_t> faceTriangles(mesh.number_of_faces(), std::numeric_limits<size_t>::max());
+    for(size_t triIndex = 0; triIndex < faceDescs.size(); ++triIndex) {
+        faceTriangles[static_cast<size_t>(faceDescs[triIndex])] = triIndex;
+    }
+
+    auto& faceNeighbours = mPolyhedronData.faceNeighbours;
+    faceNeighbours.assign(faceDescs.size(), {PolyhedronData::NO_NEIGHBOUR, PolyhedronData::NO_NEIGHBOUR,
+                                             PolyhedronData::NO_NEIGHBOUR});
+    auto& faceNeighbourCosines = mPolyhedronData.faceNeighbourCosines;
+    faceNeighbourCosines.assign(faceDescs.size(), {1.f, 1.f, 1.f});
+
+    for(size_t triIndex = 0; triIndex < faceDescs.size(); ++triIndex) {
+        const auto edge = mesh.halfedge(faceDescs[triIndex]);
+        auto itEdge = edge;
+
+        for(int i = 0; i < 3; ++i) {
+            const auto oppositeEdge = mesh.opposite(itEdge);
+            if(oppositeEdge.is_valid() && !mesh.is_border(oppositeEdge)) {
+                const PolyhedronData::Mesh::Face_index neighbourFace = mesh.face(oppositeEdge);
+                const size_t neighbourFaceId = faceTriangles[static_cast<size_t>(neighbourFace)];
+                P_ASSERT(neighbourFaceId < mTriangles.size());
+                faceNeighbours[triIndex][i] = static_cast<uint32_t>(neighbourFaceId);
+                faceNeighbourCosines[triIndex][i] = glm::dot(glm::normalize(mTriangles.getNormal(triIndex)),
+                                                             glm::normalize(mTriangles.getNormal(neighbourFaceId)));
+            }
+
+            itEdge = mesh.next(itEdge);
+        }
+        P_ASSERT(edge == itEdge);
+    }
 }
 
 std::array<int, 3> Geometry::gatherNeighbours(const size_t triIndex) const {
-    const auto& faceDescriptors = mPolyhedronData.mFaceDescs;
-    const auto& mesh = mPolyhedronData.mMesh;
-    P_ASSERT(triIndex < faceDescriptors.size());
+    P_ASSERT(triIndex < mPolyhedronData.faceNeighbours.size());
     std::array<int, 3> returnValue = {-1, -1, -1};
-    const PolyhedronData::face_descriptor face = faceDescriptors[triIndex];
-    const auto edge = mesh.halfedge(face);
-    auto itEdge = edge;
-
+    const std::array<uint32_t, 3>& neighbours = mPolyhedronData.faceNeighbours[triIndex];
     for(int i = 0; i < 3; ++i) {
-        const auto oppositeEdge = mesh.opposite(itEdge);
-        if(oppositeEdge.is_valid() && !mesh.is_border(oppositeEdge)) {
-            const PolyhedronData::Mesh::Face_index neighbourFace = mesh.face(oppositeEdge);
-            const size_t neighbourFaceId = mPolyhedronData.mIdMap[neighbourFace];
-            P_ASSERT(neighbourFaceId < mTriangles.size());
-            returnValue[i] = static_cast<int>(neighbourFaceId);
+        if(neighbours[i] != PolyhedronData::NO_NEIGHBOUR) {
+            returnValue[i] = static_cast<int>(neighbours[i]);
         }
-
-        itEdge = mesh.next(itEdge);
     }
-    P_ASSERT(edge == itEdge);
-
     return returnValue;
 }
-std::array<std::optional<DetailedTriangleId>, 3> Geometry::gatherNeighbours(const DetailedTriangleId triId) const {
-    P_ASSERT(mMeshDetailed);
-
-    const auto& faceDescriptors = mMeshDetailedFaceDescs;
-    const auto& mesh = *mMeshDetailed;
-    P_ASSERT(faceDescriptors.find(triId) != faceDescriptors.end());
-    std::array<std::optional<DetailedTriangleId>, 3> returnValue = {};
-    const PolyhedronData::face_descriptor face = faceDescriptors.find(triId)->second;
-    const auto edge = mesh.halfedge(face);
-    auto itEdge = edge;
 
-    for(int i = 0; i < 3; ++i) {
-        const auto oppositeEdge = mesh.opposite(itEdge);
-        if(oppositeEdge.is_valid() && !mesh.is_border(oppositeEdge)) {
-            const PolyhedronData::Mesh::Face_index neighbourFace = mesh.face(oppositeEdge);
-            const DetailedTriangleId neighbourFaceId = mMeshDetailedIdMap[neighbourFace];
-            returnValue[i] = neighbourFaceId;
+float Geometry::getNeighbourCosine(const size_t triangleIdx, const size_t neighbourIdx) const {
+    P_ASSERT(triangleIdx < mTriangles.size() && neighbourIdx < mTriangles.size());
+    if(triangleIdx < mPolyhedronData.faceNeighbours.size()) {
+        const std::array<uint32_t, 3>& neighbours = mPolyhedronData.faceNeighbours[triangleIdx];
+        for(int i = 0; i < 3; ++i) {
+            if(neighbours[i] == neighbourIdx) {
+                return mPolyhedronData.faceNeighbourCosines[triangleIdx][i];
+            }
         }
-
-        itEdge = mesh.next(itEdge);
     }
-    P_ASSERT(edge == itEdge);
 
-    return returnValue;
+    // Not neighbours, or the mesh is not built
+    return glm::dot(glm::normalize(mTriangles.getNormal(triangleIdx)),
+                    glm::normalize(mTriangles.getNormal(neighbourIdx)));
+}
+
+static_assert(SdfCalculator::NO_NEIGHBOUR == PolyhedronData::NO_NEIGHBOUR,
+              "SdfCalculator reads the neighbours of PolyhedronData");
+static_assert(SdfSegmentation::NO_NEIGHBOUR == PolyhedronData::NO_NEIGHBOUR,
+              "SdfSegmentation reads the neighbours of PolyhedronData");
+static_assert(RegionFill::NO_NEIGHBOUR == PolyhedronData::NO_NEIGHBOUR,
+              "RegionFill reads the neighbours of PolyhedronData");
+
+Geometry::SdfRefinement::~SdfRefinement() {
+    isCancelled = true;
+    if(values.valid()) {
+        // On a worker thread, the refinement may be still queued behind this task
+        try {
+            getThreadPool().wait(values);
+        } catch(...) {
+            // The values are dropped anyway
+        }
+    }
 }
 
 void Geometry::computeSdf() {
+    mSdfRefinement.reset();
+    invalidateSegmentations();
     mProgress->sdfPercentage = 0.0f;
+    mProgress->isSdfCancelled = false;
     mPolyhedronData.isSdfComputed = false;
     mPolyhedronData.sdfValuesValid = true;
-    mPolyhedronData.mMesh.remove_property_map(mPolyhedronData.sdf_property_map);
-    bool created;
-    boost::tie(mPolyhedronData.sdf_property_map, created) =
-        mPolyhedronData.mMesh.add_property_map<PolyhedronData::face_descriptor, double>("f:sdf");
-    P_ASSERT(created);
+    mPolyhedronData.sdfValues.clear();
 
-    if(created) {
-        std::pair<double, double> minMaxSdf;
-        try {
-            minMaxSdf = CGAL::sdf_values(mPolyhedronData.mMesh, mPolyhedronData.sdf_property_map, 2.0 / 3.0 * CGAL_PI,
-                                         25, true);
-        } catch(...) {
-            mPolyhedronData.sdfValuesValid = false;
-            mProgress->resetSdf();
-            throw std::runtime_error("Computation of the SDF values failed internally in CGAL.");
-        }
-        if(minMaxSdf.first == minMaxSdf.second) {
-            mPolyhedronData.sdfValuesValid = false;
-            // This happens when the object is flat and thus has no volume
-            mProgress->resetSdf();
-            throw SdfValuesException("The SDF computation returned a non-valid result. The values were both equal to " +
-                                     std::to_string(minMaxSdf.first) + ".");
-        }
-        mPolyhedronData.isSdfComputed = true;
-        mProgress->sdfPercentage = 1.0f;
-        CI_LOG_I("SDF values computed.");
-    } else {
-        mPolyhedronData.isSdfComputed = false;
+    P_ASSERT(mPickingTree.size() == mTriangles.size());
+    P_ASSERT(mPolyhedronData.faceNeighbours.size() == mTriangles.size());
+    std::optional<std::pair<double, double>> minMaxSdf;
+    SdfSettings coarseSettings = mSdfSettings;
+    coarseSettings.rayCount = std::min(mSdfSettings.rayCount, COARSE_SDF_RAY_COUNT);
+    try {
+        const std::shared_ptr<const SdfProxy> proxy = getSdfProxy(coarseSettings);
+        coarseSettings.proxyTriangleCount = proxy != nullptr ? proxy->getTargetTriangleCount() : 0;
+        std::vector<double> sdfValues;
+        minMaxSdf = calculateSdf(coarseSettings, proxy, sdfValues, &mProgress->sdfPercentage,
+                                 &mProgress->isSdfCancelled);
+        mPolyhedronData.sdfValues = minMaxSdf ? std::move(sdfValues) : std::vector<double>();
+    } catch(...) {
+        mPolyhedronData.sdfValuesValid = false;
         mProgress->resetSdf();
-        throw std::runtime_error("Computation of the SDF values failed, a new property map could not be tied");
+        throw std::runtime_error("Computation of the SDF values failed internally.");
+    }
+    if(!minMaxSdf) {
+        // Cancelled by the user, the values can be computed again
+        mProgress->resetSdf();
+        CI_LOG_I("SDF computation cancelled.");
+        return;
+    }
+    if(minMaxSdf->first == minMaxSdf->second) {
+        mPolyhedronData.sdfValuesValid = false;
+        // This happens when the object is flat and thus has no volume
+        mProgress->resetSdf();
+        throw SdfValuesException("The SDF computation returned a non-valid result. The values were both equal to " +
+                                 std::to_string(minMaxSdf->first) + ".");
+    }
+    mPolyhedronData.isSdfComputed = true;
+    mSdfValuesSettings = coarseSettings;
+    mProgress->sdfPercentage = 1.0f;
+    CI_LOG_I("Coarse SDF values computed.");
+
+    if(coarseSettings.rayCount < mSdfSettings.rayCount) {
+        startSdfRefinement();
+    }
+}
+
+void Geometry::startSdfRefinement() {
+    mSdfRefinement = std::make_unique<SdfRefinement>();
+    SdfRefinement* const refinement = mSdfRefinement.get();
+    refinement->settings = mSdfSettings;
+    const std::shared_ptr<const SdfProxy> proxy = getSdfProxy(refinement->settings);
+    refinement->settings.proxyTriangleCount = proxy != nullptr ? proxy->getTargetTriangleCount() : 0;
+
+    // Only reads data which does not change until mSdfRefinement is reset, the proxy is kept by the task
+    refinement->values = getThreadPool().enqueue(::ThreadPool::priority::background, [this, refinement, proxy]() {
+        std::optional<std::vector<double>> values(std::in_place);
+        const std::optional<std::pair<double, double>> minMaxSdf = calculateSdf(
+            refinement->settings, proxy, *values, &refinement->progress, &refinement->isCancelled);
+        if(!minMaxSdf || minMaxSdf->first == minMaxSdf->second) {
+            values.reset();
+        }
+        return values;
+    });
+}
+
+std::shared_ptr<const SdfProxy> Geometry::getSdfProxy(const SdfSettings& settings) {
+    // The proxy triangles are mapped from the polyhedron faces, which match the base triangles
+    if(settings.proxyTriangleCount == 0 || mTriangles.size() <= settings.proxyTriangleCount ||
+       mPolyhedronData.indices.size() != mTriangles.size()) {
+        return nullptr;
+    }
+    if(mSdfProxy == nullptr || mSdfProxy->getTargetTriangleCount() != settings.proxyTriangleCount) {
+        mSdfProxy = std::make_shared<const SdfProxy>(mPolyhedronData.vertices, mPolyhedronData.indices,
+                                                     settings.proxyTriangleCount, getThreadPool());
+        CI_LOG_I("SDF proxy of " + std::to_string(mSdfProxy->getTriangleCount()) + " triangles built.");
+    }
+    return mSdfProxy->getTriangleCount() > 0 ? mSdfProxy : nullptr;
+}
+
+std::optional<std::pair<double, double>> Geometry::calculateSdf(const SdfSettings& settings,
+                                                                const std::shared_ptr<const SdfProxy>& proxy,
+                                                                std::vector<double>& values,
+                                                                std::atomic<float>* progress,
+                                                                const std::atomic<bool>* isCancelled) const {
+    // Kept alive until the computation finishes, even if the application replaces it
+    const std::shared_ptr<SdfGpuCalculator> gpuCalculator = std::atomic_load(&sSdfGpuCalculator);
+    if(proxy == nullptr) {
+        // Rays are cast over the picking hierarchy of the same triangles, in parallel
+        SdfCalculator calculator(mPickingTree, mTriangles.getVertices(), mPolyhedronData.faceNeighbours);
+        calculator.setGpuCalculator(gpuCalculator.get());
+        return calculator.compute(settings, values, getThreadPool(), progress, isCancelled);
     }
+
+    // Each triangle takes the value of its closest proxy triangle
+    SdfCalculator calculator(proxy->getBvh(), proxy->getVertices(), proxy->getNeighbours());
+    calculator.setGpuCalculator(gpuCalculator.get());
+    std::vector<double> proxyValues;
+    const std::optional<std::pair<double, double>> minMaxSdf =
+        calculator.compute(settings, proxyValues, getThreadPool(), progress, isCancelled);
+    if(minMaxSdf) {
+        values = proxy->toMeshValues(proxyValues);
+    }
+    return minMaxSdf;
 }
 
-size_t Geometry::segment(const int numberOfClusters, const float smoothingLambda,
-                         std::map<size_t, std::vector<size_t>>& segmentToTriangleIds,
-                         std::unordered_map<size_t, size_t>& triangleToSegmentMap) {
+bool Geometry::updateSdfRefinement() {
+    if(mSdfRefinement == nullptr ||
+       mSdfRefinement->values.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return false;
+    }
+
+    std::optional<std::vector<double>> values;
+    try {
+        values = mSdfRefinement->values.get();
+    } catch(const std::exception& e) {
+        CI_LOG_W("Refinement of the SDF values failed, keeping the coarse values: " << e.what());
+    }
+    const SdfSettings settings = mSdfRefinement->settings;
+    mSdfRefinement.reset();
+    if(!values || !isSdfComputed()) {
+        return false;
+    }
+
+    P_ASSERT(values->size() == mPolyhedronData.sdfValues.size());
+    mPolyhedronData.sdfValues = std::move(*values);
+    mSdfValuesSettings = settings;
+    invalidateSegmentations();
+    CI_LOG_I("SDF values refined.");
+    return true;
+}
+
+size_t Geometry::segment(const int numberOfClusters, const float smoothingLambda, SegmentMap& segments,
+                         const std::atomic<bool>* isCancelled) {
     if(!mPolyhedronData.isSdfComputed) {
         throw std::runtime_error("Cannot calculate the segmentation - SDF values not computed.");
         return 0;
     }
-    bool created;
-    PolyhedronData::Mesh::Property_map<PolyhedronData::face_descriptor, std::size_t> segment_property_map;
-    boost::tie(segment_property_map, created) =
-        mPolyhedronData.mMesh.add_property_map<PolyhedronData::face_descriptor, std::size_t>("f:sid");
 
-    P_ASSERT(created);
-
-    if(created) {
-        std::size_t numberOfSegments = std::numeric_limits<size_t>::min();
+    const auto cached = std::find_if(mSegmentationCache.begin(), mSegmentationCache.end(),
+                                     [numberOfClusters, smoothingLambda](const CachedSegmentation& segmentation) {
+                                         return segmentation.numberOfClusters == numberOfClusters &&
+                                                segmentation.smoothingLambda == smoothingLambda;
+                                     });
+    if(cached != mSegmentationCache.end()) {
+        // Most recently used first
+        std::rotate(mSegmentationCache.begin(), cached, cached + 1);
+        CI_LOG_I("Segmentation reused.");
+    } else {
+        std::optional<SdfSegmentation::Segments> segments;
+        const std::shared_ptr<const SdfSegmentation> sdfSegmentation = getSdfSegmentation();
         try {
-            numberOfSegments =
-                CGAL::segmentation_from_sdf_values(mPolyhedronData.mMesh, mPolyhedronData.sdf_property_map,
-                                                   segment_property_map, numberOfClusters, smoothingLambda);
-        } catch(...) {
-            throw std::runtime_error("Computation of the segmentation failed internally in CGAL.");
+            // The clustering of the same number of clusters is reused, only the graph cut runs again
+            segments = sdfSegmentation->segment(numberOfClusters, smoothingLambda, isCancelled);
+        } catch(const std::exception& e) {
+            throw std::runtime_error(std::string("Computation of the segmentation failed internally: ") + e.what());
         }
-
-        if(numberOfSegments > PEPR3D_MAX_PALETTE_COLORS) {
-            mPolyhedronData.mMesh.remove_property_map(segment_property_map);
+        if(!segments) {
+            CI_LOG_I("Segmentation cancelled.");
             return 0;
         }
+        cacheSegmentation(sdfSegmentation, numberOfClusters, smoothingLambda, std::move(*segments));
+        CI_LOG_I("Segmentation finished.");
+    }
 
-        for(size_t seg = 0; seg < numberOfSegments; ++seg) {
-            segmentToTriangleIds.insert({seg, {}});
-        }
-
-        // Assign the colors to the triangles
-        for(const auto& face : mPolyhedronData.mFaceDescs) {
-            const size_t id = mPolyhedronData.mIdMap[face];
-            const size_t color = segment_property_map[face];
-            P_ASSERT(id < mTriangles.size());
-            P_ASSERT(color < numberOfSegments);
-            triangleToSegmentMap.insert({id, color});
-            segmentToTriangleIds[color].push_back(id);
-        }
+    const CachedSegmentation& segmentation = mSegmentationCache.front();
+    P_ASSERT(segmentation.triangleSegments.size() == mTriangles.size());
+    const size_t numberOfSegments = segmentation.numberOfSegments;
+    CI_LOG_I("Number of segments: " + std::to_string(numberOfSegments));
+    if(numberOfSegments > PEPR3D_MAX_PALETTE_COLORS) {
+        return 0;
+    }
 
-        CI_LOG_I("Segmentation finished. Number of segments: " + std::to_string(numberOfSegments));
+    segments = SegmentMap(segmentation.triangleSegments, numberOfSegments, getThreadPool());
+    return numberOfSegments;
+}
 
-        // End, clean up
-        mPolyhedronData.mMesh.remove_property_map(segment_property_map);
+std::shared_ptr<const SdfSegmentation> Geometry::getSdfSegmentation() {
+    if(!isSdfComputed()) {
+        return nullptr;
+    }
+    if(mSdfSegmentation == nullptr) {
+        std::vector<double> sdfValues(mTriangles.size());
+        for(size_t triIdx = 0; triIdx < sdfValues.size(); ++triIdx) {
+            sdfValues[triIdx] = getSdfValue(triIdx);
+        }
+        // The serial graph cut dominates the segmentation of large meshes, they are smoothed in parallel
+        const auto getSmoothing = [](const size_t triangleCount) {
+            using Smoothing = SdfSegmentation::Smoothing;
+            return triangleCount >= SEGMENTATION_PROPAGATION_MIN_TRIANGLES ? Smoothing::LabelPropagation
+                                                                           : Smoothing::GraphCut;
+        };
+        const std::shared_ptr<const SdfProxy> proxy = getSdfProxy(mSdfValuesSettings);
+        if(proxy != nullptr) {
+            // The graph cut runs on the proxy, the mesh only refines the seams between the labels
+            const std::vector<glm::vec3>& proxyVertices = proxy->getVertices();
+            auto proxySegmentation = std::make_shared<const SdfSegmentation>(
+                proxyVertices, proxy->getNeighbours(), proxy->toProxyValues(sdfValues),
+                getSmoothing(proxyVertices.size() / 3), &getThreadPool());
+            mSdfSegmentation = std::make_shared<const SdfSegmentation>(
+                mTriangles.getVertices(), mPolyhedronData.faceNeighbours, std::move(sdfValues),
+                std::move(proxySegmentation), proxy->getProxyTriangles());
+        } else {
+            mSdfSegmentation = std::make_shared<const SdfSegmentation>(
+                mTriangles.getVertices(), mPolyhedronData.faceNeighbours, std::move(sdfValues),
+                getSmoothing(mTriangles.size()), &getThreadPool());
+        }
+    }
+    return mSdfSegmentation;
+}
 
-        return numberOfSegments;
-    } else {
-        throw std::runtime_error("Computation of the segmentation failed, a new property map could not be tied.");
+void Geometry::cacheSegmentation(const std::shared_ptr<const SdfSegmentation>& sdfSegmentation,
+                                 const int numberOfClusters, const float smoothingLambda,
+                                 SdfSegmentation::Segments segments) {
+    if(sdfSegmentation == nullptr || sdfSegmentation != mSdfSegmentation) {
+        // Computed from SDF values which are not current anymore
+        return;
+    }
+    P_ASSERT(segments.triangleSegments.size() == mTriangles.size());
+
+    mSegmentationCache.erase(std::remove_if(mSegmentationCache.begin(), mSegmentationCache.end(),
+                                            [numberOfClusters, smoothingLambda](const CachedSegmentation& cached) {
+                                                return cached.numberOfClusters == numberOfClusters &&
+                                                       cached.smoothingLambda == smoothingLambda;
+                                            }),
+                             mSegmentationCache.end());
+    mSegmentationCache.insert(mSegmentationCache.begin(),
+                              CachedSegmentation{numberOfClusters, smoothingLambda,
+                                                 static_cast<uint32_t>(segments.numberOfSegments),
+                                                 std::move(segments.triangleSegments)});
+    if(mSegmentationCache.size() > SEGMENTATION_CACHE_SIZE) {
+        mSegmentationCache.pop_back();
     }
 }
 
+void Geometry::invalidateSegmentations() {
+    mSegmentationCache.clear();
+    mSdfSegmentation.reset();
+    ++mSdfValuesVersion;
+}
+
 }  // namespace pepr3d
@@ -1,7 +1,6 @@
 #pragma once
 
-#include <CGAL/AABB_traits.h>
-#include <CGAL/AABB_tree.h>
+#include <CGAL/Bbox_3.h>
 #include <CGAL/Surface_mesh.h>
 #include <CGAL/exceptions.h>
 #include <CGAL/mesh_segmentation.h>
@@ -12,19 +11,42 @@
 #include <cereal/types/vector.hpp>
 #include "cinder/Log.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <future>
+#include <limits>
 #include <map>
+#include <mutex>
 #include <optional>
+#include <set>
 #include <unordered_map>
 #include <vector>
 
+#include "geometry/BoundingSphereTree.h"
+#include "geometry/BoundingSpheres.h"
+#include "geometry/ColorChunkCompressor.h"
 #include "geometry/ColorManager.h"
+#include "geometry/CopyOnWrite.h"
 #include "geometry/GeometryProgress.h"
 #include "geometry/GlmSerialization.h"
+#include "geometry/MappedBufferStorage.h"
+#include "geometry/MeshSimplifier.h"
+#include "geometry/MortonOrder.h"
 #include "geometry/ModelImporter.h"
 #include "geometry/PolyhedronData.h"
+#include "geometry/SdfCalculator.h"
+#include "geometry/SdfProxy.h"
+#include "geometry/SdfSegmentation.h"
+#include "geometry/SegmentMap.h"
 #include "geometry/Triangle.h"
+#include "geometry/TriangleBvh.h"
 #include "geometry/TriangleDetail.h"
+#include "geometry/TriangleSlotMap.h"
+#include "geometry/TriangleStore.h"
 #include "geometry/TrianglePrimitive.h"
+#include "ThreadPool.h"
 #include "peprassert.h"
 #include "tools/Brush.h"
 
@@ -37,15 +59,16 @@ class Geometry {
     using Circle = DataTriangle::K::Circle_3;
     using Sphere = DataTriangle::K::Sphere_3;
     using Line3 = DataTriangle::K::Line_3;
+    using Segment3 = DataTriangle::K::Segment_3;
     using Vector3 = pepr3d::DataTriangle::K::Vector_3;
     using Point3 = pepr3d::DataTriangle::K::Point_3;
     using Ft = pepr3d::DataTriangle::K::FT;
     using Ray = pepr3d::DataTriangle::K::Ray_3;
-    using My_AABB_traits = CGAL::AABB_traits<pepr3d::DataTriangle::K, DataTriangleAABBPrimitive>;
-    using Tree = CGAL::AABB_tree<My_AABB_traits>;
-    using Ray_intersection = boost::optional<Tree::Intersection_and_primitive_id<Ray>::Type>;
-    using BoundingBox = My_AABB_traits::Bounding_box;
-    using ColorIndex = GLuint;
+    using BoundingBox = CGAL::Bbox_3;
+    /// Single byte per face, uploaded to the GPU as a GL_R8UI buffer texture
+    using ColorIndex = pepr3d::ColorIndex;
+    static_assert(PEPR3D_MAX_PALETTE_COLORS - 1 <= std::numeric_limits<ColorIndex>::max(),
+                  "ColorIndex is too small for the palette");
 
     /// A highlight of a part of the Geometry
     struct AreaHighlight {
@@ -56,32 +79,92 @@ class Geometry {
         glm::vec3 origin{};
         glm::vec3 direction{};
         double size{};
+        /// Triangle under the brush center and the brush center the triangles were collected for
+        size_t startTriangle{};
+        glm::vec3 trianglesOrigin{};
         bool enabled{};
-        /// Do we need to upload new data to the gpu
+        /// Does the highlight mask have to be generated again
         bool dirty{true};
     };
 
     /// All OpenGL buffers of the Geometry
     struct OpenGlData {
-        /// Vertex buffer with the same data as mTriangles for OpenGL to render the mesh.
-        /// Contains position and color data for each vertex.
+        /// Sorted, non-overlapping ranges [first, second) of a buffer that changed since the last upload
+        struct BufferRanges {
+            std::vector<std::pair<size_t, size_t>> ranges;
+
+            void add(size_t begin, size_t end) {
+                P_ASSERT(begin <= end);
+                // Consecutive writes usually extend the last range
+                if(!ranges.empty() && ranges.back().first <= begin && begin <= ranges.back().second) {
+                    ranges.back().second = std::max(ranges.back().second, end);
+                } else {
+                    ranges.emplace_back(begin, end);
+                    isMerged = false;
+                }
+            }
+
+            /// Sort the ranges and merge the overlapping and adjacent ones to limit the number of uploads
+            void merge() {
+                if(isMerged) {
+                    return;
+                }
+                std::sort(ranges.begin(), ranges.end());
+                std::vector<std::pair<size_t, size_t>> mergedRanges;
+                for(const auto& range : ranges) {
+                    if(!mergedRanges.empty() && range.first <= mergedRanges.back().second) {
+                        mergedRanges.back().second = std::max(mergedRanges.back().second, range.second);
+                    } else {
+                        mergedRanges.push_back(range);
+                    }
+                }
+                ranges = std::move(mergedRanges);
+                isMerged = true;
+            }
+
+            bool empty() const {
+                return ranges.empty();
+            }
+
+            void clear() {
+                ranges.clear();
+                isMerged = true;
+            }
+
+           private:
+            bool isMerged{true};
+        };
+
+        /// Mapped GPU buffers the vertex, index and face triangle buffers are written to instead of their vectors
+        using MappedStorage = MappedBufferStorage;
+
+        /// Vertex buffer for OpenGL to render the mesh.
+        /// Simple triangles share the vertices of the original mesh, detail triangles follow with 3 own vertices each.
         std::vector<glm::vec3> vertexBuffer;
 
-        /// Color buffer, keeping the invariant that every triangle has only one color - all three vertices have to have
-        /// the same color. It is aligned with the vertex buffer and its size should be always equal to the vertex
-        /// buffer.
+        /// Index buffer for OpenGL frontend, 3 indices for each face. The first faces are the triangles of mTriangles
+        /// (degenerate if the triangle has a detail), detail triangles follow.
+        std::vector<uint32_t> indexBuffer;
+
+        /// Color buffer with a single color for each face of the index buffer.
         std::vector<ColorIndex> colorBuffer;
 
-        /// Normal buffer, the triangle has same normal for its every vertex.
-        /// It is aligned with the vertex buffer and its size should be always equal to the vertex buffer.
-        std::vector<glm::vec3> normalBuffer;
+        /// Base triangle of each face of the index buffer, changes only with the layout of the buffers.
+        /// Used to look up the highlight mask of a face.
+        std::vector<GLuint> faceTriangles;
 
-        /// Index buffer for OpenGL frontend., specifying the same triangles as in mTriangles.
-        std::vector<uint32_t> indexBuffer;
+        /// One bit for each base triangle that indicates if its faces should display cursor highlight, 32 triangles
+        /// in each element. Used to limit the highlight to continuous surface, without a continuous surface the
+        /// shader tests only the distance to the highlight origin and the mask is not used.
+        std::vector<GLuint> highlightMask;
+
+        /// Number of vertices and faces in the buffers, also when they are written to a MappedStorage
+        size_t vertexCount{0};
+        size_t faceCount{0};
 
-        /// boolen for each triangle that indicates if the triangle should display cursor highlight
-        /// Used to limit the highlight to continuous surface
-        std::vector<GLint> highlightMask;  // Possibly needs to be GLint, had problems getting GLbyte through cinder
+        /// The vertex, index and face triangle buffers were written to a MappedStorage, not to their vectors.
+        /// The color buffer and the highlight mask are always kept, the tools read and update them in place.
+        bool isMapped{false};
 
         bool isDirty{true};
 
@@ -92,30 +175,97 @@ class Geometry {
             mutable bool didColorUpdate{false};
             mutable bool didHighlightUpdate{false};
 
+            /// The buffers were generated from scratch, all of the data has to be uploaded again
+            mutable bool didLayoutChange{true};
+
+            /// Face ranges of the index, color and highlight buffers rewritten by incremental updates
+            mutable BufferRanges dirtyFaceRanges;
+
+            /// Vertex ranges of the vertex buffer rewritten by incremental updates
+            mutable BufferRanges dirtyVertexRanges;
+
+            /// Face ranges of the color buffer changed in place, valid when didColorUpdate is set
+            mutable BufferRanges colorRanges;
+
+            /// Element ranges of the highlight mask changed in place, valid when didHighlightUpdate is set
+            mutable BufferRanges highlightRanges;
+
             void unsetColorFlag() const {
                 didColorUpdate = false;
+                colorRanges.clear();
             }
 
             void unsetHighlightFlag() const {
                 didHighlightUpdate = false;
+                highlightRanges.clear();
+            }
+
+            void unsetBufferFlags() const {
+                didLayoutChange = false;
+                dirtyFaceRanges.clear();
+                dirtyVertexRanges.clear();
             }
         } info;
     };
 
    private:
-    /// Triangle soup of the original model mesh, containing CGAL::Triangle_3 data for AABB tree.
-    std::vector<DataTriangle> mTriangles;
+    /// Triangle soup of the original model mesh, CGAL::Triangle_3 data for AABB tree are constructed on demand.
+    TriangleStore mTriangles;
 
     /// Stores a rough collision sphere for each triangle
     /// in a form of a center point + radius.
     /// Used to speed up capsule/cylinder querries on original triangles.
-    std::vector<std::pair<Point3, double>> mTriangleBounds;
+    /// Has to be regenerated by generateTriangleBounds() whenever mTriangles change.
+    BoundingSpheres mTriangleBounds;
+
+    /// Hierarchy over mTriangleBounds for range queries
+    BoundingSphereTree mTriangleBoundsTree;
+
+    /// Range of the OpenGL buffers reserved for the triangles of a single TriangleDetail
+    struct DetailBufferSlot {
+        /// Index of the first face of the slot in the index, color and face triangle buffers
+        size_t faceStart;
+        /// Index of the first vertex of the slot in the vertex buffer
+        size_t vertexStart;
+        /// Number of triangles that fit into the slot, unused triangles are degenerate
+        size_t capacity;
+    };
+
+    /// Triangle detail (detailed triangles that replace the original) of a base triangle and the slot of its
+    /// triangles in the mOgl buffers. The buffer slot stays reserved after the detail is removed, until the next
+    /// buffer update releases it.
+    struct TriangleDetailSlot {
+        /// Details are copy-on-write, undo snapshots share the details that did not change
+        std::optional<CopyOnWrite<TriangleDetail>> detail;
+        std::optional<DetailBufferSlot> bufferSlot;
+    };
+
+    /// Details and buffer slots of the base triangles that have any, looked up by isSimpleTriangle() in every loop
+    /// over the triangles
+    TriangleSlotMap<TriangleDetailSlot> mTriangleDetailSlots;
+
+    /// Details changed by painting since the last compactTriangleDetails()
+    std::set<size_t> mDetailsToCompact;
 
-    /// Map of triangle details. (Detailed triangles that replace the original)
-    std::map<size_t, TriangleDetail> mTriangleDetails;
+    /// Map of DetailBufferSlot::faceStart -> baseTriangleId, to find the triangle of a face
+    std::map<size_t, size_t> mDetailBufferSlotOwners;
 
-    /// Map of baseTriangleId -> Index of first detail triangle color in mOgl.colorBuffer
-    std::map<size_t, size_t> mTriangleDetailColorBufferStart;
+    /// Base triangles whose TriangleDetail was created, modified or removed since the last buffer update
+    std::set<size_t> mOglDirtyDetails;
+
+    /// Number of triangles in the buffers that belong to no slot anymore
+    size_t mOglUnusedTriangles{0};
+
+    /// Vertex, index and face triangle buffers being written, the vectors of mOgl or a MappedStorage
+    glm::vec3* mOglVertices{nullptr};
+    uint32_t* mOglIndices{nullptr};
+    GLuint* mOglFaceTriangles{nullptr};
+
+    /// Simple triangles use the shared vertices of mPolyhedronData instead of 3 own vertices each
+    bool mOglSharedVertices{false};
+
+    /// The layout of the buffers is invalid and everything has to be generated again
+    bool mOglNeedsRebuild{true};
 
     /// All open GL buffers
     OpenGlData mOgl;
@@ -123,12 +273,117 @@ class Geometry {
     /// Polyhedron structure
     PolyhedronData mPolyhedronData;
 
-    /// AABB tree from the CGAL library, to find intersections with rays generated by user mouse clicks and the mesh.
-    std::unique_ptr<Tree> mTree;
+    /// Ray count, cone angle and proxy size used by computeSdf()
+    SdfSettings mSdfSettings;
+
+    /// Settings the current SDF values were computed with, fewer rays than mSdfSettings until they are refined
+    SdfSettings mSdfValuesSettings;
+
+    /// Segmentation of the current SDF values with the given parameters
+    struct CachedSegmentation {
+        int numberOfClusters;
+        float smoothingLambda;
+        uint32_t numberOfSegments;
+
+        /// Segment of each triangle
+        std::vector<uint32_t> triangleSegments;
+
+        template <class Archive>
+        void serialize(Archive& archive) {
+            archive(numberOfClusters, smoothingLambda, numberOfSegments, triangleSegments);
+        }
+    };
+
+    /// Recently computed segmentations, the most recently used first. Cleared whenever the SDF values change.
+    std::vector<CachedSegmentation> mSegmentationCache;
+
+    /// Segmentation pipeline of the current SDF values, keeps the clustering between segmentations
+    std::shared_ptr<const SdfSegmentation> mSdfSegmentation;
+
+    static const size_t SEGMENTATION_CACHE_SIZE = 4;
+
+    /// Increased whenever the SDF values change, see getSdfValuesVersion()
+    size_t mSdfValuesVersion = 0;
+
+    /// Float hierarchy over the original triangles, to find intersections with rays generated by user mouse clicks
+    TriangleBvh mPickingTree;
+
+    /// mPickingTree was loaded from a project file and does not have to be rebuilt by recomputeFromData()
+    bool mIsPickingTreeLoaded = false;
 
-    /// AABB tree built over all triangles, including details. This tree is invalidated on every operation that changes
-    /// triangleDetail topology.
-    std::unique_ptr<Tree> mTreeDetailed;
+    /// Meshes of at least this many triangles get a simplified proxy of about SIMPLIFIED_MESH_TRIANGLES triangles
+    static const size_t SIMPLIFIED_MESH_MIN_TRIANGLES = 1000000;
+    static const size_t SIMPLIFIED_MESH_TRIANGLES = 250000;
+
+    /// Coarse proxy of a large mesh built by recomputeFromData(), its source triangles are the base triangles
+    MeshSimplifier::Mesh mSimplifiedMesh;
+
+    /// Decimated proxy the SDF values and the segmentation are computed on, see SdfSettings::proxyTriangleCount.
+    /// Built on demand by getSdfProxy(), shared with the SDF refinement.
+    std::shared_ptr<const SdfProxy> mSdfProxy;
+
+    /// Set by setThreadPool()
+    static inline ::ThreadPool* sThreadPool = nullptr;
+
+    /// Set by setSdfGpuCalculator(), read with std::atomic_load as the SDF is computed on the workers
+    static inline std::shared_ptr<SdfGpuCalculator> sSdfGpuCalculator;
+
+    /// SDF values of each triangle loaded from a project file, restored once the polyhedron is built
+    std::vector<double> mLoadedSdfValues;
+
+    /// Segmentations of mLoadedSdfValues loaded from a project file, restored together with them
+    std::vector<CachedSegmentation> mLoadedSegmentations;
+
+    /// Version of the derived data stored at the end of a .p3d project, data of other versions is recomputed.
+    /// Version 2 appends the SDF settings and the segmentation cache to the data of version 1.
+    /// Version 3 appends the order of the palette, which is kept even if the rest does not match the geometry.
+    /// Version 4 appends the proxy sizes of the SDF settings.
+    static constexpr uint32_t DERIVED_DATA_VERSION = 4;
+
+    /// Picking data of a single TriangleDetail, a 2D point location in the plane of its base triangle.
+    /// The detail triangles lie in that plane, they are projected into it and bucketed by a uniform grid.
+    struct DetailPicking {
+        /// 3 vertices for each detail triangle
+        std::vector<glm::vec3> vertices;
+
+        /// Origin and orthonormal axes of the plane of the base triangle
+        glm::vec3 origin{};
+        glm::vec3 axisX{};
+        glm::vec3 axisY{};
+
+        /// 3 vertices projected into the plane for each detail triangle
+        std::vector<glm::vec2> points;
+
+        /// Grid of gridSize x gridSize cells over the bounds of the points, the triangles overlapping cell i are
+        /// cellTriangles[cellStarts[i]] until cellTriangles[cellStarts[i + 1]]
+        glm::vec2 gridMin{};
+        glm::vec2 cellSize{};
+        uint32_t gridSize = 0;
+        std::vector<uint32_t> cellStarts;
+        std::vector<uint32_t> cellTriangles;
+
+        /// Build the picking from the plain vertices of the detail and the vertices of its base triangle
+        void build(std::vector<glm::vec3> detailVertices, const std::array<glm::vec3, 3>& baseVertices);
+
+        /// Detail triangle containing a point of the plane, none if float rounding left a gap there
+        std::optional<size_t> locate(const glm::vec3& point) const;
+
+        size_t getApproximateMemorySize() const;
+    };
+
+    /// Average number of detail triangles in a cell of DetailPicking
+    static const size_t DETAIL_PICKING_TRIANGLES_PER_CELL = 2;
+
+    /// The continuous highlight is kept while the brush center moves less than this fraction of the brush size
+    /// over the same triangle with the same settings
+    static constexpr float HIGHLIGHT_REUSE_DISTANCE = 0.02f;
+
+    /// Second level of picking in detailed mesh, mPickingTree finds the base triangle and this its detail triangle.
+    /// Only details in mDetailPickingDirty are rebuilt, so a stroke does not rebuild the picking of the whole mesh
+    /// and no hierarchy over the detailed mesh is needed.
+    std::map<size_t, DetailPicking> mDetailPicking;
+    std::set<size_t> mDetailPickingDirty;
+    bool mDetailPickingNeedsRebuild = true;
 
     // ----- Detailed Mesh Data ------
 
@@ -140,6 +395,111 @@ class Geometry {
     /// Map converting a face_descriptor into an ID
     PolyhedronData::Mesh::Property_map<PolyhedronData::face_descriptor, DetailedTriangleId> mMeshDetailedIdMap;
 
+    /**
+     *  Yes, we are about to hash floating point values.
+     *  These values come from CGAL exact kernel, so they should be bit-equal and safe to hash.
+     *  There is no betters way to get indices before this, as different color parts are stored in different polygons.
+     *  The bit patterns of the coordinates are mixed together, xor of per-coordinate hashes collides on symmetric
+     *  and axis-aligned positions, e.g. (a, b, c) and (b, a, c).
+     */
+    struct VertexPositionHash {
+        size_t operator()(const glm::vec3& vec) const {
+            uint64_t hash = 0x9E3779B97F4A7C15ull;
+            for(int i = 0; i < 3; ++i) {
+                // -0 equals 0, both have to hash the same
+                const float value = vec[i] == 0.f ? 0.f : vec[i];
+                uint32_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                hash = mix(hash ^ bits);
+            }
+            return static_cast<size_t>(hash);
+        }
+
+        /// Finalizer of SplitMix64, every input bit affects every output bit
+        static uint64_t mix(uint64_t value) {
+            value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+            value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+            return value ^ (value >> 31);
+        }
+    };
+
+    /// Vertices of mMeshDetailed by their position, patches of changed details reuse the vertices of neighbours
+    std::unordered_map<glm::vec3, PolyhedronData::vertex_descriptor, VertexPositionHash> mMeshDetailedVertexDescs;
+
+    /// Position of each vertex of mMeshDetailed, the key of the vertex in mMeshDetailedVertexDescs
+    std::vector<glm::vec3> mMeshDetailedVertexPositions;
+
+    /// Base triangles whose faces in mMeshDetailed no longer match their TriangleDetail
+    std::set<size_t> mMeshDetailedDirty;
+
+    /// Base triangles whose edges may need correctSharedVertices(), all edges of details if the flag is set
+    std::set<size_t> mSharedVerticesDirty;
+    bool mSharedVerticesNeedFullCorrection = true;
+
+    /// Labels of the connected regions of one color in mMeshDetailed, see getColorRegion().
+    /// Labelled on the first use, then only regions around changed triangles are labelled again.
+    struct ColorRegions {
+        static constexpr uint32_t NO_REGION = std::numeric_limits<uint32_t>::max();
+
+        /// Region of each face of mMeshDetailed by the face index, NO_REGION for faces not labelled yet
+        std::vector<uint32_t> faceRegions;
+
+        /// Faces of each region, empty for unused regions
+        std::vector<std::vector<PolyhedronData::face_descriptor>> regionFaces;
+
+        /// Indices of the unused regions in regionFaces
+        std::vector<uint32_t> freeRegions;
+
+        /// Regions that lost faces removed from mMeshDetailed
+        std::vector<uint32_t> brokenRegions;
+
+        /// Base triangles whose colors or faces changed since the last labelling
+        std::set<size_t> dirtyTriangles;
+
+        /// The labels match mMeshDetailed, apart from the changes listed above
+        bool isValid = false;
+
+        void clear() {
+            faceRegions.clear();
+            regionFaces.clear();
+            freeRegions.clear();
+            brokenRegions.clear();
+            dirtyTriangles.clear();
+            isValid = false;
+        }
+    };
+    ColorRegions mColorRegions;
+
+    /// Normals of the vertices of mMeshDetailed and its halfedges between colors, the data of the extruded export.
+    /// Computed on the first use, then only around the triangles changed since, in the same way as mColorRegions.
+    struct DetailedNormalsAndBorders {
+        /// Normal of each vertex by the vertex index, the normalized sum of the distinct normals of its faces
+        std::vector<glm::vec3> vertexNormals;
+
+        /// Whether each halfedge by the halfedge index has a face, and no face of the same color on its opposite side
+        std::vector<uint8_t> isColorBorder;
+
+        /// Base triangles whose colors or faces changed since the last update
+        std::set<size_t> dirtyTriangles;
+
+        /// Vertices and neighbouring faces of the faces removed from mMeshDetailed since the last update
+        std::vector<PolyhedronData::vertex_descriptor> dirtyVertices;
+        std::vector<PolyhedronData::face_descriptor> dirtyFaces;
+
+        /// The data matches mMeshDetailed, apart from the changes listed above
+        bool isValid = false;
+
+        void clear() {
+            vertexNormals.clear();
+            isColorBorder.clear();
+            dirtyTriangles.clear();
+            dirtyVertices.clear();
+            dirtyFaces.clear();
+            isValid = false;
+        }
+    };
+    DetailedNormalsAndBorders mDetailedNormalsAndBorders;
+
     // ----- END of Detailed Mesh Data ------
 
     /// AABB of the whole mesh
@@ -148,39 +508,98 @@ class Geometry {
     /// A vector based map mapping size_t into ci::ColorA
     ColorManager mColorManager;
 
+    /// Previous state of the triangles changed since beginDelta(), empty unless a delta is being recorded
+    std::optional<GeometryDelta> mRecordedDelta;
+    std::mutex mRecordedDeltaMutex;
+
+    /// Compresses the colors of cold snapshots, shared with the workers compressing them, see compressState()
+    std::shared_ptr<ColorChunkCompressor> mColorChunkCompressor = std::make_shared<ColorChunkCompressor>();
+
     /// Struct representing a highlight around user's cursor
     AreaHighlight mAreaHighlight;
 
     /// Current progress of import, tree, polyhedron building, export, etc.
     std::unique_ptr<GeometryProgress> mProgress;
 
+    /// Rays of the first SDF estimate, computeSdf() refines it with mSdfSettings in the background
+    static constexpr int COARSE_SDF_RAY_COUNT = 5;
+
+    /// SDF values computed in the background with the full settings, while the coarse values are already in use
+    struct SdfRefinement {
+        std::atomic<bool> isCancelled{false};
+        std::atomic<float> progress{0.0f};
+        SdfSettings settings;
+
+        /// Empty if cancelled or if the values could not be normalized
+        std::future<std::optional<std::vector<double>>> values;
+
+        /// Cancels the refinement and waits for the workers, they read the triangles, neighbours and mPickingTree
+        ~SdfRefinement();
+    };
+
+    /// Reset before the data read by the refinement changes, declared after it so it is destroyed first
+    std::unique_ptr<SdfRefinement> mSdfRefinement;
+
     struct GeometryState {
-        std::vector<size_t> triangleColors;
-        std::map<size_t, TriangleDetail> triangleDetails;
+        /// Colors of mTriangles, see TriangleStore::getPackedColorChunks(). Empty once compressed.
+        std::vector<TriangleStore::PackedColorChunk> triangleColorChunks;
+
+        /// Colors of a state compressed by compressState(), empty if it is not compressed
+        std::vector<ColorChunkCompressor::CompressedChunkRef> compressedColorChunks;
+        std::map<size_t, CopyOnWrite<TriangleDetail>> triangleDetails;
         ColorManager::ColorMap colorMap;
+        std::vector<size_t> colorOrder;
+    };
+
+    /// The state of the base triangles changed by a command before it ran, restored to undo it, see beginDelta()
+    struct GeometryDelta {
+        struct TriangleState {
+            size_t color = 0;
+
+            /// Shared with the details of the snapshots, empty if the triangle was simple
+            std::optional<CopyOnWrite<TriangleDetail>> detail;
+        };
+        std::map<size_t, TriangleState> triangles;
+
+        /// Nothing was changed while the delta was recorded
+        bool empty() const {
+            return triangles.empty();
+        }
     };
 
     friend class cereal::access;
 
    public:
     /// Empty constructor
-    Geometry() : mTree(std::make_unique<Tree>()), mProgress(std::make_unique<GeometryProgress>()) {}
+    Geometry() : mProgress(std::make_unique<GeometryProgress>()) {}
+
+    /// Sets the thread pool used by all Geometries for their parallel work, must be set before any is loaded.
+    /// The application sets its pool on startup, the tests and the benchmarks their own.
+    static void setThreadPool(::ThreadPool& threadPool) {
+        sThreadPool = &threadPool;
+    }
+
+    static ::ThreadPool& getThreadPool() {
+        P_ASSERT(sThreadPool != nullptr);
+        return *sThreadPool;
+    }
+
+    /// Sets the calculator tracing the SDF rays of all Geometries on the GPU, null traces them on the CPU.
+    /// Computations already running keep the calculator they started with.
+    static void setSdfGpuCalculator(std::shared_ptr<SdfGpuCalculator> calculator) {
+        std::atomic_store(&sSdfGpuCalculator, std::move(calculator));
+    }
 
     Geometry(std::vector<DataTriangle>&& triangles)
-        : mTriangles(std::move(triangles)), mProgress(std::make_unique<GeometryProgress>()) {
-        generateVertexBuffer();
+        : mTriangles(triangles), mProgress(std::make_unique<GeometryProgress>()) {
+        layoutOpenGlBuffers();
+        bindOpenGlStorage(nullptr);
+        fillOpenGlBuffers();
         generateTriangleBounds();
-        generateIndexBuffer();
-        generateColorBuffer();
-        generateNormalBuffer();
-        P_ASSERT(mOgl.indexBuffer.size() == mOgl.vertexBuffer.size());
+        P_ASSERT(mOgl.indexBuffer.size() == 3 * mOgl.colorBuffer.size());
         buildTree();
-        buildDetailedTree();
-
-        P_ASSERT(mTree->size() == mTriangles.size());
-        if(!mTree->empty()) {
-            mBoundingBox = std::make_unique<BoundingBox>(mTree->bbox());
-        }
+        updateDetailPicking();
+        P_ASSERT(mPickingTree.size() == mTriangles.size());
     }
 
     std::vector<glm::vec3>& getVertexBuffer() {
@@ -188,51 +607,92 @@ class Geometry {
     }
 
     bool polyhedronValid() const {
-        return mPolyhedronData.mMesh.is_valid() && mPolyhedronData.valid && !mPolyhedronData.mMesh.is_empty();
+        return mPolyhedronData.valid && !mPolyhedronData.faceNeighbours.empty();
     }
 
     size_t polyVertCount() const {
         return mPolyhedronData.vertices.size();
     }
 
+    /// Vertices of the base triangles with the identical ones joined, indexed by getPolyIndices()
+    const std::vector<glm::vec3>& getPolyVertices() const {
+        return mPolyhedronData.vertices;
+    }
+
+    /// Vertices of each base triangle in counter-clockwise order, in the order of the triangles if there is one for
+    /// each triangle
+    const std::vector<std::array<size_t, 3>>& getPolyIndices() const {
+        return mPolyhedronData.indices;
+    }
+
+    /// Returns a coarse proxy of the mesh, e.g., to draw it while the camera moves, nullptr for smaller meshes.
+    /// The source triangles of the proxy are base triangles, their positions do not change until the next load.
+    const MeshSimplifier::Mesh* getSimplifiedMesh() const {
+        return mSimplifiedMesh.indices.empty() ? nullptr : &mSimplifiedMesh;
+    }
+
     const OpenGlData& getOpenGlData() const {
-        // Since we use a new vertex for each triangle, we should have vertices == triangles
-        P_ASSERT(mOgl.indexBuffer.size() == mOgl.vertexBuffer.size());
-        P_ASSERT(mOgl.vertexBuffer.size() == mOgl.normalBuffer.size());
-        P_ASSERT(!mAreaHighlight.enabled || (mOgl.highlightMask.size() == mOgl.vertexBuffer.size()));
-        P_ASSERT(mOgl.colorBuffer.size() == mOgl.vertexBuffer.size());
+        // Color and base triangle are stored per face, each face has 3 indices
+        P_ASSERT(mOgl.colorBuffer.size() == mOgl.faceCount);
+        P_ASSERT(mOgl.isMapped || mOgl.indexBuffer.size() == 3 * mOgl.faceCount);
+        P_ASSERT(mOgl.isMapped || mOgl.faceTriangles.size() == mOgl.faceCount);
+        P_ASSERT(mOgl.isMapped || mOgl.vertexBuffer.size() == mOgl.vertexCount);
+        P_ASSERT(!mAreaHighlight.enabled || (mOgl.highlightMask.size() == getHighlightMaskSize(mTriangles.size())));
 
         return mOgl;
     }
 
-    /// Update buffers used by openGl. Should only be called when they are dirty
-    void updateOpenGlBuffers() {
-        P_ASSERT(mOgl.isDirty);  // Called unnecessarily. Most likely by error.
+    /// Update buffers used by openGl. Should only be called when they are dirty.
+    /// Only the parts of the buffers belonging to modified triangles are rewritten, unless the layout is invalid.
+    /// @param storage Mapped GPU buffers to write the vertices, indices and face triangles to instead of the vectors
+    /// of OpenGlData, if not null. Switching between the storage and the vectors generates all of the buffers again.
+    void updateOpenGlBuffers(OpenGlData::MappedStorage* storage = nullptr);
+
+    /// Force generation of all buffers from scratch on the next update, e.g., when the MappedStorage the buffers
+    /// were written to holds another Geometry now
+    void invalidateOpenGlBuffers() {
+        mOglNeedsRebuild = true;
+        mOglDirtyDetails.clear();
+        mOgl.isDirty = true;
+    }
 
-        const auto start = std::chrono::high_resolution_clock::now();
+    /// Bounding box of the used faces [faceBegin, faceEnd) of the buffers, computed from the triangles and their
+    /// details, so it does not need the vertices or indices. The box is empty (min > max) if there are none.
+    std::pair<glm::vec3, glm::vec3> getOpenGlFaceBounds(size_t faceBegin, size_t faceEnd) const;
 
-        generateVertexBuffer();
-        generateIndexBuffer();
-        generateColorBuffer();
-        generateNormalBuffer();
-        generateHighlightBuffer();
+    /// Make the detailed mesh match the TriangleDetails, correcting their shared vertices first.
+    /// Only details changed since the last call are patched, building it after a load or undo is a slow operation.
+    /// Picking does not need the detailed mesh, only bucket painting and export do.
+    /// @param isCancelled Checked while the mesh is built from scratch, if not null. A cancelled build leaves no
+    /// detailed mesh, so the next call builds it again.
+    void updateDetailedMesh(const std::atomic<bool>* isCancelled = nullptr);
 
-        mOgl.isDirty = false;
-        mOgl.info.didColorUpdate = false;
-        mOgl.info.didHighlightUpdate = false;
+    bool isDetailedMeshValid() const {
+        return mMeshDetailed != nullptr && mMeshDetailedDirty.empty() && !needsSharedVertexCorrection();
+    }
 
-        const auto end = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<double, std::milli> timeMs = end - start;
+    /// Update the detailed mesh and its vertex normals and color borders, only around the triangles changed since
+    /// the last call
+    /// @param isCancelled Passed to updateDetailedMesh(), if not null
+    void updateDetailedNormalsAndBorders(const std::atomic<bool>* isCancelled = nullptr);
 
-        CI_LOG_I("Generating buffers took " + std::to_string(timeMs.count()) + " ms");
+    bool areDetailedNormalsAndBordersValid() const {
+        const auto& data = mDetailedNormalsAndBorders;
+        return isDetailedMeshValid() && data.isValid && data.dirtyTriangles.empty() && data.dirtyVertices.empty() &&
+               data.dirtyFaces.empty();
     }
 
-    /// Update temporary detailed data like detailed AABB tree and detailed Mesh
-    /// This is a slow operation
-    void updateTemporaryDetailedData();
+    /// Normal of each vertex of the detailed mesh by the vertex index, valid after updateDetailedNormalsAndBorders()
+    const std::vector<glm::vec3>& getMeshDetailedVertexNormals() const {
+        P_ASSERT(areDetailedNormalsAndBordersValid());
+        return mDetailedNormalsAndBorders.vertexNormals;
+    }
 
-    bool isTemporaryDetailedDataValid() const {
-        return mMeshDetailed && mTreeDetailed;
+    /// Whether the halfedge of the detailed mesh has a face, and its opposite halfedge has no face or a face of
+    /// another color. Valid after updateDetailedNormalsAndBorders().
+    bool isMeshDetailedColorBorder(const PolyhedronData::halfedge_descriptor halfedge) const {
+        P_ASSERT(areDetailedNormalsAndBordersValid());
+        return mDetailedNormalsAndBorders.isColorBorder[static_cast<size_t>(halfedge)] != 0;
     }
 
     glm::vec3 getBoundingBoxMin() const {
@@ -257,12 +717,16 @@ class Geometry {
         mAreaHighlight.enabled = false;
     }
 
-    const DataTriangle& getTriangle(const size_t triangleIndex) const {
+    /// Highlight whole base triangles instead of the area under the brush, e.g., the region a fill would paint.
+    /// Detail triangles are highlighted with their base triangle. Replaced by the next highlightArea().
+    void highlightTriangles(const std::vector<size_t>& triangles);
+
+    TriangleView getTriangle(const size_t triangleIndex) const {
         P_ASSERT(triangleIndex < mTriangles.size());
-        return mTriangles[triangleIndex];
+        return TriangleView(mTriangles, triangleIndex);
     }
 
-    const DataTriangle& getTriangle(const DetailedTriangleId triangleId) const {
+    TriangleView getTriangle(const DetailedTriangleId triangleId) const {
         const size_t baseId = triangleId.getBaseId();
         const std::optional<size_t> detailId = triangleId.getDetailId();
 
@@ -270,14 +734,14 @@ class Geometry {
         if(detailId) {
             P_ASSERT(!isSimpleTriangle(baseId));
             P_ASSERT(*detailId < getTriangleDetailCount(baseId));
-            return mTriangleDetails.at(baseId).getTriangles()[*detailId];
+            return TriangleView((*findTriangleDetail(baseId))->getTriangles(), *detailId);
         } else {
-            return mTriangles[baseId];
+            return TriangleView(mTriangles, baseId);
         }
     }
 
     size_t getTriangleColor(const size_t triangleIndex) const {
-        return getTriangle(triangleIndex).getColor();
+        return mTriangles.getColor(triangleIndex);
     }
 
     size_t getTriangleColor(const DetailedTriangleId triangleId) const {
@@ -299,8 +763,7 @@ class Geometry {
 
     bool isSimpleTriangle(size_t triangleIdx) const {
         // Triangle is single color when it has no detail triangles
-        auto it = mTriangleDetails.find(triangleIdx);
-        return it == mTriangleDetails.end();
+        return findTriangleDetail(triangleIdx) == nullptr;
     }
 
     const GeometryProgress& getProgress() const {
@@ -326,15 +789,32 @@ class Geometry {
         return mMeshDetailedIdMap;
     }
 
+    /// Position of each vertex of the detailed mesh by the vertex index, the same floats as the vertices of the
+    /// triangles
+    const std::vector<glm::vec3>& getMeshDetailedVertexPositions() const {
+        return mMeshDetailedVertexPositions;
+    }
+
     /// Loads new geometry into the private data, rebuilds the buffers and other data structures automatically.
     void loadNewGeometry(const std::string& fileName);
 
     /// Set new triangle color.
     void setTriangleColor(const size_t triangleIndex, const size_t newColor);
 
+    /// Set the color of many whole base triangles, the same as setTriangleColor() for each of them.
+    /// The indices are sorted and deduplicated first, so that the colors are written in runs of consecutive faces and
+    /// the state of the triangles for undo is recorded at once.
+    void setTriangleColors(std::vector<size_t> triangleIndices, size_t newColor);
+
     /// Set new triangle color.
+    /// Call compactTriangleDetails() after a batch of these, a detail that got a single color can be removed then.
     void setTriangleColor(const DetailedTriangleId triangleId, const size_t newColor);
 
+    /// Replace details painted since the last call that ended up with a single color by simple triangles.
+    /// A detail sharing vertices on an edge with a neighbouring detail stays, unless both are replaced.
+    /// Detail triangles are never renumbered, only whole details disappear.
+    void compactTriangleDetails();
+
     /// Intersects the mesh with the given ray and returns the index of the triangle intersected, if it exists.
     /// Example use: generate ray based on a mouse click, call this method, then call setTriangleColor.
     std::optional<size_t> intersectMesh(const ci::Ray& ray) const;
@@ -347,39 +827,75 @@ class Geometry {
     /// Intersects the detailed mesh with the given ray and returns the ID of the triangle intersected, if it exists.
     std::optional<DetailedTriangleId> intersectDetailedMesh(const ci::Ray& ray);
 
+    /// All triangles of the connected region of one color containing startTriangle, the same triangles as a
+    /// bucket() stopping on different colors. Regions are labelled on the first call and later calls only label
+    /// the regions around triangles changed in between, so a call is usually just a lookup.
+    std::vector<DetailedTriangleId> getColorRegion(const DetailedTriangleId startTriangle);
+
+    /// Returns the ID of the triangle displayed by a face of the OpenGL buffers, e.g. read from a picking buffer.
+    /// Returns nothing for faces that display no triangle (degenerate or unused faces).
+    /// Valid only while the OpenGL data is not dirty.
+    std::optional<DetailedTriangleId> getTriangleIdOfFace(size_t face) const;
+
     /// Highlight an area around the intersection point. All points on a continuous surface closer than the size are
     /// highlighted.
     void highlightArea(const ci::Ray& ray, const struct BrushSettings& settings);
 
+    /// Highlight an area around the hit of the ray already intersected with the mesh, e.g., by the pick of the
+    /// ModelView, see highlightArea(). Nothing is highlighted without a hit triangle.
+    void highlightArea(const ci::Ray& ray, std::optional<size_t> hitTriangle, const glm::vec3& hitPoint,
+                       const struct BrushSettings& settings);
+
     /// Paint area with a shaped brush
     /// @param ray Ray along which to project the shape, using orthogonal projection
     /// @param shape Points in world space representing a polygonal shape
     void paintWithShape(const ci::Ray& ray, const std::vector<Point3>& shape, size_t color,
                         bool paintBackfaces = false);
 
-    /// Paint area with a shaped brush
-    /// @param ray Ray along which to project the shape, using orthogonal projection
-    /// @param triangles Triangles in world space representing the shape
-    void paintWithShape(const ci::Ray& ray, const std::vector<DataTriangle::Triangle>& triangles, size_t color);
+    /// Paint a stroke of shapes, the same as calling paintWithShape() for each shape.
+    /// Each triangle detail is painted once with the union of all the shapes touching it.
+    /// @param directions Direction of the projection of each shape
+    /// @param shapes Points in world space representing a polygonal shape, one for each direction
+    void paintWithShapes(const std::vector<glm::vec3>& directions, const std::vector<std::vector<Point3>>& shapes,
+                         size_t color, bool paintBackfaces = false);
+
+    /// Paint a text, the same as painting the union of the triangles of each letter with a shaped brush.
+    /// Each letter is joined once, and each triangle detail is painted once with the letters touching it.
+    /// @param ray Ray along which to project the text, using orthogonal projection
+    /// @param letters Triangles in world space representing each letter
+    void paintWithText(const ci::Ray& ray, const std::vector<std::vector<DataTriangle::Triangle>>& letters,
+                       size_t color);
 
     /// Paint continuous spherical area with a brush of specified size
     void paintAreaWithSphere(const ci::Ray& ray, const BrushSettings& settings);
 
+    /// Paint a stroke of spherical dabs, the same as calling paintAreaWithSphere() for each ray.
+    /// Rays are traced together and each triangle detail is painted once with all the dabs touching it.
+    /// With BrushSettings::sweptStroke, the hits of consecutive rays are connected by capsules instead, hits at most
+    /// SWEPT_STROKE_MAX_GAP brush sizes apart.
+    void paintAreaWithSpheres(const std::vector<ci::Ray>& rays, const BrushSettings& settings);
+
+    /// Longest segment of a swept stroke in brush sizes, hits farther apart are painted as separate dabs, so that a
+    /// stroke jumping between parts of the model does not paint across the gap
+    static constexpr float SWEPT_STROKE_MAX_GAP = 10.f;
+
     /// Change all color ID's from one to another
     /// @param ColorFunc functor of type size_t func(size_t originalColor), that returns the new color ID
     template <typename ColorFunc>
     void changeColorIds(const ColorFunc& colorFunc) {
         for(size_t i = 0; i < getTriangleCount(); ++i) {
             if(isSimpleTriangle(i)) {
-                const auto& triangle = getTriangle(i);
-                setTriangleColor(i, colorFunc(triangle.getColor()));
+                setTriangleColor(i, colorFunc(mTriangles.getColor(i)));
             } else {
                 TriangleDetail* triDetail = getTriangleDetail(i);
                 triDetail->changeColorIds(colorFunc);
             }
         }
 
-        mOgl.isDirty = true;
+        // Colors may merge, label all regions again
+        mColorRegions.clear();
+        mDetailedNormalsAndBorders.clear();
+        invalidateOpenGlBuffers();
     }
 
     /// Save current state into a struct so that it can be restored later (CommandManager target requirement)
@@ -388,6 +904,99 @@ class Geometry {
     /// Load previous state from a struct (CommandManager target requirement)
     void loadState(const GeometryState&);
 
+    /// Approximate memory taken by a saved state in bytes, used by CommandManager to limit the undo memory.
+    /// Data shared with the current geometry or other states is split evenly between its owners at the time of call.
+    size_t getStateMemorySize(const GeometryState& state) const;
+
+    /// Compress a saved state that is rarely loaded, on a worker in the background (CommandManager target option).
+    /// Only the colors are compressed, the details stay shared with the geometry. loadState() decompresses them.
+    std::future<GeometryState> compressState(const GeometryState& state) const;
+
+    /// Record the previous state of each base triangle changed from now until endDelta(), only the colors and the
+    /// details of the triangles are recorded, not the palette (CommandManager target requirement)
+    /// @param delta Delta to extend, the triangles it already has keep their recorded state
+    void beginDelta(GeometryDelta delta);
+
+    /// Stop recording and return the recorded delta
+    GeometryDelta endDelta();
+
+    /// Restore the triangles of the delta to their recorded state, undoing everything changed since beginDelta()
+    void undoDelta(const GeometryDelta& delta);
+
+    /// Approximate memory taken by a delta in bytes, shared details are split like in getStateMemorySize()
+    size_t getDeltaMemorySize(const GeometryDelta& delta) const;
+
+    /// Copy of everything saved into a .p3d project, so that it can be written on a worker while the Geometry is
+    /// painted on. The details are shared with the Geometry like in saveState().
+    struct ProjectSnapshot {
+        ColorManager colorManager;
+        TriangleStore triangles;
+        std::map<size_t, CopyOnWrite<TriangleDetail>> triangleDetails;
+        std::vector<glm::vec3> vertices;
+        std::vector<std::array<size_t, 3>> indices;
+        TriangleBvh pickingTree;
+        std::vector<uint32_t> faceAdjacency;
+        std::vector<double> sdfValues;
+        SdfSettings sdfSettings;
+        SdfSettings sdfValuesSettings;
+        std::vector<CachedSegmentation> segmentations;
+
+        /// Hash of the geometry the derived data was computed from, set when the snapshot is read from a file
+        std::optional<uint64_t> derivedDataHash;
+
+        /// Hash of the geometry of the snapshot, see Geometry::computeDerivedDataHash()
+        uint64_t computeDerivedDataHash() const {
+            return Geometry::computeDerivedDataHash(triangles.getVertices(), vertices, indices);
+        }
+
+        /// Writes the project in the format read by Geometry::load(), only reads the snapshot
+        template <class Archive>
+        void save(Archive& saveArchive) const;
+    };
+
+    /// Copy the project to save it later, from any thread. The details are lazy copies that share no exact kernel
+    /// objects with the Geometry, see TriangleDetail::createLazyCopy().
+    ProjectSnapshot createProjectSnapshot() const;
+
+    /// Copy of the data read by ModelExporter, so that the files can be exported on a worker while the Geometry is
+    /// painted on. The details are shared with the Geometry like in saveState(), the detailed mesh with its normals
+    /// and borders is copied. The copy has no buffers, trees or connectivity, it is only meant for the export.
+    std::shared_ptr<const Geometry> createExportSnapshot() const;
+
+    /// Load a project read from a file, e.g., by ProjectFile::read(). The derived data is used only if its hash
+    /// matches the geometry, otherwise it is recomputed. Call recomputeFromData() afterwards, same as after load().
+    void loadProjectSnapshot(ProjectSnapshot&& snapshot);
+
+    /// Approximate memory taken by the main parts of the Geometry in bytes
+    struct MemoryUsage {
+        /// mTriangles
+        size_t triangles = 0;
+
+        /// mTriangleDetailSlots including the exact polygons of the details, details shared with undo snapshots are
+        /// split evenly between their owners like in getStateMemorySize()
+        size_t triangleDetails = 0;
+
+        /// CPU copies of the OpenGL buffers and the simplified mesh, the GPU buffers are measured by the ModelView
+        size_t openGlBuffers = 0;
+
+        /// mPickingTree, mTriangleBoundsTree and mDetailPicking
+        size_t pickingTrees = 0;
+
+        /// mPolyhedronData, the Surface_mesh of the base triangles is not kept after the build
+        size_t polyhedron = 0;
+
+        /// mMeshDetailed and its face lookup
+        size_t detailedMesh = 0;
+
+        size_t getTotal() const {
+            return triangles + triangleDetails + openGlBuffers + pickingTrees + polyhedron + detailedMesh;
+        }
+    };
+
+    /// Measures the memory taken by the Geometry, walks all triangle details.
+    /// Must not be called while another thread modifies the Geometry.
+    MemoryUsage getMemoryUsage() const;
+
     /// Spreads as BFS, starting from startTriangle to wherever it can reach.
     /// Stopping is handled by the StoppingCondition functor/lambda.
     /// A vector of reached triangle indices is returned;
@@ -401,23 +1010,79 @@ class Geometry {
     template <typename StoppingCondition>
     std::vector<size_t> bucket(const std::vector<size_t>& startTriangles, const StoppingCondition& stopFunctor);
 
+    /// Meshes with fewer triangles are filled by bucket(), the BFS levels are too small to split between threads
+    static constexpr size_t PARALLEL_BUCKET_MIN_TRIANGLES = 1 << 14;
+
+    /// Same as bucket(), but the BFS runs level by level, with each level split between the threads of the pool.
+    /// Meant for fills expected to cover large parts of the mesh. The same triangles are reached, they are
+    /// returned level by level and sorted by index within each level.
+    /// The stopping functor is called concurrently from several threads, so it may only read shared data.
+    template <typename StoppingCondition>
+    std::vector<DetailedTriangleId> parallelBucket(const DetailedTriangleId startTriangle,
+                                                   const StoppingCondition& stopFunctor, ::ThreadPool& threadPool);
+
+    template <typename StoppingCondition>
+    std::vector<size_t> parallelBucket(const std::vector<size_t>& startTriangles,
+                                       const StoppingCondition& stopFunctor, ::ThreadPool& threadPool);
+
     /// Spread as BFS from starting triangle, until the limits of brush settings are reached
     std::vector<size_t> getTrianglesUnderBrush(const glm::vec3& originPoint, const glm::vec3& insideDirection,
                                                size_t startTriangle, const struct BrushSettings& settings);
 
+    /// Triangles under a segment of a swept brush stroke from start to end, with their coverage by the capsule.
+    /// Spreads from the starting triangle if the brush is continuous, like getTrianglesUnderBrush().
+    std::vector<std::pair<size_t, SphereCoverage>> getTrianglesUnderStroke(const glm::vec3& start,
+                                                                           const glm::vec3& end,
+                                                                           const glm::vec3& insideDirection,
+                                                                           size_t startTriangle,
+                                                                           const struct BrushSettings& settings);
+
+    /// Cosine of the angle between the normals of two triangles, cached for neighbours across an edge.
+    /// Details of a triangle lie in its plane, so neighbouring detailed triangles use the value of their bases.
+    float getNeighbourCosine(const size_t triangleIdx, const size_t neighbourIdx) const;
+
+    /// Triangles across the 3 edges of each triangle, PolyhedronData::NO_NEIGHBOUR for border edges
+    const std::vector<std::array<uint32_t, 3>>& getFaceNeighbours() const {
+        return mPolyhedronData.faceNeighbours;
+    }
+
+    /// Cosines of the angles between the normals of each triangle and its getFaceNeighbours()
+    const std::vector<std::array<float, 3>>& getFaceNeighbourCosines() const {
+        return mPolyhedronData.faceNeighbourCosines;
+    }
+
+    /// Colors of the base triangles in immutable chunks shared until a color in them changes, see
+    /// TriangleStore::getPackedColorChunks(). Cheap to take, e.g., to read the colors on a worker thread.
+    std::vector<TriangleStore::PackedColorChunk> getPackedTriangleColors() const {
+        return mTriangles.getPackedColorChunks();
+    }
+
+    float getNeighbourCosine(const DetailedTriangleId triangle, const DetailedTriangleId neighbour) const {
+        if(triangle.getBaseId() == neighbour.getBaseId()) {
+            return 1.f;
+        }
+        return getNeighbourCosine(triangle.getBaseId(), neighbour.getBaseId());
+    }
+
     /// Get all triangles that are closer to the object than radius
     /// This function operates on spherical bounds of triangles and may therefore return false positives
     /// @param object CGAL Object - point, line, etc
     template <typename Object>
     std::vector<size_t> getTrianglesInRadius(const Object& object, double radius) const {
         P_ASSERT(mTriangleBounds.size() == mTriangles.size());
+        P_ASSERT(mTriangleBoundsTree.size() == mTriangleBounds.size());
         std::vector<size_t> result;
 
-        for(size_t triIdx = 0; triIdx < mTriangleBounds.size(); ++triIdx) {
+        const auto squaredDistance = [&object](const glm::dvec3& point) {
+            return CGAL::to_double(CGAL::squared_distance(object, Point3(point.x, point.y, point.z)));
+        };
+        mTriangleBoundsTree.query(radius, squaredDistance, [&](const size_t triIdx) {
             if(isTriangleInRadius(object, radius, triIdx))
                 result.push_back(triIdx);
-        }
+        });
 
+        // Keep the order of the triangle indices
+        std::sort(result.begin(), result.end());
         return result;
     }
 
@@ -429,8 +1094,9 @@ class Geometry {
         P_ASSERT(triangleIdx < mTriangleBounds.size());
         P_ASSERT(mTriangleBounds.size() == mTriangles.size());
 
-        const Point3& sphereCenter = mTriangleBounds[triangleIdx].first;
-        const double sphereRadius = mTriangleBounds[triangleIdx].second;
+        const glm::vec3 center = mTriangleBounds.getCenter(triangleIdx);
+        const Point3 sphereCenter(center.x, center.y, center.z);
+        const double sphereRadius = mTriangleBounds.getRadius(triangleIdx);
 
         // Any sphere in contact with the cylinder is going to have this max squared distance
         const double distanceLimitSquared = (radius + sphereRadius) * (radius + sphereRadius);
@@ -448,33 +1114,98 @@ class Geometry {
         computeSdf();
     }
 
+    /// Meshes of at least this many triangles offer computing the SDF on a proxy, of SDF_PROXY_TRIANGLES by default
+    static const size_t SDF_PROXY_MIN_TRIANGLES = 1000000;
+    static const size_t SDF_PROXY_TRIANGLES = 200000;
+
+    /// Segmentations of at least this many triangles are smoothed by a parallel label propagation instead of the
+    /// graph cut, see SdfSegmentation::Smoothing
+    static const size_t SEGMENTATION_PROPAGATION_MIN_TRIANGLES = 500000;
+
+    /// Quality of the SDF values computed next time
+    const SdfSettings& getSdfSettings() const {
+        return mSdfSettings;
+    }
+
+    void setSdfSettings(const SdfSettings& settings) {
+        mSdfSettings = settings;
+    }
+
+    /// The coarse SDF values are in use and the values with the full settings are being computed
+    bool isSdfRefining() const {
+        return mSdfRefinement != nullptr;
+    }
+
+    /// Progress of the refinement from 0 to 1, only valid while isSdfRefining()
+    float getSdfRefinementProgress() const {
+        P_ASSERT(mSdfRefinement != nullptr);
+        return mSdfRefinement->progress;
+    }
+
+    /// Stop the refinement, the coarse values stay in use
+    void cancelSdfRefinement() {
+        if(mSdfRefinement != nullptr) {
+            mSdfRefinement->isCancelled = true;
+        }
+    }
+
+    /// Replace the SDF values with the refined ones once they are ready, called from the main thread between slow
+    /// operations. Returns true if the values have changed.
+    bool updateSdfRefinement();
+
     /// Segmentation algorithms will not work if SDF values are not pre-computed
     bool isSdfComputed() const {
-        if(mPolyhedronData.sdf_property_map == nullptr) {
+        if(mPolyhedronData.sdfValues.empty()) {
             return false;
         } else {
-            P_ASSERT(mPolyhedronData.indices.size() == static_cast<size_t>(mPolyhedronData.sdf_property_map.end() -
-                                                                           mPolyhedronData.sdf_property_map.begin()));
+            P_ASSERT(mPolyhedronData.indices.size() == mPolyhedronData.sdfValues.size());
             return mPolyhedronData.isSdfComputed;
         }
     }
 
     /// Once SDF is computed, segment the whole SurfaceMesh automatically
-    size_t segmentation(const int numberOfClusters, const float smoothingLambda,
-                        std::map<size_t, std::vector<size_t>>& segmentToTriangleIds,
-                        std::unordered_map<size_t, size_t>& triangleToSegmentMap) {
-        return segment(numberOfClusters, smoothingLambda, segmentToTriangleIds, triangleToSegmentMap);
+    /// @param segments Replaced by the segments of the triangles if the segmentation succeeds
+    /// @param isCancelled Checked by the graph cut, if not null. A cancelled segmentation returns 0 segments.
+    size_t segmentation(const int numberOfClusters, const float smoothingLambda, SegmentMap& segments,
+                        const std::atomic<bool>* isCancelled = nullptr) {
+        return segment(numberOfClusters, smoothingLambda, segments, isCancelled);
+    }
+
+    /// Segmentation pipeline of the current SDF values, null if they are not computed. It owns copies of its data,
+    /// so it can segment on worker threads while the Geometry changes.
+    std::shared_ptr<const SdfSegmentation> getSdfSegmentation();
+
+    /// Keep segments computed by getSdfSegmentation(), segmentation() with the same parameters returns them.
+    /// Ignored if the SDF values have changed since.
+    void cacheSegmentation(const std::shared_ptr<const SdfSegmentation>& sdfSegmentation, int numberOfClusters,
+                           float smoothingLambda, SdfSegmentation::Segments segments);
+
+    /// Changes whenever the SDF values change, so tools can tell when data derived from them is stale
+    size_t getSdfValuesVersion() const {
+        return mSdfValuesVersion;
     }
 
     double getSdfValue(const size_t triangleIndex) const {
-        P_ASSERT(triangleIndex < mPolyhedronData.mFaceDescs.size());
+        P_ASSERT(triangleIndex < mPolyhedronData.sdfValues.size());
         P_ASSERT(triangleIndex < mTriangles.size());
-        PolyhedronData::face_descriptor faceDescForTri = mPolyhedronData.mFaceDescs[triangleIndex];
-        return mPolyhedronData.sdf_property_map[faceDescForTri];
+        return mPolyhedronData.sdfValues[triangleIndex];
     }
 
+    /// Builds the buffers, the polyhedron and the trees from the loaded data. The buffers and the bounding box are
+    /// done first and marked by GeometryProgress::buffersPercentage, the geometry can be displayed from then on,
+    /// while the rest is still being built.
     void recomputeFromData();
 
+    /// Reorders the imported triangles and the faces of the polyhedron data along a Morton curve, so that ranges of
+    /// the buffers are spatially compact and ModelView can cull them. Call before anything is computed from them.
+    void reorderTrianglesSpatially();
+
+    /// Hash of the triangles and the polyhedron, the same for the same model loaded again, e.g., to check that a
+    /// recorded session is replayed on the model it was recorded on
+    uint64_t getModelHash() const {
+        return computeDerivedDataHash();
+    }
+
     /// Get number of detailed triangles for this baseId
     size_t getTriangleDetailCount(const DetailedTriangleId triangleIndex) const {
         return getTriangleDetailCount(triangleIndex.getBaseId());
@@ -482,11 +1213,11 @@ class Geometry {
 
     /// Get number of detailed triangles for this baseId
     size_t getTriangleDetailCount(const size_t triangleIndex) const {
-        auto it = mTriangleDetails.find(triangleIndex);
-        if(it == mTriangleDetails.end()) {
+        const CopyOnWrite<TriangleDetail>* detail = findTriangleDetail(triangleIndex);
+        if(detail == nullptr) {
             return 0;
         } else {
-            return it->second.getTriangles().size();
+            return (*detail)->getTriangles().size();
         }
     }
 
@@ -495,82 +1226,303 @@ class Geometry {
     }
 
    private:
-    /// Generates the vertex buffer linearly - adding each vertex of each triangle as a new one.
-    /// We need to do this because each triangle has to be able to be colored differently, therefore no vertex
-    /// sharing is possible.
-    void generateVertexBuffer();
+    /// Generates all of the buffers used by openGl from scratch, into the storage if not null
+    void generateOpenGlBuffers(OpenGlData::MappedStorage* storage);
 
-    /// Generating a linear index buffer, since we do not reuse any vertices.
-    void generateIndexBuffer();
+    /// Lays out the buffers - the shared vertices of the original mesh followed by a slot for each detail.
+    /// Colors are stored per face, so the simple triangles can share their vertices.
+    void layoutOpenGlBuffers();
 
-    /// Generating triplets of colors, since we only allow a single-colored triangle.
-    void generateColorBuffer();
+    /// Points mOglVertices, mOglIndices and mOglFaceTriangles to the storage, or to the vectors of mOgl resized to
+    /// mOgl.vertexCount and mOgl.faceCount if the storage is null. The color buffer is always resized.
+    /// Returns false if the storage lost its previous contents.
+    bool bindOpenGlStorage(OpenGlData::MappedStorage* storage);
 
-    /// Generate a buffer of normals. Generates only "triangle normals" - all three vertices have the same normal.
-    void generateNormalBuffer();
+    /// Fills the vertices, indices, colors and base triangles of all faces in one parallel pass over the triangles.
+    /// The faces of triangles with a detail and unused faces are degenerate.
+    void fillOpenGlBuffers();
 
-    /// Generate a buffer of highlight information. Saves per-triangle data to each vertex
+    /// Generate the highlight bitset of the base triangles. Detail triangles use the bit of their base triangle.
     void generateHighlightBuffer();
 
     /// Generate spherical bounds for each original triangle. Used to speed up capsule querries.
     void generateTriangleBounds();
 
+    /// Rewrite only the parts of the buffers that belong to mOglDirtyDetails, moving details that outgrew their slot
+    /// to the end of the buffers. Returns false without writing anything if the storage lost its contents.
+    bool updateDirtyDetailBuffers(OpenGlData::MappedStorage* storage);
+
+    /// Write the face of a simple triangle to the index, color and face triangle buffers
+    void writeBaseFace(size_t triangleIdx);
+
+    /// Write a single detail triangle of the base triangle to all buffers, as the detailIdx-th face of the slot
+    void writeDetailFace(const DetailBufferSlot& slot, size_t detailIdx, const TriangleDetail& detail,
+                         size_t triangleIdx);
+
+    /// Make faces [faceBegin, faceEnd) degenerate
+    void clearFaceRange(size_t faceBegin, size_t faceEnd);
+
+    /// Indices of the vertices of a simple triangle in the vertex buffer
+    std::array<uint32_t, 3> getBaseFaceIndices(size_t triangleIdx) const;
+
+    /// Value of the highlight mask for the base triangle and all of its detail triangles
+    bool getHighlightMaskValue(size_t triangleIdx) const;
+
+    /// Rewrite the highlight bit of the base triangle in place, it is shared by all of its detail triangles
+    void setHighlightMask(size_t triangleIdx, bool highlight);
+
+    /// Number of elements of the highlight bitset for the number of base triangles
+    static size_t getHighlightMaskSize(size_t triangleCount) {
+        return (triangleCount + 31) / 32;
+    }
+
+    /// Write a color of a single face to the color buffer, in place
+    void setColorBufferFace(size_t face, size_t color);
+
+    /// Number of triangles reserved in the buffers for a detail, leaving space to grow without moving it
+    static size_t getDetailBufferCapacity(size_t detailTriangleCount) {
+        return detailTriangleCount + detailTriangleCount / 2 + 4;
+    }
+
+    /// Schedule buffer update of the base triangle and its TriangleDetail
+    void markDetailDirty(size_t triangleIdx) {
+        markColorRegionDirty(triangleIdx);
+        mOglDirtyDetails.insert(triangleIdx);
+        mDetailPickingDirty.insert(triangleIdx);
+        mMeshDetailedDirty.insert(triangleIdx);
+        mSharedVerticesDirty.insert(triangleIdx);
+        mOgl.isDirty = true;
+    }
+
+    /// The colors of the triangle changed, its color regions and color borders have to be updated again
+    void markColorRegionDirty(size_t triangleIdx) {
+        if(mColorRegions.isValid) {
+            mColorRegions.dirtyTriangles.insert(triangleIdx);
+        }
+        if(mDetailedNormalsAndBorders.isValid) {
+            mDetailedNormalsAndBorders.dirtyTriangles.insert(triangleIdx);
+        }
+    }
+
+    /// Label the color regions of mMeshDetailed that changed since the last call, or all of them
+    void updateColorRegions();
+
+    /// Normalized sum of the distinct normals of the faces of the vertex in mMeshDetailed
+    glm::vec3 computeDetailedVertexNormal(PolyhedronData::vertex_descriptor vertex) const;
+
     /// Build the CGAL Polyhedron construct in mPolyhedronData. Takes a bit of time to rebuild.
     void buildPolyhedron();
 
-    /// Builds AABB tree over the original mesh
+    /// Builds the picking hierarchy and the bounding box of the original mesh
     void buildTree();
 
-    /// Build AABB Tree over all triangles including details.
-    void buildDetailedTree();
+    void computeBoundingBox();
+
+    /// Fill the SDF property map from mLoadedSdfValues and the segmentation cache from mLoadedSegmentations if they
+    /// match the polyhedron
+    void restoreLoadedSdfValues();
+
+    /// SDF value of each triangle, empty if the SDF values were not computed
+    std::vector<double> getSdfValuesToSave() const;
+
+    /// Hash of the geometry the derived data is computed from, to reject derived data of a different mesh
+    uint64_t computeDerivedDataHash() const {
+        return computeDerivedDataHash(mTriangles.getVertices(), mPolyhedronData.vertices, mPolyhedronData.indices);
+    }
+
+    static uint64_t computeDerivedDataHash(const std::vector<glm::vec3>& triangleVertices,
+                                           const std::vector<glm::vec3>& vertices,
+                                           const std::vector<std::array<size_t, 3>>& indices);
+
+    /// Load the picking tree, face adjacency, SDF values and segmentations saved after the geometry.
+    /// Projects saved without them, or with data that does not match the geometry, are loaded without it.
+    template <class Archive>
+    void loadDerivedData(Archive& loadArchive);
+
+    /// Rebuild picking data of the details that changed since the last call
+    void updateDetailPicking();
+
+    /// Find the detail triangle of a detailed base triangle hit at hitPoint
+    size_t intersectDetail(size_t triangleIdx, const glm::vec3& hitPoint) const;
+
+    /// Build a CGAL mesh over detailed triangles.
+    /// If the mesh exists, only the faces of the base triangles in mMeshDetailedDirty are replaced.
+    void buildDetailedMesh(const std::atomic<bool>* isCancelled);
+
+    /// Replace faces of the changed base triangles in mMeshDetailed, returns false if a face cannot be added
+    bool patchDetailedMesh();
+
+    /// Add the faces of a base triangle to mMeshDetailed, its detail triangles or the triangle itself if simple.
+    /// Returns false if a face cannot be added.
+    bool addDetailedMeshFaces(size_t triangleIdx);
+
+    /// Add a single face of the triangle to mMeshDetailed, returns false if the face cannot be added
+    bool addDetailedMeshFace(DetailedTriangleId triangleId,
+                             const std::array<PolyhedronData::vertex_descriptor, 3>& vertDescriptors);
+
+    /// Remove the faces of a base triangle from mMeshDetailed, including vertices used only by them
+    void removeDetailedMeshFaces(size_t triangleIdx);
+
+    /// Faces of a base triangle in mMeshDetailed, its detail triangles or the triangle itself if simple
+    std::vector<PolyhedronData::face_descriptor> getDetailedMeshFaces(size_t triangleIdx) const;
 
-    /// Build a CGAL mesh over detailed triangles
-    void buildDetailedMesh();
+#ifdef PEPR3D_COLLECT_DEBUG_DATA
+    /// Log how well mMeshDetailedVertexDescs spreads the vertices, to check the hash on real models.
+    /// Scans all buckets, so it is only built with the debug data.
+    void logVertexWeldingStatistics() const;
+#endif
+
+    /// Find the vertex of mMeshDetailed at the position, or add a new one
+    PolyhedronData::vertex_descriptor getDetailedMeshVertex(const glm::vec3& position,
+                                                            const DataTriangle::Point& point);
 
     /// Fixes T-junctions and unmatched vertices on edges of TriangleDetails
-    /// by creating a matching vertex on the neighbouring triangle
+    /// by creating a matching vertex on the neighbouring triangle.
+    /// Only edges of the triangles changed since the last correction (mSharedVerticesDirty) are fixed.
     void correctSharedVertices();
 
-    /// Invalidate temporary detailed data like detailed AABB tree and mesh.
+    /// Is one of the neighbouring triangles a detail without its exact data and do the plain vertices of both on
+    /// their shared edge match? The edge then needs no correction, so loaded details are not decoded before they
+    /// are painted, see TriangleDetail::loadLazy().
+    bool isUndecodedEdgeMatching(size_t firstTriIdx, size_t secondTriIdx) const;
+
+    bool needsSharedVertexCorrection() const {
+        return mSharedVerticesNeedFullCorrection || !mSharedVerticesDirty.empty();
+    }
+
+    /// Invalidate temporary detailed data like the detailed mesh, it is built from scratch next time.
+    /// Details changed with markDetailDirty() do not need this, their faces are replaced in the mesh.
     void invalidateTemporaryDetailedData();
 
     TriangleDetail* createTriangleDetail(size_t triangleIdx);
 
+    /// Detail of the base triangle, nullptr if it has none
+    const CopyOnWrite<TriangleDetail>* findTriangleDetail(const size_t triangleIndex) const {
+        const TriangleDetailSlot* slot = mTriangleDetailSlots.find(triangleIndex);
+        return slot == nullptr || !slot->detail ? nullptr : &*slot->detail;
+    }
+
+    const DetailBufferSlot* findDetailBufferSlot(const size_t triangleIndex) const {
+        const TriangleDetailSlot* slot = mTriangleDetailSlots.find(triangleIndex);
+        return slot == nullptr || !slot->bufferSlot ? nullptr : &*slot->bufferSlot;
+    }
+
+    /// Replace the detail of the base triangle, without marking anything dirty
+    void setTriangleDetail(const size_t triangleIndex, CopyOnWrite<TriangleDetail> detail) {
+        mTriangleDetailSlots[triangleIndex].detail = std::move(detail);
+    }
+
+    /// Remove the detail of the base triangle, without marking anything dirty. Its buffer slot is kept.
+    void eraseTriangleDetail(const size_t triangleIndex) {
+        TriangleDetailSlot* slot = mTriangleDetailSlots.find(triangleIndex);
+        if(slot != nullptr) {
+            slot->detail.reset();
+            if(!slot->bufferSlot) {
+                mTriangleDetailSlots.erase(triangleIndex);
+            }
+        }
+    }
+
+    /// Details of all base triangles, e.g., for a snapshot
+    std::map<size_t, CopyOnWrite<TriangleDetail>> copyTriangleDetails() const;
+
+    /// Replace the details of all base triangles, the buffer slots stay until the buffers are updated
+    void replaceTriangleDetails(const std::map<size_t, CopyOnWrite<TriangleDetail>>& details);
+
     TriangleDetail* getTriangleDetail(const size_t triangleIndex) {
-        auto it = mTriangleDetails.find(triangleIndex);
-        if(it == mTriangleDetails.end()) {
+        // Before write(), the recorded copy keeps the detail shared so that it is not modified in place
+        recordTriangleState(triangleIndex);
+        TriangleDetailSlot* slot = mTriangleDetailSlots.find(triangleIndex);
+        if(slot == nullptr || !slot->detail) {
             return createTriangleDetail(triangleIndex);
         } else {
-            return &(it->second);
+            return &(slot->detail->write());
         }
     }
 
     void removeTriangleDetail(size_t triangleIndex);
 
-    /// Used by BFS in bucket painting. Aggregates the neighbours of the triangle at triIndex by looking
-    /// into the CGAL Polyhedron construct.
-    std::array<int, 3> gatherNeighbours(const size_t triIndex) const;
+    /// Remember the state of the base triangle in mRecordedDelta before its first change, if recording
+    void recordTriangleState(size_t triangleIndex) {
+        if(mRecordedDelta) {
+            // Triangle details are modified from parallel loops
+            const std::lock_guard<std::mutex> lock(mRecordedDeltaMutex);
+            if(mRecordedDelta->triangles.count(triangleIndex) == 0) {
+                GeometryDelta::TriangleState& state = mRecordedDelta->triangles[triangleIndex];
+                state.color = mTriangles.getColor(triangleIndex);
+                const CopyOnWrite<TriangleDetail>* detail = findTriangleDetail(triangleIndex);
+                if(detail != nullptr) {
+                    state.detail = *detail;
+                }
+            }
+        }
+    }
+
+    /// Same as recordTriangleState() for each of the base triangles, locking once
+    void recordTriangleStates(const std::vector<size_t>& triangleIndices) {
+        if(mRecordedDelta) {
+            const std::lock_guard<std::mutex> lock(mRecordedDeltaMutex);
+            for(const size_t triangleIndex : triangleIndices) {
+                if(mRecordedDelta->triangles.count(triangleIndex) == 0) {
+                    GeometryDelta::TriangleState& state = mRecordedDelta->triangles[triangleIndex];
+                    state.color = mTriangles.getColor(triangleIndex);
+                    const CopyOnWrite<TriangleDetail>* detail = findTriangleDetail(triangleIndex);
+                    if(detail != nullptr) {
+                        state.detail = *detail;
+                    }
+                }
+            }
+        }
+    }
+
+    /// Estimated cost of painting the triangle detail, used to schedule the expensive details first
+    size_t getTriangleDetailComplexity(const size_t triangleIndex) const {
+        const CopyOnWrite<TriangleDetail>* detail = findTriangleDetail(triangleIndex);
+        return detail == nullptr ? 1 : (*detail)->getComplexity();
+    }
 
-    /// Used by BFS in bucket painting. Aggregates the neighbours of the triangle at triIndex by looking
-    /// into the CGAL Polyhedron construct.
-    std::array<std::optional<DetailedTriangleId>, 3> gatherNeighbours(const DetailedTriangleId triIndex) const;
+    /// Fill PolyhedronData::faceNeighbours and faceNeighbourCosines from the built CGAL Polyhedron construct
+    /// @param faceDescs Face of each triangle (from mTriangles)
+    void computeFaceNeighbours(const PolyhedronData::Mesh& mesh,
+                               const std::vector<PolyhedronData::face_descriptor>& faceDescs);
+
+    /// Neighbours of the triangle at triIndex across its 3 edges, -1 for border edges
+    std::array<int, 3> gatherNeighbours(const size_t triIndex) const;
 
     /// Used by BFS in bucket painting. Manages the queue used to search through the graph.
     template <typename StoppingCondition>
-    void addNeighboursToQueue(const size_t currentVertex, std::unordered_set<size_t>& alreadyVisited,
-                              std::deque<size_t>& toVisit, const StoppingCondition& stopFunctor) const;
+    void addNeighboursToQueue(const size_t currentVertex, std::vector<size_t>& toVisit,
+                              const StoppingCondition& stopFunctor);
 
-    /// Used by BFS in bucket painting. Manages the queue used to search through the graph.
+    /// Used by BFS in bucket painting. Manages the queue of faces of the detailed mesh used to search through the
+    /// graph, currentVertex is the ID of the face.
     template <typename StoppingCondition>
-    void addNeighboursToQueue(const DetailedTriangleId currentVertex,
-                              std::unordered_set<DetailedTriangleId>& alreadyVisited,
-                              std::deque<DetailedTriangleId>& toVisit, const StoppingCondition& stopFunctor) const;
+    void addNeighboursToQueue(const PolyhedronData::face_descriptor face, const DetailedTriangleId currentVertex,
+                              std::vector<PolyhedronData::face_descriptor>& toVisit,
+                              const StoppingCondition& stopFunctor);
 
+    /// Compute a coarse estimate with COARSE_SDF_RAY_COUNT rays first, so the segmentation can start right away,
+    /// then start the refinement with mSdfSettings. Leaves the SDF not computed if cancelled by GeometryProgress.
     void computeSdf();
 
-    size_t segment(const int numberOfClusters, const float smoothingLambda,
-                   std::map<size_t, std::vector<size_t>>& segmentToTriangleIds,
-                   std::unordered_map<size_t, size_t>& triangleToSegmentMap);
+    /// Start computing the values with mSdfSettings on the thread pool, see mSdfRefinement
+    void startSdfRefinement();
+
+    /// Proxy of the size of the settings, built if needed. Null if the settings compute on the mesh or if the mesh
+    /// is not larger than the proxy.
+    std::shared_ptr<const SdfProxy> getSdfProxy(const SdfSettings& settings);
+
+    /// Compute the SDF values of the triangles, on the proxy if not null. Returns the result of SdfCalculator.
+    std::optional<std::pair<double, double>> calculateSdf(const SdfSettings& settings,
+                                                          const std::shared_ptr<const SdfProxy>& proxy,
+                                                          std::vector<double>& values, std::atomic<float>* progress,
+                                                          const std::atomic<bool>* isCancelled) const;
+
+    /// The SDF values have changed, drop the cached segmentations and the clustering
+    void invalidateSegmentations();
+
+    size_t segment(const int numberOfClusters, const float smoothingLambda, SegmentMap& segments,
+                   const std::atomic<bool>* isCancelled);
 
     /// Method to allow the Cereal library to serialize this class. Used for saving a .p3d project.
     template <class Archive>
@@ -580,64 +1532,102 @@ class Geometry {
     template <class Archive>
     void load(Archive& loadArchive);
 
+    /// Visit the triangles of toVisit and everything reachable from them, the triangles have to be marked in
+    /// mBucketVisited. Returns the visited triangles in the order of the visit.
     template <typename StoppingCondition>
-    std::vector<size_t> bucketSpread(const StoppingCondition& stopFunctor, std::deque<size_t>& toVisit,
-                                     std::unordered_set<size_t>& alreadyVisited);
+    std::vector<size_t> bucketSpread(const StoppingCondition& stopFunctor, std::vector<size_t>& toVisit);
 
     template <typename StoppingCondition>
     std::vector<DetailedTriangleId> bucketSpread(const StoppingCondition& stopFunctor,
-                                                 std::deque<DetailedTriangleId>& toVisit,
-                                                 std::unordered_set<DetailedTriangleId>& alreadyVisited);
+                                                 std::vector<PolyhedronData::face_descriptor>& toVisit);
+
+    /// Number of frontier triangles processed together by one task of parallelSpread
+    static constexpr size_t PARALLEL_BUCKET_GRAIN = 1024;
+
+    /// Level-synchronous BFS from the nodes of frontier, nodes are indices smaller than nodeCount.
+    /// forEachNeighbour(node, callback) calls callback(neighbour) for each neighbour of the node,
+    /// canVisit(neighbour, node) is the stopping condition. Both are called concurrently.
+    /// Returns the visited nodes level by level, each level sorted.
+    template <typename ForEachNeighbour, typename CanVisit>
+    static std::vector<size_t> parallelSpread(std::vector<size_t> frontier, const size_t nodeCount,
+                                              const ForEachNeighbour& forEachNeighbour, const CanVisit& canVisit,
+                                              ::ThreadPool& threadPool);
+
+    /// Visited marks of the flood fills. Each fill starts a new epoch instead of clearing the marks, so that a fill
+    /// over a few triangles does not pay for all triangles of the mesh.
+    class VisitedMarks {
+       public:
+        /// Forget all marks, indices up to size can be marked
+        void reset(const size_t size) {
+            if(mEpochs.size() < size) {
+                mEpochs.resize(size, 0);
+            }
+            ++mEpoch;
+            if(mEpoch == 0) {
+                // Marks of an old epoch could look like the new one after the wrap around
+                std::fill(mEpochs.begin(), mEpochs.end(), 0);
+                mEpoch = 1;
+            }
+        }
+
+        bool isVisited(const size_t idx) const {
+            P_ASSERT(idx < mEpochs.size());
+            return mEpochs[idx] == mEpoch;
+        }
+
+        void visit(const size_t idx) {
+            P_ASSERT(idx < mEpochs.size());
+            mEpochs[idx] = mEpoch;
+        }
+
+       private:
+        std::vector<uint32_t> mEpochs;
+        uint32_t mEpoch{0};
+    };
+
+    /// Shared by the fills of the base and of the detailed mesh, indexed by triangle or face index
+    VisitedMarks mBucketVisited;
 };
 
 template <typename StoppingCondition>
-std::vector<size_t> Geometry::bucketSpread(const StoppingCondition& stopFunctor, std::deque<size_t>& toVisit,
-                                           std::unordered_set<size_t>& alreadyVisited) {
-    std::vector<size_t> trianglesToColor;
-    P_ASSERT(mPolyhedronData.indices.size() == mTriangles.size());
-
-    while(!toVisit.empty()) {
-        // Remove yourself from queue and mark visited
-        const size_t currentVertex = toVisit.front();
-        toVisit.pop_front();
-        P_ASSERT(alreadyVisited.find(currentVertex) != alreadyVisited.end());
+std::vector<size_t> Geometry::bucketSpread(const StoppingCondition& stopFunctor, std::vector<size_t>& toVisit) {
+    P_ASSERT(mPolyhedronData.faceNeighbours.size() == mTriangles.size());
+
+    // The frontier is a flat queue that is never popped, it ends up holding all visited triangles in order
+    for(size_t head = 0; head < toVisit.size(); ++head) {
+        const size_t currentVertex = toVisit[head];
+        P_ASSERT(mBucketVisited.isVisited(currentVertex));
         P_ASSERT(currentVertex < mTriangles.size());
-        P_ASSERT(toVisit.size() < mTriangles.size());
 
         // Catching because of unpredictable CGAL errors
         try {
             // Manage neighbours and grow the queue
-            addNeighboursToQueue(currentVertex, alreadyVisited, toVisit, stopFunctor);
+            addNeighboursToQueue(currentVertex, toVisit, stopFunctor);
         } catch(CGAL::Assertion_exception& excp) {
             CI_LOG_E("Exception caught. Returning immediately. " + excp.expression() + " " + excp.message());
             throw std::runtime_error("Bucket spread failed inside the CGAL library.");
         }
-
-        // Add the triangle to the list
-        trianglesToColor.push_back(currentVertex);
     }
-    return trianglesToColor;
+    return std::move(toVisit);
 }
 
 template <typename StoppingCondition>
 std::vector<DetailedTriangleId> Geometry::bucketSpread(const StoppingCondition& stopFunctor,
-                                                       std::deque<DetailedTriangleId>& toVisit,
-                                                       std::unordered_set<DetailedTriangleId>& alreadyVisited) {
+                                                       std::vector<PolyhedronData::face_descriptor>& toVisit) {
     P_ASSERT(mMeshDetailed);
     std::vector<DetailedTriangleId> trianglesToColor;
 
-    while(!toVisit.empty()) {
-        // Remove yourself from queue and mark visited
-        const DetailedTriangleId currentVertex = toVisit.front();
-        toVisit.pop_front();
-        P_ASSERT(alreadyVisited.find(currentVertex) != alreadyVisited.end());
+    for(size_t head = 0; head < toVisit.size(); ++head) {
+        const PolyhedronData::face_descriptor face = toVisit[head];
+        const DetailedTriangleId currentVertex = mMeshDetailedIdMap[face];
+        P_ASSERT(mBucketVisited.isVisited(static_cast<size_t>(face)));
         P_ASSERT(currentVertex.getBaseId() < mTriangles.size());
         P_ASSERT(currentVertex.getDetailId() < getTriangleDetailCount(currentVertex));
 
         // Catching because of unpredictable CGAL errors
         try {
             // Manage neighbours and grow the queue
-            addNeighboursToQueue(currentVertex, alreadyVisited, toVisit, stopFunctor);
+            addNeighboursToQueue(face, currentVertex, toVisit, stopFunctor);
         } catch(CGAL::Assertion_exception* excp) {
             throw std::runtime_error("Exception caught. Returning immediately. " + excp->expression() + " " +
                                      excp->message());
@@ -652,117 +1642,294 @@ std::vector<DetailedTriangleId> Geometry::bucketSpread(const StoppingCondition&
 template <typename StoppingCondition>
 std::vector<DetailedTriangleId> Geometry::bucket(const DetailedTriangleId startTriangle,
                                                  const StoppingCondition& stopFunctor) {
-    if(mPolyhedronData.mMesh.is_empty()) {
+    if(!mPolyhedronData.valid) {
         return {};
     }
 
-    if(!isTemporaryDetailedDataValid()) {
-        updateTemporaryDetailedData();
+    if(!isDetailedMeshValid()) {
+        updateDetailedMesh();
         P_ASSERT(mMeshDetailed);
     }
 
-    std::deque<DetailedTriangleId> toVisit;
-    const DetailedTriangleId startingFace = startTriangle;
-    toVisit.push_back(startingFace);
+    const auto startIt = mMeshDetailedFaceDescs.find(startTriangle);
+    P_ASSERT(startIt != mMeshDetailedFaceDescs.end());
+    if(startIt == mMeshDetailedFaceDescs.end()) {
+        return {};
+    }
 
-    std::unordered_set<DetailedTriangleId> alreadyVisited;
-    alreadyVisited.insert(startingFace);
+    // Faces are visited by their index in the detailed mesh, removed faces keep their indices
+    mBucketVisited.reset(mMeshDetailed->num_faces());
+    std::vector<PolyhedronData::face_descriptor> toVisit{startIt->second};
+    mBucketVisited.visit(static_cast<size_t>(startIt->second));
 
-    return bucketSpread(stopFunctor, toVisit, alreadyVisited);
+    return bucketSpread(stopFunctor, toVisit);
 }
 
 template <typename StoppingCondition>
 std::vector<size_t> Geometry::bucket(const size_t startTriangle, const StoppingCondition& stopFunctor) {
-    if(mPolyhedronData.mMesh.is_empty()) {
+    return bucket(std::vector<size_t>{startTriangle}, stopFunctor);
+}
+
+template <typename StoppingCondition>
+std::vector<size_t> Geometry::bucket(const std::vector<size_t>& startingTriangles,
+                                     const StoppingCondition& stopFunctor) {
+    if(!mPolyhedronData.valid || mPolyhedronData.faceNeighbours.size() != mTriangles.size()) {
         return {};
     }
 
-    std::deque<size_t> toVisit;
-    const size_t startingFace = startTriangle;
-    toVisit.push_back(startingFace);
-
-    std::unordered_set<size_t> alreadyVisited;
-    alreadyVisited.insert(startingFace);
+    mBucketVisited.reset(mTriangles.size());
+    std::vector<size_t> toVisit;
+    toVisit.reserve(startingTriangles.size());
+    for(const size_t startTriangle : startingTriangles) {
+        if(!mBucketVisited.isVisited(startTriangle)) {
+            toVisit.push_back(startTriangle);
+            mBucketVisited.visit(startTriangle);
+        }
+    }
 
-    return bucketSpread(stopFunctor, toVisit, alreadyVisited);
+    return bucketSpread(stopFunctor, toVisit);
 }
 
 template <typename StoppingCondition>
-std::vector<size_t> Geometry::bucket(const std::vector<size_t>& startingTriangles,
-                                     const StoppingCondition& stopFunctor) {
-    if(mPolyhedronData.mMesh.is_empty()) {
+std::vector<DetailedTriangleId> Geometry::parallelBucket(const DetailedTriangleId startTriangle,
+                                                         const StoppingCondition& stopFunctor,
+                                                         ::ThreadPool& threadPool) {
+    if(!mPolyhedronData.valid) {
         return {};
     }
 
-    std::deque<size_t> toVisit;
-    std::unordered_set<size_t> alreadyVisited;
+    if(!isDetailedMeshValid()) {
+        updateDetailedMesh();
+        P_ASSERT(mMeshDetailed);
+    }
 
-    for(const size_t startTriangle : startingTriangles) {
-        toVisit.push_back(startTriangle);
-        alreadyVisited.insert(startTriangle);
+    const auto& mesh = *mMeshDetailed;
+    if(mesh.number_of_faces() < PARALLEL_BUCKET_MIN_TRIANGLES || threadPool.size() < 2) {
+        return bucket(startTriangle, stopFunctor);
     }
 
-    return bucketSpread(stopFunctor, toVisit, alreadyVisited);
+    const auto startIt = mMeshDetailedFaceDescs.find(startTriangle);
+    P_ASSERT(startIt != mMeshDetailedFaceDescs.end());
+    if(startIt == mMeshDetailedFaceDescs.end()) {
+        return {};
+    }
+
+    const auto forEachNeighbour = [&mesh](const size_t faceIdx, const auto& callback) {
+        const PolyhedronData::face_descriptor face(static_cast<PolyhedronData::Mesh::size_type>(faceIdx));
+        const auto edge = mesh.halfedge(face);
+        auto itEdge = edge;
+        for(int i = 0; i < 3; ++i) {
+            const auto oppositeEdge = mesh.opposite(itEdge);
+            itEdge = mesh.next(itEdge);
+            if(oppositeEdge.is_valid() && !mesh.is_border(oppositeEdge)) {
+                callback(static_cast<size_t>(mesh.face(oppositeEdge)));
+            }
+        }
+        P_ASSERT(edge == itEdge);
+    };
+
+    const auto canVisit = [this, &stopFunctor](const size_t neighbourIdx, const size_t faceIdx) -> bool {
+        using size_type = PolyhedronData::Mesh::size_type;
+        const DetailedTriangleId neighbourId =
+            mMeshDetailedIdMap[PolyhedronData::face_descriptor(static_cast<size_type>(neighbourIdx))];
+        const DetailedTriangleId currentId =
+            mMeshDetailedIdMap[PolyhedronData::face_descriptor(static_cast<size_type>(faceIdx))];
+        return stopFunctor(neighbourId, currentId);
+    };
+
+    // Faces are visited by their index in the detailed mesh, removed faces keep their indices
+    const std::vector<size_t> visitedFaces =
+        parallelSpread({static_cast<size_t>(startIt->second)}, mesh.num_faces(), forEachNeighbour, canVisit,
+                       threadPool);
+
+    std::vector<DetailedTriangleId> trianglesToColor;
+    trianglesToColor.reserve(visitedFaces.size());
+    for(const size_t faceIdx : visitedFaces) {
+        trianglesToColor.push_back(
+            mMeshDetailedIdMap[PolyhedronData::face_descriptor(static_cast<PolyhedronData::Mesh::size_type>(faceIdx))]);
+    }
+    return trianglesToColor;
 }
 
 template <typename StoppingCondition>
-void Geometry::addNeighboursToQueue(const size_t currentVertex, std::unordered_set<size_t>& alreadyVisited,
-                                    std::deque<size_t>& toVisit, const StoppingCondition& stopFunctor) const {
-    const std::array<int, 3> neighbours = gatherNeighbours(currentVertex);
-    for(int i = 0; i < 3; ++i) {
-        if(neighbours[i] == -1) {
-            continue;
-        } else {
-            if(alreadyVisited.find(neighbours[i]) == alreadyVisited.end()) {
-                // New vertex -> visit it.
-                if(stopFunctor(neighbours[i], currentVertex)) {
-                    toVisit.push_back(neighbours[i]);
-                    alreadyVisited.insert(neighbours[i]);
-                }
+std::vector<size_t> Geometry::parallelBucket(const std::vector<size_t>& startingTriangles,
+                                             const StoppingCondition& stopFunctor, ::ThreadPool& threadPool) {
+    if(!mPolyhedronData.valid || mPolyhedronData.faceNeighbours.size() != mTriangles.size()) {
+        return {};
+    }
+
+    if(mTriangles.size() < PARALLEL_BUCKET_MIN_TRIANGLES || threadPool.size() < 2) {
+        return bucket(startingTriangles, stopFunctor);
+    }
+
+    const auto forEachNeighbour = [this](const size_t triangleIdx, const auto& callback) {
+        for(const uint32_t neighbour : mPolyhedronData.faceNeighbours[triangleIdx]) {
+            if(neighbour != PolyhedronData::NO_NEIGHBOUR) {
+                callback(static_cast<size_t>(neighbour));
             }
         }
+    };
+
+    return parallelSpread(startingTriangles, mTriangles.size(), forEachNeighbour, stopFunctor, threadPool);
+}
+
+template <typename ForEachNeighbour, typename CanVisit>
+std::vector<size_t> Geometry::parallelSpread(std::vector<size_t> frontier, const size_t nodeCount,
+                                             const ForEachNeighbour& forEachNeighbour, const CanVisit& canVisit,
+                                             ::ThreadPool& threadPool) {
+    // One bit per node, claimed with fetch_or so that each node gets into the next level only once
+    std::vector<std::atomic<uint32_t>> visited((nodeCount + 31) / 32);
+    const auto tryVisit = [&visited](const size_t node) -> bool {
+        const uint32_t bit = 1u << (node % 32);
+        return (visited[node / 32].fetch_or(bit, std::memory_order_relaxed) & bit) == 0;
+    };
+    const auto isVisited = [&visited](const size_t node) -> bool {
+        return (visited[node / 32].load(std::memory_order_relaxed) & (1u << (node % 32))) != 0;
+    };
+
+    // Duplicate start nodes are visited once
+    frontier.erase(std::remove_if(frontier.begin(), frontier.end(),
+                                  [&tryVisit, nodeCount](const size_t node) {
+                                      P_ASSERT(node < nodeCount);
+                                      return !tryVisit(node);
+                                  }),
+                   frontier.end());
+    std::sort(frontier.begin(), frontier.end());
+
+    std::vector<size_t> result;
+    std::vector<std::vector<size_t>> chunkLevels;
+    std::vector<size_t> chunkIds;
+    while(!frontier.empty()) {
+        result.insert(result.end(), frontier.begin(), frontier.end());
+
+        const size_t chunkCount = (frontier.size() + PARALLEL_BUCKET_GRAIN - 1) / PARALLEL_BUCKET_GRAIN;
+        chunkLevels.resize(chunkCount);
+        chunkIds.resize(chunkCount);
+        for(size_t chunkIdx = 0; chunkIdx < chunkCount; ++chunkIdx) {
+            chunkIds[chunkIdx] = chunkIdx;
+            chunkLevels[chunkIdx].clear();
+        }
+
+        // Each chunk of the frontier collects the nodes it claimed for the next level
+        threadPool.parallel_for(
+            chunkIds.begin(), chunkIds.end(),
+            [&](const size_t chunkIdx) {
+                const size_t begin = chunkIdx * PARALLEL_BUCKET_GRAIN;
+                const size_t end = std::min(frontier.size(), begin + PARALLEL_BUCKET_GRAIN);
+                std::vector<size_t>& nextLevel = chunkLevels[chunkIdx];
+                // Catching because of unpredictable CGAL errors
+                try {
+                    for(size_t i = begin; i < end; ++i) {
+                        const size_t node = frontier[i];
+                        forEachNeighbour(node, [&](const size_t neighbour) {
+                            // Check the mark before the stopping condition, it is usually cheaper
+                            if(!isVisited(neighbour) && canVisit(neighbour, node) && tryVisit(neighbour)) {
+                                nextLevel.push_back(neighbour);
+                            }
+                        });
+                    }
+                } catch(CGAL::Assertion_exception& excp) {
+                    CI_LOG_E("Exception caught. Returning immediately. " + excp.expression() + " " + excp.message());
+                    throw std::runtime_error("Bucket spread failed inside the CGAL library.");
+                }
+            },
+            1);
+
+        // Which chunk claims a node depends on the timing, sorting keeps the result deterministic
+        frontier.clear();
+        for(const std::vector<size_t>& nextLevel : chunkLevels) {
+            frontier.insert(frontier.end(), nextLevel.begin(), nextLevel.end());
+        }
+        std::sort(frontier.begin(), frontier.end());
     }
+    return result;
 }
 
 template <typename StoppingCondition>
-void Geometry::addNeighboursToQueue(const DetailedTriangleId currentVertex,
-                                    std::unordered_set<DetailedTriangleId>& alreadyVisited,
-                                    std::deque<DetailedTriangleId>& toVisit,
-                                    const StoppingCondition& stopFunctor) const {
-    std::array<std::optional<DetailedTriangleId>, 3> neighbours = gatherNeighbours(currentVertex);
+void Geometry::addNeighboursToQueue(const size_t currentVertex, std::vector<size_t>& toVisit,
+                                    const StoppingCondition& stopFunctor) {
+    const std::array<uint32_t, 3>& neighbours = mPolyhedronData.faceNeighbours[currentVertex];
+    for(const uint32_t neighbour : neighbours) {
+        if(neighbour == PolyhedronData::NO_NEIGHBOUR || mBucketVisited.isVisited(neighbour)) {
+            continue;
+        }
+        // New vertex -> visit it.
+        if(stopFunctor(static_cast<size_t>(neighbour), currentVertex)) {
+            toVisit.push_back(neighbour);
+            mBucketVisited.visit(neighbour);
+        }
+    }
+}
+
+template <typename StoppingCondition>
+void Geometry::addNeighboursToQueue(const PolyhedronData::face_descriptor face,
+                                    const DetailedTriangleId currentVertex,
+                                    std::vector<PolyhedronData::face_descriptor>& toVisit,
+                                    const StoppingCondition& stopFunctor) {
+    // Surface_mesh keeps its connectivity in flat arrays indexed by the face and halfedge indices
+    const auto& mesh = *mMeshDetailed;
+    const auto edge = mesh.halfedge(face);
+    auto itEdge = edge;
+
     for(int i = 0; i < 3; ++i) {
-        if(!neighbours[i]) {
+        const auto oppositeEdge = mesh.opposite(itEdge);
+        itEdge = mesh.next(itEdge);
+        if(!oppositeEdge.is_valid() || mesh.is_border(oppositeEdge)) {
             continue;
-        } else {
-            if(alreadyVisited.find(*neighbours[i]) == alreadyVisited.end()) {
-                // New vertex -> visit it.
-                if(stopFunctor(*neighbours[i], currentVertex)) {
-                    toVisit.push_back(*neighbours[i]);
-                    alreadyVisited.insert(*neighbours[i]);
-                }
-            }
+        }
+
+        const PolyhedronData::face_descriptor neighbourFace = mesh.face(oppositeEdge);
+        if(mBucketVisited.isVisited(static_cast<size_t>(neighbourFace))) {
+            continue;
+        }
+        // New vertex -> visit it.
+        const DetailedTriangleId neighbourId = mMeshDetailedIdMap[neighbourFace];
+        if(stopFunctor(neighbourId, currentVertex)) {
+            toVisit.push_back(neighbourFace);
+            mBucketVisited.visit(static_cast<size_t>(neighbourFace));
         }
     }
+    P_ASSERT(edge == itEdge);
 }
 
 /* -------------------- Serialization -------------------- */
 
 template <class Archive>
 void Geometry::save(Archive& saveArchive) const {
-    saveArchive(mColorManager);
-    saveArchive(mTriangles);
-    saveArchive(mTriangleDetails);
-    saveArchive(mPolyhedronData.vertices);
-    saveArchive(mPolyhedronData.indices);
+    createProjectSnapshot().save(saveArchive);
+}
+
+template <class Archive>
+void Geometry::ProjectSnapshot::save(Archive& saveArchive) const {
+    saveArchive(colorManager);
+    saveArchive(triangles);
+    saveArchive(triangleDetails);
+    saveArchive(vertices);
+    saveArchive(indices);
+
+    // Derived data, saves computing it again on load. Older versions of Pepr3D stop reading before it.
+    saveArchive(DERIVED_DATA_VERSION);
+    saveArchive(computeDerivedDataHash());
+    saveArchive(pickingTree);
+    saveArchive(faceAdjacency);
+    saveArchive(sdfValues);
+    saveArchive(sdfSettings, sdfValuesSettings);
+    saveArchive(sdfValues.empty() ? std::vector<CachedSegmentation>() : segmentations);
+    saveArchive(colorManager.getColorOrder());
+    saveArchive(sdfSettings.proxyTriangleCount, sdfValuesSettings.proxyTriangleCount);
 }
 
 template <class Archive>
 void Geometry::load(Archive& loadArchive) {
     loadArchive(mColorManager);
     loadArchive(mTriangles);
-    loadArchive(mTriangleDetails);
+    std::map<size_t, CopyOnWrite<TriangleDetail>> triangleDetails;
+    loadArchive(triangleDetails);
+    replaceTriangleDetails(triangleDetails);
+    mDetailPickingNeedsRebuild = true;
     loadArchive(mPolyhedronData.vertices);
     loadArchive(mPolyhedronData.indices);
+    loadDerivedData(loadArchive);
 
     // Reset progress
     mProgress->resetLoad();
@@ -771,7 +1938,8 @@ void Geometry::load(Archive& loadArchive) {
     mProgress->importRenderPercentage = 1.0f;
     mProgress->importComputePercentage = 1.0f;
 
-    updateTemporaryDetailedData();
+    // Shared vertices and the detailed mesh wait until a tool needs them
+    invalidateTemporaryDetailedData();
 
     P_ASSERT(!mTriangles.empty());
     P_ASSERT(!mColorManager.empty());
@@ -779,4 +1947,63 @@ void Geometry::load(Archive& loadArchive) {
     P_ASSERT(!mPolyhedronData.indices.empty());
 }
 
-}  // namespace pepr3d
\ No newline at end of file
+template <class Archive>
+void Geometry::loadDerivedData(Archive& loadArchive) {
+    mIsPickingTreeLoaded = false;
+    mPickingTree.clear();
+    mPolyhedronData.faceAdjacency.clear();
+    mLoadedSdfValues.clear();
+    mLoadedSegmentations.clear();
+
+    bool isMatching = false;
+    try {
+        uint32_t version;
+        loadArchive(version);
+        if(version == 0 || version > DERIVED_DATA_VERSION) {
+            CI_LOG_W("Derived data of version " + std::to_string(version) + " ignored, it will be recomputed.");
+            return;
+        }
+
+        uint64_t hash;
+        loadArchive(hash);
+        loadArchive(mPickingTree);
+        loadArchive(mPolyhedronData.faceAdjacency);
+        loadArchive(mLoadedSdfValues);
+        if(version >= 2) {
+            loadArchive(mSdfSettings, mSdfValuesSettings);
+            loadArchive(mLoadedSegmentations);
+        } else {
+            // Version 1 values were computed with the default settings
+            mSdfSettings = mSdfValuesSettings = SdfSettings();
+        }
+        if(version >= 3) {
+            // Older versions show the palette in the order of the color indices
+            std::vector<size_t> colorOrder;
+            loadArchive(colorOrder);
+            mColorManager.setColorOrder(colorOrder);
+        }
+        if(version >= 4) {
+            loadArchive(mSdfSettings.proxyTriangleCount, mSdfValuesSettings.proxyTriangleCount);
+        } else {
+            // Older versions computed on the mesh
+            mSdfSettings.proxyTriangleCount = mSdfValuesSettings.proxyTriangleCount = 0;
+        }
+        isMatching = hash == computeDerivedDataHash() && mPickingTree.size() == mTriangles.size();
+        if(!isMatching) {
+            CI_LOG_W("Derived data does not match the geometry of the project, it will be recomputed.");
+        }
+    } catch(const cereal::Exception&) {
+        // Project saved before derived data was stored, nothing follows the geometry
+    }
+
+    if(!isMatching) {
+        mPickingTree.clear();
+        mPolyhedronData.faceAdjacency.clear();
+        mLoadedSdfValues.clear();
+        mLoadedSegmentations.clear();
+        return;
+    }
+    mIsPickingTreeLoaded = true;
+}
+
+}  // namespace pepr3d
@@ -1,8 +1,17 @@
 #ifdef _TEST_
 
 #include <gtest/gtest.h>
+#include <atomic>
+#include <future>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <utility>
+#include <vector>
 
 #include "geometry/Geometry.h"
+#include "geometry/ModelExporter.h"
+#include "geometry/ProjectFile.h"
 
 /// Return a simple testing geometry of a cube
 pepr3d::Geometry getGeometryWithCube() {
@@ -49,10 +58,8 @@ TEST(Geometry, initialize) {
     EXPECT_EQ(vertexBuffer.size(), 36);
     const auto indexBuffer = geo.getOpenGlData().indexBuffer;
     EXPECT_EQ(indexBuffer.size(), 36);
-    const auto normalBuffer = geo.getOpenGlData().normalBuffer;
-    EXPECT_EQ(normalBuffer.size(), 36);
     const auto colorBuffer = geo.getOpenGlData().colorBuffer;
-    EXPECT_EQ(colorBuffer.size(), 36);
+    EXPECT_EQ(colorBuffer.size(), 12);
 }
 
 TEST(Geometry, getColor) {
@@ -67,10 +74,10 @@ TEST(Geometry, getColor) {
     EXPECT_EQ(geo.getTriangleColor(1), 0);
 
     const auto colorBuffer = geo.getOpenGlData().colorBuffer;
-    EXPECT_EQ(colorBuffer.size(), 36);
+    EXPECT_EQ(colorBuffer.size(), 12);
     pepr3d::Geometry::ColorIndex colorIndex = colorBuffer.at(0);
 
-    for(int i = 1; i < 36; ++i) {
+    for(int i = 1; i < 12; ++i) {
         EXPECT_EQ(colorIndex, colorBuffer.at(i));
     }
 }
@@ -87,24 +94,550 @@ TEST(Geometry, setColor) {
     EXPECT_EQ(geo.getTriangleColor(1), 0);
 
     auto& colorBuffer = geo.getOpenGlData().colorBuffer;
-    EXPECT_EQ(colorBuffer.size(), 36);
+    EXPECT_EQ(colorBuffer.size(), 12);
     const pepr3d::Geometry::ColorIndex colorIndex = colorBuffer.at(0);
 
     geo.setTriangleColor(1, 3);
 
-    EXPECT_NE(colorBuffer.at(0), colorBuffer.at(4));
-    const pepr3d::Geometry::ColorIndex newColorIndex = colorBuffer.at(4);
+    EXPECT_NE(colorBuffer.at(0), colorBuffer.at(1));
+    EXPECT_EQ(colorBuffer.at(1), 3);
 
-    for(int i = 0; i < 3; ++i) {
+    for(int i = 2; i < 12; ++i) {
         EXPECT_EQ(colorBuffer.at(i), colorIndex);
     }
+}
 
-    for(int i = 3; i < 6; ++i) {
-        EXPECT_EQ(colorBuffer.at(i), newColorIndex);
+TEST(Geometry, setColors) {
+    /**
+     * Test that coloring many triangles at once equals coloring them one by one, and removes their details
+     */
+
+    pepr3d::Geometry geo(getGeometryWithCube());
+    geo.updateOpenGlBuffers();
+    pepr3d::BrushSettings settings;
+    settings.size = 0.1f;
+    settings.color = 1;
+    geo.paintAreaWithSphere(ci::Ray(glm::vec3(0.2f, 2.0f, 0.1f), glm::vec3(0, -1, 0)), settings);
+    ASSERT_FALSE(geo.isSimpleTriangle(1));
+    geo.updateOpenGlBuffers();
+    geo.getOpenGlData().info.unsetBufferFlags();
+    geo.getOpenGlData().info.unsetColorFlag();
+
+    geo.setTriangleColors({7, 2, 1, 3, 2, 6}, 3);
+    EXPECT_TRUE(geo.isSimpleTriangle(1));
+    for(size_t i = 0; i < 12; ++i) {
+        const bool isColored = i == 1 || i == 2 || i == 3 || i == 6 || i == 7;
+        EXPECT_EQ(geo.getTriangleColor(i), isColored ? 3 : 0);
     }
 
-    for(int i = 7; i < 36; ++i) {
-        EXPECT_EQ(colorBuffer.at(i), colorIndex);
+    // The simple triangles are patched in place, in runs of consecutive faces
+    const auto& glData = geo.getOpenGlData();
+    EXPECT_TRUE(glData.info.didColorUpdate);
+    const std::vector<std::pair<size_t, size_t>> expectedRanges = {{2, 4}, {6, 8}};
+    EXPECT_EQ(glData.info.colorRanges.ranges, expectedRanges);
+    EXPECT_EQ(glData.colorBuffer.at(2), 3);
+    EXPECT_EQ(glData.colorBuffer.at(7), 3);
+
+    // The removed detail is replaced by its base triangle on the next update
+    EXPECT_TRUE(glData.isDirty);
+    geo.updateOpenGlBuffers();
+    EXPECT_EQ(geo.getOpenGlData().colorBuffer.at(1), 3);
+}
+
+TEST(Geometry, incrementalBufferUpdate) {
+    /**
+     * Test that painting a detail only patches the buffers and keeps base triangles in place
+     */
+
+    pepr3d::Geometry geo(getGeometryWithCube());
+    geo.updateOpenGlBuffers();
+    geo.getOpenGlData().info.unsetBufferFlags();
+
+    pepr3d::BrushSettings settings;
+    settings.size = 0.1f;
+    settings.color = 1;
+    geo.paintAreaWithSphere(ci::Ray(glm::vec3(0.2f, 2.0f, 0.1f), glm::vec3(0, -1, 0)), settings);
+    ASSERT_FALSE(geo.isSimpleTriangle(1));
+    ASSERT_TRUE(geo.getOpenGlData().isDirty);
+
+    geo.updateOpenGlBuffers();
+    const auto& glData = geo.getOpenGlData();
+    EXPECT_FALSE(glData.isDirty);
+    // New detail is appended to the end of the buffers
+    EXPECT_FALSE(glData.info.didLayoutChange);
+    ASSERT_FALSE(glData.info.dirtyFaceRanges.empty());
+    EXPECT_EQ(glData.info.dirtyFaceRanges.ranges.back().second, glData.colorBuffer.size());
+    ASSERT_FALSE(glData.info.dirtyVertexRanges.empty());
+    EXPECT_EQ(glData.info.dirtyVertexRanges.ranges.front().first, 36);
+
+    const size_t detailCount = geo.getTriangleDetailCount(1);
+    EXPECT_GE(glData.colorBuffer.size(), 12 + detailCount);
+    EXPECT_GE(glData.vertexBuffer.size(), 36 + 3 * detailCount);
+    EXPECT_EQ(glData.indexBuffer.size(), 3 * glData.colorBuffer.size());
+    EXPECT_EQ(glData.faceTriangles.size(), glData.colorBuffer.size());
+    // One highlight bit for each base triangle, independent of the details
+    EXPECT_EQ(glData.highlightMask.size(), 1);
+
+    // Painted base triangle is replaced by a degenerate face, others stay untouched
+    for(size_t i = 3; i < 6; ++i) {
+        EXPECT_EQ(glData.indexBuffer[i], glData.indexBuffer[3]);
+    }
+    for(size_t triIdx = 0; triIdx < geo.getTriangleCount(); ++triIdx) {
+        if(triIdx == 1) {
+            continue;
+        }
+        for(size_t i = 0; i < 3; ++i) {
+            EXPECT_EQ(glData.vertexBuffer[glData.indexBuffer[3 * triIdx + i]], geo.getTriangle(triIdx).getVertex(i));
+        }
+    }
+
+    // Detail faces point to their own vertices
+    for(size_t detailIdx = 0; detailIdx < detailCount; ++detailIdx) {
+        const size_t face = 12 + detailIdx;
+        EXPECT_EQ(glData.colorBuffer[face], geo.getTriangle(pepr3d::DetailedTriangleId(1, detailIdx)).getColor());
+        EXPECT_EQ(glData.faceTriangles[face], 1u);
+        for(size_t i = 0; i < 3; ++i) {
+            EXPECT_EQ(glData.vertexBuffer[glData.indexBuffer[3 * face + i]],
+                      geo.getTriangle(pepr3d::DetailedTriangleId(1, detailIdx)).getVertex(i));
+        }
+    }
+}
+
+TEST(Geometry, fullBufferRebuildMatchesUpdate) {
+    /**
+     * Test that generating the buffers from scratch gives the same buffers as patching them after a paint
+     */
+
+    pepr3d::Geometry geo(getGeometryWithCube());
+    geo.updateOpenGlBuffers();
+
+    pepr3d::BrushSettings settings;
+    settings.size = 0.1f;
+    settings.color = 1;
+    geo.paintAreaWithSphere(ci::Ray(glm::vec3(0.2f, 2.0f, 0.1f), glm::vec3(0, -1, 0)), settings);
+    ASSERT_FALSE(geo.isSimpleTriangle(1));
+    geo.updateOpenGlBuffers();
+    const pepr3d::Geometry::OpenGlData patched = geo.getOpenGlData();
+
+    // Loading a state lays out all buffers again
+    geo.loadState(geo.saveState());
+    geo.updateOpenGlBuffers();
+    const auto& rebuilt = geo.getOpenGlData();
+    EXPECT_TRUE(rebuilt.info.didLayoutChange);
+    EXPECT_EQ(rebuilt.vertexBuffer, patched.vertexBuffer);
+    EXPECT_EQ(rebuilt.indexBuffer, patched.indexBuffer);
+    EXPECT_EQ(rebuilt.colorBuffer, patched.colorBuffer);
+    EXPECT_EQ(rebuilt.faceTriangles, patched.faceTriangles);
+}
+
+/// MappedBufferStorage backed by vectors, growing them keeps their contents
+class VectorBufferStorage : public pepr3d::MappedBufferStorage {
+   public:
+    std::vector<glm::vec3> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<GLuint> faceTriangles;
+    size_t mapCount = 0;
+
+    bool map(size_t vertexCount, size_t faceCount) override {
+        ++mapCount;
+        vertices.resize(std::max(vertices.size(), vertexCount));
+        indices.resize(std::max(indices.size(), 3 * faceCount));
+        faceTriangles.resize(std::max(faceTriangles.size(), faceCount));
+        return true;
+    }
+
+    glm::vec3* getVertices() override {
+        return vertices.data();
+    }
+
+    uint32_t* getIndices() override {
+        return indices.data();
+    }
+
+    GLuint* getFaceTriangles() override {
+        return faceTriangles.data();
+    }
+};
+
+TEST(Geometry, mappedBuffersMatchVectors) {
+    /**
+     * Test that the buffers written to a mapped storage are the buffers kept in the vectors otherwise, and that the
+     * vectors are not kept while a storage is used
+     */
+
+    pepr3d::Geometry geo(getGeometryWithCube());
+    pepr3d::Geometry mappedGeo(getGeometryWithCube());
+    VectorBufferStorage storage;
+    geo.updateOpenGlBuffers();
+    mappedGeo.updateOpenGlBuffers(&storage);
+    ASSERT_TRUE(mappedGeo.getOpenGlData().isMapped);
+    EXPECT_TRUE(mappedGeo.getOpenGlData().vertexBuffer.empty());
+    EXPECT_TRUE(mappedGeo.getOpenGlData().indexBuffer.empty());
+    EXPECT_TRUE(mappedGeo.getOpenGlData().faceTriangles.empty());
+
+    // The detail is appended by the incremental update, which maps the storage once
+    pepr3d::BrushSettings settings;
+    settings.size = 0.1f;
+    settings.color = 1;
+    const ci::Ray ray(glm::vec3(0.2f, 2.0f, 0.1f), glm::vec3(0, -1, 0));
+    geo.paintAreaWithSphere(ray, settings);
+    mappedGeo.paintAreaWithSphere(ray, settings);
+    geo.updateOpenGlBuffers();
+    const size_t mapCount = storage.mapCount;
+    mappedGeo.updateOpenGlBuffers(&storage);
+    EXPECT_EQ(storage.mapCount, mapCount + 1);
+    EXPECT_FALSE(mappedGeo.getOpenGlData().info.didLayoutChange);
+
+    const auto& glData = geo.getOpenGlData();
+    const auto& mappedData = mappedGeo.getOpenGlData();
+    ASSERT_EQ(mappedData.vertexCount, glData.vertexBuffer.size());
+    ASSERT_EQ(mappedData.faceCount, glData.colorBuffer.size());
+    EXPECT_EQ(mappedData.colorBuffer, glData.colorBuffer);
+    for(size_t face = 0; face < mappedData.faceCount; ++face) {
+        EXPECT_EQ(storage.faceTriangles[face], glData.faceTriangles[face]);
+        for(size_t i = 0; i < 3; ++i) {
+            EXPECT_EQ(storage.indices[3 * face + i], glData.indexBuffer[3 * face + i]);
+            // Unused faces are degenerate, their vertices do not matter
+            EXPECT_EQ(storage.vertices[storage.indices[3 * face + i]],
+                      glData.vertexBuffer[glData.indexBuffer[3 * face + i]]);
+        }
+    }
+
+    // The bounds of the faces come from the triangles, the whole cube and the detail within it
+    const auto bounds = mappedGeo.getOpenGlFaceBounds(0, mappedData.faceCount);
+    EXPECT_EQ(bounds.first, glm::vec3(-0.5f));
+    EXPECT_EQ(bounds.second, glm::vec3(0.5f));
+    const auto detailBounds = mappedGeo.getOpenGlFaceBounds(mappedGeo.getTriangleCount(), mappedData.faceCount);
+    EXPECT_GE(detailBounds.first.y, 0.5f - 1e-5f);
+    EXPECT_LE(detailBounds.second.y, 0.5f + 1e-5f);
+    const auto unusedBounds = mappedGeo.getOpenGlFaceBounds(1, 2);
+    EXPECT_GT(unusedBounds.first.x, unusedBounds.second.x);
+
+    // Going back to the vectors generates them again
+    mappedGeo.invalidateOpenGlBuffers();
+    mappedGeo.updateOpenGlBuffers();
+    EXPECT_FALSE(mappedGeo.getOpenGlData().isMapped);
+    EXPECT_EQ(mappedGeo.getOpenGlData().faceCount, mappedGeo.getOpenGlData().faceTriangles.size());
+}
+
+TEST(Geometry, highlightMaskOfTriangles) {
+    /**
+     * Test that the continuous highlight sets only the bits of the triangles under the brush and that it is kept
+     * while the brush barely moves
+     */
+
+    pepr3d::Geometry geo(getGeometryWithCube());
+    geo.updateOpenGlBuffers();
+
+    pepr3d::BrushSettings settings;
+    settings.size = 0.1f;
+    settings.continuous = true;
+    geo.highlightArea(ci::Ray(glm::vec3(0.2f, 2.0f, 0.1f), glm::vec3(0, -1, 0)), settings);
+
+    const auto& glData = geo.getOpenGlData();
+    const auto& highlight = geo.getAreaHighlight();
+    ASSERT_TRUE(highlight.enabled);
+    ASSERT_EQ(glData.highlightMask.size(), 1);
+    for(size_t triIdx = 0; triIdx < geo.getTriangleCount(); ++triIdx) {
+        const bool isSet = (glData.highlightMask[0] >> triIdx) & 1;
+        EXPECT_EQ(isSet, highlight.triangles.count(triIdx) == 1);
+    }
+    EXPECT_FLOAT_EQ(highlight.trianglesOrigin.x, 0.2f);
+
+    // A small move over the same triangle keeps the surface, only the brush center follows
+    geo.highlightArea(ci::Ray(glm::vec3(0.2001f, 2.0f, 0.1f), glm::vec3(0, -1, 0)), settings);
+    EXPECT_FLOAT_EQ(highlight.origin.x, 0.2001f);
+    EXPECT_FLOAT_EQ(highlight.trianglesOrigin.x, 0.2f);
+
+    // A larger move collects the surface again
+    geo.highlightArea(ci::Ray(glm::vec3(0.25f, 2.0f, 0.1f), glm::vec3(0, -1, 0)), settings);
+    EXPECT_FLOAT_EQ(highlight.trianglesOrigin.x, 0.25f);
+
+    // Without a continuous surface the shader does not need the mask
+    settings.continuous = false;
+    geo.highlightArea(ci::Ray(glm::vec3(0.2f, 2.0f, 0.1f), glm::vec3(0, -1, 0)), settings);
+    EXPECT_EQ(glData.highlightMask[0], 0u);
+}
+
+TEST(Geometry, paintStrokeMatchesDabs) {
+    /**
+     * Test that painting a whole stroke at once gives the same result as painting the dabs one by one
+     */
+
+    const std::vector<ci::Ray> rays{ci::Ray(glm::vec3(0.2f, 2.0f, 0.1f), glm::vec3(0, -1, 0)),
+                                    ci::Ray(glm::vec3(0.25f, 2.0f, 0.1f), glm::vec3(0, -1, 0)),
+                                    ci::Ray(glm::vec3(-0.2f, 2.0f, -0.1f), glm::vec3(0, -1, 0)),
+                                    ci::Ray(glm::vec3(5.0f, 2.0f, 5.0f), glm::vec3(0, -1, 0))};
+    pepr3d::BrushSettings settings;
+    settings.size = 0.1f;
+    settings.color = 1;
+
+    pepr3d::Geometry dabs(getGeometryWithCube());
+    for(const ci::Ray& ray : rays) {
+        dabs.paintAreaWithSphere(ray, settings);
+    }
+    pepr3d::Geometry stroke(getGeometryWithCube());
+    stroke.paintAreaWithSpheres(rays, settings);
+
+    ASSERT_EQ(stroke.getTriangleCount(), dabs.getTriangleCount());
+    for(size_t triIdx = 0; triIdx < dabs.getTriangleCount(); ++triIdx) {
+        ASSERT_EQ(stroke.isSimpleTriangle(triIdx), dabs.isSimpleTriangle(triIdx));
+        if(dabs.isSimpleTriangle(triIdx)) {
+            EXPECT_EQ(stroke.getTriangle(triIdx).getColor(), dabs.getTriangle(triIdx).getColor());
+        } else {
+            EXPECT_EQ(stroke.getTriangleDetailCount(triIdx), dabs.getTriangleDetailCount(triIdx));
+        }
+    }
+    EXPECT_FALSE(stroke.isSimpleTriangle(1));
+}
+
+TEST(Geometry, triangleIdOfFace) {
+    /**
+     * Test that faces of the OpenGL buffers are mapped back to the triangles they display
+     */
+
+    pepr3d::Geometry geo(getGeometryWithCube());
+    pepr3d::BrushSettings settings;
+    settings.size = 0.1f;
+    settings.color = 1;
+    geo.paintAreaWithSphere(ci::Ray(glm::vec3(0.2f, 2.0f, 0.1f), glm::vec3(0, -1, 0)), settings);
+    geo.updateOpenGlBuffers();
+    ASSERT_FALSE(geo.isSimpleTriangle(1));
+
+    EXPECT_EQ(geo.getTriangleIdOfFace(0), pepr3d::DetailedTriangleId(0));
+    EXPECT_FALSE(geo.getTriangleIdOfFace(1));
+
+    // The slot of the detail follows the base triangles
+    const size_t detailCount = geo.getTriangleDetailCount(1);
+    for(size_t detailIdx = 0; detailIdx < detailCount; ++detailIdx) {
+        EXPECT_EQ(geo.getTriangleIdOfFace(geo.getTriangleCount() + detailIdx),
+                  pepr3d::DetailedTriangleId(1, detailIdx));
+    }
+    const size_t faceCount = geo.getOpenGlData().colorBuffer.size();
+    for(size_t face = geo.getTriangleCount() + detailCount; face < faceCount; ++face) {
+        EXPECT_FALSE(geo.getTriangleIdOfFace(face));
+    }
+}
+
+TEST(Geometry, intersectDetailedMesh) {
+    /**
+     * Test that picking finds the detail triangle under the ray, also after the detail changes
+     */
+
+    pepr3d::Geometry geo(getGeometryWithCube());
+    const ci::Ray ray(glm::vec3(0.2f, 2.0f, 0.1f), glm::vec3(0, -1, 0));
+    auto picked = geo.intersectDetailedMesh(ray);
+    ASSERT_TRUE(picked);
+    EXPECT_EQ(picked->getBaseId(), 1);
+    EXPECT_FALSE(picked->getDetailId());
+
+    pepr3d::BrushSettings settings;
+    settings.size = 0.1f;
+    settings.color = 1;
+    geo.paintAreaWithSphere(ray, settings);
+    ASSERT_FALSE(geo.isSimpleTriangle(1));
+
+    picked = geo.intersectDetailedMesh(ray);
+    ASSERT_TRUE(picked);
+    EXPECT_EQ(picked->getBaseId(), 1);
+    ASSERT_TRUE(picked->getDetailId());
+    EXPECT_LT(*picked->getDetailId(), geo.getTriangleDetailCount(1));
+    // The center of the brush is painted
+    EXPECT_EQ(geo.getTriangle(*picked).getColor(), 1);
+
+    // Every ray over the painted detail hits the detail triangle picked for it
+    for(int x = -9; x <= 9; ++x) {
+        for(int z = -9; z <= 9; ++z) {
+            const ci::Ray gridRay(glm::vec3(0.2f + 0.0123f * x, 2.0f, 0.1f + 0.0117f * z), glm::vec3(0, -1, 0));
+            const auto gridPicked = geo.intersectDetailedMesh(gridRay);
+            ASSERT_TRUE(gridPicked);
+            if(gridPicked->getDetailId()) {
+                EXPECT_TRUE(pepr3d::GeometryUtils::triangleRayIntersection(geo.getTriangle(*gridPicked), gridRay));
+            }
+        }
+    }
+}
+
+TEST(Geometry, exportSnapshot) {
+    /**
+     * Test that the export snapshot keeps the painted state and its detailed mesh while the Geometry is painted on
+     */
+
+    pepr3d::Geometry geo(getGeometryWithCube());
+    const ci::Ray ray(glm::vec3(0.2f, 2.0f, 0.1f), glm::vec3(0, -1, 0));
+    pepr3d::BrushSettings settings;
+    settings.size = 0.1f;
+    settings.color = 1;
+    geo.paintAreaWithSphere(ray, settings);
+    geo.updateDetailedNormalsAndBorders();
+    const auto picked = geo.intersectDetailedMesh(ray);
+    ASSERT_TRUE(picked);
+    ASSERT_TRUE(picked->getDetailId());
+
+    const std::shared_ptr<const pepr3d::Geometry> snapshot = geo.createExportSnapshot();
+    ASSERT_NE(snapshot->getMeshDetailed(), nullptr);
+    EXPECT_TRUE(snapshot->areDetailedNormalsAndBordersValid());
+    EXPECT_EQ(snapshot->getMeshDetailed()->num_faces(), geo.getMeshDetailed()->num_faces());
+    EXPECT_EQ(snapshot->getMeshDetailedVertexPositions(), geo.getMeshDetailedVertexPositions());
+    EXPECT_EQ(snapshot->getBoundingBoxMin(), geo.getBoundingBoxMin());
+    EXPECT_EQ(snapshot->getBoundingBoxMax(), geo.getBoundingBoxMax());
+    for(const auto face : snapshot->getMeshDetailed()->faces()) {
+        EXPECT_EQ(snapshot->getMeshDetailedIdMap()[face], geo.getMeshDetailedIdMap()[face]);
+    }
+
+    // Painting the Geometry over the snapshot does not change it
+    const size_t detailCount = geo.getTriangleDetailCount(1);
+    settings.color = 2;
+    settings.size = 0.3f;
+    geo.paintAreaWithSphere(ray, settings);
+    EXPECT_EQ(snapshot->getTriangle(*picked).getColor(), 1);
+    EXPECT_EQ(snapshot->getTriangleDetailCount(1), detailCount);
+    EXPECT_EQ(snapshot->getTriangleCount(), geo.getTriangleCount());
+}
+
+TEST(Geometry, exportSnapshotWhilePainting) {
+    /**
+     * Test that exporting the snapshot on a worker gives the same scenes while the Geometry is painted on and its
+     * detailed mesh is patched, the painting clones the shared details instead of modifying them
+     */
+
+    pepr3d::Geometry geo(getGeometryWithCube());
+    pepr3d::BrushSettings settings;
+    settings.size = 0.1f;
+    settings.color = 1;
+    geo.paintAreaWithSphere(ci::Ray(glm::vec3(0.2f, 2.0f, 0.1f), glm::vec3(0, -1, 0)), settings);
+    geo.updateDetailedMesh();
+    const std::shared_ptr<const pepr3d::Geometry> snapshot = geo.createExportSnapshot();
+
+    ::ThreadPool& threadPool = pepr3d::Geometry::getThreadPool();
+    const auto getSceneSizes = [&snapshot, &threadPool]() {
+        pepr3d::ModelExporter exporter(snapshot.get(), nullptr, threadPool);
+        std::map<size_t, std::pair<unsigned int, unsigned int>> sizes;
+        for(const auto& scene : exporter.createScenes(pepr3d::ExportType::Surface)) {
+            const aiMesh* const mesh = scene.second->mMeshes[0];
+            sizes[scene.first] = {mesh->mNumVertices, mesh->mNumFaces};
+        }
+        return sizes;
+    };
+    const auto expectedSizes = getSceneSizes();
+    ASSERT_EQ(expectedSizes.size(), 2);
+
+    std::atomic<bool> isPainting(true);
+    auto exported = std::async(std::launch::async, [&]() {
+        size_t mismatchCount = 0;
+        for(size_t i = 0; i < 10 || isPainting; ++i) {
+            mismatchCount += getSceneSizes() != expectedSizes;
+        }
+        return mismatchCount;
+    });
+    for(int stroke = 0; stroke < 50; ++stroke) {
+        settings.color = 2 + stroke % 2;
+        settings.size = 0.05f + 0.01f * static_cast<float>(stroke % 10);
+        const float x = -0.4f + 0.016f * static_cast<float>(stroke);
+        geo.paintAreaWithSphere(ci::Ray(glm::vec3(x, 2.0f, 0.1f), glm::vec3(0, -1, 0)), settings);
+        geo.updateDetailedMesh();
+    }
+    isPainting = false;
+    EXPECT_EQ(exported.get(), 0);
+    EXPECT_EQ(getSceneSizes(), expectedSizes);
+}
+
+TEST(Geometry, saveProjectWhilePainting) {
+    /**
+     * Test that saving the project snapshot on a worker while the Geometry is painted on gives the state at the
+     * moment of the snapshot, the details of the snapshot share no exact kernel objects with the Geometry
+     */
+
+    pepr3d::Geometry geo(getGeometryWithCube());
+    pepr3d::BrushSettings settings;
+    settings.size = 0.1f;
+    settings.color = 1;
+    geo.paintAreaWithSphere(ci::Ray(glm::vec3(0.2f, 2.0f, 0.1f), glm::vec3(0, -1, 0)), settings);
+    const pepr3d::Geometry::ProjectSnapshot snapshot = geo.createProjectSnapshot();
+    ASSERT_FALSE(snapshot.triangleDetails.empty());
+    for(const auto& detail : snapshot.triangleDetails) {
+        EXPECT_FALSE(detail.second->hasExactData());
     }
+
+    using DetailColors = std::map<size_t, std::vector<pepr3d::ColorIndex>>;
+    const auto getDetailColors = [](const pepr3d::Geometry::ProjectSnapshot& projectSnapshot) {
+        DetailColors colors;
+        for(const auto& detail : projectSnapshot.triangleDetails) {
+            colors[detail.first] = detail.second->getTriangles().getColors();
+        }
+        return colors;
+    };
+    const DetailColors expectedColors = getDetailColors(snapshot);
+
+    ::ThreadPool& threadPool = pepr3d::Geometry::getThreadPool();
+    std::atomic<bool> isPainting(true);
+    auto saved = std::async(std::launch::async, [&]() {
+        size_t mismatchCount = 0;
+        for(size_t i = 0; i < 5 || isPainting; ++i) {
+            std::stringstream file(std::ios::in | std::ios::out | std::ios::binary);
+            pepr3d::ProjectFile::write(file, snapshot, threadPool);
+            pepr3d::Geometry::ProjectSnapshot loaded = pepr3d::ProjectFile::read(file, threadPool);
+            for(auto& detail : loaded.triangleDetails) {
+                detail.second.write().loadExactData();
+            }
+            mismatchCount += getDetailColors(loaded) != expectedColors ||
+                             loaded.triangles.getColors() != snapshot.triangles.getColors();
+        }
+        return mismatchCount;
+    });
+    for(int stroke = 0; stroke < 50; ++stroke) {
+        // The undo states share the details, so painting them again copies their exact kernel objects
+        const pepr3d::Geometry::GeometryState state = geo.saveState();
+        settings.color = 2 + stroke % 2;
+        settings.size = 0.05f + 0.01f * static_cast<float>(stroke % 10);
+        const float x = -0.4f + 0.016f * static_cast<float>(stroke);
+        geo.paintAreaWithSphere(ci::Ray(glm::vec3(x, 2.0f, 0.1f), glm::vec3(0, -1, 0)), settings);
+    }
+    isPainting = false;
+    EXPECT_EQ(saved.get(), 0);
+    EXPECT_EQ(getDetailColors(snapshot), expectedColors);
+}
+
+TEST(Geometry, neighbourCosine) {
+    /**
+     * Test the cosine of the angle between normals of triangles and of their details
+     */
+
+    pepr3d::Geometry geometry = getGeometryWithCube();
+    // Top and top, top and bottom, top and front
+    EXPECT_FLOAT_EQ(geometry.getNeighbourCosine(0, 1), 1.f);
+    EXPECT_FLOAT_EQ(geometry.getNeighbourCosine(0, 2), -1.f);
+    EXPECT_NEAR(geometry.getNeighbourCosine(0, 4), 0.f, 1e-6f);
+
+    // Details of one triangle are coplanar, details of two triangles use their normals
+    EXPECT_FLOAT_EQ(geometry.getNeighbourCosine(pepr3d::DetailedTriangleId(0, 0), pepr3d::DetailedTriangleId(0, 1)),
+                    1.f);
+    EXPECT_FLOAT_EQ(geometry.getNeighbourCosine(pepr3d::DetailedTriangleId(0, 1), pepr3d::DetailedTriangleId(2)),
+                    -1.f);
+}
+
+TEST(Geometry, bufferRangesMerge) {
+    /**
+     * Test that dirty buffer ranges are sorted and merged into the minimal set of uploads
+     */
+
+    pepr3d::Geometry::OpenGlData::BufferRanges ranges;
+    EXPECT_TRUE(ranges.empty());
+
+    ranges.add(30, 33);
+    ranges.add(33, 36);  // extends the last range
+    ranges.add(0, 3);
+    ranges.add(9, 12);
+    ranges.add(3, 6);
+    ranges.add(31, 32);
+    ranges.merge();
+
+    ASSERT_EQ(ranges.ranges.size(), 3);
+    EXPECT_EQ(ranges.ranges[0], std::make_pair<size_t, size_t>(0, 6));
+    EXPECT_EQ(ranges.ranges[1], std::make_pair<size_t, size_t>(9, 12));
+    EXPECT_EQ(ranges.ranges[2], std::make_pair<size_t, size_t>(30, 36));
+
+    ranges.clear();
+    EXPECT_TRUE(ranges.empty());
 }
 #endif
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <atomic>
 
 namespace pepr3d {
@@ -30,8 +31,12 @@ struct GeometryProgress {
 
     std::atomic<float> sdfPercentage{-1.0f};
 
+    /// Set by the user to stop the SDF computation, the workers check it after each chunk of triangles
+    std::atomic<bool> isSdfCancelled{false};
+
     void resetSdf() {
         sdfPercentage = -1.0f;
+        isSdfCancelled = false;
     }
 
     std::atomic<float> paintTextPercentage{-1.0f};
@@ -39,6 +44,22 @@ struct GeometryProgress {
     void resetPaintText() {
         paintTextPercentage = -1.0f;
     }
+
+    /// Writing a .p3d project on a worker, see Geometry::createProjectSnapshot()
+    std::atomic<float> saveProjectPercentage{-1.0f};
+
+    /// Exporting files on a worker from a snapshot, see Geometry::createExportSnapshot(). The progress of its scenes
+    /// and files is kept apart, so that it does not mix with the previews of the Geometry itself.
+    std::atomic<float> backgroundExportPercentage{-1.0f};
+
+    using Percentages = std::array<float, 11>;
+
+    /// Snapshot of all the percentages above, e.g., to find out whether any of them changed since the last frame
+    Percentages getPercentages() const {
+        return {importRenderPercentage, importComputePercentage, buffersPercentage, aabbTreePercentage,
+                polyhedronPercentage, createScenePercentage, exportFilePercentage, sdfPercentage,
+                paintTextPercentage, saveProjectPercentage, backgroundExportPercentage};
+    }
 };
 
 }  // namespace pepr3d
\ No newline at end of file
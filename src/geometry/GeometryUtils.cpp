@@ -5,6 +5,14 @@
 #include <CGAL/Aff_transformation_3.h>
 #include <CGAL/Min_sphere_of_points_d_traits_3.h>
 #include <CGAL/Min_sphere_of_spheres_d.h>
+#include <algorithm>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
 
 namespace pepr3d {
 
@@ -19,13 +27,13 @@ float GeometryUtils::segmentPointDistanceSquared(const glm::vec3 &start, const g
     return static_cast<float>(CGAL::squared_distance(segment, cgPoint));
 }
 
-std::optional<glm::vec3> GeometryUtils::triangleRayIntersection(const DataTriangle &tri, ci::Ray ray) {
+std::optional<glm::vec3> GeometryUtils::triangleRayIntersection(const DataTriangle::Triangle &tri, ci::Ray ray) {
     const glm::vec3 source = ray.getOrigin();
     const glm::vec3 direction = ray.getDirection();
     const pepr3d::Geometry::Ray rayQuery(pepr3d::DataTriangle::Point(source.x, source.y, source.z),
                                          pepr3d::Geometry::Direction(direction.x, direction.y, direction.z));
 
-    auto intersectionPointOrSeg = CGAL::intersection(rayQuery, tri.getTri());
+    auto intersectionPointOrSeg = CGAL::intersection(rayQuery, tri);
     if(intersectionPointOrSeg) {
         glm::vec3 result = boost::apply_visitor(TriRayIntVisitor{}, *intersectionPointOrSeg);
         return result;
@@ -46,6 +54,267 @@ bool GeometryUtils::isFullyInsideASphere(const DataTriangle::K::Triangle_3 &tri,
     return dist0 <= radiusSquared && dist1 <= radiusSquared && dist2 <= radiusSquared;
 }
 
+namespace {
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+using Floats = __m128;
+
+inline Floats loadFloats(const float* values) {
+    return _mm_load_ps(values);
+}
+inline Floats splatFloats(const float value) {
+    return _mm_set1_ps(value);
+}
+inline Floats add(const Floats a, const Floats b) {
+    return _mm_add_ps(a, b);
+}
+inline Floats sub(const Floats a, const Floats b) {
+    return _mm_sub_ps(a, b);
+}
+inline Floats mul(const Floats a, const Floats b) {
+    return _mm_mul_ps(a, b);
+}
+inline Floats div(const Floats a, const Floats b) {
+    return _mm_div_ps(a, b);
+}
+inline Floats min(const Floats a, const Floats b) {
+    return _mm_min_ps(a, b);
+}
+inline Floats max(const Floats a, const Floats b) {
+    return _mm_max_ps(a, b);
+}
+/// Bit i is set if lane i of a is less than (or equal to) lane i of b
+inline unsigned lessMask(const Floats a, const Floats b) {
+    return static_cast<unsigned>(_mm_movemask_ps(_mm_cmplt_ps(a, b)));
+}
+inline unsigned lessEqualMask(const Floats a, const Floats b) {
+    return static_cast<unsigned>(_mm_movemask_ps(_mm_cmple_ps(a, b)));
+}
+#elif defined(__aarch64__) || defined(_M_ARM64)
+using Floats = float32x4_t;
+
+inline Floats loadFloats(const float* values) {
+    return vld1q_f32(values);
+}
+inline Floats splatFloats(const float value) {
+    return vdupq_n_f32(value);
+}
+inline Floats add(const Floats a, const Floats b) {
+    return vaddq_f32(a, b);
+}
+inline Floats sub(const Floats a, const Floats b) {
+    return vsubq_f32(a, b);
+}
+inline Floats mul(const Floats a, const Floats b) {
+    return vmulq_f32(a, b);
+}
+inline Floats div(const Floats a, const Floats b) {
+    return vdivq_f32(a, b);
+}
+inline Floats min(const Floats a, const Floats b) {
+    return vminq_f32(a, b);
+}
+inline Floats max(const Floats a, const Floats b) {
+    return vmaxq_f32(a, b);
+}
+inline unsigned toMask(const uint32x4_t lanes) {
+    const uint32_t bitValues[4] = {1, 2, 4, 8};
+    return vaddvq_u32(vandq_u32(lanes, vld1q_u32(bitValues)));
+}
+inline unsigned lessMask(const Floats a, const Floats b) {
+    return toMask(vcltq_f32(a, b));
+}
+inline unsigned lessEqualMask(const Floats a, const Floats b) {
+    return toMask(vcleq_f32(a, b));
+}
+#else
+/// Scalar fallback, the compiler may still vectorize the loops
+struct Floats {
+    float lanes[4];
+};
+
+template <typename Func>
+inline Floats eachLane(const Floats a, const Floats b, const Func& func) {
+    Floats result;
+    for(int i = 0; i < 4; ++i) {
+        result.lanes[i] = func(a.lanes[i], b.lanes[i]);
+    }
+    return result;
+}
+inline Floats loadFloats(const float* values) {
+    return {{values[0], values[1], values[2], values[3]}};
+}
+inline Floats splatFloats(const float value) {
+    return {{value, value, value, value}};
+}
+inline Floats add(const Floats a, const Floats b) {
+    return eachLane(a, b, [](float x, float y) { return x + y; });
+}
+inline Floats sub(const Floats a, const Floats b) {
+    return eachLane(a, b, [](float x, float y) { return x - y; });
+}
+inline Floats mul(const Floats a, const Floats b) {
+    return eachLane(a, b, [](float x, float y) { return x * y; });
+}
+inline Floats div(const Floats a, const Floats b) {
+    return eachLane(a, b, [](float x, float y) { return x / y; });
+}
+inline Floats min(const Floats a, const Floats b) {
+    return eachLane(a, b, [](float x, float y) { return y < x ? y : x; });
+}
+inline Floats max(const Floats a, const Floats b) {
+    return eachLane(a, b, [](float x, float y) { return y > x ? y : x; });
+}
+inline unsigned lessMask(const Floats a, const Floats b) {
+    unsigned mask = 0;
+    for(int i = 0; i < 4; ++i) {
+        mask |= a.lanes[i] < b.lanes[i] ? 1u << i : 0u;
+    }
+    return mask;
+}
+inline unsigned lessEqualMask(const Floats a, const Floats b) {
+    unsigned mask = 0;
+    for(int i = 0; i < 4; ++i) {
+        mask |= a.lanes[i] <= b.lanes[i] ? 1u << i : 0u;
+    }
+    return mask;
+}
+#endif
+
+/// Triangles classified at once, one in each lane
+constexpr size_t BLOCK_TRIANGLES = 4;
+
+/// Coordinates of the vertices of a block of triangles, transposed so that each array fills the lanes
+struct TriangleBlock {
+    alignas(16) float x[3][BLOCK_TRIANGLES] = {};
+    alignas(16) float y[3][BLOCK_TRIANGLES] = {};
+    alignas(16) float z[3][BLOCK_TRIANGLES] = {};
+
+    void set(const size_t lane, const size_t vertex, const glm::vec3& position) {
+        x[vertex][lane] = position.x;
+        y[vertex][lane] = position.y;
+        z[vertex][lane] = position.z;
+    }
+};
+
+struct Point3s {
+    Floats x, y, z;
+};
+
+inline Floats dot(const Point3s& a, const Point3s& b) {
+    return add(add(mul(a.x, b.x), mul(a.y, b.y)), mul(a.z, b.z));
+}
+
+inline Point3s sub(const Point3s& a, const Point3s& b) {
+    return {sub(a.x, b.x), sub(a.y, b.y), sub(a.z, b.z)};
+}
+
+/// Squared distance of the point from the segment [start, end], degenerate segments are their start
+inline Floats segmentPointDistanceSquared(const Point3s& start, const Point3s& end, const Point3s& point) {
+    const Point3s segment = sub(end, start);
+    const Point3s toPoint = sub(point, start);
+    // The projection is 0 for a degenerate segment too, the length only must not be 0
+    const Floats length = max(dot(segment, segment), splatFloats(std::numeric_limits<float>::min()));
+    const Floats t = min(max(div(dot(toPoint, segment), length), splatFloats(0.f)), splatFloats(1.f));
+    const Point3s offset{sub(toPoint.x, mul(t, segment.x)), sub(toPoint.y, mul(t, segment.y)),
+                         sub(toPoint.z, mul(t, segment.z))};
+    return dot(offset, offset);
+}
+
+/// Classify the first count triangles of the block
+void classifyBlock(const TriangleBlock& block, const size_t count, const glm::vec3& center,
+                   const float radiusSquared, SphereCoverage* coverage) {
+    const Point3s centers{splatFloats(center.x), splatFloats(center.y), splatFloats(center.z)};
+    const Floats limit = splatFloats(radiusSquared);
+
+    Point3s vertices[3];
+    unsigned insideMask = (1u << BLOCK_TRIANGLES) - 1;
+    for(size_t i = 0; i < 3; ++i) {
+        vertices[i] = {loadFloats(block.x[i]), loadFloats(block.y[i]), loadFloats(block.z[i])};
+        const Point3s offset = sub(vertices[i], centers);
+        insideMask &= lessEqualMask(dot(offset, offset), limit);
+    }
+
+    Floats edgeDistance = segmentPointDistanceSquared(vertices[0], vertices[1], centers);
+    edgeDistance = min(edgeDistance, segmentPointDistanceSquared(vertices[1], vertices[2], centers));
+    edgeDistance = min(edgeDistance, segmentPointDistanceSquared(vertices[2], vertices[0], centers));
+    const unsigned intersectingMask = lessMask(edgeDistance, limit);
+
+    for(size_t lane = 0; lane < count; ++lane) {
+        const unsigned bit = 1u << lane;
+        coverage[lane] = (insideMask & bit) != 0
+                             ? SphereCoverage::Inside
+                             : ((intersectingMask & bit) != 0 ? SphereCoverage::Intersecting : SphereCoverage::Outside);
+    }
+}
+}  // namespace
+
+std::vector<SphereCoverage> GeometryUtils::classifyTriangles(const std::vector<glm::vec3>& vertices,
+                                                             const std::vector<size_t>& triangleIds,
+                                                             const glm::vec3& center, const float radius) {
+    std::vector<SphereCoverage> coverage(triangleIds.size());
+    for(size_t blockStart = 0; blockStart < triangleIds.size(); blockStart += BLOCK_TRIANGLES) {
+        const size_t count = std::min(BLOCK_TRIANGLES, triangleIds.size() - blockStart);
+        TriangleBlock block;
+        for(size_t lane = 0; lane < count; ++lane) {
+            const size_t firstVertex = 3 * triangleIds[blockStart + lane];
+            P_ASSERT(firstVertex + 2 < vertices.size());
+            for(size_t i = 0; i < 3; ++i) {
+                block.set(lane, i, vertices[firstVertex + i]);
+            }
+        }
+        classifyBlock(block, count, center, radius * radius, coverage.data() + blockStart);
+    }
+    return coverage;
+}
+
+SphereCoverage GeometryUtils::classifyTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c,
+                                               const glm::vec3& center, const float radius) {
+    TriangleBlock block;
+    block.set(0, 0, a);
+    block.set(0, 1, b);
+    block.set(0, 2, c);
+    SphereCoverage coverage = SphereCoverage::Outside;
+    classifyBlock(block, 1, center, radius * radius, &coverage);
+    return coverage;
+}
+
+SphereCoverage GeometryUtils::classifyTriangleAgainstCapsule(const glm::vec3 &a, const glm::vec3 &b,
+                                                             const glm::vec3 &c, const glm::vec3 &start,
+                                                             const glm::vec3 &end, const float radius) {
+    if(start == end) {
+        return classifyTriangle(a, b, c, start, radius);
+    }
+
+    using K = CGAL::Simple_cartesian<double>;
+    using Point = K::Point_3;
+    using Segment = K::Segment_3;
+
+    const Point vertices[3] = {Point(a.x, a.y, a.z), Point(b.x, b.y, b.z), Point(c.x, c.y, c.z)};
+    const Segment axis(Point(start.x, start.y, start.z), Point(end.x, end.y, end.z));
+    const double radiusSquared = static_cast<double>(radius) * radius;
+
+    // The capsule is convex, it contains the triangle if it contains the vertices
+    if(std::all_of(std::begin(vertices), std::end(vertices),
+                   [&axis, radiusSquared](const Point &vertex) {
+                       return CGAL::squared_distance(axis, vertex) <= radiusSquared;
+                   })) {
+        return SphereCoverage::Inside;
+    }
+
+    for(int i = 0; i < 3; ++i) {
+        const Segment edge(vertices[i], vertices[(i + 1) % 3]);
+        if(CGAL::squared_distance(axis, edge) < radiusSquared) {
+            return SphereCoverage::Intersecting;
+        }
+    }
+
+    const K::Triangle_3 triangle(vertices[0], vertices[1], vertices[2]);
+    if(!triangle.is_degenerate() && CGAL::do_intersect(triangle, axis)) {
+        return SphereCoverage::Intersecting;
+    }
+    return SphereCoverage::Outside;
+}
+
 std::pair<DataTriangle::K::Point_3, double> GeometryUtils::getBoundingSphere(
     const std::vector<DataTriangle::K::Point_3> &shape) {
     using K = DataTriangle::K;
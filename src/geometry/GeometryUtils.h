@@ -16,6 +16,7 @@
 #include <CGAL/Polygon_set_2.h>
 #include <CGAL/Polygon_with_holes_2.h>
 #include <CGAL/Simple_cartesian.h>
+#include <cstdint>
 #include <optional>
 #include <vector>
 
@@ -24,6 +25,16 @@
 namespace pepr3d {
 class DataTriangle;
 
+/// How a triangle is covered by a sphere or a capsule, see GeometryUtils::classifyTriangles()
+enum class SphereCoverage : std::uint8_t {
+    /// No edge of the triangle is closer to the center than the radius
+    Outside,
+    /// An edge is closer to the center than the radius, but not all vertices are inside
+    Intersecting,
+    /// All vertices are at most the radius from the center
+    Inside
+};
+
 /// Static utility functions that are not closely tied to Geometry
 class GeometryUtils {
    private:
@@ -184,7 +195,7 @@ class GeometryUtils {
 
     /// Find intersection point of a ray and a single triangle
     /// If the intersection is a segment return one of the edge points
-    static std::optional<glm::vec3> triangleRayIntersection(const class DataTriangle& tri, ci::Ray ray);
+    static std::optional<glm::vec3> triangleRayIntersection(const DataTriangle::Triangle& tri, ci::Ray ray);
 
     static bool isFullyInsideASphere(const DataTriangle::K::Triangle_3& tri, const DataTriangle::K::Point_3& origin,
                                      double radius);
@@ -192,6 +203,25 @@ class GeometryUtils {
     static bool isFullyInsideASphere(const DataTriangle::K::Triangle_3& tri, const glm::vec3& origin, double radius) {
         return isFullyInsideASphere(tri, DataTriangle::K::Point_3(origin.x, origin.y, origin.z), radius);
     }
+
+    /// Classify the triangles against a sphere, in blocks of SIMD lanes (SSE2 or NEON, scalar elsewhere).
+    /// Compares the distances of the vertices and the edges in floats, unlike isFullyInsideASphere().
+    /// @param vertices 3 consecutive vertices of each triangle, e.g., TriangleStore::getVertices()
+    /// @param triangleIds Triangles of vertices to classify
+    /// @return Coverage of each of triangleIds
+    static std::vector<SphereCoverage> classifyTriangles(const std::vector<glm::vec3>& vertices,
+                                                         const std::vector<size_t>& triangleIds,
+                                                         const glm::vec3& center, float radius);
+
+    /// Classify a single triangle against a sphere, the same as classifyTriangles()
+    static SphereCoverage classifyTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c,
+                                           const glm::vec3& center, float radius);
+
+    /// Classify a triangle against a capsule, the points at most radius from the segment from start to end.
+    /// The triangle intersects the capsule if an edge is closer than the radius or the segment crosses it.
+    /// A capsule of a single point is classified as a sphere by classifyTriangle().
+    static SphereCoverage classifyTriangleAgainstCapsule(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c,
+                                                         const glm::vec3& start, const glm::vec3& end, float radius);
 };
 
 }  // namespace pepr3d
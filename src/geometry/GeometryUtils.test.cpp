@@ -3,6 +3,10 @@
 #include <CGAL/Exact_predicates_exact_constructions_kernel.h>
 #include <CGAL/Polygon_2.h>
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
 #include "geometry/GeometryUtils.h"
 using glm::vec3;
 using pepr3d::GeometryUtils;
@@ -82,5 +86,101 @@ TEST(GeometryUtils, SimplifyPolygon) {
 
     EXPECT_FALSE(GeometryUtils::simplifyPolygon(pgn));
 }
+
+TEST(GeometryUtils, classifyTriangles) {
+    /**
+     * Test that the batched classification agrees with the per triangle distances, including the last partial block
+     */
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> coordinate(-1.f, 1.f);
+    std::vector<vec3> vertices;
+    std::vector<size_t> triangleIds;
+    for(size_t i = 0; i < 103; ++i) {
+        for(int v = 0; v < 3; ++v) {
+            vertices.emplace_back(coordinate(generator), coordinate(generator), coordinate(generator));
+        }
+        triangleIds.push_back((i * 37) % 103);
+    }
+    // A degenerate triangle in the sphere
+    vertices.insert(vertices.end(), 3, vec3(0.1f, 0.f, 0.f));
+    triangleIds.push_back(103);
+
+    const vec3 center(0.1f, 0.2f, -0.1f);
+    const float radius = 0.7f;
+    const float radiusSquared = radius * radius;
+    const std::vector<SphereCoverage> coverage =
+        GeometryUtils::classifyTriangles(vertices, triangleIds, center, radius);
+    ASSERT_EQ(coverage.size(), triangleIds.size());
+
+    size_t coverageCounts[3] = {};
+    for(size_t i = 0; i < triangleIds.size(); ++i) {
+        const vec3& a = vertices[3 * triangleIds[i]];
+        const vec3& b = vertices[3 * triangleIds[i] + 1];
+        const vec3& c = vertices[3 * triangleIds[i] + 2];
+        const float edgeDistance = std::min({GeometryUtils::segmentPointDistanceSquared(a, b, center),
+                                             GeometryUtils::segmentPointDistanceSquared(b, c, center),
+                                             GeometryUtils::segmentPointDistanceSquared(c, a, center)});
+        const DataTriangle::K::Triangle_3 cgalTri(DataTriangle::K::Point_3(a.x, a.y, a.z),
+                                                   DataTriangle::K::Point_3(b.x, b.y, b.z),
+                                                   DataTriangle::K::Point_3(c.x, c.y, c.z));
+        const bool isInside = GeometryUtils::isFullyInsideASphere(cgalTri, center, radius);
+
+        // Distances at the radius may differ in the float and the double precision
+        const float farthestVertex = std::max({glm::dot(a - center, a - center), glm::dot(b - center, b - center),
+                                               glm::dot(c - center, c - center)});
+        if(std::abs(edgeDistance - radiusSquared) < 1e-4f || std::abs(farthestVertex - radiusSquared) < 1e-4f) {
+            continue;
+        }
+
+        const SphereCoverage expected = isInside ? SphereCoverage::Inside
+                                                 : (edgeDistance < radiusSquared ? SphereCoverage::Intersecting
+                                                                                 : SphereCoverage::Outside);
+        EXPECT_EQ(coverage[i], expected);
+        EXPECT_EQ(GeometryUtils::classifyTriangle(a, b, c, center, radius), expected);
+        ++coverageCounts[static_cast<size_t>(expected)];
+    }
+    EXPECT_EQ(coverage.back(), SphereCoverage::Inside);
+    EXPECT_GT(coverageCounts[static_cast<size_t>(SphereCoverage::Outside)], 0);
+    EXPECT_GT(coverageCounts[static_cast<size_t>(SphereCoverage::Intersecting)], 0);
+    EXPECT_TRUE(GeometryUtils::classifyTriangles(vertices, {}, center, radius).empty());
+}
+
+TEST(GeometryUtils, classifyTriangleAgainstCapsule) {
+    /**
+     * Test the coverage of a triangle by capsules passing along it, through it and beside it
+     */
+
+    const vec3 a(0.f, 0.f, 0.f);
+    const vec3 b(1.f, 0.f, 0.f);
+    const vec3 c(0.f, 1.f, 0.f);
+
+    // Along the triangle over all of its edges, and over all of it
+    EXPECT_EQ(GeometryUtils::classifyTriangleAgainstCapsule(a, b, c, vec3(-1.f, 0.2f, 0.1f), vec3(2.f, 0.2f, 0.1f),
+                                                            0.15f),
+              SphereCoverage::Intersecting);
+    EXPECT_EQ(GeometryUtils::classifyTriangleAgainstCapsule(a, b, c, vec3(0.f), vec3(0.5f, 0.5f, 0.f), 2.f),
+              SphereCoverage::Inside);
+
+    // Through the interior, far from all edges
+    EXPECT_EQ(GeometryUtils::classifyTriangleAgainstCapsule(a, b, c, vec3(0.3f, 0.3f, 5.f), vec3(0.3f, 0.3f, -5.f),
+                                                            0.01f),
+              SphereCoverage::Intersecting);
+
+    // Above the triangle and beside it
+    EXPECT_EQ(GeometryUtils::classifyTriangleAgainstCapsule(a, b, c, vec3(-1.f, -1.f, 2.f), vec3(2.f, 2.f, 2.f),
+                                                            0.5f),
+              SphereCoverage::Outside);
+    EXPECT_EQ(GeometryUtils::classifyTriangleAgainstCapsule(a, b, c, vec3(-0.5f, -2.f, 0.f), vec3(-0.5f, 2.f, 0.f),
+                                                            0.4f),
+              SphereCoverage::Outside);
+
+    // A capsule of a single point is a sphere
+    for(const float radius : {0.1f, 0.5f, 2.f}) {
+        const vec3 center(0.2f, -0.3f, 0.1f);
+        EXPECT_EQ(GeometryUtils::classifyTriangleAgainstCapsule(a, b, c, center, center, radius),
+                  GeometryUtils::classifyTriangle(a, b, c, center, radius));
+    }
+}
 }  // namespace pepr3d
 #endif
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include "geometry/ImportCache.h"
+
+#include <cinder/Log.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "geometry/ProjectFile.h"
+
+namespace pepr3d {
+
+namespace {
+const std::string ENTRY_EXTENSION = ".p3d";
+
+/// Entry being written, renamed once complete
+const std::string PARTIAL_ENTRY_EXTENSION = ".p3d.saving";
+
+/// Bytes of the file hashed at once
+const size_t HASH_BLOCK_SIZE = size_t(1) << 20;
+
+/// FNV-1a over 64-bit words, like Geometry::computeDerivedDataHash()
+void addToHash(uint64_t& hash, const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for(; size >= sizeof(uint64_t); size -= sizeof(uint64_t), bytes += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, bytes, sizeof(uint64_t));
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    for(; size > 0; --size, ++bytes) {
+        hash = (hash ^ *bytes) * 1099511628211ull;
+    }
+}
+
+/// Time of the last write of a file, the type differs between the implementations of ci::fs
+using WriteTime = decltype(ci::fs::last_write_time(std::declval<ci::fs::path>()));
+
+/// Entry files of the cache with their time of writing and size, written first to last
+std::vector<std::tuple<WriteTime, ci::fs::path, uint64_t>> listEntries(const ci::fs::path& directory) {
+    std::vector<std::tuple<WriteTime, ci::fs::path, uint64_t>> entries;
+    try {
+        if(!ci::fs::is_directory(directory)) {
+            return entries;
+        }
+        for(ci::fs::directory_iterator it(directory), end; it != end; ++it) {
+            const std::string name = it->path().filename().string();
+            if(name.size() <= ENTRY_EXTENSION.size() ||
+               name.compare(name.size() - ENTRY_EXTENSION.size(), ENTRY_EXTENSION.size(), ENTRY_EXTENSION) != 0) {
+                continue;
+            }
+            entries.emplace_back(ci::fs::last_write_time(it->path()), it->path(),
+                                 static_cast<uint64_t>(ci::fs::file_size(it->path())));
+        }
+    } catch(const std::exception& e) {
+        CI_LOG_W("Could not list the import cache in " + directory.string() + ": " + e.what());
+    }
+    std::sort(entries.begin(), entries.end());
+    return entries;
+}
+}  // namespace
+
+ImportCache::ImportCache(const ci::fs::path& directory, const uint64_t maxBytes)
+    : mDirectory(directory), mMaxBytes(maxBytes) {}
+
+std::optional<uint64_t> ImportCache::computeKey(const ci::fs::path& modelPath) {
+    std::ifstream is(modelPath.string(), std::ios::binary);
+    if(!is.is_open()) {
+        return {};
+    }
+
+    uint64_t hash = 14695981039346656037ull;
+    const uint32_t importerVersion = IMPORTER_VERSION;
+    addToHash(hash, &importerVersion, sizeof(importerVersion));
+
+    // The importer is chosen by the extension
+    std::string extension = modelPath.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](const unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    addToHash(hash, extension.data(), extension.size());
+
+    std::vector<char> block(HASH_BLOCK_SIZE);
+    uint64_t fileSize = 0;
+    while(is) {
+        is.read(block.data(), static_cast<std::streamsize>(block.size()));
+        const size_t readSize = static_cast<size_t>(is.gcount());
+        addToHash(hash, block.data(), readSize);
+        fileSize += readSize;
+    }
+    if(is.bad()) {
+        return {};
+    }
+    addToHash(hash, &fileSize, sizeof(fileSize));
+    return hash;
+}
+
+std::optional<Geometry::ProjectSnapshot> ImportCache::read(const uint64_t key, ::ThreadPool& threadPool) {
+    if(!isEnabled()) {
+        return {};
+    }
+    const std::lock_guard<std::mutex> lock(mMutex);
+    const ci::fs::path path = getPath(key);
+    std::ifstream is(path.string(), std::ios::binary);
+    if(!is.is_open()) {
+        return {};
+    }
+
+    try {
+        if(ProjectFile::isProjectFile(is)) {
+            Geometry::ProjectSnapshot snapshot = ProjectFile::read(is, threadPool);
+            if(snapshot.derivedDataHash) {
+                return snapshot;
+            }
+        }
+    } catch(const std::exception& e) {
+        CI_LOG_W("The import cache entry " + path.string() + " cannot be read: " + e.what());
+    }
+    is.close();
+    std::remove(path.string().c_str());
+    return {};
+}
+
+bool ImportCache::write(const uint64_t key, const Geometry::ProjectSnapshot& snapshot, ::ThreadPool& threadPool) {
+    const uint64_t maxBytes = mMaxBytes;
+    if(maxBytes == 0) {
+        return false;
+    }
+    const std::lock_guard<std::mutex> lock(mMutex);
+    const ci::fs::path path = getPath(key);
+    ci::fs::path temporaryPath = path;
+    temporaryPath.replace_extension(PARTIAL_ENTRY_EXTENSION);
+    try {
+        ci::fs::create_directories(mDirectory);
+        std::ofstream os(temporaryPath.string(), std::ios::binary);
+        if(!os.is_open()) {
+            throw std::runtime_error("Could not open " + temporaryPath.string());
+        }
+        ProjectFile::write(os, snapshot, threadPool);
+        os.close();
+        if(!os) {
+            throw std::runtime_error("Could not write " + temporaryPath.string());
+        }
+        std::remove(path.string().c_str());
+        ci::fs::rename(temporaryPath, path);
+    } catch(const std::exception& e) {
+        std::remove(temporaryPath.string().c_str());
+        CI_LOG_W("Writing the import cache entry failed: " << e.what());
+        return false;
+    }
+
+    removeEntriesAbove(maxBytes);
+    return true;
+}
+
+uint64_t ImportCache::getSize() const {
+    uint64_t size = 0;
+    for(const auto& entry : listEntries(mDirectory)) {
+        size += std::get<2>(entry);
+    }
+    return size;
+}
+
+void ImportCache::clear() {
+    const std::lock_guard<std::mutex> lock(mMutex);
+    removeEntriesAbove(0);
+}
+
+ci::fs::path ImportCache::getPath(const uint64_t key) const {
+    std::ostringstream name;
+    name << std::hex << key << ENTRY_EXTENSION;
+    return mDirectory / name.str();
+}
+
+void ImportCache::removeEntriesAbove(const uint64_t maxBytes) {
+    const auto entries = listEntries(mDirectory);
+    uint64_t size = 0;
+    for(const auto& entry : entries) {
+        size += std::get<2>(entry);
+    }
+    for(auto it = entries.begin(); it != entries.end() && size > maxBytes; ++it) {
+        if(std::remove(std::get<1>(*it).string().c_str()) == 0) {
+            size -= std::get<2>(*it);
+        }
+    }
+}
+
+}  // namespace pepr3d
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cinder/Filesystem.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+
+#include "ThreadPool.h"
+#include "geometry/Geometry.h"
+
+namespace pepr3d {
+
+/// Cache of imported models on disk, importing the same file again skips the importer and the computation of the
+/// derived data. An entry is the project of the freshly imported model in the ProjectFile container, with the welded
+/// vertices and indices, the normals, the colors and the derived data: the face adjacency, the picking tree and the
+/// SDF values if there are any. Entries are keyed by a hash of the contents and the extension of the file and by
+/// IMPORTER_VERSION, they are files "<key>.p3d" in the directory of the cache.
+/// Once the cache is larger than its limit, the entries written first are removed.
+/// The methods can be called from any thread.
+class ImportCache {
+   public:
+    /// Part of the keys, raise it when the importers or the import options change the imported model
+    static const uint32_t IMPORTER_VERSION = 1;
+
+    /// @param maxBytes Size limit of all entries, 0 turns the cache off
+    ImportCache(const ci::fs::path& directory, uint64_t maxBytes);
+
+    const ci::fs::path& getDirectory() const {
+        return mDirectory;
+    }
+
+    uint64_t getMaxBytes() const {
+        return mMaxBytes;
+    }
+
+    /// Set the size limit, the entries above it are removed with the next write()
+    void setMaxBytes(uint64_t maxBytes) {
+        mMaxBytes = maxBytes;
+    }
+
+    bool isEnabled() const {
+        return mMaxBytes > 0;
+    }
+
+    /// Key of the model file, empty if the file cannot be read
+    static std::optional<uint64_t> computeKey(const ci::fs::path& modelPath);
+
+    /// Project of the cached model, empty if it is not cached or the cache is off.
+    /// A corrupted entry is removed.
+    std::optional<Geometry::ProjectSnapshot> read(uint64_t key, ::ThreadPool& threadPool);
+
+    /// Store the project of an imported model, then remove the entries above the size limit.
+    /// Returns false if the entry could not be written.
+    bool write(uint64_t key, const Geometry::ProjectSnapshot& snapshot, ::ThreadPool& threadPool);
+
+    /// Total size of the entries in bytes
+    uint64_t getSize() const;
+
+    /// Remove all entries
+    void clear();
+
+   private:
+    ci::fs::path getPath(uint64_t key) const;
+
+    /// Remove the entries written first until the entries fit into maxBytes
+    void removeEntriesAbove(uint64_t maxBytes);
+
+    ci::fs::path mDirectory;
+    std::atomic<uint64_t> mMaxBytes;
+
+    /// Held while entries are written or removed
+    std::mutex mMutex;
+};
+
+}  // namespace pepr3d
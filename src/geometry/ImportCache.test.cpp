@@ -0,0 +1,103 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "geometry/ImportCache.h"
+
+namespace pepr3d {
+
+namespace {
+/// Snapshot of a strip of size quads
+Geometry::ProjectSnapshot getStripSnapshot(const size_t size) {
+    Geometry::ProjectSnapshot snapshot;
+    for(size_t x = 0; x <= size; ++x) {
+        snapshot.vertices.emplace_back(static_cast<float>(x), 0.f, 0.f);
+        snapshot.vertices.emplace_back(static_cast<float>(x), 1.f, 0.f);
+    }
+    std::vector<glm::vec3> triangleVertices;
+    for(size_t x = 0; x < size; ++x) {
+        snapshot.indices.push_back({2 * x, 2 * x + 2, 2 * x + 1});
+        snapshot.indices.push_back({2 * x + 2, 2 * x + 3, 2 * x + 1});
+    }
+    for(const std::array<size_t, 3>& triangle : snapshot.indices) {
+        for(const size_t vertexIdx : triangle) {
+            triangleVertices.push_back(snapshot.vertices[vertexIdx]);
+        }
+    }
+    const size_t triangleCount = snapshot.indices.size();
+    snapshot.triangles.assign(std::move(triangleVertices), std::vector<glm::vec3>(triangleCount, glm::vec3(0, 0, 1)),
+                              std::vector<ColorIndex>(triangleCount, 0));
+    return snapshot;
+}
+
+void writeFile(const ci::fs::path& path, const std::string& contents) {
+    std::ofstream os(path.string(), std::ios::binary);
+    os << contents;
+}
+}  // namespace
+
+TEST(ImportCache, storesImportedModels) {
+    /**
+     * Test that the key follows the contents and the extension of the file, that a stored model is read back and
+     * that the entries written first are removed once the cache is over its limit
+     */
+
+    const ci::fs::path directory = ci::fs::temp_directory_path() / "pepr3d_import_cache_test";
+    ci::fs::remove_all(directory);
+    ci::fs::create_directories(directory);
+    writeFile(directory / "a.stl", "solid a");
+    writeFile(directory / "b.stl", "solid b");
+    writeFile(directory / "a.obj", "solid a");
+    const std::optional<uint64_t> keyA = ImportCache::computeKey(directory / "a.stl");
+    const std::optional<uint64_t> keyB = ImportCache::computeKey(directory / "b.stl");
+    ASSERT_TRUE(keyA && keyB);
+    EXPECT_NE(*keyA, *keyB);
+    EXPECT_NE(*keyA, ImportCache::computeKey(directory / "a.obj"));
+    EXPECT_EQ(*keyA, ImportCache::computeKey(directory / "a.stl"));
+    EXPECT_FALSE(ImportCache::computeKey(directory / "missing.stl"));
+
+    ::ThreadPool threadPool(2);
+    ImportCache cache(directory / "cache", 1 << 30);
+    EXPECT_FALSE(cache.read(*keyA, threadPool));
+
+    const Geometry::ProjectSnapshot snapshot = getStripSnapshot(100);
+    ASSERT_TRUE(cache.write(*keyA, snapshot, threadPool));
+    const std::optional<Geometry::ProjectSnapshot> cached = cache.read(*keyA, threadPool);
+    ASSERT_TRUE(cached);
+    EXPECT_EQ(cached->vertices, snapshot.vertices);
+    EXPECT_EQ(cached->indices, snapshot.indices);
+    EXPECT_EQ(cached->triangles.getVertices(), snapshot.triangles.getVertices());
+    EXPECT_EQ(cached->derivedDataHash, snapshot.computeDerivedDataHash());
+    EXPECT_FALSE(cache.read(*keyB, threadPool));
+
+    // A limit below two entries keeps one of them, the write times may be equal
+    const uint64_t entrySize = cache.getSize();
+    cache.setMaxBytes(entrySize + entrySize / 2);
+    ASSERT_TRUE(cache.write(*keyB, snapshot, threadPool));
+    EXPECT_LE(cache.getSize(), cache.getMaxBytes());
+    EXPECT_NE(cache.read(*keyA, threadPool).has_value(), cache.read(*keyB, threadPool).has_value());
+
+    // A corrupted entry is removed
+    std::ostringstream name;
+    name << std::hex << *keyA << ".p3d";
+    writeFile(cache.getDirectory() / name.str(), "corrupted");
+    EXPECT_FALSE(cache.read(*keyA, threadPool));
+    EXPECT_FALSE(ci::fs::exists(cache.getDirectory() / name.str()));
+
+    cache.clear();
+    EXPECT_EQ(cache.getSize(), 0);
+
+    cache.setMaxBytes(0);
+    EXPECT_FALSE(cache.isEnabled());
+    EXPECT_FALSE(cache.write(*keyA, snapshot, threadPool));
+    ci::fs::remove_all(directory);
+}
+
+}  // namespace pepr3d
+
+#endif
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cinder/gl/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include "glm/glm.hpp"
+
+namespace pepr3d {
+
+/// GPU memory the vertex, index and face triangle buffers of a Geometry are written to directly, handed over by
+/// ModelView, see Geometry::updateOpenGlBuffers(). While a storage is used, the Geometry does not keep the three
+/// buffers on the CPU.
+class MappedBufferStorage {
+   public:
+    virtual ~MappedBufferStorage() = default;
+
+    /// Make room for at least the vertices and faces and map the buffers for writing.
+    /// Returns false if their previous contents were lost, e.g., when they had to grow, then all of the buffers are
+    /// generated again.
+    virtual bool map(size_t vertexCount, size_t faceCount) = 0;
+
+    /// The mapped buffers, valid until the storage is unmapped by its owner
+    virtual glm::vec3* getVertices() = 0;
+    virtual uint32_t* getIndices() = 0;
+    virtual GLuint* getFaceTriangles() = 0;
+};
+
+}  // namespace pepr3d
@@ -0,0 +1,117 @@
+#include "geometry/MeshFileWriter.h"
+
+#include <sstream>
+#include <stdexcept>
+
+namespace pepr3d {
+
+namespace {
+const size_t STL_HEADER_SIZE = 80;
+const size_t STL_RECORD_SIZE = 50;
+
+/// 6 floats of a vertex and a face with a uchar count and 3 int indices
+const size_t PLY_VERTEX_SIZE = 6 * 4;
+const size_t PLY_FACE_SIZE = 1 + 3 * 4;
+
+bool isLittleEndianHost() {
+    const std::uint16_t one = 1;
+    std::uint8_t firstByte;
+    std::memcpy(&firstByte, &one, 1);
+    return firstByte == 1;
+}
+}  // namespace
+
+std::optional<MeshFileWriter::Format> MeshFileWriter::getFormat(const std::string& fileType) {
+    if(!isLittleEndianHost()) {
+        return {};
+    }
+    if(fileType == "stl") {
+        return Format::Stl;
+    }
+    if(fileType == "ply") {
+        return Format::Ply;
+    }
+    return {};
+}
+
+size_t MeshFileWriter::getFileSize(const Format format, const size_t triangleCount) {
+    if(format == Format::Stl) {
+        return STL_HEADER_SIZE + sizeof(std::uint32_t) + STL_RECORD_SIZE * triangleCount;
+    }
+    return getIndexedPlyFileSize(3 * triangleCount, triangleCount);
+}
+
+size_t MeshFileWriter::getIndexedPlyFileSize(const size_t vertexCount, const size_t triangleCount) {
+    return getPlyHeader(vertexCount, triangleCount).size() + PLY_VERTEX_SIZE * vertexCount +
+           PLY_FACE_SIZE * triangleCount;
+}
+
+void MeshFileWriter::Progress::addWrittenBytes(const size_t bytes) {
+    const size_t writtenBytes = mWrittenBytes += bytes;
+    if(mProgress != nullptr && mTotalBytes > 0) {
+        mProgress->exportFilePercentage = static_cast<float>(writtenBytes) / static_cast<float>(mTotalBytes);
+    }
+}
+
+MeshFileWriter::MeshFileWriter(const std::string& path, Progress* progress)
+    : mFile(path, std::ios::binary | std::ios::trunc), mBuffer(BUFFER_BYTES), mProgress(progress) {
+    if(!mFile) {
+        throw std::runtime_error("Could not open the file " + path +
+                                 " for writing. Make sure you have write permissions to the directory or files you are "
+                                 "exporting to.");
+    }
+}
+
+std::string MeshFileWriter::getPlyHeader(const size_t vertexCount, const size_t triangleCount) {
+    std::stringstream header;
+    header << "ply\nformat binary_little_endian 1.0\ncomment Created by Pepr3D\n";
+    header << "element vertex " << vertexCount << "\n";
+    header << "property float x\nproperty float y\nproperty float z\n";
+    header << "property float nx\nproperty float ny\nproperty float nz\n";
+    header << "element face " << triangleCount << "\n";
+    header << "property list uchar int vertex_index\nend_header\n";
+    return header.str();
+}
+
+void MeshFileWriter::writeHeader(const Format format, const size_t triangleCount) {
+    if(format == Format::Stl) {
+        const std::string header = "Binary STL exported by Pepr3D";
+        for(size_t i = 0; i < STL_HEADER_SIZE; ++i) {
+            append(i < header.size() ? header[i] : ' ');
+        }
+        append(static_cast<std::uint32_t>(triangleCount));
+    } else {
+        for(const char c : getPlyHeader(3 * triangleCount, triangleCount)) {
+            append(c);
+        }
+    }
+}
+
+void MeshFileWriter::writeFacet(const std::array<glm::vec3, 3>& positions) {
+    const glm::vec3 cross = glm::cross(positions[1] - positions[0], positions[2] - positions[0]);
+    const float length = glm::length(cross);
+    append(length > 0.f ? cross * (1.f / length) : glm::vec3(0.f));
+    for(const glm::vec3& position : positions) {
+        append(position);
+    }
+    append<std::uint16_t>(0);
+}
+
+void MeshFileWriter::flush() {
+    mFile.write(mBuffer.data(), static_cast<std::streamsize>(mUsedBytes));
+    if(mProgress != nullptr) {
+        mProgress->addWrittenBytes(mUsedBytes);
+    }
+    mUsedBytes = 0;
+}
+
+void MeshFileWriter::close() {
+    flush();
+    mFile.close();
+    if(!mFile) {
+        throw std::runtime_error(
+            "Could not write the exported files. Make sure there is enough space on the disk you are exporting to.");
+    }
+}
+
+}  // namespace pepr3d
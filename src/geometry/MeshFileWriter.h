@@ -0,0 +1,155 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "geometry/GeometryProgress.h"
+
+namespace pepr3d {
+
+/// Native export of binary STL and binary little endian PLY files, the counterpart of BinaryMeshImporter.
+/// The triangles are read from a callback and streamed to the file through a large buffer, so the exported mesh is
+/// never copied into an aiScene or into the memory blob of Assimp::Exporter. The files of write() match the ones of
+/// Assimp: STL facets get the normal of their corners, PLY files get 3 vertices with their normals for each triangle.
+/// PLY files of writeIndexedPly() share the vertices of the triangles.
+/// Each file has its own writer, the writers of one export may run in parallel and share their Progress.
+class MeshFileWriter {
+   public:
+    enum class Format { Stl, Ply };
+
+    /// Format of the file type of ExportAssistant, empty if the file is left to Assimp. The formats are written from
+    /// the memory of the host, so big endian hosts are left to Assimp as well.
+    static std::optional<Format> getFormat(const std::string& fileType);
+
+    /// Size in bytes of the file with the triangles
+    static size_t getFileSize(Format format, size_t triangleCount);
+
+    /// Size in bytes of the file of writeIndexedPly()
+    static size_t getIndexedPlyFileSize(size_t vertexCount, size_t triangleCount);
+
+    /// Bytes written by all writers of an export, reported to exportFilePercentage after each buffer
+    class Progress {
+       public:
+        Progress(size_t totalBytes, GeometryProgress* progress) : mTotalBytes(totalBytes), mProgress(progress) {}
+
+        void addWrittenBytes(size_t bytes);
+
+       private:
+        const size_t mTotalBytes;
+        GeometryProgress* const mProgress;
+        std::atomic<size_t> mWrittenBytes{0};
+    };
+
+    /// Write the triangles to the file, throws std::runtime_error if the file cannot be written.
+    /// getCorner(triangleIdx, cornerIdx, position, normal) sets the corner of a triangle in counter-clockwise order.
+    template <typename GetCorner>
+    static void write(const std::string& path, Format format, size_t triangleCount, const GetCorner& getCorner,
+                      Progress* progress) {
+        MeshFileWriter writer(path, progress);
+        writer.writeHeader(format, triangleCount);
+
+        std::array<glm::vec3, 3> positions;
+        std::array<glm::vec3, 3> normals;
+        for(size_t triIdx = 0; triIdx < triangleCount; ++triIdx) {
+            for(size_t k = 0; k < 3; ++k) {
+                getCorner(triIdx, k, positions[k], normals[k]);
+            }
+            if(format == Format::Stl) {
+                writer.writeFacet(positions);
+            } else {
+                for(size_t k = 0; k < 3; ++k) {
+                    writer.append(positions[k]);
+                    writer.append(normals[k]);
+                }
+            }
+        }
+
+        if(format == Format::Ply) {
+            // The vertices of the triangles are consecutive
+            for(size_t triIdx = 0; triIdx < triangleCount; ++triIdx) {
+                writer.append<std::uint8_t>(3);
+                for(size_t k = 0; k < 3; ++k) {
+                    writer.append(static_cast<std::int32_t>(3 * triIdx + k));
+                }
+            }
+        }
+
+        writer.close();
+    }
+
+    /// Write a PLY file with the vertices shared by the triangles, throws std::runtime_error if the file cannot be
+    /// written. getVertex(vertexIdx, position, normal) sets a vertex, getTriangle(triangleIdx) returns the indices of
+    /// the vertices of a triangle in counter-clockwise order.
+    template <typename GetVertex, typename GetTriangle>
+    static void writeIndexedPly(const std::string& path, size_t vertexCount, const GetVertex& getVertex,
+                                size_t triangleCount, const GetTriangle& getTriangle, Progress* progress) {
+        MeshFileWriter writer(path, progress);
+        for(const char c : getPlyHeader(vertexCount, triangleCount)) {
+            writer.append(c);
+        }
+
+        glm::vec3 position;
+        glm::vec3 normal;
+        for(size_t vertexIdx = 0; vertexIdx < vertexCount; ++vertexIdx) {
+            getVertex(vertexIdx, position, normal);
+            writer.append(position);
+            writer.append(normal);
+        }
+        for(size_t triIdx = 0; triIdx < triangleCount; ++triIdx) {
+            const auto vertices = getTriangle(triIdx);
+            writer.append<std::uint8_t>(3);
+            for(size_t k = 0; k < 3; ++k) {
+                writer.append(static_cast<std::int32_t>(vertices[k]));
+            }
+        }
+
+        writer.close();
+    }
+
+   private:
+    /// Size of the buffer written to the file at once
+    static constexpr size_t BUFFER_BYTES = 1 << 22;
+
+    MeshFileWriter(const std::string& path, Progress* progress);
+
+    static std::string getPlyHeader(size_t vertexCount, size_t triangleCount);
+
+    void writeHeader(Format format, size_t triangleCount);
+
+    /// STL facet with the normal of the corners, in the same way as Assimp
+    void writeFacet(const std::array<glm::vec3, 3>& positions);
+
+    template <typename T>
+    void append(const T& value) {
+        if(mUsedBytes + sizeof(T) > mBuffer.size()) {
+            flush();
+        }
+        std::memcpy(mBuffer.data() + mUsedBytes, &value, sizeof(T));
+        mUsedBytes += sizeof(T);
+    }
+
+    void append(const glm::vec3& value) {
+        append(value.x);
+        append(value.y);
+        append(value.z);
+    }
+
+    void flush();
+
+    /// Flush the buffer and close the file, throws if any of the writes failed
+    void close();
+
+    std::ofstream mFile;
+    std::vector<char> mBuffer;
+    size_t mUsedBytes = 0;
+    Progress* mProgress;
+};
+
+}  // namespace pepr3d
@@ -0,0 +1,118 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "geometry/BinaryMeshImporter.h"
+#include "geometry/MeshFileWriter.h"
+
+namespace {
+/// Tetrahedron with its triangles oriented outwards
+const std::array<glm::vec3, 4> TETRAHEDRON_CORNERS{glm::vec3(0, 0, 0), glm::vec3(1, 0, 0), glm::vec3(0, 1, 0),
+                                                   glm::vec3(0, 0, 1)};
+const std::array<std::array<size_t, 3>, 4> TETRAHEDRON_TRIANGLES{
+    {{0, 2, 1}, {0, 1, 3}, {0, 3, 2}, {1, 2, 3}}};
+
+void getTetrahedronCorner(const size_t triIdx, const size_t cornerIdx, glm::vec3& position, glm::vec3& normal) {
+    const auto& triangle = TETRAHEDRON_TRIANGLES[triIdx];
+    position = TETRAHEDRON_CORNERS[triangle[cornerIdx]];
+    normal = glm::normalize(glm::cross(TETRAHEDRON_CORNERS[triangle[1]] - TETRAHEDRON_CORNERS[triangle[0]],
+                                       TETRAHEDRON_CORNERS[triangle[2]] - TETRAHEDRON_CORNERS[triangle[0]]));
+}
+
+size_t getFileSize(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    return static_cast<size_t>(file.tellg());
+}
+}  // namespace
+
+TEST(MeshFileWriter, readBack) {
+    /**
+     * Test that the written STL and PLY files have the predicted size and import as the same welded mesh
+     */
+
+    ::ThreadPool threadPool(2);
+    for(const std::string fileType : {"stl", "ply"}) {
+        const auto format = pepr3d::MeshFileWriter::getFormat(fileType);
+        ASSERT_TRUE(format);
+        const std::string path = ::testing::TempDir() + "pepr3d_mesh_file_writer." + fileType;
+
+        pepr3d::GeometryProgress geometryProgress;
+        const size_t fileSize = pepr3d::MeshFileWriter::getFileSize(*format, TETRAHEDRON_TRIANGLES.size());
+        pepr3d::MeshFileWriter::Progress progress(fileSize, &geometryProgress);
+        pepr3d::MeshFileWriter::write(path, *format, TETRAHEDRON_TRIANGLES.size(), getTetrahedronCorner, &progress);
+        EXPECT_EQ(getFileSize(path), fileSize);
+        EXPECT_EQ(geometryProgress.exportFilePercentage, 1.f);
+
+        const auto mesh = pepr3d::BinaryMeshImporter::import(path, nullptr, threadPool);
+        std::remove(path.c_str());
+        ASSERT_TRUE(mesh);
+        ASSERT_EQ(mesh->vertexBuffer.size(), TETRAHEDRON_CORNERS.size());
+        ASSERT_EQ(mesh->indexBuffer.size(), TETRAHEDRON_TRIANGLES.size());
+        for(size_t triIdx = 0; triIdx < TETRAHEDRON_TRIANGLES.size(); ++triIdx) {
+            glm::vec3 normal;
+            for(size_t k = 0; k < 3; ++k) {
+                glm::vec3 position;
+                getTetrahedronCorner(triIdx, k, position, normal);
+                EXPECT_EQ(mesh->triangleVertices[3 * triIdx + k], position);
+            }
+            EXPECT_LT(glm::length(mesh->triangleNormals[triIdx] - normal), 1e-6f);
+        }
+    }
+
+    EXPECT_FALSE(pepr3d::MeshFileWriter::getFormat("obj"));
+}
+
+TEST(MeshFileWriter, indexedPly) {
+    /**
+     * Test that a PLY file with shared vertices has the predicted size and imports as the same mesh
+     */
+
+    ::ThreadPool threadPool(2);
+    const std::string path = ::testing::TempDir() + "pepr3d_mesh_file_writer_indexed.ply";
+    const auto getVertex = [](const size_t vertexIdx, glm::vec3& position, glm::vec3& normal) {
+        position = TETRAHEDRON_CORNERS[vertexIdx];
+        normal = glm::normalize(position - glm::vec3(0.25f));
+    };
+    const auto getTriangle = [](const size_t triIdx) { return TETRAHEDRON_TRIANGLES[triIdx]; };
+
+    const size_t fileSize =
+        pepr3d::MeshFileWriter::getIndexedPlyFileSize(TETRAHEDRON_CORNERS.size(), TETRAHEDRON_TRIANGLES.size());
+    EXPECT_LT(fileSize, pepr3d::MeshFileWriter::getFileSize(pepr3d::MeshFileWriter::Format::Ply,
+                                                             TETRAHEDRON_TRIANGLES.size()));
+    pepr3d::MeshFileWriter::writeIndexedPly(path, TETRAHEDRON_CORNERS.size(), getVertex,
+                                            TETRAHEDRON_TRIANGLES.size(), getTriangle, nullptr);
+    EXPECT_EQ(getFileSize(path), fileSize);
+
+    const auto mesh = pepr3d::BinaryMeshImporter::import(path, nullptr, threadPool);
+    std::remove(path.c_str());
+    ASSERT_TRUE(mesh);
+    ASSERT_EQ(mesh->vertexBuffer.size(), TETRAHEDRON_CORNERS.size());
+    ASSERT_EQ(mesh->indexBuffer.size(), TETRAHEDRON_TRIANGLES.size());
+    for(size_t triIdx = 0; triIdx < TETRAHEDRON_TRIANGLES.size(); ++triIdx) {
+        for(size_t k = 0; k < 3; ++k) {
+            EXPECT_EQ(mesh->triangleVertices[3 * triIdx + k],
+                      TETRAHEDRON_CORNERS[TETRAHEDRON_TRIANGLES[triIdx][k]]);
+        }
+    }
+}
+
+TEST(MeshFileWriter, unwritablePath) {
+    /**
+     * Test that a file that cannot be opened throws
+     */
+
+    const auto format = pepr3d::MeshFileWriter::getFormat("stl");
+    ASSERT_TRUE(format);
+    const std::string path = ::testing::TempDir() + "pepr3d_missing_directory/file.stl";
+    EXPECT_THROW(pepr3d::MeshFileWriter::write(path, *format, TETRAHEDRON_TRIANGLES.size(), getTetrahedronCorner,
+                                               nullptr),
+                 std::runtime_error);
+}
+
+#endif
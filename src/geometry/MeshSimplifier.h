@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <boost/functional/hash.hpp>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "peprassert.h"
+
+namespace pepr3d {
+
+/// Simplifies a mesh by vertex clustering, e.g., to draw a coarse proxy of a large mesh while the camera moves.
+/// The bounding box is divided into a uniform grid of cubic cells, the vertices of each cell join into their average
+/// position. Triangles with two corners in the same cell disappear, and so do duplicates of the same cells.
+/// Each remaining triangle remembers one of its source triangles, e.g., to take its color.
+class MeshSimplifier {
+   public:
+    struct Mesh {
+        std::vector<glm::vec3> vertices;
+        std::vector<std::array<size_t, 3>> indices;
+
+        /// Index of a source triangle of each of the triangles
+        std::vector<size_t> sourceTriangles;
+    };
+
+    /// Returns the mesh simplified to roughly targetTriangleCount triangles, the count depends on the shape.
+    /// The triangles are in the order of their source triangles, so the result does not depend on the threads.
+    static Mesh simplify(const std::vector<glm::vec3>& vertices, const std::vector<std::array<size_t, 3>>& indices,
+                         size_t targetTriangleCount, ::ThreadPool& threadPool) {
+        Mesh mesh;
+        if(vertices.empty() || indices.empty() || targetTriangleCount == 0) {
+            return mesh;
+        }
+
+        glm::vec3 boxMin = vertices.front();
+        glm::vec3 boxMax = vertices.front();
+        for(const glm::vec3& vertex : vertices) {
+            boxMin = glm::min(boxMin, vertex);
+            boxMax = glm::max(boxMax, vertex);
+        }
+
+        // A cell covers about the area of 2 target triangles, the vertices of a surface cluster in 1 cell each
+        double area = 0.0;
+        for(const auto& triangle : indices) {
+            const glm::vec3 cross = glm::cross(vertices[triangle[1]] - vertices[triangle[0]],
+                                               vertices[triangle[2]] - vertices[triangle[0]]);
+            area += 0.5 * static_cast<double>(glm::length(cross));
+        }
+        const glm::vec3 boxSize = boxMax - boxMin;
+        const float maxSize = std::max(std::max(boxSize.x, boxSize.y), boxSize.z);
+        const float cellSize = std::max(static_cast<float>(std::sqrt(2.0 * area / targetTriangleCount)),
+                                        maxSize / static_cast<float>(MAX_CELLS_PER_AXIS));
+        if(!(cellSize > 0.f)) {
+            return mesh;
+        }
+
+        // Items for parallel_for
+        std::vector<size_t> vertexIds(vertices.size());
+        std::iota(vertexIds.begin(), vertexIds.end(), 0);
+
+        std::vector<CellKey> cells(vertices.size());
+        threadPool.parallel_for(vertexIds.begin(), vertexIds.end(), [&](const size_t vertexIdx) {
+            const glm::vec3 cell = glm::floor((vertices[vertexIdx] - boxMin) / cellSize);
+            cells[vertexIdx] = getCellKey(cell);
+        });
+
+        // Vertices of a cell join into one, in the order of their first occurrence
+        std::unordered_map<CellKey, size_t> cellVertices;
+        std::vector<size_t> vertexClusters(vertices.size());
+        std::vector<size_t> clusterSizes;
+        for(size_t vertexIdx = 0; vertexIdx < vertices.size(); ++vertexIdx) {
+            const auto inserted = cellVertices.emplace(cells[vertexIdx], mesh.vertices.size());
+            if(inserted.second) {
+                mesh.vertices.emplace_back(0.f);
+                clusterSizes.push_back(0);
+            }
+            const size_t cluster = inserted.first->second;
+            vertexClusters[vertexIdx] = cluster;
+            mesh.vertices[cluster] += vertices[vertexIdx];
+            ++clusterSizes[cluster];
+        }
+        for(size_t cluster = 0; cluster < mesh.vertices.size(); ++cluster) {
+            mesh.vertices[cluster] *= 1.f / static_cast<float>(clusterSizes[cluster]);
+        }
+
+        // The first of the triangles between the same 3 clusters keeps its orientation
+        std::unordered_set<std::array<size_t, 3>, boost::hash<std::array<size_t, 3>>> clusterTriangles;
+        for(size_t triIdx = 0; triIdx < indices.size(); ++triIdx) {
+            const std::array<size_t, 3> triangle{vertexClusters[indices[triIdx][0]],
+                                                 vertexClusters[indices[triIdx][1]],
+                                                 vertexClusters[indices[triIdx][2]]};
+            if(triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0]) {
+                continue;
+            }
+            std::array<size_t, 3> sortedTriangle = triangle;
+            std::sort(sortedTriangle.begin(), sortedTriangle.end());
+            if(clusterTriangles.insert(sortedTriangle).second) {
+                mesh.indices.push_back(triangle);
+                mesh.sourceTriangles.push_back(triIdx);
+            }
+        }
+        P_ASSERT(mesh.indices.size() == mesh.sourceTriangles.size());
+        return mesh;
+    }
+
+   private:
+    using CellKey = std::uint64_t;
+
+    /// Cell coordinates are packed into 21 bits each
+    static const std::uint64_t MAX_CELLS_PER_AXIS = (1 << 21) - 1;
+
+    static CellKey getCellKey(const glm::vec3& cell) {
+        const auto coordinate = [](const float value) {
+            return std::min(static_cast<std::uint64_t>(std::max(value, 0.f)), MAX_CELLS_PER_AXIS - 1);
+        };
+        return (coordinate(cell.x) << 42) | (coordinate(cell.y) << 21) | coordinate(cell.z);
+    }
+};
+
+}  // namespace pepr3d
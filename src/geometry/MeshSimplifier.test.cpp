@@ -0,0 +1,85 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <array>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "geometry/MeshSimplifier.h"
+#include "geometry/TestGeometries.h"
+
+TEST(MeshSimplifier, simplifyGrid) {
+    /**
+     * Test that a fine grid is simplified to about the target count of valid triangles of the same orientation
+     */
+
+    ::ThreadPool threadPool(2);
+    std::vector<glm::vec3> vertices;
+    std::vector<std::array<size_t, 3>> indices;
+    pepr3d::test::createGrid(200, 1.f, vertices, indices);
+
+    const size_t targetTriangleCount = 2000;
+    const pepr3d::MeshSimplifier::Mesh mesh =
+        pepr3d::MeshSimplifier::simplify(vertices, indices, targetTriangleCount, threadPool);
+    ASSERT_EQ(mesh.indices.size(), mesh.sourceTriangles.size());
+    EXPECT_GT(mesh.indices.size(), targetTriangleCount / 4);
+    EXPECT_LT(mesh.indices.size(), 4 * targetTriangleCount);
+
+    for(const glm::vec3& vertex : mesh.vertices) {
+        EXPECT_GE(vertex.x, 0.f);
+        EXPECT_LE(vertex.x, 1.f);
+        EXPECT_GE(vertex.y, 0.f);
+        EXPECT_LE(vertex.y, 1.f);
+        EXPECT_EQ(vertex.z, 0.f);
+    }
+
+    for(size_t triIdx = 0; triIdx < mesh.indices.size(); ++triIdx) {
+        const auto& triangle = mesh.indices[triIdx];
+        for(const size_t vertex : triangle) {
+            ASSERT_LT(vertex, mesh.vertices.size());
+        }
+        const glm::vec3 cross = glm::cross(mesh.vertices[triangle[1]] - mesh.vertices[triangle[0]],
+                                           mesh.vertices[triangle[2]] - mesh.vertices[triangle[0]]);
+        EXPECT_GT(cross.z, 0.f);
+
+        ASSERT_LT(mesh.sourceTriangles[triIdx], indices.size());
+        if(triIdx > 0) {
+            EXPECT_LT(mesh.sourceTriangles[triIdx - 1], mesh.sourceTriangles[triIdx]);
+        }
+    }
+}
+
+TEST(MeshSimplifier, independentOfThreads) {
+    /**
+     * Test that the simplified mesh is the same with any number of threads
+     */
+
+    std::vector<glm::vec3> vertices;
+    std::vector<std::array<size_t, 3>> indices;
+    pepr3d::test::createGrid(150, 1.f, vertices, indices);
+
+    ::ThreadPool singleThread(0);
+    ::ThreadPool threadPool(3);
+    const auto expected = pepr3d::MeshSimplifier::simplify(vertices, indices, 500, singleThread);
+    const auto mesh = pepr3d::MeshSimplifier::simplify(vertices, indices, 500, threadPool);
+    EXPECT_EQ(mesh.vertices, expected.vertices);
+    EXPECT_EQ(mesh.indices, expected.indices);
+    EXPECT_EQ(mesh.sourceTriangles, expected.sourceTriangles);
+}
+
+TEST(MeshSimplifier, emptyMesh) {
+    /**
+     * Test that an empty or flat mesh simplifies to an empty mesh
+     */
+
+    ::ThreadPool threadPool(2);
+    const auto empty = pepr3d::MeshSimplifier::simplify({}, {}, 100, threadPool);
+    EXPECT_TRUE(empty.vertices.empty());
+    EXPECT_TRUE(empty.indices.empty());
+
+    const std::vector<glm::vec3> point(3, glm::vec3(1.f));
+    const auto degenerate = pepr3d::MeshSimplifier::simplify(point, {{0, 1, 2}}, 100, threadPool);
+    EXPECT_TRUE(degenerate.indices.empty());
+}
+
+#endif
@@ -3,20 +3,31 @@
 #include <assimp/scene.h>       // Output data structure
 #include <assimp/Exporter.hpp>  // C++ exporter interface
 
-#include <glm/gtc/epsilon.hpp>
+#include <CGAL/boost/graph/iterator.h>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
+#include <cstdint>
+#include <map>
+#include <numeric>
+#include <optional>
 #include <sstream>
+#include <unordered_map>
 #include <vector>
 
+#include "ThreadPool.h"
+
 #include "geometry/AssimpProgress.h"
 #include "geometry/ExportType.h"
 #include "geometry/Geometry.h"
 #include "geometry/GeometryProgress.h"
+#include "geometry/MeshFileWriter.h"
 #include "geometry/PolyhedronData.h"
 #include "geometry/Triangle.h"
 #include "geometry/TrianglePrimitive.h"
+#include "geometry/VertexWelder.h"
 
 typedef size_t colorIndex;
 
@@ -29,59 +40,153 @@ class ModelExporter {
     GeometryProgress *mProgress;
     std::vector<float> mExtrusionCoef;
 
-   public:
-    ModelExporter(const Geometry *geometry, GeometryProgress *progress) : mGeometry(geometry), mProgress(progress) {}
+    ::ThreadPool &mThreadPool;
 
-    /// Returns a map where each color index has a corresponding exported Assimp scene.
-    std::map<colorIndex, std::unique_ptr<aiScene>> createScenes(ExportType exportType) {
+    /// Cancellation of the running createScenes() or saveModel(), null if it cannot be cancelled
+    const std::atomic<bool> *mIsCancelled = nullptr;
+
+    bool isExportCancelled() const {
+        return mIsCancelled != nullptr && *mIsCancelled;
+    }
+
+    /// createScenes() checking mIsCancelled
+    std::map<colorIndex, std::unique_ptr<aiScene>> createScenesOfType(ExportType exportType) {
+        std::map<colorIndex, std::unique_ptr<aiScene>> scenes;
+        // The cancelled preparation may have left no detailed mesh
+        if(isExportCancelled()) {
+            return scenes;
+        }
         switch(exportType) {
-        case ExportType::Surface: return createPolySurfaceScenes(); break;
-        case ExportType::NonPolySurface: return createNonPolySurfaceScenes(); break;
-        case ExportType::NonPolyExtrusion: return createNonPolyScenes(); break;
-        case ExportType::PolyExtrusion: return createPolyScenes(false); break;
-        case ExportType::PolyExtrusionWithSDF: return createPolyScenes(true); break;
-        default: P_ASSERT(false); return createNonPolySurfaceScenes();
+        case ExportType::Surface: scenes = createPolySurfaceScenes(); break;
+        case ExportType::NonPolySurface: scenes = createNonPolySurfaceScenes(); break;
+        case ExportType::NonPolyExtrusion: scenes = createNonPolyScenes(); break;
+        case ExportType::PolyExtrusion: scenes = createPolyScenes(false); break;
+        case ExportType::PolyExtrusionWithSDF: scenes = createPolyScenes(true); break;
+        default: P_ASSERT(false); scenes = createNonPolySurfaceScenes();
+        }
+        if(isExportCancelled()) {
+            scenes.clear();
         }
+        return scenes;
+    }
+
+   public:
+    ModelExporter(const Geometry *geometry, GeometryProgress *progress, ::ThreadPool &threadPool)
+        : mGeometry(geometry), mProgress(progress), mThreadPool(threadPool) {}
+
+    /// Returns a map where each color index has a corresponding exported Assimp scene.
+    /// @param isCancelled Checked before the scene of each color, if not null. Returns no scenes once cancelled.
+    std::map<colorIndex, std::unique_ptr<aiScene>> createScenes(ExportType exportType,
+                                                                const std::atomic<bool> *isCancelled = nullptr) {
+        mIsCancelled = isCancelled;
+        std::map<colorIndex, std::unique_ptr<aiScene>> scenes = createScenesOfType(exportType);
+        mIsCancelled = nullptr;
+        return scenes;
     }
 
     /// Saves the exported Geometry to files, may throw an exception on error.
-    void saveModel(const std::string filePath, const std::string fileName, const std::string fileType,
-                   ExportType exportType) {
-        Assimp::Exporter exporter;
+    /// STL and PLY files are streamed by MeshFileWriter, surface exports straight from the Geometry without scenes.
+    /// Surfaces share their vertices in all formats with an index buffer, except for STL, which has only facets.
+    /// @param isCancelled Checked before each scene and file, if not null. The files written before the
+    /// cancellation are kept. Returns false if cancelled.
+    bool saveModel(const std::string filePath, const std::string fileName, const std::string fileType,
+                   ExportType exportType, const std::atomic<bool> *isCancelled = nullptr) {
+        return saveModel(filePath, fileName, std::vector<std::string>{fileType}, exportType, isCancelled);
+    }
 
+    /// Saves the exported Geometry to files of each of the file types, e.g., "stl" and "obj".
+    /// The scenes or the triangles of the colors are created once and shared by the files of all the file types,
+    /// which are written concurrently.
+    bool saveModel(const std::string filePath, const std::string fileName, const std::vector<std::string> &fileTypes,
+                   ExportType exportType, const std::atomic<bool> *isCancelled = nullptr) {
+        P_ASSERT(!fileTypes.empty());
         if(mProgress != nullptr) {
             mProgress->resetSave();
             mProgress->createScenePercentage = 0.0f;
         }
 
-        std::map<colorIndex, std::unique_ptr<aiScene>> scenes = createScenes(exportType);
-
-        if(mProgress != nullptr) {
-            mProgress->createScenePercentage = 1.0f;
-            mProgress->exportFilePercentage = 0.0f;
+        mIsCancelled = isCancelled;
+        if(isExportCancelled()) {
+            // The cancelled preparation may have left no detailed mesh
+            mIsCancelled = nullptr;
+            return false;
         }
 
-        std::string assimpFileType = fileType;
-        if(fileType == "stl" || fileType == "ply") {
-            assimpFileType += "b";  // binary
+        // The same file type twice would write the same files concurrently
+        std::vector<std::string> assimpFileTypes;
+        std::vector<std::pair<std::string, MeshFileWriter::Format>> writerFormats;
+        for(const std::string &fileType : fileTypes) {
+            const std::optional<MeshFileWriter::Format> format = MeshFileWriter::getFormat(fileType);
+            if(!format) {
+                if(std::find(assimpFileTypes.begin(), assimpFileTypes.end(), fileType) == assimpFileTypes.end()) {
+                    assimpFileTypes.push_back(fileType);
+                }
+            } else if(std::find_if(writerFormats.begin(), writerFormats.end(), [&fileType](const auto &writerFormat) {
+                          return writerFormat.first == fileType;
+                      }) == writerFormats.end()) {
+                writerFormats.emplace_back(fileType, *format);
+            }
         }
 
-        int sceneCounter = 0;
-        for(auto &scene : scenes) {
-            std::stringstream ss;
-            ss << filePath << "/" << fileName << "_" << sceneCounter << "." << fileType;
-            auto exportResult = exporter.Export(scene.second.get(), assimpFileType, ss.str());
-            if(exportResult != AI_SUCCESS) {
-                throw std::runtime_error(
-                    "Could not export the scenes to the specified files. Make sure the model is valid and you have "
-                    "write permissions to the directory or files you are exporting to.");
+        const bool isSurfaceExport = exportType == ExportType::NonPolySurface || exportType == ExportType::Surface;
+        if(!writerFormats.empty() && isSurfaceExport) {
+            writeSurfaceFiles(exportType, filePath, fileName, writerFormats);
+        }
+        if(!assimpFileTypes.empty() || (!writerFormats.empty() && !isSurfaceExport)) {
+            const std::map<colorIndex, std::unique_ptr<aiScene>> scenes = createScenesOfType(exportType);
+            if(!writerFormats.empty() && !isSurfaceExport) {
+                writeSceneFiles(scenes, filePath, fileName, writerFormats);
+            }
+            if(!assimpFileTypes.empty()) {
+                saveScenesWithAssimp(scenes, filePath, fileName, assimpFileTypes);
             }
-            sceneCounter++;
         }
+        const bool isSaved = !isExportCancelled();
+        mIsCancelled = nullptr;
 
-        if(mProgress != nullptr) {
+        if(mProgress != nullptr && isSaved) {
             mProgress->exportFilePercentage = 1.0f;
         }
+        return isSaved;
+    }
+
+    /// Returns the scene of a single color of an extrusion, e.g., after its extrusion coefficient changed.
+    /// Reuses the data shared by the colors, which the last createScenes() of the export type computed, so only the
+    /// walls and the bottom of the color are extruded again. Returns nullptr if there is no shared data of the export
+    /// type for the current version of the Geometry or the color has no triangles.
+    std::unique_ptr<aiScene> createColorScene(ExportType exportType, colorIndex color) {
+        if(exportType == ExportType::NonPolyExtrusion && mNonPolyExtrusionData) {
+            const NonPolyExtrusionData &data = *mNonPolyExtrusionData;
+            const auto triangleIndices = data.colorsWithIndices.find(color);
+            if(triangleIndices == data.colorsWithIndices.end()) {
+                return nullptr;
+            }
+            return createNewNonPolyScene(triangleIndices->second, data.cornerVertices, data.vertexNormals,
+                                         data.boundaryEdges.at(color), mExtrusionCoef[color]);
+        }
+
+        const bool withSDF = exportType == ExportType::PolyExtrusionWithSDF;
+        if((exportType == ExportType::PolyExtrusion || withSDF) && mPolyExtrusionData &&
+           mPolyExtrusionData->withSDF == withSDF) {
+            const PolyExtrusionData &data = *mPolyExtrusionData;
+            const auto triangleIndices = data.colorsWithIndices.find(color);
+            if(triangleIndices == data.colorsWithIndices.end()) {
+                return nullptr;
+            }
+            return createNewPolyScene(triangleIndices->second, mGeometry->getMeshDetailedVertexNormals(),
+                                      data.borderEdges.at(color), data.vertexSDF, mExtrusionCoef[color]);
+        }
+        return nullptr;
+    }
+
+    /// Drops the data shared by the colors of the extrusions if the Geometry changed since it was computed.
+    /// @param version Version number of the CommandManager of the Geometry
+    void setGeometryVersion(size_t version) {
+        if(mGeometryVersion != version) {
+            mNonPolyExtrusionData.reset();
+            mPolyExtrusionData.reset();
+            mGeometryVersion = version;
+        }
     }
 
     /// Sets extrusion coefficients between 0 and 1 indexed by the color index.
@@ -99,264 +204,686 @@ class ModelExporter {
         bool isBoundary = false;
     };
 
-    /// Creates surface only exported scenes without the need for a CGAL Polyhedron.
-    /// Returns a map where each color index has a corresponding exported Assimp scene.
-    std::map<colorIndex, std::unique_ptr<aiScene>> createNonPolySurfaceScenes() {
-        std::map<colorIndex, std::unique_ptr<aiScene>> scenes;
+    /// Surface of the triangles of one color with shared vertices, for the file formats with an index buffer.
+    /// A vertex gets the normalized sum of the normals of its triangles.
+    struct IndexedSurface {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> normals;
+        std::vector<std::array<unsigned int, 3>> triangles;
+    };
 
+    /// Data of createNonPolyScenes() shared by the colors, each color of colorsWithIndices has its boundaryEdges
+    struct NonPolyExtrusionData {
         std::map<colorIndex, std::vector<unsigned int>> colorsWithIndices;
+        std::vector<size_t> cornerVertices;
+        std::vector<glm::vec3> vertexNormals;
+        std::map<colorIndex, std::vector<IndexedEdge>> boundaryEdges;
+    };
 
-        for(unsigned int i = 0; i < mGeometry->getTriangleCount(); i++) {
-            colorIndex color = mGeometry->getTriangle(i).getColor();
-            colorsWithIndices[color].emplace_back(static_cast<unsigned int>(i));
+    /// Data of createPolyScenes() shared by the colors, each color of colorsWithIndices has its borderEdges.
+    /// The vertex normals are maintained by the Geometry, see Geometry::getMeshDetailedVertexNormals().
+    struct PolyExtrusionData {
+        bool withSDF;
+        std::map<colorIndex, std::vector<DetailedTriangleId>> colorsWithIndices;
+        std::map<colorIndex, std::vector<PolyhedronData::halfedge_descriptor>> borderEdges;
+
+        /// Average SDF value of the faces of each vertex by the vertex index, empty without SDF
+        std::vector<float> vertexSDF;
+    };
+
+    /// Shared data of the last extrusions, kept until the version of the Geometry changes
+    std::optional<NonPolyExtrusionData> mNonPolyExtrusionData;
+    std::optional<PolyExtrusionData> mPolyExtrusionData;
+    std::optional<size_t> mGeometryVersion;
+
+    /// Path of the exported file with the index fileIdx
+    static std::string getExportedFilePath(const std::string &filePath, const std::string &fileName,
+                                           const size_t fileIdx, const std::string &fileType) {
+        std::stringstream ss;
+        ss << filePath << "/" << fileName << "_" << fileIdx << "." << fileType;
+        return ss.str();
+    }
+
+    /// Exports the scenes to the files of each file type, each file on its own worker with its own Assimp::Exporter.
+    /// The exporters only read the scenes, they copy them before any post-processing.
+    void saveScenesWithAssimp(const std::map<colorIndex, std::unique_ptr<aiScene>> &scenes,
+                              const std::string &filePath, const std::string &fileName,
+                              const std::vector<std::string> &fileTypes) {
+        if(mProgress != nullptr) {
+            mProgress->createScenePercentage = 1.0f;
+            mProgress->exportFilePercentage = 0.0f;
         }
 
-        for(auto &indexOfColor : colorsWithIndices) {
-            scenes[indexOfColor.first] = std::move(createNewNonPolySurfaceScene(indexOfColor.second));
+        std::vector<const aiScene *> sceneList;
+        for(const auto &scene : scenes) {
+            sceneList.push_back(scene.second.get());
         }
 
-        return scenes;
+        // Items for parallel_for, each is a file type and a scene
+        std::vector<size_t> fileIds(fileTypes.size() * sceneList.size());
+        std::iota(fileIds.begin(), fileIds.end(), 0);
+
+        mThreadPool.parallel_for(
+            fileIds.begin(), fileIds.end(),
+            [&](const size_t fileId) {
+                if(isExportCancelled()) {
+                    return;
+                }
+                const std::string &fileType = fileTypes[fileId / sceneList.size()];
+                const size_t sceneIdx = fileId % sceneList.size();
+
+                std::string assimpFileType = fileType;
+                if(fileType == "stl" || fileType == "ply") {
+                    assimpFileType += "b";  // binary
+                }
+
+                Assimp::Exporter exporter;
+                const std::string path = getExportedFilePath(filePath, fileName, sceneIdx, fileType);
+                auto exportResult = exporter.Export(sceneList[sceneIdx], assimpFileType, path);
+                if(exportResult != AI_SUCCESS) {
+                    throw std::runtime_error(
+                        "Could not export the scenes to the specified files. Make sure the model is valid and you "
+                        "have write permissions to the directory or files you are exporting to.");
+                }
+            },
+            1);
     }
 
-    /// Creates surface only exported scenes with the need for a CGAL Polyhedron.
-    /// Returns a map where each color index has a corresponding exported Assimp scene.
-    std::map<colorIndex, std::unique_ptr<aiScene>> createPolySurfaceScenes() {
-        std::map<colorIndex, std::unique_ptr<aiScene>> scenes;
+    /// Base triangles of each color, in the order of the colors
+    std::vector<std::vector<unsigned int>> getTrianglesByColor() const {
+        std::map<colorIndex, std::vector<unsigned int>> colorsWithIndices;
+        for(unsigned int i = 0; i < mGeometry->getTriangleCount(); i++) {
+            colorsWithIndices[mGeometry->getTriangle(i).getColor()].emplace_back(i);
+        }
 
-        std::map<colorIndex, std::vector<DetailedTriangleId>> colorsWithIndices;
+        std::vector<std::vector<unsigned int>> trianglesByColor;
+        for(auto &indexOfColor : colorsWithIndices) {
+            trianglesByColor.push_back(std::move(indexOfColor.second));
+        }
+        return trianglesByColor;
+    }
 
+    /// Faces of the detailed mesh of each color, in the order of the colors
+    std::map<colorIndex, std::vector<PolyhedronData::face_descriptor>> getDetailedFacesByColor() const {
+        std::map<colorIndex, std::vector<PolyhedronData::face_descriptor>> colorsWithFaces;
         for(PolyhedronData::face_descriptor fd : mGeometry->getMeshDetailed()->faces()) {
-            colorIndex color = mGeometry->getTriangle(mGeometry->getMeshDetailedIdMap()[fd]).getColor();
-            colorsWithIndices[color].emplace_back(mGeometry->getMeshDetailedIdMap()[fd]);
+            const DetailedTriangleId triangleId = mGeometry->getMeshDetailedIdMap()[fd];
+            colorsWithFaces[mGeometry->getTriangle(triangleId).getColor()].emplace_back(fd);
         }
+        return colorsWithFaces;
+    }
 
-        for(auto &indexOfColor : colorsWithIndices) {
-            scenes[indexOfColor.first] = std::move(createNewPolySurfaceScene(indexOfColor.second));
+    /// Writes the surface of each color to its file of each format, STL triangles are read directly from the
+    /// Geometry, PLY files get the vertices shared by the triangles
+    void writeSurfaceFiles(ExportType exportType, const std::string &filePath, const std::string &fileName,
+                           const std::vector<std::pair<std::string, MeshFileWriter::Format>> &formats) {
+        std::vector<std::pair<std::string, MeshFileWriter::Format>> stlFormats;
+        std::vector<std::string> plyFileTypes;
+        for(const auto &format : formats) {
+            if(format.second == MeshFileWriter::Format::Stl) {
+                stlFormats.push_back(format);
+            } else {
+                plyFileTypes.push_back(format.first);
+            }
         }
 
-        return scenes;
+        if(exportType == ExportType::NonPolySurface) {
+            const std::vector<std::vector<unsigned int>> trianglesByColor = getTrianglesByColor();
+            if(!stlFormats.empty()) {
+                writeSurfaceFacetFiles(trianglesByColor, filePath, fileName, stlFormats);
+            }
+            if(!plyFileTypes.empty()) {
+                std::vector<IndexedSurface> surfaces(trianglesByColor.size());
+                withBaseVertices([&](const std::vector<glm::vec3> &positions,
+                                     const std::vector<std::array<size_t, 3>> &triangleVertices) {
+                    forEachInParallel(surfaces.size(), [&](const size_t fileIdx) {
+                        surfaces[fileIdx] = createBaseSurface(trianglesByColor[fileIdx], positions, triangleVertices);
+                    });
+                });
+                writeIndexedPlyFiles(surfaces, filePath, fileName, plyFileTypes);
+            }
+            return;
+        }
+
+        P_ASSERT(exportType == ExportType::Surface);
+        std::vector<std::vector<PolyhedronData::face_descriptor>> facesByColor;
+        for(auto &colorWithFaces : getDetailedFacesByColor()) {
+            facesByColor.push_back(std::move(colorWithFaces.second));
+        }
+        if(!stlFormats.empty()) {
+            std::vector<std::vector<DetailedTriangleId>> trianglesByColor;
+            for(const auto &faces : facesByColor) {
+                trianglesByColor.emplace_back();
+                for(const PolyhedronData::face_descriptor fd : faces) {
+                    trianglesByColor.back().push_back(mGeometry->getMeshDetailedIdMap()[fd]);
+                }
+            }
+            writeSurfaceFacetFiles(trianglesByColor, filePath, fileName, stlFormats);
+        }
+        if(!plyFileTypes.empty()) {
+            std::vector<IndexedSurface> surfaces(facesByColor.size());
+            forEachInParallel(surfaces.size(), [&](const size_t fileIdx) {
+                surfaces[fileIdx] = createDetailedSurface(facesByColor[fileIdx]);
+            });
+            writeIndexedPlyFiles(surfaces, filePath, fileName, plyFileTypes);
+        }
     }
 
-    /// Creates extruded scenes without the need for a CGAL Polyhedron.
-    /// Returns a map where each color index has a corresponding exported Assimp scene.
-    std::map<colorIndex, std::unique_ptr<aiScene>> createNonPolyScenes() {
-        std::map<colorIndex, std::unique_ptr<aiScene>> scenes;
+    /// Writes the triangles of each color to its file of each format, the triangles are read directly from the
+    /// Geometry
+    template <typename TriangleId>
+    void writeSurfaceFacetFiles(const std::vector<std::vector<TriangleId>> &trianglesByColor,
+                                const std::string &filePath, const std::string &fileName,
+                                const std::vector<std::pair<std::string, MeshFileWriter::Format>> &formats) {
+        std::vector<size_t> triangleCounts;
+        for(const auto &triangles : trianglesByColor) {
+            triangleCounts.push_back(triangles.size());
+        }
 
-        std::map<colorIndex, std::vector<unsigned int>> colorsWithIndices;
+        const auto getCorner = [&](const size_t fileIdx, const size_t triIdx, const size_t cornerIdx,
+                                   glm::vec3 &position, glm::vec3 &normal) {
+            const TriangleView triangle = mGeometry->getTriangle(trianglesByColor[fileIdx][triIdx]);
+            position = triangle.getVertex(cornerIdx);
+            normal = triangle.getNormal();
+        };
+        writeFilesInParallel(triangleCounts, filePath, fileName, formats, getCorner);
+    }
 
-        std::map<std::array<float, 3>, glm::vec3> summedVertexNormals;
+    /// Writes the surface of each color to its PLY file of each of the file types, all of them concurrently
+    void writeIndexedPlyFiles(const std::vector<IndexedSurface> &surfaces, const std::string &filePath,
+                              const std::string &fileName, const std::vector<std::string> &fileTypes) {
+        if(mProgress != nullptr) {
+            mProgress->createScenePercentage = 1.0f;
+            mProgress->exportFilePercentage = 0.0f;
+        }
 
-        // key=edge, value=(tri_idx, vert_idx, vert_idx)
-        std::map<std::array<std::array<float, 3>, 2>, IndexedEdge> edgeLookup;
+        size_t totalBytes = 0;
+        for(const IndexedSurface &surface : surfaces) {
+            totalBytes += fileTypes.size() *
+                          MeshFileWriter::getIndexedPlyFileSize(surface.positions.size(), surface.triangles.size());
+        }
+        MeshFileWriter::Progress progress(totalBytes, mProgress);
 
-        for(unsigned int i = 0; i < mGeometry->getTriangleCount(); i++) {
-            colorIndex color = mGeometry->getTriangle(i).getColor();
-            colorsWithIndices[color].emplace_back(static_cast<unsigned int>(i));
+        forEachInParallel(fileTypes.size() * surfaces.size(), [&](const size_t fileId) {
+            if(isExportCancelled()) {
+                return;
+            }
+            const size_t fileIdx = fileId % surfaces.size();
+            const IndexedSurface &surface = surfaces[fileIdx];
+            const auto getVertex = [&surface](const size_t vertexIdx, glm::vec3 &position, glm::vec3 &normal) {
+                position = surface.positions[vertexIdx];
+                normal = surface.normals[vertexIdx];
+            };
+            const auto getTriangle = [&surface](const size_t triIdx) { return surface.triangles[triIdx]; };
+            MeshFileWriter::writeIndexedPly(
+                getExportedFilePath(filePath, fileName, fileIdx, fileTypes[fileId / surfaces.size()]),
+                surface.positions.size(), getVertex, surface.triangles.size(), getTriangle, &progress);
+        });
+    }
 
-            for(unsigned int j = 0; j < 3; j++) {
-                std::array<float, 3> vertex = {mGeometry->getTriangle(i).getVertex(j).x,
-                                               mGeometry->getTriangle(i).getVertex(j).y,
-                                               mGeometry->getTriangle(i).getVertex(j).z};
+    /// Runs f(itemIdx) for each of the items, each on its own worker
+    template <typename F>
+    void forEachInParallel(const size_t itemCount, const F &f) {
+        // Items for parallel_for
+        std::vector<size_t> itemIds(itemCount);
+        std::iota(itemIds.begin(), itemIds.end(), 0);
+        mThreadPool.parallel_for(itemIds.begin(), itemIds.end(), f, 1);
+    }
 
-                summedVertexNormals[vertex] += mGeometry->getTriangle(i).getNormal();
+    /// Calls f(positions, triangleVertices) with the vertices shared by the base triangles and the vertices of each
+    /// triangle. These are the vertices of the polyhedron if it has all the triangles, otherwise the corners of the
+    /// triangles are welded.
+    template <typename F>
+    void withBaseVertices(const F &f) {
+        const size_t triangleCount = mGeometry->getTriangleCount();
+        if(mGeometry->getPolyIndices().size() == triangleCount) {
+            f(mGeometry->getPolyVertices(), mGeometry->getPolyIndices());
+            return;
+        }
 
-                std::array<float, 3> nextVertex = {mGeometry->getTriangle(i).getVertex((j + 1) % 3).x,
-                                                   mGeometry->getTriangle(i).getVertex((j + 1) % 3).y,
-                                                   mGeometry->getTriangle(i).getVertex((j + 1) % 3).z};
+        // Items for parallel_for
+        std::vector<size_t> triangleIds(triangleCount);
+        std::iota(triangleIds.begin(), triangleIds.end(), 0);
 
-                IndexedEdge &edge = edgeLookup[{vertex, nextVertex}];
-                edge.color = mGeometry->getTriangle(i).getColor();
-                edge.tri = i;
-                edge.id1 = j;
-                edge.id2 = (j + 1) % 3;
+        std::vector<glm::vec3> corners(3 * triangleCount);
+        mThreadPool.parallel_for(triangleIds.begin(), triangleIds.end(), [&](const size_t triIdx) {
+            const TriangleView triangle = mGeometry->getTriangle(triIdx);
+            for(unsigned int j = 0; j < 3; j++) {
+                corners[3 * triIdx + j] = triangle.getVertex(j);
+            }
+        });
+        const VertexWelder welder(corners, mThreadPool);
+        std::vector<std::array<size_t, 3>> triangleVertices(triangleCount);
+        for(size_t triIdx = 0; triIdx < triangleCount; ++triIdx) {
+            for(size_t j = 0; j < 3; j++) {
+                triangleVertices[triIdx][j] = welder.getIndices()[3 * triIdx + j];
             }
         }
+        f(welder.getVertices(), triangleVertices);
+    }
 
-        normalizeSummedNormals(summedVertexNormals);
-
-        computeBoundaryEdges(edgeLookup);
+    /// Shares the vertices of the triangles, keeping only the vertices used by them.
+    /// getTriangleVertices(triIdx) returns the vertices of a triangle in a larger mesh, getPosition(vertexIdx) the
+    /// position of a vertex of the larger mesh and getNormal(triIdx) the normal of a triangle.
+    template <typename GetTriangleVertices, typename GetPosition, typename GetNormal>
+    static IndexedSurface createIndexedSurface(const size_t triangleCount,
+                                               const GetTriangleVertices &getTriangleVertices,
+                                               const GetPosition &getPosition, const GetNormal &getNormal) {
+        std::vector<size_t> cornerVertices(3 * triangleCount);
+        for(size_t triIdx = 0; triIdx < triangleCount; ++triIdx) {
+            const std::array<size_t, 3> vertices = getTriangleVertices(triIdx);
+            std::copy(vertices.begin(), vertices.end(), cornerVertices.begin() + 3 * triIdx);
+        }
 
-        for(auto &indexOfColor : colorsWithIndices) {
-            auto soloBoundary = selectBoundaryEdgesByColor(edgeLookup, indexOfColor.first);
+        // The vertices keep their order in the larger mesh, so that the file stays close to it
+        std::vector<size_t> usedVertices = cornerVertices;
+        std::sort(usedVertices.begin(), usedVertices.end());
+        usedVertices.erase(std::unique(usedVertices.begin(), usedVertices.end()), usedVertices.end());
 
-            scenes[indexOfColor.first] = std::move(createNewNonPolyScene(
-                indexOfColor.second, summedVertexNormals, soloBoundary, mExtrusionCoef[indexOfColor.first]));
+        IndexedSurface surface;
+        surface.positions.reserve(usedVertices.size());
+        for(const size_t vertex : usedVertices) {
+            surface.positions.push_back(getPosition(vertex));
         }
-
-        return scenes;
+        surface.normals.assign(usedVertices.size(), glm::vec3(0.0f));
+        surface.triangles.resize(triangleCount);
+        for(size_t triIdx = 0; triIdx < triangleCount; ++triIdx) {
+            const glm::vec3 normal = getNormal(triIdx);
+            for(size_t j = 0; j < 3; j++) {
+                const auto vertexIdx = static_cast<unsigned int>(
+                    std::lower_bound(usedVertices.begin(), usedVertices.end(), cornerVertices[3 * triIdx + j]) -
+                    usedVertices.begin());
+                surface.triangles[triIdx][j] = vertexIdx;
+                surface.normals[vertexIdx] += normal;
+            }
+        }
+        for(glm::vec3 &normal : surface.normals) {
+            const float length = glm::length(normal);
+            normal = length > 0.0f ? normal / length : glm::vec3(0.0f);
+        }
+        return surface;
     }
 
-    /// Normalize summed vertex normals
-    void normalizeSummedNormals(std::map<std::array<float, 3>, glm::vec3> &summedVertexNormals) {
-        for(auto &vertexNormal : summedVertexNormals) {
-            vertexNormal.second = glm::normalize(vertexNormal.second);
-        }
+    /// Surface of the base triangles with their vertices, see withBaseVertices()
+    IndexedSurface createBaseSurface(const std::vector<unsigned int> &triangleIndices,
+                                     const std::vector<glm::vec3> &positions,
+                                     const std::vector<std::array<size_t, 3>> &triangleVertices) const {
+        return createIndexedSurface(
+            triangleIndices.size(), [&](const size_t i) { return triangleVertices[triangleIndices[i]]; },
+            [&](const size_t vertex) { return positions[vertex]; },
+            [&](const size_t i) { return mGeometry->getTriangle(triangleIndices[i]).getNormal(); });
     }
 
-    /// Decide if the edge is between two colors
-    void computeBoundaryEdges(std::map<std::array<std::array<float, 3>, 2>, IndexedEdge> &edgeLookup) {
-        for(auto &edge : edgeLookup) {
-            if(edgeLookup.count({edge.first[1], edge.first[0]})) {
-                if(!edge.second.isBoundary && edgeLookup[{edge.first[1], edge.first[0]}].color != edge.second.color) {
-                    edgeLookup[{edge.first[1], edge.first[0]}].isBoundary = true;
-                    edge.second.isBoundary = true;
-                }
+    /// Surface of the faces of the detailed mesh, which share the vertices of the mesh
+    IndexedSurface createDetailedSurface(const std::vector<PolyhedronData::face_descriptor> &faces) const {
+        const PolyhedronData::Mesh &mesh = *mGeometry->getMeshDetailed();
+        const std::vector<glm::vec3> &positions = mGeometry->getMeshDetailedVertexPositions();
+        const auto getTriangleVertices = [&](const size_t i) {
+            std::array<size_t, 3> vertices{};
+            size_t j = 0;
+            for(const PolyhedronData::vertex_descriptor vd :
+                CGAL::vertices_around_face(mesh.halfedge(faces[i]), mesh)) {
+                P_ASSERT(j < 3);
+                vertices[j++] = static_cast<size_t>(vd);
             }
+            return vertices;
+        };
+        const auto getNormal = [&](const size_t i) {
+            return mGeometry->getTriangle(mGeometry->getMeshDetailedIdMap()[faces[i]]).getNormal();
+        };
+        return createIndexedSurface(faces.size(), getTriangleVertices,
+                                    [&](const size_t vertex) { return positions[vertex]; }, getNormal);
+    }
+
+    /// Writes the single mesh of each scene to its file of each format
+    void writeSceneFiles(const std::map<colorIndex, std::unique_ptr<aiScene>> &scenes, const std::string &filePath,
+                         const std::string &fileName,
+                         const std::vector<std::pair<std::string, MeshFileWriter::Format>> &formats) {
+        std::vector<const aiMesh *> meshes;
+        std::vector<size_t> triangleCounts;
+        for(const auto &scene : scenes) {
+            P_ASSERT(scene.second->mNumMeshes == 1);
+            meshes.push_back(scene.second->mMeshes[0]);
+            triangleCounts.push_back(meshes.back()->mNumFaces);
         }
+
+        const auto getCorner = [&](const size_t fileIdx, const size_t triIdx, const size_t cornerIdx,
+                                   glm::vec3 &position, glm::vec3 &normal) {
+            const aiMesh *const mesh = meshes[fileIdx];
+            const aiFace &face = mesh->mFaces[triIdx];
+            P_ASSERT(face.mNumIndices == 3);
+            const aiVector3D &vertex = mesh->mVertices[face.mIndices[cornerIdx]];
+            const aiVector3D &vertexNormal = mesh->mNormals[face.mIndices[cornerIdx]];
+            position = glm::vec3(vertex.x, vertex.y, vertex.z);
+            normal = glm::vec3(vertexNormal.x, vertexNormal.y, vertexNormal.z);
+        };
+        writeFilesInParallel(triangleCounts, filePath, fileName, formats, getCorner);
     }
 
-    /// Returns a vector of IndexedEdge that were boundary and with the specified color.
-    std::vector<IndexedEdge> selectBoundaryEdgesByColor(
-        std::map<std::array<std::array<float, 3>, 2>, IndexedEdge> &edgeLookup, colorIndex color) {
-        std::vector<IndexedEdge> soloBoundary;
-        for(auto &edge : edgeLookup) {
-            if(edge.second.color == color && edge.second.isBoundary) {
-                soloBoundary.emplace_back(edge.second);
+    /// Writes the files of all colors and formats concurrently, each of them on its own worker.
+    /// getCorner(fileIdx, triangleIdx, cornerIdx, position, normal) is the corner of a triangle of a file.
+    template <typename GetCorner>
+    void writeFilesInParallel(const std::vector<size_t> &triangleCounts, const std::string &filePath,
+                              const std::string &fileName,
+                              const std::vector<std::pair<std::string, MeshFileWriter::Format>> &formats,
+                              const GetCorner &getCorner) {
+        if(mProgress != nullptr) {
+            mProgress->createScenePercentage = 1.0f;
+            mProgress->exportFilePercentage = 0.0f;
+        }
+
+        size_t totalBytes = 0;
+        for(const auto &format : formats) {
+            for(const size_t triangleCount : triangleCounts) {
+                totalBytes += MeshFileWriter::getFileSize(format.second, triangleCount);
             }
         }
-        return soloBoundary;
+        MeshFileWriter::Progress progress(totalBytes, mProgress);
+
+        // Items for parallel_for, each is a format and a file
+        std::vector<size_t> fileIds(formats.size() * triangleCounts.size());
+        std::iota(fileIds.begin(), fileIds.end(), 0);
+
+        mThreadPool.parallel_for(
+            fileIds.begin(), fileIds.end(),
+            [&](const size_t fileId) {
+                if(isExportCancelled()) {
+                    return;
+                }
+                const auto &format = formats[fileId / triangleCounts.size()];
+                const size_t fileIdx = fileId % triangleCounts.size();
+                const auto getFileCorner = [&getCorner, fileIdx](const size_t triIdx, const size_t cornerIdx,
+                                                                 glm::vec3 &position, glm::vec3 &normal) {
+                    getCorner(fileIdx, triIdx, cornerIdx, position, normal);
+                };
+                MeshFileWriter::write(getExportedFilePath(filePath, fileName, fileIdx, format.first), format.second,
+                                      triangleCounts[fileIdx], getFileCorner, &progress);
+            },
+            1);
     }
 
-    /// Creates extruded scenes with the need for a CGAL Polyhedron.
-    /// Optionally extrudes relative to SDF values.
+    /// Creates surface only exported scenes without the need for a CGAL Polyhedron.
     /// Returns a map where each color index has a corresponding exported Assimp scene.
-    std::map<colorIndex, std::unique_ptr<aiScene>> createPolyScenes(bool withSDF) {
-        std::map<colorIndex, std::unique_ptr<aiScene>> scenes;
-
-        std::map<colorIndex, std::vector<DetailedTriangleId>> colorsWithIndices;
+    std::map<colorIndex, std::unique_ptr<aiScene>> createNonPolySurfaceScenes() {
+        std::map<colorIndex, std::vector<unsigned int>> colorsWithIndices;
 
-        std::unordered_map<PolyhedronData::vertex_descriptor, glm::vec3> summedVertexNormals;
-        std::map<PolyhedronData::vertex_descriptor, float> vertexSDF;
+        for(unsigned int i = 0; i < mGeometry->getTriangleCount(); i++) {
+            colorIndex color = mGeometry->getTriangle(i).getColor();
+            colorsWithIndices[color].emplace_back(static_cast<unsigned int>(i));
+        }
 
-        std::map<colorIndex, std::set<PolyhedronData::halfedge_descriptor>> borderEdges;
+        std::map<colorIndex, std::unique_ptr<aiScene>> scenes;
+        withBaseVertices([&](const std::vector<glm::vec3> &positions,
+                             const std::vector<std::array<size_t, 3>> &triangleVertices) {
+            scenes = createScenesInParallel(
+                colorsWithIndices, [&](const colorIndex, const std::vector<unsigned int> &triangleIndices) {
+                    return createNewNonPolySurfaceScene(triangleIndices, positions, triangleVertices);
+                });
+        });
+        return scenes;
+    }
 
-        for(PolyhedronData::face_descriptor fd : mGeometry->getMeshDetailed()->faces()) {
-            colorIndex color = mGeometry->getTriangle(mGeometry->getMeshDetailedIdMap()[fd]).getColor();
-            colorsWithIndices[color].emplace_back(mGeometry->getMeshDetailedIdMap()[fd]);
+    /// Creates the scene of each color on its own worker, the colors are independent of each other.
+    /// createScene(color, triangleIndices) must only read the shared data.
+    template <typename CreateScene>
+    std::map<colorIndex, std::unique_ptr<aiScene>> createScenesInParallel(
+        const std::map<colorIndex, std::vector<unsigned int>> &colorsWithIndices, const CreateScene &createScene) {
+        std::vector<std::map<colorIndex, std::vector<unsigned int>>::const_iterator> colors;
+        for(auto it = colorsWithIndices.begin(); it != colorsWithIndices.end(); ++it) {
+            colors.push_back(it);
         }
 
-        for(PolyhedronData::vertex_descriptor vd : mGeometry->getMeshDetailed()->vertices()) {
-            int degree = mGeometry->getMeshDetailed()->degree(vd);
-            std::vector<glm::vec3> vertexNormals;
+        // Items for parallel_for
+        std::vector<size_t> colorIds(colors.size());
+        std::iota(colorIds.begin(), colorIds.end(), 0);
 
-            auto halfedge = mGeometry->getMeshDetailed()->halfedge(vd);
+        std::vector<std::unique_ptr<aiScene>> colorScenes(colors.size());
+        mThreadPool.parallel_for(
+            colorIds.begin(), colorIds.end(),
+            [&](const size_t colorIdx) {
+                if(!isExportCancelled()) {
+                    colorScenes[colorIdx] = createScene(colors[colorIdx]->first, colors[colorIdx]->second);
+                }
+            },
+            1);
 
-            for(size_t i = 0; i < degree; i++) {
-                auto face = mGeometry->getMeshDetailed()->face(halfedge);
+        std::map<colorIndex, std::unique_ptr<aiScene>> scenes;
+        for(size_t colorIdx = 0; colorIdx < colors.size(); ++colorIdx) {
+            scenes[colors[colorIdx]->first] = std::move(colorScenes[colorIdx]);
+        }
+        return scenes;
+    }
 
-                if(face.is_valid()) {
-                    DetailedTriangleId triIndex = mGeometry->getMeshDetailedIdMap()[face];
+    /// Creates surface only exported scenes with the need for a CGAL Polyhedron.
+    /// Returns a map where each color index has a corresponding exported Assimp scene.
+    std::map<colorIndex, std::unique_ptr<aiScene>> createPolySurfaceScenes() {
+        std::map<colorIndex, std::unique_ptr<aiScene>> scenes;
 
-                    if(withSDF) {
-                        vertexSDF[vd] += (float)mGeometry->getSdfValue(triIndex.getBaseId());
-                    }
+        for(auto &colorWithFaces : getDetailedFacesByColor()) {
+            if(isExportCancelled()) {
+                break;
+            }
+            scenes[colorWithFaces.first] = createNewPolySurfaceScene(colorWithFaces.second);
+        }
 
-                    vertexNormals.push_back(mGeometry->getTriangle(triIndex).getNormal());
+        return scenes;
+    }
 
-                    colorIndex faceColor = mGeometry->getTriangle(triIndex).getColor();
+    /// Creates extruded scenes without the need for a CGAL Polyhedron.
+    /// Returns a map where each color index has a corresponding exported Assimp scene.
+    std::map<colorIndex, std::unique_ptr<aiScene>> createNonPolyScenes() {
+        if(!mNonPolyExtrusionData) {
+            mNonPolyExtrusionData = computeNonPolyExtrusionData();
+        }
+        const NonPolyExtrusionData &data = *mNonPolyExtrusionData;
 
-                    auto oppositeHalfedge = mGeometry->getMeshDetailed()->opposite(halfedge);
-                    auto oppositeFace = mGeometry->getMeshDetailed()->face(oppositeHalfedge);
+        return createScenesInParallel(
+            data.colorsWithIndices, [&](const colorIndex color, const std::vector<unsigned int> &triangleIndices) {
+                return createNewNonPolyScene(triangleIndices, data.cornerVertices, data.vertexNormals,
+                                             data.boundaryEdges.at(color), mExtrusionCoef[color]);
+            });
+    }
 
-                    if(oppositeFace.is_valid()) {
-                        DetailedTriangleId oppositeFaceIdx = mGeometry->getMeshDetailedIdMap()[oppositeFace];
-                        colorIndex oppositeFaceColor = mGeometry->getTriangle(oppositeFaceIdx).getColor();
-                        if(faceColor != oppositeFaceColor) {
-                            borderEdges[faceColor].insert(halfedge);
-                        }
-                    } else {
-                        // halfedge is border edge (hole in the model), so it is alsou boundary edge
-                        borderEdges[faceColor].insert(halfedge);
-                    }
-                }
+    /// Computes the colors, vertex normals and boundary edges of createNonPolyScenes()
+    NonPolyExtrusionData computeNonPolyExtrusionData() {
+        const size_t triangleCount = mGeometry->getTriangleCount();
 
-                halfedge = mGeometry->getMeshDetailed()->next_around_target(halfedge);
-            }
+        NonPolyExtrusionData data;
 
-            float ep = glm::epsilon<float>();
+        for(unsigned int i = 0; i < triangleCount; i++) {
+            data.colorsWithIndices[mGeometry->getTriangle(i).getColor()].emplace_back(i);
+        }
 
-            bool isEpsSameNormal = false;
-            for(size_t i = 0; i < vertexNormals.size(); i++) {
-                for(size_t j = 0; j < i; j++) {
-                    isEpsSameNormal |= glm::all(glm::epsilonEqual(vertexNormals[i], vertexNormals[j], ep));
-                }
-                if(!isEpsSameNormal) {
-                    summedVertexNormals[vd] += vertexNormals[i];
-                }
-                isEpsSameNormal = false;
+        // Items for parallel_for
+        std::vector<size_t> triangleIds(triangleCount);
+        std::iota(triangleIds.begin(), triangleIds.end(), 0);
+
+        std::vector<glm::vec3> corners(3 * triangleCount);
+        mThreadPool.parallel_for(triangleIds.begin(), triangleIds.end(), [&](const size_t triIdx) {
+            const TriangleView triangle = mGeometry->getTriangle(triIdx);
+            for(unsigned int j = 0; j < 3; j++) {
+                corners[3 * triIdx + j] = triangle.getVertex(j);
             }
+        });
 
-            summedVertexNormals[vd] = glm::normalize(summedVertexNormals[vd]);
+        // Corners at identical positions share a vertex, the lookups below are indexed by the vertices
+        const VertexWelder welder(corners, mThreadPool);
+        data.cornerVertices = welder.getIndices();
+        data.vertexNormals = computeVertexNormals(data.cornerVertices, welder.getVertices().size());
 
-            if(withSDF) {
-                vertexSDF[vd] = vertexSDF[vd] / degree;  // average
-            }
+        data.boundaryEdges = computeBoundaryEdges(data.cornerVertices, welder.getVertices().size());
+        // Every color gets its edges before the map is shared by the workers
+        for(const auto &indexOfColor : data.colorsWithIndices) {
+            data.boundaryEdges[indexOfColor.first];
         }
+        return data;
+    }
 
-        for(auto &indexOfColor : colorsWithIndices) {
-            scenes[indexOfColor.first] =
-                std::move(createNewPolyScene(indexOfColor.second, summedVertexNormals, borderEdges[indexOfColor.first],
-                                             vertexSDF, mExtrusionCoef[indexOfColor.first]));
+    /// Returns the normalized sum of the normals of the triangles around each vertex.
+    /// The corners are grouped by their vertex first, so that the vertices are summed in parallel, each in the order
+    /// of its corners.
+    /// @param cornerVertices Vertex of each corner of the triangles, 3 per triangle, out of vertexCount vertices
+    std::vector<glm::vec3> computeVertexNormals(const std::vector<size_t> &cornerVertices, const size_t vertexCount) {
+        std::vector<size_t> vertexCornerStarts(vertexCount + 1, 0);
+        for(const size_t vertex : cornerVertices) {
+            ++vertexCornerStarts[vertex + 1];
         }
+        std::partial_sum(vertexCornerStarts.begin(), vertexCornerStarts.end(), vertexCornerStarts.begin());
 
-        return scenes;
-    }
+        std::vector<size_t> vertexCorners(cornerVertices.size());
+        std::vector<size_t> nextCorner(vertexCornerStarts.begin(), vertexCornerStarts.end() - 1);
+        for(size_t cornerIdx = 0; cornerIdx < cornerVertices.size(); ++cornerIdx) {
+            vertexCorners[nextCorner[cornerVertices[cornerIdx]]++] = cornerIdx;
+        }
 
-    std::unique_ptr<aiScene> createNewNonPolySurfaceScene(std::vector<unsigned int> &triangleIndices) {
-        std::unique_ptr<aiScene> scene = std::make_unique<aiScene>();
+        // Items for parallel_for
+        std::vector<size_t> vertexIds(vertexCount);
+        std::iota(vertexIds.begin(), vertexIds.end(), 0);
 
-        scene->mRootNode = new aiNode();
-
-        scene->mMaterials = new aiMaterial *[1];
-        scene->mMaterials[0] = nullptr;
-        scene->mNumMaterials = 1;
+        std::vector<glm::vec3> vertexNormals(vertexCount);
+        mThreadPool.parallel_for(vertexIds.begin(), vertexIds.end(), [&](const size_t vertexIdx) {
+            glm::vec3 normal(0.0f);
+            for(size_t i = vertexCornerStarts[vertexIdx]; i < vertexCornerStarts[vertexIdx + 1]; ++i) {
+                normal += mGeometry->getTriangle(vertexCorners[i] / 3).getNormal();
+            }
+            vertexNormals[vertexIdx] = glm::normalize(normal);
+        });
+        return vertexNormals;
+    }
 
-        scene->mMaterials[0] = new aiMaterial();
+    /// Returns the edges between two colors in each color. Edges are directed from the vertex id1 to id2 of their
+    /// triangle, an edge is between two colors if its opposite edge has another color.
+    /// @param cornerVertices Vertex of each corner of the triangles, 3 per triangle, out of vertexCount vertices
+    std::map<colorIndex, std::vector<IndexedEdge>> computeBoundaryEdges(const std::vector<size_t> &cornerVertices,
+                                                                        const size_t vertexCount) {
+        const auto getEdgeKey = [vertexCount](const size_t from, const size_t to) {
+            return static_cast<std::uint64_t>(from) * vertexCount + to;
+        };
+
+        // key=directed edge, value=index of the edge, the last triangle with the edge keeps it
+        std::unordered_map<std::uint64_t, size_t> edgeLookup;
+        edgeLookup.reserve(cornerVertices.size());
+        std::vector<IndexedEdge> edges;
+        edges.reserve(cornerVertices.size());
+        std::vector<std::uint64_t> oppositeKeys;
+        oppositeKeys.reserve(cornerVertices.size());
+
+        for(unsigned int i = 0; i < cornerVertices.size() / 3; i++) {
+            const colorIndex color = mGeometry->getTriangle(i).getColor();
+            for(unsigned int j = 0; j < 3; j++) {
+                const size_t vertex = cornerVertices[3 * i + j];
+                const size_t nextVertex = cornerVertices[3 * i + (j + 1) % 3];
 
-        scene->mMeshes = new aiMesh *[1];
-        scene->mMeshes[0] = nullptr;
-        scene->mNumMeshes = 1;
+                IndexedEdge edge;
+                edge.color = color;
+                edge.tri = i;
+                edge.id1 = j;
+                edge.id2 = (j + 1) % 3;
 
-        scene->mMeshes[0] = new aiMesh();
-        scene->mMeshes[0]->mMaterialIndex = 0;
+                const auto result = edgeLookup.emplace(getEdgeKey(vertex, nextVertex), edges.size());
+                if(result.second) {
+                    edges.push_back(edge);
+                    oppositeKeys.push_back(getEdgeKey(nextVertex, vertex));
+                } else {
+                    edges[result.first->second] = edge;
+                }
+            }
+        }
 
-        scene->mRootNode->mMeshes = new unsigned int[1];
-        scene->mRootNode->mMeshes[0] = 0;
-        scene->mRootNode->mNumMeshes = 1;
+        // Decide if the edge is between two colors, each edge only reads the lookup and writes itself
+        std::vector<size_t> edgeIds(edges.size());
+        std::iota(edgeIds.begin(), edgeIds.end(), 0);
+        mThreadPool.parallel_for(edgeIds.begin(), edgeIds.end(), [&](const size_t edgeIdx) {
+            const auto opposite = edgeLookup.find(oppositeKeys[edgeIdx]);
+            if(opposite != edgeLookup.end() && edges[opposite->second].color != edges[edgeIdx].color) {
+                edges[edgeIdx].isBoundary = true;
+            }
+        });
 
-        auto pMesh = scene->mMeshes[0];
+        std::map<colorIndex, std::vector<IndexedEdge>> boundaryEdges;
+        for(const IndexedEdge &edge : edges) {
+            if(edge.isBoundary) {
+                boundaryEdges[edge.color].push_back(edge);
+            }
+        }
+        return boundaryEdges;
+    }
 
-        size_t trianglesCount = triangleIndices.size();
+    /// Creates extruded scenes with the need for a CGAL Polyhedron.
+    /// Optionally extrudes relative to SDF values.
+    /// Returns a map where each color index has a corresponding exported Assimp scene.
+    std::map<colorIndex, std::unique_ptr<aiScene>> createPolyScenes(bool withSDF) {
+        if(!mPolyExtrusionData || mPolyExtrusionData->withSDF != withSDF) {
+            mPolyExtrusionData = computePolyExtrusionData(withSDF);
+        }
+        const PolyExtrusionData &data = *mPolyExtrusionData;
 
-        pMesh->mVertices = new aiVector3D[3 * trianglesCount];
-        pMesh->mNormals = new aiVector3D[3 * trianglesCount];
+        std::map<colorIndex, std::unique_ptr<aiScene>> scenes;
+        for(auto &indexOfColor : data.colorsWithIndices) {
+            scenes[indexOfColor.first] =
+                createNewPolyScene(indexOfColor.second, mGeometry->getMeshDetailedVertexNormals(),
+                                   data.borderEdges.at(indexOfColor.first), data.vertexSDF,
+                                   mExtrusionCoef[indexOfColor.first]);
+        }
 
-        pMesh->mNumVertices = (unsigned int)(3 * trianglesCount);
+        return scenes;
+    }
 
-        pMesh->mFaces = new aiFace[trianglesCount];
-        pMesh->mNumFaces = (unsigned int)(trianglesCount);
+    /// Collects the colors, border edges and optionally the vertex SDF values of createPolyScenes().
+    /// The normals and borders are maintained by the Geometry, so this is a linear pass over the detailed mesh.
+    PolyExtrusionData computePolyExtrusionData(bool withSDF) {
+        const PolyhedronData::Mesh &mesh = *mGeometry->getMeshDetailed();
 
-        for(unsigned int i = 0; i < trianglesCount; i++) {
-            aiFace &face = pMesh->mFaces[i];
-            face.mIndices = new unsigned int[3];
-            face.mNumIndices = 3;
+        PolyExtrusionData data;
+        data.withSDF = withSDF;
 
-            for(unsigned int j = 0; j < face.mNumIndices; j++) {
-                pMesh->mVertices[3 * i + j] = aiVector3D(mGeometry->getTriangle(triangleIndices[i]).getVertex(j).x,
-                                                         mGeometry->getTriangle(triangleIndices[i]).getVertex(j).y,
-                                                         mGeometry->getTriangle(triangleIndices[i]).getVertex(j).z);
+        for(PolyhedronData::face_descriptor fd : mesh.faces()) {
+            colorIndex color = mGeometry->getTriangle(mGeometry->getMeshDetailedIdMap()[fd]).getColor();
+            data.colorsWithIndices[color].emplace_back(mGeometry->getMeshDetailedIdMap()[fd]);
+        }
 
-                pMesh->mNormals[3 * i + j] = aiVector3D(mGeometry->getTriangle(triangleIndices[i]).getNormal().x,
-                                                        mGeometry->getTriangle(triangleIndices[i]).getNormal().y,
-                                                        mGeometry->getTriangle(triangleIndices[i]).getNormal().z);
+        // Every color gets its edges, so the data is only read by createNewPolyScene()
+        for(const auto &indexOfColor : data.colorsWithIndices) {
+            data.borderEdges[indexOfColor.first];
+        }
+        for(PolyhedronData::halfedge_descriptor halfedge : mesh.halfedges()) {
+            if(mGeometry->isMeshDetailedColorBorder(halfedge)) {
+                const DetailedTriangleId triIndex = mGeometry->getMeshDetailedIdMap()[mesh.face(halfedge)];
+                data.borderEdges.at(mGeometry->getTriangle(triIndex).getColor()).push_back(halfedge);
+            }
+        }
 
-                face.mIndices[j] = 3 * i + j;
+        if(withSDF) {
+            data.vertexSDF.assign(mesh.num_vertices(), 0.0f);
+            for(PolyhedronData::vertex_descriptor vd : mesh.vertices()) {
+                float &vertexSDF = data.vertexSDF[static_cast<size_t>(vd)];
+                size_t degree = 0;
+                for(PolyhedronData::halfedge_descriptor halfedge : CGAL::halfedges_around_target(vd, mesh)) {
+                    if(!mesh.is_border(halfedge)) {
+                        DetailedTriangleId triIndex = mGeometry->getMeshDetailedIdMap()[mesh.face(halfedge)];
+                        vertexSDF += (float)mGeometry->getSdfValue(triIndex.getBaseId());
+                    }
+                    ++degree;
+                }
+                vertexSDF = vertexSDF / degree;  // average
             }
         }
-        return scene;
+        return data;
+    }
+
+    /// Scene of the base triangles of one color, which share the vertices of the base triangles
+    std::unique_ptr<aiScene> createNewNonPolySurfaceScene(const std::vector<unsigned int> &triangleIndices,
+                                                          const std::vector<glm::vec3> &positions,
+                                                          const std::vector<std::array<size_t, 3>> &triangleVertices) {
+        return createIndexedSurfaceScene(createBaseSurface(triangleIndices, positions, triangleVertices));
+    }
+
+    /// Scene of the faces of the detailed mesh of one color, which share the vertices of the detailed mesh
+    std::unique_ptr<aiScene> createNewPolySurfaceScene(const std::vector<PolyhedronData::face_descriptor> &faces) {
+        return createIndexedSurfaceScene(createDetailedSurface(faces));
     }
 
-    std::unique_ptr<aiScene> createNewPolySurfaceScene(std::vector<DetailedTriangleId> &triangleIndices) {
+    static std::unique_ptr<aiScene> createIndexedSurfaceScene(const IndexedSurface &surface) {
         std::unique_ptr<aiScene> scene = std::make_unique<aiScene>();
 
         scene->mRootNode = new aiNode();
@@ -380,39 +907,34 @@ class ModelExporter {
 
         auto pMesh = scene->mMeshes[0];
 
-        size_t trianglesCount = triangleIndices.size();
-
-        pMesh->mVertices = new aiVector3D[3 * trianglesCount];
-        pMesh->mNormals = new aiVector3D[3 * trianglesCount];
-
-        pMesh->mNumVertices = (unsigned int)(3 * trianglesCount);
+        const size_t vertexCount = surface.positions.size();
+        pMesh->mVertices = new aiVector3D[vertexCount];
+        pMesh->mNormals = new aiVector3D[vertexCount];
+        pMesh->mNumVertices = (unsigned int)(vertexCount);
+        for(size_t i = 0; i < vertexCount; i++) {
+            const glm::vec3 &position = surface.positions[i];
+            const glm::vec3 &normal = surface.normals[i];
+            pMesh->mVertices[i] = aiVector3D(position.x, position.y, position.z);
+            pMesh->mNormals[i] = aiVector3D(normal.x, normal.y, normal.z);
+        }
 
+        const size_t trianglesCount = surface.triangles.size();
         pMesh->mFaces = new aiFace[trianglesCount];
         pMesh->mNumFaces = (unsigned int)(trianglesCount);
-
-        for(unsigned int i = 0; i < trianglesCount; i++) {
+        for(size_t i = 0; i < trianglesCount; i++) {
             aiFace &face = pMesh->mFaces[i];
             face.mIndices = new unsigned int[3];
             face.mNumIndices = 3;
-
-            for(unsigned int j = 0; j < face.mNumIndices; j++) {
-                pMesh->mVertices[3 * i + j] = aiVector3D(mGeometry->getTriangle(triangleIndices[i]).getVertex(j).x,
-                                                         mGeometry->getTriangle(triangleIndices[i]).getVertex(j).y,
-                                                         mGeometry->getTriangle(triangleIndices[i]).getVertex(j).z);
-
-                pMesh->mNormals[3 * i + j] = aiVector3D(mGeometry->getTriangle(triangleIndices[i]).getNormal().x,
-                                                        mGeometry->getTriangle(triangleIndices[i]).getNormal().y,
-                                                        mGeometry->getTriangle(triangleIndices[i]).getNormal().z);
-
-                face.mIndices[j] = 3 * i + j;
-            }
+            std::copy(surface.triangles[i].begin(), surface.triangles[i].end(), face.mIndices);
         }
         return scene;
     }
 
-    std::unique_ptr<aiScene> createNewNonPolyScene(std::vector<unsigned int> &triangleIndices,
-                                                   std::map<std::array<float, 3>, glm::vec3> &vertexNormalLookup,
-                                                   std::vector<IndexedEdge> &borderEdges, float userCoef) {
+    /// @param cornerVertices Vertex of each corner of the triangles, 3 per triangle, indexing vertexNormals
+    std::unique_ptr<aiScene> createNewNonPolyScene(const std::vector<unsigned int> &triangleIndices,
+                                                   const std::vector<size_t> &cornerVertices,
+                                                   const std::vector<glm::vec3> &vertexNormals,
+                                                   const std::vector<IndexedEdge> &borderEdges, float userCoef) {
         size_t borderTriangleCount = 2 * borderEdges.size();
 
         float extrusionCoef = glm::length(mGeometry->getBoundingBoxMax() - mGeometry->getBoundingBoxMin()) * userCoef;
@@ -449,7 +971,13 @@ class ModelExporter {
         pMesh->mFaces = new aiFace[trianglesCount * 2 + borderTriangleCount];
         pMesh->mNumFaces = (unsigned int)(trianglesCount * 2 + borderTriangleCount);
 
-        for(unsigned int i = 0; i < trianglesCount; i++) {
+        // Items for parallel_for, every triangle and wall writes only its own faces and vertices
+        std::vector<size_t> triangleIds(trianglesCount);
+        std::iota(triangleIds.begin(), triangleIds.end(), 0);
+        std::vector<size_t> edgeIds(borderEdges.size());
+        std::iota(edgeIds.begin(), edgeIds.end(), 0);
+
+        mThreadPool.parallel_for(triangleIds.begin(), triangleIds.end(), [&](const size_t i) {
             aiFace &face = pMesh->mFaces[i];
             face.mIndices = new unsigned int[3];
             face.mNumIndices = 3;
@@ -463,11 +991,11 @@ class ModelExporter {
                                                         mGeometry->getTriangle(triangleIndices[i]).getNormal().y,
                                                         mGeometry->getTriangle(triangleIndices[i]).getNormal().z);
 
-                face.mIndices[j] = 3 * i + j;
+                face.mIndices[j] = static_cast<unsigned int>(3 * i + j);
             }
-        }
+        });
 
-        for(unsigned int i = 0; i < trianglesCount; i++) {
+        mThreadPool.parallel_for(triangleIds.begin(), triangleIds.end(), [&](const size_t i) {
             aiFace &face = pMesh->mFaces[i + trianglesCount];
             face.mIndices = new unsigned int[3];
             face.mNumIndices = 3;
@@ -477,7 +1005,7 @@ class ModelExporter {
 
                 glm::vec3 vertex = mGeometry->getTriangle(triangleIndices[i]).getVertex(j);
 
-                glm::vec3 vertexNormal = extrusionCoef * vertexNormalLookup[{vertex.x, vertex.y, vertex.z}];
+                glm::vec3 vertexNormal = extrusionCoef * vertexNormals[cornerVertices[3 * triangleIndices[i] + j]];
 
                 pMesh->mVertices[3 * (i + trianglesCount) + j] =
                     aiVector3D(vertex.x - vertexNormal.x, vertex.y - vertexNormal.y, vertex.z - vertexNormal.z);
@@ -489,9 +1017,9 @@ class ModelExporter {
 
                 face.mIndices[jRevert] = (unsigned int)(3 * (i + trianglesCount) + j);
             }
-        }
+        });
 
-        for(size_t i = 0; i < borderEdges.size(); i++) {
+        mThreadPool.parallel_for(edgeIds.begin(), edgeIds.end(), [&](const size_t i) {
             aiFace &face1 = pMesh->mFaces[(2 * trianglesCount) + (2 * i)];
             face1.mIndices = new unsigned int[3];
             face1.mNumIndices = 3;
@@ -503,8 +1031,9 @@ class ModelExporter {
             glm::vec3 vertex1 = mGeometry->getTriangle(borderEdges[i].tri).getVertex(borderEdges[i].id1);
             glm::vec3 vertex2 = mGeometry->getTriangle(borderEdges[i].tri).getVertex(borderEdges[i].id2);
 
-            glm::vec3 vertexNormal1 = extrusionCoef * vertexNormalLookup[{vertex1.x, vertex1.y, vertex1.z}];
-            glm::vec3 vertexNormal2 = extrusionCoef * vertexNormalLookup[{vertex2.x, vertex2.y, vertex2.z}];
+            const size_t firstCorner = 3 * borderEdges[i].tri;
+            glm::vec3 vertexNormal1 = extrusionCoef * vertexNormals[cornerVertices[firstCorner + borderEdges[i].id1]];
+            glm::vec3 vertexNormal2 = extrusionCoef * vertexNormals[cornerVertices[firstCorner + borderEdges[i].id2]];
 
             pMesh->mVertices[3 * 2 * (trianglesCount + i) + 0] = aiVector3D(vertex1.x, vertex1.y, vertex1.z);
             pMesh->mVertices[3 * 2 * (trianglesCount + i) + 1] =
@@ -530,16 +1059,16 @@ class ModelExporter {
             face2.mIndices[0] = (unsigned int)(3 * 2 * (trianglesCount + i) + 3);
             face2.mIndices[1] = (unsigned int)(3 * 2 * (trianglesCount + i) + 4);
             face2.mIndices[2] = (unsigned int)(3 * 2 * (trianglesCount + i) + 5);
-        }
+        });
 
         return scene;
     }
 
     std::unique_ptr<aiScene> createNewPolyScene(
-        std::vector<DetailedTriangleId> &triangleIndices,
-        std::unordered_map<PolyhedronData::vertex_descriptor, glm::vec3> &vertexNormals,
-        std::set<PolyhedronData::halfedge_descriptor> &borderEdges,
-        std::map<PolyhedronData::vertex_descriptor, float> &vertexSDF, float userCoef) {
+        const std::vector<DetailedTriangleId> &triangleIndices,
+        const std::vector<glm::vec3> &vertexNormals,
+        const std::vector<PolyhedronData::halfedge_descriptor> &borderEdges, const std::vector<float> &vertexSDF,
+        float userCoef) {
         size_t borderTriangleCount = 2 * borderEdges.size();
 
         float extrusionCoef = glm::length(mGeometry->getBoundingBoxMax() - mGeometry->getBoundingBoxMin()) * userCoef;
@@ -548,9 +1077,9 @@ class ModelExporter {
 
         float maxSdfValue = 0.0f;
         if(withSDF) {
-            for(auto &v : vertexSDF) {
-                if(v.second > maxSdfValue) {
-                    maxSdfValue = v.second;
+            for(const float v : vertexSDF) {
+                if(v > maxSdfValue) {
+                    maxSdfValue = v;
                 }
             }
         }
@@ -626,10 +1155,10 @@ class ModelExporter {
 
                 auto &p = mGeometry->getMeshDetailed()->point(polyVertex);
                 glm::vec3 vertex(p.x(), p.y(), p.z());
-                glm::vec3 vertexNormal = extrusionCoef * vertexNormals[polyVertex];
+                glm::vec3 vertexNormal = extrusionCoef * vertexNormals[static_cast<size_t>(polyVertex)];
 
                 if(withSDF) {
-                    vertexNormal *= vertexSDF[polyVertex] / maxSdfValue;
+                    vertexNormal *= vertexSDF[static_cast<size_t>(polyVertex)] / maxSdfValue;
                 }
 
                 pMesh->mVertices[3 * (i + trianglesCount) + j] =
@@ -666,12 +1195,12 @@ class ModelExporter {
             glm::vec3 vertex1(p1.x(), p1.y(), p1.z());
             glm::vec3 vertex2(p2.x(), p2.y(), p2.z());
 
-            glm::vec3 vertexNormal1 = extrusionCoef * vertexNormals[polyVertex1];
-            glm::vec3 vertexNormal2 = extrusionCoef * vertexNormals[polyVertex2];
+            glm::vec3 vertexNormal1 = extrusionCoef * vertexNormals[static_cast<size_t>(polyVertex1)];
+            glm::vec3 vertexNormal2 = extrusionCoef * vertexNormals[static_cast<size_t>(polyVertex2)];
 
             if(!vertexSDF.empty()) {
-                vertexNormal1 *= vertexSDF[polyVertex1] / maxSdfValue;
-                vertexNormal2 *= vertexSDF[polyVertex2] / maxSdfValue;
+                vertexNormal1 *= vertexSDF[static_cast<size_t>(polyVertex1)] / maxSdfValue;
+                vertexNormal2 *= vertexSDF[static_cast<size_t>(polyVertex2)] / maxSdfValue;
             }
 
             pMesh->mVertices[3 * 2 * (trianglesCount + i) + 0] = aiVector3D(vertex1.x, vertex1.y, vertex1.z);
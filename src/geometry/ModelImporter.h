@@ -9,7 +9,12 @@
 #include <boost/functional/hash.hpp>
 #include <glm/gtc/epsilon.hpp>
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <iostream>
+#include <numeric>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -19,6 +24,7 @@
 #include "geometry/ColorManager.h"
 #include "geometry/GeometryProgress.h"
 #include "geometry/Triangle.h"
+#include "geometry/VertexWelder.h"
 #include "peprassert.h"
 
 namespace pepr3d {
@@ -39,9 +45,7 @@ class ModelImporter {
    public:
     ModelImporter(const std::string p, GeometryProgress *progress, ::ThreadPool &threadPool)
         : mPath(p), mProgress(progress) {
-        auto loadedModel = threadPool.enqueue([this]() { return loadModel(this->mPath); });
-        bool loadedModelWithJoinedVertices = loadModelWithJoinedVertices(this->mPath);
-        this->mModelLoaded = loadedModel.get() & loadedModelWithJoinedVertices;
+        this->mModelLoaded = loadModel(this->mPath, threadPool);
         P_ASSERT(mTriangles.size() == mIndexBuffer.size());
     }
 
@@ -88,91 +92,9 @@ class ModelImporter {
         }
     }
 
-    /// Pull the correct Vertex buffer (correct as in vertices are re-used for multiple triangles) from the mesh
-    static std::vector<glm::vec3> calculateVertexBuffer(aiMesh *mesh) {
-        std::vector<glm::vec3> vertices;
-        vertices.reserve(mesh->mNumVertices);
-        for(size_t i = 0; i < mesh->mNumVertices; i++) {
-            vertices.emplace_back(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
-        }
-        P_ASSERT(vertices.size() == mesh->mNumVertices);
-        return vertices;
-    }
-
-    /// Pull the correct index buffer (correct as in different than 0-N) from the mesh
-    static std::vector<std::array<size_t, 3>> calculateIndexBuffer(aiMesh *mesh) {
-        std::vector<std::array<size_t, 3>> indices;
-        indices.reserve(mesh->mNumFaces);
-
-        for(unsigned int i = 0; i < mesh->mNumFaces; i++) {
-            P_ASSERT(mesh->mFaces[i].mNumIndices == 3);
-
-            std::array<glm::vec3, 3> triangle;
-
-            for(unsigned int j = 0; j < mesh->mFaces[i].mNumIndices; j++) {
-                triangle[j].x = mesh->mVertices[mesh->mFaces[i].mIndices[j]].x;
-                triangle[j].y = mesh->mVertices[mesh->mFaces[i].mIndices[j]].y;
-                triangle[j].z = mesh->mVertices[mesh->mFaces[i].mIndices[j]].z;
-            }
-
-            /// Check for degenerate triangles which we do not want in the representation
-            const bool isZeroArea = zeroAreaCheck(triangle);
-            if(!isZeroArea) {
-                indices.push_back(
-                    {mesh->mFaces[i].mIndices[0], mesh->mFaces[i].mIndices[1], mesh->mFaces[i].mIndices[2]});
-            } else {
-                CI_LOG_W("Imported a triangle with zero surface area. Ommiting it from index buffer.");
-            }
-        }
-
-        return indices;
-    }
-
-    /// A method which loads the model with ALL vertex information apart from position removed. This is done to
-    /// correctly merge all vertices and receive a closed mesh, which can't be done if more than one vertex per position
-    /// exists.
-    bool loadModelWithJoinedVertices(const std::string &path) {
-        std::vector<aiMesh *> meshes;
-
-        /// Creates an instance of the Importer class
-        Assimp::Importer importer;
-        importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_LINE | aiPrimitiveType_POINT);
-        importer.SetPropertyInteger(AI_CONFIG_PP_FD_REMOVE, 1);
-        importer.SetPropertyInteger(AI_CONFIG_PP_FD_CHECKAREA, 1);
-        importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, aiComponent_NORMALS | aiComponent_TANGENTS_AND_BITANGENTS |
-                                                                aiComponent_COLORS | aiComponent_TEXCOORDS |
-                                                                aiComponent_BONEWEIGHTS);
-
-        // Progress handler
-        if(mProgress != nullptr) {
-            auto assimpProgress =
-                std::make_unique<AssimpProgress<std::atomic<float>>>(&(mProgress->importComputePercentage));
-            importer.SetProgressHandler(assimpProgress.release());  // importer calls delete on assimpProgress
-        }
-
-        /// Scene with some postprocessing
-        const aiScene *scene =
-            importer.ReadFile(path, aiProcess_Triangulate | aiProcess_SortByPType | aiProcess_RemoveComponent |
-                                        aiProcess_JoinIdenticalVertices | aiProcess_FindDegenerates);
-
-        // If the import failed, report it
-        if(!scene) {
-            CI_LOG_E(importer.GetErrorString());
-            return false;
-        }
-
-        /// Access the file's contents
-        processNode(scene->mRootNode, scene, meshes);
-
-        mVertexBuffer = calculateVertexBuffer(meshes[0]);
-        mIndexBuffer = calculateIndexBuffer(meshes[0]);
-
-        meshes.clear();
-        return true;
-    }
-
-    /// A method which loads the model we will use for rendering - with duplicated vertices for normals, colors, etc.
-    bool loadModel(const std::string &path) {
+    /// Loads the model in a single pass. The triangles for rendering come with the normals and colors of the file,
+    /// which may duplicate vertices, so the vertex and index buffers of the closed mesh weld the vertices afterwards.
+    bool loadModel(const std::string &path, ::ThreadPool &threadPool) {
         mPalette.clear();
         std::vector<aiMesh *> meshes;
 
@@ -203,8 +125,18 @@ class ModelImporter {
 
         /// Access the file's contents
         processNode(scene->mRootNode, scene, meshes);
+        if(meshes.empty()) {
+            CI_LOG_E("The file does not contain any mesh.");
+            return false;
+        }
 
-        mTriangles = processFirstMesh(meshes[0]);
+        if(mProgress != nullptr) {
+            mProgress->importComputePercentage = 0.0f;
+        }
+        processMeshes(meshes, threadPool);
+        if(mProgress != nullptr) {
+            mProgress->importComputePercentage = 1.0f;
+        }
 
         if(mPalette.empty()) {
             mPalette = ColorManager();  // create new palette with default colors
@@ -230,78 +162,196 @@ class ModelImporter {
         }
     }
 
-    /// Obtains model information only from first of the meshes.
-    std::vector<DataTriangle> processFirstMesh(aiMesh *mesh) {
-        std::vector<DataTriangle> triangles;
+    /// Faces processed by a single item of parallel_for
+    static constexpr size_t CHUNK_FACES = 16384;
+
+    /// A chunk of faces of one of the meshes, the item of parallel_for
+    struct FaceChunk {
+        size_t mesh;
+        size_t begin;
+        size_t end;
+    };
+
+    /// Colors of one chunk of faces, in the order of their first face
+    struct ChunkColors {
+        std::vector<std::array<float, 3>> colors;
+
+        /// Index of the color of each face of the chunk in colors
+        std::vector<std::uint32_t> faceColors;
+    };
+
+    static std::array<glm::vec3, 3> getFaceVertices(const aiMesh *mesh, const aiFace &face) {
+        std::array<glm::vec3, 3> vertices;
+        for(unsigned int j = 0; j < 3; j++) {
+            const aiVector3D &vertex = mesh->mVertices[face.mIndices[j]];
+            vertices[j] = glm::vec3(vertex.x, vertex.y, vertex.z);
+        }
+        return vertices;
+    }
 
-        /// Obtaining triangle color. Default color is set if there is no color information
-        std::unordered_map<std::array<float, 3>, size_t, boost::hash<std::array<float, 3>>> colorLookup;
+    /// Obtains model information from all of the meshes, merged into a single model. Fills mTriangles and
+    /// mIndexBuffer with the same triangles, and mVertexBuffer with the welded vertices of all the meshes.
+    /// The faces of all the meshes are split into chunks processed in parallel, each chunk with its own color table,
+    /// so a large mesh does not wait for the small ones. The face counts and the color tables of the chunks are then
+    /// merged in the order of the meshes and of the chunks, which gives the triangles and the colors the indices of a
+    /// serial pass over the meshes.
+    void processMeshes(const std::vector<aiMesh *> &meshes, ::ThreadPool &threadPool) {
+        // Items for parallel_for
+        std::vector<size_t> meshIds(meshes.size());
+        std::iota(meshIds.begin(), meshIds.end(), 0);
+
+        /// Vertices and faces of each mesh are placed after those of the previous meshes
+        std::vector<size_t> meshVertexOffsets(meshes.size() + 1, 0);
+        std::vector<size_t> meshFaceOffsets(meshes.size() + 1, 0);
+        std::vector<FaceChunk> chunks;
+        for(size_t meshIdx = 0; meshIdx < meshes.size(); ++meshIdx) {
+            const size_t meshFaceCount = meshes[meshIdx]->mNumFaces;
+            meshVertexOffsets[meshIdx + 1] = meshVertexOffsets[meshIdx] + meshes[meshIdx]->mNumVertices;
+            meshFaceOffsets[meshIdx + 1] = meshFaceOffsets[meshIdx] + meshFaceCount;
+            for(size_t begin = 0; begin < meshFaceCount; begin += CHUNK_FACES) {
+                chunks.push_back({meshIdx, begin, std::min(meshFaceCount, begin + CHUNK_FACES)});
+            }
+        }
+        const size_t faceCount = meshFaceOffsets.back();
+        std::vector<size_t> chunkIds(chunks.size());
+        std::iota(chunkIds.begin(), chunkIds.end(), 0);
+
+        /// Weld the vertices of all the meshes together, so the meshes touching each other are connected
+        std::vector<glm::vec3> positions(meshVertexOffsets.back());
+        threadPool.parallel_for(meshIds.begin(), meshIds.end(), [&](const size_t meshIdx) {
+            const aiMesh *mesh = meshes[meshIdx];
+            for(size_t i = 0; i < mesh->mNumVertices; i++) {
+                positions[meshVertexOffsets[meshIdx] + i] =
+                    glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+            }
+        });
+        const VertexWelder welder(positions, threadPool);
+        mVertexBuffer = welder.getVertices();
+        const std::vector<size_t> &weldedIndices = welder.getIndices();
+        positions.clear();
+
+        /// Normals of the faces, and which faces do not have a zero area and are kept in the representation,
+        /// indexed by the face offset of the mesh plus the face index within the mesh
+        std::vector<glm::vec3> faceNormals(faceCount);
+        std::vector<char> isFaceKept(faceCount);
+        std::vector<size_t> chunkKeptCounts(chunks.size(), 0);
+        std::vector<ChunkColors> chunkColors(chunks.size());
+
+        threadPool.parallel_for(chunkIds.begin(), chunkIds.end(), [&](const size_t chunk) {
+            const aiMesh *mesh = meshes[chunks[chunk].mesh];
+            const size_t begin = chunks[chunk].begin;
+            const size_t end = chunks[chunk].end;
+            const size_t faceOffset = meshFaceOffsets[chunks[chunk].mesh];
+            const bool hasColors = mesh->GetNumColorChannels() > 0;
+            std::unordered_map<std::array<float, 3>, std::uint32_t, boost::hash<std::array<float, 3>>> colorLookup;
+            ChunkColors &colors = chunkColors[chunk];
+            if(hasColors) {
+                colors.faceColors.resize(end - begin);
+            }
 
-        for(unsigned int i = 0; i < mesh->mNumFaces; i++) {
-            aiFace face = mesh->mFaces[i];
+            for(size_t i = begin; i < end; i++) {
+                const aiFace &face = mesh->mFaces[i];
+                P_ASSERT(face.mNumIndices == 3);
 
-            P_ASSERT(face.mNumIndices == 3);
+                const std::array<glm::vec3, 3> vertices = getFaceVertices(mesh, face);
+                glm::vec3 normals[3];
+                if(mesh->HasNormals()) {
+                    for(unsigned int j = 0; j < 3; j++) {
+                        const aiVector3D &normal = mesh->mNormals[face.mIndices[j]];
+                        normals[j] = glm::vec3(normal.x, normal.y, normal.z);
+                    }
+                }
 
-            std::array<glm::vec3, 3> vertices;
-            glm::vec3 normals[3];
-            glm::vec3 normal;
+                /// Calculation of surface normals from vertices and vertex normals or only from vertices.
+                faceNormals[faceOffset + i] = calculateNormal(vertices, normals);
 
-            /// Loading triangle vertices and normals (if it has them)
-            for(unsigned int j = 0; j < face.mNumIndices; j++) {
-                vertices[j].x = mesh->mVertices[face.mIndices[j]].x;
-                vertices[j].y = mesh->mVertices[face.mIndices[j]].y;
-                vertices[j].z = mesh->mVertices[face.mIndices[j]].z;
+                /// Check for degenerate triangles which we do not want in the representation
+                const double Eps = 0.000001;
+                isFaceKept[faceOffset + i] = !zeroAreaCheck(vertices, Eps);
+                if(isFaceKept[faceOffset + i]) {
+                    // Normal should be normalized
+                    P_ASSERT(glm::epsilonEqual<double>(glm::length(faceNormals[faceOffset + i]), 1.0, Eps));
+                    ++chunkKeptCounts[chunk];
+                }
 
-                if(mesh->HasNormals()) {
-                    normals[j].x = mesh->mNormals[face.mIndices[j]].x;
-                    normals[j].y = mesh->mNormals[face.mIndices[j]].y;
-                    normals[j].z = mesh->mNormals[face.mIndices[j]].z;
+                /// Colors of degenerate faces still take a place in the palette, as they take it in the file
+                if(hasColors) {
+                    const aiColor4D &color = mesh->mColors[0][face.mIndices[0]];  // first layer of the first vertex
+                    const std::array<float, 3> rgbArray = {color.r, color.g, color.b};
+                    const auto result =
+                        colorLookup.emplace(rgbArray, static_cast<std::uint32_t>(colors.colors.size()));
+                    if(result.second) {
+                        colors.colors.push_back(rgbArray);
+                    }
+                    colors.faceColors[i - begin] = result.first->second;
                 }
             }
+        });
 
-            /// Calculation of surface normals from vertices and vertex normals or only from vertices.
-            normal = calculateNormal(vertices, normals);
-
-            glm::vec4 color;
-            size_t returnColor = 0;
-            if(mesh->GetNumColorChannels() > 0) {
-                color.r = mesh->mColors[0][face.mIndices[0]][0];  // first color layer from first vertex of triangle
-                color.g = mesh->mColors[0][face.mIndices[0]][1];
-                color.b = mesh->mColors[0][face.mIndices[0]][2];
-                color.a = 1;
-
-                const std::array<float, 3> rgbArray = {color.r, color.g, color.b};
+        /// Merge the color tables of the chunks into the palette, default color is used if there is no color
+        /// information
+        std::unordered_map<std::array<float, 3>, size_t, boost::hash<std::array<float, 3>>> colorLookup;
+        std::vector<std::vector<size_t>> chunkPaletteColors(chunks.size());
+        for(size_t chunk = 0; chunk < chunks.size(); ++chunk) {
+            for(const std::array<float, 3> &rgbArray : chunkColors[chunk].colors) {
                 const auto result = colorLookup.find(rgbArray);
                 if(result != colorLookup.end()) {
-                    P_ASSERT(result->second < mPalette.size());
-                    P_ASSERT(result->second >= 0);
-                    returnColor = result->second;
+                    chunkPaletteColors[chunk].push_back(result->second);
                 } else {
-                    mPalette.addColor(color);
+                    // Colors beyond the palette limit are not added and take the last color
+                    mPalette.addColor(glm::vec4(rgbArray[0], rgbArray[1], rgbArray[2], 1.f));
                     colorLookup.insert({rgbArray, mPalette.size() - 1});
-                    returnColor = mPalette.size() - 1;
-                    P_ASSERT(colorLookup.find(rgbArray) != colorLookup.end());
+                    chunkPaletteColors[chunk].push_back(mPalette.size() - 1);
                 }
             }
+        }
 
-            /// Check for degenerate triangles which we do not want in the representation
-            const double Eps = 0.000001;
-            const bool isZeroArea = zeroAreaCheck(vertices, Eps);
-            if(!isZeroArea) {
-                /// Do last minute quality checks on the triangle
-                // Normal should be normalized
-                P_ASSERT(glm::epsilonEqual<double>(glm::length(normal), 1.0, Eps));
+        /// Place the kept triangles of each chunk after those of the previous chunks
+        std::vector<size_t> chunkOffsets(chunks.size() + 1, 0);
+        std::partial_sum(chunkKeptCounts.begin(), chunkKeptCounts.end(), chunkOffsets.begin() + 1);
+        mTriangles.clear();
+        mTriangles.resize(chunkOffsets.back());
+        mIndexBuffer.clear();
+        mIndexBuffer.resize(chunkOffsets.back());
+
+        threadPool.parallel_for(chunkIds.begin(), chunkIds.end(), [&](const size_t chunk) {
+            const aiMesh *mesh = meshes[chunks[chunk].mesh];
+            const size_t begin = chunks[chunk].begin;
+            const size_t end = chunks[chunk].end;
+            const size_t faceOffset = meshFaceOffsets[chunks[chunk].mesh];
+            const size_t vertexOffset = meshVertexOffsets[chunks[chunk].mesh];
+            const bool hasColors = !chunkColors[chunk].faceColors.empty();
+            size_t triIdx = chunkOffsets[chunk];
+            for(size_t i = begin; i < end; i++) {
+                if(!isFaceKept[faceOffset + i]) {
+                    continue;
+                }
+                const aiFace &face = mesh->mFaces[i];
+                const size_t returnColor =
+                    hasColors ? chunkPaletteColors[chunk][chunkColors[chunk].faceColors[i - begin]] : 0;
                 // ColorPalette should either be empty and return color 0, or returnColor should be within the palette
                 P_ASSERT(
                     (mPalette.size() == 0 && returnColor == 0) ||
                     (mPalette.size() > 0 && returnColor < mPalette.size() && returnColor < PEPR3D_MAX_PALETTE_COLORS));
-                /// Place the constructed triangle
-                triangles.emplace_back(vertices[0], vertices[1], vertices[2], normal, returnColor);
-            } else {
-                CI_LOG_W("Imported a triangle with zero surface area. Ommiting it from geometry data.");
+
+                /// Place the constructed triangle, each triangle is a new object, so CGAL's reference counting does not
+                /// race between the threads
+                const std::array<glm::vec3, 3> vertices = getFaceVertices(mesh, face);
+                mTriangles[triIdx] =
+                    DataTriangle(vertices[0], vertices[1], vertices[2], faceNormals[faceOffset + i], returnColor);
+                mIndexBuffer[triIdx] = {weldedIndices[vertexOffset + face.mIndices[0]],
+                                        weldedIndices[vertexOffset + face.mIndices[1]],
+                                        weldedIndices[vertexOffset + face.mIndices[2]]};
+                ++triIdx;
             }
+            P_ASSERT(triIdx == chunkOffsets[chunk + 1]);
+        });
+
+        const size_t omittedCount = faceCount - mTriangles.size();
+        if(omittedCount > 0) {
+            CI_LOG_W("Imported " << omittedCount << " of " << faceCount
+                                 << " triangles with zero surface area. Omitting them from geometry data.");
         }
-        return triangles;
     }
 
     /// Calculates triangle normal from its vertices with orientation of original vertex normals.
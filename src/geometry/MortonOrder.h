@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "peprassert.h"
+
+namespace pepr3d {
+
+/// Orders triangles along a Morton (Z-order) curve through a grid over their bounding box, so that triangles
+/// close to each other in the order are close to each other in space, e.g., to cull ranges of a buffer at once.
+class MortonOrder {
+   public:
+    /// Returns the indices of the triangles in the order of the curve through the cells of their centroids.
+    /// Triangles in the same cell keep their original order, so the result does not depend on the threads.
+    /// @param triangleVertices 3 consecutive vertices of each triangle
+    static std::vector<size_t> getTriangleOrder(const std::vector<glm::vec3>& triangleVertices,
+                                                ::ThreadPool& threadPool) {
+        P_ASSERT(triangleVertices.size() % 3 == 0);
+        const size_t triangleCount = triangleVertices.size() / 3;
+        if(triangleCount == 0) {
+            return {};
+        }
+
+        glm::vec3 boxMin = triangleVertices.front();
+        glm::vec3 boxMax = triangleVertices.front();
+        for(const glm::vec3& vertex : triangleVertices) {
+            boxMin = glm::min(boxMin, vertex);
+            boxMax = glm::max(boxMax, vertex);
+        }
+        const glm::vec3 boxSize = boxMax - boxMin;
+        const float maxSize = std::max(std::max(boxSize.x, boxSize.y), boxSize.z);
+        const float scale = maxSize > 0.f ? static_cast<float>(CELLS_PER_AXIS) / maxSize : 0.f;
+
+        // Items for parallel_for
+        std::vector<size_t> triangleIds(triangleCount);
+        std::iota(triangleIds.begin(), triangleIds.end(), 0);
+
+        std::vector<std::pair<std::uint32_t, size_t>> codes(triangleCount);
+        threadPool.parallel_for(triangleIds.begin(), triangleIds.end(), [&](const size_t triIdx) {
+            const glm::vec3 centroid =
+                (triangleVertices[3 * triIdx] + triangleVertices[3 * triIdx + 1] + triangleVertices[3 * triIdx + 2]) *
+                (1.f / 3.f);
+            const glm::vec3 cell = (centroid - boxMin) * scale;
+            codes[triIdx] = {getCode(getCoordinate(cell.x), getCoordinate(cell.y), getCoordinate(cell.z)), triIdx};
+        });
+        std::sort(codes.begin(), codes.end());
+
+        std::vector<size_t> order(triangleCount);
+        for(size_t i = 0; i < triangleCount; ++i) {
+            order[i] = codes[i].second;
+        }
+        return order;
+    }
+
+   private:
+    /// Coordinates of the cells are 10-bit, 30 bits of the code in total
+    static const std::uint32_t CELLS_PER_AXIS = 1 << 10;
+
+    static std::uint32_t getCoordinate(const float value) {
+        return std::min(static_cast<std::uint32_t>(std::max(value, 0.f)), CELLS_PER_AXIS - 1);
+    }
+
+    /// Spreads the 10 bits of the coordinate to every third bit
+    static std::uint32_t spreadBits(std::uint32_t value) {
+        value = (value | (value << 16)) & 0x030000FF;
+        value = (value | (value << 8)) & 0x0300F00F;
+        value = (value | (value << 4)) & 0x030C30C3;
+        value = (value | (value << 2)) & 0x09249249;
+        return value;
+    }
+
+    static std::uint32_t getCode(const std::uint32_t x, const std::uint32_t y, const std::uint32_t z) {
+        return (spreadBits(x) << 2) | (spreadBits(y) << 1) | spreadBits(z);
+    }
+};
+
+}  // namespace pepr3d
@@ -0,0 +1,82 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "geometry/MortonOrder.h"
+
+namespace {
+void addPointTriangle(std::vector<glm::vec3>& triangleVertices, const glm::vec3& point) {
+    triangleVertices.insert(triangleVertices.end(), 3, point);
+}
+}  // namespace
+
+TEST(MortonOrder, cubeCorners) {
+    /**
+     * Test that the corners of a cube are ordered along the curve, with Z changing fastest and X slowest
+     */
+
+    ::ThreadPool threadPool(2);
+    std::vector<glm::vec3> triangleVertices;
+    for(int corner = 7; corner >= 0; --corner) {
+        addPointTriangle(triangleVertices, glm::vec3((corner >> 2) & 1, (corner >> 1) & 1, corner & 1));
+    }
+    // Same cell as the first corner keeps its place after it
+    addPointTriangle(triangleVertices, glm::vec3(0.f));
+
+    const std::vector<size_t> order = pepr3d::MortonOrder::getTriangleOrder(triangleVertices, threadPool);
+    EXPECT_EQ(order, std::vector<size_t>({7, 8, 6, 5, 4, 3, 2, 1, 0}));
+
+    EXPECT_TRUE(pepr3d::MortonOrder::getTriangleOrder({}, threadPool).empty());
+}
+
+TEST(MortonOrder, localRanges) {
+    /**
+     * Test that shuffled triangles are ordered into a permutation whose ranges are spatially compact,
+     * and that the order does not depend on the threads
+     */
+
+    const size_t resolution = 64;
+    std::vector<glm::vec3> points;
+    for(size_t y = 0; y < resolution; ++y) {
+        for(size_t x = 0; x < resolution; ++x) {
+            points.emplace_back(static_cast<float>(x), static_cast<float>(y), 0.f);
+        }
+    }
+    std::mt19937 random(3);
+    std::shuffle(points.begin(), points.end(), random);
+    std::vector<glm::vec3> triangleVertices;
+    for(const glm::vec3& point : points) {
+        addPointTriangle(triangleVertices, point);
+    }
+
+    ::ThreadPool singleThread(0);
+    ::ThreadPool threadPool(3);
+    const std::vector<size_t> order = pepr3d::MortonOrder::getTriangleOrder(triangleVertices, threadPool);
+    EXPECT_EQ(order, pepr3d::MortonOrder::getTriangleOrder(triangleVertices, singleThread));
+
+    std::vector<size_t> sorted = order;
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<size_t> identity(points.size());
+    std::iota(identity.begin(), identity.end(), 0);
+    ASSERT_EQ(sorted, identity);
+
+    // Each range of 64 triangles along a Z-order curve covers an 8x8 square of the grid
+    const size_t rangeSize = 64;
+    for(size_t begin = 0; begin < order.size(); begin += rangeSize) {
+        glm::vec3 boxMin = points[order[begin]];
+        glm::vec3 boxMax = boxMin;
+        for(size_t i = begin; i < begin + rangeSize; ++i) {
+            boxMin = glm::min(boxMin, points[order[i]]);
+            boxMax = glm::max(boxMax, points[order[i]]);
+        }
+        EXPECT_EQ(boxMax.x - boxMin.x, 7.f);
+        EXPECT_EQ(boxMax.y - boxMin.y, 7.f);
+    }
+}
+
+#endif
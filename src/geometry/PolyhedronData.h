@@ -1,11 +1,17 @@
 #pragma once
 
 #include <CGAL/Surface_mesh.h>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
 #include "geometry/Triangle.h"
 
 namespace pepr3d {
 
-/// CGAL Polyhedron data of the Geometry
+/// CGAL Polyhedron data of the Geometry.
+/// The Surface_mesh of the base triangles is only built to find their connectivity and released afterwards, the
+/// indexed float mesh and the neighbour arrays are all that stays resident, which matters for scans of 20M+ triangles.
 struct PolyhedronData {
     /// Vertex positions after joining all identical vertices.
     /// This is after removing all other componens and as such based only on the position property.
@@ -24,18 +30,24 @@ struct PolyhedronData {
     bool valid = false;
     bool sdfValuesValid = true;
 
-    /// Map converting a face_descriptor into an ID, that corresponds to the mTriangles vector
-    PolyhedronData::Mesh::Property_map<PolyhedronData::face_descriptor, size_t> mIdMap;
-
-    /// Map converting a face_descriptor into the SDF value of the given face.
+    /// SDF value of each triangle (from mTriangles), empty until computed.
     /// Note: the SDF values are linearly normalized so min=0, max=1
-    PolyhedronData::Mesh::Property_map<PolyhedronData::face_descriptor, double> sdf_property_map;
+    std::vector<double> sdfValues;
+
+    /// Opposite halfedge of each halfedge 3 * i + k of the triangle i, from the bulk build of the mesh.
+    /// Saved with the project, so that loading it does not have to match the edges again. Empty if not known.
+    std::vector<uint32_t> faceAdjacency;
+
+    /// Border edges have no neighbour in faceNeighbours
+    static constexpr uint32_t NO_NEIGHBOUR = std::numeric_limits<uint32_t>::max();
 
-    /// A "map" converting the ID of each triangle (from mTriangles) into a face_descriptor
-    std::vector<PolyhedronData::face_descriptor> mFaceDescs;
+    /// IDs of the triangles across the 3 edges of each triangle (from mTriangles), in the order of the halfedges of
+    /// its face. Filled from the Surface_mesh when it is built, the only connectivity kept afterwards.
+    std::vector<std::array<uint32_t, 3>> faceNeighbours;
 
-    /// The data-structure itself
-    Mesh mMesh;
+    /// Cosine of the angle between the normals of each triangle and its neighbour in faceNeighbours,
+    /// 1 for border edges. Filled together with faceNeighbours.
+    std::vector<std::array<float, 3>> faceNeighbourCosines;
 };
 
 }  // namespace pepr3d
\ No newline at end of file
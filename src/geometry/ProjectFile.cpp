@@ -0,0 +1,471 @@
+#include "geometry/ProjectFile.h"
+
+#include <cereal/archives/binary.hpp>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "geometry/BlockCompression.h"
+
+namespace pepr3d {
+namespace ProjectFile {
+
+namespace {
+const char MAGIC[4] = {'P', '3', 'D', 'C'};
+
+/// Size of the blocks the sections are split into, large enough to compress well and small enough to keep all
+/// threads busy with a single large section
+const size_t BLOCK_SIZE = size_t(1) << 20;
+
+/// Triangle details in a single Details section
+const size_t DETAILS_PER_SECTION = 256;
+
+/// Largest ratio of the raw and the stored size of a block, to detect corrupted sizes before allocating them
+const uint64_t MAX_COMPRESSION_RATIO = 256;
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t blockCount;
+    uint32_t reserved;
+};
+
+/// Entry of the table of contents, a single block of a section.
+/// The blocks of a section are consecutive, the sections of the same type differ by their part.
+struct BlockEntry {
+    uint32_t type;
+    uint32_t part;
+
+    /// Position of the block from the start of the file
+    uint64_t offset;
+
+    /// Size of the block in the file, the block is stored uncompressed if it is the same as rawSize
+    uint64_t storedSize;
+    uint64_t rawSize;
+};
+static_assert(sizeof(Header) == 16 && sizeof(BlockEntry) == 32, "The entries are written without padding");
+
+/// A section of the project, before it is split into blocks and after its blocks are joined again
+struct Section {
+    SectionType type;
+    uint32_t part = 0;
+    std::string data;
+};
+
+using DetailMap = std::map<size_t, CopyOnWrite<TriangleDetail>>;
+
+/// Details of a PolygonLazyDetails section, each with the index of its triangle
+std::string saveLazyDetails(const DetailMap::const_iterator begin, const DetailMap::const_iterator end) {
+    std::ostringstream os(std::ios::binary);
+    {
+        cereal::BinaryOutputArchive archive(os);
+        archive(cereal::make_size_tag(static_cast<cereal::size_type>(std::distance(begin, end))));
+        for(auto detailIt = begin; detailIt != end; ++detailIt) {
+            archive(static_cast<uint64_t>(detailIt->first));
+            detailIt->second->saveLazy(archive);
+        }
+    }
+    return os.str();
+}
+
+/// Details of a PolygonLazyDetails section, or of a LazyDetails section if they have the exact triangles
+DetailMap loadLazyDetails(const std::string& data, const bool hasExactTriangles) {
+    std::istringstream is(data, std::ios::binary);
+    cereal::BinaryInputArchive archive(is);
+    cereal::size_type count;
+    archive(cereal::make_size_tag(count));
+
+    DetailMap details;
+    for(cereal::size_type i = 0; i < count; ++i) {
+        uint64_t triangleIdx;
+        archive(triangleIdx);
+        TriangleDetail detail;
+        if(hasExactTriangles) {
+            detail.loadLazyWithExactTriangles(archive);
+        } else {
+            detail.loadLazy(archive);
+        }
+        details.emplace_hint(details.end(), static_cast<size_t>(triangleIdx), CopyOnWrite<TriangleDetail>(detail));
+    }
+    return details;
+}
+
+template <typename... Values>
+std::string archiveValues(const Values&... values) {
+    std::ostringstream os(std::ios::binary);
+    {
+        cereal::BinaryOutputArchive archive(os);
+        archive(values...);
+    }
+    return os.str();
+}
+
+/// Arrays of floats are shuffled by the bytes of the floats
+template <typename T>
+std::string shuffleVector(const std::vector<T>& values) {
+    static_assert(std::is_trivially_copyable<T>::value && sizeof(T) % sizeof(float) == 0, "Only arrays of floats");
+    return BlockCompression::shuffleBytes(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T),
+                                          sizeof(float));
+}
+
+template <typename T>
+std::vector<T> unshuffleVector(const std::string& data) {
+    if(data.size() % sizeof(T) != 0) {
+        throw std::runtime_error("A section of the project has an invalid size.");
+    }
+    const std::string bytes = BlockCompression::unshuffleBytes(data, sizeof(float));
+    std::vector<T> values(bytes.size() / sizeof(T));
+    if(!values.empty()) {
+        std::memcpy(values.data(), bytes.data(), bytes.size());
+    }
+    return values;
+}
+
+/// Neighbouring triangles of the spatially ordered mesh use close vertices, so the differences have small values
+std::string encodeIndices(const std::vector<std::array<size_t, 3>>& indices) {
+    std::vector<uint32_t> codes(3 * indices.size());
+    int64_t previous = 0;
+    for(size_t i = 0; i < codes.size(); ++i) {
+        const size_t index = indices[i / 3][i % 3];
+        if(index > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+            throw std::runtime_error("The project has too many vertices to be saved.");
+        }
+        const int64_t difference = static_cast<int64_t>(index) - previous;
+        previous = static_cast<int64_t>(index);
+        codes[i] = static_cast<uint32_t>(difference >= 0 ? 2 * difference : -2 * difference - 1);
+    }
+    return BlockCompression::shuffleBytes(reinterpret_cast<const char*>(codes.data()), codes.size() * sizeof(uint32_t),
+                                          sizeof(uint32_t));
+}
+
+std::vector<std::array<size_t, 3>> decodeIndices(const std::string& data, const size_t vertexCount) {
+    if(data.size() % (3 * sizeof(uint32_t)) != 0) {
+        throw std::runtime_error("The indices of the project have an invalid size.");
+    }
+    const std::string bytes = BlockCompression::unshuffleBytes(data, sizeof(uint32_t));
+    std::vector<std::array<size_t, 3>> indices(bytes.size() / (3 * sizeof(uint32_t)));
+    int64_t previous = 0;
+    for(size_t i = 0; i < 3 * indices.size(); ++i) {
+        uint32_t code;
+        std::memcpy(&code, bytes.data() + i * sizeof(uint32_t), sizeof(uint32_t));
+        const int64_t difference = (code % 2 == 0) ? int64_t(code / 2) : -int64_t(code / 2) - 1;
+        previous += difference;
+        if(previous < 0 || static_cast<size_t>(previous) >= vertexCount) {
+            throw std::runtime_error("The indices of the project refer to missing vertices.");
+        }
+        indices[i / 3][i % 3] = static_cast<size_t>(previous);
+    }
+    return indices;
+}
+
+std::string packColors(const std::vector<ColorIndex>& colors) {
+    std::string packed((colors.size() + 1) / 2, '\0');
+    for(size_t i = 0; i < colors.size(); ++i) {
+        P_ASSERT(colors[i] < 16);
+        packed[i / 2] = static_cast<char>(packed[i / 2] | (colors[i] << (4 * (i % 2))));
+    }
+    return packed;
+}
+
+std::vector<ColorIndex> unpackColors(const std::string& packed, const size_t triangleCount) {
+    if(packed.size() != (triangleCount + 1) / 2) {
+        throw std::runtime_error("The colors of the project do not match its triangles.");
+    }
+    std::vector<ColorIndex> colors(triangleCount);
+    for(size_t i = 0; i < triangleCount; ++i) {
+        colors[i] = static_cast<ColorIndex>((static_cast<unsigned char>(packed[i / 2]) >> (4 * (i % 2))) & 0xF);
+    }
+    return colors;
+}
+
+/// Are the vertices of the triangles the indexed vertices of the polyhedron, so they do not have to be saved
+bool areTrianglesIndexed(const Geometry::ProjectSnapshot& snapshot) {
+    const std::vector<glm::vec3>& triangleVertices = snapshot.triangles.getVertices();
+    if(snapshot.indices.size() != snapshot.triangles.size()) {
+        return false;
+    }
+    for(size_t i = 0; i < triangleVertices.size(); ++i) {
+        const glm::vec3& vertex = snapshot.vertices[snapshot.indices[i / 3][i % 3]];
+        if(std::memcmp(&vertex, &triangleVertices[i], sizeof(glm::vec3)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void readBytes(std::istream& is, char* data, const size_t size) {
+    if(!is.read(data, static_cast<std::streamsize>(size))) {
+        throw std::runtime_error("The project file is truncated.");
+    }
+}
+
+const Section* findSection(const std::vector<Section>& sections, const SectionType type) {
+    const auto sectionIt =
+        std::find_if(sections.begin(), sections.end(), [type](const Section& section) { return section.type == type; });
+    return sectionIt == sections.end() ? nullptr : &*sectionIt;
+}
+
+const std::string& getSectionData(const std::vector<Section>& sections, const SectionType type) {
+    const Section* section = findSection(sections, type);
+    if(section == nullptr) {
+        throw std::runtime_error("The project misses a part of the geometry.");
+    }
+    return section->data;
+}
+}  // namespace
+
+bool isProjectFile(std::istream& is) {
+    const std::istream::pos_type start = is.tellg();
+    char magic[sizeof(MAGIC)] = {};
+    is.read(magic, sizeof(magic));
+    const bool isMatching = is.gcount() == sizeof(MAGIC) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+    is.clear();
+    is.seekg(start);
+    return isMatching;
+}
+
+void write(std::ostream& os, const Geometry::ProjectSnapshot& snapshot, ::ThreadPool& threadPool) {
+    // Each section is encoded by its own task
+    std::vector<Section> sections;
+    std::vector<std::function<std::string()>> encoders;
+    const auto addSection = [&sections, &encoders](SectionType type, uint32_t part,
+                                                   std::function<std::string()> encoder) {
+        sections.push_back(Section{type, part, {}});
+        encoders.push_back(std::move(encoder));
+    };
+
+    addSection(SectionType::Palette, 0, [&snapshot]() {
+        return archiveValues(snapshot.colorManager, snapshot.colorManager.getColorOrder());
+    });
+    addSection(SectionType::Vertices, 0, [&snapshot]() { return shuffleVector(snapshot.vertices); });
+    addSection(SectionType::Indices, 0, [&snapshot]() { return encodeIndices(snapshot.indices); });
+    addSection(SectionType::Normals, 0, [&snapshot]() { return shuffleVector(snapshot.triangles.getNormals()); });
+    if(!areTrianglesIndexed(snapshot)) {
+        addSection(SectionType::TriangleVertices, 0,
+                   [&snapshot]() { return shuffleVector(snapshot.triangles.getVertices()); });
+    }
+    addSection(SectionType::Colors, 0, [&snapshot]() { return packColors(snapshot.triangles.getColors()); });
+
+    // Saving the triangles separately from the exact data, unlike TriangleDetail::save(), never modifies the details
+    uint32_t detailPart = 0;
+    for(auto groupBegin = snapshot.triangleDetails.begin(); groupBegin != snapshot.triangleDetails.end();) {
+        auto groupEnd = groupBegin;
+        for(size_t i = 0; i < DETAILS_PER_SECTION && groupEnd != snapshot.triangleDetails.end(); ++i) {
+            ++groupEnd;
+        }
+        addSection(SectionType::PolygonLazyDetails, detailPart++,
+                   [groupBegin, groupEnd]() { return saveLazyDetails(groupBegin, groupEnd); });
+        groupBegin = groupEnd;
+    }
+
+    addSection(SectionType::DerivedData, 0, [&snapshot]() {
+        const auto noSegmentations = decltype(snapshot.segmentations)();
+        return archiveValues(snapshot.computeDerivedDataHash(), snapshot.pickingTree, snapshot.faceAdjacency,
+                             snapshot.sdfValues, snapshot.sdfSettings, snapshot.sdfValuesSettings,
+                             snapshot.sdfValues.empty() ? noSegmentations : snapshot.segmentations);
+    });
+
+    std::vector<size_t> sectionIds(sections.size());
+    std::iota(sectionIds.begin(), sectionIds.end(), 0);
+    threadPool.parallel_for(
+        sectionIds.begin(), sectionIds.end(),
+        [&sections, &encoders](const size_t sectionIdx) { sections[sectionIdx].data = encoders[sectionIdx](); }, 1);
+
+    // Every section has at least one block, so that empty sections are listed too
+    std::vector<BlockEntry> entries;
+    std::vector<std::pair<const std::string*, size_t>> blockSources;
+    for(const Section& section : sections) {
+        for(size_t begin = 0; begin == 0 || begin < section.data.size(); begin += BLOCK_SIZE) {
+            const size_t rawSize = std::min(BLOCK_SIZE, section.data.size() - begin);
+            entries.push_back(BlockEntry{static_cast<uint32_t>(section.type), section.part, 0, 0, rawSize});
+            blockSources.emplace_back(&section.data, begin);
+        }
+    }
+
+    std::vector<std::string> blocks(entries.size());
+    std::vector<size_t> blockIds(entries.size());
+    std::iota(blockIds.begin(), blockIds.end(), 0);
+    threadPool.parallel_for(
+        blockIds.begin(), blockIds.end(),
+        [&entries, &blockSources, &blocks](const size_t blockIdx) {
+            std::string raw = blockSources[blockIdx].first->substr(blockSources[blockIdx].second,
+                                                                   static_cast<size_t>(entries[blockIdx].rawSize));
+            std::string compressed = BlockCompression::compress(raw);
+            blocks[blockIdx] = compressed.size() < raw.size() ? std::move(compressed) : std::move(raw);
+        },
+        1);
+
+    uint64_t offset = sizeof(Header) + entries.size() * sizeof(BlockEntry);
+    for(size_t blockIdx = 0; blockIdx < entries.size(); ++blockIdx) {
+        entries[blockIdx].offset = offset;
+        entries[blockIdx].storedSize = blocks[blockIdx].size();
+        offset += blocks[blockIdx].size();
+    }
+
+    Header header{{}, VERSION, static_cast<uint32_t>(entries.size()), 0};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    os.write(reinterpret_cast<const char*>(entries.data()),
+             static_cast<std::streamsize>(entries.size() * sizeof(BlockEntry)));
+    for(const std::string& block : blocks) {
+        os.write(block.data(), static_cast<std::streamsize>(block.size()));
+    }
+    if(!os) {
+        throw std::runtime_error("The project could not be written.");
+    }
+}
+
+Geometry::ProjectSnapshot read(std::istream& is, ::ThreadPool& threadPool) {
+    const std::istream::pos_type start = is.tellg();
+    is.seekg(0, std::ios::end);
+    const uint64_t fileSize = static_cast<uint64_t>(is.tellg() - start);
+    is.seekg(start);
+
+    if(fileSize < sizeof(Header)) {
+        throw std::runtime_error("The project file is truncated.");
+    }
+    Header header;
+    readBytes(is, reinterpret_cast<char*>(&header), sizeof(header));
+    if(std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("The file is not a Pepr3D project.");
+    }
+    if(header.version > VERSION) {
+        throw std::runtime_error("The project was saved by a newer version of Pepr3D.");
+    }
+    // The table of contents follows the header, it has to fit into the rest of the file before it is allocated
+    if(header.blockCount > (fileSize - sizeof(Header)) / sizeof(BlockEntry)) {
+        throw std::runtime_error("The project file is truncated.");
+    }
+
+    std::vector<BlockEntry> entries(header.blockCount);
+    readBytes(is, reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(BlockEntry));
+    std::vector<std::string> blocks(entries.size());
+    for(size_t blockIdx = 0; blockIdx < entries.size(); ++blockIdx) {
+        const BlockEntry& entry = entries[blockIdx];
+        if(entry.offset > fileSize || entry.storedSize > fileSize - entry.offset || entry.storedSize > entry.rawSize ||
+           entry.rawSize > entry.storedSize * MAX_COMPRESSION_RATIO + 16) {
+            throw std::runtime_error("The project file is corrupted.");
+        }
+        blocks[blockIdx].resize(static_cast<size_t>(entry.storedSize));
+        is.seekg(start + static_cast<std::streamoff>(entry.offset));
+        readBytes(is, &blocks[blockIdx][0], blocks[blockIdx].size());
+    }
+
+    std::vector<size_t> blockIds(entries.size());
+    std::iota(blockIds.begin(), blockIds.end(), 0);
+    threadPool.parallel_for(
+        blockIds.begin(), blockIds.end(),
+        [&entries, &blocks](const size_t blockIdx) {
+            if(entries[blockIdx].storedSize < entries[blockIdx].rawSize) {
+                blocks[blockIdx] =
+                    BlockCompression::decompress(blocks[blockIdx], static_cast<size_t>(entries[blockIdx].rawSize));
+            }
+        },
+        1);
+
+    // Consecutive blocks of the same type and part are joined into their section
+    std::vector<Section> sections;
+    for(size_t blockIdx = 0; blockIdx < entries.size(); ++blockIdx) {
+        const SectionType type = static_cast<SectionType>(entries[blockIdx].type);
+        if(sections.empty() || sections.back().type != type || sections.back().part != entries[blockIdx].part) {
+            sections.push_back(Section{type, entries[blockIdx].part, std::move(blocks[blockIdx])});
+        } else {
+            sections.back().data += blocks[blockIdx];
+        }
+    }
+
+    Geometry::ProjectSnapshot snapshot;
+    try {
+        std::istringstream paletteStream(getSectionData(sections, SectionType::Palette), std::ios::binary);
+        cereal::BinaryInputArchive paletteArchive(paletteStream);
+        std::vector<size_t> order;
+        paletteArchive(snapshot.colorManager, order);
+        snapshot.colorManager.setColorOrder(order);
+    } catch(const cereal::Exception&) {
+        throw std::runtime_error("The palette of the project is corrupted.");
+    }
+
+    snapshot.vertices = unshuffleVector<glm::vec3>(getSectionData(sections, SectionType::Vertices));
+    snapshot.indices = decodeIndices(getSectionData(sections, SectionType::Indices), snapshot.vertices.size());
+    std::vector<glm::vec3> normals = unshuffleVector<glm::vec3>(getSectionData(sections, SectionType::Normals));
+    std::vector<ColorIndex> colors = unpackColors(getSectionData(sections, SectionType::Colors), normals.size());
+    std::vector<glm::vec3> triangleVertices;
+    if(const Section* section = findSection(sections, SectionType::TriangleVertices)) {
+        triangleVertices = unshuffleVector<glm::vec3>(section->data);
+    } else if(snapshot.indices.size() == normals.size()) {
+        triangleVertices.reserve(3 * snapshot.indices.size());
+        for(const std::array<size_t, 3>& triangle : snapshot.indices) {
+            for(const size_t vertexIdx : triangle) {
+                triangleVertices.push_back(snapshot.vertices[vertexIdx]);
+            }
+        }
+    }
+    if(triangleVertices.size() != 3 * normals.size()) {
+        throw std::runtime_error("The vertices of the project do not match its triangles.");
+    }
+    snapshot.triangles.assign(std::move(triangleVertices), std::move(normals), std::move(colors));
+
+    std::vector<const Section*> detailSections;
+    for(const Section& section : sections) {
+        if(section.type == SectionType::Details || section.type == SectionType::LazyDetails ||
+           section.type == SectionType::PolygonLazyDetails) {
+            detailSections.push_back(&section);
+        }
+    }
+    std::vector<DetailMap> detailGroups(detailSections.size());
+    std::vector<size_t> detailIds(detailSections.size());
+    std::iota(detailIds.begin(), detailIds.end(), 0);
+    threadPool.parallel_for(
+        detailIds.begin(), detailIds.end(),
+        [&detailSections, &detailGroups](const size_t groupIdx) {
+            const Section& section = *detailSections[groupIdx];
+            if(section.type == SectionType::LazyDetails || section.type == SectionType::PolygonLazyDetails) {
+                detailGroups[groupIdx] = loadLazyDetails(section.data, section.type == SectionType::LazyDetails);
+                return;
+            }
+            // Version 2 has only the exact data, the details are triangulated here
+            std::istringstream detailStream(section.data, std::ios::binary);
+            cereal::BinaryInputArchive detailArchive(detailStream);
+            detailArchive(detailGroups[groupIdx]);
+        },
+        1);
+    for(DetailMap& group : detailGroups) {
+        for(auto& detail : group) {
+            if(detail.first >= snapshot.triangles.size()) {
+                throw std::runtime_error("The project has a detail of a missing triangle.");
+            }
+        }
+        snapshot.triangleDetails.merge(group);
+    }
+
+    // The derived data is recomputed if it cannot be read
+    if(const Section* section = findSection(sections, SectionType::DerivedData)) {
+        try {
+            std::istringstream derivedStream(section->data, std::ios::binary);
+            cereal::BinaryInputArchive derivedArchive(derivedStream);
+            uint64_t hash;
+            derivedArchive(hash, snapshot.pickingTree, snapshot.faceAdjacency, snapshot.sdfValues,
+                           snapshot.sdfSettings, snapshot.sdfValuesSettings, snapshot.segmentations);
+            snapshot.derivedDataHash = hash;
+        } catch(const cereal::Exception&) {
+            snapshot.pickingTree.clear();
+            snapshot.faceAdjacency.clear();
+            snapshot.sdfValues.clear();
+            snapshot.segmentations.clear();
+        }
+    }
+    return snapshot;
+}
+
+}  // namespace ProjectFile
+}  // namespace pepr3d
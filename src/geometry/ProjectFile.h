@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+#include "ThreadPool.h"
+#include "geometry/Geometry.h"
+
+namespace pepr3d {
+
+/// Container of the .p3d projects since version 2, older projects are a single cereal archive of the Geometry.
+/// The file is a header, a table of contents and the sections it lists. Each section is a part of the project:
+/// the palette, the indexed vertices, the normals, the colors packed to 4 bits, groups of the triangle details and
+/// the optional derived data. A section is split into blocks compressed on their own by BlockCompression, so the
+/// blocks are compressed and decompressed in parallel and a section can be read without the others.
+/// The triangle details are read without their exact data, see TriangleDetail::loadLazy().
+/// The numbers are written in the byte order of the host, little endian on all supported platforms.
+namespace ProjectFile {
+
+/// Version of the container, written after the magic bytes
+const uint32_t VERSION = 4;
+
+/// Kinds of the sections, readers skip the kinds they do not know
+enum class SectionType : uint32_t {
+    /// Cereal archive of the ColorManager and the order of its colors
+    Palette = 1,
+    /// Vertices of the polyhedron, the bytes of the floats shuffled
+    Vertices = 2,
+    /// Differences of consecutive vertex indices of the polyhedron triangles, zigzag encoded and shuffled
+    Indices = 3,
+    /// Normal of each triangle, the bytes of the floats shuffled
+    Normals = 4,
+    /// Vertices of each triangle, only when they are not the indexed vertices of the polyhedron
+    TriangleVertices = 5,
+    /// Color of each triangle in 4 bits, two triangles per byte
+    Colors = 6,
+    /// Cereal archive of a group of the triangle details with only their polygons, written by version 2
+    Details = 7,
+    /// Cereal archive of the data computed from the geometry, recomputed if missing or not matching
+    DerivedData = 8,
+    /// Group of the triangle details, the triangles of each followed by its exact data with the exact triangles,
+    /// written by version 3, see TriangleDetail::loadLazyWithExactTriangles(). Each group is a separate stream.
+    LazyDetails = 9,
+    /// Group of the triangle details like LazyDetails, without the exact triangles, see TriangleDetail::saveLazy()
+    PolygonLazyDetails = 10
+};
+
+/// Is the stream a project in this container, does not move the position of the stream
+bool isProjectFile(std::istream& is);
+
+/// Write the project, throws std::runtime_error if the stream fails
+void write(std::ostream& os, const Geometry::ProjectSnapshot& snapshot, ::ThreadPool& threadPool);
+
+/// Read a project written by write(), throws std::runtime_error if it is corrupted.
+/// The derived data hash of the snapshot is set if the project has its derived data.
+Geometry::ProjectSnapshot read(std::istream& is, ::ThreadPool& threadPool);
+
+}  // namespace ProjectFile
+
+}  // namespace pepr3d
@@ -0,0 +1,138 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <cereal/archives/binary.hpp>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "geometry/ProjectFile.h"
+
+namespace pepr3d {
+
+namespace {
+/// Snapshot of a grid of quads, each triangle with the indexed vertices of the polyhedron and one of the colors
+Geometry::ProjectSnapshot getGridSnapshot(const size_t size) {
+    Geometry::ProjectSnapshot snapshot;
+    for(size_t y = 0; y <= size; ++y) {
+        for(size_t x = 0; x <= size; ++x) {
+            snapshot.vertices.emplace_back(static_cast<float>(x), static_cast<float>(y), 0.1f * static_cast<float>(x));
+        }
+    }
+
+    std::vector<glm::vec3> triangleVertices;
+    std::vector<glm::vec3> normals;
+    std::vector<ColorIndex> colors;
+    for(size_t y = 0; y < size; ++y) {
+        for(size_t x = 0; x < size; ++x) {
+            const size_t corner = y * (size + 1) + x;
+            snapshot.indices.push_back({corner, corner + 1, corner + size + 1});
+            snapshot.indices.push_back({corner + 1, corner + size + 2, corner + size + 1});
+        }
+    }
+    for(const std::array<size_t, 3>& triangle : snapshot.indices) {
+        for(const size_t vertexIdx : triangle) {
+            triangleVertices.push_back(snapshot.vertices[vertexIdx]);
+        }
+        normals.emplace_back(0, 0, 1);
+        colors.push_back(static_cast<ColorIndex>(normals.size() % snapshot.colorManager.size()));
+    }
+    snapshot.triangles.assign(std::move(triangleVertices), std::move(normals), std::move(colors));
+    return snapshot;
+}
+}  // namespace
+
+TEST(ProjectFile, roundTrip) {
+    /**
+     * Test that the geometry and the palette of a project read back exactly as they were written
+     */
+
+    ::ThreadPool threadPool(2);
+    Geometry::ProjectSnapshot snapshot = getGridSnapshot(50);
+    snapshot.colorManager.setColorOrder({3, 2, 1, 0});
+
+    std::stringstream file(std::ios::in | std::ios::out | std::ios::binary);
+    ProjectFile::write(file, snapshot, threadPool);
+    ASSERT_TRUE(ProjectFile::isProjectFile(file));
+
+    // The triangles are built from the indexed vertices, so only the indices and the vertices are stored
+    const size_t rawSize =
+        snapshot.vertices.size() * sizeof(glm::vec3) + snapshot.triangles.size() * sizeof(glm::vec3) * 4;
+    EXPECT_LT(file.str().size(), rawSize / 2);
+
+    const Geometry::ProjectSnapshot loaded = ProjectFile::read(file, threadPool);
+    EXPECT_EQ(loaded.vertices, snapshot.vertices);
+    EXPECT_EQ(loaded.indices, snapshot.indices);
+    EXPECT_EQ(loaded.triangles.getVertices(), snapshot.triangles.getVertices());
+    EXPECT_EQ(loaded.triangles.getNormals(), snapshot.triangles.getNormals());
+    EXPECT_EQ(loaded.triangles.getColors(), snapshot.triangles.getColors());
+    EXPECT_EQ(loaded.colorManager.size(), snapshot.colorManager.size());
+    EXPECT_EQ(loaded.colorManager.getColorOrder(), snapshot.colorManager.getColorOrder());
+    EXPECT_TRUE(loaded.triangleDetails.empty());
+    ASSERT_TRUE(loaded.derivedDataHash.has_value());
+    EXPECT_EQ(*loaded.derivedDataHash, snapshot.computeDerivedDataHash());
+}
+
+TEST(ProjectFile, triangleVertices) {
+    /**
+     * Test that triangles which differ from the indexed vertices are stored on their own
+     */
+
+    ::ThreadPool threadPool(2);
+    Geometry::ProjectSnapshot snapshot = getGridSnapshot(4);
+    std::vector<glm::vec3> triangleVertices = snapshot.triangles.getVertices();
+    triangleVertices[5] += glm::vec3(0.001f, 0, 0);
+    std::vector<glm::vec3> normals = snapshot.triangles.getNormals();
+    std::vector<ColorIndex> colors = snapshot.triangles.getColors();
+    snapshot.triangles.assign(std::move(triangleVertices), std::move(normals), std::move(colors));
+
+    std::stringstream file(std::ios::in | std::ios::out | std::ios::binary);
+    ProjectFile::write(file, snapshot, threadPool);
+    const Geometry::ProjectSnapshot loaded = ProjectFile::read(file, threadPool);
+    EXPECT_EQ(loaded.triangles.getVertices(), snapshot.triangles.getVertices());
+    EXPECT_EQ(loaded.vertices, snapshot.vertices);
+}
+
+TEST(ProjectFile, corruptedFile) {
+    /**
+     * Test that older projects are not taken for the container and that truncated or damaged files are rejected
+     */
+
+    ::ThreadPool threadPool(2);
+    std::stringstream legacyFile(std::ios::in | std::ios::out | std::ios::binary);
+    {
+        cereal::BinaryOutputArchive saveArchive(legacyFile);
+        saveArchive(uint32_t(0x80000001));
+    }
+    EXPECT_FALSE(ProjectFile::isProjectFile(legacyFile));
+    EXPECT_EQ(legacyFile.tellg(), 0);
+
+    std::stringstream file(std::ios::in | std::ios::out | std::ios::binary);
+    ProjectFile::write(file, getGridSnapshot(10), threadPool);
+    const std::string bytes = file.str();
+
+    std::stringstream truncatedFile(bytes.substr(0, bytes.size() - 7), std::ios::in | std::ios::binary);
+    EXPECT_THROW(ProjectFile::read(truncatedFile, threadPool), std::runtime_error);
+
+    std::stringstream headerlessFile(bytes.substr(0, 10), std::ios::in | std::ios::binary);
+    EXPECT_THROW(ProjectFile::read(headerlessFile, threadPool), std::runtime_error);
+
+    // The table of contents is longer than the file after the header, though not longer than the whole file
+    std::string tableBytes = bytes.substr(0, 16 + 2 * 32 + 16);
+    const uint32_t blockCount = 3;
+    std::memcpy(&tableBytes[8], &blockCount, sizeof(blockCount));
+    std::stringstream tableFile(tableBytes, std::ios::in | std::ios::binary);
+    EXPECT_THROW(ProjectFile::read(tableFile, threadPool), std::runtime_error);
+
+    std::string damagedBytes = bytes;
+    damagedBytes[4] = static_cast<char>(ProjectFile::VERSION + 1);
+    std::stringstream damagedFile(damagedBytes, std::ios::in | std::ios::binary);
+    EXPECT_THROW(ProjectFile::read(damagedFile, threadPool), std::runtime_error);
+}
+
+}  // namespace pepr3d
+
+#endif
@@ -0,0 +1,64 @@
+#include "geometry/RegionFill.h"
+
+#include "peprassert.h"
+
+namespace pepr3d {
+
+RegionFill::RegionFill(std::vector<std::array<uint32_t, 3>> neighbours,
+                       std::vector<std::array<float, 3>> neighbourCosines, const std::vector<glm::vec3>& normals)
+    : mNeighbours(std::move(neighbours)), mNeighbourCosines(std::move(neighbourCosines)) {
+    P_ASSERT(mNeighbours.size() == mNeighbourCosines.size());
+    P_ASSERT(mNeighbours.size() == normals.size());
+    mNormals.reserve(normals.size());
+    for(const glm::vec3& normal : normals) {
+        mNormals.push_back(glm::normalize(normal));
+    }
+}
+
+std::optional<std::vector<size_t>> RegionFill::fill(const size_t startTriangle,
+                                                    const std::vector<TriangleStore::PackedColorChunk>& colors,
+                                                    const Criteria& criteria,
+                                                    const std::atomic<bool>* isCancelled) const {
+    if(startTriangle >= mNeighbours.size()) {
+        return std::vector<size_t>();
+    }
+    const ColorIndex startColor = TriangleStore::getPackedColor(colors, startTriangle);
+    const glm::vec3 startNormal = mNormals[startTriangle];
+
+    // The same conditions as the stopping functors of the Paint Bucket
+    const auto canSpread = [&](const size_t triangle, const int edge, const size_t neighbour) {
+        if(criteria.stopOnColor && TriangleStore::getPackedColor(colors, neighbour) != startColor) {
+            return false;
+        }
+        if(criteria.stopOnNormal) {
+            const float cosAngle = criteria.compareWithStart ? glm::dot(mNormals[neighbour], startNormal)
+                                                             : mNeighbourCosines[triangle][edge];
+            if(cosAngle < criteria.minCosine) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // The queue is never popped, it ends up holding all reached triangles in order
+    std::vector<bool> isReached(mNeighbours.size(), false);
+    std::vector<size_t> reached{startTriangle};
+    isReached[startTriangle] = true;
+    for(size_t head = 0; head < reached.size(); ++head) {
+        if(isCancelled != nullptr && head % CANCEL_CHECK_TRIANGLES == 0 && *isCancelled) {
+            return std::nullopt;
+        }
+        const size_t triangle = reached[head];
+        for(int edge = 0; edge < 3; ++edge) {
+            const uint32_t neighbour = mNeighbours[triangle][edge];
+            if(neighbour == NO_NEIGHBOUR || isReached[neighbour] || !canSpread(triangle, edge, neighbour)) {
+                continue;
+            }
+            isReached[neighbour] = true;
+            reached.push_back(neighbour);
+        }
+    }
+    return reached;
+}
+
+}  // namespace pepr3d
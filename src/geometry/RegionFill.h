@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include "geometry/TriangleStore.h"
+
+namespace pepr3d {
+
+/// Flood fill over the base triangles of a mesh with the criteria of the Paint Bucket, e.g., for its live preview.
+/// The fill owns copies of the topology of the mesh and gets the colors as immutable chunks, so it can run on a
+/// worker thread while the Geometry is painted. It does not see the triangle details, a triangle split into details
+/// is filled by the color of its base triangle.
+/// All methods can be called from several threads at once.
+class RegionFill {
+   public:
+    /// Border edges have no neighbour
+    static constexpr uint32_t NO_NEIGHBOUR = std::numeric_limits<uint32_t>::max();
+
+    /// Number of triangles filled between the checks of the cancellation
+    static const size_t CANCEL_CHECK_TRIANGLES = 4096;
+
+    /// When the fill stops spreading, without any criterion it covers the whole connected component
+    struct Criteria {
+        bool stopOnColor = false;
+        bool stopOnNormal = false;
+
+        /// Cosine of the largest angle between the normals the fill passes, if it stops on normals
+        float minCosine = -1.f;
+
+        /// Compare the normals with the start triangle instead of the neighbour the fill comes from
+        bool compareWithStart = false;
+
+        bool operator==(const Criteria& other) const {
+            return stopOnColor == other.stopOnColor && stopOnNormal == other.stopOnNormal &&
+                   minCosine == other.minCosine && compareWithStart == other.compareWithStart;
+        }
+    };
+
+    /// @param neighbours Triangles across the 3 edges of each triangle, NO_NEIGHBOUR for border edges
+    /// @param neighbourCosines Cosines of the angles between the normals of each triangle and its neighbours
+    /// @param normals Normal of each triangle
+    RegionFill(std::vector<std::array<uint32_t, 3>> neighbours, std::vector<std::array<float, 3>> neighbourCosines,
+               const std::vector<glm::vec3>& normals);
+
+    size_t getTriangleCount() const {
+        return mNeighbours.size();
+    }
+
+    /// Triangles reached from the start triangle, in the order they were reached, empty if cancelled
+    /// @param colors Colors of the triangles, see Geometry::getPackedTriangleColors()
+    /// @param isCancelled Checked every CANCEL_CHECK_TRIANGLES triangles, if not null
+    std::optional<std::vector<size_t>> fill(size_t startTriangle,
+                                            const std::vector<TriangleStore::PackedColorChunk>& colors,
+                                            const Criteria& criteria,
+                                            const std::atomic<bool>* isCancelled = nullptr) const;
+
+   private:
+    std::vector<std::array<uint32_t, 3>> mNeighbours;
+    std::vector<std::array<float, 3>> mNeighbourCosines;
+
+    /// Normalized normal of each triangle
+    std::vector<glm::vec3> mNormals;
+};
+
+}  // namespace pepr3d
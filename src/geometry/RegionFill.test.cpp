@@ -0,0 +1,68 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <array>
+#include <atomic>
+#include <vector>
+
+#include "geometry/RegionFill.h"
+
+namespace {
+/// Strip of 4 triangles, each a neighbour of the next one, bent by 60 degrees between triangles 1, 2 and 3.
+/// The last triangle has color 1, the others color 0.
+struct Strip {
+    std::vector<pepr3d::DataTriangle> triangles;
+    std::vector<std::array<uint32_t, 3>> neighbours;
+    std::vector<std::array<float, 3>> neighbourCosines;
+    std::vector<glm::vec3> normals;
+
+    Strip() {
+        const uint32_t none = pepr3d::RegionFill::NO_NEIGHBOUR;
+        normals = {glm::vec3(0, 0, 1), glm::vec3(0, 0, 1), glm::vec3(0, 0.866025f, 0.5f),
+                   glm::vec3(0, 0.866025f, -0.5f)};
+        neighbours = {{1, none, none}, {0, 2, none}, {1, 3, none}, {2, none, none}};
+        neighbourCosines = {{1.f, 1.f, 1.f}, {1.f, 0.5f, 1.f}, {0.5f, 0.5f, 1.f}, {0.5f, 1.f, 1.f}};
+        for(size_t triIdx = 0; triIdx < normals.size(); ++triIdx) {
+            const glm::vec3 offset(static_cast<float>(triIdx), 0, 0);
+            triangles.emplace_back(offset, offset + glm::vec3(1, 0, 0), offset + glm::vec3(0, 1, 0), normals[triIdx],
+                                   triIdx == 3 ? 1 : 0);
+        }
+    }
+};
+}  // namespace
+
+TEST(RegionFill, criteria) {
+    /**
+     * Test that the fill stops on the colors and the angles like the Paint Bucket, and spreads over the whole
+     * component without any criterion
+     */
+
+    const Strip strip;
+    const pepr3d::RegionFill regionFill(strip.neighbours, strip.neighbourCosines, strip.normals);
+    const pepr3d::TriangleStore store(strip.triangles);
+    const auto colors = store.getPackedColorChunks();
+    ASSERT_EQ(regionFill.getTriangleCount(), 4);
+
+    pepr3d::RegionFill::Criteria criteria;
+    EXPECT_EQ(*regionFill.fill(0, colors, criteria), std::vector<size_t>({0, 1, 2, 3}));
+
+    criteria.stopOnColor = true;
+    EXPECT_EQ(*regionFill.fill(0, colors, criteria), std::vector<size_t>({0, 1, 2}));
+    EXPECT_EQ(*regionFill.fill(3, colors, criteria), std::vector<size_t>({3}));
+
+    criteria.stopOnColor = false;
+    criteria.stopOnNormal = true;
+    criteria.minCosine = 0.7f;
+    EXPECT_EQ(*regionFill.fill(0, colors, criteria), std::vector<size_t>({0, 1}));
+
+    // Each bend is passed, but the last triangle is turned by 120 degrees from the start
+    criteria.minCosine = 0.4f;
+    EXPECT_EQ(*regionFill.fill(0, colors, criteria), std::vector<size_t>({0, 1, 2, 3}));
+    criteria.compareWithStart = true;
+    EXPECT_EQ(*regionFill.fill(0, colors, criteria), std::vector<size_t>({0, 1, 2}));
+
+    const std::atomic<bool> isCancelled(true);
+    EXPECT_FALSE(regionFill.fill(0, colors, criteria, &isCancelled).has_value());
+}
+
+#endif
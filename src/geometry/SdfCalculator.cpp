@@ -0,0 +1,361 @@
+#include "geometry/SdfCalculator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+
+#include "ThreadPool.h"
+#include "geometry/SdfGpuCalculator.h"
+#include "geometry/TriangleBvh.h"
+#include "peprassert.h"
+
+namespace pepr3d {
+
+namespace {
+/// Number of triangles processed together by one task
+const size_t CHUNK_SIZE = 256;
+
+/// Part of the progress taken by casting the rays, the rest is the postprocessing
+const float RAY_PROGRESS = 0.9f;
+
+double gaussian(const double value, const double deviation) {
+    return std::exp(-0.5 * (value / deviation) * (value / deviation));
+}
+
+bool isSet(const std::atomic<bool>* flag) {
+    return flag != nullptr && flag->load(std::memory_order_relaxed);
+}
+
+/// Call f(begin, end) for the chunks of [0, count) on the thread pool, chunks not started yet are skipped once
+/// isCancelled is set
+template <typename Func>
+void parallelForChunks(const size_t count, ::ThreadPool& threadPool, const std::atomic<bool>* isCancelled,
+                       const Func& f) {
+    std::vector<size_t> chunkBegins((count + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    for(size_t chunkIdx = 0; chunkIdx < chunkBegins.size(); ++chunkIdx) {
+        chunkBegins[chunkIdx] = chunkIdx * CHUNK_SIZE;
+    }
+    threadPool.parallel_for(chunkBegins.begin(), chunkBegins.end(),
+                            [count, isCancelled, &f](const size_t begin) {
+                                if(!isSet(isCancelled)) {
+                                    f(begin, std::min(count, begin + CHUNK_SIZE));
+                                }
+                            },
+                            1);
+}
+}  // namespace
+
+SdfCalculator::SdfCalculator(const TriangleBvh& bvh, const std::vector<glm::vec3>& vertices,
+                             const std::vector<std::array<uint32_t, 3>>& neighbours)
+    : mBvh(bvh), mVertices(vertices), mNeighbours(neighbours) {
+    P_ASSERT(mVertices.size() % 3 == 0);
+    P_ASSERT(mNeighbours.size() == mVertices.size() / 3);
+    P_ASSERT(mBvh.size() == mVertices.size() / 3);
+
+    mNormals.resize(mVertices.size() / 3);
+    glm::vec3 boxMin(std::numeric_limits<float>::max());
+    glm::vec3 boxMax(std::numeric_limits<float>::lowest());
+    for(size_t triangleIdx = 0; triangleIdx < mNormals.size(); ++triangleIdx) {
+        const glm::vec3& a = mVertices[3 * triangleIdx];
+        const glm::vec3& b = mVertices[3 * triangleIdx + 1];
+        const glm::vec3& c = mVertices[3 * triangleIdx + 2];
+        const glm::vec3 normal = glm::cross(b - a, c - a);
+        const float length = glm::length(normal);
+        mNormals[triangleIdx] = length > 0.f ? normal * (1.f / length) : glm::vec3(0.f);
+        for(const glm::vec3& vertex : {a, b, c}) {
+            boxMin = glm::min(boxMin, vertex);
+            boxMax = glm::max(boxMax, vertex);
+        }
+    }
+
+    // Far enough for the float precision of the triangle planes, negligible compared to the thickness
+    if(!mNormals.empty()) {
+        mRayOffset = 1e-5f * glm::length(boxMax - boxMin);
+    }
+}
+
+std::optional<std::pair<double, double>> SdfCalculator::compute(const SdfSettings& settings,
+                                                                std::vector<double>& values, ::ThreadPool& threadPool,
+                                                                std::atomic<float>* progress,
+                                                                const std::atomic<bool>* isCancelled) const {
+    const size_t triangleCount = mNormals.size();
+    values.assign(triangleCount, 0.0);
+    if(triangleCount == 0) {
+        return std::make_pair(0.0, 0.0);
+    }
+
+    const std::vector<DiskSample> samples = sampleDisk(std::max(settings.rayCount, 1));
+    const float coneTangent = std::tan(0.5f * settings.coneAngle);
+
+    std::vector<char> hasValue(triangleCount, 0);
+    const bool isTracedOnGpu = mGpuCalculator != nullptr &&
+                               computeValuesOnGpu(samples, coneTangent, values, hasValue, threadPool, progress,
+                                                  isCancelled);
+    if(isSet(isCancelled)) {
+        return {};
+    }
+
+    if(!isTracedOnGpu) {
+        std::atomic<size_t> finishedTriangles{0};
+        parallelForChunks(triangleCount, threadPool, isCancelled, [&](const size_t begin, const size_t end) {
+            std::vector<glm::vec3> origins;
+            std::vector<glm::vec3> directions;
+            std::vector<std::pair<double, double>> distances;
+            for(size_t triangleIdx = begin; triangleIdx < end; ++triangleIdx) {
+                const std::optional<double> value =
+                    computeTriangleValue(triangleIdx, samples, coneTangent, origins, directions, distances);
+                if(value) {
+                    values[triangleIdx] = *value;
+                    hasValue[triangleIdx] = 1;
+                }
+            }
+            const size_t finished = finishedTriangles.fetch_add(end - begin) + end - begin;
+            if(progress != nullptr) {
+                *progress = RAY_PROGRESS * static_cast<float>(finished) / static_cast<float>(triangleCount);
+            }
+        });
+
+        if(isSet(isCancelled)) {
+            return {};
+        }
+    }
+
+    fillMissingValues(values, hasValue);
+    values = smoothValues(values, threadPool, isCancelled);
+    if(isSet(isCancelled)) {
+        return {};
+    }
+
+    const auto minMax = std::minmax_element(values.begin(), values.end());
+    const double minValue = *minMax.first;
+    const double maxValue = *minMax.second;
+    if(minValue < maxValue) {
+        for(double& value : values) {
+            value = (value - minValue) / (maxValue - minValue);
+        }
+    }
+
+    if(progress != nullptr) {
+        *progress = 1.f;
+    }
+    return std::make_pair(minValue, maxValue);
+}
+
+std::optional<double> SdfCalculator::robustAverage(std::vector<std::pair<double, double>>& distances) {
+    if(distances.empty()) {
+        return {};
+    }
+    if(distances.size() == 1) {
+        return distances.front().first;
+    }
+
+    // Median of the distances
+    const size_t half = distances.size() / 2;
+    std::nth_element(distances.begin(), distances.begin() + half, distances.end());
+    double median = distances[half].first;
+    if(distances.size() % 2 == 0) {
+        median = 0.5 * (median + std::max_element(distances.begin(), distances.begin() + half)->first);
+    }
+
+    double deviation = 0.0;
+    for(const auto& distance : distances) {
+        deviation += (distance.first - median) * (distance.first - median);
+    }
+    deviation = std::sqrt(deviation / static_cast<double>(distances.size()));
+
+    double totalDistance = 0.0;
+    double totalWeight = 0.0;
+    for(const auto& distance : distances) {
+        if(std::abs(distance.first - median) <= 1.5 * deviation) {
+            totalDistance += distance.first * distance.second;
+            totalWeight += distance.second;
+        }
+    }
+    if(totalDistance == 0.0) {
+        return median;
+    }
+    return totalDistance / totalWeight;
+}
+
+std::vector<SdfCalculator::DiskSample> SdfCalculator::sampleDisk(const int sampleCount) {
+    // Golden angle, consecutive samples never line up
+    const double goldenAngle = (3.0 - std::sqrt(5.0)) * glm::pi<double>();
+    std::vector<DiskSample> samples;
+    samples.reserve(sampleCount);
+    for(int i = 0; i < sampleCount; ++i) {
+        const double angle = i * goldenAngle;
+        const double radius = static_cast<double>(i) / sampleCount;
+        samples.push_back(DiskSample{static_cast<float>(radius * std::cos(angle)),
+                                     static_cast<float>(radius * std::sin(angle)), 1.f});
+    }
+    return samples;
+}
+
+std::optional<double> SdfCalculator::computeTriangleValue(const size_t triangleIdx,
+                                                          const std::vector<DiskSample>& samples,
+                                                          const float coneTangent, std::vector<glm::vec3>& origins,
+                                                          std::vector<glm::vec3>& directions,
+                                                          std::vector<std::pair<double, double>>& distances) const {
+    const glm::vec3 inside = -mNormals[triangleIdx];
+    if(inside == glm::vec3(0.f)) {
+        return {};
+    }
+    const glm::vec3 centroid =
+        (mVertices[3 * triangleIdx] + mVertices[3 * triangleIdx + 1] + mVertices[3 * triangleIdx + 2]) * (1.f / 3.f);
+
+    // Orthonormal base of the disk at the tip of the cone
+    const glm::vec3 helper = std::abs(inside.x) < 0.9f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f);
+    const glm::vec3 diskX = glm::normalize(glm::cross(inside, helper));
+    const glm::vec3 diskY = glm::cross(inside, diskX);
+
+    origins.clear();
+    directions.clear();
+    for(const DiskSample& sample : samples) {
+        const glm::vec3 direction =
+            glm::normalize(inside + diskX * (sample.x * coneTangent) + diskY * (sample.y * coneTangent));
+        origins.push_back(centroid + direction * mRayOffset);
+        directions.push_back(direction);
+    }
+
+    // Rays of one triangle are coherent, the packet traversal shares the nodes between them
+    const std::vector<std::optional<TriangleBvh::Hit>> hits = mBvh.intersect(origins, directions);
+
+    distances.clear();
+    for(size_t rayIdx = 0; rayIdx < hits.size(); ++rayIdx) {
+        const auto& hit = hits[rayIdx];
+        // Only count rays reaching the other side from the inside, the hit triangle faces away from the ray
+        if(!hit || hit->triangleIdx == triangleIdx || glm::dot(mNormals[hit->triangleIdx], directions[rayIdx]) <= 0.f) {
+            continue;
+        }
+        distances.emplace_back(static_cast<double>(hit->distance + mRayOffset), samples[rayIdx].weight);
+    }
+    return robustAverage(distances);
+}
+
+bool SdfCalculator::computeValuesOnGpu(const std::vector<DiskSample>& samples, const float coneTangent,
+                                       std::vector<double>& values, std::vector<char>& hasValue,
+                                       ::ThreadPool& threadPool, std::atomic<float>* progress,
+                                       const std::atomic<bool>* isCancelled) const {
+    std::vector<glm::vec2> diskPoints;
+    diskPoints.reserve(samples.size());
+    for(const DiskSample& sample : samples) {
+        diskPoints.emplace_back(sample.x, sample.y);
+    }
+    const auto onProgress = [progress](const float finished) {
+        if(progress != nullptr) {
+            *progress = RAY_PROGRESS * finished;
+        }
+    };
+    const std::vector<float> rayDistances = mGpuCalculator->traceRays(
+        mBvh, mVertices, mNormals, diskPoints, coneTangent, mRayOffset, threadPool, onProgress, isCancelled);
+    if(rayDistances.empty()) {
+        return false;
+    }
+
+    // The rays are averaged as on the CPU, rays that did not reach the other side are negative
+    const size_t rayCount = samples.size();
+    parallelForChunks(values.size(), threadPool, isCancelled, [&](const size_t begin, const size_t end) {
+        std::vector<std::pair<double, double>> distances;
+        for(size_t triangleIdx = begin; triangleIdx < end; ++triangleIdx) {
+            distances.clear();
+            for(size_t rayIdx = 0; rayIdx < rayCount; ++rayIdx) {
+                const float distance = rayDistances[triangleIdx * rayCount + rayIdx];
+                if(distance >= 0.f) {
+                    distances.emplace_back(static_cast<double>(distance), samples[rayIdx].weight);
+                }
+            }
+            const std::optional<double> value = robustAverage(distances);
+            if(value) {
+                values[triangleIdx] = *value;
+                hasValue[triangleIdx] = 1;
+            }
+        }
+    });
+    return true;
+}
+
+void SdfCalculator::fillMissingValues(std::vector<double>& values, std::vector<char>& hasValue) const {
+    // Values spread from the neighbours, a triangle may need several passes to get one
+    bool isMissing = true;
+    bool hasChanged = true;
+    while(isMissing && hasChanged) {
+        isMissing = false;
+        hasChanged = false;
+        for(size_t triangleIdx = 0; triangleIdx < values.size(); ++triangleIdx) {
+            if(hasValue[triangleIdx]) {
+                continue;
+            }
+            double total = 0.0;
+            size_t count = 0;
+            for(const uint32_t neighbour : mNeighbours[triangleIdx]) {
+                if(neighbour != NO_NEIGHBOUR && hasValue[neighbour]) {
+                    total += values[neighbour];
+                    ++count;
+                }
+            }
+            if(count > 0) {
+                values[triangleIdx] = total / static_cast<double>(count);
+                hasValue[triangleIdx] = 1;
+                hasChanged = true;
+            } else {
+                isMissing = true;
+            }
+        }
+    }
+    // Components without any value keep 0
+}
+
+std::vector<double> SdfCalculator::smoothValues(const std::vector<double>& values, ::ThreadPool& threadPool,
+                                                const std::atomic<bool>* isCancelled) const {
+    const size_t triangleCount = values.size();
+    // Number of rings of neighbours, grows with the resolution of the mesh
+    const size_t windowSize = static_cast<size_t>(std::sqrt(static_cast<double>(triangleCount) / 2000.0)) + 1;
+    const double spatialDeviation = 0.5 * static_cast<double>(windowSize);
+
+    std::vector<double> smoothed(triangleCount);
+    parallelForChunks(triangleCount, threadPool, isCancelled, [&](const size_t begin, const size_t end) {
+        std::unordered_set<uint32_t> visited;
+        std::vector<std::pair<uint32_t, uint32_t>> neighbourhood;  // triangle and its ring
+        for(size_t triangleIdx = begin; triangleIdx < end; ++triangleIdx) {
+            visited.clear();
+            neighbourhood.clear();
+            visited.insert(static_cast<uint32_t>(triangleIdx));
+            neighbourhood.emplace_back(static_cast<uint32_t>(triangleIdx), 0);
+            for(size_t head = 0; head < neighbourhood.size(); ++head) {
+                const auto current = neighbourhood[head];
+                if(current.second >= windowSize) {
+                    continue;
+                }
+                for(const uint32_t neighbour : mNeighbours[current.first]) {
+                    if(neighbour != NO_NEIGHBOUR && visited.insert(neighbour).second) {
+                        neighbourhood.emplace_back(neighbour, current.second + 1);
+                    }
+                }
+            }
+
+            const double currentValue = values[triangleIdx];
+            double deviation = 0.0;
+            for(const auto& neighbour : neighbourhood) {
+                deviation += (values[neighbour.first] - currentValue) * (values[neighbour.first] - currentValue);
+            }
+            deviation = std::sqrt(deviation / static_cast<double>(neighbourhood.size()));
+            if(deviation == 0.0) {
+                deviation = std::numeric_limits<double>::epsilon();
+            }
+
+            double totalValue = 0.0;
+            double totalWeight = 0.0;
+            for(const auto& neighbour : neighbourhood) {
+                const double value = values[neighbour.first];
+                const double weight = gaussian(static_cast<double>(neighbour.second), spatialDeviation) *
+                                      gaussian(value - currentValue, 1.5 * deviation);
+                totalValue += value * weight;
+                totalWeight += weight;
+            }
+            smoothed[triangleIdx] = totalValue / totalWeight;
+        }
+    });
+    return smoothed;
+}
+
+}  // namespace pepr3d
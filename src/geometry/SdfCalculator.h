@@ -0,0 +1,115 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+class ThreadPool;
+
+namespace pepr3d {
+
+class SdfGpuCalculator;
+class TriangleBvh;
+
+/// Quality settings of the shape diameter function
+struct SdfSettings {
+    /// Number of rays cast from each triangle
+    int rayCount = 25;
+
+    /// Opening angle of the cone of rays in radians
+    float coneAngle = 2.f / 3.f * glm::pi<float>();
+
+    /// Compute on a simplified proxy of about this many triangles if the mesh has more, 0 computes on the mesh
+    size_t proxyTriangleCount = 0;
+
+    /// Method to allow the Cereal library to serialize the settings, Geometry stores proxyTriangleCount separately
+    template <class Archive>
+    void serialize(Archive& archive) {
+        archive(rayCount, coneAngle);
+    }
+};
+
+/// Shape diameter function of a closed triangle mesh, with the semantics of CGAL::sdf_values() with postprocessing.
+/// A cone of rays is cast to the inside of the mesh from the centroid of each triangle, the value of the triangle is
+/// the robust average of the distances to the other side. Triangles left without a value get the average of their
+/// neighbours, then the values are smoothed with a bilateral filter and normalized to [0, 1].
+/// Rays are traced over the float TriangleBvh used for picking, in parallel, or on the GPU if it is set.
+class SdfCalculator {
+   public:
+    /// Border edges have no neighbour
+    static constexpr uint32_t NO_NEIGHBOUR = std::numeric_limits<uint32_t>::max();
+
+    /// @param bvh Hierarchy built over the triangles
+    /// @param vertices 3 consecutive vertices of each triangle, in the order given to the hierarchy
+    /// @param neighbours Triangles across the 3 edges of each triangle, NO_NEIGHBOUR for border edges
+    SdfCalculator(const TriangleBvh& bvh, const std::vector<glm::vec3>& vertices,
+                  const std::vector<std::array<uint32_t, 3>>& neighbours);
+
+    /// Trace the rays with the compute shaders of the calculator, it must outlive compute().
+    /// The rays are traced on the CPU if it is null or if the GPU fails.
+    void setGpuCalculator(SdfGpuCalculator* gpuCalculator) {
+        mGpuCalculator = gpuCalculator;
+    }
+
+    /// Compute the normalized values of all triangles. Returns the minimum and the maximum value before the
+    /// normalization, they are equal if the values could not be normalized. Empty if cancelled.
+    /// @param progress Set from 0 to 1 while computing, after each chunk of triangles, if not null
+    /// @param isCancelled Checked by the workers before each chunk of triangles, if not null
+    std::optional<std::pair<double, double>> compute(const SdfSettings& settings, std::vector<double>& values,
+                                                     ::ThreadPool& threadPool, std::atomic<float>* progress = nullptr,
+                                                     const std::atomic<bool>* isCancelled = nullptr) const;
+
+    /// Average of the ray distances without the outliers, the rays further from the median than 1.5 times the
+    /// standard deviation. Pairs are a distance and a weight. Empty if there are no distances.
+    static std::optional<double> robustAverage(std::vector<std::pair<double, double>>& distances);
+
+   private:
+    /// Sample of the unit disk, the ray goes through it when the disk is placed at the tip of the cone
+    struct DiskSample {
+        float x;
+        float y;
+        float weight;
+    };
+
+    /// Vogel disk sampling, samples are denser close to the center of the disk and have the same weight
+    static std::vector<DiskSample> sampleDisk(int sampleCount);
+
+    /// Raw value of the triangle, empty if no ray hit the inside of the mesh
+    std::optional<double> computeTriangleValue(size_t triangleIdx, const std::vector<DiskSample>& samples,
+                                               float coneTangent, std::vector<glm::vec3>& origins,
+                                               std::vector<glm::vec3>& directions,
+                                               std::vector<std::pair<double, double>>& distances) const;
+
+    /// Raw values of the triangles from the rays traced by mGpuCalculator, false if the GPU failed.
+    /// hasValue is set for the triangles with a value.
+    bool computeValuesOnGpu(const std::vector<DiskSample>& samples, float coneTangent, std::vector<double>& values,
+                            std::vector<char>& hasValue, ::ThreadPool& threadPool, std::atomic<float>* progress,
+                            const std::atomic<bool>* isCancelled) const;
+
+    /// Give triangles without a value the average of their neighbours with a value
+    void fillMissingValues(std::vector<double>& values, std::vector<char>& hasValue) const;
+
+    /// Bilateral filter over the rings of neighbours of each triangle
+    std::vector<double> smoothValues(const std::vector<double>& values, ::ThreadPool& threadPool,
+                                     const std::atomic<bool>* isCancelled) const;
+
+    const TriangleBvh& mBvh;
+    const std::vector<glm::vec3>& mVertices;
+    const std::vector<std::array<uint32_t, 3>>& mNeighbours;
+
+    /// Unit normal of each triangle, computed from its vertices
+    std::vector<glm::vec3> mNormals;
+
+    /// Distance of the ray origins from the triangles, so that rays do not hit the triangle they start on
+    float mRayOffset = 0.f;
+
+    SdfGpuCalculator* mGpuCalculator = nullptr;
+};
+
+}  // namespace pepr3d
@@ -0,0 +1,178 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "geometry/SdfCalculator.h"
+#include "geometry/TriangleBvh.h"
+
+namespace {
+/// Vertices of a closed box, 3 consecutive vertices for each triangle, oriented outwards
+std::vector<glm::vec3> getBoxVertices(const glm::vec3& size) {
+    // Bottom corners, then the top corners
+    const float x = size.x, y = size.y, z = size.z;
+    const std::array<glm::vec3, 8> corners{glm::vec3(0, 0, 0), glm::vec3(x, 0, 0), glm::vec3(x, y, 0),
+                                           glm::vec3(0, y, 0), glm::vec3(0, 0, z), glm::vec3(x, 0, z),
+                                           glm::vec3(x, y, z), glm::vec3(0, y, z)};
+    const std::array<std::array<size_t, 3>, 12> triangles{{{0, 2, 1}, {0, 3, 2}, {4, 5, 6}, {4, 6, 7},
+                                                           {0, 1, 5}, {0, 5, 4}, {1, 2, 6}, {1, 6, 5},
+                                                           {2, 3, 7}, {2, 7, 6}, {3, 0, 4}, {3, 4, 7}}};
+    std::vector<glm::vec3> vertices;
+    for(const auto& triangle : triangles) {
+        for(const size_t corner : triangle) {
+            vertices.push_back(corners[corner]);
+        }
+    }
+    return vertices;
+}
+
+/// Neighbours across the edges of the triangles, found by matching the edges
+std::vector<std::array<uint32_t, 3>> getNeighbours(const std::vector<glm::vec3>& vertices) {
+    const auto key = [](const glm::vec3& v) { return std::array<float, 3>{v.x, v.y, v.z}; };
+    std::map<std::pair<std::array<float, 3>, std::array<float, 3>>, uint32_t> edges;
+    const size_t triangleCount = vertices.size() / 3;
+    for(uint32_t triangleIdx = 0; triangleIdx < triangleCount; ++triangleIdx) {
+        for(size_t i = 0; i < 3; ++i) {
+            edges[{key(vertices[3 * triangleIdx + i]), key(vertices[3 * triangleIdx + (i + 1) % 3])}] = triangleIdx;
+        }
+    }
+
+    std::vector<std::array<uint32_t, 3>> neighbours(triangleCount);
+    for(size_t triangleIdx = 0; triangleIdx < triangleCount; ++triangleIdx) {
+        for(size_t i = 0; i < 3; ++i) {
+            // The neighbour has the same edge in the opposite direction
+            const auto it =
+                edges.find({key(vertices[3 * triangleIdx + (i + 1) % 3]), key(vertices[3 * triangleIdx + i])});
+            neighbours[triangleIdx][i] = it == edges.end() ? pepr3d::SdfCalculator::NO_NEIGHBOUR : it->second;
+        }
+    }
+    return neighbours;
+}
+}  // namespace
+
+TEST(SdfCalculator, robustAverage) {
+    /**
+     * Test that the distances far from the median do not count
+     */
+
+    std::vector<std::pair<double, double>> distances;
+    EXPECT_FALSE(pepr3d::SdfCalculator::robustAverage(distances));
+
+    distances = {{2.0, 1.0}};
+    EXPECT_DOUBLE_EQ(*pepr3d::SdfCalculator::robustAverage(distances), 2.0);
+
+    // The outlier 10 is left out, the rest is weighted
+    distances = {{1.0, 1.0}, {1.0, 1.0}, {1.2, 2.0}, {1.0, 1.0}, {10.0, 1.0}};
+    EXPECT_DOUBLE_EQ(*pepr3d::SdfCalculator::robustAverage(distances), 5.4 / 5.0);
+}
+
+TEST(SdfCalculator, thicknessOfBox) {
+    /**
+     * Test that the large faces of a thin box are thinner than its sides, and that the values are normalized
+     */
+
+    ::ThreadPool threadPool(2);
+    const std::vector<glm::vec3> vertices = getBoxVertices(glm::vec3(4.f, 4.f, 0.5f));
+    const std::vector<std::array<uint32_t, 3>> neighbours = getNeighbours(vertices);
+    for(const auto& triangleNeighbours : neighbours) {
+        for(const uint32_t neighbour : triangleNeighbours) {
+            ASSERT_NE(neighbour, pepr3d::SdfCalculator::NO_NEIGHBOUR);
+        }
+    }
+
+    pepr3d::TriangleBvh bvh;
+    bvh.build(vertices);
+    const pepr3d::SdfCalculator calculator(bvh, vertices, neighbours);
+
+    std::atomic<float> progress{-1.f};
+    std::vector<double> values;
+    const std::optional<std::pair<double, double>> minMax =
+        calculator.compute(pepr3d::SdfSettings(), values, threadPool, &progress);
+    ASSERT_TRUE(minMax);
+    ASSERT_EQ(values.size(), 12);
+    EXPECT_EQ(progress, 1.f);
+
+    // The box is 0.5 thick, rays in the cone go further than straight through it
+    EXPECT_GT(minMax->first, 0.5);
+    EXPECT_LT(minMax->first, minMax->second);
+    EXPECT_LT(minMax->second, 4.0);
+    for(const double value : values) {
+        EXPECT_GE(value, 0.0);
+        EXPECT_LE(value, 1.0);
+    }
+
+    // Fewer rays in a narrower cone still tell the large faces apart
+    pepr3d::SdfSettings narrowSettings;
+    narrowSettings.rayCount = 5;
+    narrowSettings.coneAngle = 0.5f;
+    std::vector<double> narrowValues;
+    calculator.compute(narrowSettings, narrowValues, threadPool);
+
+    for(const std::vector<double>* result : {&values, &narrowValues}) {
+        // The first 4 triangles are the large faces
+        const double largeFaceValue = *std::max_element(result->begin(), result->begin() + 4);
+        for(size_t sideIdx = 4; sideIdx < 12; ++sideIdx) {
+            EXPECT_LT(largeFaceValue, (*result)[sideIdx]);
+        }
+    }
+}
+
+TEST(SdfCalculator, scalesWithSize) {
+    /**
+     * Test that the values of a box twice as large are twice as large before the normalization and the same after
+     */
+
+    ::ThreadPool threadPool(2);
+    std::vector<std::pair<double, double>> minMaxes;
+    std::vector<std::vector<double>> values(2);
+    for(size_t sizeIdx = 0; sizeIdx < 2; ++sizeIdx) {
+        const std::vector<glm::vec3> vertices = getBoxVertices(glm::vec3(sizeIdx + 1.f));
+        const std::vector<std::array<uint32_t, 3>> neighbours = getNeighbours(vertices);
+        pepr3d::TriangleBvh bvh;
+        bvh.build(vertices);
+        minMaxes.push_back(*pepr3d::SdfCalculator(bvh, vertices, neighbours)
+                                .compute(pepr3d::SdfSettings(), values[sizeIdx], threadPool));
+    }
+
+    EXPECT_NEAR(minMaxes[1].first, 2.0 * minMaxes[0].first, 1e-4);
+    EXPECT_NEAR(minMaxes[1].second, 2.0 * minMaxes[0].second, 1e-4);
+    ASSERT_EQ(values[0].size(), values[1].size());
+    for(size_t triangleIdx = 0; triangleIdx < values[0].size(); ++triangleIdx) {
+        EXPECT_NEAR(values[0][triangleIdx], values[1][triangleIdx], 1e-2);
+    }
+}
+
+TEST(SdfCalculator, cancel) {
+    /**
+     * Test that a cancelled computation returns no values, and that a coarse estimate already orders the faces
+     */
+
+    ::ThreadPool threadPool(2);
+    const std::vector<glm::vec3> vertices = getBoxVertices(glm::vec3(4.f, 4.f, 0.5f));
+    const std::vector<std::array<uint32_t, 3>> neighbours = getNeighbours(vertices);
+    pepr3d::TriangleBvh bvh;
+    bvh.build(vertices);
+    const pepr3d::SdfCalculator calculator(bvh, vertices, neighbours);
+
+    std::atomic<bool> isCancelled{true};
+    std::atomic<float> progress{-1.f};
+    std::vector<double> values;
+    EXPECT_FALSE(calculator.compute(pepr3d::SdfSettings(), values, threadPool, &progress, &isCancelled));
+    EXPECT_LT(progress, 1.f);
+
+    isCancelled = false;
+    pepr3d::SdfSettings coarseSettings;
+    coarseSettings.rayCount = 3;
+    ASSERT_TRUE(calculator.compute(coarseSettings, values, threadPool, &progress, &isCancelled));
+    EXPECT_EQ(progress, 1.f);
+    const double largeFaceValue = *std::max_element(values.begin(), values.begin() + 4);
+    EXPECT_LT(largeFaceValue, *std::min_element(values.begin() + 4, values.end()));
+}
+
+#endif
@@ -0,0 +1,223 @@
+#include "geometry/SdfGpuCalculator.h"
+
+#include <algorithm>
+#include <exception>
+#include <future>
+#include <utility>
+
+#include "cinder/Log.h"
+#include "cinder/Thread.h"
+#include "cinder/gl/gl.h"
+
+#include "ThreadPool.h"
+#include "geometry/TriangleBvh.h"
+#include "peprassert.h"
+
+namespace pepr3d {
+
+namespace {
+/// Invocations in a work group, local_size_x of the shader
+const size_t LOCAL_SIZE = 64;
+
+/// Triangles traced by one dispatch, small enough for the driver not to reset the GPU on slow hardware
+const size_t BATCH_TRIANGLES = 1 << 14;
+
+/// Buffer bindings of the shader
+enum Binding : GLuint { NODES = 0, BVH_TRIANGLES = 1, TRIANGLES = 2, SAMPLES = 3, DISTANCES = 4 };
+
+bool isSet(const std::atomic<bool>* flag) {
+    return flag != nullptr && flag->load(std::memory_order_relaxed);
+}
+}  // namespace
+
+struct SdfGpuCalculator::GlState {
+    ci::gl::ContextRef context;
+    ci::gl::GlslProgRef program;
+};
+
+SdfGpuCalculator::SdfGpuCalculator() = default;
+
+std::shared_ptr<SdfGpuCalculator> SdfGpuCalculator::create(const std::string& shaderSource) {
+#if defined(CINDER_GL_HAS_COMPUTE_SHADER) && defined(CINDER_GL_HAS_SHADER_STORAGE)
+    if(ci::gl::getVersion() < std::make_pair(4, 3)) {
+        CI_LOG_I("OpenGL " + ci::gl::getVersionString() + " has no compute shaders, the SDF is computed on the CPU.");
+        return nullptr;
+    }
+
+    std::shared_ptr<SdfGpuCalculator> calculator(new SdfGpuCalculator());
+    calculator->mGl = std::make_unique<GlState>();
+    calculator->mGl->context = ci::gl::Context::create(ci::gl::context());
+
+    // The shader is compiled on the thread that uses it, with its context current
+    std::promise<bool> isCompiled;
+    std::future<bool> isCompiledFuture = isCompiled.get_future();
+    SdfGpuCalculator* const calculatorPtr = calculator.get();
+    calculator->mThread = std::thread([calculatorPtr, shaderSource, &isCompiled]() {
+        ci::ThreadSetup threadSetup;
+        calculatorPtr->mGl->context->makeCurrent();
+        try {
+            calculatorPtr->mGl->program = ci::gl::GlslProg::create(ci::gl::GlslProg::Format().compute(shaderSource));
+        } catch(const std::exception& e) {
+            CI_LOG_E(std::string("SDF compute shader failed to compile, the SDF is computed on the CPU: ") +
+                     e.what());
+            calculatorPtr->mGl.reset();
+            isCompiled.set_value(false);
+            return;
+        }
+        isCompiled.set_value(true);
+        calculatorPtr->runJobs();
+    });
+
+    if(!isCompiledFuture.get()) {
+        calculator->mThread.join();
+        return nullptr;
+    }
+    CI_LOG_I("The SDF rays are traced on the GPU.");
+    return calculator;
+#else
+    (void)shaderSource;
+    CI_LOG_I("Cinder is built without compute shaders, the SDF is computed on the CPU.");
+    return nullptr;
+#endif
+}
+
+SdfGpuCalculator::~SdfGpuCalculator() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mIsStopping = true;
+    }
+    mCondition.notify_all();
+    if(mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void SdfGpuCalculator::runJobs() {
+    while(true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [this] { return mIsStopping || !mJobs.empty(); });
+            if(mIsStopping && mJobs.empty()) {
+                break;
+            }
+            job = std::move(mJobs.front());
+            mJobs.pop_front();
+        }
+        job();
+    }
+
+    // The buffers and the shader belong to the context of this thread
+    mGl.reset();
+}
+
+std::vector<float> SdfGpuCalculator::traceRays(const TriangleBvh& bvh, const std::vector<glm::vec3>& vertices,
+                                               const std::vector<glm::vec3>& normals,
+                                               const std::vector<glm::vec2>& samples, const float coneTangent,
+                                               const float rayOffset, ::ThreadPool& threadPool,
+                                               const std::function<void(float)>& onProgress,
+                                               const std::atomic<bool>* isCancelled) {
+    P_ASSERT(vertices.size() == 3 * normals.size());
+    P_ASSERT(bvh.size() == normals.size());
+
+    // The job refers to the arguments, they outlive it as this thread waits for it
+    std::packaged_task<std::vector<float>()> job([&]() {
+        return traceRaysOnThread(bvh, vertices, normals, samples, coneTangent, rayOffset, onProgress, isCancelled);
+    });
+    std::future<std::vector<float>> distances = job.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mJobs.emplace_back([&job]() { job(); });
+    }
+    mCondition.notify_one();
+    return threadPool.wait(distances);
+}
+
+std::vector<float> SdfGpuCalculator::traceRaysOnThread(const TriangleBvh& bvh, const std::vector<glm::vec3>& vertices,
+                                                       const std::vector<glm::vec3>& normals,
+                                                       const std::vector<glm::vec2>& samples,
+                                                       const float coneTangent, const float rayOffset,
+                                                       const std::function<void(float)>& onProgress,
+                                                       const std::atomic<bool>* isCancelled) {
+#if defined(CINDER_GL_HAS_COMPUTE_SHADER) && defined(CINDER_GL_HAS_SHADER_STORAGE)
+    const size_t triangleCount = normals.size();
+    const size_t rayCount = samples.size();
+    if(triangleCount == 0 || rayCount == 0) {
+        return {};
+    }
+
+    std::vector<glm::vec4> nodes;
+    std::vector<glm::vec4> bvhTriangles;
+    bvh.getFlatLayout(nodes, bvhTriangles);
+    std::vector<glm::vec4> triangles;
+    triangles.reserve(4 * triangleCount);
+    for(size_t triangleIdx = 0; triangleIdx < triangleCount; ++triangleIdx) {
+        for(size_t i = 0; i < 3; ++i) {
+            triangles.emplace_back(vertices[3 * triangleIdx + i], 0.f);
+        }
+        triangles.emplace_back(normals[triangleIdx], 0.f);
+    }
+
+    const size_t batchTriangles = std::min(BATCH_TRIANGLES, triangleCount);
+    GLint64 maxBlockSize = 0;
+    glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxBlockSize);
+    const size_t largestBuffer = sizeof(glm::vec4) * std::max({nodes.size(), bvhTriangles.size(), triangles.size()});
+    if(largestBuffer > static_cast<size_t>(maxBlockSize)) {
+        CI_LOG_I("The mesh does not fit into the shader storage of the GPU, the SDF rays are traced on the CPU.");
+        return {};
+    }
+
+    try {
+        const ci::gl::SsboRef nodeBuffer =
+            ci::gl::Ssbo::create(sizeof(glm::vec4) * nodes.size(), nodes.data(), GL_STATIC_DRAW);
+        const ci::gl::SsboRef bvhTriangleBuffer =
+            ci::gl::Ssbo::create(sizeof(glm::vec4) * bvhTriangles.size(), bvhTriangles.data(), GL_STATIC_DRAW);
+        const ci::gl::SsboRef triangleBuffer =
+            ci::gl::Ssbo::create(sizeof(glm::vec4) * triangles.size(), triangles.data(), GL_STATIC_DRAW);
+        const ci::gl::SsboRef sampleBuffer =
+            ci::gl::Ssbo::create(sizeof(glm::vec2) * samples.size(), samples.data(), GL_STATIC_DRAW);
+        const ci::gl::SsboRef distanceBuffer =
+            ci::gl::Ssbo::create(sizeof(float) * batchTriangles * rayCount, nullptr, GL_STREAM_READ);
+        nodeBuffer->bindBase(NODES);
+        bvhTriangleBuffer->bindBase(BVH_TRIANGLES);
+        triangleBuffer->bindBase(TRIANGLES);
+        sampleBuffer->bindBase(SAMPLES);
+        distanceBuffer->bindBase(DISTANCES);
+
+        ci::gl::ScopedGlslProg scopedProgram(mGl->program);
+        mGl->program->uniform("uRayCount", static_cast<int>(rayCount));
+        mGl->program->uniform("uConeTangent", coneTangent);
+        mGl->program->uniform("uRayOffset", rayOffset);
+
+        std::vector<float> distances(triangleCount * rayCount);
+        for(size_t first = 0; first < triangleCount; first += batchTriangles) {
+            if(isSet(isCancelled)) {
+                return {};
+            }
+            const size_t count = std::min(batchTriangles, triangleCount - first);
+            const size_t batchRays = count * rayCount;
+            mGl->program->uniform("uFirstTriangle", static_cast<int>(first));
+            mGl->program->uniform("uTriangleCount", static_cast<int>(count));
+            ci::gl::dispatchCompute(static_cast<GLuint>((batchRays + LOCAL_SIZE - 1) / LOCAL_SIZE));
+            ci::gl::memoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+            distanceBuffer->getBufferSubData(0, sizeof(float) * batchRays, distances.data() + first * rayCount);
+            onProgress(static_cast<float>(first + count) / static_cast<float>(triangleCount));
+        }
+
+        const GLenum error = ci::gl::getError();
+        if(error != GL_NO_ERROR) {
+            CI_LOG_E("Tracing the SDF rays on the GPU failed with " + ci::gl::getErrorString(error) +
+                     ", the rays are traced on the CPU.");
+            return {};
+        }
+        return distances;
+    } catch(const std::exception& e) {
+        CI_LOG_E(std::string("Tracing the SDF rays on the GPU failed, the rays are traced on the CPU: ") + e.what());
+        return {};
+    }
+#else
+    return {};
+#endif
+}
+
+}  // namespace pepr3d
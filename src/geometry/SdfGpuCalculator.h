@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <glm/glm.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ThreadPool;
+
+namespace pepr3d {
+
+class TriangleBvh;
+
+/// Traces the rays of the shape diameter function with OpenGL compute shaders, for SdfCalculator.
+/// Owns a thread with an OpenGL context shared with the context it was created on, the SDF computations running
+/// on the thread pool hand their rays over to it. The hierarchy, the triangles and the disk samples are uploaded
+/// for each computation, the rays are traced in batches of triangles, so that the computation can be cancelled and
+/// reports its progress. Only the rays run on the GPU, SdfCalculator averages their distances and postprocesses
+/// the values as on the CPU.
+class SdfGpuCalculator {
+   public:
+    /// Create the calculator, must be called on a thread with a current OpenGL context.
+    /// Null if the context does not support compute shaders (OpenGL 4.3) or the shader does not compile.
+    /// @param shaderSource Source of the compute shader, shaders/SdfRays.comp of the assets
+    static std::shared_ptr<SdfGpuCalculator> create(const std::string& shaderSource);
+
+    ~SdfGpuCalculator();
+
+    SdfGpuCalculator(const SdfGpuCalculator&) = delete;
+    SdfGpuCalculator& operator=(const SdfGpuCalculator&) = delete;
+
+    /// Trace the rays of all triangles, samples.size() rays for each, in the order of the triangles and the samples.
+    /// Returns the distance of each ray to the other side including rayOffset, negative if the ray missed it.
+    /// Empty if cancelled or if the GPU failed, e.g. because the buffers are too large, the caller traces the rays
+    /// on the CPU then. The calling thread executes the tasks of the thread pool while waiting.
+    /// @param vertices 3 consecutive vertices of each triangle, in the order given to the hierarchy
+    /// @param normals Unit normal of each triangle, zero for degenerate triangles which cast no rays
+    /// @param samples Points of the unit disk the rays go through, when the disk is at the tip of the cone
+    /// @param onProgress Called with the finished part of the rays from 0 to 1, after each batch
+    /// @param isCancelled Checked before each batch, if not null
+    std::vector<float> traceRays(const TriangleBvh& bvh, const std::vector<glm::vec3>& vertices,
+                                 const std::vector<glm::vec3>& normals, const std::vector<glm::vec2>& samples,
+                                 float coneTangent, float rayOffset, ::ThreadPool& threadPool,
+                                 const std::function<void(float)>& onProgress,
+                                 const std::atomic<bool>* isCancelled = nullptr);
+
+   private:
+    /// Context and shader of the thread, defined with the OpenGL includes
+    struct GlState;
+
+    SdfGpuCalculator();
+
+    /// Run the jobs until the calculator is destroyed, on mThread
+    void runJobs();
+
+    /// Body of traceRays() on mThread
+    std::vector<float> traceRaysOnThread(const TriangleBvh& bvh, const std::vector<glm::vec3>& vertices,
+                                         const std::vector<glm::vec3>& normals, const std::vector<glm::vec2>& samples,
+                                         float coneTangent, float rayOffset,
+                                         const std::function<void(float)>& onProgress,
+                                         const std::atomic<bool>* isCancelled);
+
+    /// Only used on mThread, with its context current
+    std::unique_ptr<GlState> mGl;
+
+    std::thread mThread;
+
+    /// Guards mJobs and mIsStopping
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::deque<std::function<void()>> mJobs;
+    bool mIsStopping = false;
+};
+
+}  // namespace pepr3d
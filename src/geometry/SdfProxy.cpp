@@ -0,0 +1,108 @@
+#include "geometry/SdfProxy.h"
+
+#include <algorithm>
+#include <numeric>
+#include <tuple>
+
+#include "geometry/MeshSimplifier.h"
+#include "peprassert.h"
+
+namespace pepr3d {
+
+SdfProxy::SdfProxy(const std::vector<glm::vec3>& vertices, const std::vector<std::array<size_t, 3>>& indices,
+                   const size_t targetTriangleCount, ::ThreadPool& threadPool)
+    : mTargetTriangleCount(targetTriangleCount) {
+    P_ASSERT(indices.size() <= std::numeric_limits<uint32_t>::max());
+    const MeshSimplifier::Mesh proxy = MeshSimplifier::simplify(vertices, indices, targetTriangleCount, threadPool);
+    const size_t triangleCount = proxy.indices.size();
+    mSourceTriangles = proxy.sourceTriangles;
+
+    mVertices.reserve(3 * triangleCount);
+    for(const auto& triangle : proxy.indices) {
+        for(const size_t vertexIdx : triangle) {
+            mVertices.push_back(proxy.vertices[vertexIdx]);
+        }
+    }
+
+    // Edges sorted by their vertices, an edge shared by exactly 2 triangles links them. Edges of more triangles
+    // left by the simplification are borders.
+    std::vector<std::tuple<size_t, size_t, uint32_t>> edges;
+    edges.reserve(3 * triangleCount);
+    for(uint32_t triIdx = 0; triIdx < triangleCount; ++triIdx) {
+        for(uint32_t edgeIdx = 0; edgeIdx < 3; ++edgeIdx) {
+            const size_t start = proxy.indices[triIdx][edgeIdx];
+            const size_t end = proxy.indices[triIdx][(edgeIdx + 1) % 3];
+            edges.emplace_back(std::min(start, end), std::max(start, end), 3 * triIdx + edgeIdx);
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    std::array<uint32_t, 3> noNeighbours;
+    noNeighbours.fill(NO_NEIGHBOUR);
+    mNeighbours.assign(triangleCount, noNeighbours);
+    for(size_t begin = 0; begin < edges.size();) {
+        size_t end = begin + 1;
+        while(end < edges.size() && std::get<0>(edges[end]) == std::get<0>(edges[begin]) &&
+              std::get<1>(edges[end]) == std::get<1>(edges[begin])) {
+            ++end;
+        }
+        if(end - begin == 2) {
+            const uint32_t first = std::get<2>(edges[begin]);
+            const uint32_t second = std::get<2>(edges[begin + 1]);
+            mNeighbours[first / 3][first % 3] = second / 3;
+            mNeighbours[second / 3][second % 3] = first / 3;
+        }
+        begin = end;
+    }
+
+    mBvh.build(mVertices, &threadPool);
+
+    // Items for parallel_for
+    std::vector<size_t> triangleIds(indices.size());
+    std::iota(triangleIds.begin(), triangleIds.end(), 0);
+
+    mProxyTriangles.assign(indices.size(), 0);
+    if(mBvh.empty()) {
+        return;
+    }
+    threadPool.parallel_for(triangleIds.begin(), triangleIds.end(), [&](const size_t triIdx) {
+        const auto& triangle = indices[triIdx];
+        const glm::vec3 centroid =
+            (vertices[triangle[0]] + vertices[triangle[1]] + vertices[triangle[2]]) * (1.f / 3.f);
+        const std::optional<TriangleBvh::Hit> closest = mBvh.findClosest(centroid);
+        P_ASSERT(closest);
+        mProxyTriangles[triIdx] = static_cast<uint32_t>(closest->triangleIdx);
+    });
+}
+
+std::vector<double> SdfProxy::toMeshValues(const std::vector<double>& proxyValues) const {
+    P_ASSERT(proxyValues.size() == getTriangleCount());
+    std::vector<double> meshValues(mProxyTriangles.size(), 0.0);
+    if(proxyValues.empty()) {
+        return meshValues;
+    }
+    for(size_t triIdx = 0; triIdx < mProxyTriangles.size(); ++triIdx) {
+        meshValues[triIdx] = proxyValues[mProxyTriangles[triIdx]];
+    }
+    return meshValues;
+}
+
+std::vector<double> SdfProxy::toProxyValues(const std::vector<double>& meshValues) const {
+    P_ASSERT(meshValues.size() == mProxyTriangles.size());
+    std::vector<double> sums(getTriangleCount(), 0.0);
+    std::vector<size_t> counts(getTriangleCount(), 0);
+    if(sums.empty()) {
+        return sums;
+    }
+    for(size_t triIdx = 0; triIdx < mProxyTriangles.size(); ++triIdx) {
+        sums[mProxyTriangles[triIdx]] += meshValues[triIdx];
+        ++counts[mProxyTriangles[triIdx]];
+    }
+    for(size_t proxyIdx = 0; proxyIdx < sums.size(); ++proxyIdx) {
+        sums[proxyIdx] = counts[proxyIdx] > 0 ? sums[proxyIdx] / counts[proxyIdx]
+                                               : meshValues[mSourceTriangles[proxyIdx]];
+    }
+    return sums;
+}
+
+}  // namespace pepr3d
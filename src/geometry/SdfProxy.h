@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <limits>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "geometry/TriangleBvh.h"
+
+namespace pepr3d {
+
+/// Decimated proxy of a large mesh, the SDF values and the segmentation are computed on it instead of on the mesh.
+/// The proxy is simplified by MeshSimplifier and each triangle of the mesh is mapped to the proxy triangle closest to
+/// its centroid, found by a hierarchy over the proxy. Values move between the mesh and the proxy through the map.
+class SdfProxy {
+   public:
+    /// Border edges have no neighbour
+    static constexpr uint32_t NO_NEIGHBOUR = std::numeric_limits<uint32_t>::max();
+
+    /// @param vertices Vertices of the mesh, shared by its triangles
+    /// @param indices Vertices of each triangle of the mesh
+    /// @param targetTriangleCount Rough number of triangles of the proxy
+    SdfProxy(const std::vector<glm::vec3>& vertices, const std::vector<std::array<size_t, 3>>& indices,
+             size_t targetTriangleCount, ::ThreadPool& threadPool);
+
+    size_t getTargetTriangleCount() const {
+        return mTargetTriangleCount;
+    }
+
+    size_t getTriangleCount() const {
+        return mVertices.size() / 3;
+    }
+
+    /// 3 consecutive vertices of each triangle of the proxy
+    const std::vector<glm::vec3>& getVertices() const {
+        return mVertices;
+    }
+
+    /// Triangles of the proxy across the 3 edges of each proxy triangle, NO_NEIGHBOUR for border edges
+    const std::vector<std::array<uint32_t, 3>>& getNeighbours() const {
+        return mNeighbours;
+    }
+
+    /// Hierarchy over the triangles of the proxy
+    const TriangleBvh& getBvh() const {
+        return mBvh;
+    }
+
+    /// Closest proxy triangle of each triangle of the mesh
+    const std::vector<uint32_t>& getProxyTriangles() const {
+        return mProxyTriangles;
+    }
+
+    /// Value of each triangle of the mesh from the values of the proxy triangles
+    std::vector<double> toMeshValues(const std::vector<double>& proxyValues) const;
+
+    /// Value of each proxy triangle, the average of the mesh triangles mapped to it. Proxy triangles without any take
+    /// the value of their source triangle.
+    std::vector<double> toProxyValues(const std::vector<double>& meshValues) const;
+
+   private:
+    size_t mTargetTriangleCount;
+
+    std::vector<glm::vec3> mVertices;
+    std::vector<std::array<uint32_t, 3>> mNeighbours;
+    TriangleBvh mBvh;
+
+    std::vector<uint32_t> mProxyTriangles;
+
+    /// Triangle of the mesh each proxy triangle was simplified from
+    std::vector<size_t> mSourceTriangles;
+};
+
+}  // namespace pepr3d
@@ -0,0 +1,64 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "geometry/SdfProxy.h"
+#include "geometry/TestGeometries.h"
+
+TEST(SdfProxy, mapsTrianglesToProxy) {
+    /**
+     * Test that a fine grid gets a coarse proxy with matched neighbours, that each triangle maps to a proxy
+     * triangle close to it, and that values keep their position when moved between the mesh and the proxy
+     */
+
+    ::ThreadPool threadPool(2);
+    std::vector<glm::vec3> vertices;
+    std::vector<std::array<size_t, 3>> indices;
+    pepr3d::test::createGrid(100, 10.f, vertices, indices);
+
+    const pepr3d::SdfProxy proxy(vertices, indices, 500, threadPool);
+    EXPECT_EQ(proxy.getTargetTriangleCount(), 500);
+    ASSERT_GT(proxy.getTriangleCount(), 0);
+    EXPECT_LT(proxy.getTriangleCount(), indices.size() / 4);
+    ASSERT_EQ(proxy.getVertices().size(), 3 * proxy.getTriangleCount());
+    ASSERT_EQ(proxy.getNeighbours().size(), proxy.getTriangleCount());
+    ASSERT_EQ(proxy.getBvh().size(), proxy.getTriangleCount());
+    ASSERT_EQ(proxy.getProxyTriangles().size(), indices.size());
+
+    // Neighbours are mutual and most inner edges of the proxy are matched
+    size_t matchedEdges = 0;
+    for(uint32_t triIdx = 0; triIdx < proxy.getTriangleCount(); ++triIdx) {
+        for(const uint32_t neighbour : proxy.getNeighbours()[triIdx]) {
+            if(neighbour == pepr3d::SdfProxy::NO_NEIGHBOUR) {
+                continue;
+            }
+            ++matchedEdges;
+            const auto& back = proxy.getNeighbours()[neighbour];
+            EXPECT_NE(std::find(back.begin(), back.end(), triIdx), back.end());
+        }
+    }
+    EXPECT_GT(matchedEdges, 2 * proxy.getTriangleCount());
+
+    // The value of a triangle is its x coordinate, the proxy keeps it up to the size of its triangles
+    std::vector<double> values(indices.size());
+    for(size_t triIdx = 0; triIdx < indices.size(); ++triIdx) {
+        values[triIdx] = vertices[indices[triIdx][0]].x;
+    }
+    const std::vector<double> proxyValues = proxy.toProxyValues(values);
+    ASSERT_EQ(proxyValues.size(), proxy.getTriangleCount());
+    const std::vector<double> meshValues = proxy.toMeshValues(proxyValues);
+    ASSERT_EQ(meshValues.size(), indices.size());
+    for(size_t triIdx = 0; triIdx < indices.size(); ++triIdx) {
+        EXPECT_NEAR(meshValues[triIdx], values[triIdx], 1.5);
+    }
+
+    const pepr3d::SdfProxy emptyProxy({}, {}, 500, threadPool);
+    EXPECT_EQ(emptyProxy.getTriangleCount(), 0);
+    EXPECT_TRUE(emptyProxy.toProxyValues({}).empty());
+}
+
+#endif
@@ -0,0 +1,237 @@
+#include "geometry/SdfRegionFlood.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "peprassert.h"
+
+namespace pepr3d {
+
+namespace {
+const double NOT_REACHED = std::numeric_limits<double>::infinity();
+
+/// Call onClosest(triangle, seedIdx) for each of the triangles ordered by their SDF values, with the index of the
+/// closest of the sorted seed values. Both are sorted, so the closest seed only moves forward.
+template <typename OnClosest>
+void sweepClosestSeeds(const std::vector<uint32_t>& sortedTriangles, const std::vector<double>& sdfValues,
+                       const std::vector<double>& sortedSeedValues, OnClosest onClosest) {
+    P_ASSERT(!sortedSeedValues.empty());
+    size_t upper = 0;
+    for(const uint32_t triangle : sortedTriangles) {
+        const double value = sdfValues[triangle];
+        while(upper < sortedSeedValues.size() && sortedSeedValues[upper] < value) {
+            ++upper;
+        }
+
+        size_t closest = upper;
+        if(upper == sortedSeedValues.size()) {
+            closest = upper - 1;
+        } else if(upper > 0 && value - sortedSeedValues[upper - 1] <= sortedSeedValues[upper] - value) {
+            closest = upper - 1;
+        }
+        onClosest(triangle, closest);
+    }
+}
+}  // namespace
+
+SdfRegionFlood::SdfRegionFlood(std::vector<std::array<uint32_t, 3>> neighbours, std::vector<double> sdfValues)
+    : mNeighbours(std::move(neighbours)), mSdfValues(std::move(sdfValues)) {
+    P_ASSERT(mNeighbours.size() == mSdfValues.size());
+    mSortedTriangles.resize(mSdfValues.size());
+    std::iota(mSortedTriangles.begin(), mSortedTriangles.end(), 0);
+    std::sort(mSortedTriangles.begin(), mSortedTriangles.end(),
+              [this](const uint32_t a, const uint32_t b) { return mSdfValues[a] < mSdfValues[b]; });
+}
+
+void SdfRegionFlood::setSeeds(const std::unordered_map<size_t, size_t>& seeds, const bool areEdgesHard) {
+    std::map<size_t, std::vector<uint32_t>> seedsByColor;
+    for(const auto& seed : seeds) {
+        P_ASSERT(seed.first < mSdfValues.size());
+        seedsByColor[seed.second].push_back(static_cast<uint32_t>(seed.first));
+    }
+    for(auto& colorSeeds : seedsByColor) {
+        std::sort(colorSeeds.second.begin(), colorSeeds.second.end());
+    }
+
+    bool isFloodedAgain = areEdgesHard != mAreEdgesHard;
+    mAreEdgesHard = areEdgesHard;
+    if(mAreEdgesHard) {
+        std::vector<size_t> closestColors = getClosestColors(seedsByColor);
+        isFloodedAgain = isFloodedAgain || closestColors != mClosestColors;
+        mClosestColors = std::move(closestColors);
+    } else {
+        mClosestColors.clear();
+    }
+
+    for(auto it = mColors.begin(); it != mColors.end();) {
+        if(seedsByColor.find(it->first) == seedsByColor.end()) {
+            it = mColors.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for(auto& colorSeeds : seedsByColor) {
+        ColorFlood& colorFlood = mColors[colorSeeds.first];
+        std::vector<uint32_t>& newSeeds = colorSeeds.second;
+        const bool isResumed = !isFloodedAgain && !colorFlood.levels.empty() &&
+                               std::includes(newSeeds.begin(), newSeeds.end(), colorFlood.seeds.begin(),
+                                             colorFlood.seeds.end());
+        if(isResumed && newSeeds.size() == colorFlood.seeds.size()) {
+            continue;
+        }
+
+        colorFlood.seeds = std::move(newSeeds);
+        std::vector<double> differences = getDifferences(colorFlood.seeds);
+        Queue queue;
+        if(isResumed) {
+            // The differences only decrease with more seeds. A triangle whose difference decreased may now be
+            // reached at a lower level through one of its neighbours, the flood continues from there.
+            std::swap(colorFlood.differences, differences);
+            for(uint32_t triangle = 0; triangle < mSdfValues.size(); ++triangle) {
+                if(colorFlood.differences[triangle] >= differences[triangle]) {
+                    continue;
+                }
+                double level = colorFlood.levels[triangle];
+                for(const uint32_t neighbour : mNeighbours[triangle]) {
+                    if(neighbour != NO_NEIGHBOUR && !isEdgeBlocked(neighbour, triangle)) {
+                        level = std::min(level, std::max(colorFlood.levels[neighbour],
+                                                         colorFlood.differences[triangle]));
+                    }
+                }
+                if(level < colorFlood.levels[triangle]) {
+                    colorFlood.levels[triangle] = level;
+                    queue.emplace(level, triangle);
+                }
+            }
+        } else {
+            colorFlood.differences = std::move(differences);
+            colorFlood.levels.assign(mSdfValues.size(), NOT_REACHED);
+        }
+
+        for(const uint32_t seed : colorFlood.seeds) {
+            if(colorFlood.levels[seed] > 0.0) {
+                colorFlood.levels[seed] = 0.0;
+                queue.emplace(0.0, seed);
+            }
+        }
+        flood(colorFlood, queue);
+    }
+}
+
+std::unordered_map<size_t, std::vector<size_t>> SdfRegionFlood::getRegions(const double spread,
+                                                                           const bool isOverlapping) const {
+    std::unordered_map<size_t, std::vector<size_t>> regions;
+    if(isOverlapping) {
+        for(const auto& color : mColors) {
+            const ColorFlood& colorFlood = color.second;
+            std::vector<size_t>& region = regions[color.first];
+            for(uint32_t triangle = 0; triangle < mSdfValues.size(); ++triangle) {
+                if(colorFlood.levels[triangle] < spread ||
+                   std::binary_search(colorFlood.seeds.begin(), colorFlood.seeds.end(), triangle)) {
+                    region.push_back(triangle);
+                }
+            }
+        }
+        return regions;
+    }
+
+    // Seeds keep their color, other triangles go to the reaching color with the lowest difference
+    const size_t NO_COLOR = std::numeric_limits<size_t>::max();
+    std::vector<size_t> owners(mSdfValues.size(), NO_COLOR);
+    std::vector<double> ownerDifferences(mSdfValues.size(), NOT_REACHED);
+    for(const auto& color : mColors) {
+        for(const uint32_t seed : color.second.seeds) {
+            owners[seed] = color.first;
+            ownerDifferences[seed] = -1.0;
+        }
+    }
+    for(const auto& color : mColors) {
+        const ColorFlood& colorFlood = color.second;
+        for(uint32_t triangle = 0; triangle < mSdfValues.size(); ++triangle) {
+            if(colorFlood.levels[triangle] < spread &&
+               colorFlood.differences[triangle] < ownerDifferences[triangle]) {
+                owners[triangle] = color.first;
+                ownerDifferences[triangle] = colorFlood.differences[triangle];
+            }
+        }
+    }
+
+    for(size_t triangle = 0; triangle < owners.size(); ++triangle) {
+        if(owners[triangle] != NO_COLOR) {
+            regions[owners[triangle]].push_back(triangle);
+        }
+    }
+    return regions;
+}
+
+double SdfRegionFlood::getLevel(const size_t color, const size_t triangle) const {
+    P_ASSERT(triangle < mSdfValues.size());
+    const auto colorFlood = mColors.find(color);
+    if(colorFlood == mColors.end()) {
+        return NOT_REACHED;
+    }
+    return colorFlood->second.levels[triangle];
+}
+
+std::vector<double> SdfRegionFlood::getDifferences(const std::vector<uint32_t>& seeds) const {
+    std::vector<double> seedValues(seeds.size());
+    for(size_t seedIdx = 0; seedIdx < seeds.size(); ++seedIdx) {
+        seedValues[seedIdx] = mSdfValues[seeds[seedIdx]];
+    }
+    std::sort(seedValues.begin(), seedValues.end());
+
+    std::vector<double> differences(mSdfValues.size());
+    sweepClosestSeeds(mSortedTriangles, mSdfValues, seedValues, [&](const uint32_t triangle, const size_t seedIdx) {
+        differences[triangle] = std::abs(mSdfValues[triangle] - seedValues[seedIdx]);
+    });
+    return differences;
+}
+
+std::vector<size_t> SdfRegionFlood::getClosestColors(
+    const std::map<size_t, std::vector<uint32_t>>& seedsByColor) const {
+    std::vector<std::pair<double, size_t>> seeds;
+    for(const auto& colorSeeds : seedsByColor) {
+        for(const uint32_t seed : colorSeeds.second) {
+            seeds.emplace_back(mSdfValues[seed], colorSeeds.first);
+        }
+    }
+    std::vector<size_t> closestColors(mSdfValues.size(), 0);
+    if(seeds.empty()) {
+        return closestColors;
+    }
+    std::sort(seeds.begin(), seeds.end());
+
+    std::vector<double> seedValues(seeds.size());
+    std::transform(seeds.begin(), seeds.end(), seedValues.begin(),
+                   [](const std::pair<double, size_t>& seed) { return seed.first; });
+    sweepClosestSeeds(mSortedTriangles, mSdfValues, seedValues, [&](const uint32_t triangle, const size_t seedIdx) {
+        closestColors[triangle] = seeds[seedIdx].second;
+    });
+    return closestColors;
+}
+
+void SdfRegionFlood::flood(ColorFlood& colorFlood, Queue& queue) const {
+    while(!queue.empty()) {
+        const auto [level, triangle] = queue.top();
+        queue.pop();
+        if(level > colorFlood.levels[triangle]) {
+            // Reached at a lower level since it was queued
+            continue;
+        }
+
+        for(const uint32_t neighbour : mNeighbours[triangle]) {
+            if(neighbour == NO_NEIGHBOUR || isEdgeBlocked(triangle, neighbour)) {
+                continue;
+            }
+            const double neighbourLevel = std::max(level, colorFlood.differences[neighbour]);
+            if(neighbourLevel < colorFlood.levels[neighbour]) {
+                colorFlood.levels[neighbour] = neighbourLevel;
+                queue.emplace(neighbourLevel, neighbour);
+            }
+        }
+    }
+}
+
+}  // namespace pepr3d
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace pepr3d {
+
+/// Regions grown from seed triangles of several colors over the face adjacency, by the SDF values of the triangles.
+/// The difference of a triangle to a color is its SDF distance to the closest SDF value of the color's seeds. The
+/// level of a triangle is the lowest largest difference along any path from a seed of the color, found by a priority
+/// flood from all seeds of the color at once. A region with a spread then covers the triangles with a level below the
+/// spread, so changing the spread only thresholds the levels and adding seeds resumes the flood where it improves.
+class SdfRegionFlood {
+   public:
+    /// Border edges have no neighbour
+    static constexpr uint32_t NO_NEIGHBOUR = std::numeric_limits<uint32_t>::max();
+
+    /// @param neighbours Triangles across the 3 edges of each triangle, NO_NEIGHBOUR for border edges
+    /// @param sdfValues SDF value of each triangle
+    SdfRegionFlood(std::vector<std::array<uint32_t, 3>> neighbours, std::vector<double> sdfValues);
+
+    /// Flood from the seeds, a map from triangles to their colors. Colors which only gained seeds are resumed, colors
+    /// which lost seeds are flooded again. With hard edges, no region crosses an edge between triangles with
+    /// different closest colors. Those change with any seed, so all colors are flooded again when they do.
+    void setSeeds(const std::unordered_map<size_t, size_t>& seeds, bool areEdgesHard);
+
+    /// Triangles of each color with a level below spread, including the color's seeds. Without overlap, a triangle
+    /// reached by several colors is kept by the one it has the lowest difference to.
+    std::unordered_map<size_t, std::vector<size_t>> getRegions(double spread, bool isOverlapping) const;
+
+    /// Level of a triangle for a color, infinity if the color has no seeds or cannot reach the triangle
+    double getLevel(size_t color, size_t triangle) const;
+
+   private:
+    struct ColorFlood {
+        /// Sorted seed triangles of the color
+        std::vector<uint32_t> seeds;
+
+        /// Difference of each triangle to the color
+        std::vector<double> differences;
+
+        /// Level of each triangle, infinity where not reached
+        std::vector<double> levels;
+    };
+
+    using Queue = std::priority_queue<std::pair<double, uint32_t>, std::vector<std::pair<double, uint32_t>>,
+                                      std::greater<std::pair<double, uint32_t>>>;
+
+    /// Difference of each triangle to the closest of the seeds
+    std::vector<double> getDifferences(const std::vector<uint32_t>& seeds) const;
+
+    /// Color of the seed with the closest SDF value to each triangle
+    std::vector<size_t> getClosestColors(const std::map<size_t, std::vector<uint32_t>>& seedsByColor) const;
+
+    /// Lower the levels of the triangles reachable from the queued ones, until no level improves
+    void flood(ColorFlood& colorFlood, Queue& queue) const;
+
+    bool isEdgeBlocked(const uint32_t triangle, const uint32_t neighbour) const {
+        return mAreEdgesHard && mClosestColors[triangle] != mClosestColors[neighbour];
+    }
+
+    std::vector<std::array<uint32_t, 3>> mNeighbours;
+    std::vector<double> mSdfValues;
+
+    /// All triangles ordered by their SDF values, to find the closest seeds of all triangles in one sweep
+    std::vector<uint32_t> mSortedTriangles;
+
+    bool mAreEdgesHard = false;
+
+    /// Closest color of each triangle, only kept with hard edges
+    std::vector<size_t> mClosestColors;
+
+    std::map<size_t, ColorFlood> mColors;
+};
+
+}  // namespace pepr3d
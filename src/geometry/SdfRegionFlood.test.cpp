@@ -0,0 +1,181 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <queue>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "geometry/SdfRegionFlood.h"
+
+namespace {
+/// Neighbours of a grid of size x size squares, 2 triangles each. Triangle 2i is the lower right half of square i,
+/// triangle 2i + 1 its upper left half.
+std::vector<std::array<uint32_t, 3>> getGridNeighbours(const size_t size) {
+    const uint32_t none = pepr3d::SdfRegionFlood::NO_NEIGHBOUR;
+    const auto square = [size](const size_t x, const size_t y) { return static_cast<uint32_t>(2 * (y * size + x)); };
+    std::vector<std::array<uint32_t, 3>> neighbours(2 * size * size);
+    for(size_t y = 0; y < size; ++y) {
+        for(size_t x = 0; x < size; ++x) {
+            const uint32_t lower = square(x, y);
+            neighbours[lower] = {lower + 1, y > 0 ? square(x, y - 1) + 1 : none,
+                                 x + 1 < size ? square(x + 1, y) + 1 : none};
+            neighbours[lower + 1] = {lower, y + 1 < size ? square(x, y + 1) : none, x > 0 ? square(x - 1, y) : none};
+        }
+    }
+    return neighbours;
+}
+
+/// Triangles of each color reached by a breadth first search through triangles closer than spread to any seed value
+/// of the color, triangles reached by several colors go to the closest one
+std::unordered_map<size_t, std::vector<size_t>> getExpectedRegions(
+    const std::vector<std::array<uint32_t, 3>>& neighbours, const std::vector<double>& sdfValues,
+    const std::unordered_map<size_t, size_t>& seeds, const double spread) {
+    std::unordered_map<size_t, std::vector<size_t>> seedsByColor;
+    for(const auto& seed : seeds) {
+        seedsByColor[seed.second].push_back(seed.first);
+    }
+
+    std::vector<size_t> owners(sdfValues.size(), std::numeric_limits<size_t>::max());
+    std::vector<double> ownerDifferences(sdfValues.size(), std::numeric_limits<double>::max());
+    for(const auto& colorSeeds : seedsByColor) {
+        std::vector<double> differences(sdfValues.size(), std::numeric_limits<double>::max());
+        for(size_t triangle = 0; triangle < sdfValues.size(); ++triangle) {
+            for(const size_t seed : colorSeeds.second) {
+                const double difference = std::abs(sdfValues[triangle] - sdfValues[seed]);
+                differences[triangle] = std::min(differences[triangle], difference);
+            }
+        }
+
+        std::vector<bool> isReached(sdfValues.size(), false);
+        std::queue<size_t> queue;
+        for(const size_t seed : colorSeeds.second) {
+            isReached[seed] = true;
+            queue.push(seed);
+        }
+        while(!queue.empty()) {
+            const size_t triangle = queue.front();
+            queue.pop();
+            if(seeds.find(triangle) == seeds.end() && differences[triangle] < ownerDifferences[triangle]) {
+                owners[triangle] = colorSeeds.first;
+                ownerDifferences[triangle] = differences[triangle];
+            }
+            for(const uint32_t neighbour : neighbours[triangle]) {
+                if(neighbour != pepr3d::SdfRegionFlood::NO_NEIGHBOUR && !isReached[neighbour] &&
+                   differences[neighbour] < spread) {
+                    isReached[neighbour] = true;
+                    queue.push(neighbour);
+                }
+            }
+        }
+    }
+    for(const auto& seed : seeds) {
+        owners[seed.first] = seed.second;
+    }
+
+    std::unordered_map<size_t, std::vector<size_t>> regions;
+    for(size_t triangle = 0; triangle < owners.size(); ++triangle) {
+        if(owners[triangle] != std::numeric_limits<size_t>::max()) {
+            regions[owners[triangle]].push_back(triangle);
+        }
+    }
+    return regions;
+}
+}  // namespace
+
+TEST(SdfRegionFlood, matchesBreadthFirstSearch) {
+    /**
+     * Test that thresholding the levels gives the regions of a breadth first search limited by the spread
+     */
+
+    const size_t size = 12;
+    const std::vector<std::array<uint32_t, 3>> neighbours = getGridNeighbours(size);
+    std::mt19937 random(3);
+    std::uniform_real_distribution<double> value(0.0, 1.0);
+    std::vector<double> sdfValues(neighbours.size());
+    for(double& sdfValue : sdfValues) {
+        sdfValue = value(random);
+    }
+
+    const std::unordered_map<size_t, size_t> seeds{{0, 1}, {17, 1}, {100, 2}, {287, 4}, {250, 2}};
+    pepr3d::SdfRegionFlood regionFlood(neighbours, sdfValues);
+    regionFlood.setSeeds(seeds, false);
+    for(const double spread : {0.0, 0.05, 0.2, 0.4, 1.0}) {
+        EXPECT_EQ(regionFlood.getRegions(spread, false), getExpectedRegions(neighbours, sdfValues, seeds, spread));
+    }
+
+    // Overlapping regions are independent, everything is reached with the full spread
+    const auto overlapping = regionFlood.getRegions(1.01, true);
+    ASSERT_EQ(overlapping.size(), 3);
+    for(const auto& region : overlapping) {
+        EXPECT_EQ(region.second.size(), sdfValues.size());
+    }
+    EXPECT_EQ(regionFlood.getLevel(1, 0), 0.0);
+    EXPECT_EQ(regionFlood.getLevel(3, 0), std::numeric_limits<double>::infinity());
+}
+
+TEST(SdfRegionFlood, resumeWithMoreSeeds) {
+    /**
+     * Test that adding seeds one at a time gives the same levels as flooding with all of them, and that removing
+     * a seed floods its color again
+     */
+
+    const size_t size = 10;
+    const std::vector<std::array<uint32_t, 3>> neighbours = getGridNeighbours(size);
+    std::mt19937 random(11);
+    std::uniform_real_distribution<double> value(0.0, 1.0);
+    std::vector<double> sdfValues(neighbours.size());
+    for(double& sdfValue : sdfValues) {
+        sdfValue = value(random);
+    }
+
+    pepr3d::SdfRegionFlood resumed(neighbours, sdfValues);
+    std::unordered_map<size_t, size_t> seeds;
+    for(const size_t seed : {5, 60, 61, 130, 199, 42}) {
+        seeds[seed] = seed % 2;
+        resumed.setSeeds(seeds, false);
+    }
+    pepr3d::SdfRegionFlood flooded(neighbours, sdfValues);
+    flooded.setSeeds(seeds, false);
+    for(size_t triangle = 0; triangle < sdfValues.size(); ++triangle) {
+        for(const size_t color : {0, 1}) {
+            EXPECT_EQ(resumed.getLevel(color, triangle), flooded.getLevel(color, triangle));
+        }
+    }
+
+    seeds.erase(60);
+    resumed.setSeeds(seeds, false);
+    pepr3d::SdfRegionFlood withoutSeed(neighbours, sdfValues);
+    withoutSeed.setSeeds(seeds, false);
+    for(size_t triangle = 0; triangle < sdfValues.size(); ++triangle) {
+        EXPECT_EQ(resumed.getLevel(0, triangle), withoutSeed.getLevel(0, triangle));
+    }
+}
+
+TEST(SdfRegionFlood, hardEdges) {
+    /**
+     * Test that with hard edges a region does not cross triangles closer to another color
+     */
+
+    // A chain of triangles, the middle ones closer to the value of color 1
+    const uint32_t none = pepr3d::SdfRegionFlood::NO_NEIGHBOUR;
+    const std::vector<std::array<uint32_t, 3>> neighbours{{1, none, none}, {0, 2, none}, {1, 3, none},
+                                                          {2, 4, none},    {3, 5, none}, {4, none, none}};
+    const std::vector<double> sdfValues{0.1, 0.15, 0.5, 0.5, 0.2, 0.1};
+    const std::unordered_map<size_t, size_t> seeds{{0, 0}, {3, 1}};
+
+    pepr3d::SdfRegionFlood regionFlood(neighbours, sdfValues);
+    regionFlood.setSeeds(seeds, false);
+    auto regions = regionFlood.getRegions(0.5, true);
+    EXPECT_EQ(regions[0], std::vector<size_t>({0, 1, 2, 3, 4, 5}));
+
+    regionFlood.setSeeds(seeds, true);
+    regions = regionFlood.getRegions(0.5, true);
+    EXPECT_EQ(regions[0], std::vector<size_t>({0, 1}));
+    EXPECT_EQ(regions[1], std::vector<size_t>({2, 3}));
+}
+
+#endif
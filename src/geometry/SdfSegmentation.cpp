@@ -0,0 +1,772 @@
+#include "geometry/SdfSegmentation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+#include <numeric>
+#include <random>
+
+#include "peprassert.h"
+
+namespace pepr3d {
+
+namespace {
+/// Constants of CGAL::Surface_mesh_segmentation
+const double NORMALIZATION_ALPHA = 5.0;
+const double CONVEX_FACTOR = 0.08;
+const double MIN_EDGE_ANGLE = 5e-6;
+const double MIN_PROBABILITY = 5e-6;
+
+const size_t K_MEANS_RUNS = 5;
+const size_t MAX_ITERATIONS = 100;
+const double EM_THRESHOLD = 1e-4;
+
+/// Passes of iterated conditional modes along the seams of labels transferred from a proxy
+const size_t SEAM_REFINEMENT_PASSES = 8;
+
+/// Most passes over all nodes of the label propagation, it usually converges in a few
+const size_t LABEL_PROPAGATION_PASSES = 50;
+
+/// Minimum cut of a graph with a source and a sink, found by Dinic's maximum flow algorithm
+class MaxFlow {
+   public:
+    explicit MaxFlow(size_t nodeCount) : mFirstEdge(nodeCount, NONE) {}
+
+    uint32_t addNode() {
+        mFirstEdge.push_back(NONE);
+        return static_cast<uint32_t>(mFirstEdge.size() - 1);
+    }
+
+    void addEdge(const uint32_t from, const uint32_t to, const double capacity, const double reverseCapacity) {
+        // Edge 2i goes from -> to, edge 2i + 1 is its reverse
+        addHalfEdge(from, to, capacity);
+        addHalfEdge(to, from, reverseCapacity);
+    }
+
+    /// Returns the value of the maximum flow, empty if cancelled
+    std::optional<double> compute(const uint32_t source, const uint32_t sink, const std::atomic<bool>* isCancelled) {
+        double flow = 0.0;
+        while(findLevels(source, sink)) {
+            if(isCancelled != nullptr && *isCancelled) {
+                return {};
+            }
+            flow += augmentPaths(source, sink);
+        }
+        return flow;
+    }
+
+    /// After compute(), is the node on the side of the source of the minimum cut
+    bool isSourceSide(const uint32_t node) const {
+        return mLevel[node] >= 0;
+    }
+
+   private:
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+    void addHalfEdge(const uint32_t from, const uint32_t to, const double capacity) {
+        mTarget.push_back(to);
+        mResidual.push_back(capacity);
+        mNextEdge.push_back(mFirstEdge[from]);
+        mFirstEdge[from] = static_cast<uint32_t>(mTarget.size() - 1);
+    }
+
+    /// Breadth first search over the residual graph, returns true if the sink is reachable
+    bool findLevels(const uint32_t source, const uint32_t sink) {
+        mLevel.assign(mFirstEdge.size(), -1);
+        mCurrentEdge = mFirstEdge;
+        std::vector<uint32_t> queue{source};
+        mLevel[source] = 0;
+        for(size_t head = 0; head < queue.size(); ++head) {
+            const uint32_t node = queue[head];
+            for(uint32_t edge = mFirstEdge[node]; edge != NONE; edge = mNextEdge[edge]) {
+                if(mResidual[edge] > 0.0 && mLevel[mTarget[edge]] < 0) {
+                    mLevel[mTarget[edge]] = mLevel[node] + 1;
+                    queue.push_back(mTarget[edge]);
+                }
+            }
+        }
+        return mLevel[sink] >= 0;
+    }
+
+    /// Saturate all shortest paths to the sink, returns the added flow
+    double augmentPaths(const uint32_t source, const uint32_t sink) {
+        double flow = 0.0;
+        std::vector<uint32_t> path;
+        uint32_t node = source;
+        while(true) {
+            if(node == sink) {
+                double bottleneck = std::numeric_limits<double>::infinity();
+                for(const uint32_t edge : path) {
+                    bottleneck = std::min(bottleneck, mResidual[edge]);
+                }
+                for(const uint32_t edge : path) {
+                    mResidual[edge] -= bottleneck;
+                    mResidual[edge ^ 1] += bottleneck;
+                }
+                flow += bottleneck;
+
+                // Continue from the first saturated edge
+                const auto saturated = std::find_if(path.begin(), path.end(),
+                                                    [this](const uint32_t edge) { return mResidual[edge] <= 0.0; });
+                P_ASSERT(saturated != path.end());
+                node = mTarget[*saturated ^ 1];
+                path.erase(saturated, path.end());
+                continue;
+            }
+
+            uint32_t& edge = mCurrentEdge[node];
+            while(edge != NONE && (mResidual[edge] <= 0.0 || mLevel[mTarget[edge]] != mLevel[node] + 1)) {
+                edge = mNextEdge[edge];
+            }
+            if(edge != NONE) {
+                path.push_back(edge);
+                node = mTarget[edge];
+            } else if(node == source) {
+                return flow;
+            } else {
+                // Dead end, no path goes through the node in this phase
+                mLevel[node] = -1;
+                node = mTarget[path.back() ^ 1];
+                path.pop_back();
+                mCurrentEdge[node] = mNextEdge[mCurrentEdge[node]];
+            }
+        }
+    }
+
+    std::vector<uint32_t> mFirstEdge;
+    std::vector<uint32_t> mTarget;
+    std::vector<uint32_t> mNextEdge;
+    std::vector<double> mResidual;
+    std::vector<int> mLevel;
+    std::vector<uint32_t> mCurrentEdge;
+};
+
+size_t findClosest(const std::vector<double>& centers, const double value) {
+    size_t closest = 0;
+    for(size_t center = 1; center < centers.size(); ++center) {
+        if(std::abs(value - centers[center]) < std::abs(value - centers[closest])) {
+            closest = center;
+        }
+    }
+    return closest;
+}
+
+/// Centers of the clusters of 1D values with the lowest sum of squared distances of several k-means++ runs
+std::vector<double> kMeans(const std::vector<double>& values, const size_t numberOfClusters) {
+    // Fixed seed, the same values are always segmented the same
+    std::mt19937 random(1340818006);
+    std::vector<double> bestCenters;
+    double bestError = std::numeric_limits<double>::max();
+    std::vector<double> distances(values.size());
+    for(size_t run = 0; run < K_MEANS_RUNS; ++run) {
+        // k-means++ initialization, each next center is far from the previous ones
+        std::vector<double> centers{values[std::uniform_int_distribution<size_t>(0, values.size() - 1)(random)]};
+        while(centers.size() < numberOfClusters) {
+            for(size_t i = 0; i < values.size(); ++i) {
+                double minDistance = std::numeric_limits<double>::max();
+                for(const double center : centers) {
+                    minDistance = std::min(minDistance, (values[i] - center) * (values[i] - center));
+                }
+                distances[i] = minDistance;
+            }
+            const double totalDistance = std::accumulate(distances.begin(), distances.end(), 0.0);
+            if(totalDistance <= 0.0) {
+                // Fewer distinct values than clusters
+                centers.push_back(centers.back());
+                continue;
+            }
+            std::discrete_distribution<size_t> pick(distances.begin(), distances.end());
+            centers.push_back(values[pick(random)]);
+        }
+
+        double error = 0.0;
+        for(size_t iteration = 0; iteration < MAX_ITERATIONS; ++iteration) {
+            std::vector<double> sums(numberOfClusters, 0.0);
+            std::vector<size_t> counts(numberOfClusters, 0);
+            error = 0.0;
+            for(const double value : values) {
+                const size_t closest = findClosest(centers, value);
+                sums[closest] += value;
+                ++counts[closest];
+                error += (value - centers[closest]) * (value - centers[closest]);
+            }
+
+            bool hasMoved = false;
+            for(size_t center = 0; center < numberOfClusters; ++center) {
+                const double newCenter = counts[center] > 0 ? sums[center] / counts[center] : centers[center];
+                hasMoved |= newCenter != centers[center];
+                centers[center] = newCenter;
+            }
+            if(!hasMoved) {
+                break;
+            }
+        }
+
+        if(error < bestError) {
+            bestError = error;
+            bestCenters = centers;
+        }
+    }
+    std::sort(bestCenters.begin(), bestCenters.end());
+    return bestCenters;
+}
+}  // namespace
+
+SdfSegmentation::SdfSegmentation(const std::vector<glm::vec3>& vertices,
+                                 const std::vector<std::array<uint32_t, 3>>& neighbours, std::vector<double> sdfValues,
+                                 const Smoothing smoothing, ::ThreadPool* threadPool)
+    : mSdfValues(std::move(sdfValues)), mSmoothing(smoothing), mThreadPool(threadPool) {
+    const size_t triangleCount = vertices.size() / 3;
+    P_ASSERT(smoothing != Smoothing::LabelPropagation || threadPool != nullptr);
+    P_ASSERT(vertices.size() % 3 == 0);
+    P_ASSERT(neighbours.size() == triangleCount);
+    P_ASSERT(mSdfValues.size() == triangleCount);
+
+    mLogValues.resize(triangleCount);
+    if(triangleCount > 0) {
+        const auto minMax = std::minmax_element(mSdfValues.begin(), mSdfValues.end());
+        const double range = *minMax.second - *minMax.first;
+        const double logScale = 1.0 / std::log(NORMALIZATION_ALPHA + 1.0);
+        for(size_t triangleIdx = 0; triangleIdx < triangleCount; ++triangleIdx) {
+            const double linear = range > 0.0 ? (mSdfValues[triangleIdx] - *minMax.first) / range : 0.0;
+            mLogValues[triangleIdx] = std::log(linear * NORMALIZATION_ALPHA + 1.0) * logScale;
+        }
+    }
+
+    std::vector<glm::vec3> normals(triangleCount);
+    for(size_t triangleIdx = 0; triangleIdx < triangleCount; ++triangleIdx) {
+        const glm::vec3& a = vertices[3 * triangleIdx];
+        const glm::vec3 normal = glm::cross(vertices[3 * triangleIdx + 1] - a, vertices[3 * triangleIdx + 2] - a);
+        const float length = glm::length(normal);
+        normals[triangleIdx] = length > 0.f ? normal * (1.f / length) : glm::vec3(0.f);
+    }
+
+    for(uint32_t triangleIdx = 0; triangleIdx < triangleCount; ++triangleIdx) {
+        for(size_t edgeIdx = 0; edgeIdx < 3; ++edgeIdx) {
+            const uint32_t neighbour = neighbours[triangleIdx][edgeIdx];
+            if(neighbour == NO_NEIGHBOUR || neighbour <= triangleIdx) {
+                continue;
+            }
+
+            // The neighbour is concave if its vertex off the shared edge is above the plane of the triangle
+            const glm::vec3& edgeStart = vertices[3 * triangleIdx + edgeIdx];
+            const glm::vec3& edgeEnd = vertices[3 * triangleIdx + (edgeIdx + 1) % 3];
+            float height = 0.f;
+            for(size_t i = 0; i < 3; ++i) {
+                const glm::vec3& vertex = vertices[3 * neighbour + i];
+                if(vertex != edgeStart && vertex != edgeEnd) {
+                    height = glm::dot(normals[triangleIdx], vertex - edgeStart);
+                }
+            }
+
+            const double cosine =
+                std::clamp(static_cast<double>(glm::dot(normals[triangleIdx], normals[neighbour])), -1.0, 1.0);
+            double angle = std::acos(cosine) / glm::pi<double>();
+            if(height < 0.f) {
+                angle *= CONVEX_FACTOR;
+            }
+            mEdges.emplace_back(triangleIdx, neighbour);
+            mEdgeCosts.push_back(-std::log(std::max(angle, MIN_EDGE_ANGLE)));
+        }
+    }
+}
+
+SdfSegmentation::SdfSegmentation(const std::vector<glm::vec3>& vertices,
+                                 const std::vector<std::array<uint32_t, 3>>& neighbours, std::vector<double> sdfValues,
+                                 std::shared_ptr<const SdfSegmentation> proxy, std::vector<uint32_t> proxyTriangles)
+    : SdfSegmentation(vertices, neighbours, std::move(sdfValues)) {
+    P_ASSERT(proxy != nullptr);
+    P_ASSERT(proxyTriangles.size() == mSdfValues.size());
+    P_ASSERT(std::all_of(proxyTriangles.begin(), proxyTriangles.end(),
+                         [&proxy](const uint32_t triangle) { return triangle < proxy->mSdfValues.size(); }));
+    mProxy = std::move(proxy);
+    mProxyTriangles = std::move(proxyTriangles);
+
+    std::array<uint32_t, 3> noEdges;
+    noEdges.fill(NO_NEIGHBOUR);
+    mTriangleEdges.assign(mSdfValues.size(), noEdges);
+    for(uint32_t edgeIdx = 0; edgeIdx < mEdges.size(); ++edgeIdx) {
+        for(const uint32_t triangle : {mEdges[edgeIdx].first, mEdges[edgeIdx].second}) {
+            const auto slot = std::find(mTriangleEdges[triangle].begin(), mTriangleEdges[triangle].end(), NO_NEIGHBOUR);
+            if(slot != mTriangleEdges[triangle].end()) {
+                *slot = edgeIdx;
+            }
+        }
+    }
+}
+
+std::shared_ptr<const SdfSegmentation::Clustering> SdfSegmentation::getClustering(
+    const size_t numberOfClusters) const {
+    if(mProxy != nullptr) {
+        return mProxy->getClustering(numberOfClusters);
+    }
+    std::lock_guard<std::mutex> lock(mClusteringMutex);
+    if(mClustering == nullptr || mNumberOfClusters != numberOfClusters) {
+        mClustering = std::make_shared<const Clustering>(fitClusters(mLogValues, numberOfClusters));
+        mNumberOfClusters = numberOfClusters;
+    }
+    return mClustering;
+}
+
+std::optional<SdfSegmentation::Segments> SdfSegmentation::segment(const size_t numberOfClusters,
+                                                                  const double smoothingLambda,
+                                                                  const std::atomic<bool>* isCancelled) const {
+    if(mSdfValues.empty()) {
+        return Segments();
+    }
+
+    const std::optional<std::vector<uint32_t>> labels = computeLabels(numberOfClusters, smoothingLambda, isCancelled);
+    if(!labels) {
+        return {};
+    }
+    return assignSegments(*labels);
+}
+
+std::optional<std::vector<uint32_t>> SdfSegmentation::computeLabels(const size_t numberOfClusters,
+                                                                    const double smoothingLambda,
+                                                                    const std::atomic<bool>* isCancelled) const {
+    if(mProxy != nullptr) {
+        const std::optional<std::vector<uint32_t>> proxyLabels =
+            mProxy->computeLabels(numberOfClusters, smoothingLambda, isCancelled);
+        if(!proxyLabels) {
+            return {};
+        }
+        std::vector<uint32_t> labels(mProxyTriangles.size());
+        for(size_t triangleIdx = 0; triangleIdx < labels.size(); ++triangleIdx) {
+            labels[triangleIdx] = (*proxyLabels)[mProxyTriangles[triangleIdx]];
+        }
+        refineSeams(labels, std::max(smoothingLambda, 0.0));
+        return labels;
+    }
+
+    const std::shared_ptr<const Clustering> clustering = getClustering(numberOfClusters);
+    std::vector<double> edgeWeights(mEdgeCosts.size());
+    const double lambda = std::max(smoothingLambda, 0.0);
+    std::transform(mEdgeCosts.begin(), mEdgeCosts.end(), edgeWeights.begin(),
+                   [lambda](const double cost) { return cost * lambda; });
+
+    if(mSmoothing == Smoothing::LabelPropagation) {
+        return propagateLabels(mEdges, edgeWeights, clustering->costs, clustering->labels, *mThreadPool, isCancelled);
+    }
+    return graphCut(mEdges, edgeWeights, clustering->costs, clustering->labels, isCancelled);
+}
+
+void SdfSegmentation::refineSeams(std::vector<uint32_t>& labels, const double smoothingLambda) const {
+    const size_t triangleCount = labels.size();
+    if(triangleCount == 0) {
+        return;
+    }
+
+    // Gaussian mixture of the log values of the labels on the mesh, fitted again as the labels change
+    const size_t labelCount = *std::max_element(labels.begin(), labels.end()) + 1;
+    std::vector<double> means(labelCount);
+    std::vector<double> deviations(labelCount);
+    std::vector<double> mixings(labelCount);
+    const auto fitLabels = [&]() {
+        std::fill(means.begin(), means.end(), 0.0);
+        std::fill(deviations.begin(), deviations.end(), 0.0);
+        std::fill(mixings.begin(), mixings.end(), 0.0);
+        std::vector<size_t> counts(labelCount, 0);
+        for(size_t triangleIdx = 0; triangleIdx < triangleCount; ++triangleIdx) {
+            means[labels[triangleIdx]] += mLogValues[triangleIdx];
+            deviations[labels[triangleIdx]] += mLogValues[triangleIdx] * mLogValues[triangleIdx];
+            ++counts[labels[triangleIdx]];
+        }
+        const double minDeviation = 1e-8;
+        for(size_t label = 0; label < labelCount; ++label) {
+            if(counts[label] > 0) {
+                means[label] /= counts[label];
+                const double variance = deviations[label] / counts[label] - means[label] * means[label];
+                deviations[label] = std::sqrt(std::max(variance, 0.0));
+                mixings[label] = static_cast<double>(counts[label]) / triangleCount;
+            }
+            deviations[label] = std::max(deviations[label], minDeviation);
+        }
+    };
+    const auto getDensity = [&](const double value, const size_t label) {
+        const double distance = (value - means[label]) / deviations[label];
+        return mixings[label] / deviations[label] * std::exp(-0.5 * distance * distance);
+    };
+
+    const auto getNeighbour = [this](const uint32_t triangle, const uint32_t edgeIdx) {
+        return mEdges[edgeIdx].first == triangle ? mEdges[edgeIdx].second : mEdges[edgeIdx].first;
+    };
+
+    // Cost of the label like the costs of the clustering, and the weights of the edges to neighbours with other
+    // labels. totalDensity is the density of the value of the triangle summed over all labels.
+    const auto getEnergy = [&](const uint32_t triangle, const uint32_t label, const double totalDensity) {
+        const double probability =
+            totalDensity > 0.0 ? getDensity(mLogValues[triangle], label) / totalDensity : 1.0 / labelCount;
+        double energy = -std::log(std::max(probability, MIN_PROBABILITY));
+        for(const uint32_t edgeIdx : mTriangleEdges[triangle]) {
+            if(edgeIdx != NO_NEIGHBOUR && labels[getNeighbour(triangle, edgeIdx)] != label) {
+                energy += smoothingLambda * mEdgeCosts[edgeIdx];
+            }
+        }
+        return energy;
+    };
+
+    // Only triangles on the seams can change, then only the neighbours of the changed ones
+    std::vector<uint32_t> seam;
+    for(const auto& edge : mEdges) {
+        if(labels[edge.first] != labels[edge.second]) {
+            seam.push_back(edge.first);
+            seam.push_back(edge.second);
+        }
+    }
+    std::sort(seam.begin(), seam.end());
+    seam.erase(std::unique(seam.begin(), seam.end()), seam.end());
+
+    std::vector<bool> isQueued(triangleCount, false);
+    for(size_t pass = 0; pass < SEAM_REFINEMENT_PASSES && !seam.empty(); ++pass) {
+        fitLabels();
+        std::vector<uint32_t> changed;
+        for(const uint32_t triangle : seam) {
+            double totalDensity = 0.0;
+            for(size_t label = 0; label < labelCount; ++label) {
+                totalDensity += getDensity(mLogValues[triangle], label);
+            }
+            uint32_t bestLabel = labels[triangle];
+            double bestEnergy = getEnergy(triangle, bestLabel, totalDensity);
+            for(const uint32_t edgeIdx : mTriangleEdges[triangle]) {
+                if(edgeIdx == NO_NEIGHBOUR) {
+                    continue;
+                }
+                const uint32_t label = labels[getNeighbour(triangle, edgeIdx)];
+                const double energy = label == bestLabel ? bestEnergy : getEnergy(triangle, label, totalDensity);
+                if(energy < bestEnergy) {
+                    bestEnergy = energy;
+                    bestLabel = label;
+                }
+            }
+            if(bestLabel != labels[triangle]) {
+                labels[triangle] = bestLabel;
+                changed.push_back(triangle);
+            }
+        }
+
+        std::vector<uint32_t> nextSeam;
+        for(const uint32_t triangle : changed) {
+            for(const uint32_t edgeIdx : mTriangleEdges[triangle]) {
+                const uint32_t neighbour = edgeIdx == NO_NEIGHBOUR ? triangle : getNeighbour(triangle, edgeIdx);
+                for(const uint32_t next : {triangle, neighbour}) {
+                    if(!isQueued[next]) {
+                        isQueued[next] = true;
+                        nextSeam.push_back(next);
+                    }
+                }
+            }
+        }
+        for(const uint32_t triangle : nextSeam) {
+            isQueued[triangle] = false;
+        }
+        seam.swap(nextSeam);
+    }
+}
+
+std::optional<std::vector<uint32_t>> SdfSegmentation::graphCut(
+    const std::vector<std::pair<uint32_t, uint32_t>>& edges, const std::vector<double>& edgeWeights,
+    const std::vector<std::vector<double>>& costs, std::vector<uint32_t> labels, const std::atomic<bool>* isCancelled) {
+    P_ASSERT(edges.size() == edgeWeights.size());
+    const uint32_t nodeCount = static_cast<uint32_t>(labels.size());
+    const double infinity = std::numeric_limits<double>::infinity();
+
+    // Expand each label in turn while the energy decreases, the minimum cut of an expansion is its energy
+    double minEnergy = infinity;
+    bool hasImproved = true;
+    while(hasImproved) {
+        hasImproved = false;
+        for(uint32_t alpha = 0; alpha < costs.size(); ++alpha) {
+            // Nodes on the side of the sink get the label alpha
+            MaxFlow graph(nodeCount + 2);
+            const uint32_t source = nodeCount;
+            const uint32_t sink = nodeCount + 1;
+            // The flow through both terminal edges of a node is known, only the rest of it is left to the graph
+            double terminalFlow = 0.0;
+            for(uint32_t node = 0; node < nodeCount; ++node) {
+                const double sourceCapacity = costs[alpha][node];
+                const double sinkCapacity = labels[node] == alpha ? infinity : costs[labels[node]][node];
+                const double flow = std::min(sourceCapacity, sinkCapacity);
+                terminalFlow += flow;
+                graph.addEdge(source, node, sourceCapacity - flow, 0.0);
+                graph.addEdge(node, sink, sinkCapacity - flow, 0.0);
+            }
+            for(size_t edgeIdx = 0; edgeIdx < edges.size(); ++edgeIdx) {
+                const uint32_t first = edges[edgeIdx].first;
+                const uint32_t second = edges[edgeIdx].second;
+                const double weight = edgeWeights[edgeIdx];
+                if(labels[first] == labels[second]) {
+                    if(labels[first] != alpha) {
+                        graph.addEdge(first, second, weight, weight);
+                    }
+                } else {
+                    // The edge is paid if the nodes keep their different labels or if only one of them gets alpha
+                    const uint32_t between = graph.addNode();
+                    const double firstWeight = labels[first] == alpha ? 0.0 : weight;
+                    const double secondWeight = labels[second] == alpha ? 0.0 : weight;
+                    graph.addEdge(first, between, firstWeight, firstWeight);
+                    graph.addEdge(between, second, secondWeight, secondWeight);
+                    graph.addEdge(between, sink, weight, 0.0);
+                }
+            }
+
+            const std::optional<double> flow = graph.compute(source, sink, isCancelled);
+            if(!flow) {
+                return {};
+            }
+            const double energy = *flow + terminalFlow;
+            if(minEnergy - energy <= energy * 1e-10) {
+                continue;
+            }
+            minEnergy = energy;
+            hasImproved = true;
+            for(uint32_t node = 0; node < nodeCount; ++node) {
+                if(!graph.isSourceSide(node)) {
+                    labels[node] = alpha;
+                }
+            }
+        }
+    }
+    return labels;
+}
+
+std::optional<std::vector<uint32_t>> SdfSegmentation::propagateLabels(
+    const std::vector<std::pair<uint32_t, uint32_t>>& edges, const std::vector<double>& edgeWeights,
+    const std::vector<std::vector<double>>& costs, std::vector<uint32_t> labels, ::ThreadPool& threadPool,
+    const std::atomic<bool>* isCancelled) {
+    P_ASSERT(edges.size() == edgeWeights.size());
+    const uint32_t nodeCount = static_cast<uint32_t>(labels.size());
+    const uint32_t labelCount = static_cast<uint32_t>(costs.size());
+
+    // Neighbours of each node with the weights of their edges, stored one node after another
+    std::vector<uint32_t> firstNeighbour(nodeCount + 1, 0);
+    for(const auto& edge : edges) {
+        ++firstNeighbour[edge.first + 1];
+        ++firstNeighbour[edge.second + 1];
+    }
+    std::partial_sum(firstNeighbour.begin(), firstNeighbour.end(), firstNeighbour.begin());
+    std::vector<std::pair<uint32_t, double>> neighbours(firstNeighbour.back());
+    {
+        std::vector<uint32_t> nextNeighbour(firstNeighbour.begin(), firstNeighbour.end() - 1);
+        for(size_t edgeIdx = 0; edgeIdx < edges.size(); ++edgeIdx) {
+            neighbours[nextNeighbour[edges[edgeIdx].first]++] = {edges[edgeIdx].second, edgeWeights[edgeIdx]};
+            neighbours[nextNeighbour[edges[edgeIdx].second]++] = {edges[edgeIdx].first, edgeWeights[edgeIdx]};
+        }
+    }
+
+    // Greedy coloring, triangles of a mesh have at most 3 neighbours and get at most 4 colors
+    const uint32_t noColor = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> colors(nodeCount, noColor);
+    std::vector<std::vector<uint32_t>> colorNodes;
+    std::vector<bool> isColorUsed;
+    for(uint32_t node = 0; node < nodeCount; ++node) {
+        isColorUsed.assign(colorNodes.size() + 1, false);
+        for(uint32_t i = firstNeighbour[node]; i < firstNeighbour[node + 1]; ++i) {
+            if(colors[neighbours[i].first] != noColor) {
+                isColorUsed[colors[neighbours[i].first]] = true;
+            }
+        }
+        colors[node] = static_cast<uint32_t>(std::find(isColorUsed.begin(), isColorUsed.end(), false) -
+                                             isColorUsed.begin());
+        if(colors[node] == colorNodes.size()) {
+            colorNodes.emplace_back();
+        }
+        colorNodes[colors[node]].push_back(node);
+    }
+
+    // The edges to the neighbours with other labels are paid, the weight of the neighbours with the label is saved
+    const auto findBestLabel = [&](const uint32_t node) {
+        double totalWeight = 0.0;
+        for(uint32_t i = firstNeighbour[node]; i < firstNeighbour[node + 1]; ++i) {
+            totalWeight += neighbours[i].second;
+        }
+        const auto getEnergy = [&](const uint32_t label) {
+            double energy = costs[label][node] + totalWeight;
+            for(uint32_t i = firstNeighbour[node]; i < firstNeighbour[node + 1]; ++i) {
+                if(labels[neighbours[i].first] == label) {
+                    energy -= neighbours[i].second;
+                }
+            }
+            return energy;
+        };
+
+        uint32_t bestLabel = labels[node];
+        double bestEnergy = getEnergy(bestLabel);
+        for(uint32_t label = 0; label < labelCount; ++label) {
+            const double energy = getEnergy(label);
+            // Only a clear improvement changes the label, so that the propagation always ends
+            if(bestEnergy - energy > std::abs(bestEnergy) * 1e-10) {
+                bestEnergy = energy;
+                bestLabel = label;
+            }
+        }
+        return bestLabel;
+    };
+
+    for(size_t pass = 0; pass < LABEL_PROPAGATION_PASSES; ++pass) {
+        std::atomic<bool> hasChanged{false};
+        for(const std::vector<uint32_t>& nodes : colorNodes) {
+            if(isCancelled != nullptr && *isCancelled) {
+                return {};
+            }
+            // Nodes of the same color are not neighbours, each of them reads only the labels of other colors
+            threadPool.parallel_for(nodes.begin(), nodes.end(), [&](const uint32_t node) {
+                const uint32_t bestLabel = findBestLabel(node);
+                if(bestLabel != labels[node]) {
+                    labels[node] = bestLabel;
+                    hasChanged.store(true, std::memory_order_relaxed);
+                }
+            });
+        }
+        if(!hasChanged) {
+            break;
+        }
+    }
+    return labels;
+}
+
+SdfSegmentation::Clustering SdfSegmentation::fitClusters(const std::vector<double>& values,
+                                                         const size_t numberOfClusters) {
+    P_ASSERT(numberOfClusters > 0);
+    Clustering clustering;
+    clustering.labels.assign(values.size(), 0);
+    clustering.costs.assign(numberOfClusters, std::vector<double>(values.size(), 0.0));
+    if(values.empty()) {
+        return clustering;
+    }
+
+    std::vector<double> means = kMeans(values, numberOfClusters);
+    std::vector<double> deviations(numberOfClusters, 0.0);
+    std::vector<double> mixings(numberOfClusters, 0.0);
+    std::vector<size_t> counts(numberOfClusters, 0);
+    for(const double value : values) {
+        const size_t closest = findClosest(means, value);
+        deviations[closest] += (value - means[closest]) * (value - means[closest]);
+        ++counts[closest];
+    }
+    const double minDeviation = 1e-8;
+    for(size_t cluster = 0; cluster < numberOfClusters; ++cluster) {
+        deviations[cluster] = counts[cluster] > 0 ? std::sqrt(deviations[cluster] / counts[cluster]) : minDeviation;
+        deviations[cluster] = std::max(deviations[cluster], minDeviation);
+        mixings[cluster] = static_cast<double>(counts[cluster]) / values.size();
+    }
+
+    // Expectation maximization, probabilities[cluster][value] is the expectation step
+    std::vector<std::vector<double>>& probabilities = clustering.costs;
+    const double normalization = 1.0 / std::sqrt(2.0 * glm::pi<double>());
+    double likelihood = -std::numeric_limits<double>::max();
+    for(size_t iteration = 0; iteration < MAX_ITERATIONS; ++iteration) {
+        double newLikelihood = 0.0;
+        for(size_t valueIdx = 0; valueIdx < values.size(); ++valueIdx) {
+            double total = 0.0;
+            for(size_t cluster = 0; cluster < numberOfClusters; ++cluster) {
+                const double distance = (values[valueIdx] - means[cluster]) / deviations[cluster];
+                const double density =
+                    mixings[cluster] * normalization / deviations[cluster] * std::exp(-0.5 * distance * distance);
+                probabilities[cluster][valueIdx] = density;
+                total += density;
+            }
+            for(size_t cluster = 0; cluster < numberOfClusters; ++cluster) {
+                probabilities[cluster][valueIdx] =
+                    total > 0.0 ? probabilities[cluster][valueIdx] / total : 1.0 / numberOfClusters;
+            }
+            newLikelihood += std::log(std::max(total, std::numeric_limits<double>::min()));
+        }
+
+        const bool hasConverged = std::abs(newLikelihood - likelihood) <= EM_THRESHOLD * std::abs(newLikelihood);
+        likelihood = newLikelihood;
+        if(hasConverged) {
+            break;
+        }
+
+        for(size_t cluster = 0; cluster < numberOfClusters; ++cluster) {
+            double weight = 0.0;
+            double mean = 0.0;
+            for(size_t valueIdx = 0; valueIdx < values.size(); ++valueIdx) {
+                weight += probabilities[cluster][valueIdx];
+                mean += probabilities[cluster][valueIdx] * values[valueIdx];
+            }
+            if(weight <= 0.0) {
+                // Empty cluster keeps its parameters
+                continue;
+            }
+            mean /= weight;
+            double deviation = 0.0;
+            for(size_t valueIdx = 0; valueIdx < values.size(); ++valueIdx) {
+                deviation += probabilities[cluster][valueIdx] * (values[valueIdx] - mean) * (values[valueIdx] - mean);
+            }
+            means[cluster] = mean;
+            deviations[cluster] = std::max(std::sqrt(deviation / weight), minDeviation);
+            mixings[cluster] = weight / values.size();
+        }
+    }
+
+    for(size_t valueIdx = 0; valueIdx < values.size(); ++valueIdx) {
+        uint32_t mostProbable = 0;
+        for(uint32_t cluster = 1; cluster < numberOfClusters; ++cluster) {
+            if(probabilities[cluster][valueIdx] > probabilities[mostProbable][valueIdx]) {
+                mostProbable = cluster;
+            }
+        }
+        clustering.labels[valueIdx] = mostProbable;
+        for(size_t cluster = 0; cluster < numberOfClusters; ++cluster) {
+            const double cost = -std::log(std::max(probabilities[cluster][valueIdx], MIN_PROBABILITY));
+            probabilities[cluster][valueIdx] = std::max(cost, std::numeric_limits<double>::epsilon());
+        }
+    }
+    return clustering;
+}
+
+SdfSegmentation::Segments SdfSegmentation::assignSegments(const std::vector<uint32_t>& labels) const {
+    // Union-find over the edges between triangles of the same label
+    std::vector<uint32_t> parents(labels.size());
+    std::iota(parents.begin(), parents.end(), 0);
+    const auto findRoot = [&parents](uint32_t node) {
+        while(parents[node] != node) {
+            parents[node] = parents[parents[node]];
+            node = parents[node];
+        }
+        return node;
+    };
+    for(const auto& edge : mEdges) {
+        if(labels[edge.first] == labels[edge.second]) {
+            const uint32_t first = findRoot(edge.first);
+            const uint32_t second = findRoot(edge.second);
+            parents[std::max(first, second)] = std::min(first, second);
+        }
+    }
+
+    const uint32_t NO_SEGMENT = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> rootSegments(labels.size(), NO_SEGMENT);
+    std::vector<std::pair<double, size_t>> sdfSums;  // sum of the SDF values and the triangle count of each segment
+    Segments segments;
+    segments.triangleSegments.resize(labels.size());
+    for(uint32_t triangleIdx = 0; triangleIdx < labels.size(); ++triangleIdx) {
+        const uint32_t root = findRoot(triangleIdx);
+        if(rootSegments[root] == NO_SEGMENT) {
+            rootSegments[root] = static_cast<uint32_t>(sdfSums.size());
+            sdfSums.emplace_back(0.0, 0);
+        }
+        segments.triangleSegments[triangleIdx] = rootSegments[root];
+        sdfSums[rootSegments[root]].first += mSdfValues[triangleIdx];
+        ++sdfSums[rootSegments[root]].second;
+    }
+
+    // Order the segments by their average SDF value, segments of the same average by their first triangle
+    std::vector<uint32_t> order(sdfSums.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&sdfSums](const uint32_t a, const uint32_t b) {
+        return sdfSums[a].first / sdfSums[a].second < sdfSums[b].first / sdfSums[b].second;
+    });
+    std::vector<uint32_t> ranks(order.size());
+    for(uint32_t rank = 0; rank < order.size(); ++rank) {
+        ranks[order[rank]] = rank;
+    }
+    for(uint32_t& segment : segments.triangleSegments) {
+        segment = ranks[segment];
+    }
+    segments.numberOfSegments = sdfSums.size();
+    return segments;
+}
+
+}  // namespace pepr3d
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.h"
+
+namespace pepr3d {
+
+/// Segmentation of a mesh from the SDF values of its triangles, the steps of CGAL::segmentation_from_sdf_values()
+/// done separately. The SDF values are softly clustered by a Gaussian mixture, the clusters are smoothed by a graph
+/// cut weighted by the dihedral angles of the edges, and connected triangles of the same cluster form a segment.
+/// The clustering of the last number of clusters is kept, so a change of the smoothing only repeats the graph cut.
+/// The graph cut of large meshes can be replaced by a parallel label propagation, see Smoothing.
+/// The segmentation owns copies of its data, all methods can be called from several threads at once.
+/// Large meshes can be segmented on a decimated proxy, the triangles of the mesh get the labels of their closest
+/// proxy triangles and only the triangles along the seams between the labels are smoothed again on the mesh.
+class SdfSegmentation {
+   public:
+    /// Border edges have no neighbour
+    static constexpr uint32_t NO_NEIGHBOUR = std::numeric_limits<uint32_t>::max();
+
+    /// Minimization of the energy of the graph cut which smooths the clusters
+    enum class Smoothing {
+        /// Alpha expansion by graphCut(), serial
+        GraphCut,
+
+        /// Parallel iterated conditional modes by propagateLabels(), a local minimum close to the clustering
+        LabelPropagation
+    };
+
+    /// Gaussian mixture fitted to the log normalized SDF values
+    struct Clustering {
+        /// The most probable cluster of each triangle, clusters are ordered by their mean
+        std::vector<uint32_t> labels;
+
+        /// Negative log probability of each cluster for each triangle, indexed [cluster][triangle]
+        std::vector<std::vector<double>> costs;
+    };
+
+    struct Segments {
+        size_t numberOfSegments = 0;
+
+        /// Segment of each triangle, segments are ordered by the average SDF value of their triangles
+        std::vector<uint32_t> triangleSegments;
+    };
+
+    /// @param vertices 3 consecutive vertices of each triangle
+    /// @param neighbours Triangles across the 3 edges of each triangle, NO_NEIGHBOUR for border edges
+    /// @param sdfValues SDF value of each triangle
+    /// @param threadPool Runs the label propagation, required by Smoothing::LabelPropagation
+    SdfSegmentation(const std::vector<glm::vec3>& vertices, const std::vector<std::array<uint32_t, 3>>& neighbours,
+                    std::vector<double> sdfValues, Smoothing smoothing = Smoothing::GraphCut,
+                    ::ThreadPool* threadPool = nullptr);
+
+    /// Segmentation of the mesh done on a proxy, the clustering and the graph cut run on the proxy
+    /// @param proxy Segmentation of the proxy of the mesh
+    /// @param proxyTriangles Closest triangle of the proxy to each triangle of the mesh
+    SdfSegmentation(const std::vector<glm::vec3>& vertices, const std::vector<std::array<uint32_t, 3>>& neighbours,
+                    std::vector<double> sdfValues, std::shared_ptr<const SdfSegmentation> proxy,
+                    std::vector<uint32_t> proxyTriangles);
+
+    /// Soft clustering of the SDF values, fitted again only when numberOfClusters changes.
+    /// With a proxy, the clustering of the proxy triangles.
+    std::shared_ptr<const Clustering> getClustering(size_t numberOfClusters) const;
+
+    /// Segment the mesh, empty if cancelled
+    /// @param smoothingLambda Weight of the dihedral angles of the edges against the probabilities of the clusters
+    /// @param isCancelled Checked by the graph cut after each step, if not null
+    std::optional<Segments> segment(size_t numberOfClusters, double smoothingLambda,
+                                    const std::atomic<bool>* isCancelled = nullptr) const;
+
+    /// Labels of the nodes minimizing the sum of costs[label][node] and of the weights of the edges between nodes
+    /// with different labels. Alpha expansion starting from labels, empty if cancelled.
+    static std::optional<std::vector<uint32_t>> graphCut(const std::vector<std::pair<uint32_t, uint32_t>>& edges,
+                                                         const std::vector<double>& edgeWeights,
+                                                         const std::vector<std::vector<double>>& costs,
+                                                         std::vector<uint32_t> labels,
+                                                         const std::atomic<bool>* isCancelled = nullptr);
+
+    /// Labels of the nodes lowering the energy of graphCut() by iterated conditional modes starting from labels, each
+    /// node takes its best label given the labels of its neighbours until no label changes. The nodes are colored so
+    /// that neighbours never share a color, the nodes of one color are updated in parallel and the result does not
+    /// depend on the number of threads. Empty if cancelled.
+    static std::optional<std::vector<uint32_t>> propagateLabels(const std::vector<std::pair<uint32_t, uint32_t>>& edges,
+                                                                const std::vector<double>& edgeWeights,
+                                                                const std::vector<std::vector<double>>& costs,
+                                                                std::vector<uint32_t> labels,
+                                                                ::ThreadPool& threadPool,
+                                                                const std::atomic<bool>* isCancelled = nullptr);
+
+    /// Gaussian mixture fitted by expectation maximization, initialized by the best of several k-means runs
+    static Clustering fitClusters(const std::vector<double>& values, size_t numberOfClusters);
+
+   private:
+    /// Labels minimizing the energy of the graph cut, empty if cancelled
+    std::optional<std::vector<uint32_t>> computeLabels(size_t numberOfClusters, double smoothingLambda,
+                                                       const std::atomic<bool>* isCancelled) const;
+
+    /// Change labels of the triangles along the seams between the labels to lower the energy of the graph cut,
+    /// by iterated conditional modes. Each label is a Gaussian of the log values of its triangles, fitted before each
+    /// pass.
+    void refineSeams(std::vector<uint32_t>& labels, double smoothingLambda) const;
+
+    /// Group connected triangles with the same label into segments ordered by their average SDF value
+    Segments assignSegments(const std::vector<uint32_t>& labels) const;
+
+    /// SDF value of each triangle
+    std::vector<double> mSdfValues;
+
+    /// SDF values normalized to [0, 1] on a logarithmic scale, the input of the clustering
+    std::vector<double> mLogValues;
+
+    /// Edges between neighbouring triangles, each edge once
+    std::vector<std::pair<uint32_t, uint32_t>> mEdges;
+
+    /// Negative log of the normalized dihedral angle of each edge, convex edges count less than concave ones
+    std::vector<double> mEdgeCosts;
+
+    /// Segmentation of the proxy and the closest proxy triangle of each triangle, null without a proxy
+    std::shared_ptr<const SdfSegmentation> mProxy;
+    std::vector<uint32_t> mProxyTriangles;
+
+    /// Index of the edges of mEdges of each triangle, NO_NEIGHBOUR for unused slots. Only used with a proxy.
+    std::vector<std::array<uint32_t, 3>> mTriangleEdges;
+
+    /// Minimization of the energy without a proxy, the thread pool is not null for Smoothing::LabelPropagation
+    Smoothing mSmoothing;
+    ::ThreadPool* mThreadPool;
+
+    mutable std::mutex mClusteringMutex;
+    mutable size_t mNumberOfClusters = 0;
+    mutable std::shared_ptr<const Clustering> mClustering;
+};
+
+}  // namespace pepr3d
@@ -0,0 +1,336 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "geometry/SdfSegmentation.h"
+
+namespace {
+/// Flat grid of size x size squares in the XY plane, 2 triangles each, 3 consecutive vertices for each triangle
+std::vector<glm::vec3> getGridVertices(const size_t size) {
+    std::vector<glm::vec3> vertices;
+    for(size_t y = 0; y < size; ++y) {
+        for(size_t x = 0; x < size; ++x) {
+            const glm::vec3 corner(static_cast<float>(x), static_cast<float>(y), 0.f);
+            const glm::vec3 right = corner + glm::vec3(1.f, 0.f, 0.f);
+            const glm::vec3 up = corner + glm::vec3(0.f, 1.f, 0.f);
+            const glm::vec3 opposite = corner + glm::vec3(1.f, 1.f, 0.f);
+            vertices.insert(vertices.end(), {corner, right, opposite, corner, opposite, up});
+        }
+    }
+    return vertices;
+}
+
+/// Neighbours across the edges of the triangles, found by matching the edges
+std::vector<std::array<uint32_t, 3>> getNeighbours(const std::vector<glm::vec3>& vertices) {
+    const auto key = [](const glm::vec3& v) { return std::array<float, 3>{v.x, v.y, v.z}; };
+    std::map<std::pair<std::array<float, 3>, std::array<float, 3>>, uint32_t> edges;
+    const size_t triangleCount = vertices.size() / 3;
+    for(uint32_t triangleIdx = 0; triangleIdx < triangleCount; ++triangleIdx) {
+        for(size_t i = 0; i < 3; ++i) {
+            edges[{key(vertices[3 * triangleIdx + i]), key(vertices[3 * triangleIdx + (i + 1) % 3])}] = triangleIdx;
+        }
+    }
+
+    std::vector<std::array<uint32_t, 3>> neighbours(triangleCount);
+    for(size_t triangleIdx = 0; triangleIdx < triangleCount; ++triangleIdx) {
+        for(size_t i = 0; i < 3; ++i) {
+            const auto it =
+                edges.find({key(vertices[3 * triangleIdx + (i + 1) % 3]), key(vertices[3 * triangleIdx + i])});
+            neighbours[triangleIdx][i] = it == edges.end() ? pepr3d::SdfSegmentation::NO_NEIGHBOUR : it->second;
+        }
+    }
+    return neighbours;
+}
+
+double getEnergy(const std::vector<std::pair<uint32_t, uint32_t>>& edges, const std::vector<double>& edgeWeights,
+                 const std::vector<std::vector<double>>& costs, const std::vector<uint32_t>& labels) {
+    double energy = 0.0;
+    for(size_t node = 0; node < labels.size(); ++node) {
+        energy += costs[labels[node]][node];
+    }
+    for(size_t edgeIdx = 0; edgeIdx < edges.size(); ++edgeIdx) {
+        if(labels[edges[edgeIdx].first] != labels[edges[edgeIdx].second]) {
+            energy += edgeWeights[edgeIdx];
+        }
+    }
+    return energy;
+}
+}  // namespace
+
+TEST(SdfSegmentation, graphCutChain) {
+    /**
+     * Test that the graph cut follows the costs without edges and gives all nodes the same label with strong edges
+     */
+
+    const std::vector<std::pair<uint32_t, uint32_t>> edges{{0, 1}, {1, 2}, {2, 3}, {3, 4}};
+    const std::vector<std::vector<double>> costs{{0.1, 0.1, 1.0, 2.0, 2.0}, {2.0, 2.0, 0.9, 0.1, 0.1}};
+    const std::vector<uint32_t> startLabels(5, 0);
+
+    const auto pointwise = pepr3d::SdfSegmentation::graphCut(edges, std::vector<double>(4, 0.0), costs, startLabels);
+    ASSERT_TRUE(pointwise);
+    EXPECT_EQ(*pointwise, std::vector<uint32_t>({0, 0, 1, 1, 1}));
+
+    // Cutting any edge costs more than the worse label of a half, label 1 has the lower total cost
+    const auto smooth = pepr3d::SdfSegmentation::graphCut(edges, std::vector<double>(4, 10.0), costs, startLabels);
+    ASSERT_TRUE(smooth);
+    EXPECT_EQ(*smooth, std::vector<uint32_t>(5, 1));
+
+    // A weak edge in the middle is cut instead of the strong ones
+    const auto split =
+        pepr3d::SdfSegmentation::graphCut(edges, {10.0, 0.05, 10.0, 10.0}, costs, std::vector<uint32_t>(5, 1));
+    ASSERT_TRUE(split);
+    EXPECT_EQ(*split, std::vector<uint32_t>({0, 0, 1, 1, 1}));
+}
+
+TEST(SdfSegmentation, graphCutBound) {
+    /**
+     * Test on random graphs that alpha expansion never increases the energy and stays within twice the optimum
+     */
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<double> cost(0.0, 1.0);
+    const size_t nodeCount = 7;
+    const size_t labelCount = 3;
+    for(size_t graphIdx = 0; graphIdx < 20; ++graphIdx) {
+        std::vector<std::pair<uint32_t, uint32_t>> edges;
+        std::vector<double> edgeWeights;
+        for(uint32_t first = 0; first < nodeCount; ++first) {
+            for(uint32_t second = first + 1; second < nodeCount; ++second) {
+                if(cost(random) < 0.5) {
+                    edges.emplace_back(first, second);
+                    edgeWeights.push_back(cost(random));
+                }
+            }
+        }
+        std::vector<std::vector<double>> costs(labelCount, std::vector<double>(nodeCount));
+        std::vector<uint32_t> startLabels(nodeCount);
+        for(size_t node = 0; node < nodeCount; ++node) {
+            for(size_t label = 0; label < labelCount; ++label) {
+                costs[label][node] = cost(random);
+            }
+            startLabels[node] = static_cast<uint32_t>(random() % labelCount);
+        }
+
+        double optimum = std::numeric_limits<double>::max();
+        std::vector<uint32_t> labels(nodeCount, 0);
+        for(size_t combination = 0; combination < 2187; ++combination) {  // 3^7
+            size_t remainder = combination;
+            for(size_t node = 0; node < nodeCount; ++node, remainder /= labelCount) {
+                labels[node] = static_cast<uint32_t>(remainder % labelCount);
+            }
+            optimum = std::min(optimum, getEnergy(edges, edgeWeights, costs, labels));
+        }
+
+        const auto result = pepr3d::SdfSegmentation::graphCut(edges, edgeWeights, costs, startLabels);
+        ASSERT_TRUE(result);
+        const double energy = getEnergy(edges, edgeWeights, costs, *result);
+        EXPECT_LE(energy, getEnergy(edges, edgeWeights, costs, startLabels) + 1e-9);
+        EXPECT_LE(energy, 2.0 * optimum + 1e-9);
+    }
+}
+
+TEST(SdfSegmentation, propagateLabelsChain) {
+    /**
+     * Test that the label propagation follows the costs without edges and smooths a noisy node with strong edges
+     */
+
+    ::ThreadPool threadPool(4);
+    const std::vector<std::pair<uint32_t, uint32_t>> edges{{0, 1}, {1, 2}, {2, 3}, {3, 4}};
+    const std::vector<std::vector<double>> costs{{0.1, 0.1, 1.0, 2.0, 2.0}, {2.0, 2.0, 0.9, 0.1, 0.1}};
+
+    const auto pointwise = pepr3d::SdfSegmentation::propagateLabels(edges, std::vector<double>(4, 0.0), costs,
+                                                                    std::vector<uint32_t>(5, 0), threadPool);
+    ASSERT_TRUE(pointwise);
+    EXPECT_EQ(*pointwise, std::vector<uint32_t>({0, 0, 1, 1, 1}));
+
+    // The middle node is closer to label 0 on its own, but both of its neighbours keep label 0
+    const std::vector<std::vector<double>> noisy{{0.1, 0.1, 0.8, 0.1, 0.1}, {2.0, 2.0, 0.5, 2.0, 2.0}};
+    const auto smooth = pepr3d::SdfSegmentation::propagateLabels(edges, std::vector<double>(4, 0.5), noisy,
+                                                                 {0, 0, 1, 0, 0}, threadPool);
+    ASSERT_TRUE(smooth);
+    EXPECT_EQ(*smooth, std::vector<uint32_t>(5, 0));
+
+    const std::atomic<bool> isCancelled{true};
+    EXPECT_FALSE(pepr3d::SdfSegmentation::propagateLabels(edges, std::vector<double>(4, 0.5), noisy,
+                                                          {0, 0, 1, 0, 0}, threadPool, &isCancelled));
+}
+
+TEST(SdfSegmentation, propagateLabelsLocalMinimum) {
+    /**
+     * Test on random graphs that the label propagation never increases the energy, that no single node can lower it
+     * further and that the result does not depend on the number of threads
+     */
+
+    ::ThreadPool threadPool(4);
+    ::ThreadPool serialPool(0);
+    std::mt19937 random(42);
+    std::uniform_real_distribution<double> cost(0.0, 1.0);
+    const size_t nodeCount = 200;
+    const size_t labelCount = 4;
+    for(size_t graphIdx = 0; graphIdx < 10; ++graphIdx) {
+        std::vector<std::pair<uint32_t, uint32_t>> edges;
+        std::vector<double> edgeWeights;
+        for(uint32_t first = 0; first < nodeCount; ++first) {
+            for(uint32_t second = first + 1; second < nodeCount; ++second) {
+                if(cost(random) < 0.02) {
+                    edges.emplace_back(first, second);
+                    edgeWeights.push_back(cost(random));
+                }
+            }
+        }
+        std::vector<std::vector<double>> costs(labelCount, std::vector<double>(nodeCount));
+        std::vector<uint32_t> startLabels(nodeCount);
+        for(size_t node = 0; node < nodeCount; ++node) {
+            for(size_t label = 0; label < labelCount; ++label) {
+                costs[label][node] = cost(random);
+            }
+            startLabels[node] = static_cast<uint32_t>(random() % labelCount);
+        }
+
+        const auto result = pepr3d::SdfSegmentation::propagateLabels(edges, edgeWeights, costs, startLabels,
+                                                                     threadPool);
+        ASSERT_TRUE(result);
+        const double energy = getEnergy(edges, edgeWeights, costs, *result);
+        EXPECT_LE(energy, getEnergy(edges, edgeWeights, costs, startLabels) + 1e-9);
+        for(size_t node = 0; node < nodeCount; ++node) {
+            std::vector<uint32_t> changed = *result;
+            for(uint32_t label = 0; label < labelCount; ++label) {
+                changed[node] = label;
+                EXPECT_GE(getEnergy(edges, edgeWeights, costs, changed), energy - 1e-9);
+            }
+        }
+
+        const auto serial = pepr3d::SdfSegmentation::propagateLabels(edges, edgeWeights, costs, startLabels,
+                                                                     serialPool);
+        ASSERT_TRUE(serial);
+        EXPECT_EQ(*serial, *result);
+    }
+}
+
+TEST(SdfSegmentation, fitClusters) {
+    /**
+     * Test that two separated groups of values get two clusters ordered by their mean
+     */
+
+    const std::vector<double> values{0.81, 0.1, 0.8, 0.12, 0.79, 0.11, 0.82, 0.09};
+    const pepr3d::SdfSegmentation::Clustering clustering = pepr3d::SdfSegmentation::fitClusters(values, 2);
+    ASSERT_EQ(clustering.labels.size(), values.size());
+    ASSERT_EQ(clustering.costs.size(), 2);
+    for(size_t valueIdx = 0; valueIdx < values.size(); ++valueIdx) {
+        const uint32_t expected = values[valueIdx] > 0.5 ? 1 : 0;
+        EXPECT_EQ(clustering.labels[valueIdx], expected);
+        EXPECT_LT(clustering.costs[expected][valueIdx], clustering.costs[1 - expected][valueIdx]);
+        EXPECT_GT(clustering.costs[expected][valueIdx], 0.0);
+    }
+}
+
+TEST(SdfSegmentation, segmentGrid) {
+    /**
+     * Test that a grid with a thin and a thick half is split into two segments, the thin one first
+     */
+
+    const size_t size = 8;
+    const std::vector<glm::vec3> vertices = getGridVertices(size);
+    const size_t triangleCount = vertices.size() / 3;
+    std::mt19937 random(7);
+    std::normal_distribution<double> noise(0.0, 0.05);
+    std::vector<double> sdfValues(triangleCount);
+    for(size_t triangleIdx = 0; triangleIdx < triangleCount; ++triangleIdx) {
+        // Triangles of the bottom half are thick
+        const bool isThick = triangleIdx < triangleCount / 2;
+        sdfValues[triangleIdx] = (isThick ? 0.8 : 0.2) + noise(random);
+    }
+
+    const pepr3d::SdfSegmentation segmentation(vertices, getNeighbours(vertices), sdfValues);
+    const auto segments = segmentation.segment(2, 0.3);
+    ASSERT_TRUE(segments);
+    EXPECT_EQ(segments->numberOfSegments, 2);
+    ASSERT_EQ(segments->triangleSegments.size(), triangleCount);
+    for(size_t triangleIdx = 0; triangleIdx < triangleCount; ++triangleIdx) {
+        EXPECT_EQ(segments->triangleSegments[triangleIdx], triangleIdx < triangleCount / 2 ? 1 : 0);
+    }
+
+    // The clustering is kept for the same number of clusters
+    const auto clustering = segmentation.getClustering(2);
+    EXPECT_EQ(segmentation.getClustering(2), clustering);
+    EXPECT_NE(segmentation.getClustering(3), clustering);
+
+    // Flat edges are expensive to cut, strong smoothing keeps the grid in one piece
+    const auto smoothed = segmentation.segment(3, 100.0);
+    ASSERT_TRUE(smoothed);
+    EXPECT_EQ(smoothed->numberOfSegments, 1);
+
+    const std::atomic<bool> isCancelled{true};
+    EXPECT_FALSE(segmentation.segment(2, 0.3, &isCancelled));
+
+    // The label propagation finds the same halves
+    ::ThreadPool threadPool(4);
+    const pepr3d::SdfSegmentation propagation(vertices, getNeighbours(vertices), sdfValues,
+                                              pepr3d::SdfSegmentation::Smoothing::LabelPropagation, &threadPool);
+    const auto propagated = propagation.segment(2, 0.3);
+    ASSERT_TRUE(propagated);
+    EXPECT_EQ(propagated->numberOfSegments, 2);
+    EXPECT_EQ(propagated->triangleSegments, segments->triangleSegments);
+    EXPECT_FALSE(propagation.segment(2, 0.3, &isCancelled));
+}
+
+TEST(SdfSegmentation, segmentOnProxy) {
+    /**
+     * Test that the labels of a coarse proxy are transferred to a fine grid and that the seam between the thick and
+     * the thin part is moved to the rows where the values of the fine grid change, inside a cell of the proxy
+     */
+
+    const size_t size = 16;
+    const std::vector<glm::vec3> vertices = getGridVertices(size);
+    const size_t triangleCount = vertices.size() / 3;
+    std::mt19937 random(11);
+    std::normal_distribution<double> noise(0.0, 0.05);
+    std::vector<double> sdfValues(triangleCount);
+    for(size_t triangleIdx = 0; triangleIdx < triangleCount; ++triangleIdx) {
+        // Rows below 7 are thick, the proxy has 2 rows of the grid in each of its rows
+        const bool isThick = triangleIdx / 2 / size < 7;
+        sdfValues[triangleIdx] = (isThick ? 0.8 : 0.2) + noise(random);
+    }
+
+    // Proxy of half the resolution, each triangle maps to the proxy triangle of the same half of the same cell
+    const size_t proxySize = size / 2;
+    std::vector<glm::vec3> proxyVertices = getGridVertices(proxySize);
+    for(glm::vec3& vertex : proxyVertices) {
+        vertex = vertex * 2.f;
+    }
+    std::vector<uint32_t> proxyTriangles(triangleCount);
+    std::vector<double> proxySums(proxyVertices.size() / 3, 0.0);
+    for(size_t triangleIdx = 0; triangleIdx < triangleCount; ++triangleIdx) {
+        const size_t cell = triangleIdx / 2;
+        const size_t proxyCell = (cell / size / 2) * proxySize + (cell % size) / 2;
+        proxyTriangles[triangleIdx] = static_cast<uint32_t>(2 * proxyCell + triangleIdx % 2);
+        proxySums[proxyTriangles[triangleIdx]] += sdfValues[triangleIdx] / 4.0;
+    }
+
+    auto proxy = std::make_shared<const pepr3d::SdfSegmentation>(proxyVertices, getNeighbours(proxyVertices),
+                                                                 proxySums);
+    const pepr3d::SdfSegmentation segmentation(vertices, getNeighbours(vertices), sdfValues, proxy, proxyTriangles);
+    const auto segments = segmentation.segment(2, 0.3);
+    ASSERT_TRUE(segments);
+    EXPECT_EQ(segments->numberOfSegments, 2);
+    ASSERT_EQ(segments->triangleSegments.size(), triangleCount);
+    for(size_t triangleIdx = 0; triangleIdx < triangleCount; ++triangleIdx) {
+        EXPECT_EQ(segments->triangleSegments[triangleIdx], triangleIdx / 2 / size < 7 ? 1 : 0);
+    }
+
+    // The clustering is the one of the proxy
+    EXPECT_EQ(segmentation.getClustering(2)->labels.size(), proxySums.size());
+
+    const std::atomic<bool> isCancelled{true};
+    EXPECT_FALSE(segmentation.segment(2, 0.3, &isCancelled));
+}
+
+#endif
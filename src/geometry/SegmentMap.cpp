@@ -0,0 +1,65 @@
+#include "geometry/SegmentMap.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "peprassert.h"
+
+namespace pepr3d {
+
+SegmentMap::SegmentMap(const std::vector<uint32_t>& triangleSegments, const size_t numberOfSegments,
+                       ::ThreadPool& threadPool)
+    : mTriangleSegments(triangleSegments.size()),
+      mSegmentOffsets(numberOfSegments + 1, 0),
+      mSegmentTriangles(triangleSegments.size()) {
+    P_ASSERT(numberOfSegments <= MAX_SEGMENTS);
+    P_ASSERT(triangleSegments.size() <= std::numeric_limits<uint32_t>::max());
+    const size_t triangleCount = triangleSegments.size();
+
+    // Items for parallel_for
+    std::vector<size_t> chunkIds((triangleCount + CHUNK_TRIANGLES - 1) / CHUNK_TRIANGLES);
+    std::iota(chunkIds.begin(), chunkIds.end(), 0);
+    const auto getChunkEnd = [triangleCount](const size_t chunk) {
+        return std::min(triangleCount, CHUNK_TRIANGLES * (chunk + 1));
+    };
+
+    // Triangles of each segment in each chunk, then the position of the first of them in mSegmentTriangles
+    std::vector<uint32_t> chunkPositions(chunkIds.size() * numberOfSegments, 0);
+    threadPool.parallel_for(
+        chunkIds.begin(), chunkIds.end(),
+        [&](const size_t chunk) {
+            uint32_t* const counts = chunkPositions.data() + chunk * numberOfSegments;
+            for(size_t triIdx = CHUNK_TRIANGLES * chunk; triIdx < getChunkEnd(chunk); ++triIdx) {
+                const uint32_t segment = triangleSegments[triIdx];
+                P_ASSERT(segment < numberOfSegments);
+                mTriangleSegments[triIdx] = static_cast<uint16_t>(segment);
+                ++counts[segment];
+            }
+        },
+        1);
+
+    uint32_t position = 0;
+    for(size_t segment = 0; segment < numberOfSegments; ++segment) {
+        mSegmentOffsets[segment] = position;
+        for(size_t chunk = 0; chunk < chunkIds.size(); ++chunk) {
+            const uint32_t count = chunkPositions[chunk * numberOfSegments + segment];
+            chunkPositions[chunk * numberOfSegments + segment] = position;
+            position += count;
+        }
+    }
+    mSegmentOffsets[numberOfSegments] = position;
+    P_ASSERT(position == triangleCount);
+
+    // The chunks write after each other within each segment, so the triangles stay in increasing order
+    threadPool.parallel_for(
+        chunkIds.begin(), chunkIds.end(),
+        [&](const size_t chunk) {
+            uint32_t* const positions = chunkPositions.data() + chunk * numberOfSegments;
+            for(size_t triIdx = CHUNK_TRIANGLES * chunk; triIdx < getChunkEnd(chunk); ++triIdx) {
+                mSegmentTriangles[positions[mTriangleSegments[triIdx]]++] = static_cast<uint32_t>(triIdx);
+            }
+        },
+        1);
+}
+
+}  // namespace pepr3d
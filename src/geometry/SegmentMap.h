@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "ThreadPool.h"
+
+namespace pepr3d {
+
+/// Segments of a segmentation of the base triangles in dense arrays: the segment of each triangle and the triangles
+/// of each segment, stored one segment after another (CSR). Unlike maps of the triangles, it takes 10 bytes per
+/// triangle and both lookups are a single index.
+class SegmentMap {
+   public:
+    /// Largest number of segments, the segment of a triangle is 16 bit
+    static constexpr size_t MAX_SEGMENTS = size_t(std::numeric_limits<uint16_t>::max()) + 1;
+
+    /// Consecutive triangles of a segment
+    class Triangles {
+       public:
+        Triangles(const uint32_t* first, const uint32_t* last) : mFirst(first), mLast(last) {}
+
+        const uint32_t* begin() const {
+            return mFirst;
+        }
+
+        const uint32_t* end() const {
+            return mLast;
+        }
+
+        size_t size() const {
+            return static_cast<size_t>(mLast - mFirst);
+        }
+
+       private:
+        const uint32_t* mFirst;
+        const uint32_t* mLast;
+    };
+
+    /// Empty map without any triangles or segments
+    SegmentMap() = default;
+
+    /// Builds the map in parallel on the thread pool
+    /// @param triangleSegments Segment of each triangle, below numberOfSegments
+    SegmentMap(const std::vector<uint32_t>& triangleSegments, size_t numberOfSegments, ::ThreadPool& threadPool);
+
+    size_t getTriangleCount() const {
+        return mTriangleSegments.size();
+    }
+
+    size_t getSegmentCount() const {
+        return mSegmentOffsets.empty() ? 0 : mSegmentOffsets.size() - 1;
+    }
+
+    bool empty() const {
+        return mTriangleSegments.empty();
+    }
+
+    size_t getSegment(const size_t triangle) const {
+        return mTriangleSegments[triangle];
+    }
+
+    /// Triangles of the segment, in increasing order
+    Triangles getTriangles(const size_t segment) const {
+        const uint32_t* const data = mSegmentTriangles.data();
+        return Triangles(data + mSegmentOffsets[segment], data + mSegmentOffsets[segment + 1]);
+    }
+
+    /// Copy of the triangles of the segment, e.g., for a command painting them
+    std::vector<size_t> copyTriangles(const size_t segment) const {
+        const Triangles triangles = getTriangles(segment);
+        return std::vector<size_t>(triangles.begin(), triangles.end());
+    }
+
+    void clear() {
+        mTriangleSegments.clear();
+        mSegmentOffsets.clear();
+        mSegmentTriangles.clear();
+    }
+
+   private:
+    /// Triangles filled by a single item of parallel_for
+    static const size_t CHUNK_TRIANGLES = 65536;
+
+    std::vector<uint16_t> mTriangleSegments;
+
+    /// Start of each segment in mSegmentTriangles, followed by the total count
+    std::vector<uint32_t> mSegmentOffsets;
+
+    std::vector<uint32_t> mSegmentTriangles;
+};
+
+}  // namespace pepr3d
@@ -0,0 +1,43 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "geometry/SegmentMap.h"
+
+TEST(SegmentMap, triangleSegments) {
+    /**
+     * Test that the map built in chunks on several threads finds the segment of each triangle and lists the
+     * triangles of each segment in increasing order, also for segments without any triangles
+     */
+
+    const size_t triangleCount = 200000;
+    std::vector<uint32_t> triangleSegments(triangleCount);
+    for(size_t triIdx = 0; triIdx < triangleCount; ++triIdx) {
+        triangleSegments[triIdx] = static_cast<uint32_t>((triIdx * 7 + triIdx / 1000) % 3 == 0 ? 3 : triIdx % 3);
+    }
+
+    ::ThreadPool threadPool(3);
+    const pepr3d::SegmentMap segmentMap(triangleSegments, 5, threadPool);
+    ASSERT_EQ(segmentMap.getTriangleCount(), triangleCount);
+    ASSERT_EQ(segmentMap.getSegmentCount(), 5);
+
+    std::vector<std::vector<size_t>> expected(5);
+    for(size_t triIdx = 0; triIdx < triangleCount; ++triIdx) {
+        EXPECT_EQ(segmentMap.getSegment(triIdx), triangleSegments[triIdx]);
+        expected[triangleSegments[triIdx]].push_back(triIdx);
+    }
+    for(size_t segment = 0; segment < expected.size(); ++segment) {
+        EXPECT_EQ(segmentMap.getTriangles(segment).size(), expected[segment].size());
+        EXPECT_EQ(segmentMap.copyTriangles(segment), expected[segment]);
+    }
+    EXPECT_TRUE(segmentMap.copyTriangles(4).empty());
+
+    const pepr3d::SegmentMap emptyMap({}, 0, threadPool);
+    EXPECT_TRUE(emptyMap.empty());
+    EXPECT_EQ(emptyMap.getSegmentCount(), 0);
+    EXPECT_EQ(pepr3d::SegmentMap().getSegmentCount(), 0);
+}
+
+#endif
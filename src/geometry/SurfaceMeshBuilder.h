@@ -0,0 +1,350 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "peprassert.h"
+
+namespace pepr3d {
+
+/// Builds the connectivity of a CGAL::Surface_mesh from an indexed triangle mesh in bulk.
+/// Instead of adding the faces one by one, the opposite halfedges are found for all faces in parallel and the
+/// connectivity arrays of the mesh are written directly.
+/// Only meshes with manifold edges and vertices are built this way, other meshes are rejected, so that the
+/// caller can use Surface_mesh::add_face(), which handles (or refuses) them the usual way.
+/// Face i of the built mesh is the triangle i.
+template <class Mesh>
+class SurfaceMeshBuilder {
+    using Vertex_index = typename Mesh::Vertex_index;
+    using Halfedge_index = typename Mesh::Halfedge_index;
+    using Face_index = typename Mesh::Face_index;
+    using size_type = typename Mesh::size_type;
+    using Point = typename Mesh::Point;
+
+    static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+   public:
+    SurfaceMeshBuilder(const std::vector<glm::vec3>& vertices, const std::vector<std::array<size_t, 3>>& triangles)
+        : mVertices(vertices), mTriangles(triangles) {}
+
+    /// Use face adjacency from getFaceAdjacency() of an earlier build of the same triangles, instead of finding
+    /// the opposite halfedges again. Adjacency that does not match the triangles is ignored.
+    void setFaceAdjacency(std::vector<uint32_t>&& faceAdjacency) {
+        mOpposite = std::move(faceAdjacency);
+        mHasFaceAdjacency = true;
+    }
+
+    /// Opposite halfedge of each halfedge 3 * f + k of the triangles, from vertex k to vertex k + 1 of the triangle f.
+    /// Border halfedges have no opposite, std::numeric_limits<uint32_t>::max() is stored instead.
+    const std::vector<uint32_t>& getFaceAdjacency() const {
+        return mOpposite;
+    }
+
+    /// Fill the mesh, returns false and leaves the mesh empty if the triangles cannot be built in bulk
+    bool build(Mesh& mesh, ::ThreadPool& threadPool) {
+        mesh.clear();
+        if(mVertices.size() >= NONE || 3 * mTriangles.size() >= NONE) {
+            return false;
+        }
+
+        // Items for parallel_for
+        mVertexIds.resize(mVertices.size());
+        std::iota(mVertexIds.begin(), mVertexIds.end(), 0);
+        mFaceIds.resize(mTriangles.size());
+        std::iota(mFaceIds.begin(), mFaceIds.end(), 0);
+
+        if(!buildOutgoingHalfedges(threadPool)) {
+            return false;
+        }
+        if(!mHasFaceAdjacency || !isFaceAdjacencyValid(threadPool)) {
+            if(!findOppositeHalfedges(threadPool)) {
+                return false;
+            }
+        }
+        numberEdges();
+
+        mesh.resize(static_cast<size_type>(mVertices.size()), static_cast<size_type>(mEdgeCount),
+                    static_cast<size_type>(mTriangles.size()));
+
+        threadPool.parallel_for(mVertexIds.begin(), mVertexIds.end(), [this, &mesh](size_t vertexIdx) {
+            const glm::vec3& vertex = mVertices[vertexIdx];
+            mesh.point(Vertex_index(static_cast<size_type>(vertexIdx))) = Point(vertex.x, vertex.y, vertex.z);
+        });
+
+        // Halfedges of the faces, every element of the mesh arrays is written by one task only
+        threadPool.parallel_for(mFaceIds.begin(), mFaceIds.end(), [this, &mesh](size_t faceIdx) {
+            const Face_index face(static_cast<size_type>(faceIdx));
+            for(uint32_t k = 0; k < 3; ++k) {
+                const uint32_t faceHalfedge = static_cast<uint32_t>(3 * faceIdx + k);
+                const Halfedge_index h = getHalfedge(faceHalfedge);
+                mesh.set_target(h, Vertex_index(static_cast<size_type>(getTo(faceHalfedge))));
+                mesh.set_next(h, getHalfedge(getNextInFace(faceHalfedge)));
+                mesh.set_face(h, face);
+            }
+            mesh.set_halfedge(face, getHalfedge(static_cast<uint32_t>(3 * faceIdx)));
+        });
+
+        // Border halfedges and vertices, fails on vertices where multiple fans meet
+        std::atomic<bool> isManifold{true};
+        threadPool.parallel_for(mVertexIds.begin(), mVertexIds.end(), [this, &mesh, &isManifold](size_t vertexIdx) {
+            if(!linkVertex(mesh, static_cast<uint32_t>(vertexIdx))) {
+                isManifold = false;
+            }
+        });
+        if(!isManifold) {
+            mesh.clear();
+            return false;
+        }
+
+        threadPool.parallel_for(mVertexIds.begin(), mVertexIds.end(), [this, &mesh, &isManifold](size_t vertexIdx) {
+            if(!isVertexFanComplete(mesh, static_cast<uint32_t>(vertexIdx))) {
+                isManifold = false;
+            }
+        });
+        if(!isManifold) {
+            mesh.clear();
+            return false;
+        }
+        return true;
+    }
+
+   private:
+    const std::vector<glm::vec3>& mVertices;
+    const std::vector<std::array<size_t, 3>>& mTriangles;
+
+    std::vector<size_t> mVertexIds;
+    std::vector<size_t> mFaceIds;
+
+    /// Face halfedges going out of each vertex, vertex v owns [mOutgoingStart[v], mOutgoingStart[v + 1])
+    std::vector<uint32_t> mOutgoingStart;
+    std::vector<uint32_t> mOutgoing;
+
+    /// Opposite face halfedge of each face halfedge, NONE on the border
+    std::vector<uint32_t> mOpposite;
+    bool mHasFaceAdjacency = false;
+
+    /// Edge of each face halfedge
+    std::vector<uint32_t> mEdge;
+    size_t mEdgeCount = 0;
+
+    /// Face halfedge 3 * f + k goes from the vertex k to the vertex k + 1 of the face f
+    uint32_t getFrom(const uint32_t faceHalfedge) const {
+        return static_cast<uint32_t>(mTriangles[faceHalfedge / 3][faceHalfedge % 3]);
+    }
+
+    uint32_t getTo(const uint32_t faceHalfedge) const {
+        return static_cast<uint32_t>(mTriangles[faceHalfedge / 3][(faceHalfedge + 1) % 3]);
+    }
+
+    static uint32_t getNextInFace(const uint32_t faceHalfedge) {
+        return faceHalfedge - faceHalfedge % 3 + (faceHalfedge + 1) % 3;
+    }
+
+    static uint32_t getPreviousInFace(const uint32_t faceHalfedge) {
+        return faceHalfedge - faceHalfedge % 3 + (faceHalfedge + 2) % 3;
+    }
+
+    /// Surface_mesh stores the two halfedges of an edge e as 2e and 2e + 1, the face halfedge owning the edge
+    /// takes the first one
+    bool isEdgeOwner(const uint32_t faceHalfedge) const {
+        return mOpposite[faceHalfedge] == NONE || faceHalfedge < mOpposite[faceHalfedge];
+    }
+
+    Halfedge_index getHalfedge(const uint32_t faceHalfedge) const {
+        const size_t idx = 2 * static_cast<size_t>(mEdge[faceHalfedge]) + (isEdgeOwner(faceHalfedge) ? 0 : 1);
+        return Halfedge_index(static_cast<size_type>(idx));
+    }
+
+    /// Border halfedge opposite of a face halfedge without an opposite face halfedge
+    Halfedge_index getBorderHalfedge(const uint32_t faceHalfedge) const {
+        P_ASSERT(mOpposite[faceHalfedge] == NONE);
+        return Halfedge_index(static_cast<size_type>(2 * static_cast<size_t>(mEdge[faceHalfedge]) + 1));
+    }
+
+    bool buildOutgoingHalfedges(::ThreadPool& threadPool) {
+        const size_t vertexCount = mVertices.size();
+        std::vector<std::atomic<uint32_t>> counts(vertexCount);
+        for(auto& count : counts) {
+            count.store(0, std::memory_order_relaxed);
+        }
+
+        std::atomic<bool> isValid{true};
+        threadPool.parallel_for(mFaceIds.begin(), mFaceIds.end(), [this, &counts, &isValid, vertexCount](size_t face) {
+            const auto& tri = mTriangles[face];
+            // Degenerate faces are left to add_face()
+            if(tri[0] >= vertexCount || tri[1] >= vertexCount || tri[2] >= vertexCount || tri[0] == tri[1] ||
+               tri[1] == tri[2] || tri[2] == tri[0]) {
+                isValid = false;
+                return;
+            }
+            for(const size_t vertex : tri) {
+                counts[vertex].fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+        if(!isValid) {
+            return false;
+        }
+
+        mOutgoingStart.resize(vertexCount + 1);
+        mOutgoingStart[0] = 0;
+        for(size_t vertex = 0; vertex < vertexCount; ++vertex) {
+            mOutgoingStart[vertex + 1] = mOutgoingStart[vertex] + counts[vertex].load(std::memory_order_relaxed);
+            counts[vertex].store(mOutgoingStart[vertex], std::memory_order_relaxed);
+        }
+
+        // Order in the lists depends on the scheduling, the lists are only searched
+        mOutgoing.resize(3 * mTriangles.size());
+        threadPool.parallel_for(mFaceIds.begin(), mFaceIds.end(), [this, &counts](size_t face) {
+            for(uint32_t k = 0; k < 3; ++k) {
+                const uint32_t faceHalfedge = static_cast<uint32_t>(3 * face + k);
+                mOutgoing[counts[getFrom(faceHalfedge)].fetch_add(1, std::memory_order_relaxed)] = faceHalfedge;
+            }
+        });
+        return true;
+    }
+
+    bool findOppositeHalfedges(::ThreadPool& threadPool) {
+        mOpposite.assign(3 * mTriangles.size(), NONE);
+        std::atomic<bool> isValid{true};
+        threadPool.parallel_for(mFaceIds.begin(), mFaceIds.end(), [this, &isValid](size_t face) {
+            for(uint32_t k = 0; k < 3; ++k) {
+                const uint32_t faceHalfedge = static_cast<uint32_t>(3 * face + k);
+                const uint32_t from = getFrom(faceHalfedge);
+                const uint32_t to = getTo(faceHalfedge);
+
+                // Two faces with the same orientation of an edge cannot be joined
+                for(uint32_t i = mOutgoingStart[from]; i < mOutgoingStart[from + 1]; ++i) {
+                    if(mOutgoing[i] != faceHalfedge && getTo(mOutgoing[i]) == to) {
+                        isValid = false;
+                        return;
+                    }
+                }
+
+                // The opposite halfedge goes back, there is at most one thanks to the test above
+                for(uint32_t i = mOutgoingStart[to]; i < mOutgoingStart[to + 1]; ++i) {
+                    if(getTo(mOutgoing[i]) == from) {
+                        mOpposite[faceHalfedge] = mOutgoing[i];
+                        break;
+                    }
+                }
+            }
+        });
+        return isValid;
+    }
+
+    /// Adjacency given by setFaceAdjacency() has to pair halfedges going in opposite directions
+    bool isFaceAdjacencyValid(::ThreadPool& threadPool) const {
+        if(mOpposite.size() != 3 * mTriangles.size()) {
+            return false;
+        }
+        std::atomic<bool> isValid{true};
+        threadPool.parallel_for(mFaceIds.begin(), mFaceIds.end(), [this, &isValid](size_t face) {
+            for(uint32_t k = 0; k < 3; ++k) {
+                const uint32_t faceHalfedge = static_cast<uint32_t>(3 * face + k);
+                const uint32_t opposite = mOpposite[faceHalfedge];
+                if(opposite == NONE) {
+                    continue;
+                }
+                if(opposite >= mOpposite.size() || mOpposite[opposite] != faceHalfedge ||
+                   getFrom(opposite) != getTo(faceHalfedge) || getTo(opposite) != getFrom(faceHalfedge)) {
+                    isValid = false;
+                    return;
+                }
+            }
+        });
+        return isValid;
+    }
+
+    void numberEdges() {
+        mEdge.assign(3 * mTriangles.size(), NONE);
+        uint32_t edgeCount = 0;
+        for(uint32_t faceHalfedge = 0; faceHalfedge < mEdge.size(); ++faceHalfedge) {
+            if(isEdgeOwner(faceHalfedge)) {
+                mEdge[faceHalfedge] = edgeCount++;
+            } else {
+                // The owner has a lower index and is already numbered
+                mEdge[faceHalfedge] = mEdge[mOpposite[faceHalfedge]];
+            }
+        }
+        mEdgeCount = edgeCount;
+    }
+
+    /// Link the border halfedge ending in the vertex and set the halfedge of the vertex
+    bool linkVertex(Mesh& mesh, const uint32_t vertexIdx) const {
+        const uint32_t begin = mOutgoingStart[vertexIdx];
+        const uint32_t end = mOutgoingStart[vertexIdx + 1];
+        if(begin == end) {
+            // Isolated vertices keep a null halfedge
+            return true;
+        }
+
+        // Border halfedges coming into and going out of the vertex
+        uint32_t borderIn = NONE;
+        uint32_t borderOut = NONE;
+        uint32_t firstIncoming = NONE;
+        for(uint32_t i = begin; i < end; ++i) {
+            const uint32_t outgoing = mOutgoing[i];
+            const uint32_t incoming = getPreviousInFace(outgoing);
+            firstIncoming = std::min(firstIncoming, incoming);
+            if(mOpposite[outgoing] == NONE) {
+                if(borderIn != NONE) {
+                    return false;
+                }
+                borderIn = outgoing;
+            }
+            if(mOpposite[incoming] == NONE) {
+                if(borderOut != NONE) {
+                    return false;
+                }
+                borderOut = incoming;
+            }
+        }
+        if((borderIn == NONE) != (borderOut == NONE)) {
+            return false;
+        }
+
+        const Vertex_index vertex(static_cast<size_type>(vertexIdx));
+        if(borderIn == NONE) {
+            mesh.set_halfedge(vertex, getHalfedge(firstIncoming));
+            return true;
+        }
+
+        // Border halfedges go against the face halfedges, the one ending here continues with the one starting here
+        const Halfedge_index border = getBorderHalfedge(borderIn);
+        mesh.set_target(border, vertex);
+        mesh.set_face(border, mesh.null_face());
+        mesh.set_next(border, getBorderHalfedge(borderOut));
+        // Border vertices point to a border halfedge, as Surface_mesh requires
+        mesh.set_halfedge(vertex, border);
+        return true;
+    }
+
+    /// Walking around the vertex has to visit all of its halfedges, otherwise multiple fans meet at the vertex
+    bool isVertexFanComplete(const Mesh& mesh, const uint32_t vertexIdx) const {
+        const uint32_t outgoingCount = mOutgoingStart[vertexIdx + 1] - mOutgoingStart[vertexIdx];
+        if(outgoingCount == 0) {
+            return true;
+        }
+
+        const Halfedge_index start = mesh.halfedge(Vertex_index(static_cast<size_type>(vertexIdx)));
+        const bool isBorder = mesh.is_border(start);
+        const uint32_t incomingCount = outgoingCount + (isBorder ? 1 : 0);
+
+        Halfedge_index h = start;
+        uint32_t visited = 0;
+        do {
+            h = mesh.opposite(mesh.next(h));
+            ++visited;
+        } while(h != start && visited <= incomingCount);
+        return h == start && visited == incomingCount;
+    }
+};
+
+}  // namespace pepr3d
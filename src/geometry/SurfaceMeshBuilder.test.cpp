@@ -0,0 +1,139 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <array>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "geometry/PolyhedronData.h"
+#include "geometry/SurfaceMeshBuilder.h"
+
+namespace {
+using Mesh = pepr3d::PolyhedronData::Mesh;
+
+/// Build the mesh face by face, the way CGAL does it
+bool buildWithAddFace(Mesh& mesh, const std::vector<glm::vec3>& vertices,
+                      const std::vector<std::array<size_t, 3>>& triangles) {
+    std::vector<Mesh::Vertex_index> vertexDescs;
+    for(const auto& vertex : vertices) {
+        vertexDescs.push_back(mesh.add_vertex(Mesh::Point(vertex.x, vertex.y, vertex.z)));
+    }
+    for(const auto& tri : triangles) {
+        if(mesh.add_face(vertexDescs[tri[0]], vertexDescs[tri[1]], vertexDescs[tri[2]]) == Mesh::null_face()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t countBorderHalfedges(const Mesh& mesh) {
+    size_t count = 0;
+    for(const auto halfedge : mesh.halfedges()) {
+        count += mesh.is_border(halfedge) ? 1 : 0;
+    }
+    return count;
+}
+}  // namespace
+
+TEST(SurfaceMeshBuilder, matchesAddFace) {
+    /**
+     * Test that a closed and an open mesh built in bulk are valid and match the meshes built face by face
+     */
+
+    ::ThreadPool threadPool(2);
+
+    // Octahedron, closed
+    const std::vector<glm::vec3> vertices{{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+    std::vector<std::array<size_t, 3>> triangles{{0, 2, 4}, {2, 1, 4}, {1, 3, 4}, {3, 0, 4},
+                                                 {2, 0, 5}, {1, 2, 5}, {3, 1, 5}, {0, 3, 5}};
+
+    for(const bool isOpen : {false, true}) {
+        if(isOpen) {
+            // Remove the two bottom faces
+            triangles.resize(6);
+        }
+
+        Mesh bulkMesh;
+        pepr3d::SurfaceMeshBuilder<Mesh> builder(vertices, triangles);
+        ASSERT_TRUE(builder.build(bulkMesh, threadPool));
+        EXPECT_TRUE(bulkMesh.is_valid(false));
+
+        Mesh expectedMesh;
+        ASSERT_TRUE(buildWithAddFace(expectedMesh, vertices, triangles));
+        EXPECT_EQ(bulkMesh.number_of_vertices(), expectedMesh.number_of_vertices());
+        EXPECT_EQ(bulkMesh.number_of_edges(), expectedMesh.number_of_edges());
+        EXPECT_EQ(bulkMesh.number_of_faces(), expectedMesh.number_of_faces());
+        EXPECT_EQ(countBorderHalfedges(bulkMesh), countBorderHalfedges(expectedMesh));
+        EXPECT_EQ(countBorderHalfedges(bulkMesh), isOpen ? 4 : 0);
+
+        // Face i is the triangle i
+        for(size_t faceIdx = 0; faceIdx < triangles.size(); ++faceIdx) {
+            const Mesh::Face_index face(static_cast<Mesh::size_type>(faceIdx));
+            const Mesh::Halfedge_index halfedge = bulkMesh.halfedge(face);
+            std::array<size_t, 3> faceVertices;
+            faceVertices[0] = static_cast<size_t>(bulkMesh.source(halfedge));
+            faceVertices[1] = static_cast<size_t>(bulkMesh.target(halfedge));
+            faceVertices[2] = static_cast<size_t>(bulkMesh.target(bulkMesh.next(halfedge)));
+            EXPECT_EQ(faceVertices, triangles[faceIdx]);
+        }
+    }
+}
+
+TEST(SurfaceMeshBuilder, reusesFaceAdjacency) {
+    /**
+     * Test that the face adjacency of an earlier build gives the same mesh and that wrong adjacency is not used
+     */
+
+    ::ThreadPool threadPool(2);
+    const std::vector<glm::vec3> vertices{{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+    const std::vector<std::array<size_t, 3>> triangles{{0, 2, 4}, {2, 1, 4}, {1, 3, 4}, {3, 0, 4},
+                                                       {2, 0, 5}, {1, 2, 5}, {3, 1, 5}, {0, 3, 5}};
+
+    Mesh expectedMesh;
+    pepr3d::SurfaceMeshBuilder<Mesh> builder(vertices, triangles);
+    ASSERT_TRUE(builder.build(expectedMesh, threadPool));
+    const std::vector<uint32_t> faceAdjacency = builder.getFaceAdjacency();
+    ASSERT_EQ(faceAdjacency.size(), 3 * triangles.size());
+
+    std::vector<uint32_t> wrongAdjacency = faceAdjacency;
+    std::swap(wrongAdjacency[0], wrongAdjacency[1]);
+
+    for(const auto& adjacency : {faceAdjacency, wrongAdjacency}) {
+        Mesh mesh;
+        pepr3d::SurfaceMeshBuilder<Mesh> reusingBuilder(vertices, triangles);
+        reusingBuilder.setFaceAdjacency(std::vector<uint32_t>(adjacency));
+        ASSERT_TRUE(reusingBuilder.build(mesh, threadPool));
+        EXPECT_TRUE(mesh.is_valid(false));
+        EXPECT_EQ(reusingBuilder.getFaceAdjacency(), faceAdjacency);
+        for(const auto halfedge : expectedMesh.halfedges()) {
+            EXPECT_EQ(mesh.opposite(halfedge), expectedMesh.opposite(halfedge));
+            EXPECT_EQ(mesh.next(halfedge), expectedMesh.next(halfedge));
+            EXPECT_EQ(mesh.target(halfedge), expectedMesh.target(halfedge));
+        }
+    }
+}
+
+TEST(SurfaceMeshBuilder, rejectsNonManifold) {
+    /**
+     * Test that meshes add_face() would have to handle are left to it
+     */
+
+    ::ThreadPool threadPool(2);
+    const std::vector<glm::vec3> vertices{{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}};
+    Mesh mesh;
+
+    // Three faces on the same edge
+    const std::vector<std::array<size_t, 3>> sharedEdge{{0, 1, 2}, {1, 0, 3}, {1, 0, 4}};
+    EXPECT_FALSE(pepr3d::SurfaceMeshBuilder<Mesh>(vertices, sharedEdge).build(mesh, threadPool));
+    EXPECT_EQ(mesh.number_of_faces(), 0);
+
+    // Two faces sharing only a vertex
+    const std::vector<std::array<size_t, 3>> sharedVertex{{0, 1, 2}, {0, 3, 4}};
+    EXPECT_FALSE(pepr3d::SurfaceMeshBuilder<Mesh>(vertices, sharedVertex).build(mesh, threadPool));
+
+    // Degenerate face
+    const std::vector<std::array<size_t, 3>> degenerate{{0, 1, 1}};
+    EXPECT_FALSE(pepr3d::SurfaceMeshBuilder<Mesh>(vertices, degenerate).build(mesh, threadPool));
+}
+
+#endif
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <memory_resource>
+
+namespace pepr3d {
+
+/// Memory for short-lived containers of the painting pipeline, a separate pool for every thread.
+/// Details are painted and triangulated in parallel, with their own pools the threads do not contend
+/// for the global allocator, and the memory of one detail is reused by the next one.
+/// Containers using this memory must be destroyed by the thread that created them, do not store them.
+inline std::pmr::memory_resource* getTemporaryMemory() {
+    thread_local std::pmr::unsynchronized_pool_resource pool;
+    return &pool;
+}
+
+}  // namespace pepr3d
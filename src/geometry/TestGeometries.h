@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+#include <glm/glm.hpp>
+#include <utility>
+#include <vector>
+
+#include "geometry/Geometry.h"
+
+/// Small geometries shared by the tests, include it only from the .test.cpp files
+namespace pepr3d {
+namespace test {
+
+/// Square of 2 triangles in the XY plane, the second one moved along Z by offset
+inline Geometry getGeometryWithSquare(const float offset = 0.f) {
+    std::vector<DataTriangle> triangles;
+    triangles.emplace_back(glm::vec3(0, 0, 0), glm::vec3(1, 0, 0), glm::vec3(1, 1, 0), glm::vec3(0, 0, 1), 0);
+    triangles.emplace_back(glm::vec3(0, 0, offset), glm::vec3(1, 1, offset), glm::vec3(0, 1, offset),
+                           glm::vec3(0, 0, 1), 0);
+    return Geometry(std::move(triangles));
+}
+
+/// Square of size x size in the XY plane of resolution x resolution quads, 2 triangles each facing +Z.
+/// Replaces the contents of the vertices and the indices.
+inline void createGrid(const size_t resolution, const float size, std::vector<glm::vec3>& vertices,
+                       std::vector<std::array<size_t, 3>>& indices) {
+    vertices.clear();
+    indices.clear();
+    for(size_t y = 0; y <= resolution; ++y) {
+        for(size_t x = 0; x <= resolution; ++x) {
+            vertices.emplace_back(size * x / resolution, size * y / resolution, 0.f);
+        }
+    }
+    for(size_t y = 0; y < resolution; ++y) {
+        for(size_t x = 0; x < resolution; ++x) {
+            const size_t corner = y * (resolution + 1) + x;
+            indices.push_back({corner, corner + 1, corner + resolution + 2});
+            indices.push_back({corner, corner + resolution + 2, corner + resolution + 1});
+        }
+    }
+}
+
+}  // namespace test
+}  // namespace pepr3d
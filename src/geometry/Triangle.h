@@ -5,10 +5,15 @@
 #include <CGAL/Spherical_kernel_3.h>
 #include <cereal/access.hpp>
 #include <cereal/cereal.hpp>
+#include <cstdint>
 #include <glm/glm.hpp>
 
 namespace pepr3d {
 
+/// Index of a color in the palette. The palette holds at most PEPR3D_MAX_PALETTE_COLORS colors,
+/// so a single byte is enough and keeps the per-triangle color data small.
+using ColorIndex = std::uint8_t;
+
 /// Custom Triangle type holding the CGAL::Triangle_3 and additional data
 class DataTriangle {
    public:
@@ -25,7 +30,7 @@ class DataTriangle {
     Triangle mTriangleCgal;
 
     /// Color of the triangle in the final STL file
-    size_t mColor;
+    ColorIndex mColor;
 
     /// Normal of the triangle
     glm::vec3 mNormal;
@@ -36,7 +41,9 @@ class DataTriangle {
     DataTriangle() : mColor(0) {}
 
     DataTriangle(const glm::vec3 x, const glm::vec3 y, const glm::vec3 z, const glm::vec3 n, const size_t col = 0)
-        : mTriangleCgal(Point(x.x, x.y, x.z), Point(y.x, y.y, y.z), Point(z.x, z.y, z.z)), mColor(col), mNormal(n) {}
+        : mTriangleCgal(Point(x.x, x.y, x.z), Point(y.x, y.y, y.z), Point(z.x, z.y, z.z)),
+          mColor(static_cast<ColorIndex>(col)),
+          mNormal(n) {}
 
     /// Method used by the AABB conversion functor to make DataTriangle searchable in AABB tree
     const Triangle& getTri() const {
@@ -49,7 +56,7 @@ class DataTriangle {
     }
 
     void setColor(const size_t newColor) {
-        mColor = newColor;
+        mColor = static_cast<ColorIndex>(newColor);
     }
 
     size_t getColor() const {
@@ -61,9 +68,18 @@ class DataTriangle {
     }
 
    private:
+    /// The color is stored as size_t in the archive, to stay compatible with existing files
+    template <class Archive>
+    void save(Archive& ar) const {
+        const size_t color = mColor;
+        ar(mTriangleCgal, color, mNormal);
+    }
+
     template <class Archive>
-    void serialize(Archive& ar) {
-        ar(mTriangleCgal, mColor, mNormal);
+    void load(Archive& ar) {
+        size_t color = 0;
+        ar(mTriangleCgal, color, mNormal);
+        mColor = static_cast<ColorIndex>(color);
     }
 };
 
@@ -0,0 +1,623 @@
+#include "geometry/TriangleBvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <utility>
+
+#include "ThreadPool.h"
+#include "peprassert.h"
+
+namespace pepr3d {
+
+namespace {
+/// Number of bins used to evaluate the surface area heuristic
+const size_t SAH_BIN_COUNT = 12;
+
+/// Meshes with fewer triangles are built on a single thread
+const size_t PARALLEL_BUILD_MIN_TRIANGLES = 1 << 16;
+
+/// Bounds of the slab test are enlarged by this factor, so that rounding never misses a box (Ize 2013)
+const float SLAB_ROBUSTNESS = 1.0f + 2.0f * 3.0f * std::numeric_limits<float>::epsilon();
+}  // namespace
+
+float TriangleBvh::Bounds::area() const {
+    const glm::vec3 extent = max - min;
+    if(extent.x < 0.f || extent.y < 0.f || extent.z < 0.f) {
+        return 0.f;
+    }
+    return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+void TriangleBvh::clear() {
+    mNodes.clear();
+    mTriangles.clear();
+    mTriangleIds.clear();
+}
+
+void TriangleBvh::build(const std::vector<glm::vec3>& vertices, ::ThreadPool* threadPool) {
+    P_ASSERT(vertices.size() % 3 == 0);
+    clear();
+
+    const size_t triangleCount = vertices.size() / 3;
+    if(triangleCount == 0) {
+        return;
+    }
+    if(triangleCount < PARALLEL_BUILD_MIN_TRIANGLES) {
+        threadPool = nullptr;
+    }
+
+    // Calls func(triIdx) for all triangles, in parallel if possible
+    std::vector<size_t> triangleIdxs;
+    if(threadPool) {
+        triangleIdxs.resize(triangleCount);
+        std::iota(triangleIdxs.begin(), triangleIdxs.end(), 0);
+    }
+    const auto forEachTriangle = [threadPool, &triangleIdxs, triangleCount](auto&& func) {
+        if(threadPool) {
+            threadPool->parallel_for(triangleIdxs.begin(), triangleIdxs.end(), func);
+        } else {
+            for(size_t triIdx = 0; triIdx < triangleCount; ++triIdx) {
+                func(triIdx);
+            }
+        }
+    };
+
+    std::vector<Bounds> triangleBounds(triangleCount);
+    std::vector<glm::vec3> centroids(triangleCount);
+    forEachTriangle([&](const size_t triIdx) {
+        for(size_t i = 0; i < 3; ++i) {
+            triangleBounds[triIdx].extend(vertices[3 * triIdx + i]);
+        }
+        centroids[triIdx] = 0.5f * (triangleBounds[triIdx].min + triangleBounds[triIdx].max);
+    });
+
+    mTriangleIds.resize(triangleCount);
+    std::iota(mTriangleIds.begin(), mTriangleIds.end(), 0);
+    mNodes.reserve(triangleCount / LEAF_SIZE + 1);
+
+    if(!threadPool) {
+        buildNode(0, triangleCount, triangleBounds, centroids, mNodes, nullptr, 0);
+    } else {
+        // The top of the hierarchy is split on this thread, until there are enough subtrees for all threads
+        std::vector<DeferredSubtree> deferred;
+        const size_t deferredSize =
+            std::max(PARALLEL_BUILD_MIN_TRIANGLES / 4, triangleCount / (8 * (threadPool->size() + 1)));
+        buildNode(0, triangleCount, triangleBounds, centroids, mNodes, &deferred, deferredSize);
+
+        // Subtrees work on disjoint ranges of mTriangleIds
+        threadPool->parallel_for_weighted(
+            deferred.begin(), deferred.end(),
+            [&](DeferredSubtree& subtree) {
+                buildNode(subtree.begin, subtree.end, triangleBounds, centroids, subtree.nodes, nullptr, 0);
+            },
+            [](const DeferredSubtree& subtree) { return subtree.end - subtree.begin; });
+
+        // Append the subtrees in order, leaves already index the shared mTriangleIds
+        for(DeferredSubtree& subtree : deferred) {
+            const uint32_t offset = static_cast<uint32_t>(mNodes.size());
+            for(Node& node : subtree.nodes) {
+                for(size_t i = 0; i < WIDTH; ++i) {
+                    if(node.valid[i] && node.count[i] == 0) {
+                        node.child[i] += offset;
+                    }
+                }
+            }
+            mNodes.insert(mNodes.end(), subtree.nodes.begin(), subtree.nodes.end());
+            mNodes[subtree.parentNode].child[subtree.parentSlot] = offset;
+        }
+    }
+
+    // Store the vertices in the leaf order, so that a leaf reads continuous memory
+    mTriangles.resize(triangleCount);
+    forEachTriangle([&](const size_t idx) {
+        const uint32_t triIdx = mTriangleIds[idx];
+        mTriangles[idx] = {vertices[3 * triIdx], vertices[3 * triIdx + 1], vertices[3 * triIdx + 2]};
+    });
+}
+
+void TriangleBvh::getFlatLayout(std::vector<glm::vec4>& nodes, std::vector<glm::vec4>& triangles) const {
+    nodes.clear();
+    nodes.reserve(2 * WIDTH * mNodes.size());
+    for(const Node& node : mNodes) {
+        for(size_t i = 0; i < WIDTH; ++i) {
+            const uint32_t count = node.valid[i] ? node.count[i] : INVALID_CHILD_COUNT;
+            nodes.emplace_back(node.minX[i], node.minY[i], node.minZ[i], glm::uintBitsToFloat(node.child[i]));
+            nodes.emplace_back(node.maxX[i], node.maxY[i], node.maxZ[i], glm::uintBitsToFloat(count));
+        }
+    }
+
+    triangles.clear();
+    triangles.reserve(3 * mTriangles.size());
+    for(size_t idx = 0; idx < mTriangles.size(); ++idx) {
+        triangles.emplace_back(mTriangles[idx][0], glm::uintBitsToFloat(mTriangleIds[idx]));
+        triangles.emplace_back(mTriangles[idx][1], 0.f);
+        triangles.emplace_back(mTriangles[idx][2], 0.f);
+    }
+}
+
+uint32_t TriangleBvh::buildNode(const size_t begin, const size_t end, const std::vector<Bounds>& triangleBounds,
+                                const std::vector<glm::vec3>& centroids, std::vector<Node>& nodes,
+                                std::vector<DeferredSubtree>* deferred, const size_t deferredSize) {
+    P_ASSERT(begin < end);
+
+    // Split the largest range until there is a range for each child
+    std::vector<std::pair<size_t, size_t>> ranges{{begin, end}};
+    while(ranges.size() < WIDTH) {
+        auto largestIt = std::max_element(ranges.begin(), ranges.end(), [](const auto& a, const auto& b) {
+            return a.second - a.first < b.second - b.first;
+        });
+        if(largestIt->second - largestIt->first <= LEAF_SIZE) {
+            break;
+        }
+
+        const std::pair<size_t, size_t> range = *largestIt;
+        const size_t split = splitRange(range.first, range.second, triangleBounds, centroids);
+        *largestIt = {range.first, split};
+        ranges.emplace_back(split, range.second);
+    }
+
+    const uint32_t nodeIdx = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+    for(size_t i = 0; i < WIDTH; ++i) {
+        Bounds bounds;
+        uint32_t child = 0;
+        uint32_t count = 0;
+        const bool valid = i < ranges.size();
+        if(valid) {
+            const size_t rangeBegin = ranges[i].first;
+            const size_t rangeEnd = ranges[i].second;
+            for(size_t idx = rangeBegin; idx < rangeEnd; ++idx) {
+                bounds.extend(triangleBounds[mTriangleIds[idx]]);
+            }
+
+            if(rangeEnd - rangeBegin <= LEAF_SIZE) {
+                child = static_cast<uint32_t>(rangeBegin);
+                count = static_cast<uint32_t>(rangeEnd - rangeBegin);
+            } else if(deferred && rangeEnd - rangeBegin <= deferredSize) {
+                // Linked once the subtree is built
+                deferred->push_back({nodeIdx, i, rangeBegin, rangeEnd, {}});
+            } else {
+                child = buildNode(rangeBegin, rangeEnd, triangleBounds, centroids, nodes, deferred, deferredSize);
+            }
+        }
+
+        // The recursion may have reallocated the nodes
+        Node& node = nodes[nodeIdx];
+        node.minX[i] = bounds.min.x;
+        node.minY[i] = bounds.min.y;
+        node.minZ[i] = bounds.min.z;
+        node.maxX[i] = bounds.max.x;
+        node.maxY[i] = bounds.max.y;
+        node.maxZ[i] = bounds.max.z;
+        node.child[i] = child;
+        node.count[i] = count;
+        node.valid[i] = valid;
+    }
+
+    return nodeIdx;
+}
+
+size_t TriangleBvh::splitRange(const size_t begin, const size_t end, const std::vector<Bounds>& triangleBounds,
+                               const std::vector<glm::vec3>& centroids) {
+    P_ASSERT(end - begin > 1);
+    const size_t middle = begin + (end - begin) / 2;
+
+    Bounds centroidBounds;
+    for(size_t idx = begin; idx < end; ++idx) {
+        centroidBounds.extend(centroids[mTriangleIds[idx]]);
+    }
+    const glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+    const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+    if(extent[axis] <= 0.f) {
+        // All centroids are the same, any split is as good as another
+        return middle;
+    }
+
+    const auto getBin = [&](const uint32_t triIdx) {
+        const float position = (centroids[triIdx][axis] - centroidBounds.min[axis]) / extent[axis];
+        return std::min(SAH_BIN_COUNT - 1, static_cast<size_t>(position * SAH_BIN_COUNT));
+    };
+
+    std::array<Bounds, SAH_BIN_COUNT> binBounds;
+    std::array<size_t, SAH_BIN_COUNT> binCounts{};
+    for(size_t idx = begin; idx < end; ++idx) {
+        const size_t bin = getBin(mTriangleIds[idx]);
+        binBounds[bin].extend(triangleBounds[mTriangleIds[idx]]);
+        ++binCounts[bin];
+    }
+
+    // Cost of the split after each bin is area * count on both sides
+    std::array<float, SAH_BIN_COUNT> leftCosts{};
+    Bounds leftBounds;
+    size_t leftCount = 0;
+    for(size_t bin = 0; bin + 1 < SAH_BIN_COUNT; ++bin) {
+        leftBounds.extend(binBounds[bin]);
+        leftCount += binCounts[bin];
+        leftCosts[bin] = leftBounds.area() * static_cast<float>(leftCount);
+    }
+
+    size_t bestBin = 0;
+    float bestCost = std::numeric_limits<float>::max();
+    Bounds rightBounds;
+    size_t rightCount = 0;
+    for(size_t bin = SAH_BIN_COUNT - 1; bin > 0; --bin) {
+        rightBounds.extend(binBounds[bin]);
+        rightCount += binCounts[bin];
+        const float cost = leftCosts[bin - 1] + rightBounds.area() * static_cast<float>(rightCount);
+        if(cost < bestCost) {
+            bestCost = cost;
+            bestBin = bin;
+        }
+    }
+
+    const auto splitIt = std::partition(mTriangleIds.begin() + begin, mTriangleIds.begin() + end,
+                                        [&](const uint32_t triIdx) { return getBin(triIdx) < bestBin; });
+    const size_t split = static_cast<size_t>(splitIt - mTriangleIds.begin());
+    if(split == begin || split == end) {
+        // Degenerate distribution, fall back to a median split
+        std::nth_element(mTriangleIds.begin() + begin, mTriangleIds.begin() + middle, mTriangleIds.begin() + end,
+                         [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+        return middle;
+    }
+    return split;
+}
+
+std::optional<TriangleBvh::Hit> TriangleBvh::intersect(const glm::vec3& origin, const glm::vec3& direction) const {
+    if(mNodes.empty()) {
+        return {};
+    }
+
+    const glm::vec3 invDirection = 1.f / direction;
+
+    struct StackEntry {
+        uint32_t child;
+        uint32_t count;
+        float distance;
+    };
+    std::vector<StackEntry> stack;
+    stack.reserve(64);
+    stack.push_back({0, 0, 0.f});
+
+    std::optional<Hit> closest;
+    float closestDistance = std::numeric_limits<float>::max();
+
+    while(!stack.empty()) {
+        const StackEntry entry = stack.back();
+        stack.pop_back();
+        if(entry.distance > closestDistance) {
+            continue;
+        }
+
+        if(entry.count > 0) {
+            for(uint32_t idx = entry.child; idx < entry.child + entry.count; ++idx) {
+                const std::optional<float> distance = intersectTriangle(origin, direction, mTriangles[idx]);
+                if(distance && *distance < closestDistance) {
+                    closestDistance = *distance;
+                    closest = Hit{mTriangleIds[idx], *distance};
+                }
+            }
+            continue;
+        }
+
+        const Node& node = mNodes[entry.child];
+        std::array<float, WIDTH> entryDistance;
+        std::array<bool, WIDTH> isHit;
+        intersectChildren(node, origin, invDirection, closestDistance, entryDistance, isHit);
+
+        // Push the far children first, so that the closest one is traversed next
+        std::array<size_t, WIDTH> order;
+        size_t hitCount = 0;
+        for(size_t i = 0; i < WIDTH; ++i) {
+            if(isHit[i]) {
+                order[hitCount++] = i;
+            }
+        }
+        for(size_t i = 1; i < hitCount; ++i) {
+            for(size_t j = i; j > 0 && entryDistance[order[j - 1]] < entryDistance[order[j]]; --j) {
+                std::swap(order[j - 1], order[j]);
+            }
+        }
+        for(size_t i = 0; i < hitCount; ++i) {
+            stack.push_back({node.child[order[i]], node.count[order[i]], entryDistance[order[i]]});
+        }
+    }
+
+    return closest;
+}
+
+std::vector<std::optional<TriangleBvh::Hit>> TriangleBvh::intersect(const std::vector<glm::vec3>& origins,
+                                                                   const std::vector<glm::vec3>& directions) const {
+    P_ASSERT(origins.size() == directions.size());
+    std::vector<std::optional<Hit>> hits(origins.size());
+    for(size_t begin = 0; begin < origins.size(); begin += PACKET_SIZE) {
+        const size_t count = std::min(PACKET_SIZE, origins.size() - begin);
+        intersectPacket(&origins[begin], &directions[begin], count, &hits[begin]);
+    }
+    return hits;
+}
+
+void TriangleBvh::intersectPacket(const glm::vec3* origins, const glm::vec3* directions, const size_t count,
+                                  std::optional<Hit>* hits) const {
+    P_ASSERT(count > 0 && count <= PACKET_SIZE);
+    if(mNodes.empty()) {
+        return;
+    }
+
+    // Bit i of a mask is set when the ray i is active
+    using RayMask = uint32_t;
+    static_assert(PACKET_SIZE <= sizeof(RayMask) * 8, "Ray mask too small for the packet");
+
+    std::array<glm::vec3, PACKET_SIZE> invDirections;
+    std::array<float, PACKET_SIZE> closestDistance;
+    for(size_t ray = 0; ray < count; ++ray) {
+        invDirections[ray] = 1.f / directions[ray];
+        closestDistance[ray] = std::numeric_limits<float>::max();
+    }
+
+    struct StackEntry {
+        uint32_t child;
+        uint32_t count;
+        RayMask rays;
+    };
+    std::vector<StackEntry> stack;
+    stack.reserve(64);
+    stack.push_back({0, 0, static_cast<RayMask>((RayMask{1} << count) - 1)});
+
+    while(!stack.empty()) {
+        const StackEntry entry = stack.back();
+        stack.pop_back();
+
+        if(entry.count > 0) {
+            for(uint32_t idx = entry.child; idx < entry.child + entry.count; ++idx) {
+                for(size_t ray = 0; ray < count; ++ray) {
+                    if(!(entry.rays & (RayMask{1} << ray))) {
+                        continue;
+                    }
+                    const std::optional<float> distance =
+                        intersectTriangle(origins[ray], directions[ray], mTriangles[idx]);
+                    if(distance && *distance < closestDistance[ray]) {
+                        closestDistance[ray] = *distance;
+                        hits[ray] = Hit{mTriangleIds[idx], *distance};
+                    }
+                }
+            }
+            continue;
+        }
+
+        // Each child is visited by the rays that hit it, ordered by the closest entry of any of them
+        const Node& node = mNodes[entry.child];
+        std::array<RayMask, WIDTH> childRays{};
+        std::array<float, WIDTH> childDistance;
+        childDistance.fill(std::numeric_limits<float>::max());
+        for(size_t ray = 0; ray < count; ++ray) {
+            if(!(entry.rays & (RayMask{1} << ray))) {
+                continue;
+            }
+            std::array<float, WIDTH> entryDistance;
+            std::array<bool, WIDTH> isHit;
+            intersectChildren(node, origins[ray], invDirections[ray], closestDistance[ray], entryDistance, isHit);
+            for(size_t i = 0; i < WIDTH; ++i) {
+                if(isHit[i]) {
+                    childRays[i] |= RayMask{1} << ray;
+                    childDistance[i] = std::min(childDistance[i], entryDistance[i]);
+                }
+            }
+        }
+
+        std::array<size_t, WIDTH> order;
+        size_t hitCount = 0;
+        for(size_t i = 0; i < WIDTH; ++i) {
+            if(childRays[i] != 0) {
+                order[hitCount++] = i;
+            }
+        }
+        for(size_t i = 1; i < hitCount; ++i) {
+            for(size_t j = i; j > 0 && childDistance[order[j - 1]] < childDistance[order[j]]; --j) {
+                std::swap(order[j - 1], order[j]);
+            }
+        }
+        for(size_t i = 0; i < hitCount; ++i) {
+            stack.push_back({node.child[order[i]], node.count[order[i]], childRays[order[i]]});
+        }
+    }
+}
+
+std::optional<TriangleBvh::Hit> TriangleBvh::findClosest(const glm::vec3& point) const {
+    if(mNodes.empty()) {
+        return {};
+    }
+
+    struct StackEntry {
+        uint32_t child;
+        uint32_t count;
+        float squaredDistance;
+    };
+    std::vector<StackEntry> stack;
+    stack.reserve(64);
+    stack.push_back({0, 0, 0.f});
+
+    std::optional<Hit> closest;
+    float closestSquaredDistance = std::numeric_limits<float>::max();
+
+    while(!stack.empty()) {
+        const StackEntry entry = stack.back();
+        stack.pop_back();
+        if(entry.squaredDistance > closestSquaredDistance) {
+            continue;
+        }
+
+        if(entry.count > 0) {
+            for(uint32_t idx = entry.child; idx < entry.child + entry.count; ++idx) {
+                const glm::vec3 offset = closestPointOnTriangle(point, mTriangles[idx]) - point;
+                const float squaredDistance = glm::dot(offset, offset);
+                if(squaredDistance < closestSquaredDistance) {
+                    closestSquaredDistance = squaredDistance;
+                    closest = Hit{mTriangleIds[idx], 0.f};
+                }
+            }
+            continue;
+        }
+
+        // Squared distance to the box of each child, boxes further than the closest triangle are skipped
+        const Node& node = mNodes[entry.child];
+        std::array<float, WIDTH> boxDistance;
+        std::array<size_t, WIDTH> order;
+        size_t nearCount = 0;
+        for(size_t i = 0; i < WIDTH; ++i) {
+            const float dx = std::max({node.minX[i] - point.x, 0.f, point.x - node.maxX[i]});
+            const float dy = std::max({node.minY[i] - point.y, 0.f, point.y - node.maxY[i]});
+            const float dz = std::max({node.minZ[i] - point.z, 0.f, point.z - node.maxZ[i]});
+            boxDistance[i] = dx * dx + dy * dy + dz * dz;
+            if(node.valid[i] && boxDistance[i] <= closestSquaredDistance) {
+                order[nearCount++] = i;
+            }
+        }
+
+        // Push the far children first, so that the closest one is traversed next
+        for(size_t i = 1; i < nearCount; ++i) {
+            for(size_t j = i; j > 0 && boxDistance[order[j - 1]] < boxDistance[order[j]]; --j) {
+                std::swap(order[j - 1], order[j]);
+            }
+        }
+        for(size_t i = 0; i < nearCount; ++i) {
+            stack.push_back({node.child[order[i]], node.count[order[i]], boxDistance[order[i]]});
+        }
+    }
+
+    if(closest) {
+        closest->distance = std::sqrt(closestSquaredDistance);
+    }
+    return closest;
+}
+
+glm::vec3 TriangleBvh::closestPointOnTriangle(const glm::vec3& point, const std::array<glm::vec3, 3>& triangle) {
+    const glm::vec3& a = triangle[0];
+    const glm::vec3& b = triangle[1];
+    const glm::vec3& c = triangle[2];
+    const glm::vec3 ab = b - a;
+    const glm::vec3 ac = c - a;
+
+    // Vertex regions, then edge regions, then the face, by the barycentric coordinates of the projection
+    const glm::vec3 ap = point - a;
+    const float d1 = glm::dot(ab, ap);
+    const float d2 = glm::dot(ac, ap);
+    if(d1 <= 0.f && d2 <= 0.f) {
+        return a;
+    }
+
+    const glm::vec3 bp = point - b;
+    const float d3 = glm::dot(ab, bp);
+    const float d4 = glm::dot(ac, bp);
+    if(d3 >= 0.f && d4 <= d3) {
+        return b;
+    }
+
+    const float vc = d1 * d4 - d3 * d2;
+    if(vc <= 0.f && d1 >= 0.f && d3 <= 0.f) {
+        return a + ab * (d1 / (d1 - d3));
+    }
+
+    const glm::vec3 cp = point - c;
+    const float d5 = glm::dot(ab, cp);
+    const float d6 = glm::dot(ac, cp);
+    if(d6 >= 0.f && d5 <= d6) {
+        return c;
+    }
+
+    const float vb = d5 * d2 - d1 * d6;
+    if(vb <= 0.f && d2 >= 0.f && d6 <= 0.f) {
+        return a + ac * (d2 / (d2 - d6));
+    }
+
+    const float va = d3 * d6 - d5 * d4;
+    if(va <= 0.f && d4 - d3 >= 0.f && d5 - d6 >= 0.f) {
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+
+    const float sum = va + vb + vc;
+    if(sum <= 0.f) {
+        // Degenerate triangle with all regions empty
+        return a;
+    }
+    return a + ab * (vb / sum) + ac * (vc / sum);
+}
+
+void TriangleBvh::intersectChildren(const Node& node, const glm::vec3& origin, const glm::vec3& invDirection,
+                                    const float maxDistance, std::array<float, WIDTH>& entryDistance,
+                                    std::array<bool, WIDTH>& isHit) {
+    for(size_t i = 0; i < WIDTH; ++i) {
+        const float x0 = (node.minX[i] - origin.x) * invDirection.x;
+        const float x1 = (node.maxX[i] - origin.x) * invDirection.x;
+        const float y0 = (node.minY[i] - origin.y) * invDirection.y;
+        const float y1 = (node.maxY[i] - origin.y) * invDirection.y;
+        const float z0 = (node.minZ[i] - origin.z) * invDirection.z;
+        const float z1 = (node.maxZ[i] - origin.z) * invDirection.z;
+        const float tEnter = std::max({std::min(x0, x1), std::min(y0, y1), std::min(z0, z1), 0.f});
+        const float tExit = std::min({std::max(x0, x1), std::max(y0, y1), std::max(z0, z1)}) * SLAB_ROBUSTNESS;
+        entryDistance[i] = tEnter;
+        isHit[i] = node.valid[i] && tEnter <= tExit && tEnter <= maxDistance;
+    }
+}
+
+std::optional<float> TriangleBvh::intersectTriangle(const glm::vec3& origin, const glm::vec3& direction,
+                                                    const std::array<glm::vec3, 3>& triangle) {
+    // Permute the axes, so that the largest component of the direction is z
+    const glm::vec3 absDirection = glm::abs(direction);
+    int kz = 2;
+    if(absDirection.x >= absDirection.y && absDirection.x >= absDirection.z) {
+        kz = 0;
+    } else if(absDirection.y >= absDirection.z) {
+        kz = 1;
+    }
+    int kx = (kz + 1) % 3;
+    int ky = (kx + 1) % 3;
+    if(direction[kz] < 0.f) {
+        std::swap(kx, ky);
+    }
+    if(direction[kz] == 0.f) {
+        return {};
+    }
+
+    // Shear transformation, the ray becomes the z axis
+    const float sx = direction[kx] / direction[kz];
+    const float sy = direction[ky] / direction[kz];
+    const float sz = 1.f / direction[kz];
+
+    const glm::vec3 a = triangle[0] - origin;
+    const glm::vec3 b = triangle[1] - origin;
+    const glm::vec3 c = triangle[2] - origin;
+    const float ax = a[kx] - sx * a[kz];
+    const float ay = a[ky] - sy * a[kz];
+    const float bx = b[kx] - sx * b[kz];
+    const float by = b[ky] - sy * b[kz];
+    const float cx = c[kx] - sx * c[kz];
+    const float cy = c[ky] - sy * c[kz];
+
+    // Scaled barycentric coordinates, recomputed in double precision on edges
+    float u = cx * by - cy * bx;
+    float v = ax * cy - ay * cx;
+    float w = bx * ay - by * ax;
+    if(u == 0.f || v == 0.f || w == 0.f) {
+        u = static_cast<float>(static_cast<double>(cx) * by - static_cast<double>(cy) * bx);
+        v = static_cast<float>(static_cast<double>(ax) * cy - static_cast<double>(ay) * cx);
+        w = static_cast<float>(static_cast<double>(bx) * ay - static_cast<double>(by) * ax);
+    }
+
+    if((u < 0.f || v < 0.f || w < 0.f) && (u > 0.f || v > 0.f || w > 0.f)) {
+        return {};
+    }
+
+    const float determinant = u + v + w;
+    if(determinant == 0.f) {
+        return {};
+    }
+
+    const float t = (u * sz * a[kz] + v * sz * b[kz] + w * sz * c[kz]) / determinant;
+    if(t < 0.f) {
+        return {};
+    }
+    return t;
+}
+
+}  // namespace pepr3d
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <limits>
+#include <optional>
+#include <vector>
+
+class ThreadPool;
+
+namespace pepr3d {
+
+/// Bounding volume hierarchy over float triangles, used for picking triangles with rays and for finding the closest
+/// triangles to points.
+/// Built with the surface area heuristic. Every node has up to 4 children with bounds stored as
+/// structure of arrays, so that all 4 children are tested with the same instructions.
+/// Triangles are tested with a watertight ray-triangle test, rays never slip between neighbouring triangles.
+/// Exact CGAL types are not used, painting still works with the exact triangles of Geometry.
+class TriangleBvh {
+   public:
+    static const size_t WIDTH = 4;
+
+    /// Maximum number of triangles in a leaf
+    static const size_t LEAF_SIZE = 4;
+
+    /// Number of rays traced together by the packet traversal
+    static const size_t PACKET_SIZE = 8;
+
+    /// Count of an unused child slot in the flat layout
+    static constexpr uint32_t INVALID_CHILD_COUNT = std::numeric_limits<uint32_t>::max();
+
+    struct Hit {
+        /// Index of the triangle, in the order in which the triangles were given to build()
+        size_t triangleIdx;
+
+        /// Ray parameter of the hit, distance from the origin in multiples of the direction
+        float distance;
+    };
+
+    /// Build the hierarchy over triangles, vertices contains 3 consecutive vertices for each triangle.
+    /// With a thread pool, subtrees of large meshes are built in parallel, the result is the same.
+    void build(const std::vector<glm::vec3>& vertices, ::ThreadPool* threadPool = nullptr);
+
+    void clear();
+
+    size_t size() const {
+        return mTriangleIds.size();
+    }
+
+    bool empty() const {
+        return mTriangleIds.empty();
+    }
+
+    /// Rough estimate of the memory taken by the hierarchy in bytes
+    size_t getApproximateMemorySize() const {
+        return sizeof(TriangleBvh) + mNodes.capacity() * sizeof(Node) +
+               mTriangles.capacity() * sizeof(std::array<glm::vec3, 3>) + mTriangleIds.capacity() * sizeof(uint32_t);
+    }
+
+    /// Find the closest triangle hit by the ray, the ray starts at origin
+    std::optional<Hit> intersect(const glm::vec3& origin, const glm::vec3& direction) const;
+
+    /// Find the closest triangle hit by each ray, the result is in the order of the rays.
+    /// Consecutive rays are traced in packets of PACKET_SIZE sharing one traversal, so coherent rays
+    /// (e.g. the rays of a brush stroke) load each node only once.
+    std::vector<std::optional<Hit>> intersect(const std::vector<glm::vec3>& origins,
+                                              const std::vector<glm::vec3>& directions) const;
+
+    /// Find the triangle closest to the point, the distance of the hit is the Euclidean distance from the point
+    std::optional<Hit> findClosest(const glm::vec3& point) const;
+
+    /// Copy the hierarchy into flat arrays of vec4, e.g. for uploading it to the GPU.
+    /// Every node takes 2 * WIDTH vec4, a pair for each child slot: (min, child) and (max, count), child and count
+    /// are the bits of the uint32_t stored in w, count is INVALID_CHILD_COUNT for unused slots. The root is node 0.
+    /// Every triangle takes 3 vec4 in the leaf order, w of the first vertex holds the bits of the original index.
+    void getFlatLayout(std::vector<glm::vec4>& nodes, std::vector<glm::vec4>& triangles) const;
+
+    /// Method to allow the Cereal library to serialize the hierarchy, the including code provides the cereal types
+    template <class Archive>
+    void serialize(Archive& archive) {
+        archive(mNodes, mTriangles, mTriangleIds);
+    }
+
+    /// Watertight ray-triangle test (Woop, Benthin, Wald 2013), returns the ray parameter of the hit
+    static std::optional<float> intersectTriangle(const glm::vec3& origin, const glm::vec3& direction,
+                                                  const std::array<glm::vec3, 3>& triangle);
+
+    /// Closest point of the triangle to the point (Ericson 2005, section 5.1.5)
+    static glm::vec3 closestPointOnTriangle(const glm::vec3& point, const std::array<glm::vec3, 3>& triangle);
+
+   private:
+    struct Node {
+        std::array<float, WIDTH> minX, minY, minZ;
+        std::array<float, WIDTH> maxX, maxY, maxZ;
+
+        /// Index of the child node, or of the first triangle of a leaf
+        std::array<uint32_t, WIDTH> child;
+
+        /// Number of triangles of a leaf, 0 for inner nodes
+        std::array<uint32_t, WIDTH> count;
+
+        /// Is the child slot used
+        std::array<bool, WIDTH> valid;
+
+        template <class Archive>
+        void serialize(Archive& archive) {
+            archive(minX, minY, minZ, maxX, maxY, maxZ, child, count, valid);
+        }
+    };
+
+    struct Bounds {
+        glm::vec3 min{std::numeric_limits<float>::max()};
+        glm::vec3 max{std::numeric_limits<float>::lowest()};
+
+        void extend(const glm::vec3& point) {
+            min = glm::min(min, point);
+            max = glm::max(max, point);
+        }
+
+        void extend(const Bounds& other) {
+            min = glm::min(min, other.min);
+            max = glm::max(max, other.max);
+        }
+
+        float area() const;
+    };
+
+    /// Slab test of the ray against all children of the node, children further than maxDistance are missed
+    static void intersectChildren(const Node& node, const glm::vec3& origin, const glm::vec3& invDirection,
+                                  float maxDistance, std::array<float, WIDTH>& entryDistance,
+                                  std::array<bool, WIDTH>& isHit);
+
+    /// Trace up to PACKET_SIZE rays together, hits are written to the first count elements of hits
+    void intersectPacket(const glm::vec3* origins, const glm::vec3* directions, size_t count,
+                         std::optional<Hit>* hits) const;
+
+    /// Subtree built separately from the top of the hierarchy, then appended to mNodes
+    struct DeferredSubtree {
+        /// Node and child slot the subtree root is linked to
+        uint32_t parentNode;
+        size_t parentSlot;
+
+        /// Range of mTriangleIds of the subtree
+        size_t begin;
+        size_t end;
+
+        /// Nodes of the subtree, child indices are local to this vector
+        std::vector<Node> nodes;
+    };
+
+    /// Build a node for the triangles in [begin, end) of mTriangleIds into nodes, returns its index.
+    /// Bounds and centroids are indexed by the original triangle index.
+    /// If deferred is set, children with at most deferredSize triangles are not built, but added to deferred.
+    uint32_t buildNode(size_t begin, size_t end, const std::vector<Bounds>& triangleBounds,
+                       const std::vector<glm::vec3>& centroids, std::vector<Node>& nodes,
+                       std::vector<DeferredSubtree>* deferred, size_t deferredSize);
+
+    /// Split [begin, end) of mTriangleIds into two parts using binned SAH, returns the split position
+    size_t splitRange(size_t begin, size_t end, const std::vector<Bounds>& triangleBounds,
+                      const std::vector<glm::vec3>& centroids);
+
+    std::vector<Node> mNodes;
+
+    /// Triangle vertices in the leaf order
+    std::vector<std::array<glm::vec3, 3>> mTriangles;
+
+    /// Original index of every triangle of mTriangles
+    std::vector<uint32_t> mTriangleIds;
+};
+
+}  // namespace pepr3d
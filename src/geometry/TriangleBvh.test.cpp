@@ -0,0 +1,321 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/array.hpp>
+#include <cereal/types/vector.hpp>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "geometry/GlmSerialization.h"
+#include "geometry/TriangleBvh.h"
+
+TEST(TriangleBvh, matchesLinearScan) {
+    /**
+     * Test that the hierarchy finds the same closest triangle as testing all of them
+     */
+
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> position(-5.f, 5.f);
+    std::uniform_real_distribution<float> offset(-0.3f, 0.3f);
+
+    std::vector<glm::vec3> vertices;
+    for(size_t triIdx = 0; triIdx < 2000; ++triIdx) {
+        const glm::vec3 center(position(generator), position(generator), position(generator));
+        for(size_t i = 0; i < 3; ++i) {
+            vertices.push_back(center + glm::vec3(offset(generator), offset(generator), offset(generator)));
+        }
+    }
+    pepr3d::TriangleBvh bvh;
+    bvh.build(vertices);
+    ASSERT_EQ(bvh.size(), vertices.size() / 3);
+
+    size_t hitCount = 0;
+    for(size_t rayIdx = 0; rayIdx < 200; ++rayIdx) {
+        const glm::vec3 origin(position(generator), position(generator), -10.f);
+        const glm::vec3 direction(offset(generator), offset(generator), 1.f);
+
+        std::optional<float> expectedDistance;
+        for(size_t triIdx = 0; triIdx < vertices.size() / 3; ++triIdx) {
+            const auto distance = pepr3d::TriangleBvh::intersectTriangle(
+                origin, direction, {vertices[3 * triIdx], vertices[3 * triIdx + 1], vertices[3 * triIdx + 2]});
+            if(distance && (!expectedDistance || *distance < *expectedDistance)) {
+                expectedDistance = distance;
+            }
+        }
+
+        const auto hit = bvh.intersect(origin, direction);
+        ASSERT_EQ(hit.has_value(), expectedDistance.has_value());
+        if(hit) {
+            EXPECT_EQ(hit->distance, *expectedDistance);
+            ++hitCount;
+        }
+    }
+    EXPECT_GT(hitCount, 0);
+}
+
+TEST(TriangleBvh, closestMatchesLinearScan) {
+    /**
+     * Test that the hierarchy finds a triangle as close to each point as the closest of all triangles
+     */
+
+    std::mt19937 generator(19);
+    std::uniform_real_distribution<float> position(-5.f, 5.f);
+    std::uniform_real_distribution<float> offset(-0.3f, 0.3f);
+
+    std::vector<glm::vec3> vertices;
+    for(size_t triIdx = 0; triIdx < 2000; ++triIdx) {
+        const glm::vec3 center(position(generator), position(generator), position(generator));
+        for(size_t i = 0; i < 3; ++i) {
+            vertices.push_back(center + glm::vec3(offset(generator), offset(generator), offset(generator)));
+        }
+    }
+    pepr3d::TriangleBvh bvh;
+    bvh.build(vertices);
+
+    for(size_t pointIdx = 0; pointIdx < 200; ++pointIdx) {
+        const glm::vec3 point(2.f * position(generator), 2.f * position(generator), 2.f * position(generator));
+        float expectedDistance = std::numeric_limits<float>::max();
+        for(size_t triIdx = 0; triIdx < vertices.size() / 3; ++triIdx) {
+            const glm::vec3 closest = pepr3d::TriangleBvh::closestPointOnTriangle(
+                point, {vertices[3 * triIdx], vertices[3 * triIdx + 1], vertices[3 * triIdx + 2]});
+            expectedDistance = std::min(expectedDistance, glm::length(closest - point));
+        }
+
+        const auto hit = bvh.findClosest(point);
+        ASSERT_TRUE(hit.has_value());
+        EXPECT_FLOAT_EQ(hit->distance, expectedDistance);
+    }
+
+    // The closest point of a triangle is on it, or the point itself when the point lies in the triangle
+    const std::array<glm::vec3, 3> triangle{glm::vec3(0, 0, 0), glm::vec3(2, 0, 0), glm::vec3(0, 2, 0)};
+    EXPECT_EQ(pepr3d::TriangleBvh::closestPointOnTriangle(glm::vec3(0.5f, 0.5f, 3.f), triangle),
+              glm::vec3(0.5f, 0.5f, 0.f));
+    EXPECT_EQ(pepr3d::TriangleBvh::closestPointOnTriangle(glm::vec3(-1.f, -1.f, 0.f), triangle), triangle[0]);
+    EXPECT_EQ(pepr3d::TriangleBvh::closestPointOnTriangle(glm::vec3(1.f, -1.f, 0.f), triangle),
+              glm::vec3(1.f, 0.f, 0.f));
+    EXPECT_FALSE(pepr3d::TriangleBvh().findClosest(glm::vec3(0.f)).has_value());
+}
+
+TEST(TriangleBvh, packetMatchesSingleRays) {
+    /**
+     * Test that tracing rays in packets gives the same hits as tracing them one by one
+     */
+
+    std::mt19937 generator(11);
+    std::uniform_real_distribution<float> position(-5.f, 5.f);
+    std::uniform_real_distribution<float> offset(-0.3f, 0.3f);
+
+    std::vector<glm::vec3> vertices;
+    for(size_t triIdx = 0; triIdx < 2000; ++triIdx) {
+        const glm::vec3 center(position(generator), position(generator), position(generator));
+        for(size_t i = 0; i < 3; ++i) {
+            vertices.push_back(center + glm::vec3(offset(generator), offset(generator), offset(generator)));
+        }
+    }
+    pepr3d::TriangleBvh bvh;
+    bvh.build(vertices);
+
+    // A stroke of neighbouring rays, not a multiple of the packet size
+    std::vector<glm::vec3> origins;
+    std::vector<glm::vec3> directions;
+    for(size_t rayIdx = 0; rayIdx < 3 * pepr3d::TriangleBvh::PACKET_SIZE + 3; ++rayIdx) {
+        origins.emplace_back(-4.f + 0.1f * rayIdx, position(generator), -10.f);
+        directions.emplace_back(offset(generator), offset(generator), 1.f);
+    }
+
+    const auto hits = bvh.intersect(origins, directions);
+    ASSERT_EQ(hits.size(), origins.size());
+    for(size_t rayIdx = 0; rayIdx < origins.size(); ++rayIdx) {
+        const auto expected = bvh.intersect(origins[rayIdx], directions[rayIdx]);
+        ASSERT_EQ(hits[rayIdx].has_value(), expected.has_value());
+        if(expected) {
+            EXPECT_EQ(hits[rayIdx]->triangleIdx, expected->triangleIdx);
+            EXPECT_EQ(hits[rayIdx]->distance, expected->distance);
+        }
+    }
+
+    EXPECT_TRUE(pepr3d::TriangleBvh().intersect(origins, directions)[0] == std::nullopt);
+}
+
+TEST(TriangleBvh, parallelBuild) {
+    /**
+     * Test that building large hierarchies in parallel gives the same hits as building them on one thread
+     */
+
+    std::mt19937 generator(13);
+    std::uniform_real_distribution<float> position(-5.f, 5.f);
+    std::uniform_real_distribution<float> offset(-0.05f, 0.05f);
+
+    std::vector<glm::vec3> vertices;
+    for(size_t triIdx = 0; triIdx < 200000; ++triIdx) {
+        const glm::vec3 center(position(generator), position(generator), position(generator));
+        for(size_t i = 0; i < 3; ++i) {
+            vertices.push_back(center + glm::vec3(offset(generator), offset(generator), offset(generator)));
+        }
+    }
+
+    pepr3d::TriangleBvh serialBvh;
+    serialBvh.build(vertices);
+    ::ThreadPool threadPool(4);
+    pepr3d::TriangleBvh parallelBvh;
+    parallelBvh.build(vertices, &threadPool);
+    ASSERT_EQ(parallelBvh.size(), serialBvh.size());
+
+    size_t hitCount = 0;
+    for(size_t rayIdx = 0; rayIdx < 500; ++rayIdx) {
+        const glm::vec3 origin(position(generator), position(generator), -10.f);
+        const glm::vec3 direction(offset(generator), offset(generator), 1.f);
+        const auto expected = serialBvh.intersect(origin, direction);
+        const auto hit = parallelBvh.intersect(origin, direction);
+        ASSERT_EQ(hit.has_value(), expected.has_value());
+        if(hit) {
+            EXPECT_EQ(hit->triangleIdx, expected->triangleIdx);
+            EXPECT_EQ(hit->distance, expected->distance);
+            ++hitCount;
+        }
+    }
+    EXPECT_GT(hitCount, 0);
+}
+
+TEST(TriangleBvh, serialization) {
+    /**
+     * Test that a saved and loaded hierarchy finds the same hits as the one that was saved
+     */
+
+    std::mt19937 generator(17);
+    std::uniform_real_distribution<float> position(-5.f, 5.f);
+    std::uniform_real_distribution<float> offset(-0.3f, 0.3f);
+
+    std::vector<glm::vec3> vertices;
+    for(size_t triIdx = 0; triIdx < 1000; ++triIdx) {
+        const glm::vec3 center(position(generator), position(generator), position(generator));
+        for(size_t i = 0; i < 3; ++i) {
+            vertices.push_back(center + glm::vec3(offset(generator), offset(generator), offset(generator)));
+        }
+    }
+    pepr3d::TriangleBvh bvh;
+    bvh.build(vertices);
+
+    std::stringstream stream;
+    {
+        cereal::BinaryOutputArchive archive(stream);
+        archive(bvh);
+    }
+    pepr3d::TriangleBvh loaded;
+    {
+        cereal::BinaryInputArchive archive(stream);
+        archive(loaded);
+    }
+    ASSERT_EQ(loaded.size(), bvh.size());
+
+    size_t hitCount = 0;
+    for(size_t rayIdx = 0; rayIdx < 200; ++rayIdx) {
+        const glm::vec3 origin(position(generator), position(generator), -10.f);
+        const glm::vec3 direction(offset(generator), offset(generator), 1.f);
+        const auto expected = bvh.intersect(origin, direction);
+        const auto hit = loaded.intersect(origin, direction);
+        ASSERT_EQ(hit.has_value(), expected.has_value());
+        if(hit) {
+            EXPECT_EQ(hit->triangleIdx, expected->triangleIdx);
+            EXPECT_EQ(hit->distance, expected->distance);
+            ++hitCount;
+        }
+    }
+    EXPECT_GT(hitCount, 0);
+}
+
+TEST(TriangleBvh, flatLayout) {
+    /**
+     * Test that traversing the flat layout finds the same hits as the hierarchy
+     */
+
+    std::mt19937 generator(23);
+    std::uniform_real_distribution<float> position(-5.f, 5.f);
+    std::uniform_real_distribution<float> offset(-0.3f, 0.3f);
+
+    std::vector<glm::vec3> vertices;
+    for(size_t triIdx = 0; triIdx < 1000; ++triIdx) {
+        const glm::vec3 center(position(generator), position(generator), position(generator));
+        for(size_t i = 0; i < 3; ++i) {
+            vertices.push_back(center + glm::vec3(offset(generator), offset(generator), offset(generator)));
+        }
+    }
+    pepr3d::TriangleBvh bvh;
+    bvh.build(vertices);
+
+    std::vector<glm::vec4> nodes;
+    std::vector<glm::vec4> triangles;
+    bvh.getFlatLayout(nodes, triangles);
+    ASSERT_EQ(nodes.size() % (2 * pepr3d::TriangleBvh::WIDTH), 0);
+    ASSERT_EQ(triangles.size(), 3 * bvh.size());
+
+    size_t hitCount = 0;
+    for(size_t rayIdx = 0; rayIdx < 200; ++rayIdx) {
+        const glm::vec3 origin(position(generator), position(generator), -10.f);
+        const glm::vec3 direction(offset(generator), offset(generator), 1.f);
+
+        // Visit every valid slot, the boxes are not tested so that only the layout is checked
+        std::optional<pepr3d::TriangleBvh::Hit> hit;
+        std::vector<uint32_t> stack{0};
+        while(!stack.empty()) {
+            const uint32_t node = stack.back();
+            stack.pop_back();
+            for(size_t slot = 0; slot < pepr3d::TriangleBvh::WIDTH; ++slot) {
+                const glm::vec4& min = nodes[2 * (pepr3d::TriangleBvh::WIDTH * node + slot)];
+                const glm::vec4& max = nodes[2 * (pepr3d::TriangleBvh::WIDTH * node + slot) + 1];
+                const uint32_t child = glm::floatBitsToUint(min.w);
+                const uint32_t count = glm::floatBitsToUint(max.w);
+                if(count == pepr3d::TriangleBvh::INVALID_CHILD_COUNT) {
+                    continue;
+                }
+                EXPECT_TRUE(glm::all(glm::lessThanEqual(glm::vec3(min), glm::vec3(max))));
+                if(count == 0) {
+                    stack.push_back(child);
+                    continue;
+                }
+                for(uint32_t idx = child; idx < child + count; ++idx) {
+                    const std::array<glm::vec3, 3> triangle{glm::vec3(triangles[3 * idx]),
+                                                            glm::vec3(triangles[3 * idx + 1]),
+                                                            glm::vec3(triangles[3 * idx + 2])};
+                    const auto distance = pepr3d::TriangleBvh::intersectTriangle(origin, direction, triangle);
+                    if(distance && *distance >= 0.f && (!hit || *distance < hit->distance)) {
+                        hit = pepr3d::TriangleBvh::Hit{glm::floatBitsToUint(triangles[3 * idx].w), *distance};
+                    }
+                }
+            }
+        }
+
+        const auto expected = bvh.intersect(origin, direction);
+        ASSERT_EQ(hit.has_value(), expected.has_value());
+        if(hit) {
+            EXPECT_EQ(hit->triangleIdx, expected->triangleIdx);
+            EXPECT_EQ(hit->distance, expected->distance);
+            ++hitCount;
+        }
+    }
+    EXPECT_GT(hitCount, 0);
+}
+
+TEST(TriangleBvh, watertightSharedEdge) {
+    /**
+     * Test that a ray through the shared edge of two triangles hits one of them
+     */
+
+    const std::array<glm::vec3, 3> first{glm::vec3(0, 0, 0), glm::vec3(1, 0, 0), glm::vec3(0, 1, 0)};
+    const std::array<glm::vec3, 3> second{glm::vec3(1, 0, 0), glm::vec3(1, 1, 0), glm::vec3(0, 1, 0)};
+    const glm::vec3 origin(0.5f, 0.5f, 1.f);
+    const glm::vec3 direction(0.f, 0.f, -1.f);
+
+    const bool hitFirst = pepr3d::TriangleBvh::intersectTriangle(origin, direction, first).has_value();
+    const bool hitSecond = pepr3d::TriangleBvh::intersectTriangle(origin, direction, second).has_value();
+    EXPECT_TRUE(hitFirst || hitSecond);
+
+    const auto distance = pepr3d::TriangleBvh::intersectTriangle(origin, glm::vec3(0.f, 0.f, -2.f), first);
+    ASSERT_TRUE(distance);
+    EXPECT_FLOAT_EQ(*distance, 0.5f);
+}
+
+#endif
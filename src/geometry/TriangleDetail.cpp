@@ -9,6 +9,7 @@
 #include <CGAL/Polygon_2.h>
 #include <CGAL/Polygon_set_2.h>
 #include <CGAL/Spherical_kernel_intersections.h>
+#include <CGAL/convex_hull_2.h>
 #include <CGAL/partition_2.h>
 
 #ifdef PEPR3D_COLLECT_DEBUG_DATA
@@ -17,12 +18,24 @@
 #include <fstream>
 #endif
 
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/map.hpp>
 #include <cinder/Log.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <deque>
+#include <iterator>
+#include <limits>
 #include <list>
 #include <optional>
+#include <sstream>
 #include <stdexcept>
 #include <type_traits>
+#include <unordered_map>
 
 #ifndef NDEBUG
 #include "geometry/GnuplotDebugHelper.h"
@@ -30,7 +43,36 @@
 
 namespace pepr3d {
 
+namespace {
+/// Point of the detail plane rounded to doubles, used by the floating point predicates
+using ApproxPoint2 = std::array<double, 2>;
+
+ApproxPoint2 toApprox(const TriangleDetail::Point2& point) {
+    return {TriangleDetail::exactToDbl(point.x()), TriangleDetail::exactToDbl(point.y())};
+}
+
+/// Twice the signed area of the triangle (a, b, point), positive if point is left of the line a -> b
+double orientation(const ApproxPoint2& a, const ApproxPoint2& b, const ApproxPoint2& point) {
+    return (b[0] - a[0]) * (point[1] - a[1]) - (b[1] - a[1]) * (point[0] - a[0]);
+}
+
+double distance(const ApproxPoint2& a, const ApproxPoint2& b) {
+    return std::hypot(b[0] - a[0], b[1] - a[1]);
+}
+
+std::atomic<TriangleDetail::BooleanBackend> booleanBackend{TriangleDetail::BooleanBackend::Exact};
+}  // namespace
+
+void TriangleDetail::setBooleanBackend(const BooleanBackend backend) {
+    booleanBackend = backend;
+}
+
+TriangleDetail::BooleanBackend TriangleDetail::getBooleanBackend() {
+    return booleanBackend;
+}
+
 void TriangleDetail::paintSphere(const PeprSphere& peprSphere, int minSegments, size_t color) {
+    loadExactData();
     // Vertices on the triangle boundaries must be the same across multiple triangle details!
 
     const Sphere sphere(toExactK(peprSphere.center()), peprSphere.squared_radius());
@@ -48,6 +90,53 @@ void TriangleDetail::paintSphere(const PeprSphere& peprSphere, int minSegments,
         addPolygon(poly, color);
     }
 }
+
+template <typename Shape, typename MakePolygon>
+void TriangleDetail::paintShapePolygons(const std::vector<Shape>& shapes, const MakePolygon& makePolygon,
+                                        size_t color) {
+    loadExactData();
+    std::pmr::vector<Polygon> polygons(getTemporaryMemory());
+    polygons.reserve(shapes.size());
+    for(const Shape& shape : shapes) {
+        std::optional<Polygon> poly = makePolygon(shape);
+        if(!poly) {
+            continue;
+        }
+        const BoundsRelation relation = classifyAgainstBounds(*poly);
+        if(relation == BoundsRelation::Outside) {
+            continue;
+        }
+        if(relation == BoundsRelation::Covering) {
+            // The union covers the triangle too, no need to join the other shapes
+            addPolygon(*poly, color);
+            return;
+        }
+        polygons.emplace_back(std::move(*poly));
+    }
+
+    if(polygons.empty()) {
+        return;
+    }
+
+    PolygonSet pSet{};
+    pSet.join(polygons.begin(), polygons.end());
+
+    addPolygonSet(pSet, color);
+}
+
+void TriangleDetail::paintSpheres(const std::vector<PeprSphere>& peprSpheres, int minSegments, size_t color) {
+    paintShapePolygons(
+        peprSpheres, [this, minSegments](const PeprSphere& sphere) { return polygonFromSphere(sphere, minSegments); },
+        color);
+}
+
+void TriangleDetail::paintCapsules(const std::vector<PeprCapsule>& capsules, int minSegments, size_t color) {
+    paintShapePolygons(
+        capsules,
+        [this, minSegments](const PeprCapsule& capsule) { return polygonFromCapsule(capsule, minSegments); },
+        color);
+}
+
 TriangleDetail::Polygon TriangleDetail::projectShapeToPolygon(const std::vector<PeprPoint3>& shape,
                                                               const PeprVector3& direction) {
     P_ASSERT(shape.size() >= 3);
@@ -84,24 +173,143 @@ TriangleDetail::Polygon TriangleDetail::projectShapeToPolygon(const std::vector<
     return pgn;
 }
 void TriangleDetail::paintShape(const std::vector<PeprPoint3>& shape, const PeprVector3& direction, size_t color) {
+    loadExactData();
     addPolygon(projectShapeToPolygon(shape, direction), color);
 }
 
-void TriangleDetail::paintShape(const std::vector<PeprTriangle>& triangles, const PeprVector3& direction,
-                                size_t color) {
+void TriangleDetail::paintShapes(const std::vector<ShapeProjection>& shapes, size_t color) {
+    loadExactData();
+    std::pmr::vector<Polygon> polygons(getTemporaryMemory());
+    polygons.reserve(shapes.size());
+    for(const ShapeProjection& projection : shapes) {
+        Polygon poly = projectShapeToPolygon(*projection.shape, projection.direction);
+        if(poly.size() < 3) {
+            continue;
+        }
+
+        const BoundsRelation relation = classifyAgainstBounds(poly);
+        if(relation == BoundsRelation::Outside) {
+            continue;
+        }
+        if(relation == BoundsRelation::Covering) {
+            // The union covers the triangle too, no need to join the other shapes
+            addPolygon(poly, color);
+            return;
+        }
+        polygons.emplace_back(std::move(poly));
+    }
+
+    if(polygons.empty()) {
+        return;
+    }
+
+    PolygonSet pSet{};
+    pSet.join(polygons.begin(), polygons.end());
+
+    addPolygonSet(pSet, color);
+}
+
+std::vector<TriangleDetail::ShapeOutline> TriangleDetail::unionTriangles(const std::vector<PeprTriangle>& triangles,
+                                                                        const PeprVector3& direction) {
+    std::vector<ShapeOutline> triangleOutlines;
+    if(triangles.empty()) {
+        return triangleOutlines;
+    }
+
+    // The triangles are joined in a plane perpendicular to the direction, to_2d() projects along its normal
+    const Plane plane(toExactK(triangles.front().vertex(0)), toExactK(direction));
+    std::map<Point2, PeprPoint3> originalPoints;
     std::vector<Polygon> polygons;
     polygons.reserve(triangles.size());
-    for(const auto& tri : triangles) {
-        // Construct new points instead of a copy (to be safe in multithreaded environment)
-        std::vector<PeprPoint3> points = {PeprPoint3(tri.vertex(0).x(), tri.vertex(0).y(), tri.vertex(0).z()),
-                                          PeprPoint3(tri.vertex(1).x(), tri.vertex(1).y(), tri.vertex(1).z()),
-                                          PeprPoint3(tri.vertex(2).x(), tri.vertex(2).y(), tri.vertex(2).z())};
-        Polygon pgn = projectShapeToPolygon(points, direction);
-        // Add only if intersects the bounds
-        if(trianglePolygonsDoIntersect(pgn, mBounds)) {
-            polygons.emplace_back(std::move(pgn));
+    for(const PeprTriangle& tri : triangles) {
+        std::array<Point2, 3> points;
+        for(int i = 0; i < 3; ++i) {
+            points[i] = plane.to_2d(toExactK(tri.vertex(i)));
+            originalPoints.emplace(points[i], tri.vertex(i));
+        }
+        const CGAL::Orientation orientation = CGAL::orientation(points[0], points[1], points[2]);
+        if(orientation == CGAL::COLLINEAR) {
+            continue;
+        }
+        if(orientation == CGAL::CLOCKWISE) {
+            std::swap(points[1], points[2]);
+        }
+        polygons.emplace_back(points.begin(), points.end());
+        triangleOutlines.push_back({{tri.vertex(0), tri.vertex(1), tri.vertex(2)}, {}});
+    }
+
+    PolygonSet pSet{};
+    pSet.join(polygons.begin(), polygons.end());
+    std::vector<PolygonWithHoles> unionPolygons;
+    pSet.polygons_with_holes(std::back_inserter(unionPolygons));
+
+    const auto toOutlinePoints = [&plane, &originalPoints](const Polygon& polygon) {
+        std::vector<PeprPoint3> points;
+        points.reserve(polygon.size());
+        for(auto vertexIt = polygon.vertices_begin(); vertexIt != polygon.vertices_end(); ++vertexIt) {
+            const auto original = originalPoints.find(*vertexIt);
+            points.push_back(original != originalPoints.end() ? original->second
+                                                              : toNormalK(plane.to_3d(*vertexIt)));
+        }
+        return points;
+    };
+
+    std::vector<ShapeOutline> outlines;
+    outlines.reserve(unionPolygons.size());
+    for(const PolygonWithHoles& polygon : unionPolygons) {
+        // The projections need simple polygons, a boundary touching itself is projected triangle by triangle
+        if(polygon.is_unbounded() || !polygon.outer_boundary().is_simple()) {
+            return triangleOutlines;
+        }
+        ShapeOutline outline{toOutlinePoints(polygon.outer_boundary()), {}};
+        for(auto holeIt = polygon.holes_begin(); holeIt != polygon.holes_end(); ++holeIt) {
+            if(!holeIt->is_simple()) {
+                return triangleOutlines;
+            }
+            outline.holes.push_back(toOutlinePoints(*holeIt));
+        }
+        outlines.push_back(std::move(outline));
+    }
+    return outlines;
+}
+
+void TriangleDetail::paintOutlines(const std::vector<OutlineProjection>& outlines, size_t color) {
+    loadExactData();
+    std::pmr::vector<PolygonWithHoles> polygons(getTemporaryMemory());
+    polygons.reserve(outlines.size());
+    for(const OutlineProjection& projection : outlines) {
+        Polygon outerBoundary = projectShapeToPolygon(projection.outline->outerBoundary, projection.direction);
+        if(outerBoundary.size() < 3) {
+            continue;
+        }
+
+        const BoundsRelation relation = classifyAgainstBounds(outerBoundary);
+        if(relation == BoundsRelation::Outside) {
+            continue;
+        }
+        if(relation == BoundsRelation::Covering && projection.outline->holes.empty()) {
+            // The union covers the triangle too, no need to join the other outlines
+            addPolygon(outerBoundary, color);
+            return;
+        }
+
+        PolygonWithHoles polygon(std::move(outerBoundary));
+        for(const std::vector<PeprPoint3>& hole : projection.outline->holes) {
+            Polygon projectedHole = projectShapeToPolygon(hole, projection.direction);
+            if(projectedHole.size() < 3) {
+                continue;
+            }
+            // Holes are clockwise
+            projectedHole.reverse_orientation();
+            polygon.add_hole(std::move(projectedHole));
         }
+        polygons.emplace_back(std::move(polygon));
+    }
+
+    if(polygons.empty()) {
+        return;
     }
+
     PolygonSet pSet{};
     pSet.join(polygons.begin(), polygons.end());
 
@@ -109,7 +317,8 @@ void TriangleDetail::paintShape(const std::vector<PeprTriangle>& triangles, cons
 }
 
 std::pair<bool, bool> TriangleDetail::correctSharedVertices(TriangleDetail& other) {
-    const Segment3 sharedEdge = findSharedEdge(other);
+    loadExactData();
+    other.loadExactData();
     if(mColorChanged) {
         updatePolysFromTriangles();
     }
@@ -117,17 +326,51 @@ std::pair<bool, bool> TriangleDetail::correctSharedVertices(TriangleDetail& othe
         other.updatePolysFromTriangles();
     }
 
-    std::set<Point3> myPoints = findPointsOnEdge(sharedEdge);
+    const size_t myEdgeIdx = findSharedEdgeIdx(other);
+    const size_t theirEdgeIdx = other.findSharedEdgeIdx(*this);
+    if(mEdgePoints[myEdgeIdx].matchedVersions == std::make_pair(mPolygonVersion, other.mPolygonVersion)) {
+        // Neither of the details changed since the edge was matched
+        return std::make_pair(false, false);
+    }
+
+    const Segment3 sharedEdge = getEdge(myEdgeIdx);
+    const EdgePoints& myPoints = getPointsOnEdge(myEdgeIdx);
     P_ASSERT(myPoints.size() >= 2);
-    std::set<Point3> theirPoints = other.findPointsOnEdge(sharedEdge);
+    const EdgePoints& theirPoints = other.getPointsOnEdge(theirEdgeIdx);
     P_ASSERT(theirPoints.size() >= 2);
 
+    // The cached points stay until the next getPointsOnEdge(), adding points only changes the versions
     const bool myPointsAdded = addMissingPoints(myPoints, theirPoints, sharedEdge);
     const bool otherPointsAdded = other.addMissingPoints(theirPoints, myPoints, sharedEdge);
+
+    mEdgePoints[myEdgeIdx].matchedVersions = std::make_pair(mPolygonVersion, other.mPolygonVersion);
+    other.mEdgePoints[theirEdgeIdx].matchedVersions = std::make_pair(other.mPolygonVersion, mPolygonVersion);
     return std::make_pair(myPointsAdded, otherPointsAdded);
 }
 
-bool TriangleDetail::addMissingPoints(const std::set<Point3>& myPoints, const std::set<Point3>& theirPoints,
+uint64_t TriangleDetail::createPolygonVersion() {
+    static std::atomic<uint64_t> lastVersion{NO_POLYGON_VERSION};
+    return ++lastVersion;
+}
+
+const TriangleDetail::EdgePoints& TriangleDetail::getPointsOnEdge(const size_t edgeIdx) {
+    P_ASSERT(edgeIdx < mEdgePoints.size());
+    P_ASSERT(!mColorChanged);
+    EdgePointsCache& cache = mEdgePoints[edgeIdx];
+    if(cache.polygonVersion != mPolygonVersion) {
+        cache.points = findPointsOnEdge(getEdge(edgeIdx));
+        cache.polygonVersion = mPolygonVersion;
+    }
+    return cache.points;
+}
+
+TriangleDetail::Segment3 TriangleDetail::getEdge(const size_t edgeIdx) const {
+    const PeprTriangle& tri = mOriginal.getTri();
+    return Segment3(toExactK(tri.vertex(static_cast<int>(edgeIdx))),
+                    toExactK(tri.vertex(static_cast<int>((edgeIdx + 1) % 3))));
+}
+
+bool TriangleDetail::addMissingPoints(const EdgePoints& myPoints, const EdgePoints& theirPoints,
                                       const Segment3& sharedEdge) {
 #ifdef PEPR3D_COLLECT_DEBUG_DATA
     history.emplace_back(PointEntry{myPoints, theirPoints, sharedEdge});
@@ -137,10 +380,10 @@ bool TriangleDetail::addMissingPoints(const std::set<Point3>& myPoints, const st
         updatePolysFromTriangles();
     }
 
-    // Find missing points
-    std::set<Point3> missingPoints;
+    // Find missing points, both lists are sorted
+    std::pmr::vector<Point3> missingPoints(getTemporaryMemory());
     std::set_difference(theirPoints.begin(), theirPoints.end(), myPoints.begin(), myPoints.end(),
-                        std::inserter(missingPoints, missingPoints.begin()));
+                        std::back_inserter(missingPoints));
 
     if(missingPoints.empty()) {
         return false;
@@ -154,7 +397,7 @@ bool TriangleDetail::addMissingPoints(const std::set<Point3>& myPoints, const st
     }
 
     // Bring the 3d points to our plane
-    std::vector<Point2> points2D;
+    std::pmr::vector<Point2> points2D(getTemporaryMemory());
     std::transform(missingPoints.begin(), missingPoints.end(), std::back_inserter(points2D),
                    [this](auto& e) { return mOriginalPlane.to_2d(e); });
 
@@ -162,7 +405,8 @@ bool TriangleDetail::addMissingPoints(const std::set<Point3>& myPoints, const st
 
     // Find edges that contain any of the points
     for(auto& colorSetIt : mColoredPolys) {
-        std::vector<PolygonWithHoles> polys(colorSetIt.second.number_of_polygons_with_holes());
+        std::pmr::vector<PolygonWithHoles> polys(colorSetIt.second.number_of_polygons_with_holes(),
+                                                 getTemporaryMemory());
         colorSetIt.second.polygons_with_holes(polys.begin());
 
         for(PolygonWithHoles& polyWithHoles : polys) {
@@ -209,6 +453,7 @@ bool TriangleDetail::addMissingPoints(const std::set<Point3>& myPoints, const st
         colorSetIt.second.clear();
         colorSetIt.second.join(polys.begin(), polys.end());
     }
+    markPolygonsChanged();
 
     if(!points2D.empty()) {
         CI_LOG_E("Some shared points could not be added!");
@@ -243,7 +488,8 @@ void TriangleDetail::simplifyPolygons() {
             continue;
 
         bool updateNeeded = false;
-        std::vector<PolygonWithHoles> polys(colorSetIt.second.number_of_polygons_with_holes());
+        std::pmr::vector<PolygonWithHoles> polys(colorSetIt.second.number_of_polygons_with_holes(),
+                                                 getTemporaryMemory());
         colorSetIt.second.polygons_with_holes(polys.begin());
         for(PolygonWithHoles& poly : polys) {
             P_ASSERT(GeometryUtils::is_valid_polygon_with_holes(poly, Traits()));
@@ -255,27 +501,33 @@ void TriangleDetail::simplifyPolygons() {
         if(updateNeeded) {
             colorSetIt.second.clear();
             colorSetIt.second.join(polys.begin(), polys.end());
+            markPolygonsChanged();
         }
     }
 }
 
-std::set<TriangleDetail::Point3> TriangleDetail::findPointsOnEdge(const TriangleDetail::Segment3& edge) {
+TriangleDetail::EdgePoints TriangleDetail::findPointsOnEdge(const TriangleDetail::Segment3& edge) {
+    loadExactData();
     Line2 edgeLine(mOriginalPlane.to_2d(edge.point(0)), mOriginalPlane.to_2d(edge.point(1)));
-    std::set<Point3> result;
+    EdgePoints result;
 
     for(auto& colorSetIt : mColoredPolys) {
-        std::vector<PolygonWithHoles> polys(colorSetIt.second.number_of_polygons_with_holes());
+        std::pmr::vector<PolygonWithHoles> polys(colorSetIt.second.number_of_polygons_with_holes(),
+                                                 getTemporaryMemory());
         colorSetIt.second.polygons_with_holes(polys.begin());
         for(PolygonWithHoles& polyWithHoles : polys) {
             Polygon& poly = polyWithHoles.outer_boundary();
             for(auto vertexIt = poly.vertices_begin(); vertexIt != poly.vertices_end(); vertexIt++) {
                 if(edgeLine.has_on(*vertexIt)) {
-                    result.insert(mOriginalPlane.to_3d(*vertexIt));
+                    result.push_back(mOriginalPlane.to_3d(*vertexIt));
                 }
             }
         }
     }
 
+    // Neighbouring polygons share their vertices on the edge
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
     return result;
 }
 
@@ -316,6 +568,93 @@ TriangleDetail::Polygon TriangleDetail::polygonFromTriangle(const Triangle2& tri
     return pgn;
 }
 
+std::optional<TriangleDetail::Polygon> TriangleDetail::polygonFromSphere(const PeprSphere& peprSphere,
+                                                                        int minSegments) const {
+    const Sphere sphere(toExactK(peprSphere.center()), peprSphere.squared_radius());
+    auto intersection = CGAL::intersection(sphere, mOriginalPlane);
+    if(!intersection) {
+        return {};
+    }
+
+    // Continue only if the intersection is a circle (not a point or miss)
+    std::optional<Circle3> circleIntersection = boost::apply_visitor(SphereIntersectionVisitor{}, *intersection);
+    if(!circleIntersection) {
+        return {};
+    }
+    return polygonFromCircle(*circleIntersection, minSegments);
+}
+
+std::optional<TriangleDetail::Polygon> TriangleDetail::polygonFromCapsule(const PeprCapsule& capsule,
+                                                                         int minSegments) const {
+    if(capsule.start == capsule.end) {
+        return polygonFromSphere(PeprSphere(capsule.start, capsule.squaredRadius), minSegments);
+    }
+
+    // Signed distances of the ends from the plane, the distance changes linearly along the axis
+    const Vector3 normal = mOriginalPlane.orthogonal_vector();
+    const double normalLength = std::sqrt(exactToDbl(normal.squared_length()));
+    const Point3 planePoint = mOriginalPlane.point();
+    const auto getSignedDistance = [&normal, normalLength, &planePoint](const PeprPoint3& point) {
+        return exactToDbl((toExactK(point) - planePoint) * normal) / normalLength;
+    };
+    const double startDistance = getSignedDistance(capsule.start);
+    const double distanceChange = getSignedDistance(capsule.end) - startDistance;
+    const double radius = std::sqrt(capsule.squaredRadius);
+
+    // Part of the axis closer to the plane than the radius, from start at 0 to end at 1
+    double from = 0.;
+    double to = 1.;
+    std::vector<double> samples;
+    if(distanceChange == 0.) {
+        if(std::abs(startDistance) >= radius) {
+            return {};
+        }
+    } else {
+        const double first = (-radius - startDistance) / distanceChange;
+        const double second = (radius - startDistance) / distanceChange;
+        from = std::max(from, std::min(first, second));
+        to = std::min(to, std::max(first, second));
+        if(from >= to) {
+            return {};
+        }
+
+        // The largest circle is where the axis crosses the plane
+        const double crossing = -startDistance / distanceChange;
+        if(crossing > from && crossing < to) {
+            samples.push_back(crossing);
+        }
+    }
+
+    std::vector<Point2> points;
+    const PeprVector3 axis = capsule.end - capsule.start;
+    const auto addCircle = [this, &capsule, &axis, minSegments, &points](const double t, const bool cutsPlane) {
+        const PeprPoint3 center = capsule.start + t * axis;
+        const std::optional<Polygon> circle =
+            cutsPlane ? polygonFromSphere(PeprSphere(center, capsule.squaredRadius), minSegments) : std::nullopt;
+        if(circle) {
+            points.insert(points.end(), circle->vertices_begin(), circle->vertices_end());
+        } else {
+            // The sphere at the end of the part within the radius only touches the plane
+            points.push_back(mOriginalPlane.to_2d(mOriginalPlane.projection(toExactK(center))));
+        }
+    };
+    addCircle(from, from == 0.);
+    addCircle(to, to == 1.);
+    for(const double t : samples) {
+        addCircle(t, true);
+    }
+
+    Polygon hull;
+    CGAL::convex_hull_2(points.begin(), points.end(), std::back_inserter(hull));
+    if(hull.size() < 3) {
+        return {};
+    }
+
+    P_ASSERT(hull.is_counterclockwise_oriented());
+    P_ASSERT(CGAL::is_valid_polygon(hull, Traits()));
+    return hull;
+}
+
 std::vector<std::pair<TriangleDetail::Point2, double>> TriangleDetail::getCircleSharedPoints(
     const Circle3& circle, const Vector3& xBase, const Vector3& yBase) const {
     // We need shared verticies on the boundary of triangle details
@@ -420,6 +759,7 @@ TriangleDetail::Polygon TriangleDetail::polygonFromCircle(const Circle3& circle,
 }
 
 void TriangleDetail::addPolygon(const Polygon& poly, size_t color) {
+    loadExactData();
 #ifdef PEPR3D_COLLECT_DEBUG_DATA
     history.emplace_back(PolygonEntry{poly, color});
 #endif
@@ -429,23 +769,54 @@ void TriangleDetail::addPolygon(const Polygon& poly, size_t color) {
     }
 
     P_ASSERT(CGAL::is_valid_polygon(poly, Traits()));
+
+    // Skip building the polygon set when the result is known without it
+    const BoundsRelation relation = classifyAgainstBounds(poly);
+    if(relation == BoundsRelation::Outside) {
+        return;
+    }
+    if(relation == BoundsRelation::Covering) {
+        fillWithColor(color);
+        return;
+    }
+
     PolygonSet addedShape(poly);
     addPolygonSet(addedShape, color);
 }
 
 void TriangleDetail::addPolygonSet(PolygonSet& polySet, size_t color) {
+    loadExactData();
 #ifdef PEPR3D_COLLECT_DEBUG_DATA
     history.emplace_back(PolygonSetEntry{polySet, color});
 #endif
 
-    polySet.intersection(mBounds);
+    // Only shapes crossing the edges need the exact Boolean operations with the bounds
+    const BoundsRelation relation = classifyAgainstBounds(polySet);
+    if(relation == BoundsRelation::Outside) {
+        return;
+    }
+    if(relation == BoundsRelation::Covering) {
+        fillWithColor(color);
+        return;
+    }
 
     if(mColorChanged) {
         updatePolysFromTriangles();
     }
 
+    if(relation == BoundsRelation::Inside && addInsidePolygonSetToUniformDetail(polySet, color)) {
+        return;
+    }
+    if(getBooleanBackend() == BooleanBackend::FixedPoint && addPolygonSetFixedPoint(polySet, color)) {
+        return;
+    }
+    if(relation != BoundsRelation::Inside) {
+        polySet.intersection(mBounds);
+    }
+
     // Add the shape to its color layer
     mColoredPolys[color].join(polySet);
+    markPolygonsChanged();
 
     // Remove the new shape from other colors
     for(auto& it : mColoredPolys) {
@@ -462,56 +833,393 @@ void TriangleDetail::addPolygonSet(PolygonSet& polySet, size_t color) {
     updateTrianglesFromPolygons();
 }
 
-TriangleDetail::Segment3 TriangleDetail::findSharedEdge(const TriangleDetail& other) {
-    std::array<PeprPoint3, 2> commonPoints;
-    size_t pointsFound = 0;
+TriangleDetail::BoundsRelation TriangleDetail::classifyAgainstBounds(const Polygon& poly) const {
+    P_ASSERT(mBounds.size() == 3);
+    if(poly.size() < 3) {
+        return BoundsRelation::Crossing;
+    }
+
+    std::array<ApproxPoint2, 3> bounds;
+    for(size_t i = 0; i < 3; ++i) {
+        bounds[i] = toApprox(mBounds.vertex(static_cast<int>(i)));
+    }
+    std::pmr::vector<ApproxPoint2> points(getTemporaryMemory());
+    points.reserve(poly.size());
+    for(auto vertexIt = poly.vertices_begin(); vertexIt != poly.vertices_end(); ++vertexIt) {
+        points.push_back(toApprox(*vertexIt));
+    }
+
+    // Points closer to a line than the margin are on neither side. The margin is far above the rounding errors of
+    // the coordinates and of the predicates, which scale with the magnitude of the coordinates.
+    double size = 0.0;
+    double magnitude = 0.0;
+    for(size_t i = 0; i < 3; ++i) {
+        size = std::max(size, distance(bounds[i], bounds[(i + 1) % 3]));
+        magnitude = std::max({magnitude, std::abs(bounds[i][0]), std::abs(bounds[i][1])});
+    }
+    for(const ApproxPoint2& point : points) {
+        magnitude = std::max({magnitude, std::abs(point[0]), std::abs(point[1])});
+    }
+    const double margin = 1e-9 * size + 64.0 * std::numeric_limits<double>::epsilon() * magnitude;
+    if(!(size > margin)) {
+        return BoundsRelation::Crossing;
+    }
+
+    // The bounds are counter-clockwise, inside is left of every edge
+    bool isInside = true;
+    for(size_t edge = 0; edge < 3; ++edge) {
+        const ApproxPoint2& a = bounds[edge];
+        const ApproxPoint2& b = bounds[(edge + 1) % 3];
+        const double limit = margin * distance(a, b);
+
+        bool isOutside = true;
+        for(const ApproxPoint2& point : points) {
+            const double side = orientation(a, b, point);
+            isInside = isInside && side > limit;
+            isOutside = isOutside && side < -limit;
+        }
+        if(isOutside) {
+            return BoundsRelation::Outside;
+        }
+    }
+    if(isInside) {
+        return BoundsRelation::Inside;
+    }
+
+    // A simple polygon turning left at every vertex is convex and contains the bounds if it contains their vertices
+    for(size_t i = 0; i < points.size(); ++i) {
+        const ApproxPoint2& a = points[i];
+        const ApproxPoint2& b = points[(i + 1) % points.size()];
+        const double limit = margin * distance(a, b);
+        if(!(orientation(a, b, points[(i + 2) % points.size()]) > limit)) {
+            return BoundsRelation::Crossing;
+        }
+        for(const ApproxPoint2& boundsVertex : bounds) {
+            if(!(orientation(a, b, boundsVertex) > limit)) {
+                return BoundsRelation::Crossing;
+            }
+        }
+    }
+    return BoundsRelation::Covering;
+}
+
+TriangleDetail::BoundsRelation TriangleDetail::classifyAgainstBounds(const PolygonSet& polySet) const {
+    std::pmr::vector<PolygonWithHoles> polys(polySet.number_of_polygons_with_holes(), getTemporaryMemory());
+    polySet.polygons_with_holes(polys.begin());
+
+    bool isOutside = true;
+    bool isInside = true;
+    for(const PolygonWithHoles& poly : polys) {
+        if(poly.is_unbounded()) {
+            return BoundsRelation::Crossing;
+        }
+
+        // Holes are inside the outer boundary, they only matter when it covers the bounds
+        BoundsRelation relation = classifyAgainstBounds(poly.outer_boundary());
+        if(relation == BoundsRelation::Covering) {
+            if(!poly.has_holes()) {
+                return BoundsRelation::Covering;
+            }
+            relation = BoundsRelation::Crossing;
+        }
+        isOutside = isOutside && relation == BoundsRelation::Outside;
+        isInside = isInside && relation == BoundsRelation::Inside;
+    }
+
+    if(isOutside) {
+        return BoundsRelation::Outside;
+    }
+    return isInside ? BoundsRelation::Inside : BoundsRelation::Crossing;
+}
+
+void TriangleDetail::fillWithColor(size_t color) {
+    // Every other color would be subtracted to nothing
+    mColoredPolys.clear();
+    mColoredPolys.emplace(color, PolygonSet(mBounds));
+    mColorChanged = false;
+    markPolygonsChanged();
+
+    updateTrianglesFromPolygons();
+}
+
+bool TriangleDetail::addInsidePolygonSetToUniformDetail(const PolygonSet& polySet, size_t color) {
+    auto uniformIt = mColoredPolys.end();
+    for(auto it = mColoredPolys.begin(); it != mColoredPolys.end(); ++it) {
+        if(!it->second.is_empty()) {
+            if(uniformIt != mColoredPolys.end()) {
+                return false;
+            }
+            uniformIt = it;
+        }
+    }
+
+    if(uniformIt == mColoredPolys.end()) {
+        return false;
+    }
+
+    if(uniformIt->first == color) {
+        // Painting with the color of the whole detail changes nothing
+        return true;
+    }
+
+    if(polySet.number_of_polygons_with_holes() != 1 || uniformIt->second.number_of_polygons_with_holes() != 1) {
+        return false;
+    }
+
+    PolygonWithHoles shape;
+    PolygonWithHoles layer;
+    polySet.polygons_with_holes(&shape);
+    uniformIt->second.polygons_with_holes(&layer);
+    if(shape.has_holes() || layer.has_holes()) {
+        return false;
+    }
+
+    // The shape does not touch the edges of the layer, it becomes its only hole
+    Polygon hole = shape.outer_boundary();
+    hole.reverse_orientation();
+    uniformIt->second = PolygonSet(PolygonWithHoles(layer.outer_boundary(), &hole, &hole + 1));
+    debugOnlyVerifyPolygonSet(uniformIt->second);
+    mColoredPolys[color] = PolygonSet(shape);
+    markPolygonsChanged();
+
+    simplifyPolygons();
+    updateTrianglesFromPolygons();
+    return true;
+}
+
+bool TriangleDetail::addPolygonSetFixedPoint(const PolygonSet& polySet, size_t color) {
+    std::array<glm::dvec2, 3> bounds;
+    std::array<ApproxPoint2, 3> approxBounds;
+    for(size_t i = 0; i < 3; ++i) {
+        approxBounds[i] = toApprox(mBounds.vertex(static_cast<int>(i)));
+        bounds[i] = glm::dvec2(approxBounds[i][0], approxBounds[i][1]);
+    }
+    // Too thin to keep its orientation in doubles
+    if(!(orientation(approxBounds[0], approxBounds[1], approxBounds[2]) > 0.0)) {
+        return false;
+    }
+    const FixedPointFrame frame(bounds);
+
+    std::vector<glm::dvec2> points;
+    const auto addRing = [&frame, &points](const Polygon& polygon, std::vector<FixedPointRing>& rings) {
+        points.clear();
+        for(auto vertexIt = polygon.vertices_begin(); vertexIt != polygon.vertices_end(); ++vertexIt) {
+            const ApproxPoint2 point = toApprox(*vertexIt);
+            points.emplace_back(point[0], point[1]);
+        }
+        rings.push_back(frame.toFixed(points));
+    };
+    const auto getRings = [&addRing](const PolygonSet& set) -> std::optional<std::vector<FixedPointRing>> {
+        std::pmr::vector<PolygonWithHoles> polys(set.number_of_polygons_with_holes(), getTemporaryMemory());
+        set.polygons_with_holes(polys.begin());
+        std::vector<FixedPointRing> rings;
+        for(const PolygonWithHoles& poly : polys) {
+            if(poly.is_unbounded()) {
+                return {};
+            }
+            addRing(poly.outer_boundary(), rings);
+            for(auto holeIt = poly.holes_begin(); holeIt != poly.holes_end(); ++holeIt) {
+                addRing(*holeIt, rings);
+            }
+        }
+        return rings;
+    };
+
+    const std::optional<std::vector<FixedPointRing>> shapeRings = getRings(polySet);
+    if(!shapeRings) {
+        return false;
+    }
+    FixedPointPolygonSet shape = FixedPointFrame::getBounds();
+    shape.intersection(FixedPointPolygonSet(*shapeRings));
+    if(shape.isEmpty()) {
+        return true;
+    }
+
+    // All layers are painted over in one arrangement, so the boundaries they share stay shared
+    std::vector<size_t> colors;
+    std::vector<std::vector<FixedPointRing>> layers;
+    std::optional<size_t> paintedIdx;
+    for(const auto& colorSetIt : mColoredPolys) {
+        std::optional<std::vector<FixedPointRing>> layerRings = getRings(colorSetIt.second);
+        if(!layerRings) {
+            return false;
+        }
+        if(colorSetIt.first == color) {
+            paintedIdx = layers.size();
+        }
+        colors.push_back(colorSetIt.first);
+        layers.push_back(std::move(*layerRings));
+    }
+    if(!paintedIdx) {
+        paintedIdx = layers.size();
+        colors.push_back(color);
+        layers.emplace_back();
+    }
+    const std::vector<FixedPointPolygonSet> painted = FixedPointPolygonSet::paint(layers, *paintedIdx, shape);
+
+    // Back to exact points of the plane, points on the edges of the bounds stay exactly on them
+    const Point2 origin = mBounds.vertex(0);
+    const K::FT scale(FixedPointFrame::SCALE);
+    const Vector2 xBase = (mBounds.vertex(1) - origin) / scale;
+    const Vector2 yBase = (mBounds.vertex(2) - origin) / scale;
+    const auto toPolygon = [&origin, &xBase, &yBase](const FixedPointRing& ring) {
+        Polygon polygon;
+        for(const FixedPoint& point : ring) {
+            polygon.push_back(origin + xBase * K::FT(point.x) + yBase * K::FT(point.y));
+        }
+        return polygon;
+    };
+    for(size_t layerIdx = 0; layerIdx < painted.size(); ++layerIdx) {
+        std::vector<PolygonWithHoles> polys;
+        for(const FixedPointPolygonSet::PolygonWithHoles& polygon : painted[layerIdx].getPolygonsWithHoles()) {
+            std::vector<Polygon> holes;
+            std::transform(polygon.holes.begin(), polygon.holes.end(), std::back_inserter(holes), toPolygon);
+            polys.emplace_back(toPolygon(polygon.outerBoundary), holes.begin(), holes.end());
+        }
+        PolygonSet& layer = mColoredPolys[colors[layerIdx]];
+        layer.clear();
+        layer.join(polys.begin(), polys.end());
+        debugOnlyVerifyPolygonSet(layer);
+    }
+    markPolygonsChanged();
+
+    simplifyPolygons();
+    updateTrianglesFromPolygons();
+    return true;
+}
+
+std::optional<size_t> TriangleDetail::getUniformColor() const {
+    if(mPendingExactData || mTriangulatedPolygons.empty()) {
+        return {};
+    }
+
+    // Colors of all triangles, the degenerate ones have the degenerate color of their polygon
+    const size_t color = mTriangles.empty() ? mTriangulatedPolygons.front().degenerateColor : mTriangles.getColor(0);
+    for(const TriangulatedPolygon& polygon : mTriangulatedPolygons) {
+        if(!hasColor(polygon, color)) {
+            return {};
+        }
+    }
+    return color;
+}
+
+bool TriangleDetail::hasPointsInsideSharedEdge(const TriangleDetail& other) const {
+    if(mPendingExactData) {
+        return true;
+    }
+    const Segment3 edge = findSharedEdge(other);
+    const Point2 source = mOriginalPlane.to_2d(edge.source());
+    const Point2 target = mOriginalPlane.to_2d(edge.target());
+
+    // All vertices are inside the original triangle, so collinear vertices are on the edge.
+    // The triangulation of the polygons has no other vertices than the polygons.
+    const auto hasPointInside = [&source, &target](const Polygon& boundary) {
+        return std::any_of(boundary.vertices_begin(), boundary.vertices_end(),
+                           [&source, &target](const Point2& vertex) {
+                               return vertex != source && vertex != target && CGAL::collinear(source, target, vertex);
+                           });
+    };
+    return std::any_of(mTriangulatedPolygons.begin(), mTriangulatedPolygons.end(),
+                       [&hasPointInside](const TriangulatedPolygon& polygon) {
+                           return hasPointInside(polygon.polygon.outer_boundary()) ||
+                                  std::any_of(polygon.polygon.holes_begin(), polygon.polygon.holes_end(),
+                                              hasPointInside);
+                       });
+}
+
+TriangleDetail::Segment3 TriangleDetail::findSharedEdge(const TriangleDetail& other) const {
+    return getEdge(findSharedEdgeIdx(other));
+}
 
+size_t TriangleDetail::findSharedEdgeIdx(const TriangleDetail& other) const {
     // Find the two triangle vertices that are the same for both triangles
+    std::array<bool, 3> isShared{};
+    size_t pointsFound = 0;
     for(int i = 0; i < 3; i++) {
         const PeprPoint3 myPoint = mOriginal.getTri().vertex(i);
         for(int j = 0; j < 3; j++) {
-            const PeprPoint3 otherPoint = other.mOriginal.getTri().vertex(j);
-            if(myPoint == otherPoint) {
-                commonPoints[pointsFound++] = myPoint;
+            if(myPoint == other.mOriginal.getTri().vertex(j)) {
+                isShared[i] = true;
+                ++pointsFound;
             }
         }
     }
 
     P_ASSERT(pointsFound == 2);
-    return Segment3(toExactK(commonPoints[0]), toExactK(commonPoints[1]));
+    for(size_t edgeIdx = 0; edgeIdx < 3; ++edgeIdx) {
+        if(isShared[edgeIdx] && isShared[(edgeIdx + 1) % 3]) {
+            return edgeIdx;
+        }
+    }
+    P_ASSERT(false);
+    return 0;
 }
 
 void TriangleDetail::updatePolysFromTriangles() {
     debugEdgeConsistencyCheck();
 
-    mColoredPolys = createPolygonSetsFromTriangles(mTrianglesExact);
+    // Polygons of a single color are joined whole, only the recolored ones are triangulated again
+    std::vector<ExactTriangle> trianglesExact;
+    std::vector<ColoredPolygonWithHoles> polygons;
+    for(size_t polygonIdx = 0; polygonIdx < mTriangulatedPolygons.size(); ++polygonIdx) {
+        const TriangulatedPolygon& polygon = mTriangulatedPolygons[polygonIdx];
+        if(hasColor(polygon, polygon.color)) {
+            polygons.push_back({polygon.polygon, polygon.color});
+            continue;
+        }
+
+        // Same triangles in the same order as addTrianglesFromPolygon()
+        size_t triIdx = polygon.triangleBegin;
+        for(Triangle2& exactTri : triangulatePolygon(polygon.polygon)) {
+            size_t color = polygon.degenerateColor;
+            if(roundTriangle(exactTri)) {
+                P_ASSERT(triIdx < polygon.triangleEnd);
+                color = triIdx < polygon.triangleEnd ? mTriangles.getColor(triIdx++) : polygon.color;
+            }
+            trianglesExact.emplace_back(std::move(exactTri), color, polygonIdx);
+        }
+        P_ASSERT(triIdx == polygon.triangleEnd);
+    }
+
+    mColoredPolys = createPolygonSetsFromTriangles(trianglesExact, polygons);
     mColorChanged = false;
+    markPolygonsChanged();
     debugEdgeConsistencyCheck();
 
     simplifyPolygons();
 }
 
 std::map<size_t, TriangleDetail::PolygonSet> TriangleDetail::createPolygonSetsFromTriangles(
-    const std::vector<ExactTriangle>& trianglesExact) {
+    const std::vector<ExactTriangle>& trianglesExact, const std::vector<ColoredPolygonWithHoles>& polygons) {
     std::map<size_t, PolygonSet> coloredPolygonSets;
 
-    // Create polygons from triangles
-    std::map<size_t, std::vector<Polygon>> polygonsByColor;
+    // Create polygons from triangles, the whole polygons are kept aside
+    std::pmr::map<size_t, std::pmr::vector<Polygon>> trianglesByColor(getTemporaryMemory());
+    std::pmr::map<size_t, std::pmr::vector<PolygonWithHoles>> wholePolygonsByColor(getTemporaryMemory());
     for(const ExactTriangle& exactTri : trianglesExact) {
-        polygonsByColor[exactTri.color].emplace_back(polygonFromTriangle(exactTri.triangle));
+        trianglesByColor[exactTri.color].emplace_back(polygonFromTriangle(exactTri.triangle));
+    }
+    const std::pmr::vector<PolygonWithHoles> noPolygons(getTemporaryMemory());
+    for(const ColoredPolygonWithHoles& polygon : polygons) {
+        wholePolygonsByColor[polygon.color].push_back(polygon.polygon);
+        // Colors with only whole polygons get an empty list of triangles
+        trianglesByColor[polygon.color];
     }
 
-    for(const auto& it : polygonsByColor) {
-        const std::vector<Polygon>& polygons = it.second;
+    for(const auto& it : trianglesByColor) {
+        const std::pmr::vector<Polygon>& triangles = it.second;
+        const auto wholePolygonsIt = wholePolygonsByColor.find(it.first);
+        const std::pmr::vector<PolygonWithHoles>& wholePolygons =
+            wholePolygonsIt != wholePolygonsByColor.end() ? wholePolygonsIt->second : noPolygons;
 
-        P_ASSERT(std::all_of(polygons.begin(), polygons.end(), [](const auto& poly) {
+        P_ASSERT(std::all_of(triangles.begin(), triangles.end(), [](const auto& poly) {
             return CGAL::is_valid_polygon(poly, Traits()) && poly.is_counterclockwise_oriented();
         }));
 
         // Must be joined all at the same time
         // Otherwise cgal creates PolygonSet with invalid holes (vertices of higher degree)
         PolygonSet pSet;
-        pSet.join(polygons.begin(), polygons.end());
+        pSet.join(triangles.begin(), triangles.end(), wholePolygons.begin(), wholePolygons.end());
         TriangleDetail::debugOnlyVerifyPolygonSet(pSet);
 
         coloredPolygonSets.emplace(std::make_pair(it.first, std::move(pSet)));
@@ -521,11 +1229,11 @@ std::map<size_t, TriangleDetail::PolygonSet> TriangleDetail::createPolygonSetsFr
 }
 
 void TriangleDetail::markDomains(ConstrainedTriangulation& ct, ConstrainedTriangulation::Face_handle start, int index,
-                                 std::deque<ConstrainedTriangulation::Edge>& border) {
+                                 std::pmr::deque<ConstrainedTriangulation::Edge>& border) {
     if(start->info().nestingLevel != -1) {
         return;
     }
-    std::deque<ConstrainedTriangulation::Face_handle> queue;
+    std::pmr::deque<ConstrainedTriangulation::Face_handle> queue(getTemporaryMemory());
     queue.push_back(start);
     while(!queue.empty()) {
         ConstrainedTriangulation::Face_handle fh = queue.front();
@@ -558,7 +1266,7 @@ void TriangleDetail::markDomains(ConstrainedTriangulation& ct) {
     for(auto it = ct.all_faces_begin(); it != ct.all_faces_end(); ++it) {
         it->info().nestingLevel = -1;
     }
-    std::deque<ConstrainedTriangulation::Edge> border;
+    std::pmr::deque<ConstrainedTriangulation::Edge> border(getTemporaryMemory());
     markDomains(ct, ct.infinite_face(), 0, border);
     while(!border.empty()) {
         ConstrainedTriangulation::Edge e = border.front();
@@ -570,35 +1278,78 @@ void TriangleDetail::markDomains(ConstrainedTriangulation& ct) {
     }
 }
 
-void TriangleDetail::addTrianglesFromPolygon(const PolygonWithHoles& poly, size_t color) {
-    std::vector<Triangle2> newTriangles = triangulatePolygon(poly);
-
-    // Create new array for degenerate triangles
-    const size_t polygonId = mPolygonDegenerateTriangles.size();
-    mPolygonDegenerateTriangles.push_back({});
-
-    // Store all triangles
-    for(Triangle2& exactTri : newTriangles) {
-        const size_t idxOfExactTri = mTrianglesExact.size();
+void TriangleDetail::addTrianglesFromPolygon(const PolygonWithHoles& poly, size_t hash, size_t color) {
+    const std::vector<Triangle2> newTriangles = triangulatePolygon(poly);
 
-        const glm::vec3 a = toGlmVec(mOriginalPlane.to_3d(exactTri.vertex(0)));
-        const glm::vec3 b = toGlmVec(mOriginalPlane.to_3d(exactTri.vertex(1)));
-        const glm::vec3 c = toGlmVec(mOriginalPlane.to_3d(exactTri.vertex(2)));
-        DataTriangle tri(a, b, c, mOriginal.getNormal());
-        if(!tri.getTri().is_degenerate()) {
+    TriangulatedPolygon polygon{
+        poly, hash, static_cast<ColorIndex>(color), static_cast<ColorIndex>(color), false, mTriangles.size(), 0};
+    for(const Triangle2& exactTri : newTriangles) {
+        if(const auto vertices = roundTriangle(exactTri)) {
             // Triangle is good
-            tri.setColor(color);
-            mTriangles.emplace_back(std::move(tri));
-            mTrianglesToExactIdx.push_back(mTrianglesExact.size());
+            mTriangles.push_back(*vertices, mOriginal.getNormal(), color);
         } else {
             // Triangle degenerates
-            mPolygonDegenerateTriangles[polygonId].push_back(idxOfExactTri);
+            polygon.hasDegenerateTriangles = true;
+        }
+    }
+    polygon.triangleEnd = mTriangles.size();
+    mTriangulatedPolygons.push_back(std::move(polygon));
+}
+
+std::optional<std::array<glm::vec3, 3>> TriangleDetail::roundTriangle(const Triangle2& exactTri) const {
+    std::array<glm::vec3, 3> vertices;
+    std::array<PeprPoint3, 3> points;
+    for(int i = 0; i < 3; ++i) {
+        vertices[i] = toGlmVec(mOriginalPlane.to_3d(exactTri.vertex(i)));
+        points[i] = PeprPoint3(vertices[i].x, vertices[i].y, vertices[i].z);
+    }
+    if(PeprTriangle(points[0], points[1], points[2]).is_degenerate()) {
+        return {};
+    }
+    return vertices;
+}
+
+bool TriangleDetail::hasColor(const TriangulatedPolygon& polygon, const size_t color) const {
+    if(polygon.hasDegenerateTriangles && polygon.degenerateColor != color) {
+        return false;
+    }
+    const std::vector<ColorIndex>& colors = mTriangles.getColors();
+    return std::all_of(colors.begin() + polygon.triangleBegin, colors.begin() + polygon.triangleEnd,
+                       [color](const ColorIndex triColor) { return triColor == color; });
+}
+
+size_t TriangleDetail::getVertexCount(const PolygonWithHoles& poly) {
+    size_t vertexCount = poly.outer_boundary().size();
+    for(auto holeIt = poly.holes_begin(); holeIt != poly.holes_end(); ++holeIt) {
+        vertexCount += holeIt->size();
+    }
+    return vertexCount;
+}
+
+size_t TriangleDetail::hashPolygon(const PolygonWithHoles& poly) {
+    uint64_t hash = 0;
+    const auto addBoundary = [&hash](const Polygon& boundary) {
+        for(auto vertexIt = boundary.vertices_begin(); vertexIt != boundary.vertices_end(); ++vertexIt) {
+            uint64_t vertexHash = std::hash<double>()(exactToDbl(vertexIt->x())) * 0x9E3779B97F4A7C15ull ^
+                                  std::hash<double>()(exactToDbl(vertexIt->y()));
+            // SplitMix64 finalizer, then a sum that does not depend on the order of the vertices
+            vertexHash = (vertexHash ^ (vertexHash >> 30)) * 0xBF58476D1CE4E5B9ull;
+            vertexHash = (vertexHash ^ (vertexHash >> 27)) * 0x94D049BB133111EBull;
+            hash += vertexHash ^ (vertexHash >> 31);
         }
+    };
 
-        mTrianglesExact.emplace_back(std::move(exactTri), color, polygonId);
+    addBoundary(poly.outer_boundary());
+    for(auto holeIt = poly.holes_begin(); holeIt != poly.holes_end(); ++holeIt) {
+        addBoundary(*holeIt);
     }
+    return static_cast<size_t>(hash);
+}
 
-    P_ASSERT(mTriangles.size() == mTrianglesToExactIdx.size());
+bool TriangleDetail::isSamePolygon(const PolygonWithHoles& first, const PolygonWithHoles& second) {
+    // Polygon_2 comparison allows a different first vertex
+    return first.number_of_holes() == second.number_of_holes() && first.outer_boundary() == second.outer_boundary() &&
+           std::equal(first.holes_begin(), first.holes_end(), second.holes_begin());
 }
 
 std::vector<TriangleDetail::Triangle2> TriangleDetail::triangulatePolygon(const PolygonWithHoles& poly) {
@@ -637,47 +1388,211 @@ std::vector<TriangleDetail::Triangle2> TriangleDetail::triangulatePolygon(const
 }
 
 void TriangleDetail::updateTrianglesFromPolygons() {
-    mTriangles.clear();
-    mTrianglesToExactIdx.clear();
-    mTrianglesExact.clear();
-    mPolygonDegenerateTriangles.clear();
-
+    loadExactData();
     debugEdgeConsistencyCheck();
 
+    struct ColoredPolygon {
+        PolygonWithHoles polygon;
+        size_t color;
+        size_t hash;
+        bool isTriangulated;
+    };
+    std::pmr::vector<ColoredPolygon> coloredPolygons(getTemporaryMemory());
     for(auto& colorSetIt : mColoredPolys) {
         if(colorSetIt.second.is_empty())
             continue;
 
-        std::vector<PolygonWithHoles> polys(colorSetIt.second.number_of_polygons_with_holes());
+        std::pmr::vector<PolygonWithHoles> polys(colorSetIt.second.number_of_polygons_with_holes(),
+                                                 getTemporaryMemory());
         colorSetIt.second.polygons_with_holes(polys.begin());
         for(PolygonWithHoles& poly : polys) {
-            addTrianglesFromPolygon(poly, colorSetIt.first);
+            const size_t hash = hashPolygon(poly);
+            coloredPolygons.push_back({std::move(poly), colorSetIt.first, hash, false});
+        }
+    }
+
+    // Find the polygons triangulated the last time, all of their triangles must still have the polygon color
+    std::pmr::vector<TriangulatedPolygon> oldPolygons(getTemporaryMemory());
+    std::move(mTriangulatedPolygons.begin(), mTriangulatedPolygons.end(), std::back_inserter(oldPolygons));
+    std::pmr::unordered_multimap<size_t, size_t> oldPolygonsByHash(getTemporaryMemory());
+    for(size_t oldIdx = 0; oldIdx < oldPolygons.size(); ++oldIdx) {
+        oldPolygonsByHash.emplace(oldPolygons[oldIdx].hash, oldIdx);
+    }
+    std::pmr::vector<bool> isOldPolygonKept(oldPolygons.size(), false, getTemporaryMemory());
+    for(ColoredPolygon& coloredPolygon : coloredPolygons) {
+        const auto range = oldPolygonsByHash.equal_range(coloredPolygon.hash);
+        for(auto it = range.first; it != range.second; ++it) {
+            TriangulatedPolygon& oldPolygon = oldPolygons[it->second];
+            if(!isOldPolygonKept[it->second] && hasColor(oldPolygon, coloredPolygon.color) &&
+               isSamePolygon(oldPolygon.polygon, coloredPolygon.polygon)) {
+                isOldPolygonKept[it->second] = true;
+                coloredPolygon.isTriangulated = true;
+                // The polygon may have been recolored as a whole
+                oldPolygon.color = static_cast<ColorIndex>(coloredPolygon.color);
+                oldPolygon.degenerateColor = oldPolygon.color;
+                break;
+            }
+        }
+    }
+
+    TriangleStore oldTriangles = std::move(mTriangles);
+    mTriangles.clear();
+    mTriangulatedPolygons.clear();
+    mTriangles.reserve(oldTriangles.size());
+
+    // Kept polygons first, in their previous order
+    for(size_t oldIdx = 0; oldIdx < oldPolygons.size(); ++oldIdx) {
+        if(!isOldPolygonKept[oldIdx]) {
+            continue;
+        }
+
+        TriangulatedPolygon& polygon = oldPolygons[oldIdx];
+        const size_t triangleBegin = mTriangles.size();
+        mTriangles.append(oldTriangles, polygon.triangleBegin, polygon.triangleEnd);
+        polygon.triangleBegin = triangleBegin;
+        polygon.triangleEnd = mTriangles.size();
+        mTriangulatedPolygons.push_back(std::move(polygon));
+    }
+
+    for(const ColoredPolygon& coloredPolygon : coloredPolygons) {
+        if(!coloredPolygon.isTriangulated) {
+            addTrianglesFromPolygon(coloredPolygon.polygon, coloredPolygon.hash, coloredPolygon.color);
         }
     }
+    DetailedTriangleId::checkDetailTriangleCount(mTriangles.size());
+}
+
+std::string TriangleDetail::saveExactData() const {
+    std::ostringstream os(std::ios::binary);
+    {
+        cereal::BinaryOutputArchive archive(os);
+        archive(mTriangulatedPolygons, mColoredPolys, mColorChanged);
+    }
+    return os.str();
+}
 
-    P_ASSERT(mTriangles.size() == mTrianglesToExactIdx.size());
+TriangleDetail TriangleDetail::createLazyCopy() const {
+    TriangleDetail copy;
+    copy.mOriginal = mOriginal;
+    copy.mTriangles = mTriangles;
+    copy.mPendingExactData = mPendingExactData ? *mPendingExactData : saveExactData();
+    return copy;
+}
+
+void TriangleDetail::loadExactData() {
+    if(!mPendingExactData) {
+        return;
+    }
+
+    const PeprTriangle& tri = mOriginal.getTri();
+    mOriginalPlane = Plane(toExactK(tri.vertex(0)), toExactK(tri.vertex(1)), toExactK(tri.vertex(2)));
+    mBounds = polygonFromTriangle(mOriginal.getTri());
+    try {
+        std::istringstream is(*mPendingExactData, std::ios::binary);
+        cereal::BinaryInputArchive archive(is);
+        archive(mTriangulatedPolygons, mColoredPolys, mColorChanged);
+    } catch(const cereal::Exception& e) {
+        throw std::runtime_error(std::string("The exact data of a triangle detail is corrupted: ") + e.what());
+    }
+    mPendingExactData.reset();
+    markPolygonsChanged();
+    verifyTriangulatedPolygons();
+}
+
+namespace {
+/// TriangulatedPolygon as saved with the exact triangles, ranges of the exact triangles and of the detail triangles
+struct TriangulatedPolygonWithExactTriangles {
+    TriangleDetail::PolygonWithHoles polygon;
+    size_t hash;
+    size_t exactBegin;
+    size_t exactEnd;
+    size_t triangleBegin;
+    size_t triangleEnd;
+
+    template <typename Archive>
+    void serialize(Archive& archive) {
+        archive(polygon, hash, exactBegin, exactEnd, triangleBegin, triangleEnd);
+    }
+};
+}  // namespace
+
+void TriangleDetail::loadExactDataWithExactTriangles(const std::string& exactData) {
+    const PeprTriangle& tri = mOriginal.getTri();
+    mOriginalPlane = Plane(toExactK(tri.vertex(0)), toExactK(tri.vertex(1)), toExactK(tri.vertex(2)));
+    mBounds = polygonFromTriangle(mOriginal.getTri());
+
+    std::vector<ExactTriangle> trianglesExact;
+    std::vector<size_t> trianglesToExactIdx;
+    std::vector<std::vector<size_t>> polygonDegenerateTriangles;
+    std::vector<TriangulatedPolygonWithExactTriangles> polygons;
+    try {
+        std::istringstream is(exactData, std::ios::binary);
+        cereal::BinaryInputArchive archive(is);
+        archive(trianglesExact, trianglesToExactIdx, polygonDegenerateTriangles, polygons, mColoredPolys,
+                mColorChanged);
+    } catch(const cereal::Exception& e) {
+        throw std::runtime_error(std::string("The exact data of a triangle detail is corrupted: ") + e.what());
+    }
+    mPendingExactData.reset();
+    markPolygonsChanged();
+
+    // Only the colors of the exact triangles are kept, the triangulation is the same as triangulatePolygon()
+    const auto isInvalidExactIdx = [&trianglesExact](const size_t exactIdx) {
+        return exactIdx >= trianglesExact.size();
+    };
+    if(polygonDegenerateTriangles.size() != polygons.size()) {
+        throw std::runtime_error("The exact data of a triangle detail does not match its triangles.");
+    }
+    mTriangulatedPolygons.clear();
+    mTriangulatedPolygons.reserve(polygons.size());
+    for(size_t polygonIdx = 0; polygonIdx < polygons.size(); ++polygonIdx) {
+        TriangulatedPolygonWithExactTriangles& polygon = polygons[polygonIdx];
+        const std::vector<size_t>& degenerate = polygonDegenerateTriangles[polygonIdx];
+        if(polygon.exactBegin > polygon.exactEnd || polygon.exactEnd > trianglesExact.size() ||
+           std::any_of(degenerate.begin(), degenerate.end(), isInvalidExactIdx)) {
+            throw std::runtime_error("The exact data of a triangle detail does not match its triangles.");
+        }
+        const ColorIndex color =
+            polygon.exactBegin < polygon.exactEnd ? trianglesExact[polygon.exactBegin].color : ColorIndex(0);
+        const ColorIndex degenerateColor = degenerate.empty() ? color : trianglesExact[degenerate.front()].color;
+        mTriangulatedPolygons.push_back({std::move(polygon.polygon), polygon.hash, color, degenerateColor,
+                                         !degenerate.empty(), polygon.triangleBegin, polygon.triangleEnd});
+    }
+    verifyTriangulatedPolygons();
+}
+
+void TriangleDetail::verifyTriangulatedPolygons() const {
+    // The ranges are used without checks by the painting, reject data that does not fit the triangles
+    size_t triangleEnd = 0;
+    for(const TriangulatedPolygon& polygon : mTriangulatedPolygons) {
+        if(polygon.triangleBegin != triangleEnd || polygon.triangleEnd < polygon.triangleBegin) {
+            throw std::runtime_error("The exact data of a triangle detail does not match its triangles.");
+        }
+        triangleEnd = polygon.triangleEnd;
+    }
+    if(triangleEnd != mTriangles.size()) {
+        throw std::runtime_error("The exact data of a triangle detail does not match its triangles.");
+    }
 }
 
 void TriangleDetail::setColor(size_t detailIdx, size_t color) {
+    loadExactData();
     P_ASSERT(detailIdx < mTriangles.size());
-    P_ASSERT(mTriangles.size() == mTrianglesToExactIdx.size());
 
-    if(mTriangles[detailIdx].getColor() != color) {
-        // Update the inexact representation
-        mTriangles[detailIdx].setColor(color);
+    if(mTriangles.getColor(detailIdx) != color) {
+        mTriangles.setColor(detailIdx, color);
 
-        // Update the exact representation
-        const size_t exactTriIdx = mTrianglesToExactIdx[detailIdx];
-        P_ASSERT(exactTriIdx < mTrianglesExact.size());
-        mTrianglesExact[exactTriIdx].color = color;
-
-        // Also changle all degenerate triangles of this polygon to this colour
+        // Also changle all degenerate triangles of its polygon to this colour
         // These are not otherwise accessible by DetailedTriangleId, but not coloring these
         // would prevent simplification in case of fill.
-        const size_t polygonIdx = mTrianglesExact[exactTriIdx].polygonIdx;
-        for(size_t exactDegTriIdx : mPolygonDegenerateTriangles[polygonIdx]) {
-            mTrianglesExact[exactDegTriIdx].color = color;
-        }
+        // The exact triangles are created again from the polygon by updatePolysFromTriangles()
+        const auto polygonIt =
+            std::upper_bound(mTriangulatedPolygons.begin(), mTriangulatedPolygons.end(), detailIdx,
+                             [](const size_t triIdx, const TriangulatedPolygon& polygon) {
+                                 return triIdx < polygon.triangleEnd;
+                             });
+        P_ASSERT(polygonIt != mTriangulatedPolygons.end() && polygonIt->triangleBegin <= detailIdx);
+        polygonIt->degenerateColor = static_cast<ColorIndex>(color);
 
         mColorChanged = true;
 
@@ -686,4 +1601,295 @@ void TriangleDetail::setColor(size_t detailIdx, size_t color) {
 #endif
     }
 }
+
+namespace ExactBinary {
+namespace {
+using FT = TriangleDetail::K::FT;
+static_assert(std::is_same<FT, CGAL::Gmpq>::value, "Exact numbers are encoded as GMP rationals");
+
+enum NumberTag : uint8_t { DOUBLE_NUMBER = 0, RATIONAL_NUMBER = 1 };
+
+class Writer {
+   public:
+    Writer() {
+        mData.push_back('\0');
+        mData.push_back(static_cast<char>(VERSION));
+    }
+
+    std::string& data() {
+        return mData;
+    }
+
+    template <typename T>
+    void writeRaw(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be copied");
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        mData.append(bytes, sizeof(T));
+    }
+
+    void writeSize(size_t size) {
+        writeRaw(static_cast<uint32_t>(size));
+    }
+
+    void writeInteger(const CGAL::Gmpz& integer) {
+        const int sign = mpz_sgn(integer.mpz());
+        writeRaw(static_cast<int8_t>(sign));
+        const size_t byteCount = sign == 0 ? 0 : mpz_sizeinbase(integer.mpz(), 256);
+        writeSize(byteCount);
+        if(byteCount > 0) {
+            const size_t start = mData.size();
+            mData.resize(start + byteCount);
+            size_t written = 0;
+            mpz_export(&mData[start], &written, 1, 1, 1, 0, integer.mpz());
+            P_ASSERT(written == byteCount);
+        }
+    }
+
+    void writeNumber(const FT& number) {
+        const double value = number.to_double();
+        if(std::isfinite(value) && FT(value) == number) {
+            writeRaw(DOUBLE_NUMBER);
+            writeRaw(value);
+        } else {
+            writeRaw(RATIONAL_NUMBER);
+            writeInteger(number.numerator());
+            writeInteger(number.denominator());
+        }
+    }
+
+    void write(const TriangleDetail::Point2& point) {
+        writeNumber(point.x());
+        writeNumber(point.y());
+    }
+
+    void write(const TriangleDetail::Point3& point) {
+        writeNumber(point.x());
+        writeNumber(point.y());
+        writeNumber(point.z());
+    }
+
+    void write(const TriangleDetail::Polygon& polygon) {
+        writeSize(polygon.size());
+        for(auto vertexIt = polygon.vertices_begin(); vertexIt != polygon.vertices_end(); ++vertexIt) {
+            write(*vertexIt);
+        }
+    }
+
+    void write(const TriangleDetail::PolygonWithHoles& polygon) {
+        write(polygon.outer_boundary());
+        writeSize(polygon.number_of_holes());
+        for(auto holeIt = polygon.holes_begin(); holeIt != polygon.holes_end(); ++holeIt) {
+            write(*holeIt);
+        }
+    }
+
+   private:
+    std::string mData;
+};
+
+class Reader {
+   public:
+    explicit Reader(const std::string& data) : mData(data) {
+        if(!isEncoded(mData) || mData.size() < 2) {
+            throw std::runtime_error("Exact value is not in the binary encoding");
+        }
+        if(static_cast<uint8_t>(mData[1]) != VERSION) {
+            throw std::runtime_error("Unsupported version of the exact binary encoding");
+        }
+        mPosition = 2;
+    }
+
+    template <typename T>
+    T readRaw() {
+        static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be copied");
+        require(sizeof(T));
+        T value;
+        std::memcpy(&value, mData.data() + mPosition, sizeof(T));
+        mPosition += sizeof(T);
+        return value;
+    }
+
+    size_t readSize() {
+        return readRaw<uint32_t>();
+    }
+
+    CGAL::Gmpz readInteger() {
+        const int8_t sign = readRaw<int8_t>();
+        const size_t byteCount = readSize();
+        require(byteCount);
+        CGAL::Gmpz integer;
+        if(byteCount > 0) {
+            mpz_import(integer.mpz(), byteCount, 1, 1, 1, 0, mData.data() + mPosition);
+            mPosition += byteCount;
+        }
+        if(sign < 0) {
+            integer = -integer;
+        }
+        return integer;
+    }
+
+    FT readNumber() {
+        const uint8_t tag = readRaw<uint8_t>();
+        if(tag == DOUBLE_NUMBER) {
+            return FT(readRaw<double>());
+        }
+        if(tag != RATIONAL_NUMBER) {
+            throw std::runtime_error("Corrupted exact binary data, unknown number type");
+        }
+        const CGAL::Gmpz numerator = readInteger();
+        const CGAL::Gmpz denominator = readInteger();
+        if(denominator == 0) {
+            throw std::runtime_error("Corrupted exact binary data, zero denominator");
+        }
+        return FT(numerator, denominator);
+    }
+
+    void read(TriangleDetail::Point2& point) {
+        const FT x = readNumber();
+        const FT y = readNumber();
+        point = TriangleDetail::Point2(x, y);
+    }
+
+    void read(TriangleDetail::Point3& point) {
+        const FT x = readNumber();
+        const FT y = readNumber();
+        const FT z = readNumber();
+        point = TriangleDetail::Point3(x, y, z);
+    }
+
+    void read(TriangleDetail::Polygon& polygon) {
+        const size_t size = readSize();
+        polygon.clear();
+        for(size_t i = 0; i < size; ++i) {
+            TriangleDetail::Point2 point;
+            read(point);
+            polygon.push_back(point);
+        }
+    }
+
+    void read(TriangleDetail::PolygonWithHoles& polygon) {
+        TriangleDetail::Polygon outerBoundary;
+        read(outerBoundary);
+        const size_t holeCount = readSize();
+        std::vector<TriangleDetail::Polygon> holes(holeCount);
+        for(TriangleDetail::Polygon& hole : holes) {
+            read(hole);
+        }
+        polygon = TriangleDetail::PolygonWithHoles(outerBoundary, holes.begin(), holes.end());
+    }
+
+    /// All of the data has to be used by the value
+    void finish() const {
+        if(mPosition != mData.size()) {
+            throw std::runtime_error("Corrupted exact binary data, unexpected data after the value");
+        }
+    }
+
+   private:
+    void require(size_t byteCount) const {
+        if(mData.size() - mPosition < byteCount) {
+            throw std::runtime_error("Corrupted exact binary data, unexpected end of the value");
+        }
+    }
+
+    const std::string& mData;
+    size_t mPosition;
+};
+
+template <typename... Values>
+std::string encodeValues(const Values&... values) {
+    Writer writer;
+    (writer.write(values), ...);
+    return std::move(writer.data());
+}
+
+template <typename... Values>
+void decodeValues(const std::string& data, Values&... values) {
+    Reader reader(data);
+    (reader.read(values), ...);
+    reader.finish();
+}
+}  // namespace
+
+std::string encode(const TriangleDetail::Point2& point) {
+    return encodeValues(point);
+}
+
+std::string encode(const TriangleDetail::Point3& point) {
+    return encodeValues(point);
+}
+
+std::string encode(const TriangleDetail::Triangle2& triangle) {
+    return encodeValues(triangle.vertex(0), triangle.vertex(1), triangle.vertex(2));
+}
+
+std::string encode(const TriangleDetail::Polygon& polygon) {
+    return encodeValues(polygon);
+}
+
+std::string encode(const TriangleDetail::PolygonWithHoles& polygon) {
+    return encodeValues(polygon);
+}
+
+std::string encode(const TriangleDetail::Segment3& segment) {
+    return encodeValues(segment.source(), segment.target());
+}
+
+std::string encode(const TriangleDetail::Segment2& segment) {
+    return encodeValues(segment.source(), segment.target());
+}
+
+std::string encode(const std::vector<TriangleDetail::PolygonWithHoles>& polygons) {
+    Writer writer;
+    writer.writeSize(polygons.size());
+    for(const TriangleDetail::PolygonWithHoles& polygon : polygons) {
+        writer.write(polygon);
+    }
+    return std::move(writer.data());
+}
+
+void decode(const std::string& data, TriangleDetail::Point2& point) {
+    decodeValues(data, point);
+}
+
+void decode(const std::string& data, TriangleDetail::Point3& point) {
+    decodeValues(data, point);
+}
+
+void decode(const std::string& data, TriangleDetail::Triangle2& triangle) {
+    std::array<TriangleDetail::Point2, 3> vertices;
+    decodeValues(data, vertices[0], vertices[1], vertices[2]);
+    triangle = TriangleDetail::Triangle2(vertices[0], vertices[1], vertices[2]);
+}
+
+void decode(const std::string& data, TriangleDetail::Polygon& polygon) {
+    decodeValues(data, polygon);
+}
+
+void decode(const std::string& data, TriangleDetail::PolygonWithHoles& polygon) {
+    decodeValues(data, polygon);
+}
+
+void decode(const std::string& data, TriangleDetail::Segment3& segment) {
+    TriangleDetail::Point3 source, target;
+    decodeValues(data, source, target);
+    segment = TriangleDetail::Segment3(source, target);
+}
+
+void decode(const std::string& data, TriangleDetail::Segment2& segment) {
+    TriangleDetail::Point2 source, target;
+    decodeValues(data, source, target);
+    segment = TriangleDetail::Segment2(source, target);
+}
+
+void decode(const std::string& data, std::vector<TriangleDetail::PolygonWithHoles>& polygons) {
+    Reader reader(data);
+    polygons.resize(reader.readSize());
+    for(TriangleDetail::PolygonWithHoles& polygon : polygons) {
+        reader.read(polygon);
+    }
+    reader.finish();
+}
+}  // namespace ExactBinary
+
 }  // namespace pepr3d
@@ -10,8 +10,12 @@
 
 #include "FontRasterizer.h"
 #include "GeometryUtils.h"
+#include "geometry/FixedPointPolygons.h"
 #include "geometry/GlmSerialization.h"
+#include "geometry/TemporaryMemory.h"
 #include "geometry/Triangle.h"
+#include "geometry/TrianglePrimitive.h"
+#include "geometry/TriangleStore.h"
 
 #include <CGAL/Constrained_Delaunay_triangulation_2.h>
 #include <CGAL/Exact_spherical_kernel_3.h>
@@ -24,16 +28,23 @@
 #include <CGAL/Polygon_with_holes_2.h>
 
 #include <cereal/access.hpp>
+#include <cereal/details/traits.hpp>
 #include <cereal/external/base64.hpp>
 
 #include <cereal/types/set.hpp>
 #include <cereal/types/vector.hpp>
+#include <array>
+#include <cstdint>
 #include <deque>
 #include <map>
+#include <memory_resource>
 #include <optional>
+#include <set>
 #include <sstream>
 #include <stdexcept>
+#include <string>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "peprassert.h"
@@ -73,6 +84,8 @@ class TriangleDetail {
     using Line2 = TriangleDetail::K::Line_2;
     using Segment3 = TriangleDetail::K::Segment_3;
     using Segment2 = TriangleDetail::K::Segment_2;
+    /// Points on an edge of a detail, sorted and without duplicates
+    using EdgePoints = std::vector<Point3>;
 
     using PeprTriangle = DataTriangle::Triangle;
     using PeprPlane = DataTriangle::K::Plane_3;
@@ -87,12 +100,13 @@ class TriangleDetail {
     using Tds = CGAL::Triangulation_data_structure_2<CGAL::Triangulation_vertex_base_2<K>, Fb>;
     using ConstrainedTriangulation = CGAL::Constrained_triangulation_2<K, Tds, CGAL::No_intersection_tag>;
 
-    /// Exact triangle with colour and polygon information
+    /// Exact triangle with colour and polygon information, only created while the polygons are rebuilt from the
+    /// triangles
     struct ExactTriangle {
         ExactTriangle(Triangle2& tri, size_t color, size_t polygonIdx)
-            : triangle(tri), color(color), polygonIdx(polygonIdx) {}
+            : triangle(tri), color(static_cast<ColorIndex>(color)), polygonIdx(polygonIdx) {}
         ExactTriangle(Triangle2&& tri, size_t color, size_t polygonIdx)
-            : triangle(tri), color(color), polygonIdx(polygonIdx) {}
+            : triangle(tri), color(static_cast<ColorIndex>(color)), polygonIdx(polygonIdx) {}
         ExactTriangle() = default;
         ExactTriangle(const ExactTriangle&) = default;
         ExactTriangle(ExactTriangle&&) = default;
@@ -100,7 +114,7 @@ class TriangleDetail {
         /// Epeck representation of the triangle
         Triangle2 triangle;
 
-        size_t color;
+        ColorIndex color;
 
         /// Idx of the polygon this triangle belongs to
         size_t polygonIdx;
@@ -134,8 +148,8 @@ class TriangleDetail {
     };
 
     struct PointEntry {
-        std::set<Point3> myPoints;
-        std::set<Point3> theirPoints;
+        EdgePoints myPoints;
+        EdgePoints theirPoints;
         Segment3 sharedEdge;
 
         template <typename Archive>
@@ -163,52 +177,163 @@ class TriangleDetail {
         mOriginalPlane = Plane(toExactK(tri.vertex(0)), toExactK(tri.vertex(1)), toExactK(tri.vertex(2)));
         mBounds = polygonFromTriangle(mOriginal.getTri());
         mTriangles.push_back(mOriginal);
-        mTrianglesToExactIdx.push_back(0);
 
-        std::array<Point2, 3> exactPoints;
-        for(int i = 0; i < 3; i++) {
-            exactPoints[i] = mOriginalPlane.to_2d(toExactK(mOriginal.getTri().vertex(i)));
-        }
-        mTrianglesExact.emplace_back(Triangle2(exactPoints[0], exactPoints[1], exactPoints[2]), original.getColor(), 0);
-        mColoredPolys.emplace(mOriginal.getColor(), PolygonSet(mBounds));
-        mPolygonDegenerateTriangles.push_back({});
+        const auto color = static_cast<ColorIndex>(mOriginal.getColor());
+        mColoredPolys.emplace(color, PolygonSet(mBounds));
+        const PolygonWithHoles boundsPolygon(mBounds);
+        mTriangulatedPolygons.push_back({boundsPolygon, hashPolygon(boundsPolygon), color, color, false, 0, 1});
     }
 
     // Cereal requires default constructor
     TriangleDetail() = default;
 
+    /// Implementation of the Boolean operations of painting over the polygons of a detail
+    enum class BooleanBackend {
+        /// CGAL polygon sets with exact numbers
+        Exact,
+        /// FixedPointPolygonSet in the FixedPointFrame of the detail. The painted shape and the touched polygons are
+        /// rounded to 1 / FixedPointFrame::SCALE of the detail, the polygons are stored exactly as before.
+        FixedPoint
+    };
+
+    /// Backend used by all details, Exact by default. Thread-safe, but it should not change while painting.
+    static void setBooleanBackend(BooleanBackend backend);
+    static BooleanBackend getBooleanBackend();
+
     /// Paint sphere onto this detail
     /// @param minSegments Minimum number of segments of each sphere/plane intersection. Additional points may be added
     /// on boundaries.
     void paintSphere(const PeprSphere& sphere, int minSegments, size_t color);
 
+    /// Paint multiple spheres onto this detail at once, the same as painting them one by one, but the polygons
+    /// and the triangulation are updated only once
+    /// @param minSegments Minimum number of segments of each sphere/plane intersection.
+    void paintSpheres(const std::vector<PeprSphere>& spheres, int minSegments, size_t color);
+
+    /// Sphere swept along a segment from start to end, e.g., a segment of a brush stroke
+    struct PeprCapsule {
+        PeprPoint3 start;
+        PeprPoint3 end;
+        double squaredRadius;
+    };
+
+    /// Paint multiple capsules onto this detail at once, like paintSpheres(). Each capsule is cut by the plane of the
+    /// detail into a single convex polygon, a capsule with start == end is painted as a sphere.
+    /// @param minSegments Minimum number of segments of the circles at the ends of each capsule.
+    void paintCapsules(const std::vector<PeprCapsule>& capsules, int minSegments, size_t color);
+
     /// Paint a shape to triangle detail
     /// @param shape Collection of points that form a polygon, that is going to be projected onto the TriangleDetail
     /// @param direction Direction vector of the projection
     void paintShape(const std::vector<PeprPoint3>& shape, const PeprVector3& direction, size_t color);
 
-    /// Paint a shape to triangle detail
-    /// @param triangles Collection of triangles that form a shape, that is going to be projected onto the
-    /// TriangleDetail
-    /// @param direction Direction vector of the projection
-    void paintShape(const std::vector<PeprTriangle>& triangles, const PeprVector3& direction, size_t color);
+    /// Shape projected onto a detail by paintShapes()
+    struct ShapeProjection {
+        /// Points that form a polygon, see paintShape()
+        const std::vector<PeprPoint3>* shape;
+
+        /// Direction vector of the projection
+        PeprVector3 direction;
+    };
+
+    /// Paint multiple shapes onto this detail at once, the same as painting them one by one, but the polygons
+    /// and the triangulation are updated only once
+    void paintShapes(const std::vector<ShapeProjection>& shapes, size_t color);
+
+    /// Polygon with holes of a flat shape, given by the points of its boundaries
+    struct ShapeOutline {
+        std::vector<PeprPoint3> outerBoundary;
+        std::vector<std::vector<PeprPoint3>> holes;
+    };
+
+    /// Union of flat triangles as seen along the direction, computed once and projected onto each detail by
+    /// paintOutlines(). The points of the outlines are the points of the triangles, apart from the crossings
+    /// of overlapping triangles. If the union is not made of simple polygons, each triangle is its own outline.
+    static std::vector<ShapeOutline> unionTriangles(const std::vector<PeprTriangle>& triangles,
+                                                    const PeprVector3& direction);
+
+    /// Outline projected onto a detail by paintOutlines()
+    struct OutlineProjection {
+        /// Polygon with holes, see unionTriangles()
+        const ShapeOutline* outline;
+
+        /// Direction vector of the projection
+        PeprVector3 direction;
+    };
+
+    /// Paint multiple outlines onto this detail at once, the polygons and the triangulation are updated only once
+    void paintOutlines(const std::vector<OutlineProjection>& outlines, size_t color);
 
     /// Makes sure all vertices on the common edge between these two triangles are matched
     /// Creates new vertices for both triangles if there are missing
+    /// The points of each edge are kept until the polygons change, a pair that did not change since it was last
+    /// matched is skipped.
     /// You will need to updateTrianglesFromPolygons() after calling this method!
     /// @return <bool,bool> true if points were added to a triangle
     std::pair<bool, bool> correctSharedVertices(TriangleDetail& other);
 
-    const std::vector<DataTriangle>& getTriangles() const {
+    /// Triangulation of the polygons in plain floats, for rendering and picking.
+    /// Unlike the CGAL triangles, they can be read from several threads at once.
+    const TriangleStore& getTriangles() const {
         return mTriangles;
     }
 
+    /// 3 vertices of each of getTriangles()
+    const std::vector<glm::vec3>& getVertices() const {
+        return mTriangles.getVertices();
+    }
+
     const DataTriangle& getOriginal() const {
         return mOriginal;
     }
 
+    /// Color of the whole detail if all of its triangles have the same color, including the degenerate ones.
+    /// Details without their exact data are never reported as uniform.
+    std::optional<size_t> getUniformColor() const;
+
+    /// Does this detail have a vertex inside the edge shared with the other detail, besides the two end points?
+    /// Such vertices must exist in the other detail too, see correctSharedVertices().
+    /// Details without their exact data are assumed to have them.
+    bool hasPointsInsideSharedEdge(const TriangleDetail& other) const;
+
+    /// Rough estimate of the work needed to paint over or triangulate this detail, used to balance parallel work
+    size_t getComplexity() const {
+        return mTriangles.size() + mColoredPolys.size();
+    }
+
+    /// Rough estimate of the memory taken by this detail in bytes, used to limit the memory of undo snapshots.
+    /// Polygon sets are estimated from the triangulated polygons, that have the same vertices.
+    size_t getApproximateMemorySize() const {
+        size_t polygonVertexCount = 0;
+        for(const TriangulatedPolygon& polygon : mTriangulatedPolygons) {
+            polygonVertexCount += getVertexCount(polygon.polygon);
+        }
+        // Each vertex is in the triangulated polygon, and with its halfedges in the arrangement of the polygon set
+        return sizeof(TriangleDetail) + mTriangles.getApproximateMemorySize() +
+               mTriangulatedPolygons.capacity() * sizeof(TriangulatedPolygon) +
+               polygonVertexCount * 4 * sizeof(Point2) + mColoredPolys.size() * sizeof(PolygonSet) +
+               (mPendingExactData ? mPendingExactData->capacity() : 0) +
+               (mEdgePoints[0].points.capacity() + mEdgePoints[1].points.capacity() +
+                mEdgePoints[2].points.capacity()) *
+                   sizeof(Point3);
+    }
+
+    /// Is the exact representation decoded, false for a detail loaded by loadLazy() that was not painted yet.
+    /// The triangles and the vertices are always available, the methods that need the exact representation
+    /// decode it first.
+    bool hasExactData() const {
+        return !mPendingExactData;
+    }
+
+    /// Decode the exact representation of a detail loaded by loadLazy(), does nothing if it is decoded already.
+    /// The triangles stay the same. Throws std::runtime_error if the data is corrupted.
+    void loadExactData();
+
     /// Create new triangles from a set of colored polygons
     /// Tries to simplify the polygons in the process
+    /// Polygons that did not change since the last call keep their triangles, they are not triangulated again.
+    /// Their triangles come first, so detail triangles before the first changed polygon keep their index.
+    /// Throws std::runtime_error if there are more triangles than DetailedTriangleId can address.
     void updateTrianglesFromPolygons();
 
     /// Set color of a detail triangle
@@ -223,10 +348,21 @@ class TriangleDetail {
     void addPolygonSet(PolygonSet& polySet, size_t color);
 
     /// Find all points of polygons that are on the edge
-    std::set<Point3> findPointsOnEdge(const Segment3& edge);
+    EdgePoints findPointsOnEdge(const Segment3& edge);
+
+    /// Are the polygons older than the triangles, saving the detail updates them
+    bool hasOutdatedPolygons() const {
+        return mColorChanged;
+    }
 
     template <class Archive>
     void save(Archive& archive) const {
+        if(mPendingExactData) {
+            TriangleDetail decodedDetail(*this);
+            decodedDetail.loadExactData();
+            decodedDetail.save(archive);
+            return;
+        }
         if(mColorChanged) {
             // Update polygonal representation so that we can save it
             TriangleDetail* mutableThis = const_cast<TriangleDetail*>(this);
@@ -239,6 +375,7 @@ class TriangleDetail {
     template <class Archive>
     void load(Archive& archive) {
         archive(mOriginal, mColoredPolys);
+        markPolygonsChanged();
         const PeprTriangle& tri = mOriginal.getTri();
         mOriginalPlane = Plane(toExactK(tri.vertex(0)), toExactK(tri.vertex(1)), toExactK(tri.vertex(2)));
         mBounds = polygonFromTriangle(mOriginal.getTri());
@@ -246,6 +383,39 @@ class TriangleDetail {
         updateTrianglesFromPolygons();
     }
 
+    /// Save the triangles of the detail separately from its exact representation, so that loadLazy() can show the
+    /// detail without decoding the exact representation. Unlike save(), the detail is not modified.
+    template <class Archive>
+    void saveLazy(Archive& archive) const {
+        archive(mOriginal, mTriangles, mPendingExactData ? *mPendingExactData : saveExactData());
+    }
+
+    /// Copy of the detail as loadLazy() would read it after saveLazy(), the exact representation is encoded right
+    /// away. The copy shares no exact kernel objects with this detail, so it can be saved, decoded and destroyed on
+    /// another thread while this detail is painted or copied.
+    TriangleDetail createLazyCopy() const;
+
+    /// Load a detail saved by saveLazy(), its exact representation is decoded by loadExactData() once it is needed.
+    /// Throws std::runtime_error if there are more triangles than DetailedTriangleId can address.
+    template <class Archive>
+    void loadLazy(Archive& archive) {
+        std::string exactData;
+        archive(mOriginal, mTriangles, exactData);
+        DetailedTriangleId::checkDetailTriangleCount(mTriangles.size());
+        mPendingExactData = std::move(exactData);
+    }
+
+    /// Load a detail saved by saveLazy() before the exact triangles were dropped from the exact representation, in
+    /// projects of version 3. The exact representation is decoded right away, throws std::runtime_error if it is
+    /// corrupted.
+    template <class Archive>
+    void loadLazyWithExactTriangles(Archive& archive) {
+        std::string exactData;
+        archive(mOriginal, mTriangles, exactData);
+        DetailedTriangleId::checkDetailTriangleCount(mTriangles.size());
+        loadExactDataWithExactTriangles(exactData);
+    }
+
     /// Convert Point_2 from Pepr3d kernel to Exact kernel
     inline static K::Point_2 toExactK(const PeprPoint2& point) {
         return K::Point_2(point.x(), point.y());
@@ -294,11 +464,17 @@ class TriangleDetail {
         return num.to_double();
     }
 
+    /// Polygon with holes of a single color, see createPolygonSetsFromTriangles()
+    struct ColoredPolygonWithHoles {
+        PolygonWithHoles polygon;
+        size_t color;
+    };
+
     /// Creates a map of [ColorID, PolygonSet] of polygon sets made of provided triangles
-    /// @triangles array of DataTriangles, only used to get color information
-    /// @trianglesExact array of Epeck Triangles, used to get exact bounds of each triangle
+    /// @trianglesExact array of Epeck Triangles, used to get exact bounds and color of each triangle
+    /// @polygons whole polygons joined together with the triangles of their color
     static std::map<size_t, PolygonSet> createPolygonSetsFromTriangles(
-        const std::vector<ExactTriangle>& trianglesExact);
+        const std::vector<ExactTriangle>& trianglesExact, const std::vector<ColoredPolygonWithHoles>& polygons = {});
 
     /// Break down a polygon into an array of triangles
     /// @return vector of exact triangles that make up the polygon
@@ -308,6 +484,7 @@ class TriangleDetail {
     /// @param ColorFunc functor of type size_t func(size_t originalColor), that returns the new color ID
     template <typename ColorFunc>
     void changeColorIds(const ColorFunc& colorFunc) {
+        loadExactData();
         if(!mColorChanged) {
             std::map<size_t, PolygonSet> coloredPolygonSets;
 
@@ -315,36 +492,55 @@ class TriangleDetail {
                 coloredPolygonSets[colorFunc(coloredSetIt.first)].join(coloredSetIt.second);
             }
             mColoredPolys = std::move(coloredPolygonSets);
+            markPolygonsChanged();
         }
 
         // Color of some triangles has been changed, polygon representation is old
-        for(ExactTriangle& exactTri : mTrianglesExact) {
-            exactTri.color = colorFunc(exactTri.color);
+        for(TriangulatedPolygon& polygon : mTriangulatedPolygons) {
+            polygon.color = static_cast<ColorIndex>(colorFunc(polygon.color));
+            polygon.degenerateColor = static_cast<ColorIndex>(colorFunc(polygon.degenerateColor));
         }
 
-        for(DataTriangle& dataTri : mTriangles) {
-            dataTri.setColor(colorFunc(dataTri.getColor()));
+        for(size_t triIdx = 0; triIdx < mTriangles.size(); ++triIdx) {
+            mTriangles.setColor(triIdx, colorFunc(mTriangles.getColor(triIdx)));
         }
     }
 
    private:
-    /// Temporary storage for DataTriangles.  This gets overwritten on every time updateTrianglesFromPolygons() is run.
+    /// Triangles of mTriangulatedPolygons.  This gets overwritten on every time updateTrianglesFromPolygons() is run.
     /// Triangles stored here are non-degenerate triangles that roughly make up the original triangle.
-    /// Becasue DataTriangle is using a limited-precission, these triangles cannot be used to reconstruct the surface.
-    std::vector<DataTriangle> mTriangles;
+    /// Becasue the floats have a limited precission, these triangles cannot be used to reconstruct the surface.
+    /// The polygons are rebuilt from the exact triangulation of mTriangulatedPolygons instead.
+    TriangleStore mTriangles;
+
+    /// Polygon triangulated by the last updateTrianglesFromPolygons(), its triangles are a continuous range of
+    /// mTriangles, in the order of the polygons. The exact triangulation is not stored, triangulatePolygon()
+    /// gives the same triangles again. Those that degenerate in floats are not in mTriangles.
+    struct TriangulatedPolygon {
+        PolygonWithHoles polygon;
 
-    /// Stores index of exact triangle to every DataTriangle of this detail (mTriangles.size() ==
-    /// mTrianglesToExactIdx.size()) Every DataTriangle in this detail has matching exact triangle. But not all exact
-    /// triangles have a DataTriange - some degenerate.
-    std::vector<size_t> mTrianglesToExactIdx;
+        /// Hash of the polygon, see hashPolygon()
+        size_t hash;
 
-    /// Stores epeck triangles. This gets overwritten on every time updateTrianglesFromPolygons() is run.
-    /// This is used for saving andpolygonset reconstruction
-    std::vector<ExactTriangle> mTrianglesExact;
+        /// Color of the polygon set the polygon belongs to, unless mColorChanged
+        ColorIndex color;
 
-    /// Stores index into mTrianglesExact of every degenerate triangle(when represented as DataTriangle), grouped by the
-    /// polygon it belongs to.
-    std::vector<std::vector<size_t>> mPolygonDegenerateTriangles;
+        /// Color of the triangles that degenerate in floats. They cannot be picked, setColor() of any triangle of
+        /// the polygon sets them too, so that they do not prevent simplification in case of fill.
+        ColorIndex degenerateColor;
+
+        bool hasDegenerateTriangles;
+
+        size_t triangleBegin;
+        size_t triangleEnd;
+
+        template <typename Archive>
+        void serialize(Archive& archive) {
+            archive(polygon, hash, color, degenerateColor, hasDegenerateTriangles, triangleBegin, triangleEnd);
+        }
+    };
+
+    std::vector<TriangulatedPolygon> mTriangulatedPolygons;
 
     std::map<size_t, PolygonSet> mColoredPolys;
 
@@ -362,13 +558,69 @@ class TriangleDetail {
     /// Did color of any detail triangle change since last triangulation?
     bool mColorChanged = false;
 
+    /// Binary archive of the exact representation of a detail loaded by loadLazy(), until loadExactData()
+    std::optional<std::string> mPendingExactData;
+
+    static constexpr uint64_t NO_POLYGON_VERSION = 0;
+
+    /// Version of mColoredPolys, unique among all details. Copies of a detail share it until one of them changes.
+    uint64_t mPolygonVersion = createPolygonVersion();
+
+    /// Points on an edge of mOriginal, edge i goes from vertex i to vertex (i + 1) % 3
+    struct EdgePointsCache {
+        /// mPolygonVersion the points were found at
+        uint64_t polygonVersion = NO_POLYGON_VERSION;
+
+        EdgePoints points;
+
+        /// mPolygonVersion of this detail and of the neighbour when the edge was last matched
+        std::pair<uint64_t, uint64_t> matchedVersions{NO_POLYGON_VERSION, NO_POLYGON_VERSION};
+    };
+
+    std::array<EdgePointsCache, 3> mEdgePoints;
+
+    /// New value of mPolygonVersion, safe to call from several threads
+    static uint64_t createPolygonVersion();
+
+    /// Call after changing mColoredPolys, the points of the edges are found again once they are needed
+    void markPolygonsChanged() {
+        mPolygonVersion = createPolygonVersion();
+    }
+
+    /// Points of the polygons on an edge of mOriginal, found again only if the polygons changed
+    const EdgePoints& getPointsOnEdge(size_t edgeIdx);
+
+    /// Edge of mOriginal, see mEdgePoints
+    Segment3 getEdge(size_t edgeIdx) const;
+
+    /// Binary archive of the exact representation, everything besides mOriginal and mTriangles
+    std::string saveExactData() const;
+
+    /// Decode the exact representation of a detail saved with its exact triangles, see loadLazyWithExactTriangles()
+    void loadExactDataWithExactTriangles(const std::string& exactData);
+
+    /// Throw std::runtime_error if the triangulated polygons do not match mTriangles
+    void verifyTriangulatedPolygons() const;
+
+    /// Do all triangles of the polygon have the color, including the degenerate ones, see setColor()
+    bool hasColor(const TriangulatedPolygon& polygon, size_t color) const;
+
+    /// Number of vertices of the outer boundary and of the holes
+    static size_t getVertexCount(const PolygonWithHoles& poly);
+
+    /// Vertices of the exact triangle rounded to floats, none if the rounded triangle degenerates, see mTriangles
+    std::optional<std::array<glm::vec3, 3>> roundTriangle(const Triangle2& exactTri) const;
+
     /// Get points of a circle that are shared with border triangles
     std::vector<std::pair<Point2, double>> getCircleSharedPoints(const Circle3& circle, const Vector3& xBase,
                                                                  const Vector3& yBase) const;
 
    private:
     /// Find shared edge between triangles
-    Segment3 findSharedEdge(const TriangleDetail& other);
+    Segment3 findSharedEdge(const TriangleDetail& other) const;
+
+    /// Index of the edge of mOriginal shared with the other detail, see mEdgePoints
+    size_t findSharedEdgeIdx(const TriangleDetail& other) const;
 
     Polygon projectShapeToPolygon(const std::vector<PeprPoint3>& shape, const PeprVector3& direction);
 
@@ -388,19 +640,61 @@ class TriangleDetail {
 #endif
             /// Add points that are missing to our polygons
     /// @return true if any points were added
-    bool addMissingPoints(const std::set<Point3>& myPoints, const std::set<Point3>& theirPoints,
-                          const Segment3& sharedEdge);
+    bool addMissingPoints(const EdgePoints& myPoints, const EdgePoints& theirPoints, const Segment3& sharedEdge);
 
     /// Construct a polygon from a circle.
     Polygon polygonFromCircle(const Circle3& circle, int segments) const;
 
+    /// Construct a polygon from the intersection of a sphere and the plane of the detail, none if they miss
+    std::optional<Polygon> polygonFromSphere(const PeprSphere& sphere, int minSegments) const;
+
+    /// Construct a convex polygon from the intersection of a capsule and the plane of the detail, none if they miss.
+    /// It is the convex hull of the circles cut from the spheres at the ends of the part of the axis within the
+    /// radius and at the point where the axis crosses the plane, so it lies inside the exact intersection.
+    std::optional<Polygon> polygonFromCapsule(const PeprCapsule& capsule, int minSegments) const;
+
     /// Create a polygon from a PeprTriangle
     Polygon polygonFromTriangle(const PeprTriangle& tri) const;
 
     /// Create a polygon from 2D triangle in plane coordinates
     static Polygon polygonFromTriangle(const Triangle2& tri);
 
+    /// Position of a painted shape relative to the bounds of this detail
+    enum class BoundsRelation {
+        /// The shape does not overlap the bounds
+        Outside,
+        /// The shape is strictly inside the bounds, it does not touch the edges
+        Inside,
+        /// The shape covers all of the bounds
+        Covering,
+        /// Anything else, only the exact Boolean operations can tell
+        Crossing
+    };
+
+    /// Classify a polygon against the bounds with floating point predicates.
+    /// Points closer to an edge than a small margin give Crossing, so the result is never wrong, only conservative.
+    BoundsRelation classifyAgainstBounds(const Polygon& poly) const;
+
+    /// Classify a polygon set against the bounds, see classifyAgainstBounds(const Polygon&)
+    BoundsRelation classifyAgainstBounds(const PolygonSet& polySet) const;
+
    private:
+    /// Paint the union of the polygons of the shapes, see paintSpheres()
+    /// @param makePolygon Returns the std::optional<Polygon> of a shape
+    template <typename Shape, typename MakePolygon>
+    void paintShapePolygons(const std::vector<Shape>& shapes, const MakePolygon& makePolygon, size_t color);
+
+    /// Replace all polygons by the bounds of the given color
+    void fillWithColor(size_t color);
+
+    /// Paint the polygon set over the polygons with the Booleans of BooleanBackend::FixedPoint.
+    /// @return false if the polygon set or the detail cannot be represented in fixed point, nothing is changed then
+    bool addPolygonSetFixedPoint(const PolygonSet& polySet, size_t color);
+
+    /// Add a polygon set lying strictly inside the bounds to a detail of a single color, without Boolean operations.
+    /// @return false if the detail or the polygon set is not simple enough, nothing is changed then
+    bool addInsidePolygonSetToUniformDetail(const PolygonSet& polySet, size_t color);
+
     /// Simplify polygons, removing any vertices that are collinear
     void simplifyPolygons();
 
@@ -409,7 +703,14 @@ class TriangleDetail {
     void updatePolysFromTriangles();
 
     /// Add triangles from this polygon to our triangles
-    void addTrianglesFromPolygon(const PolygonWithHoles& poly, size_t color);
+    /// @param hash hashPolygon() of the polygon
+    void addTrianglesFromPolygon(const PolygonWithHoles& poly, size_t hash, size_t color);
+
+    /// Hash of the vertices of a polygon, it does not depend on the first vertex of the boundaries
+    static size_t hashPolygon(const PolygonWithHoles& poly);
+
+    /// Are the boundaries of the polygons the same, up to their first vertex
+    static bool isSamePolygon(const PolygonWithHoles& first, const PolygonWithHoles& second);
 
     /// ( From CGAL User Manual )
     /// ---------------------------
@@ -418,7 +719,7 @@ class TriangleDetail {
     static void markDomains(ConstrainedTriangulation& ct);
 
     static void markDomains(ConstrainedTriangulation& ct, ConstrainedTriangulation::Face_handle start, int index,
-                            std::deque<ConstrainedTriangulation::Edge>& border);
+                            std::pmr::deque<ConstrainedTriangulation::Edge>& border);
 
     struct SphereIntersectionVisitor : public boost::static_visitor<std::optional<Circle3>> {
         std::optional<Circle3> operator()(const Circle3& circle) const {
@@ -517,10 +818,42 @@ class TriangleDetail {
 #endif
 };
 
+/// Compact binary encoding of the exact CGAL values of TriangleDetail, used by binary archives.
+/// Coordinates are doubles when the double is exact, otherwise the numerator and denominator as GMP integers.
+/// Encoded strings start with a zero byte and the version of the encoding, text written by CGAL never does.
+namespace ExactBinary {
+const uint8_t VERSION = 1;
+
+/// Is the string an encoding of this namespace, not CGAL text
+inline bool isEncoded(const std::string& data) {
+    return !data.empty() && data[0] == '\0';
+}
+
+std::string encode(const TriangleDetail::Point2& point);
+std::string encode(const TriangleDetail::Point3& point);
+std::string encode(const TriangleDetail::Triangle2& triangle);
+std::string encode(const TriangleDetail::Polygon& polygon);
+std::string encode(const TriangleDetail::PolygonWithHoles& polygon);
+std::string encode(const TriangleDetail::Segment3& segment);
+std::string encode(const TriangleDetail::Segment2& segment);
+std::string encode(const std::vector<TriangleDetail::PolygonWithHoles>& polygons);
+
+/// Decode a value of the type it was encoded from, throws std::runtime_error if the data is corrupted
+void decode(const std::string& data, TriangleDetail::Point2& point);
+void decode(const std::string& data, TriangleDetail::Point3& point);
+void decode(const std::string& data, TriangleDetail::Triangle2& triangle);
+void decode(const std::string& data, TriangleDetail::Polygon& polygon);
+void decode(const std::string& data, TriangleDetail::PolygonWithHoles& polygon);
+void decode(const std::string& data, TriangleDetail::Segment3& segment);
+void decode(const std::string& data, TriangleDetail::Segment2& segment);
+void decode(const std::string& data, std::vector<TriangleDetail::PolygonWithHoles>& polygons);
+}  // namespace ExactBinary
+
 }  // namespace pepr3d
 
 /**
  *  CGAL Serialization functions
+ *  Binary archives use pepr3d::ExactBinary, text archives CGAL text. Both read the CGAL text of older projects.
  */
 // Note: Keep them tightly specialized, so that they don't try to serialize any other types
 namespace CGAL {
@@ -533,9 +866,13 @@ template <typename Archive, typename CGALType,
                                   std::is_same<CGALType, pepr3d::TriangleDetail::Segment3>::value ||
                                   std::is_same<CGALType, pepr3d::TriangleDetail::Segment2>::value>::type* = nullptr>
 void save(Archive& archive, const CGALType& val) {
-    std::stringstream stream;
-    stream << val;
-    archive(stream.str());
+    if constexpr(cereal::traits::is_text_archive<Archive>::value) {
+        std::stringstream stream;
+        stream << val;
+        archive(stream.str());
+    } else {
+        archive(pepr3d::ExactBinary::encode(val));
+    }
 }
 template <typename Archive, typename CGALType,
           typename std::enable_if<std::is_same<CGALType, pepr3d::TriangleDetail::Point2>::value ||
@@ -548,6 +885,11 @@ template <typename Archive, typename CGALType,
 void load(Archive& archive, CGALType& val) {
     std::string str;
     archive(str);
+    if(pepr3d::ExactBinary::isEncoded(str)) {
+        pepr3d::ExactBinary::decode(str, val);
+        return;
+    }
+
     std::stringstream stream(str);
     stream.seekg(stream.beg);
     stream >> val;
@@ -558,6 +900,11 @@ void save(Archive& archive, const pepr3d::TriangleDetail::PolygonSet& pset) {
     std::vector<pepr3d::TriangleDetail::PolygonWithHoles> polys(pset.number_of_polygons_with_holes());
     pset.polygons_with_holes(polys.begin());
 
+    if constexpr(!cereal::traits::is_text_archive<Archive>::value) {
+        archive(pepr3d::ExactBinary::encode(polys));
+        return;
+    }
+
     std::stringstream sstream;
     sstream << pset.number_of_polygons_with_holes();
     for(auto& poly : polys) {
@@ -571,13 +918,19 @@ template <typename Archive>
 void load(Archive& archive, pepr3d::TriangleDetail::PolygonSet& pset) {
     std::string str;
     archive(str);
-    std::stringstream sstream(str);
-    size_t numPolys;
-    sstream >> numPolys;
 
-    std::vector<pepr3d::TriangleDetail::PolygonWithHoles> polys(numPolys);
-    for(size_t i = 0; i < numPolys; ++i) {
-        sstream >> polys[i];
+    std::vector<pepr3d::TriangleDetail::PolygonWithHoles> polys;
+    if(pepr3d::ExactBinary::isEncoded(str)) {
+        pepr3d::ExactBinary::decode(str, polys);
+    } else {
+        std::stringstream sstream(str);
+        size_t numPolys;
+        sstream >> numPolys;
+
+        polys.resize(numPolys);
+        for(size_t i = 0; i < numPolys; ++i) {
+            sstream >> polys[i];
+        }
     }
 
     pset.clear();
@@ -12,10 +12,14 @@
 #include <CGAL/Spherical_kernel_intersections.h>
 #include <CGAL/partition_2.h>
 
+#include <cereal/archives/binary.hpp>
 #include <cereal/archives/json.hpp>
 #include <cereal/types/map.hpp>
+#include <algorithm>
 #include <random>
 #include <set>
+#include <sstream>
+#include <utility>
 
 namespace pepr3d {
 using Point2 = TriangleDetail::Point2;
@@ -396,6 +400,630 @@ TEST(TriangleDetail, ValidPolygonWithHoles2) {
     EXPECT_TRUE(CGAL::is_valid_polygon_with_holes(poly, TriangleDetail::Traits()));
 }
 
+TEST(TriangleDetail, PaintSphereFastPaths) {
+    /**
+     * Test that spheres outside, inside and covering the detail, classified without exact Booleans, paint correctly
+     */
+    using PeprPoint3 = TriangleDetail::PeprPoint3;
+    using PeprSphere = TriangleDetail::PeprSphere;
+
+    std::stringstream peprTriStream("-0.5 -0.5 0.5 0.5 -0.5 0.5 0.5 0.5 0.5");
+    TriangleDetail::PeprTriangle peprTri;
+    peprTriStream >> peprTri;
+    const DataTriangle tri(TriangleDetail::toGlmVec(peprTri.vertex(0)), TriangleDetail::toGlmVec(peprTri.vertex(1)),
+                           TriangleDetail::toGlmVec(peprTri.vertex(2)), glm::vec3(1, 0, 0), 0);
+
+    const auto colorArea = [](const TriangleDetail& detail, size_t color) {
+        double area = 0.0;
+        for(size_t triIdx = 0; triIdx < detail.getTriangles().size(); ++triIdx) {
+            const DataTriangle detailTri = detail.getTriangles().getDataTriangle(triIdx);
+            if(detailTri.getColor() == color) {
+                area += std::sqrt(detailTri.getTri().squared_area());
+            }
+        }
+        return area;
+    };
+
+    // Beyond the hypotenuse, the sphere cuts the plane but misses the triangle
+    TriangleDetail outside(tri);
+    outside.paintSphere(PeprSphere(PeprPoint3(-0.4, 0.4, 0.5), 0.01), 32, 1);
+    ASSERT_EQ(outside.getTriangles().size(), 1);
+    EXPECT_EQ(outside.getTriangles().getColor(0), 0);
+
+    // Far larger than the triangle
+    TriangleDetail covering(tri);
+    covering.paintSphere(PeprSphere(PeprPoint3(0.2, -0.2, 0.5), 4.0), 32, 1);
+    EXPECT_NEAR(colorArea(covering, 1), 0.5, 1e-6);
+    EXPECT_NEAR(colorArea(covering, 0), 0.0, 1e-6);
+
+    // Small dab around the centroid, the rest of the triangle keeps its color
+    const double radius = 0.05;
+    const double circleArea = glm::pi<double>() * radius * radius;
+    TriangleDetail inside(tri);
+    inside.paintSphere(PeprSphere(PeprPoint3(1.0 / 6.0, -1.0 / 6.0, 0.5), radius * radius), 32, 1);
+    const double dabArea = colorArea(inside, 1);
+    EXPECT_GT(dabArea, 0.9 * circleArea);
+    EXPECT_LT(dabArea, circleArea);
+    EXPECT_NEAR(colorArea(inside, 0) + dabArea, 0.5, 1e-6);
+
+    // A second dab inside the painted one goes through the Boolean operations and agrees with the first
+    inside.paintSphere(PeprSphere(PeprPoint3(1.0 / 6.0, -1.0 / 6.0, 0.5), 0.25 * radius * radius), 32, 2);
+    EXPECT_NEAR(colorArea(inside, 1) + colorArea(inside, 2), dabArea, 1e-6);
+
+    // Crossing the edge x = 0.5, half of the dab is in the triangle
+    TriangleDetail crossing(tri);
+    crossing.paintSphere(PeprSphere(PeprPoint3(0.5, -0.1, 0.5), radius * radius), 32, 1);
+    EXPECT_GT(colorArea(crossing, 1), 0.45 * circleArea);
+    EXPECT_LT(colorArea(crossing, 1), 0.5 * circleArea);
+}
+
+TEST(TriangleDetail, PaintSpheresFixedPoint) {
+    /**
+     * Test that the fixed point Booleans paint the same areas as the exact ones, up to their rounding
+     */
+    using PeprPoint3 = TriangleDetail::PeprPoint3;
+    using PeprSphere = TriangleDetail::PeprSphere;
+    using BooleanBackend = TriangleDetail::BooleanBackend;
+
+    const DataTriangle firstTri(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0.5, -0.5, 0.5), glm::vec3(0.5, 0.5, 0.5),
+                                glm::vec3(0, 0, 1), 0);
+    const DataTriangle secondTri(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0.5, 0.5, 0.5), glm::vec3(-0.5, 0.5, 0.5),
+                                 glm::vec3(0, 0, 1), 0);
+    const auto colorArea = [](const TriangleDetail& detail, size_t color) {
+        double area = 0.0;
+        for(size_t triIdx = 0; triIdx < detail.getTriangles().size(); ++triIdx) {
+            const DataTriangle detailTri = detail.getTriangles().getDataTriangle(triIdx);
+            if(detailTri.getColor() == color) {
+                area += std::sqrt(detailTri.getTri().squared_area());
+            }
+        }
+        return area;
+    };
+    const auto paint = [](TriangleDetail& detail) {
+        detail.paintSphere(PeprSphere(PeprPoint3(0.5, -0.1, 0.5), 0.04), 32, 1);
+        detail.paintSphere(PeprSphere(PeprPoint3(0.3, -0.2, 0.5), 0.01), 32, 2);
+        detail.paintSphere(PeprSphere(PeprPoint3(0.0, 0.0, 0.5), 0.02), 32, 1);
+        detail.paintSphere(PeprSphere(PeprPoint3(0.35, -0.2, 0.5), 0.0025), 32, 0);
+    };
+
+    TriangleDetail exact(firstTri);
+    paint(exact);
+
+    ASSERT_EQ(TriangleDetail::getBooleanBackend(), BooleanBackend::Exact);
+    TriangleDetail::setBooleanBackend(BooleanBackend::FixedPoint);
+    TriangleDetail fixedPoint(firstTri);
+    paint(fixedPoint);
+    TriangleDetail neighbour(secondTri);
+    neighbour.paintSphere(PeprSphere(PeprPoint3(0.0, 0.0, 0.5), 0.02), 32, 1);
+    TriangleDetail::setBooleanBackend(BooleanBackend::Exact);
+
+    double area = 0.0;
+    for(size_t color = 0; color < 3; ++color) {
+        EXPECT_GT(colorArea(fixedPoint, color), 0.0);
+        EXPECT_NEAR(colorArea(fixedPoint, color), colorArea(exact, color), 1e-6);
+        area += colorArea(fixedPoint, color);
+    }
+    EXPECT_NEAR(area, 0.5, 1e-6);
+
+    // The points rounded onto the shared edge can be matched with the neighbour
+    EXPECT_TRUE(fixedPoint.hasPointsInsideSharedEdge(neighbour));
+    fixedPoint.correctSharedVertices(neighbour);
+    fixedPoint.updateTrianglesFromPolygons();
+    neighbour.updateTrianglesFromPolygons();
+    EXPECT_NEAR(colorArea(neighbour, 0) + colorArea(neighbour, 1), 0.5, 1e-6);
+}
+
+TEST(TriangleDetail, UniformColorAndSharedEdgePoints) {
+    /**
+     * Test detecting details of a single color and details with vertices on an edge shared with a neighbour
+     */
+    using PeprPoint3 = TriangleDetail::PeprPoint3;
+    using PeprSphere = TriangleDetail::PeprSphere;
+
+    const DataTriangle firstTri(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0.5, -0.5, 0.5), glm::vec3(0.5, 0.5, 0.5),
+                                glm::vec3(0, 0, 1), 0);
+    const DataTriangle secondTri(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0.5, 0.5, 0.5), glm::vec3(-0.5, 0.5, 0.5),
+                                 glm::vec3(0, 0, 1), 0);
+    TriangleDetail first(firstTri);
+    const TriangleDetail second(secondTri);
+
+    ASSERT_TRUE(first.getUniformColor());
+    EXPECT_EQ(*first.getUniformColor(), 0);
+    EXPECT_FALSE(first.hasPointsInsideSharedEdge(second));
+
+    // Dab on the shared edge
+    first.paintSphere(PeprSphere(PeprPoint3(0.0, 0.0, 0.5), 0.01), 32, 1);
+    EXPECT_FALSE(first.getUniformColor());
+    EXPECT_TRUE(first.hasPointsInsideSharedEdge(second));
+    EXPECT_FALSE(second.hasPointsInsideSharedEdge(first));
+
+    // Painting over everything leaves only the corners
+    first.paintSphere(PeprSphere(PeprPoint3(0.0, 0.0, 0.5), 4.0), 32, 2);
+    ASSERT_TRUE(first.getUniformColor());
+    EXPECT_EQ(*first.getUniformColor(), 2);
+    EXPECT_FALSE(first.hasPointsInsideSharedEdge(second));
+}
+
+TEST(TriangleDetail, RecolorTriangles) {
+    /**
+     * Test that recolored triangles end up in the polygons of their new color once the polygons are rebuilt, and
+     * that a detail with all of its triangles recolored is uniform
+     */
+    using PeprPoint3 = TriangleDetail::PeprPoint3;
+    using PeprSphere = TriangleDetail::PeprSphere;
+
+    const auto colorArea = [](const TriangleDetail& detail, size_t color) {
+        double area = 0.0;
+        for(size_t triIdx = 0; triIdx < detail.getTriangles().size(); ++triIdx) {
+            const DataTriangle detailTri = detail.getTriangles().getDataTriangle(triIdx);
+            if(detailTri.getColor() == color) {
+                area += std::sqrt(detailTri.getTri().squared_area());
+            }
+        }
+        return area;
+    };
+
+    const DataTriangle tri(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0.5, -0.5, 0.5), glm::vec3(0.5, 0.5, 0.5),
+                           glm::vec3(0, 0, 1), 0);
+    TriangleDetail detail(tri);
+    detail.paintSphere(PeprSphere(PeprPoint3(0.1, -0.2, 0.5), 0.01), 32, 1);
+    const double dabArea = colorArea(detail, 1);
+
+    size_t recoloredIdx = 0;
+    while(recoloredIdx < detail.getTriangles().size() && detail.getTriangles().getColor(recoloredIdx) != 0) {
+        ++recoloredIdx;
+    }
+    ASSERT_LT(recoloredIdx, detail.getTriangles().size());
+    const DataTriangle recoloredTri = detail.getTriangles().getDataTriangle(recoloredIdx);
+    const double recoloredArea = std::sqrt(recoloredTri.getTri().squared_area());
+    detail.setColor(recoloredIdx, 2);
+    EXPECT_TRUE(detail.hasOutdatedPolygons());
+    EXPECT_FALSE(detail.getUniformColor());
+
+    // Saving rebuilds the polygons from the triangles
+    std::stringstream stream;
+    {
+        cereal::BinaryOutputArchive archive(stream);
+        archive(detail);
+    }
+    EXPECT_FALSE(detail.hasOutdatedPolygons());
+    TriangleDetail loaded;
+    {
+        cereal::BinaryInputArchive archive(stream);
+        archive(loaded);
+    }
+    EXPECT_NEAR(colorArea(loaded, 1), dabArea, 1e-6);
+    EXPECT_NEAR(colorArea(loaded, 2), recoloredArea, 1e-6);
+    EXPECT_NEAR(colorArea(loaded, 0) + colorArea(loaded, 1) + colorArea(loaded, 2), 0.5, 1e-6);
+
+    for(size_t triIdx = 0; triIdx < loaded.getTriangles().size(); ++triIdx) {
+        loaded.setColor(triIdx, 3);
+    }
+    ASSERT_TRUE(loaded.getUniformColor());
+    EXPECT_EQ(*loaded.getUniformColor(), 3);
+}
+
+TEST(TriangleDetail, CorrectSharedVerticesOnce) {
+    /**
+     * Test that the points of a shared edge are added to the neighbour and that a pair is corrected again only once
+     * one of the details changes
+     */
+    using PeprPoint3 = TriangleDetail::PeprPoint3;
+    using PeprSphere = TriangleDetail::PeprSphere;
+
+    const DataTriangle firstTri(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0.5, -0.5, 0.5), glm::vec3(0.5, 0.5, 0.5),
+                                glm::vec3(0, 0, 1), 0);
+    const DataTriangle secondTri(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0.5, 0.5, 0.5), glm::vec3(-0.5, 0.5, 0.5),
+                                 glm::vec3(0, 0, 1), 0);
+    TriangleDetail first(firstTri);
+    TriangleDetail second(secondTri);
+    EXPECT_EQ(first.correctSharedVertices(second), std::make_pair(false, false));
+
+    first.paintSphere(PeprSphere(PeprPoint3(0.0, 0.0, 0.5), 0.01), 32, 1);
+    EXPECT_EQ(first.correctSharedVertices(second), std::make_pair(false, true));
+    second.updateTrianglesFromPolygons();
+    EXPECT_TRUE(second.hasPointsInsideSharedEdge(first));
+    EXPECT_EQ(second.correctSharedVertices(first), std::make_pair(false, false));
+
+    // The points of the edge are sorted and the same in both details
+    const TriangleDetail::Segment3 edge(TriangleDetail::toExactK(PeprPoint3(-0.5, -0.5, 0.5)),
+                                        TriangleDetail::toExactK(PeprPoint3(0.5, 0.5, 0.5)));
+    const TriangleDetail::EdgePoints firstPoints = first.findPointsOnEdge(edge);
+    EXPECT_GT(firstPoints.size(), 2);
+    EXPECT_TRUE(std::is_sorted(firstPoints.begin(), firstPoints.end()));
+    EXPECT_EQ(firstPoints, second.findPointsOnEdge(edge));
+
+    // A second dab on the edge is added again
+    first.paintSphere(PeprSphere(PeprPoint3(0.25, 0.25, 0.5), 0.01), 32, 2);
+    EXPECT_EQ(first.correctSharedVertices(second), std::make_pair(false, true));
+    second.updateTrianglesFromPolygons();
+    EXPECT_EQ(first.findPointsOnEdge(edge), second.findPointsOnEdge(edge));
+}
+
+TEST(TriangleDetail, KeepsTrianglesOfUnchangedPolygons) {
+    /**
+     * Test that painting a dab keeps the triangles of the dabs painted before it
+     */
+    using PeprPoint3 = TriangleDetail::PeprPoint3;
+    using PeprSphere = TriangleDetail::PeprSphere;
+
+    const DataTriangle tri(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0.5, -0.5, 0.5), glm::vec3(0.5, 0.5, 0.5),
+                           glm::vec3(0, 0, 1), 0);
+    TriangleDetail triDetail(tri);
+    triDetail.paintSphere(PeprSphere(PeprPoint3(0.3, -0.3, 0.5), 0.0025), 16, 1);
+    triDetail.paintSphere(PeprSphere(PeprPoint3(0.0, -0.3, 0.5), 0.0025), 16, 2);
+
+    // The first dab moved to the front, before the changed background
+    const TriangleStore triangles = triDetail.getTriangles();
+    size_t firstDabCount = 0;
+    while(firstDabCount < triangles.size() && triangles.getColor(firstDabCount) == 1) {
+        ++firstDabCount;
+    }
+    ASSERT_GT(firstDabCount, 0);
+
+    triDetail.paintSphere(PeprSphere(PeprPoint3(0.3, 0.0, 0.5), 0.0025), 16, 3);
+    const TriangleStore& newTriangles = triDetail.getTriangles();
+    ASSERT_GT(newTriangles.size(), triangles.size());
+    for(size_t i = 0; i < firstDabCount; ++i) {
+        EXPECT_EQ(newTriangles.getColor(i), 1);
+        for(size_t vertex = 0; vertex < 3; ++vertex) {
+            EXPECT_EQ(newTriangles.getVertex(i, vertex), triangles.getVertex(i, vertex));
+        }
+    }
+
+    // Kept triangles still match their exact triangles after recoloring and repainting
+    triDetail.setColor(0, 4);
+    triDetail.paintSphere(PeprSphere(PeprPoint3(0.0, -0.3, 0.5), 0.0025), 16, 4);
+    double area = 0.0;
+    for(size_t triIdx = 0; triIdx < triDetail.getTriangles().size(); ++triIdx) {
+        const DataTriangle detailTri = triDetail.getTriangles().getDataTriangle(triIdx);
+        area += std::sqrt(detailTri.getTri().squared_area());
+    }
+    EXPECT_NEAR(area, 0.5, 1e-6);
+}
+
+TEST(TriangleDetail, PlainVerticesFollowTriangles) {
+    /**
+     * Test that the plain vertices are the vertices of the detail triangles after each change
+     */
+    using PeprPoint3 = TriangleDetail::PeprPoint3;
+    using PeprSphere = TriangleDetail::PeprSphere;
+
+    const auto expectSameVertices = [](const TriangleDetail& detail) {
+        const TriangleStore& triangles = detail.getTriangles();
+        const std::vector<glm::vec3>& vertices = detail.getVertices();
+        ASSERT_EQ(vertices.size(), 3 * triangles.size());
+        for(size_t i = 0; i < triangles.size(); ++i) {
+            for(size_t vertex = 0; vertex < 3; ++vertex) {
+                EXPECT_EQ(vertices[3 * i + vertex], triangles.getVertex(i, vertex));
+            }
+        }
+    };
+
+    const DataTriangle tri(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0.5, -0.5, 0.5), glm::vec3(0.5, 0.5, 0.5),
+                           glm::vec3(0, 0, 1), 0);
+    TriangleDetail triDetail(tri);
+    expectSameVertices(triDetail);
+
+    triDetail.paintSphere(PeprSphere(PeprPoint3(0.3, -0.3, 0.5), 0.0025), 16, 1);
+    expectSameVertices(triDetail);
+    triDetail.paintSphere(PeprSphere(PeprPoint3(0.0, -0.3, 0.5), 0.0025), 16, 2);
+    expectSameVertices(triDetail);
+
+    const TriangleDetail copy(triDetail);
+    triDetail.paintSphere(PeprSphere(PeprPoint3(0.3, 0.0, 0.5), 0.01), 16, 0);
+    expectSameVertices(triDetail);
+    expectSameVertices(copy);
+}
+
+TEST(TriangleDetail, BinaryExactSerialization) {
+    /**
+     * Test that binary archives keep exact values, including values doubles cannot hold, and read text values
+     */
+    using Point3 = TriangleDetail::Point3;
+    using Segment2 = TriangleDetail::Segment2;
+
+    const Point2 third(TriangleDetail::K::FT(1, 3), TriangleDetail::K::FT(-2, 7));
+    const Point3 point3(0.25, TriangleDetail::K::FT(5, 11), -1.5);
+    const Segment2 segment(third, Point2(0.5, 0.5));
+
+    Polygon outer;
+    outer.push_back(Point2(0, 0));
+    outer.push_back(Point2(1, 0));
+    outer.push_back(Point2(0, 1));
+    Polygon hole;
+    hole.push_back(Point2(0.1, 0.1));
+    hole.push_back(Point2(0.1, TriangleDetail::K::FT(1, 3)));
+    hole.push_back(Point2(TriangleDetail::K::FT(1, 3), 0.1));
+    ASSERT_TRUE(hole.is_clockwise_oriented());
+    const PolygonSet polySet(PolygonWithHoles(outer, &hole, &hole + 1));
+
+    std::stringstream stream;
+    {
+        cereal::BinaryOutputArchive archive(stream);
+        archive(third, point3, segment, polySet);
+        // Value stored as CGAL text, the way old projects stored it
+        std::stringstream text;
+        text << third;
+        archive(text.str());
+    }
+
+    Point2 loadedThird, loadedText;
+    Point3 loadedPoint3;
+    Segment2 loadedSegment;
+    PolygonSet loadedPolySet;
+    {
+        cereal::BinaryInputArchive archive(stream);
+        ASSERT_NO_THROW(archive(loadedThird, loadedPoint3, loadedSegment, loadedPolySet, loadedText));
+    }
+    EXPECT_EQ(loadedThird, third);
+    EXPECT_EQ(loadedPoint3, point3);
+    EXPECT_EQ(loadedSegment, segment);
+    EXPECT_EQ(loadedText, third);
+
+    std::vector<PolygonWithHoles> polys, loadedPolys;
+    polySet.polygons_with_holes(std::back_inserter(polys));
+    loadedPolySet.polygons_with_holes(std::back_inserter(loadedPolys));
+    ASSERT_EQ(loadedPolys.size(), 1);
+    EXPECT_EQ(loadedPolys[0].outer_boundary(), polys[0].outer_boundary());
+    ASSERT_EQ(loadedPolys[0].number_of_holes(), 1);
+    EXPECT_EQ(*loadedPolys[0].holes_begin(), *polys[0].holes_begin());
+
+    // Corrupted data is reported, not read past its end
+    std::string truncated = ExactBinary::encode(third);
+    truncated.pop_back();
+    Point2 corrupted;
+    EXPECT_THROW(ExactBinary::decode(truncated, corrupted), std::runtime_error);
+}
+
+TEST(TriangleDetail, LazyLoading) {
+    /**
+     * Test that a detail loaded without its exact data shows the saved triangles, and paints the same as the saved
+     * detail once the exact data is decoded
+     */
+    using PeprPoint3 = TriangleDetail::PeprPoint3;
+    using PeprSphere = TriangleDetail::PeprSphere;
+
+    const DataTriangle tri(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0.5, -0.5, 0.5), glm::vec3(0.5, 0.5, 0.5),
+                           glm::vec3(0, 0, 1), 0);
+    TriangleDetail detail(tri);
+    detail.paintSphere(PeprSphere(PeprPoint3(0.1, -0.2, 0.5), 0.01), 32, 1);
+    detail.setColor(0, 2);
+    ASSERT_TRUE(detail.hasOutdatedPolygons());
+
+    std::stringstream stream;
+    {
+        cereal::BinaryOutputArchive archive(stream);
+        detail.saveLazy(archive);
+    }
+    // Saving does not update the polygons, the detail may be shared with the Geometry
+    EXPECT_TRUE(detail.hasOutdatedPolygons());
+
+    TriangleDetail loaded;
+    {
+        cereal::BinaryInputArchive archive(stream);
+        loaded.loadLazy(archive);
+    }
+    EXPECT_FALSE(loaded.hasExactData());
+    EXPECT_FALSE(loaded.getUniformColor());
+    EXPECT_TRUE(loaded.getVertices() == detail.getVertices());
+    ASSERT_EQ(loaded.getTriangles().size(), detail.getTriangles().size());
+    for(size_t i = 0; i < detail.getTriangles().size(); ++i) {
+        EXPECT_EQ(loaded.getTriangles().getColor(i), detail.getTriangles().getColor(i));
+    }
+
+    // A lazy detail saves its exact data again without decoding it
+    std::stringstream resaved;
+    {
+        cereal::BinaryOutputArchive archive(resaved);
+        loaded.saveLazy(archive);
+    }
+    EXPECT_FALSE(loaded.hasExactData());
+
+    // Painting decodes the exact data and gives the same triangles as painting the saved detail
+    const PeprSphere secondDab(PeprPoint3(0.2, -0.1, 0.5), 0.02);
+    detail.paintSphere(secondDab, 32, 3);
+    loaded.paintSphere(secondDab, 32, 3);
+    EXPECT_TRUE(loaded.hasExactData());
+    EXPECT_TRUE(loaded.getVertices() == detail.getVertices());
+
+    TriangleDetail reloaded;
+    {
+        cereal::BinaryInputArchive archive(resaved);
+        reloaded.loadLazy(archive);
+    }
+    reloaded.paintSphere(secondDab, 32, 3);
+    EXPECT_TRUE(reloaded.getVertices() == detail.getVertices());
+
+    // Truncated data is reported instead of read past its end
+    std::string corruptedData = stream.str();
+    corruptedData.resize(corruptedData.size() - 16);
+    std::stringstream corruptedStream(corruptedData);
+    TriangleDetail corrupted;
+    {
+        cereal::BinaryInputArchive archive(corruptedStream);
+        ASSERT_ANY_THROW(corrupted.loadLazy(archive));
+    }
+}
+
+TEST(TriangleDetail, PaintCapsules) {
+    /**
+     * Test that capsules paint the stadium of their axis in the plane, the circle where the axis crosses the plane,
+     * and a sphere if the capsule is a single point
+     */
+    using PeprPoint3 = TriangleDetail::PeprPoint3;
+    using PeprSphere = TriangleDetail::PeprSphere;
+    using PeprCapsule = TriangleDetail::PeprCapsule;
+
+    const DataTriangle tri(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0.5, -0.5, 0.5), glm::vec3(0.5, 0.5, 0.5),
+                           glm::vec3(0, 0, 1), 0);
+    const auto colorArea = [](const TriangleDetail& detail, size_t color) {
+        double area = 0.0;
+        for(size_t triIdx = 0; triIdx < detail.getTriangles().size(); ++triIdx) {
+            const DataTriangle detailTri = detail.getTriangles().getDataTriangle(triIdx);
+            if(detailTri.getColor() == color) {
+                area += std::sqrt(detailTri.getTri().squared_area());
+            }
+        }
+        return area;
+    };
+    const double radius = 0.05;
+    const double circleArea = glm::pi<double>() * radius * radius;
+
+    // Along the plane inside the triangle
+    TriangleDetail along(tri);
+    along.paintCapsules({PeprCapsule{PeprPoint3(0.0, -0.3, 0.5), PeprPoint3(0.3, -0.3, 0.5), radius * radius}}, 32,
+                        1);
+    const double stadiumArea = 2 * radius * 0.3 + circleArea;
+    EXPECT_GT(colorArea(along, 1), 0.95 * stadiumArea);
+    EXPECT_LT(colorArea(along, 1), stadiumArea);
+    EXPECT_NEAR(colorArea(along, 0) + colorArea(along, 1), 0.5, 1e-6);
+
+    // Through the plane, the largest circle is where the axis crosses it
+    TriangleDetail through(tri);
+    through.paintCapsules({PeprCapsule{PeprPoint3(0.2, -0.2, 0.4), PeprPoint3(0.2, -0.2, 0.6), radius * radius}}, 32,
+                          1);
+    EXPECT_GT(colorArea(through, 1), 0.95 * circleArea);
+    EXPECT_LT(colorArea(through, 1), circleArea);
+
+    // Parallel to the plane out of reach
+    TriangleDetail missing(tri);
+    missing.paintCapsules({PeprCapsule{PeprPoint3(0.0, -0.3, 0.6), PeprPoint3(0.3, -0.3, 0.6), radius * radius}}, 32,
+                          1);
+    EXPECT_NEAR(colorArea(missing, 1), 0.0, 1e-9);
+
+    // A single point paints the same as a sphere
+    const PeprPoint3 center(0.2, -0.2, 0.5);
+    TriangleDetail point(tri);
+    point.paintCapsules({PeprCapsule{center, center, radius * radius}}, 32, 1);
+    TriangleDetail sphere(tri);
+    sphere.paintSphere(PeprSphere(center, radius * radius), 32, 1);
+    EXPECT_NEAR(colorArea(point, 1), colorArea(sphere, 1), 1e-9);
+}
+
+TEST(TriangleDetail, PaintShapesAtOnce) {
+    /**
+     * Test that painting shapes at once paints the same area as painting them one by one
+     */
+    using PeprPoint3 = TriangleDetail::PeprPoint3;
+    using PeprVector3 = TriangleDetail::PeprVector3;
+
+    const DataTriangle tri(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0.5, -0.5, 0.5), glm::vec3(0.5, 0.5, 0.5),
+                           glm::vec3(0, 0, 1), 0);
+    const PeprVector3 direction(0, 0, -1);
+    const auto square = [](double x, double y) {
+        return std::vector<PeprPoint3>{PeprPoint3(x - 0.1, y - 0.1, 1), PeprPoint3(x + 0.1, y - 0.1, 1),
+                                       PeprPoint3(x + 0.1, y + 0.1, 1), PeprPoint3(x - 0.1, y + 0.1, 1)};
+    };
+    // Two overlapping squares, one crossing the triangle edge and one outside of the triangle
+    const std::vector<std::vector<PeprPoint3>> shapes{square(0.2, -0.2), square(0.3, -0.1), square(0.35, 0.3),
+                                                      square(-3, 0)};
+
+    TriangleDetail oneByOne(tri);
+    TriangleDetail atOnce(tri);
+    std::vector<TriangleDetail::ShapeProjection> projections;
+    for(const auto& shape : shapes) {
+        oneByOne.paintShape(shape, direction, 1);
+        projections.push_back({&shape, direction});
+    }
+    atOnce.paintShapes(projections, 1);
+
+    const auto colorArea = [](const TriangleDetail& detail, size_t color) {
+        double area = 0.0;
+        for(size_t triIdx = 0; triIdx < detail.getTriangles().size(); ++triIdx) {
+            const DataTriangle detailTri = detail.getTriangles().getDataTriangle(triIdx);
+            if(detailTri.getColor() == color) {
+                area += std::sqrt(detailTri.getTri().squared_area());
+            }
+        }
+        return area;
+    };
+    EXPECT_GT(colorArea(atOnce, 1), 0.0);
+    EXPECT_NEAR(colorArea(atOnce, 1), colorArea(oneByOne, 1), 1e-9);
+    EXPECT_NEAR(colorArea(atOnce, 0), colorArea(oneByOne, 0), 1e-9);
+}
+
+TEST(TriangleDetail, PaintTriangleOutlines) {
+    /**
+     * Test that the union of a frame of triangles is a polygon with a hole made of the original points, and that
+     * painting it paints the same area as painting the triangles
+     */
+    using PeprPoint3 = TriangleDetail::PeprPoint3;
+    using PeprVector3 = TriangleDetail::PeprVector3;
+    using PeprTriangle = TriangleDetail::PeprTriangle;
+
+    const DataTriangle tri(glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0.5, -0.5, 0.5), glm::vec3(0.5, 0.5, 0.5),
+                           glm::vec3(0, 0, 1), 0);
+    const PeprVector3 direction(0, 0, -1);
+    const auto squareCorner = [](double size, size_t corner) {
+        const double x = (corner == 1 || corner == 2) ? size : -size;
+        const double y = corner >= 2 ? size : -size;
+        return PeprPoint3(x, y, 1);
+    };
+    std::vector<PeprTriangle> frame;
+    for(size_t i = 0; i < 4; ++i) {
+        const PeprPoint3 outer = squareCorner(0.4, i);
+        const PeprPoint3 nextOuter = squareCorner(0.4, (i + 1) % 4);
+        const PeprPoint3 inner = squareCorner(0.2, i);
+        const PeprPoint3 nextInner = squareCorner(0.2, (i + 1) % 4);
+        frame.emplace_back(outer, nextOuter, nextInner);
+        frame.emplace_back(outer, nextInner, inner);
+    }
+
+    const std::vector<TriangleDetail::ShapeOutline> outlines = TriangleDetail::unionTriangles(frame, direction);
+    ASSERT_EQ(outlines.size(), 1);
+    ASSERT_EQ(outlines.front().outerBoundary.size(), 4);
+    ASSERT_EQ(outlines.front().holes.size(), 1);
+    ASSERT_EQ(outlines.front().holes.front().size(), 4);
+    // Each corner of the square once, the original points and not their projections
+    const auto getCorners = [](const std::vector<PeprPoint3>& points) {
+        std::set<std::pair<double, double>> corners;
+        for(const PeprPoint3& point : points) {
+            EXPECT_EQ(point.z(), 1.0);
+            corners.emplace(point.x(), point.y());
+        }
+        return corners;
+    };
+    const auto getSquareCorners = [&squareCorner](double size) {
+        std::set<std::pair<double, double>> corners;
+        for(size_t i = 0; i < 4; ++i) {
+            corners.emplace(squareCorner(size, i).x(), squareCorner(size, i).y());
+        }
+        return corners;
+    };
+    EXPECT_EQ(getCorners(outlines.front().outerBoundary), getSquareCorners(0.4));
+    EXPECT_EQ(getCorners(outlines.front().holes.front()), getSquareCorners(0.2));
+
+    TriangleDetail byTriangles(tri);
+    std::vector<std::vector<PeprPoint3>> shapes;
+    for(const PeprTriangle& frameTri : frame) {
+        shapes.push_back({frameTri.vertex(0), frameTri.vertex(1), frameTri.vertex(2)});
+    }
+    std::vector<TriangleDetail::ShapeProjection> shapeProjections;
+    for(const auto& shape : shapes) {
+        shapeProjections.push_back({&shape, direction});
+    }
+    byTriangles.paintShapes(shapeProjections, 1);
+
+    TriangleDetail byOutlines(tri);
+    byOutlines.paintOutlines({{&outlines.front(), direction}}, 1);
+
+    const auto colorArea = [](const TriangleDetail& detail, size_t color) {
+        double area = 0.0;
+        for(size_t triIdx = 0; triIdx < detail.getTriangles().size(); ++triIdx) {
+            const DataTriangle detailTri = detail.getTriangles().getDataTriangle(triIdx);
+            if(detailTri.getColor() == color) {
+                area += std::sqrt(detailTri.getTri().squared_area());
+            }
+        }
+        return area;
+    };
+    // Half of the frame is inside of the detail
+    EXPECT_NEAR(colorArea(byOutlines, 1), 0.5 * (0.8 * 0.8 - 0.4 * 0.4), 1e-9);
+    EXPECT_NEAR(colorArea(byOutlines, 1), colorArea(byTriangles, 1), 1e-9);
+    EXPECT_NEAR(colorArea(byOutlines, 0), colorArea(byTriangles, 0), 1e-9);
+}
+
 }  // namespace pepr3d
 
 #endif
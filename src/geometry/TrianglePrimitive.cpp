@@ -8,6 +8,7 @@ DataTriangleAABBPrimitive::Datum_reference DataTriangleAABBPrimitive::datum() co
 }
 
 DataTriangleAABBPrimitive::Point DataTriangleAABBPrimitive::reference_point() const {
-    return datum().vertex(0);
+    const glm::vec3 vertex = idPair.first->getTriangle(idPair.second).getVertex(0);
+    return Point(vertex.x, vertex.y, vertex.z);
 }
 }  // namespace pepr3d
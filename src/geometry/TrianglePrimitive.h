@@ -1,35 +1,84 @@
 #pragma once
 
+#include <cstdint>
 #include <limits>
 #include <optional>
+#include <stdexcept>
 #include "geometry/Triangle.h"
+#include "peprassert.h"
 
 namespace pepr3d {
 /// Triangle ID in all detailed triangles
 /// Face index in mMeshDetailed faces;
+/// Packed into 64 bits, 40 bits of the base triangle and 24 bits of the detail triangle, so that it hashes as a single
+/// integer and the same value can be stored in integer buffers.
 struct DetailedTriangleId {
-    DetailedTriangleId() : mBaseId(std::numeric_limits<size_t>::max()), mDetailId() {}
+    /// Largest base triangle and detail triangle, all bits set mark a missing ID
+    static constexpr size_t MAX_BASE_ID = (uint64_t(1) << 40) - 2;
+    static constexpr size_t MAX_DETAIL_ID = (uint64_t(1) << 24) - 2;
+
+    DetailedTriangleId() : mPacked(std::numeric_limits<uint64_t>::max()) {}
+
+    /// Throw std::runtime_error if the base triangles of a mesh of the count do not fit into MAX_BASE_ID.
+    /// The constructor only asserts it, so a mesh is checked once it is loaded.
+    static void checkBaseTriangleCount(const size_t triangleCount) {
+        if(triangleCount > MAX_BASE_ID + 1) {
+            throw std::runtime_error("The model has too many triangles.");
+        }
+    }
+
+    /// Throw std::runtime_error if the triangles of a detail of the count do not fit into MAX_DETAIL_ID.
+    /// The constructor only asserts it, so a detail is checked once its triangles are created.
+    static void checkDetailTriangleCount(const size_t triangleCount) {
+        if(triangleCount > MAX_DETAIL_ID + 1) {
+            throw std::runtime_error("A triangle detail has too many triangles.");
+        }
+    }
 
     explicit DetailedTriangleId(size_t baseId, std::optional<size_t> detailId = {})
-        : mBaseId(baseId), mDetailId(detailId) {}
+        : mPacked(uint64_t(baseId) | (uint64_t(detailId ? *detailId : NO_DETAIL) << BASE_BITS)) {
+        P_ASSERT(baseId <= MAX_BASE_ID);
+        P_ASSERT(!detailId || *detailId <= MAX_DETAIL_ID);
+    }
+
+    /// ID of the packed value from getPacked()
+    static DetailedTriangleId fromPacked(const uint64_t packed) {
+        DetailedTriangleId triangleId;
+        triangleId.mPacked = packed;
+        return triangleId;
+    }
 
     size_t getBaseId() const {
-        return mBaseId;
+        const uint64_t baseId = mPacked & BASE_MASK;
+        return baseId == BASE_MASK ? std::numeric_limits<size_t>::max() : static_cast<size_t>(baseId);
     }
 
     std::optional<size_t> getDetailId() const {
-        return mDetailId;
+        const uint64_t detailId = mPacked >> BASE_BITS;
+        if(detailId == NO_DETAIL) {
+            return {};
+        }
+        return static_cast<size_t>(detailId);
+    }
+
+    uint64_t getPacked() const {
+        return mPacked;
     }
 
     bool operator==(const DetailedTriangleId& other) const {
-        return mBaseId == other.mBaseId && mDetailId == other.mDetailId;
+        return mPacked == other.mPacked;
     }
 
    private:
-    size_t mBaseId;
-    std::optional<size_t> mDetailId;
+    static constexpr unsigned BASE_BITS = 40;
+    static constexpr uint64_t BASE_MASK = (uint64_t(1) << BASE_BITS) - 1;
+    static constexpr uint64_t NO_DETAIL = (uint64_t(1) << (64 - BASE_BITS)) - 1;
+
+    uint64_t mPacked;
 };
 
+static_assert(sizeof(DetailedTriangleId) == sizeof(uint64_t));
+
 /// Provides the conversion facilities between the custom triangle DataTriangle and the CGAL
 /// Triangle_3 class. Taken from CGAL/examples/AABB_tree/custom_example.cpp, modified.
 struct DataTriangleAABBPrimitive {
@@ -39,7 +88,7 @@ struct DataTriangleAABBPrimitive {
     // CGAL types returned
     using Point = DataTriangle::K::Point_3;     // CGAL 3D point type
     using Datum = DataTriangle::K::Triangle_3;  // CGAL 3D triangle type
-    using Datum_reference = const DataTriangle::K::Triangle_3&;
+    using Datum_reference = DataTriangle::K::Triangle_3;  // constructed on demand, not stored in CGAL form
 
    private:
     Id idPair;
@@ -75,7 +124,7 @@ namespace std {
 template <>
 struct hash<pepr3d::DetailedTriangleId> {
     size_t operator()(const pepr3d::DetailedTriangleId& id) const {
-        return std::hash<size_t>{}(id.getBaseId()) ^ std::hash<std::optional<size_t>>{}(id.getDetailId());
+        return std::hash<uint64_t>{}(id.getPacked());
     };
 };
 }  // namespace std
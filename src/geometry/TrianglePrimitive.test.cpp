@@ -0,0 +1,52 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "geometry/TrianglePrimitive.h"
+
+TEST(DetailedTriangleId, packsIds) {
+    /**
+     * Test that the base and detail IDs survive packing into 64 bits, also at their largest values, and that IDs with
+     * and without a detail triangle differ
+     */
+
+    using pepr3d::DetailedTriangleId;
+    const DetailedTriangleId simple(12345);
+    EXPECT_EQ(simple.getBaseId(), 12345);
+    EXPECT_FALSE(simple.getDetailId());
+
+    const DetailedTriangleId detailed(12345, 0);
+    EXPECT_EQ(detailed.getBaseId(), 12345);
+    EXPECT_EQ(detailed.getDetailId(), 0);
+    EXPECT_FALSE(detailed == simple);
+
+    const DetailedTriangleId largest(DetailedTriangleId::MAX_BASE_ID, DetailedTriangleId::MAX_DETAIL_ID);
+    EXPECT_EQ(largest.getBaseId(), DetailedTriangleId::MAX_BASE_ID);
+    EXPECT_EQ(largest.getDetailId(), DetailedTriangleId::MAX_DETAIL_ID);
+    EXPECT_EQ(DetailedTriangleId::fromPacked(largest.getPacked()), largest);
+
+    // The default ID is no triangle
+    EXPECT_EQ(DetailedTriangleId().getBaseId(), std::numeric_limits<size_t>::max());
+    EXPECT_FALSE(DetailedTriangleId().getDetailId());
+
+    const std::unordered_set<DetailedTriangleId> ids{simple, detailed, largest, DetailedTriangleId(12345, 0)};
+    EXPECT_EQ(ids.size(), 3);
+}
+
+TEST(DetailedTriangleId, checksTriangleCounts) {
+    /**
+     * Test that the counts of base and detail triangles are rejected once their largest ID would not fit
+     */
+
+    using pepr3d::DetailedTriangleId;
+    EXPECT_NO_THROW(DetailedTriangleId::checkBaseTriangleCount(0));
+    EXPECT_NO_THROW(DetailedTriangleId::checkBaseTriangleCount(DetailedTriangleId::MAX_BASE_ID + 1));
+    EXPECT_THROW(DetailedTriangleId::checkBaseTriangleCount(DetailedTriangleId::MAX_BASE_ID + 2), std::runtime_error);
+    EXPECT_NO_THROW(DetailedTriangleId::checkDetailTriangleCount(DetailedTriangleId::MAX_DETAIL_ID + 1));
+    EXPECT_THROW(DetailedTriangleId::checkDetailTriangleCount(DetailedTriangleId::MAX_DETAIL_ID + 2),
+                 std::runtime_error);
+}
+
+#endif
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "peprassert.h"
+
+namespace pepr3d {
+
+/// Map of base triangles to values, for the few triangles that have one. The values are stored densely one slot
+/// after another and a per-triangle table holds the slot of each triangle, so a lookup is two array reads instead of
+/// a tree walk. The table takes 4 bytes per triangle up to the largest triangle with a value.
+/// Slots are in no particular order, adding or erasing a value invalidates pointers to the values and iterators.
+template <typename Value>
+class TriangleSlotMap {
+   public:
+    /// Triangle and its value
+    using Slot = std::pair<size_t, Value>;
+
+    using iterator = typename std::vector<Slot>::iterator;
+    using const_iterator = typename std::vector<Slot>::const_iterator;
+
+    Value* find(const size_t triangleIdx) {
+        const uint32_t slotIdx = getSlotIdx(triangleIdx);
+        return slotIdx == NO_SLOT ? nullptr : &mSlots[slotIdx].second;
+    }
+
+    const Value* find(const size_t triangleIdx) const {
+        const uint32_t slotIdx = getSlotIdx(triangleIdx);
+        return slotIdx == NO_SLOT ? nullptr : &mSlots[slotIdx].second;
+    }
+
+    bool contains(const size_t triangleIdx) const {
+        return getSlotIdx(triangleIdx) != NO_SLOT;
+    }
+
+    /// Value of the triangle, a default constructed one is added if it has none
+    Value& operator[](const size_t triangleIdx) {
+        uint32_t slotIdx = getSlotIdx(triangleIdx);
+        if(slotIdx == NO_SLOT) {
+            P_ASSERT(mSlots.size() < NO_SLOT);
+            if(triangleIdx >= mTriangleSlots.size()) {
+                mTriangleSlots.resize(triangleIdx + 1, NO_SLOT);
+            }
+            slotIdx = static_cast<uint32_t>(mSlots.size());
+            mTriangleSlots[triangleIdx] = slotIdx;
+            mSlots.emplace_back(triangleIdx, Value());
+        }
+        return mSlots[slotIdx].second;
+    }
+
+    /// Remove the value of the triangle, the last slot moves into its place
+    /// @return false if the triangle had no value
+    bool erase(const size_t triangleIdx) {
+        const uint32_t slotIdx = getSlotIdx(triangleIdx);
+        if(slotIdx == NO_SLOT) {
+            return false;
+        }
+        if(slotIdx + 1 < mSlots.size()) {
+            mSlots[slotIdx] = std::move(mSlots.back());
+            mTriangleSlots[mSlots[slotIdx].first] = slotIdx;
+        }
+        mSlots.pop_back();
+        mTriangleSlots[triangleIdx] = NO_SLOT;
+        return true;
+    }
+
+    /// Remove the values for which pred(triangleIdx, value) is true, the remaining slots keep their order
+    template <typename Predicate>
+    void eraseIf(const Predicate& pred) {
+        size_t kept = 0;
+        for(size_t slotIdx = 0; slotIdx < mSlots.size(); ++slotIdx) {
+            Slot& slot = mSlots[slotIdx];
+            if(pred(slot.first, slot.second)) {
+                mTriangleSlots[slot.first] = NO_SLOT;
+                continue;
+            }
+            if(kept != slotIdx) {
+                mSlots[kept] = std::move(slot);
+            }
+            mTriangleSlots[mSlots[kept].first] = static_cast<uint32_t>(kept);
+            ++kept;
+        }
+        mSlots.resize(kept);
+    }
+
+    /// Remove all values, only the slots in use are visited
+    void clear() {
+        for(const Slot& slot : mSlots) {
+            mTriangleSlots[slot.first] = NO_SLOT;
+        }
+        mSlots.clear();
+    }
+
+    size_t size() const {
+        return mSlots.size();
+    }
+
+    bool empty() const {
+        return mSlots.empty();
+    }
+
+    iterator begin() {
+        return mSlots.begin();
+    }
+
+    iterator end() {
+        return mSlots.end();
+    }
+
+    const_iterator begin() const {
+        return mSlots.begin();
+    }
+
+    const_iterator end() const {
+        return mSlots.end();
+    }
+
+    /// Memory of the slots and of the table, not of memory owned by the values
+    size_t getApproximateMemorySize() const {
+        return sizeof(*this) + mSlots.capacity() * sizeof(Slot) + mTriangleSlots.capacity() * sizeof(uint32_t);
+    }
+
+   private:
+    static constexpr uint32_t NO_SLOT = std::numeric_limits<uint32_t>::max();
+
+    uint32_t getSlotIdx(const size_t triangleIdx) const {
+        return triangleIdx < mTriangleSlots.size() ? mTriangleSlots[triangleIdx] : NO_SLOT;
+    }
+
+    std::vector<Slot> mSlots;
+
+    /// Slot of each triangle, NO_SLOT for triangles without a value
+    std::vector<uint32_t> mTriangleSlots;
+};
+
+}  // namespace pepr3d
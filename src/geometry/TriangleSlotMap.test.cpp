@@ -0,0 +1,59 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <map>
+#include <string>
+
+#include "geometry/TriangleSlotMap.h"
+
+TEST(TriangleSlotMap, matchesMap) {
+    /**
+     * Test that adding and erasing values in any order finds the same values as a std::map, also after the slots
+     * moved to fill the erased ones
+     */
+
+    pepr3d::TriangleSlotMap<std::string> slotMap;
+    std::map<size_t, std::string> expected;
+    EXPECT_TRUE(slotMap.empty());
+    EXPECT_EQ(slotMap.find(5), nullptr);
+
+    for(size_t step = 0; step < 2000; ++step) {
+        const size_t triangleIdx = (step * 7919) % 613;
+        if(step % 3 == 2) {
+            EXPECT_EQ(slotMap.erase(triangleIdx), expected.erase(triangleIdx) > 0);
+        } else {
+            slotMap[triangleIdx] = std::to_string(step);
+            expected[triangleIdx] = std::to_string(step);
+        }
+    }
+
+    ASSERT_EQ(slotMap.size(), expected.size());
+    for(size_t triangleIdx = 0; triangleIdx < 700; ++triangleIdx) {
+        const auto it = expected.find(triangleIdx);
+        EXPECT_EQ(slotMap.contains(triangleIdx), it != expected.end());
+        if(it != expected.end()) {
+            ASSERT_NE(slotMap.find(triangleIdx), nullptr);
+            EXPECT_EQ(*slotMap.find(triangleIdx), it->second);
+        }
+    }
+    std::map<size_t, std::string> iterated(slotMap.begin(), slotMap.end());
+    EXPECT_EQ(iterated, expected);
+
+    // Erase the odd triangles, then everything
+    slotMap.eraseIf([](const size_t triangleIdx, const std::string&) { return triangleIdx % 2 == 1; });
+    for(auto it = expected.begin(); it != expected.end();) {
+        it = it->first % 2 == 1 ? expected.erase(it) : std::next(it);
+    }
+    iterated = std::map<size_t, std::string>(slotMap.begin(), slotMap.end());
+    EXPECT_EQ(iterated, expected);
+    for(const auto& value : expected) {
+        EXPECT_EQ(*slotMap.find(value.first), value.second);
+    }
+
+    slotMap.clear();
+    EXPECT_TRUE(slotMap.empty());
+    EXPECT_FALSE(slotMap.contains(expected.begin()->first));
+    EXPECT_FALSE(slotMap.erase(1000));
+}
+
+#endif
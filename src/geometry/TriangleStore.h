@@ -0,0 +1,291 @@
+#pragma once
+
+#include <cereal/access.hpp>
+#include <cereal/types/vector.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+#include "geometry/ColorManager.h"
+#include "geometry/Triangle.h"
+#include "peprassert.h"
+
+namespace pepr3d {
+
+/// Struct-of-arrays store of the triangles of the original mesh.
+/// Vertex positions, normals and colors are kept in flat arrays, so that loops over all triangles stay cache friendly.
+/// CGAL triangles are not stored, they are constructed on demand where the AABB tree or exact predicates need them.
+class TriangleStore {
+   public:
+    using PackedColorChunk = std::shared_ptr<const std::vector<std::uint8_t>>;
+
+    /// Number of triangles in a single chunk of getPackedColorChunks()
+    static constexpr size_t COLOR_CHUNK_TRIANGLES = 8192;
+
+    TriangleStore() = default;
+
+    explicit TriangleStore(const std::vector<DataTriangle>& triangles) {
+        assign(triangles);
+    }
+
+    /// Replace the content of the store with the triangles
+    void assign(const std::vector<DataTriangle>& triangles) {
+        clear();
+        reserve(triangles.size());
+        for(const DataTriangle& triangle : triangles) {
+            push_back(triangle);
+        }
+    }
+
+    /// Replace the content of the store, with 3 consecutive vertices and a normal and a color for each triangle
+    void assign(std::vector<glm::vec3>&& vertices, std::vector<glm::vec3>&& normals,
+                std::vector<ColorIndex>&& colors) {
+        P_ASSERT(vertices.size() == 3 * normals.size() && normals.size() == colors.size());
+        clear();
+        mVertices = std::move(vertices);
+        mNormals = std::move(normals);
+        mColors = std::move(colors);
+    }
+
+    void push_back(const DataTriangle& triangle) {
+        mVertices.push_back(triangle.getVertex(0));
+        mVertices.push_back(triangle.getVertex(1));
+        mVertices.push_back(triangle.getVertex(2));
+        mNormals.push_back(triangle.getNormal());
+        mColors.push_back(triangle.getColor());
+        invalidateColorChunk(mColors.size() - 1);
+    }
+
+    void push_back(const std::array<glm::vec3, 3>& vertices, const glm::vec3& normal, const size_t color) {
+        mVertices.insert(mVertices.end(), vertices.begin(), vertices.end());
+        mNormals.push_back(normal);
+        mColors.push_back(static_cast<ColorIndex>(color));
+        invalidateColorChunk(mColors.size() - 1);
+    }
+
+    /// Append the triangles [triangleBegin, triangleEnd) of another store
+    void append(const TriangleStore& other, const size_t triangleBegin, const size_t triangleEnd) {
+        P_ASSERT(triangleBegin <= triangleEnd && triangleEnd <= other.size());
+        const size_t oldSize = size();
+        mVertices.insert(mVertices.end(), other.mVertices.begin() + 3 * triangleBegin,
+                         other.mVertices.begin() + 3 * triangleEnd);
+        mNormals.insert(mNormals.end(), other.mNormals.begin() + triangleBegin, other.mNormals.begin() + triangleEnd);
+        mColors.insert(mColors.end(), other.mColors.begin() + triangleBegin, other.mColors.begin() + triangleEnd);
+        for(size_t triangleIdx = oldSize; triangleIdx < size(); triangleIdx += COLOR_CHUNK_TRIANGLES) {
+            invalidateColorChunk(triangleIdx);
+        }
+        if(oldSize < size()) {
+            invalidateColorChunk(size() - 1);
+        }
+    }
+
+    void reserve(const size_t triangleCount) {
+        mVertices.reserve(3 * triangleCount);
+        mNormals.reserve(triangleCount);
+        mColors.reserve(triangleCount);
+    }
+
+    void clear() {
+        mVertices.clear();
+        mNormals.clear();
+        mColors.clear();
+        mPackedColorChunks.clear();
+    }
+
+    size_t size() const {
+        return mColors.size();
+    }
+
+    bool empty() const {
+        return mColors.empty();
+    }
+
+    /// Rough estimate of the memory taken by the triangles in bytes.
+    /// The packed color chunks are shared with the undo snapshots, only the cache of their pointers is included.
+    size_t getApproximateMemorySize() const {
+        return sizeof(TriangleStore) + mVertices.capacity() * sizeof(glm::vec3) +
+               mNormals.capacity() * sizeof(glm::vec3) + mColors.capacity() * sizeof(ColorIndex) +
+               mPackedColorChunks.capacity() * sizeof(PackedColorChunk);
+    }
+
+    glm::vec3 getVertex(const size_t triangleIdx, const size_t vertexIdx) const {
+        P_ASSERT(triangleIdx < size() && vertexIdx < 3);
+        return mVertices[3 * triangleIdx + vertexIdx];
+    }
+
+    glm::vec3 getNormal(const size_t triangleIdx) const {
+        P_ASSERT(triangleIdx < size());
+        return mNormals[triangleIdx];
+    }
+
+    size_t getColor(const size_t triangleIdx) const {
+        P_ASSERT(triangleIdx < size());
+        return mColors[triangleIdx];
+    }
+
+    void setColor(const size_t triangleIdx, const size_t color) {
+        P_ASSERT(triangleIdx < size());
+        if(mColors[triangleIdx] != color) {
+            mColors[triangleIdx] = static_cast<ColorIndex>(color);
+            invalidateColorChunk(triangleIdx);
+        }
+    }
+
+    /// Vertex positions of all triangles, 3 consecutive vertices for each triangle
+    const std::vector<glm::vec3>& getVertices() const {
+        return mVertices;
+    }
+
+    /// Normals of all triangles
+    const std::vector<glm::vec3>& getNormals() const {
+        return mNormals;
+    }
+
+    /// Colors of all triangles
+    const std::vector<ColorIndex>& getColors() const {
+        return mColors;
+    }
+
+    /// Colors of all triangles packed to 4 bits each, two triangles per byte, in chunks of COLOR_CHUNK_TRIANGLES.
+    /// Used for undo snapshots. Chunks are immutable and cached until a color in them changes,
+    /// so consecutive snapshots share the chunks that did not change.
+    std::vector<PackedColorChunk> getPackedColorChunks() const {
+        mPackedColorChunks.resize(getColorChunkCount());
+        for(size_t chunkIdx = 0; chunkIdx < mPackedColorChunks.size(); ++chunkIdx) {
+            if(!mPackedColorChunks[chunkIdx]) {
+                mPackedColorChunks[chunkIdx] = packColorChunk(chunkIdx);
+            }
+        }
+        return mPackedColorChunks;
+    }
+
+    /// Set colors of all triangles from the output of getPackedColorChunks()
+    void setPackedColorChunks(const std::vector<PackedColorChunk>& chunks) {
+        P_ASSERT(chunks.size() == getColorChunkCount());
+        for(size_t triangleIdx = 0; triangleIdx < size(); ++triangleIdx) {
+            mColors[triangleIdx] = getPackedColor(chunks, triangleIdx);
+        }
+        mPackedColorChunks = chunks;
+    }
+
+    /// Color of a triangle in the output of getPackedColorChunks()
+    static ColorIndex getPackedColor(const std::vector<PackedColorChunk>& chunks, const size_t triangleIdx) {
+        P_ASSERT(triangleIdx / COLOR_CHUNK_TRIANGLES < chunks.size());
+        const std::vector<std::uint8_t>& chunk = *chunks[triangleIdx / COLOR_CHUNK_TRIANGLES];
+        const size_t chunkOffset = triangleIdx % COLOR_CHUNK_TRIANGLES;
+        const int color = chunk[chunkOffset / 2] >> (PACKED_COLOR_BITS * (chunkOffset % 2));
+        return static_cast<ColorIndex>(color & ((1 << PACKED_COLOR_BITS) - 1));
+    }
+
+    /// Construct the CGAL triangle. Each call creates a new object, keep it if you need it more than once.
+    DataTriangle::Triangle getCgalTriangle(const size_t triangleIdx) const {
+        return DataTriangle::Triangle(toPoint(getVertex(triangleIdx, 0)), toPoint(getVertex(triangleIdx, 1)),
+                                      toPoint(getVertex(triangleIdx, 2)));
+    }
+
+    /// Construct a full DataTriangle, including the CGAL triangle
+    DataTriangle getDataTriangle(const size_t triangleIdx) const {
+        return DataTriangle(getVertex(triangleIdx, 0), getVertex(triangleIdx, 1), getVertex(triangleIdx, 2),
+                            getNormal(triangleIdx), getColor(triangleIdx));
+    }
+
+   private:
+    /// Number of bits of a single color in getPackedColors(), enough for PEPR3D_MAX_PALETTE_COLORS colors
+    static constexpr int PACKED_COLOR_BITS = 4;
+    static_assert(PEPR3D_MAX_PALETTE_COLORS <= (1 << PACKED_COLOR_BITS), "Palette does not fit into packed colors");
+
+    static DataTriangle::Point toPoint(const glm::vec3& v) {
+        return DataTriangle::Point(v.x, v.y, v.z);
+    }
+
+    size_t getColorChunkCount() const {
+        return (size() + COLOR_CHUNK_TRIANGLES - 1) / COLOR_CHUNK_TRIANGLES;
+    }
+
+    PackedColorChunk packColorChunk(const size_t chunkIdx) const {
+        const size_t chunkBegin = chunkIdx * COLOR_CHUNK_TRIANGLES;
+        const size_t chunkEnd = std::min(chunkBegin + COLOR_CHUNK_TRIANGLES, size());
+        auto packed = std::make_shared<std::vector<std::uint8_t>>((chunkEnd - chunkBegin + 1) / 2, 0);
+        for(size_t triangleIdx = chunkBegin; triangleIdx < chunkEnd; ++triangleIdx) {
+            P_ASSERT(mColors[triangleIdx] < (1 << PACKED_COLOR_BITS));
+            const size_t chunkOffset = triangleIdx - chunkBegin;
+            (*packed)[chunkOffset / 2] |=
+                static_cast<std::uint8_t>(mColors[triangleIdx] << (PACKED_COLOR_BITS * (chunkOffset % 2)));
+        }
+        return packed;
+    }
+
+    void invalidateColorChunk(const size_t triangleIdx) {
+        const size_t chunkIdx = triangleIdx / COLOR_CHUNK_TRIANGLES;
+        if(chunkIdx < mPackedColorChunks.size()) {
+            mPackedColorChunks[chunkIdx].reset();
+        }
+    }
+
+    std::vector<glm::vec3> mVertices;
+    std::vector<glm::vec3> mNormals;
+    std::vector<ColorIndex> mColors;
+
+    /// Cache of getPackedColorChunks(), a null chunk has to be packed again
+    mutable std::vector<PackedColorChunk> mPackedColorChunks;
+
+    friend class cereal::access;
+
+    /// Serialized as a vector of DataTriangle, to stay compatible with existing files
+    template <class Archive>
+    void save(Archive& archive) const {
+        std::vector<DataTriangle> triangles;
+        triangles.reserve(size());
+        for(size_t triangleIdx = 0; triangleIdx < size(); ++triangleIdx) {
+            triangles.push_back(getDataTriangle(triangleIdx));
+        }
+        archive(triangles);
+    }
+
+    template <class Archive>
+    void load(Archive& archive) {
+        std::vector<DataTriangle> triangles;
+        archive(triangles);
+        assign(triangles);
+    }
+};
+
+/// Read-only view of a single triangle, either of a DataTriangle or of a triangle in a TriangleStore.
+/// Cheap to copy, valid as long as the viewed triangle exists.
+class TriangleView {
+   public:
+    TriangleView(const DataTriangle& triangle) : mTriangle(&triangle) {}
+
+    TriangleView(const TriangleStore& store, const size_t triangleIdx) : mStore(&store), mIndex(triangleIdx) {}
+
+    glm::vec3 getVertex(const size_t i) const {
+        return mTriangle ? mTriangle->getVertex(i) : mStore->getVertex(mIndex, i);
+    }
+
+    glm::vec3 getNormal() const {
+        return mTriangle ? mTriangle->getNormal() : mStore->getNormal(mIndex);
+    }
+
+    size_t getColor() const {
+        return mTriangle ? mTriangle->getColor() : mStore->getColor(mIndex);
+    }
+
+    /// CGAL triangle, constructed on demand for triangles in a TriangleStore
+    DataTriangle::Triangle getTri() const {
+        return mTriangle ? mTriangle->getTri() : mStore->getCgalTriangle(mIndex);
+    }
+
+    DataTriangle getDataTriangle() const {
+        return mTriangle ? *mTriangle : mStore->getDataTriangle(mIndex);
+    }
+
+   private:
+    const DataTriangle* mTriangle = nullptr;
+    const TriangleStore* mStore = nullptr;
+    size_t mIndex = 0;
+};
+
+}  // namespace pepr3d
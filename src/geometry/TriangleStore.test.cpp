@@ -0,0 +1,108 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <sstream>
+
+#include <cereal/archives/binary.hpp>
+#include "geometry/TriangleStore.h"
+
+namespace {
+std::vector<pepr3d::DataTriangle> getTwoTriangles() {
+    return {pepr3d::DataTriangle(glm::vec3(0, 0, 0), glm::vec3(1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, 0, 1), 2),
+            pepr3d::DataTriangle(glm::vec3(1, 0, 0), glm::vec3(1, 1, 0), glm::vec3(0, 1, 0), glm::vec3(0, 0, 1), 3)};
+}
+}  // namespace
+
+TEST(TriangleStore, matchesDataTriangles) {
+    /**
+     * Test that the store returns the same data as the DataTriangle it was created from
+     */
+
+    const auto triangles = getTwoTriangles();
+    pepr3d::TriangleStore store(triangles);
+    ASSERT_EQ(store.size(), 2);
+    EXPECT_EQ(store.getVertices().size(), 6);
+
+    for(size_t triIdx = 0; triIdx < triangles.size(); ++triIdx) {
+        const pepr3d::TriangleView view(store, triIdx);
+        EXPECT_EQ(view.getColor(), triangles[triIdx].getColor());
+        EXPECT_EQ(view.getNormal(), triangles[triIdx].getNormal());
+        for(size_t i = 0; i < 3; ++i) {
+            EXPECT_EQ(view.getVertex(i), triangles[triIdx].getVertex(i));
+        }
+        EXPECT_EQ(view.getTri(), triangles[triIdx].getTri());
+    }
+
+    store.setColor(1, 0);
+    EXPECT_EQ(store.getColor(1), 0);
+    EXPECT_EQ(store.getDataTriangle(1).getColor(), 0);
+}
+
+TEST(TriangleStore, serializeAsDataTriangles) {
+    /**
+     * Test that the store is serialized the same way as a vector of DataTriangle
+     */
+
+    const auto triangles = getTwoTriangles();
+    const pepr3d::TriangleStore store(triangles);
+
+    std::stringstream storeStream;
+    {
+        cereal::BinaryOutputArchive archive(storeStream);
+        archive(store);
+    }
+    std::stringstream vectorStream;
+    {
+        cereal::BinaryOutputArchive archive(vectorStream);
+        archive(triangles);
+    }
+    EXPECT_EQ(storeStream.str(), vectorStream.str());
+
+    pepr3d::TriangleStore loaded;
+    {
+        cereal::BinaryInputArchive archive(vectorStream);
+        archive(loaded);
+    }
+    ASSERT_EQ(loaded.size(), store.size());
+    EXPECT_EQ(loaded.getVertices(), store.getVertices());
+    EXPECT_EQ(loaded.getColors(), store.getColors());
+}
+
+TEST(TriangleStore, packedColorChunks) {
+    /**
+     * Test that colors survive packing into 4 bits and that unchanged chunks are shared between snapshots
+     */
+
+    const auto twoTriangles = getTwoTriangles();
+    std::vector<pepr3d::DataTriangle> triangles;
+    // Two full chunks and an odd number of triangles in the last one
+    const size_t triangleCount = 2 * pepr3d::TriangleStore::COLOR_CHUNK_TRIANGLES + 3;
+    for(size_t triIdx = 0; triIdx < triangleCount; ++triIdx) {
+        triangles.push_back(twoTriangles[triIdx % 2]);
+    }
+    pepr3d::TriangleStore store(triangles);
+    store.setColor(0, 15);
+    store.setColor(triangleCount - 1, 7);
+
+    const auto chunks = store.getPackedColorChunks();
+    ASSERT_EQ(chunks.size(), 3);
+    EXPECT_EQ(chunks.back()->size(), 2);
+
+    pepr3d::TriangleStore restored(triangles);
+    restored.setPackedColorChunks(chunks);
+    EXPECT_EQ(restored.getColors(), store.getColors());
+    EXPECT_EQ(pepr3d::TriangleStore::getPackedColor(chunks, 0), 15);
+    EXPECT_EQ(pepr3d::TriangleStore::getPackedColor(chunks, triangleCount - 1), 7);
+
+    // Only the chunk with the changed color is packed again
+    store.setColor(pepr3d::TriangleStore::COLOR_CHUNK_TRIANGLES, 1);
+    const auto nextChunks = store.getPackedColorChunks();
+    EXPECT_EQ(nextChunks[0], chunks[0]);
+    EXPECT_NE(nextChunks[1], chunks[1]);
+    EXPECT_EQ(nextChunks[2], chunks[2]);
+
+    restored.setPackedColorChunks(nextChunks);
+    EXPECT_EQ(restored.getColors(), store.getColors());
+}
+
+#endif
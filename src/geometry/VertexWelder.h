@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <boost/functional/hash.hpp>
+#include <glm/glm.hpp>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "peprassert.h"
+
+namespace pepr3d {
+
+/// Merges the vertices with identical positions into one, to get an index buffer of a closed mesh from a mesh with
+/// separate vertices for each face.
+/// The positions are hashed into buckets, which are welded in parallel, since equal positions always share a bucket.
+/// The welded vertices keep the order of their first occurrence, so the result does not depend on the threads.
+class VertexWelder {
+    using Key = std::array<float, 3>;
+    using KeyHash = boost::hash<Key>;
+
+   public:
+    VertexWelder(const std::vector<glm::vec3>& positions, ::ThreadPool& threadPool) {
+        weld(positions, threadPool);
+    }
+
+    /// Positions of the welded vertices
+    const std::vector<glm::vec3>& getVertices() const {
+        return mVertices;
+    }
+
+    /// Index of the welded vertex of each of the positions
+    const std::vector<size_t>& getIndices() const {
+        return mIndices;
+    }
+
+   private:
+    /// Positive and negative zero are the same position, but hash differently
+    static Key getKey(const glm::vec3& position) {
+        return {position.x + 0.f, position.y + 0.f, position.z + 0.f};
+    }
+
+    void weld(const std::vector<glm::vec3>& positions, ::ThreadPool& threadPool) {
+        const size_t count = positions.size();
+        const size_t bucketCount = 4 * (threadPool.size() + 1);
+
+        // Items for parallel_for
+        std::vector<size_t> positionIds(count);
+        std::iota(positionIds.begin(), positionIds.end(), 0);
+        std::vector<size_t> bucketIds(bucketCount);
+        std::iota(bucketIds.begin(), bucketIds.end(), 0);
+
+        std::vector<size_t> buckets(count);
+        threadPool.parallel_for(positionIds.begin(), positionIds.end(), [&](const size_t positionIdx) {
+            buckets[positionIdx] = KeyHash()(getKey(positions[positionIdx])) % bucketCount;
+        });
+
+        // Sort the positions by their buckets, keeping their order within each bucket
+        std::vector<size_t> bucketStarts(bucketCount + 1, 0);
+        for(const size_t bucket : buckets) {
+            ++bucketStarts[bucket + 1];
+        }
+        std::partial_sum(bucketStarts.begin(), bucketStarts.end(), bucketStarts.begin());
+        std::vector<size_t> bucketed(count);
+        std::vector<size_t> bucketEnds(bucketStarts.begin(), bucketStarts.end() - 1);
+        for(size_t positionIdx = 0; positionIdx < count; ++positionIdx) {
+            bucketed[bucketEnds[buckets[positionIdx]]++] = positionIdx;
+        }
+
+        // The first occurrence of each position in its bucket represents all of them
+        std::vector<size_t> firstOccurrences(count);
+        threadPool.parallel_for(bucketIds.begin(), bucketIds.end(), [&](const size_t bucket) {
+            std::unordered_map<Key, size_t, KeyHash> firstOccurrence;
+            firstOccurrence.reserve(bucketStarts[bucket + 1] - bucketStarts[bucket]);
+            for(size_t i = bucketStarts[bucket]; i < bucketStarts[bucket + 1]; ++i) {
+                const size_t positionIdx = bucketed[i];
+                firstOccurrences[positionIdx] =
+                    firstOccurrence.emplace(getKey(positions[positionIdx]), positionIdx).first->second;
+            }
+        });
+
+        mVertices.clear();
+        mIndices.resize(count);
+        for(size_t positionIdx = 0; positionIdx < count; ++positionIdx) {
+            const size_t first = firstOccurrences[positionIdx];
+            P_ASSERT(first <= positionIdx);
+            if(first == positionIdx) {
+                mIndices[positionIdx] = mVertices.size();
+                mVertices.push_back(positions[positionIdx]);
+            } else {
+                mIndices[positionIdx] = mIndices[first];
+            }
+        }
+    }
+
+    std::vector<glm::vec3> mVertices;
+    std::vector<size_t> mIndices;
+};
+
+}  // namespace pepr3d
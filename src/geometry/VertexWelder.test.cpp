@@ -0,0 +1,54 @@
+#ifdef _TEST_
+
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "geometry/VertexWelder.h"
+
+TEST(VertexWelder, weldsIdenticalPositions) {
+    /**
+     * Test that identical positions get one vertex, in the order of their first occurrence
+     */
+
+    ::ThreadPool threadPool(2);
+    const std::vector<glm::vec3> positions{{0.f, 0.f, 0.f}, {1.f, 0.f, 0.f}, {0.f, 1.f, 0.f},
+                                           {1.f, 0.f, 0.f}, {0.f, -0.f, 0.f}, {1.f, 1.f, 0.f},
+                                           {0.f, 1.f, 0.f}, {1.f, 0.f, 1e-7f}};
+    const pepr3d::VertexWelder welder(positions, threadPool);
+
+    EXPECT_EQ(welder.getIndices(), std::vector<size_t>({0, 1, 2, 1, 0, 3, 2, 4}));
+    ASSERT_EQ(welder.getVertices().size(), 5);
+    EXPECT_EQ(welder.getVertices()[3], glm::vec3(1.f, 1.f, 0.f));
+    EXPECT_EQ(welder.getVertices()[4], glm::vec3(1.f, 0.f, 1e-7f));
+
+    const pepr3d::VertexWelder empty({}, threadPool);
+    EXPECT_TRUE(empty.getVertices().empty());
+    EXPECT_TRUE(empty.getIndices().empty());
+}
+
+TEST(VertexWelder, independentOfThreads) {
+    /**
+     * Test that a mesh with separate vertices for each face welds the same with any number of threads
+     */
+
+    std::mt19937 random(5);
+    std::uniform_int_distribution<int> coordinate(0, 20);
+    std::vector<glm::vec3> positions(30000);
+    for(glm::vec3& position : positions) {
+        position = glm::vec3(coordinate(random), coordinate(random), coordinate(random)) * 0.1f;
+    }
+
+    ::ThreadPool serialPool(0);
+    ::ThreadPool parallelPool(4);
+    const pepr3d::VertexWelder serial(positions, serialPool);
+    const pepr3d::VertexWelder parallel(positions, parallelPool);
+    EXPECT_EQ(serial.getIndices(), parallel.getIndices());
+    EXPECT_EQ(serial.getVertices(), parallel.getVertices());
+    for(size_t positionIdx = 0; positionIdx < positions.size(); ++positionIdx) {
+        EXPECT_EQ(serial.getVertices()[serial.getIndices()[positionIdx]], positions[positionIdx]);
+    }
+}
+
+#endif
@@ -40,4 +40,164 @@ TEST(Libraries, CGAL) {
     EXPECT_EQ(result.size(), 3);
 }
 
-#endif
\ No newline at end of file
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include "ThreadPool.h"
+
+TEST(Libraries, ThreadPoolParallelFor) {
+    // A single worker must not deadlock when tasks wait for nested tasks
+    ThreadPool pool(1);
+    std::vector<int> values(1000);
+    std::iota(values.begin(), values.end(), 0);
+
+    std::atomic<long> sum(0);
+    pool.parallel_for(values.begin(), values.end(), [&pool, &sum](int value) {
+        auto nested = pool.enqueue([value]() { return 2 * value; });
+        sum += pool.wait(nested);
+    });
+    EXPECT_EQ(sum.load(), 999 * 1000);
+
+    std::atomic<int> calls(0);
+    pool.parallel_for(values.begin(), values.end(), [&calls](int) { ++calls; }, 7);
+    EXPECT_EQ(calls.load(), 1000);
+}
+
+TEST(Libraries, ThreadPoolParallelForException) {
+    ThreadPool pool(2);
+    std::vector<int> values(100, 0);
+    values[42] = 1;
+    EXPECT_THROW(pool.parallel_for(values.begin(), values.end(),
+                                   [](int value) {
+                                       if(value) {
+                                           throw std::runtime_error("failed");
+                                       }
+                                   },
+                                   1),
+                 std::runtime_error);
+}
+
+TEST(Libraries, ThreadPoolParallelForWeighted) {
+    ThreadPool pool(3);
+    std::vector<int> values(500);
+    std::iota(values.begin(), values.end(), 0);
+
+    // Every element is processed exactly once, regardless of its cost
+    std::vector<std::atomic<int>> calls(values.size());
+    pool.parallel_for_weighted(values.begin(), values.end(), [&calls](int value) { ++calls[value]; },
+                               [](int value) { return value % 10 == 0 ? 1000 : value % 3; });
+    for(const auto& count : calls) {
+        EXPECT_EQ(count.load(), 1);
+    }
+
+    // The most expensive element is started first
+    ThreadPool serialPool(0);
+    std::vector<int> order;
+    serialPool.parallel_for_weighted(values.begin(), values.end(), [&order](int value) { order.push_back(value); },
+                                     [](int value) { return value == 123 ? 1000 : 1; });
+    ASSERT_EQ(order.size(), values.size());
+    EXPECT_EQ(order.front(), 123);
+}
+
+TEST(Libraries, ThreadPoolPriorities) {
+    // With the only worker busy, the interactive task queued last starts first
+    ThreadPool pool(1);
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    auto blocker = pool.enqueue([released]() { released.wait(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    std::mutex orderMutex;
+    std::vector<ThreadPool::priority> order;
+    const auto record = [&orderMutex, &order]() {
+        std::lock_guard<std::mutex> lock(orderMutex);
+        order.push_back(ThreadPool::current_priority());
+    };
+    auto background = pool.enqueue(ThreadPool::priority::background, record);
+    auto normal = pool.enqueue(record);
+    auto interactive = pool.enqueue(ThreadPool::priority::interactive, record);
+    release.set_value();
+    blocker.get();
+    background.get();
+    normal.get();
+    interactive.get();
+    EXPECT_EQ(order, (std::vector<ThreadPool::priority>{ThreadPool::priority::interactive,
+                                                         ThreadPool::priority::normal,
+                                                         ThreadPool::priority::background}));
+
+    // Background tasks and their nested loops run on at most 2 threads at once
+    ThreadPool widePool(4);
+    widePool.set_background_limit(2);
+    std::atomic<int> runningThreads(0);
+    std::atomic<int> maxRunningThreads(0);
+    std::vector<std::future<void>> tasks;
+    for(int i = 0; i < 16; ++i) {
+        tasks.push_back(widePool.enqueue(ThreadPool::priority::background, [&]() {
+            static thread_local int depth = 0;
+            if(depth++ == 0) {
+                const int running = ++runningThreads;
+                int maxRunning = maxRunningThreads.load();
+                while(running > maxRunning && !maxRunningThreads.compare_exchange_weak(maxRunning, running)) {
+                }
+            }
+            std::vector<int> values(50);
+            widePool.parallel_for(values.begin(), values.end(), [](int) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            });
+            if(--depth == 0) {
+                --runningThreads;
+            }
+        }));
+    }
+    for(std::future<void>& task : tasks) {
+        widePool.wait(task);
+    }
+    EXPECT_LE(maxRunningThreads.load(), 2);
+    EXPECT_GE(maxRunningThreads.load(), 1);
+}
+
+TEST(Libraries, ThreadPoolWaitingSkipsBackground) {
+    // An interactive parallel loop waiting for its last chunk does not run a queued background job inline
+    ThreadPool pool(2);
+    std::promise<void> releaseFirst;
+    std::promise<void> releaseSecond;
+    std::shared_future<void> firstReleased = releaseFirst.get_future().share();
+    std::shared_future<void> secondReleased = releaseSecond.get_future().share();
+    auto firstBlocker = pool.enqueue([firstReleased]() { firstReleased.wait(); });
+    auto secondBlocker = pool.enqueue([secondReleased]() { secondReleased.wait(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    auto background = pool.enqueue(ThreadPool::priority::background,
+                                   []() { std::this_thread::sleep_for(std::chrono::seconds(1)); });
+
+    const auto start = std::chrono::steady_clock::now();
+    {
+        const ThreadPool::priority_scope scope(ThreadPool::priority::interactive);
+        // The calling thread frees a worker for the second chunk and waits for it to start, the worker goes for
+        // the interactive chunk before the background job
+        std::atomic<bool> isSecondStarted(false);
+        std::vector<int> values{0, 1};
+        pool.parallel_for(values.begin(), values.end(), [&](const int value) {
+            if(value == 0) {
+                releaseFirst.set_value();
+                while(!isSecondStarted) {
+                    std::this_thread::yield();
+                }
+            } else {
+                isSecondStarted = true;
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+        }, 1);
+    }
+    const auto duration = std::chrono::steady_clock::now() - start;
+    EXPECT_LT(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count(), 500);
+
+    releaseSecond.set_value();
+    firstBlocker.get();
+    secondBlocker.get();
+    background.get();
+}
+
+#endif
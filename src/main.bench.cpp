@@ -0,0 +1,122 @@
+#ifdef _BENCH_
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/memory.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Benchmark.h"
+#include "ThreadPool.h"
+#include "commands/CommandManager.h"
+#include "commands/SessionRecording.h"
+#include "geometry/Geometry.h"
+
+namespace {
+/// Replays the recorded session on the model, an imported mesh or a .p3d project, and returns the timings
+std::vector<pepr3d::SessionRecording::Timing> replaySession(const std::string& recordingPath,
+                                                            const std::string& modelPath) {
+    std::ifstream recordingStream(recordingPath);
+    if(!recordingStream.is_open()) {
+        throw std::runtime_error("Could not open the session recording " + recordingPath);
+    }
+    const pepr3d::SessionRecording recording = pepr3d::SessionRecording::load(recordingStream);
+
+    auto geometry = std::make_shared<pepr3d::Geometry>();
+    const std::string extension = modelPath.size() >= 4 ? modelPath.substr(modelPath.size() - 4) : "";
+    if(extension == ".p3d" || extension == ".P3D") {
+        std::ifstream is(modelPath, std::ios::binary);
+        cereal::BinaryInputArchive loadArchive(is);
+        loadArchive(geometry);
+        geometry->recomputeFromData();
+    } else {
+        geometry->loadNewGeometry(modelPath);
+    }
+
+    pepr3d::CommandManager<pepr3d::Geometry> commandManager(*geometry);
+    return recording.replay(*geometry, commandManager);
+}
+}  // namespace
+
+/// pepr3d_bench [--filter <Suite/case prefix>] [--threads <worker count>] [--output <file.json>]
+/// pepr3d_bench --replay <recording.json> --model <model or project> [--threads <worker count>] [--output <file>]
+/// Prints a summary to stderr and the results as JSON to the output file, or to stdout without one.
+/// With --replay, the timings of the commands of the recorded session are written instead.
+int main(int argc, char** argv) {
+    std::string filter;
+    std::string outputPath;
+    std::string recordingPath;
+    std::string modelPath;
+    bool isUsageValid = true;
+    size_t threadCount = std::max<size_t>(3, std::thread::hardware_concurrency()) - 1;
+    for(int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        if(i + 1 < argc && argument == "--filter") {
+            filter = argv[++i];
+        } else if(i + 1 < argc && argument == "--threads") {
+            // The SDF refinement runs on the workers while the main thread waits, so there is at least one
+            threadCount = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        } else if(i + 1 < argc && argument == "--output") {
+            outputPath = argv[++i];
+        } else if(i + 1 < argc && argument == "--replay") {
+            recordingPath = argv[++i];
+        } else if(i + 1 < argc && argument == "--model") {
+            modelPath = argv[++i];
+        } else {
+            isUsageValid = false;
+        }
+    }
+    if(!isUsageValid || recordingPath.empty() != modelPath.empty()) {
+        std::fprintf(stderr,
+                     "Usage: %s [--filter <Suite/case prefix>] [--threads <worker count>] [--output <file>]\n"
+                     "       %s --replay <recording> --model <model> [--threads <worker count>] [--output <file>]\n",
+                     argv[0], argv[0]);
+        return 1;
+    }
+
+    ::ThreadPool threadPool(threadCount);
+    pepr3d::Geometry::setThreadPool(threadPool);
+
+    if(!recordingPath.empty()) {
+        std::vector<pepr3d::SessionRecording::Timing> timings;
+        try {
+            timings = replaySession(recordingPath, modelPath);
+        } catch(const std::exception& e) {
+            std::fprintf(stderr, "Replay failed: %s\n", e.what());
+            return 1;
+        }
+        std::ofstream os;
+        if(!outputPath.empty()) {
+            os.open(outputPath);
+        }
+        pepr3d::SessionRecording::writeTimings(outputPath.empty() ? std::cout : os, timings);
+        return !outputPath.empty() && !os ? 1 : 0;
+    }
+
+    pepr3d::Benchmark benchmark(filter);
+    try {
+        benchmark.runSuites();
+    } catch(const std::exception& e) {
+        std::fprintf(stderr, "Benchmark failed: %s\n", e.what());
+        return 1;
+    }
+
+    if(outputPath.empty()) {
+        pepr3d::Benchmark::writeJson(std::cout, benchmark.getResults(), threadCount);
+    } else {
+        std::ofstream os(outputPath);
+        pepr3d::Benchmark::writeJson(os, benchmark.getResults(), threadCount);
+        if(!os) {
+            std::fprintf(stderr, "Could not write the results to %s\n", outputPath.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
+
+#endif
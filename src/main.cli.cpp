@@ -0,0 +1,196 @@
+#ifdef _CLI_
+#include <cinder/Filesystem.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ThreadPool.h"
+#include "commands/BatchScript.h"
+#include "commands/CommandManager.h"
+#include "geometry/ExportType.h"
+#include "geometry/Geometry.h"
+#include "geometry/ModelExporter.h"
+
+namespace {
+struct Options {
+    std::string scriptPath;
+    std::string outputPath;
+    std::vector<std::string> modelPaths;
+    /// Each color is exported to a file of each of the file types
+    std::vector<std::string> fileTypes = {"stl"};
+    pepr3d::ExportType exportType = pepr3d::ExportType::Surface;
+
+    /// Models processed at once, each job uses the shared thread pool as well
+    size_t jobCount = std::max<size_t>(1, std::thread::hardware_concurrency() / 4);
+    size_t threadCount = std::max<size_t>(2, std::thread::hardware_concurrency());
+
+    /// Memory a job may take in bytes, 0 means unlimited
+    size_t memoryBudget = size_t(4096) * 1024 * 1024;
+};
+
+struct JobResult {
+    bool isDone = false;
+    std::string error;
+    double seconds = 0.0;
+    size_t peakMemory = 0;
+};
+
+std::optional<pepr3d::ExportType> getExportType(const std::string& name) {
+    if(name == "surface") {
+        return pepr3d::ExportType::Surface;
+    } else if(name == "triangles") {
+        return pepr3d::ExportType::NonPolySurface;
+    }
+    return {};
+}
+
+/// Imports the model, applies the script and exports a file of each color into a directory named after the model
+JobResult runJob(const std::string& modelPath, const pepr3d::BatchScript& script, const Options& options) {
+    JobResult result;
+    const auto start = std::chrono::steady_clock::now();
+
+    auto geometry = std::make_unique<pepr3d::Geometry>();
+    pepr3d::CommandManager<pepr3d::Geometry> commandManager(*geometry);
+    // Nothing is undone, so the undo snapshots only get a part of the budget
+    if(options.memoryBudget > 0) {
+        commandManager.setMemoryBudget(options.memoryBudget / 4);
+    }
+
+    const auto checkMemory = [&](const std::string& stage) {
+        commandManager.finalizeSnapshots();
+        const size_t memory = geometry->getMemoryUsage().getTotal() + commandManager.getSnapshotMemorySize() +
+                              commandManager.getHistoryMemorySize();
+        result.peakMemory = std::max(result.peakMemory, memory);
+        if(options.memoryBudget > 0 && memory > options.memoryBudget) {
+            throw std::runtime_error("The job takes " + std::to_string(memory / (1024 * 1024)) + " MB " + stage +
+                                     ", more than its budget of " +
+                                     std::to_string(options.memoryBudget / (1024 * 1024)) + " MB.");
+        }
+    };
+
+    try {
+        geometry->loadNewGeometry(modelPath);
+        checkMemory("after the import");
+        script.apply(*geometry, commandManager,
+                     [&](const size_t step) { checkMemory("after the step " + std::to_string(step + 1)); });
+
+        if(!geometry->isDetailedMeshValid()) {
+            geometry->updateDetailedMesh();
+        }
+        checkMemory("before the export");
+
+        const ci::fs::path model(modelPath);
+        const ci::fs::path directory = ci::fs::path(options.outputPath) / model.stem();
+        ci::fs::create_directories(directory);
+        pepr3d::ModelExporter exporter(geometry.get(), &geometry->getProgress(), pepr3d::Geometry::getThreadPool());
+        exporter.saveModel(directory.string(), model.stem().string(), options.fileTypes, options.exportType);
+        result.isDone = true;
+    } catch(const std::exception& e) {
+        result.error = e.what();
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+}  // namespace
+
+/// pepr3d_cli --script <script> --output <directory> [options] <model>...
+/// Colors each model by the script, see BatchScript, and exports a file of each color of it into its own directory.
+/// Prints a line about each model to stderr, returns 1 if any model failed.
+int main(int argc, char** argv) {
+    Options options;
+    bool isUsageValid = true;
+    for(int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        if(i + 1 < argc && argument == "--script") {
+            options.scriptPath = argv[++i];
+        } else if(i + 1 < argc && argument == "--output") {
+            options.outputPath = argv[++i];
+        } else if(i + 1 < argc && argument == "--format") {
+            // A comma separated list, e.g. stl,obj
+            options.fileTypes.clear();
+            std::istringstream fileTypes(argv[++i]);
+            for(std::string fileType; std::getline(fileTypes, fileType, ',');) {
+                isUsageValid &= fileType == "stl" || fileType == "ply" || fileType == "obj";
+                options.fileTypes.push_back(fileType);
+            }
+            isUsageValid &= !options.fileTypes.empty();
+        } else if(i + 1 < argc && argument == "--export") {
+            const std::optional<pepr3d::ExportType> exportType = getExportType(argv[++i]);
+            isUsageValid &= exportType.has_value();
+            options.exportType = exportType.value_or(options.exportType);
+        } else if(i + 1 < argc && argument == "--jobs") {
+            options.jobCount = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        } else if(i + 1 < argc && argument == "--threads") {
+            // Fills and the SDF run on the workers while the job waits, so there is at least one
+            options.threadCount = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        } else if(i + 1 < argc && argument == "--memory") {
+            options.memoryBudget = size_t(std::strtoul(argv[++i], nullptr, 10)) * 1024 * 1024;
+        } else if(argument.rfind("--", 0) == 0) {
+            isUsageValid = false;
+        } else {
+            options.modelPaths.push_back(argument);
+        }
+    }
+    if(!isUsageValid || options.scriptPath.empty() || options.outputPath.empty() || options.modelPaths.empty()) {
+        std::fprintf(stderr,
+                     "Usage: %s --script <script> --output <directory> [--format stl|ply|obj[,...]] "
+                     "[--export surface|triangles]\n"
+                     "       [--jobs <models at once>] [--threads <worker count>] [--memory <MB per job, 0 for "
+                     "unlimited>] <model>...\n",
+                     argv[0]);
+        return 1;
+    }
+
+    pepr3d::BatchScript script;
+    try {
+        std::ifstream scriptStream(options.scriptPath);
+        if(!scriptStream.is_open()) {
+            throw std::runtime_error("Could not open the script " + options.scriptPath);
+        }
+        script = pepr3d::BatchScript::parse(scriptStream);
+    } catch(const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    ::ThreadPool threadPool(options.threadCount);
+    pepr3d::Geometry::setThreadPool(threadPool);
+
+    // The jobs block on the thread pool, so they run on their own threads instead of the workers
+    std::vector<JobResult> results(options.modelPaths.size());
+    std::atomic<size_t> nextModel{0};
+    const auto runJobs = [&]() {
+        for(size_t i = nextModel++; i < options.modelPaths.size(); i = nextModel++) {
+            results[i] = runJob(options.modelPaths[i], script, options);
+            if(results[i].isDone) {
+                std::fprintf(stderr, "%s: done in %.1f s, at most %zu MB\n", options.modelPaths[i].c_str(),
+                             results[i].seconds, results[i].peakMemory / (1024 * 1024));
+            } else {
+                std::fprintf(stderr, "%s: failed: %s\n", options.modelPaths[i].c_str(), results[i].error.c_str());
+            }
+        }
+    };
+    std::vector<std::thread> jobs;
+    for(size_t i = 0; i < std::min(options.jobCount, options.modelPaths.size()); ++i) {
+        jobs.emplace_back(runJobs);
+    }
+    for(std::thread& job : jobs) {
+        job.join();
+    }
+
+    const bool isAllDone =
+        std::all_of(results.begin(), results.end(), [](const JobResult& result) { return result.isDone; });
+    return isAllDone ? 0 : 1;
+}
+
+#endif
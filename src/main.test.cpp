@@ -1,8 +1,15 @@
 #ifdef _TEST_
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <thread>
+#include "ThreadPool.h"
+#include "geometry/Geometry.h"
 
 int main(int argc, char** argv) {
     testing::InitGoogleTest(&argc, argv);
+
+    ::ThreadPool threadPool(std::max<size_t>(3, std::thread::hardware_concurrency()) - 1);
+    pepr3d::Geometry::setThreadPool(threadPool);
     return RUN_ALL_TESTS();
 }
 
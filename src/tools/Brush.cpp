@@ -8,8 +8,8 @@ void Brush::onModelViewMouseDown(ModelView& modelView, ci::app::MouseEvent event
     if(!event.isLeft()) {
         return;
     }
-    mLastRay = modelView.getRayFromWindowCoordinates(event.getPos());
-    paint();
+    updateRay(modelView, event.getPos());
+    paint(modelView);
 }
 
 void Brush::onModelViewMouseUp(ModelView& modelView, ci::app::MouseEvent event) {
@@ -23,8 +23,13 @@ void Brush::onModelViewMouseDrag(ModelView& modelView, ci::app::MouseEvent event
     if(!event.isLeftDown()) {
         return;
     }
-    updateRay(modelView, event);
-    paint();
+    // Drags coalesced into this one are painted as well, so that the stroke stays continuous
+    for(const glm::ivec2 position : modelView.getCoalescedDragPositions()) {
+        updateRay(modelView, position);
+        paint(modelView);
+    }
+    updateRay(modelView, event.getPos());
+    paint(modelView);
     updateHighlight(modelView, event);
 }
 
@@ -39,41 +44,106 @@ void Brush::onToolSelect(ModelView& modelView) {
 }
 
 void Brush::onToolDeselect(ModelView& modelView) {
+    stopPaint();
     mApplication.getCurrentGeometry()->hideHighlight();
 }
 
-void Brush::paint() {
-    // Prevents blocking the rendering if painting takes too long
-    if(mPaintsSinceDraw >= MAX_PAINTS_WITHOUT_DRAW) {
+void Brush::onUpdate(ModelView& modelView) {
+    flushPendingDabs();
+}
+
+void Brush::paint(const ModelView& modelView) {
+    if(!mIsPainting) {
+        mIsPainting = true;
+        mStrokeSettings = mBrushSettings;
+        if(mIsAdaptive && mLastHitTriangle) {
+            mStrokeSettings.segments = getAdaptiveSegments(modelView, mLastIntersection, *mLastHitTriangle);
+        }
+    } else if(mIsAdaptive) {
+        // Only the first miss is queued, it ends the swept segments
+        const float spacing = DAB_SPACING * mStrokeSettings.size;
+        const bool isNearLastDab =
+            mLastHitTriangle && mLastDabPoint && glm::distance(mLastIntersection, *mLastDabPoint) < spacing;
+        if(isNearLastDab || (!mLastHitTriangle && !mLastDabPoint)) {
+            mIsLastRaySkipped = true;
+            return;
+        }
+    }
+
+    // Painting is left for the next frame, so that the mouse events and the highlight are never blocked
+    mPendingRays.push_back(mLastRay);
+    mLastDabPoint = mLastHitTriangle ? std::optional<glm::vec3>(mLastIntersection) : std::nullopt;
+    mIsLastRaySkipped = false;
+}
+
+int Brush::getAdaptiveSegments(const ModelView& modelView, const glm::vec3& point, const size_t triangleIdx) const {
+    const DataTriangle& triangle = mApplication.getCurrentGeometry()->getTriangle(triangleIdx);
+    const float meanEdgeLength = (glm::distance(triangle.getVertex(0), triangle.getVertex(1)) +
+                                  glm::distance(triangle.getVertex(1), triangle.getVertex(2)) +
+                                  glm::distance(triangle.getVertex(2), triangle.getVertex(0))) /
+                                 3.f;
+    const float minEdgeLength =
+        std::max(SEGMENT_PIXELS / modelView.getPixelsPerUnit(point), SEGMENT_TRIANGLE_FRACTION * meanEdgeLength);
+    if(!(minEdgeLength > 0.f)) {
+        return mBrushSettings.segments;
+    }
+
+    const float circumference = 2.f * glm::pi<float>() * mBrushSettings.size;
+    const float segments = std::ceil(circumference / minEdgeLength);
+    const int minSegments = std::min(MIN_ADAPTIVE_SEGMENTS, mBrushSettings.segments);
+    return segments >= mBrushSettings.segments ? mBrushSettings.segments
+                                               : std::max(minSegments, static_cast<int>(segments));
+}
+
+void Brush::flushPendingDabs() {
+    if(mPendingRays.empty()) {
         return;
     }
 
-    mPaintsSinceDraw++;
+    mStrokeSettings.color = mApplication.getCurrentGeometry()->getColorManager().getActiveColorIndex();
+    const ci::Ray lastRay = mPendingRays.back();
+    if(mStrokeSettings.spherical && mStrokeSettings.sweptStroke && mGroupCommands) {
+        // The first segment connects to the dabs of the last frame, CmdPaintBrush joins the ray only once
+        mPendingRays.insert(mPendingRays.begin(), mLastPaintedRay);
+    }
+    mLastPaintedRay = lastRay;
 
-    mBrushSettings.color = mApplication.getCurrentGeometry()->getColorManager().getActiveColorIndex();
     auto* commandManager = mApplication.getCommandManager();
     if(commandManager) {
-        commandManager->execute(std::make_unique<CmdPaintBrush>(mLastRay, mBrushSettings), mGroupCommands);
+        // All dabs since the last frame are painted at once and joined with the rest of the stroke
+        commandManager->execute(std::make_unique<CmdPaintBrush>(std::move(mPendingRays), mStrokeSettings),
+                                mGroupCommands);
     }
+    mPendingRays.clear();
 
     mGroupCommands = true;
     mPaintedAnything = true;
 }
 
 void Brush::stopPaint() {
+    if(mIsLastRaySkipped) {
+        mPendingRays.push_back(mLastRay);
+    }
+    flushPendingDabs();
     mGroupCommands = false;
+    mIsPainting = false;
+    mLastDabPoint.reset();
+    mIsLastRaySkipped = false;
 }
 
 void Brush::updateHighlight(ModelView& modelView, ci::app::MouseEvent event) const {
     if(mBrushSettings.spherical) {
-        mApplication.getCurrentGeometry()->highlightArea(mLastRay, mBrushSettings);
+        // The hit under the cursor is shared with updateRay()
+        glm::vec3 hitPoint(0.f);
+        const std::optional<size_t> hitTriangle = modelView.pickBaseTriangle(event.getPos(), &hitPoint);
+        mApplication.getCurrentGeometry()->highlightArea(mLastRay, hitTriangle, hitPoint, mBrushSettings);
     } else {
     }
 }
 
-void Brush::updateRay(ModelView& modelView, ci::app::MouseEvent event) {
-    mLastRay = modelView.getRayFromWindowCoordinates(event.getPos());
-    auto intersection = mApplication.getCurrentGeometry()->intersectMesh(mLastRay, mLastIntersection);
+void Brush::updateRay(ModelView& modelView, const glm::ivec2 windowCoords) {
+    mLastRay = modelView.getRayFromWindowCoordinates(windowCoords);
+    mLastHitTriangle = modelView.pickBaseTriangle(windowCoords, &mLastIntersection);
 }
 
 bool Brush::isEnabled() const {
@@ -89,7 +159,14 @@ void Brush::drawToSidePane(SidePane& sidePane) {
     sidePane.drawTooltipOnHover("Size of the brush in world units.");
 
     sidePane.drawIntDragger("Segments", mBrushSettings.segments, 0.1f, 3, 50, "%d", 140.f);
-    sidePane.drawTooltipOnHover("Higher number of segments increases \"roundness\" of the brush.");
+    sidePane.drawTooltipOnHover(
+        "Higher number of segments increases \"roundness\" of the brush. With adaptive spacing, it is the most "
+        "segments of a brush large on screen.");
+
+    sidePane.drawCheckbox("Adaptive spacing", mIsAdaptive);
+    sidePane.drawTooltipOnHover(
+        "Add a dab only after the mouse moved a quarter of the brush size, and use fewer segments for a brush small "
+        "on screen.");
 
     sidePane.drawCheckbox("Paint backfaces", mBrushSettings.paintBackfaces);
     sidePane.drawTooltipOnHover("Paint triangles even if they are facing away from the camera.");
@@ -126,6 +203,11 @@ void Brush::drawToSidePane(SidePane& sidePane) {
             sidePane.drawCheckbox("Paint outer ring", mBrushSettings.paintOuterRing);
             sidePane.drawTooltipOnHover("Paint the whole triangle, even if it is not fully inside the brush.");
         }
+
+        sidePane.drawCheckbox("Swept stroke", mBrushSettings.sweptStroke);
+        sidePane.drawTooltipOnHover(
+            "Paint a continuous band between the positions of the mouse, instead of separate dabs. Fast strokes "
+            "leave no gaps and slow strokes are painted faster.");
     }
 
     if(!mBrushSettings.spherical) {
@@ -142,7 +224,6 @@ void Brush::drawToSidePane(SidePane& sidePane) {
         sidePane.drawTooltipOnHover("Paint aligned against normal.");
     }
     sidePane.drawSeparator();
-    mPaintsSinceDraw = 0;
 }
 
 void Brush::drawToModelView(ModelView& modelView) {
@@ -1,5 +1,7 @@
 #pragma once
 #include <cinder/Ray.h>
+#include <optional>
+#include <vector>
 #include "tools/Tool.h"
 #include "ui/IconsMaterialDesign.h"
 #include "ui/SidePane.h"
@@ -34,6 +36,9 @@ struct BrushSettings {
     /// When respecting original triangles should we paint triangles that are not fully inside the brush?
     bool paintOuterRing = false;
 
+    /// Connect the dabs of a stroke with capsules, so that fast strokes leave no gaps
+    bool sweptStroke = false;
+
     // -- Shape brush setting
 
     /// Use local normal for direction of shape brush
@@ -43,7 +48,16 @@ struct BrushSettings {
         return color == other.color && size == other.size && segments == other.segments &&
                paintBackfaces == other.paintBackfaces && spherical == other.spherical &&
                continuous == other.continuous && respectOriginalTriangles == other.respectOriginalTriangles &&
-               paintOuterRing == other.paintOuterRing && alignToNormal == other.alignToNormal;
+               paintOuterRing == other.paintOuterRing && sweptStroke == other.sweptStroke &&
+               alignToNormal == other.alignToNormal;
+    }
+
+    /// Method to allow the Cereal library to serialize the settings, e.g., of a recorded session.
+    /// sweptStroke is left out to read the older recordings, it is the type of the recorded entry.
+    template <class Archive>
+    void serialize(Archive& archive) {
+        archive(color, size, segments, paintBackfaces, spherical, continuous, respectOriginalTriangles,
+                paintOuterRing, alignToNormal);
     }
 };
 
@@ -72,6 +86,7 @@ class Brush : public Tool {
     virtual void onModelViewMouseUp(ModelView& modelView, ci::app::MouseEvent event) override;
     virtual void onModelViewMouseDrag(ModelView& modelView, ci::app::MouseEvent event) override;
     virtual void onModelViewMouseMove(ModelView& modelView, ci::app::MouseEvent event) override;
+    virtual void onUpdate(ModelView& modelView) override;
 
     virtual void onToolSelect(ModelView& modelView) override;
     virtual void onToolDeselect(ModelView& modelView) override;
@@ -79,34 +94,69 @@ class Brush : public Tool {
     virtual void onNewGeometryLoaded(ModelView& modelView);
 
    private:
-    /// Do painting tick on the model
-    void paint();
+    /// Queue a dab at the last ray, it is painted by the next flushPendingDabs().
+    /// With adaptive spacing, the dab is skipped while the mouse did not move DAB_SPACING of the brush size.
+    void paint(const ModelView& modelView);
+
+    /// Number of segments of the circles of a stroke starting at the point of the triangle, at most
+    /// BrushSettings::segments. Edges of the circles are not shorter than SEGMENT_PIXELS on screen, nor than
+    /// SEGMENT_TRIANGLE_FRACTION of the edges of the triangle.
+    int getAdaptiveSegments(const ModelView& modelView, const glm::vec3& point, size_t triangleIdx) const;
+
+    /// Paint all queued dabs with a single command joined to the current stroke
+    void flushPendingDabs();
 
     /// Stop painting
     void stopPaint();
 
     void updateHighlight(ModelView& modelView, ci::app::MouseEvent event) const;
 
-    /// Update ray and intersection data
-    void updateRay(ModelView& modelView, ci::app::MouseEvent event);
+    /// Update ray and intersection data for the window coordinates
+    void updateRay(ModelView& modelView, glm::ivec2 windowCoords);
     ci::Ray mLastRay;
     glm::vec3 mLastIntersection;
 
+    /// Triangle hit by mLastRay at mLastIntersection
+    std::optional<size_t> mLastHitTriangle;
+
     MainApplication& mApplication;
 
     BrushSettings mBrushSettings;
 
+    /// Settings of the stroke being painted, with the segments chosen at its start
+    BrushSettings mStrokeSettings;
+
+    /// Space the dabs and choose the segments of the circles by the size of the brush on screen
+    bool mIsAdaptive = true;
+
+    /// Distance of the dabs of adaptive spacing, in brush sizes
+    static constexpr float DAB_SPACING = 0.25f;
+    static constexpr float SEGMENT_PIXELS = 4.f;
+    static constexpr float SEGMENT_TRIANGLE_FRACTION = 1.f / 16.f;
+    static constexpr int MIN_ADAPTIVE_SEGMENTS = 6;
+
     float mMaxSize = 1.f;
     static const int SIZE_SLIDER_STEPS = 100;
 
     bool mGroupCommands = false;
 
+    /// A stroke is being painted, from the first dab until stopPaint()
+    bool mIsPainting = false;
+
+    /// Mesh point of the last queued dab, none if it missed the mesh
+    std::optional<glm::vec3> mLastDabPoint;
+
+    /// mLastRay was skipped by adaptive spacing, stopPaint() paints it to end the stroke where the mouse did
+    bool mIsLastRaySkipped = false;
+
     /// Did we paint anything since selecting this tool
     bool mPaintedAnything = false;
 
-    /// How many times can we run this tool without updating the screen
-    int mPaintsSinceDraw = 0;
-    const int MAX_PAINTS_WITHOUT_DRAW = 1;
+    /// Rays of the dabs queued since the last frame
+    std::vector<ci::Ray> mPendingRays;
+
+    /// Last ray painted by flushPendingDabs(), a swept stroke continues from it
+    ci::Ray mLastPaintedRay;
 };
 
 }  // namespace pepr3d
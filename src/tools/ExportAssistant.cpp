@@ -1,6 +1,9 @@
 #include "tools/ExportAssistant.h"
+#include <algorithm>
+#include <memory>
 #include <random>
 #include <vector>
+#include "Profiler.h"
 #include "commands/CmdPaintSingleColor.h"
 #include "geometry/ModelExporter.h"
 #include "geometry/SdfValuesException.h"
@@ -113,7 +116,12 @@ void ExportAssistant::drawToSidePane(SidePane& sidePane) {
                 ImGui::NextColumn();
                 ImGui::PushItemWidth(ImGui::GetContentRegionAvailWidth());
                 if(ImGui::DragFloat("##depth", &mSettingsPerColor[i].depth, 0.10f, 0.0f, 100.0f, "%.2f %%")) {
-                    mIsPreviewUpToDate = false;
+                    mChangedDepthColor = i;
+                }
+                if(mChangedDepthColor == i && !ImGui::IsItemActive()) {
+                    // The drag has ended
+                    mChangedDepthColor.reset();
+                    updateColorExtrusionPreview(i);
                 }
                 sidePane.drawTooltipOnHover("How deep should this color be extruded inside the model.", "",
                                             "Use this to adjust the extrusion so it is not too shallow or too "
@@ -155,32 +163,44 @@ void ExportAssistant::drawToSidePane(SidePane& sidePane) {
 
     {
         sidePane.drawText("Export As:");
-        if(ImGui::RadioButton(".stl", mExportFileType == "stl")) {
-            mExportFileType = "stl";
-        }
+        // At least one file type stays selected
+        const auto drawFileTypeCheckbox = [this](const std::string& fileType) {
+            const auto selected = std::find(mExportFileTypes.begin(), mExportFileTypes.end(), fileType);
+            bool isSelected = selected != mExportFileTypes.end();
+            if(ImGui::Checkbox(("." + fileType).c_str(), &isSelected)) {
+                if(isSelected) {
+                    mExportFileTypes.push_back(fileType);
+                } else if(mExportFileTypes.size() > 1) {
+                    mExportFileTypes.erase(selected);
+                }
+            }
+        };
+        drawFileTypeCheckbox("stl");
         sidePane.drawTooltipOnHover(
             "Export as separate .stl files.", "",
             "This is a binary format suitable for 3D printing with Prusa printers and Slic3r Prusa Edition.");
         ImGui::SameLine();
-        if(ImGui::RadioButton(".ply", mExportFileType == "ply")) {
-            mExportFileType = "ply";
-        }
+        drawFileTypeCheckbox("ply");
         sidePane.drawTooltipOnHover("Export as separate .ply files.", "",
                                     "This is a binary Stanford Triangle Format supported by standard 3D editors.");
         ImGui::SameLine();
-        if(ImGui::RadioButton(".obj", mExportFileType == "obj")) {
-            mExportFileType = "obj";
-        }
+        drawFileTypeCheckbox("obj");
         sidePane.drawTooltipOnHover("Export as separate .obj and .mtl files.", "",
                                     "This is a simple non-binary format supported by standard 3D editors.");
 
         ImGui::Checkbox("Create a new folder", &mShouldExportInNewFolder);
         sidePane.drawTooltipOnHover("If checked, a new separate folder will be created for the exported files.");
 
-        if(sidePane.drawButton("Export files")) {
-            exportFiles();
+        if(mBackgroundExport) {
+            drawBackgroundExport(sidePane);
+        } else {
+            if(sidePane.drawButton("Export files")) {
+                exportFiles();
+            }
+            sidePane.drawTooltipOnHover(
+                "Save the exported model in separate files using the options above. The files are written in the "
+                "background, the model can be painted on meanwhile.");
         }
-        sidePane.drawTooltipOnHover("Save the exported model in separate files using the options above.");
     }
 
     sidePane.drawSeparator();
@@ -224,7 +244,11 @@ void ExportAssistant::onToolDeselect(ModelView& modelView) {
 void ExportAssistant::onNewGeometryLoaded(ModelView& modelView) {
     auto* const geometry = mApplication.getCurrentGeometry();
     assert(geometry != nullptr);
-    mExporter = std::make_unique<ModelExporter>(geometry, &geometry->getProgress());
+    mExporter = std::make_unique<ModelExporter>(geometry, &geometry->getProgress(), MainApplication::getThreadPool());
+    // A running export keeps its snapshot, it no longer reports to the Geometry
+    if(mBackgroundExport) {
+        mBackgroundExport->geometry = nullptr;
+    }
     mScenes.clear();
     if(mIsSelected) {
         resetOverride();
@@ -237,10 +261,9 @@ void ExportAssistant::onNewGeometryLoaded(ModelView& modelView) {
 void ExportAssistant::resetOverride() {
     auto& modelView = mApplication.getModelView();
     modelView.toggleMeshOverride(false);
-    modelView.getOverrideColorBuffer().clear();
-    modelView.getOverrideIndexBuffer().clear();
-    modelView.getOverrideNormalBuffer().clear();
-    modelView.getOverrideVertexBuffer().clear();
+    modelView.setOverrideMesh(nullptr);
+    modelView.getOverrideFaceColorBuffer().clear();
+    modelView.getOverridePalette().clear();
     modelView.setPreviewMinMaxHeight(glm::vec2(0.0f, 1.0f));
 }
 
@@ -249,34 +272,37 @@ void ExportAssistant::setOverride() {
     auto* const geometry = mApplication.getCurrentGeometry();
     assert(geometry != nullptr);
 
-    uint32_t bufferOffset = 0;
+    // The faces index the palette by their color, no color is stored per vertex
+    auto overrideMesh = std::make_shared<ModelView::OverrideMesh>();
+    std::vector<ColorIndex> faceColors;
     for(auto& scene : mScenes) {
         const size_t colorIndex = scene.first;
         assert(mSettingsPerColor.size() > colorIndex);
         if(!mSettingsPerColor[colorIndex].isShown) {
             continue;
         }
-        const glm::vec4 color = geometry->getColorManager().getColor(colorIndex);
         aiScene* const sceneData = scene.second.get();
         assert(sceneData->mNumMeshes == 1);
         aiMesh* const mesh = sceneData->mMeshes[0];
+        const auto bufferOffset = static_cast<uint32_t>(overrideMesh->vertexBuffer.size());
         for(size_t i = 0; i < mesh->mNumVertices; ++i) {
-            modelView.getOverrideColorBuffer().push_back(color);
-            modelView.getOverrideNormalBuffer().emplace_back(mesh->mNormals[i].x, mesh->mNormals[i].y,
-                                                             mesh->mNormals[i].z);
-            modelView.getOverrideVertexBuffer().emplace_back(mesh->mVertices[i].x, mesh->mVertices[i].y,
-                                                             mesh->mVertices[i].z);
+            overrideMesh->normalBuffer.emplace_back(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+            overrideMesh->vertexBuffer.emplace_back(mesh->mVertices[i].x, mesh->mVertices[i].y,
+                                                    mesh->mVertices[i].z);
         }
         for(size_t i = 0; i < mesh->mNumFaces; ++i) {
             const aiFace face = mesh->mFaces[i];
             assert(face.mNumIndices == 3);
-            modelView.getOverrideIndexBuffer().push_back(bufferOffset + face.mIndices[0]);
-            modelView.getOverrideIndexBuffer().push_back(bufferOffset + face.mIndices[1]);
-            modelView.getOverrideIndexBuffer().push_back(bufferOffset + face.mIndices[2]);
+            overrideMesh->indexBuffer.push_back(bufferOffset + face.mIndices[0]);
+            overrideMesh->indexBuffer.push_back(bufferOffset + face.mIndices[1]);
+            overrideMesh->indexBuffer.push_back(bufferOffset + face.mIndices[2]);
         }
-        bufferOffset += mesh->mNumVertices;
+        faceColors.insert(faceColors.end(), mesh->mNumFaces, static_cast<ColorIndex>(colorIndex));
     }
 
+    modelView.setOverrideMesh(std::move(overrideMesh));
+    modelView.getOverrideFaceColorBuffer() = std::move(faceColors);
+    modelView.getOverridePalette() = geometry->getColorManager().getColorMap();
     modelView.toggleMeshOverride(true);
     modelView.setPreviewMinMaxHeight(mPreviewMinMaxHeight);
 }
@@ -326,11 +352,11 @@ void ExportAssistant::exportFiles() {
             name += "_exported";
         }
 
-        std::string fileType;
+        // The files of the other file types are saved next to the files of the first one
+        const std::vector<std::string> fileTypes = mExportFileTypes;
         std::vector<std::string> extensions;
-        extensions.emplace_back(mExportFileType);
-        name += "." + mExportFileType;
-        fileType = mExportFileType;
+        extensions.emplace_back(fileTypes.front());
+        name += "." + fileTypes.front();
 
         const auto path = mApplication.getSaveFilePath(initialPath.append(name), extensions);
 
@@ -345,27 +371,112 @@ void ExportAssistant::exportFiles() {
                 cinder::fs::create_directory(filePath);
             }
 
+            // Only the preparation modifies the Geometry, the files are written from its snapshot afterwards
+            const auto isPrepared = std::make_shared<bool>(false);
             mApplication.enqueueSlowOperation(
-                [filePath, fileName, fileType, this]() {
+                [isPrepared, this](const std::atomic<bool>* isCancelled) {
                     try {
-                        prepareExport();
-                        mExporter->saveModel(filePath, fileName, fileType, mExportType);
+                        prepareExport(isCancelled);
+                        *isPrepared = true;
                     } catch(std::exception& e) {
                         pushErrorDialog(e.what());
                         updateSettings();
                     }
                 },
-                [this]() {}, true);
+                [filePath, fileName, fileTypes, isPrepared, this]() {
+                    if(*isPrepared) {
+                        startBackgroundExport(filePath, fileName, fileTypes);
+                    }
+                },
+                true);
         }
     });
 }
 
+void ExportAssistant::startBackgroundExport(const std::string& filePath, const std::string& fileName,
+                                            const std::vector<std::string>& fileTypes) {
+    auto* const geometry = mApplication.getCurrentGeometry();
+    assert(geometry != nullptr);
+    if(mBackgroundExport) {
+        // Both exports were requested before the first one started
+        CI_LOG_W("An export is already running in the background, the export into " + filePath + " is skipped");
+        return;
+    }
+
+    BackgroundExport backgroundExport;
+    backgroundExport.geometry = geometry;
+    backgroundExport.progress = std::make_shared<GeometryProgress>();
+    backgroundExport.isCancelled = std::make_shared<std::atomic<bool>>(false);
+    mBackgroundExport = backgroundExport;
+    geometry->getProgress().backgroundExportPercentage = 0.0f;
+
+    // The extruded data cached by mExporter belongs to the Geometry, the snapshot gets an exporter of its own
+    const std::shared_ptr<const Geometry> snapshot = geometry->createExportSnapshot();
+    auto exporter = std::make_shared<ModelExporter>(snapshot.get(), backgroundExport.progress.get(),
+                                                    MainApplication::getThreadPool());
+    if(!isSurfaceExport()) {
+        exporter->setExtrusionCoef(getExtrusionCoefs());
+    }
+
+    const ExportType exportType = mExportType;
+    const std::shared_ptr<std::atomic<bool>> isCancelled = backgroundExport.isCancelled;
+    CI_LOG_I("Exporting into " + filePath + " in the background");
+    MainApplication::getThreadPool().enqueue(
+        ::ThreadPool::priority::background,
+        [snapshot, exporter, isCancelled, filePath, fileName, fileTypes, exportType, this]() {
+            bool isSaved = false;
+            std::string error;
+            try {
+                const Profiler::TraceScope traceScope("Export", "Background export");
+                isSaved = exporter->saveModel(filePath, fileName, fileTypes, exportType, isCancelled.get());
+            } catch(const std::exception& e) {
+                error = e.what();
+            }
+            mApplication.dispatchAsync([isSaved, error, this]() { finishBackgroundExport(isSaved, error); });
+        });
+}
+
+void ExportAssistant::finishBackgroundExport(const bool isSaved, const std::string& error) {
+    P_ASSERT(mBackgroundExport);
+    if(mBackgroundExport->geometry != nullptr) {
+        mBackgroundExport->geometry->getProgress().backgroundExportPercentage = isSaved ? 1.0f : -1.0f;
+    }
+    mBackgroundExport.reset();
+
+    if(!error.empty()) {
+        CI_LOG_E("Background export failed: " << error);
+        pushErrorDialog(error);
+    } else if(!isSaved) {
+        CI_LOG_I("Background export cancelled");
+    }
+}
+
+void ExportAssistant::drawBackgroundExport(SidePane& sidePane) {
+    P_ASSERT(mBackgroundExport);
+    const GeometryProgress& progress = *mBackgroundExport->progress;
+    if(progress.exportFilePercentage >= 0.0f) {
+        sidePane.drawText("Writing the files in the background...");
+    } else {
+        sidePane.drawText("Creating the scenes in the background...");
+    }
+    if(*mBackgroundExport->isCancelled) {
+        sidePane.drawText("Cancelling the export...");
+    } else if(sidePane.drawButton("Cancel export")) {
+        *mBackgroundExport->isCancelled = true;
+    }
+    sidePane.drawTooltipOnHover("Stop the export, the files written until now are kept.");
+}
+
 void ExportAssistant::updateExtrusionPreview() {
     mApplication.enqueueSlowOperation(
-        [this]() {
+        [this](const std::atomic<bool>* isCancelled) {
             try {
-                prepareExport();
-                mScenes = mExporter->createScenes(mExportType);
+                prepareExport(isCancelled);
+                auto scenes = mExporter->createScenes(mExportType, isCancelled);
+                // A cancelled preview keeps the previous scenes
+                if(!*isCancelled) {
+                    mScenes = std::move(scenes);
+                }
             } catch(std::exception& e) {
                 pushErrorDialog(e.what());
                 updateSettings();
@@ -380,10 +491,39 @@ void ExportAssistant::updateExtrusionPreview() {
                               // geometry, but that is not thread-safe as we modify it during prepareExport()
             setOverride();
         },
-        true);
+        true, MainApplication::SlowOperationKind::ExportPreview);
 }
 
-void ExportAssistant::prepareExport() {
+void ExportAssistant::updateColorExtrusionPreview(const size_t color) {
+    if(!mIsPreviewUpToDate) {
+        return;
+    }
+
+    auto* const commandManager = mApplication.getCommandManager();
+    assert(commandManager != nullptr);
+    assert(mExporter != nullptr);
+    mExporter->setGeometryVersion(commandManager->getVersionNumber());
+    mExporter->setExtrusionCoef(getExtrusionCoefs());
+    std::unique_ptr<aiScene> scene = mExporter->createColorScene(mExportType, color);
+    if(scene == nullptr) {
+        mIsPreviewUpToDate = false;
+        return;
+    }
+
+    mScenes[color] = std::move(scene);
+    resetOverride();
+    setOverride();
+}
+
+std::vector<float> ExportAssistant::getExtrusionCoefs() const {
+    std::vector<float> extrusionCoefs;
+    for(auto& colorSetting : mSettingsPerColor) {
+        extrusionCoefs.push_back(colorSetting.depth / 100.0f);  // from [0, 100]% to [0, 1]
+    }
+    return extrusionCoefs;
+}
+
+void ExportAssistant::prepareExport(const std::atomic<bool>* isCancelled) {
     auto* const geometry = mApplication.getCurrentGeometry();
     assert(geometry != nullptr);
 
@@ -395,17 +535,18 @@ void ExportAssistant::prepareExport() {
             }
         }
 
-        std::vector<float> extrusionCoefs;
-        for(auto& colorSetting : mSettingsPerColor) {
-            extrusionCoefs.push_back(colorSetting.depth / 100.0f);  // from [0, 100]% to [0, 1]
-        }
-
+        auto* const commandManager = mApplication.getCommandManager();
+        assert(commandManager != nullptr);
         assert(mExporter != nullptr);
-        mExporter->setExtrusionCoef(extrusionCoefs);
+        mExporter->setGeometryVersion(commandManager->getVersionNumber());
+        mExporter->setExtrusionCoef(getExtrusionCoefs());
     }
 
-    if(!geometry->isTemporaryDetailedDataValid()) {
-        geometry->updateTemporaryDetailedData();
+    if(mExportType == ExportType::PolyExtrusion || mExportType == ExportType::PolyExtrusionWithSDF) {
+        // Updates the detailed mesh as well
+        geometry->updateDetailedNormalsAndBorders(isCancelled);
+    } else if(!geometry->isDetailedMeshValid()) {
+        geometry->updateDetailedMesh(isCancelled);
     }
 }
 
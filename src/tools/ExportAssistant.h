@@ -1,8 +1,11 @@
 #pragma once
+#include <atomic>
 #include <map>
 #include <memory>
 #include <optional>
+#include <string>
 #include <unordered_map>
+#include <vector>
 #include "commands/CommandManager.h"
 #include "geometry/Geometry.h"
 #include "geometry/ModelExporter.h"
@@ -74,13 +77,44 @@ class ExportAssistant : public Tool {
     void validateExportType();
 
     /// Export the Geometry to files. Opens and handles the file dialog.
+    /// The Geometry is prepared in a slow operation, the files are written from its snapshot on a worker.
     void exportFiles();
 
+    /// Export running on a worker from a snapshot of the Geometry, while the Geometry can be painted on
+    struct BackgroundExport {
+        /// Geometry the export was started from, null once another one is loaded
+        Geometry* geometry = nullptr;
+
+        /// Progress of the scenes and files of the snapshot
+        std::shared_ptr<GeometryProgress> progress;
+
+        /// Set by the user to stop the export, the files written until then are kept
+        std::shared_ptr<std::atomic<bool>> isCancelled;
+    };
+    std::optional<BackgroundExport> mBackgroundExport;
+
+    /// Export a snapshot of the prepared Geometry on a worker, see exportFiles()
+    void startBackgroundExport(const std::string& filePath, const std::string& fileName,
+                               const std::vector<std::string>& fileTypes);
+
+    /// Called in the main thread once the background export is finished
+    void finishBackgroundExport(bool isSaved, const std::string& error);
+
+    /// Progress of the background export with a Cancel button, instead of the Export button
+    void drawBackgroundExport(SidePane& sidePane);
+
     /// Updates the preview in the ModelView.
     void updateExtrusionPreview();
 
+    /// Extrudes only the color again after its depth changed, if the rest of the preview is up to date
+    void updateColorExtrusionPreview(size_t color);
+
+    /// Extrusion coefficients between 0 and 1 of the depths of the colors
+    std::vector<float> getExtrusionCoefs() const;
+
     /// Prepares the current Geometry to be exported, e.g., computes SDF if needed, etc.
-    void prepareExport();
+    /// @param isCancelled Checked while the detailed mesh is built, if not null
+    void prepareExport(const std::atomic<bool>* isCancelled);
 
     /// Pushes an error dialog stating that the export was not successful.
     void pushErrorDialog(const std::string& errorDetails);
@@ -96,7 +130,11 @@ class ExportAssistant : public Tool {
 
     size_t mLastVersionPreviewed = std::numeric_limits<size_t>::max();
     bool mIsPreviewUpToDate = false;
+
+    /// Color with its depth changed by a drag that has not ended yet
+    std::optional<size_t> mChangedDepthColor;
     bool mShouldExportInNewFolder = false;
-    std::string mExportFileType = "stl";
+    /// Each color is exported to a file of each of the file types, in the order they were selected
+    std::vector<std::string> mExportFileTypes = {"stl"};
 };
 }  // namespace pepr3d
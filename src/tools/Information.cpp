@@ -1,8 +1,22 @@
 #include "tools/Information.h"
+#include <cstdio>
 #include <random>
 #include "ui/MainApplication.h"
 
 namespace pepr3d {
+
+namespace {
+std::string formatBytes(const size_t bytes) {
+    char text[32];
+    if(bytes < 1024 * 1024) {
+        std::snprintf(text, sizeof(text), "%.1f kB", static_cast<double>(bytes) / 1024.0);
+    } else {
+        std::snprintf(text, sizeof(text), "%.1f MB", static_cast<double>(bytes) / (1024.0 * 1024.0));
+    }
+    return text;
+}
+}  // namespace
+
 void Information::drawToSidePane(SidePane& sidePane) {
     sidePane.drawText(
         "Pepr3D is a student project made by a group of Charles University students during the years 2018 and 2019.");
@@ -16,5 +30,59 @@ void Information::drawToSidePane(SidePane& sidePane) {
     sidePane.drawText("See and contribute to the code:\nhttps://github.com/tomasiser/pepr3d");
 
     sidePane.drawSeparator();
+
+    updateMemoryReport();
+    mMemoryCategory.draw(sidePane, [&sidePane, this]() { drawMemoryReport(sidePane); });
+}
+
+void Information::updateMemoryReport() {
+    const double time = mApplication.getElapsedSeconds();
+    if((mMemoryReport && time - mLastMeasureTime < MEASURE_PERIOD) || mApplication.isOperationInProgress()) {
+        return;
+    }
+    mLastMeasureTime = time;
+
+    const Geometry* const geometry = mApplication.getCurrentGeometry();
+    const CommandManager<Geometry>* const commandManager = mApplication.getCommandManager();
+    if(geometry == nullptr || commandManager == nullptr) {
+        mMemoryReport.reset();
+        return;
+    }
+
+    MemoryReport report;
+    report.triangleCount = geometry->getTriangleCount();
+    report.geometry = geometry->getMemoryUsage();
+    report.gpuBuffers = mApplication.getModelView().getGpuMemorySize();
+    report.commandCount = commandManager->getHistorySize();
+    report.snapshotCount = commandManager->getSnapshotCount();
+    report.snapshots = commandManager->getSnapshotMemorySize();
+    report.commandHistory = commandManager->getHistoryMemorySize();
+    mMemoryReport = report;
+}
+
+void Information::drawMemoryReport(SidePane& sidePane) const {
+    if(!mMemoryReport) {
+        sidePane.drawText("No model is loaded.");
+        return;
+    }
+    const MemoryReport& report = *mMemoryReport;
+    const Geometry::MemoryUsage& geometry = report.geometry;
+
+    sidePane.drawText("Model triangles: " + std::to_string(report.triangleCount));
+    sidePane.drawText("Triangles: " + formatBytes(geometry.triangles) +
+                      "\nTriangle details: " + formatBytes(geometry.triangleDetails) +
+                      "\nOpenGL buffers: " + formatBytes(geometry.openGlBuffers) +
+                      "\nGPU buffers: " + formatBytes(report.gpuBuffers) +
+                      "\nPicking trees: " + formatBytes(geometry.pickingTrees) +
+                      "\nPolyhedron: " + formatBytes(geometry.polyhedron) +
+                      "\nDetailed mesh: " + formatBytes(geometry.detailedMesh) +
+                      "\nUndo snapshots (" + std::to_string(report.snapshotCount) + "): " +
+                      formatBytes(report.snapshots) + "\nUndo history (" + std::to_string(report.commandCount) +
+                      " commands): " + formatBytes(report.commandHistory));
+    sidePane.drawText("Total without GPU buffers: " +
+                      formatBytes(geometry.getTotal() + report.snapshots + report.commandHistory));
+    sidePane.drawTooltipOnHover(
+        "Approximate memory of the main parts of the project, updated every second. Data shared between the model "
+        "and the undo snapshots is split between them.");
 }
 }  // namespace pepr3d
\ No newline at end of file
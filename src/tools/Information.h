@@ -1,13 +1,19 @@
 #pragma once
+#include <optional>
+#include "geometry/Geometry.h"
 #include "tools/Tool.h"
 #include "ui/IconsMaterialDesign.h"
 #include "ui/SidePane.h"
 
 namespace pepr3d {
 
+class MainApplication;
+
 /// Tool used for getting details about the application
 class Information : public Tool {
    public:
+    explicit Information(MainApplication& app) : mApplication(app), mMemoryCategory("Memory Usage", true) {}
+
     virtual std::string getName() const override {
         return "Information";
     }
@@ -25,5 +31,29 @@ class Information : public Tool {
     }
 
     virtual void drawToSidePane(SidePane& sidePane) override;
+
+   private:
+    /// Approximate memory of the main consumers, measured at most every MEASURE_PERIOD seconds
+    struct MemoryReport {
+        size_t triangleCount = 0;
+        Geometry::MemoryUsage geometry;
+        size_t gpuBuffers = 0;
+        size_t commandCount = 0;
+        size_t snapshotCount = 0;
+        size_t snapshots = 0;
+        size_t commandHistory = 0;
+    };
+
+    static constexpr double MEASURE_PERIOD = 1.0;
+
+    /// Measures the memory again once MEASURE_PERIOD passed, unless an operation may be modifying the Geometry
+    void updateMemoryReport();
+
+    void drawMemoryReport(SidePane& sidePane) const;
+
+    MainApplication& mApplication;
+    SidePane::Category mMemoryCategory;
+    std::optional<MemoryReport> mMemoryReport;
+    double mLastMeasureTime = 0.0;
 };
 }  // namespace pepr3d
@@ -1,4 +1,7 @@
 #include "tools/LiveDebug.h"
+#include <cfloat>
+#include <cstdio>
+#include "Profiler.h"
 #include "geometry/Geometry.h"
 #include "geometry/Triangle.h"
 #include "imgui.h"
@@ -49,9 +52,51 @@ void LiveDebug::drawToSidePane(SidePane& sidePane) {
     sidePane.drawSeparator();
     sidePane.drawFloatDragger("Radius sq", mSquaredRadius, 0.01f, 0.1f, 10, "%f", 70.f);
 
+    sidePane.drawSeparator();
+    drawTimings(sidePane);
+
     ImGui::EndChild();
 }
 
+void LiveDebug::drawTimings(SidePane& sidePane) {
+    sidePane.drawText("Timings (p50 / p95 / max):");
+    const float width = ImGui::GetContentRegionAvailWidth();
+    for(size_t zoneIdx = 0; zoneIdx < Profiler::ZONE_COUNT; ++zoneIdx) {
+        const auto zone = static_cast<Profiler::Zone>(zoneIdx);
+        const std::vector<float> history = Profiler::getHistory(zone);
+        const Profiler::Statistics statistics = Profiler::getStatistics(zone);
+
+        const string name = Profiler::getZoneName(zone);
+        sidePane.drawText(name + " (" + to_string(statistics.count) + "x)");
+        char overlay[64];
+        std::snprintf(overlay, sizeof(overlay), "%.2f / %.2f / %.2f ms", statistics.median, statistics.percentile95,
+                      statistics.max);
+        ImGui::PlotLines(("##livedebug-timing-" + name).c_str(), history.data(), static_cast<int>(history.size()), 0,
+                         overlay, 0.0f, FLT_MAX, glm::vec2(width, 40.0f));
+    }
+
+    sidePane.drawText("Per frame (p50 / p95 / max):");
+    for(size_t counterIdx = 0; counterIdx < Profiler::COUNTER_COUNT; ++counterIdx) {
+        const auto counter = static_cast<Profiler::Counter>(counterIdx);
+        const std::vector<float> history = Profiler::getHistory(counter);
+        const Profiler::Statistics statistics = Profiler::getStatistics(counter);
+
+        const string name = Profiler::getCounterName(counter);
+        sidePane.drawText(name);
+        char overlay[64];
+        std::snprintf(overlay, sizeof(overlay), "%.1f / %.1f / %.1f KiB", statistics.median / 1024.f,
+                      statistics.percentile95 / 1024.f, statistics.max / 1024.f);
+        ImGui::PlotLines(("##livedebug-counter-" + name).c_str(), history.data(), static_cast<int>(history.size()), 0,
+                         overlay, 0.0f, FLT_MAX, glm::vec2(width, 40.0f));
+    }
+
+    ImGui::PushItemWidth(width);
+    if(sidePane.drawButton("Clear timings")) {
+        Profiler::clear();
+    }
+    ImGui::PopItemWidth();
+}
+
 void LiveDebug::drawToModelView(ModelView& modelView) {
     if(mTriangleUnderRay && mApplication.getCurrentGeometry()->getTriangleCount() > mTriangleUnderRay) {
         modelView.drawTriangleHighlight(*mTriangleUnderRay);
@@ -78,7 +123,7 @@ void LiveDebug::onModelViewMouseMove(ModelView& modelView, ci::app::MouseEvent e
     mMousePos = event.getPos();
     auto ray = modelView.getRayFromWindowCoordinates(event.getPos());
     glm::vec3 isectPos{};
-    mTriangleUnderRay = mApplication.getCurrentGeometry()->intersectMesh(ray, isectPos);
+    mTriangleUnderRay = modelView.pickBaseTriangle(event.getPos(), &isectPos);
     if(mTriangleUnderRay) {
         const auto rd = ray.getDirection();
 
@@ -35,6 +35,9 @@ class LiveDebug : public Tool {
     virtual void onModelViewMouseMove(ModelView& modelView, ci::app::MouseEvent event) override;
 
    private:
+    /// Draws the graphs and statistics of the Profiler zones and counters
+    void drawTimings(SidePane& sidePane);
+
     MainApplication& mApplication;
     IntegerState mIntegerState;
     CommandManager<IntegerState> mIntegerManager;
@@ -1,4 +1,5 @@
 #include "tools/PaintBucket.h"
+#include <chrono>
 #include "commands/CmdPaintSingleColor.h"
 #include "ui/MainApplication.h"
 
@@ -16,6 +17,10 @@ void PaintBucket::drawToSidePane(SidePane &sidePane) {
     sidePane.drawCheckbox("Paint while dragging", mShouldPaintWhileDrag);
     sidePane.drawTooltipOnHover("When enabled, you can drag your mouse over regions to continuously color them.");
 
+    sidePane.drawCheckbox("Preview the region", mShowFillPreview);
+    sidePane.drawTooltipOnHover(
+        "When enabled, the region that would be colored is highlighted while you hover over the model.");
+
     if(ImGui::RadioButton("Color whole model", mDoNotStop)) {
         mDoNotStop = true;
         mStopOnColor = false;
@@ -67,15 +72,121 @@ void PaintBucket::onToolSelect(ModelView &modelView) {
     if(geometry == nullptr || !mGeometryCorrect) {
         return;
     }
-    if(!geometry->isTemporaryDetailedDataValid()) {
-        mApplication.enqueueSlowOperation([geometry]() { geometry->updateTemporaryDetailedData(); }, []() {}, true);
+    // Bucket painting spreads over the detailed mesh, build it before the first click
+    if(!geometry->isDetailedMeshValid()) {
+        mApplication.enqueueSlowOperation(
+            [geometry](const std::atomic<bool>* isCancelled) { geometry->updateDetailedMesh(isCancelled); }, []() {},
+            true, MainApplication::SlowOperationKind::DetailedMesh);
     }
 }
 
+void PaintBucket::onToolDeselect(ModelView &modelView) {
+    hidePreview();
+}
+
+void PaintBucket::onUpdate(ModelView &modelView) {
+    Geometry *const geometry = mApplication.getCurrentGeometry();
+    if(geometry == nullptr || !mGeometryCorrect || mApplication.isOperationInProgress()) {
+        return;
+    }
+    if(mPreview && mPreview->triangles.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        finishPreview(*geometry);
+    }
+    if(!mShowFillPreview) {
+        hidePreview();
+        return;
+    }
+
+    const std::optional<DetailedTriangleId> hoveredTriangleId =
+        safePickDetailedMesh(mApplication, modelView, mLastMousePos);
+    if(!hoveredTriangleId) {
+        hidePreview();
+        return;
+    }
+    const PreviewKey key{hoveredTriangleId->getBaseId(), getFillCriteria(),
+                         mApplication.getCommandManager()->getVersionNumber()};
+    if(mShownPreview && *mShownPreview == key) {
+        cancelPreview();  // Back over the shown region before a newer one finished
+    } else if(!mPreview || !(mPreview->key == key)) {
+        requestPreview(key);
+    }
+}
+
+RegionFill::Criteria PaintBucket::getFillCriteria() const {
+    RegionFill::Criteria criteria;
+    if(mDoNotStop) {
+        return criteria;
+    }
+    criteria.stopOnColor = mStopOnColor;
+    criteria.stopOnNormal = mStopOnNormal;
+    if(mStopOnNormal) {
+        criteria.minCosine = static_cast<float>(glm::cos(mStopOnNormalDegrees * glm::pi<double>() / 180.0));
+        criteria.compareWithStart = mNormalCompare == NormalAngleCompare::ABSOLUTE;
+    }
+    return criteria;
+}
+
+void PaintBucket::requestPreview(const PreviewKey &key) {
+    cancelPreview();
+
+    Geometry *const geometry = mApplication.getCurrentGeometry();
+    if(geometry->getFaceNeighbours().size() != geometry->getTriangleCount()) {
+        return;  // The mesh is not built
+    }
+    if(mRegionFill == nullptr) {
+        std::vector<glm::vec3> normals(geometry->getTriangleCount());
+        for(size_t triIdx = 0; triIdx < normals.size(); ++triIdx) {
+            normals[triIdx] = geometry->getTriangle(triIdx).getNormal();
+        }
+        mRegionFill = std::make_shared<const RegionFill>(geometry->getFaceNeighbours(),
+                                                         geometry->getFaceNeighbourCosines(), normals);
+    }
+
+    auto isCancelled = std::make_shared<std::atomic<bool>>(false);
+    auto triangles = MainApplication::getThreadPool().enqueue(
+        [regionFill = mRegionFill, colors = geometry->getPackedTriangleColors(), key, isCancelled]() {
+            return regionFill->fill(key.startTriangle, colors, key.criteria, isCancelled.get());
+        });
+    mPreview = PreviewRequest{key, std::move(isCancelled), std::move(triangles)};
+}
+
+void PaintBucket::finishPreview(Geometry &geometry) {
+    PreviewRequest preview = std::move(*mPreview);
+    mPreview.reset();
+
+    std::optional<std::vector<size_t>> triangles;
+    try {
+        triangles = preview.triangles.get();
+    } catch(const std::exception &e) {
+        CI_LOG_W("Paint bucket preview failed: " << e.what());
+        return;
+    }
+    if(!triangles) {
+        return;
+    }
+    geometry.highlightTriangles(*triangles);
+    mShownPreview = preview.key;
+}
+
+void PaintBucket::cancelPreview() {
+    if(mPreview) {
+        // The worker stops at its next check, its result is never read
+        *mPreview->isCancelled = true;
+        mPreview.reset();
+    }
+}
+
+void PaintBucket::hidePreview() {
+    cancelPreview();
+    Geometry *const geometry = mApplication.getCurrentGeometry();
+    if(mShownPreview && geometry != nullptr) {
+        geometry->hideHighlight();
+    }
+    mShownPreview = {};
+}
+
 void PaintBucket::drawToModelView(ModelView &modelView) {
-    const ci::Ray cameraRay = modelView.getRayFromWindowCoordinates(mLastMousePos);
-    const auto geometry = mApplication.getCurrentGeometry();
-    std::optional<DetailedTriangleId> hoveredTriangleId = safeIntersectDetailedMesh(mApplication, cameraRay);
+    std::optional<DetailedTriangleId> hoveredTriangleId = safePickDetailedMesh(mApplication, modelView, mLastMousePos);
 
     if(hoveredTriangleId && mGeometryCorrect) {
         modelView.drawTriangleHighlight(*hoveredTriangleId);
@@ -86,7 +197,6 @@ void PaintBucket::onModelViewMouseDown(ModelView &modelView, ci::app::MouseEvent
     if(!event.isLeftDown()) {
         return;
     }
-    const ci::Ray cameraRay = modelView.getRayFromWindowCoordinates(event.getPos());
     const auto geometry = mApplication.getCurrentGeometry();
     if(geometry == nullptr) {
         return;
@@ -96,7 +206,7 @@ void PaintBucket::onModelViewMouseDown(ModelView &modelView, ci::app::MouseEvent
     }
 
     // Get a fresh triangle intersection so we can be sure the ID is valid if it's set
-    std::optional<DetailedTriangleId> hoveredTriangleId = safeIntersectDetailedMesh(mApplication, cameraRay);
+    std::optional<DetailedTriangleId> hoveredTriangleId = safePickDetailedMesh(mApplication, modelView, event.getPos());
     if(!hoveredTriangleId) {
         return;
     }
@@ -125,7 +235,17 @@ void PaintBucket::onModelViewMouseDown(ModelView &modelView, ci::app::MouseEvent
     std::vector<DetailedTriangleId> trianglesToPaint;
 
     try {
-        trianglesToPaint = geometry->bucket(*hoveredTriangleId, combinedCriterion);
+        // Without any criterion the fill covers the whole component, which is worth spreading over the threads.
+        // The criterion only reads the geometry, so it can be called concurrently.
+        if(mDoNotStop || (!mStopOnNormal && !mStopOnColor)) {
+            trianglesToPaint =
+                geometry->parallelBucket(*hoveredTriangleId, combinedCriterion, MainApplication::getThreadPool());
+        } else if(mStopOnColor && !mStopOnNormal) {
+            // Stopping on colors only finds the existing region of the color, the geometry keeps them labelled
+            trianglesToPaint = geometry->getColorRegion(*hoveredTriangleId);
+        } else {
+            trianglesToPaint = geometry->bucket(*hoveredTriangleId, combinedCriterion);
+        }
     } catch(std::exception &e) {
         const std::string errorCaption = "Error: Failed to bucket paint";
         const std::string errorDescription =
@@ -169,6 +289,10 @@ void PaintBucket::onModelViewMouseMove(ModelView &modelView, ci::app::MouseEvent
 
 void PaintBucket::onNewGeometryLoaded(ModelView &modelView) {
     mGeometryCorrect = mApplication.getCurrentGeometry()->polyhedronValid();
+    // The preview belongs to the previous geometry
+    cancelPreview();
+    mShownPreview = {};
+    mRegionFill = nullptr;
 }
 
 }  // namespace pepr3d
\ No newline at end of file
@@ -1,7 +1,12 @@
 #pragma once
+#include <atomic>
+#include <future>
+#include <memory>
 #include <optional>
+#include <vector>
 #include "commands/CommandManager.h"
 #include "geometry/Geometry.h"
+#include "geometry/RegionFill.h"
 #include "tools/Tool.h"
 #include "ui/IconsMaterialDesign.h"
 #include "ui/SidePane.h"
@@ -38,8 +43,10 @@ class PaintBucket : public Tool {
     virtual void onModelViewMouseDown(ModelView& modelView, ci::app::MouseEvent event) override;
     virtual void onModelViewMouseDrag(ModelView& modelView, ci::app::MouseEvent event) override;
     virtual void onModelViewMouseMove(ModelView& modelView, ci::app::MouseEvent event) override;
+    virtual void onUpdate(ModelView& modelView) override;
     virtual void onNewGeometryLoaded(ModelView& modelView) override;
     virtual void onToolSelect(ModelView& modelView) override;
+    virtual void onToolDeselect(ModelView& modelView) override;
 
     enum NormalAngleCompare { NEIGHBOURS = 1, ABSOLUTE = 2 };
 
@@ -50,11 +57,54 @@ class PaintBucket : public Tool {
     bool mStopOnColor = true;
     bool mDoNotStop = false;
     bool mShouldPaintWhileDrag = true;
+    bool mShowFillPreview = true;
     bool mDragging = false;
     bool mGeometryCorrect = true;
     NormalAngleCompare mNormalCompare = NormalAngleCompare::NEIGHBOURS;
     glm::ivec2 mLastMousePos;
 
+    /// What a preview of the fill was computed for, it is stale once any of it changes
+    struct PreviewKey {
+        size_t startTriangle;
+        RegionFill::Criteria criteria;
+
+        /// CommandManager::getVersionNumber() of the colors the fill read
+        size_t version;
+
+        bool operator==(const PreviewKey& other) const {
+            return startTriangle == other.startTriangle && criteria == other.criteria && version == other.version;
+        }
+    };
+
+    /// Preview of the fill running on a worker thread, cancelled by a newer request. The highlight of the previous
+    /// preview stays until it finishes.
+    struct PreviewRequest {
+        PreviewKey key;
+        std::shared_ptr<std::atomic<bool>> isCancelled;
+        std::future<std::optional<std::vector<size_t>>> triangles;
+    };
+    std::optional<PreviewRequest> mPreview;
+
+    /// Preview highlighted on the geometry, empty if there is none
+    std::optional<PreviewKey> mShownPreview;
+
+    /// Topology of the current geometry for the previews, copied for the first one
+    std::shared_ptr<const RegionFill> mRegionFill;
+
+    /// Criteria of the current settings, the same as the bucket of the Geometry uses
+    RegionFill::Criteria getFillCriteria() const;
+
+    /// Fill the region of the key on a worker thread, cancelling the running preview
+    void requestPreview(const PreviewKey& key);
+
+    /// Highlight the result of the finished mPreview
+    void finishPreview(Geometry& geometry);
+
+    void cancelPreview();
+
+    /// Cancel the running preview and remove the highlight of the shown one
+    void hidePreview();
+
     /// A paint bucket criterion that never stops, used for coloring the whole model
     struct DoNotStop {
         const Geometry* geo;
@@ -102,9 +152,7 @@ class PaintBucket : public Tool {
                 const auto& newNormal = geo->getTriangle(a).getNormal();
                 cosAngle = glm::dot(glm::normalize(newNormal), glm::normalize(startNormal));
             } else if(angleCompare == NormalAngleCompare::NEIGHBOURS) {
-                const auto& newNormal1 = geo->getTriangle(a).getNormal();
-                const auto& newNormal2 = geo->getTriangle(b).getNormal();
-                cosAngle = glm::dot(glm::normalize(newNormal1), glm::normalize(newNormal2));
+                cosAngle = geo->getNeighbourCosine(a, b);
             } else {
                 assert(false);
             }
@@ -1,4 +1,5 @@
 #include "tools/Segmentation.h"
+#include <chrono>
 #include <random>
 #include <vector>
 #include "commands/CmdPaintSingleColor.h"
@@ -15,23 +16,39 @@ void Segmentation::drawToSidePane(SidePane& sidePane) {
     const bool isSdfComputed = mApplication.getCurrentGeometry()->isSdfComputed();
     if(!isSdfComputed) {
         sidePane.drawText("Warning: This computation may take a long time to perform.");
+        drawSdfSettings(mApplication, sidePane);
         if(sidePane.drawButton("Compute SDF")) {
             mApplication.enqueueSlowOperation([this]() { safeComputeSdf(mApplication); }, []() {}, true);
         }
         sidePane.drawTooltipOnHover("Compute the shape diameter function of the model to enable the segmentation.");
     } else {
+        drawSdfRefinement(mApplication, sidePane);
         if(sidePane.drawButton("Segment!")) {
             computeSegmentation();
         }
         sidePane.drawTooltipOnHover("Start segmentation on the model.");
-        sidePane.drawFloatDragger("Robustness", mNumberOfClusters, 0.25f, 0.0f, 100.0f, "%.0f %%", 70.0f);
+        bool hasChanged =
+            sidePane.drawFloatDragger("Robustness", mNumberOfClusters, 0.25f, 0.0f, 100.0f, "%.0f %%", 70.0f);
         sidePane.drawTooltipOnHover(
             "Higher values increase the computation time and might result in better region grouping. The default value "
             "should be good for most use cases.");
-        sidePane.drawFloatDragger("Edge tolerance", mSmoothingLambda, 0.25f, 0.0f, 100.0f, "%.0f %%", 70.0f);
+        hasChanged |= sidePane.drawFloatDragger("Edge tolerance", mSmoothingLambda, 0.25f, 0.0f, 100.0f, "%.0f %%",
+                                                70.0f);
         sidePane.drawTooltipOnHover(
             "The higher the number, the more the segmentation will tolerate sharp edges and thus make less segments. "
             "If you have more segments than you wanted, increase this value. If you have less, decrease.");
+
+        const bool wasLivePreview = mIsLivePreview;
+        sidePane.drawCheckbox("Live preview", mIsLivePreview);
+        sidePane.drawTooltipOnHover("Segment the model in the background whenever the settings change.");
+        if(mIsLivePreview && (hasChanged || !wasLivePreview)) {
+            requestPreview();
+        } else if(!mIsLivePreview && wasLivePreview) {
+            cancelPreview();
+        }
+        if(mPreview) {
+            sidePane.drawText("Updating the preview...");
+        }
     }
 
     sidePane.drawSeparator();
@@ -43,33 +60,31 @@ void Segmentation::drawToSidePane(SidePane& sidePane) {
 
         sidePane.drawColorPalette();
 
-        for(const auto& toPaint : mSegmentToTriangleIds) {
-            std::string displayText = "Segment " + std::to_string(toPaint.first);
+        for(size_t segment = 0; segment < mSegments.getSegmentCount(); ++segment) {
+            std::string displayText = "Segment " + std::to_string(segment);
 
             glm::vec4 colorOfSegment(0, 0, 0, 1);
-            if(mNewColors[toPaint.first] != std::numeric_limits<size_t>::max()) {
-                colorOfSegment = colorManager.getColor(mNewColors[toPaint.first]);
+            if(mNewColors[segment] != std::numeric_limits<size_t>::max()) {
+                colorOfSegment = colorManager.getColor(mNewColors[segment]);
             } else {
-                colorOfSegment = mSegmentationColors[toPaint.first];
+                colorOfSegment = mSegmentationColors[segment];
             }
             glm::vec3 hsvButtonColor = ci::rgbToHsv(static_cast<ci::ColorA>(colorOfSegment));
             hsvButtonColor.y = 0.75;  // reduce the saturation
             ci::ColorA borderColor = ci::hsvToRgb(hsvButtonColor);
             float thickness = 3.0f;
             if(mHoveredTriangleId) {
-                auto find = mTriangleToSegmentMap.find(*mHoveredTriangleId);
-                assert(find != mTriangleToSegmentMap.end());
-                assert(find->first == *mHoveredTriangleId);
-                if(find->second == toPaint.first) {
+                assert(*mHoveredTriangleId < mSegments.getTriangleCount());
+                if(mSegments.getSegment(*mHoveredTriangleId) == segment) {
                     borderColor = ci::ColorA(1, 0, 0, 1);
                     displayText = "Currently hovered";
                     thickness = 5.0f;
                 }
             }
             if(sidePane.drawColoredButton(displayText.c_str(), borderColor, thickness)) {
-                mNewColors[toPaint.first] = colorManager.getActiveColorIndex();
+                mNewColors[segment] = colorManager.getActiveColorIndex();
                 const glm::vec4 newColor = colorManager.getColor(colorManager.getActiveColorIndex());
-                setSegmentColor(toPaint.first, newColor);
+                setSegmentColor(segment, newColor);
             }
             sidePane.drawTooltipOnHover(
                 "Click to color this segment with the currently active color from the palette.");
@@ -78,8 +93,8 @@ void Segmentation::drawToSidePane(SidePane& sidePane) {
         if(sidePane.drawButton("Accept")) {
             // Find the maximum index of the color assignment
             size_t maxColorIndex = std::numeric_limits<size_t>::min();
-            for(const auto& segment : mSegmentToTriangleIds) {
-                const size_t activeColorAssigned = mNewColors[segment.first];
+            for(size_t segment = 0; segment < mSegments.getSegmentCount(); ++segment) {
+                const size_t activeColorAssigned = mNewColors[segment];
                 if(activeColorAssigned > maxColorIndex) {
                     maxColorIndex = activeColorAssigned;
                 }
@@ -87,12 +102,12 @@ void Segmentation::drawToSidePane(SidePane& sidePane) {
 
             // If the user assigned colors are valid (i.e. there aren't colors out of the palette size), apply.
             if(maxColorIndex < colorManager.size()) {
-                for(const auto& segment : mSegmentToTriangleIds) {
-                    const size_t activeColorAssigned = mNewColors[segment.first];
-                    auto proxy = segment.second;
+                for(size_t segment = 0; segment < mSegments.getSegmentCount(); ++segment) {
+                    const size_t activeColorAssigned = mNewColors[segment];
                     CommandManager<Geometry>* const commandManager = mApplication.getCommandManager();
                     commandManager->execute(
-                        std::make_unique<CmdPaintSingleColor>(std::move(proxy), activeColorAssigned), false);
+                        std::make_unique<CmdPaintSingleColor>(mSegments.copyTriangles(segment), activeColorAssigned),
+                        false);
                 }
                 reset();
                 CI_LOG_I("Segmentation applied.");
@@ -128,13 +143,12 @@ void Segmentation::onToolDeselect(ModelView& modelView) {
 }
 
 void Segmentation::onModelViewMouseMove(ModelView& modelView, ci::app::MouseEvent event) {
-    ci::Ray mLastRay = modelView.getRayFromWindowCoordinates(event.getPos());
     const auto geometry = mApplication.getCurrentGeometry();
     if(geometry == nullptr) {
         mHoveredTriangleId = {};
         return;
     }
-    mHoveredTriangleId = safeIntersectMesh(mApplication, mLastRay);
+    mHoveredTriangleId = safePickMesh(mApplication, modelView, event.getPos());
 }
 
 void Segmentation::drawToModelView(ModelView& modelView) {
@@ -157,11 +171,8 @@ void Segmentation::onModelViewMouseDown(ModelView& modelView, ci::app::MouseEven
         return;
     }
 
-    auto find = mTriangleToSegmentMap.find(*mHoveredTriangleId);
-    assert(find != mTriangleToSegmentMap.end());
-    assert(find->first == *mHoveredTriangleId);
-
-    const size_t segId = find->second;
+    assert(*mHoveredTriangleId < mSegments.getTriangleCount());
+    const size_t segId = mSegments.getSegment(*mHoveredTriangleId);
     assert(segId < mNumberOfSegments);
     assert(segId < mNewColors.size());
 
@@ -174,6 +185,9 @@ void Segmentation::onModelViewMouseDown(ModelView& modelView, ci::app::MouseEven
 
 void Segmentation::reset() {
     mApplication.getModelView().toggleMeshOverride(false);
+    mApplication.getModelView().getOverrideFaceColorBuffer().clear();
+    mApplication.getModelView().getOverridePalette().clear();
+    cancelPreview();
 
     mNumberOfSegments = 0;
     mPickState = false;
@@ -183,14 +197,11 @@ void Segmentation::reset() {
     mSegmentationColors.clear();
     mHoveredTriangleId = {};
 
-    mSegmentToTriangleIds.clear();
-    mTriangleToSegmentMap.clear();
+    mSegments.clear();
 }
 
-void Segmentation::computeSegmentation() {
-    cancel();
-
-    Geometry* geometry = mApplication.getCurrentGeometry();
+std::pair<int, float> Segmentation::getSegmentationParameters() const {
+    const Geometry* const geometry = mApplication.getCurrentGeometry();
     assert(geometry);
 
     float smoothingLambda = mSmoothingLambda / 100.0f;
@@ -201,13 +212,79 @@ void Segmentation::computeSegmentation() {
     numberOfClusters = std::min<int>(numberOfClusters, 15);
     numberOfClusters = std::min<int>(numberOfClusters, static_cast<int>(geometry->getTriangleCount()) - 2);
     numberOfClusters = std::max<int>(2, numberOfClusters);
+    return {numberOfClusters, smoothingLambda};
+}
+
+void Segmentation::requestPreview() {
+    const auto parameters = getSegmentationParameters();
+    if(mPreview && mPreview->numberOfClusters == parameters.first && mPreview->smoothingLambda == parameters.second) {
+        return;
+    }
+    cancelPreview();
+
+    std::shared_ptr<const SdfSegmentation> sdfSegmentation = mApplication.getCurrentGeometry()->getSdfSegmentation();
+    if(sdfSegmentation == nullptr) {
+        return;
+    }
+    auto isCancelled = std::make_shared<std::atomic<bool>>(false);
+    auto segments = MainApplication::getThreadPool().enqueue([sdfSegmentation, isCancelled, parameters]() {
+        return sdfSegmentation->segment(parameters.first, parameters.second, isCancelled.get());
+    });
+    mPreview = PreviewRequest{parameters.first, parameters.second, std::move(sdfSegmentation), std::move(isCancelled),
+                              std::move(segments)};
+}
+
+void Segmentation::cancelPreview() {
+    if(mPreview) {
+        // The worker stops at its next check, its result is never read
+        *mPreview->isCancelled = true;
+        mPreview.reset();
+    }
+}
+
+void Segmentation::onUpdate(ModelView& modelView) {
+    if(!mPreview || mPreview->segments.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+    PreviewRequest preview = std::move(*mPreview);
+    mPreview.reset();
+
+    std::optional<SdfSegmentation::Segments> segments;
+    try {
+        segments = preview.segments.get();
+    } catch(const std::exception& e) {
+        CI_LOG_W("Segmentation preview failed: " << e.what());
+        return;
+    }
+    Geometry* const geometry = mApplication.getCurrentGeometry();
+    if(!segments || geometry == nullptr) {
+        return;
+    }
+
+    // The segmentation picks up the cached segments instead of computing them again
+    geometry->cacheSegmentation(preview.sdfSegmentation, preview.numberOfClusters, preview.smoothingLambda,
+                                std::move(*segments));
+    if(getSegmentationParameters() == std::make_pair(preview.numberOfClusters, preview.smoothingLambda)) {
+        computeSegmentation();
+    }
+}
+
+void Segmentation::computeSegmentation() {
+    cancel();
+
+    Geometry* geometry = mApplication.getCurrentGeometry();
+    assert(geometry);
+
+    const auto parameters = getSegmentationParameters();
+    const int numberOfClusters = parameters.first;
+    const float smoothingLambda = parameters.second;
 
     assert(0.0f < smoothingLambda && smoothingLambda <= 1.0f);
     assert(2 <= numberOfClusters && numberOfClusters <= geometry->getTriangleCount() && numberOfClusters <= 15);
 
     try {
         mNumberOfSegments =
-            geometry->segmentation(numberOfClusters, smoothingLambda, mSegmentToTriangleIds, mTriangleToSegmentMap);
+            geometry->segmentation(numberOfClusters, smoothingLambda, mSegments);
     } catch(std::exception& e) {
         const std::string errorCaption = "Error: Failed to compute the segmentation";
         const std::string errorDescription =
@@ -235,38 +312,28 @@ void Segmentation::computeSegmentation() {
         pepr3d::ColorManager::generateColors(mNumberOfSegments, mSegmentationColors);
         assert(mSegmentationColors.size() == mNumberOfSegments);
 
-        // Create an override color buffer based on the segmentation
-        std::vector<glm::vec4> newOverrideBuffer;
-        newOverrideBuffer.resize(geometry->getTriangleCount() * 3);
-        for(const auto& toPaint : mSegmentToTriangleIds) {
-            for(const auto& tri : toPaint.second) {
-                newOverrideBuffer[3 * tri] = mSegmentationColors[toPaint.first];
-                newOverrideBuffer[3 * tri + 1] = mSegmentationColors[toPaint.first];
-                newOverrideBuffer[3 * tri + 2] = mSegmentationColors[toPaint.first];
-            }
+        // Color the override mesh by the segment of each face, so a new color of a segment only changes the palette
+        ModelView& modelView = mApplication.getModelView();
+        modelView.toggleMeshOverride(true);
+        modelView.initOverrideFromGeometry();
+        std::vector<Geometry::ColorIndex>& faceColors = modelView.getOverrideFaceColorBuffer();
+        assert(mSegments.getTriangleCount() == geometry->getTriangleCount());
+        faceColors.resize(mSegments.getTriangleCount());
+        for(size_t tri = 0; tri < mSegments.getTriangleCount(); ++tri) {
+            faceColors[tri] = static_cast<Geometry::ColorIndex>(mSegments.getSegment(tri));
         }
-        mApplication.getModelView().toggleMeshOverride(true);
-        mApplication.getModelView().initOverrideFromBasicGeoemtry();
-        mApplication.getModelView().getOverrideColorBuffer() = newOverrideBuffer;
+        modelView.getOverridePalette() = mSegmentationColors;
     }
 }
 
 void Segmentation::setSegmentColor(const size_t segmentId, const glm::vec4 newColor) {
-    std::vector<glm::vec4>& overrideBuffer = mApplication.getModelView().getOverrideColorBuffer();
-    auto segmentTris = mSegmentToTriangleIds.find(segmentId);
-
-    if(segmentTris == mSegmentToTriangleIds.end()) {
+    // The faces of the override mesh index the palette by their segments
+    std::vector<glm::vec4>& overridePalette = mApplication.getModelView().getOverridePalette();
+    if(segmentId >= overridePalette.size()) {
         assert(false);
         return;
     }
-    assert((*segmentTris).first == segmentId);
-
-    assert(!overrideBuffer.empty());
-    for(const auto& tri : (*segmentTris).second) {
-        overrideBuffer[3 * tri] = newColor;
-        overrideBuffer[3 * tri + 1] = newColor;
-        overrideBuffer[3 * tri + 2] = newColor;
-    }
+    overridePalette[segmentId] = newColor;
 }
 
 void Segmentation::onNewGeometryLoaded(ModelView& modelView) {
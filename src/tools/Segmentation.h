@@ -1,7 +1,9 @@
 #pragma once
-#include <map>
+#include <atomic>
+#include <future>
+#include <memory>
 #include <optional>
-#include <unordered_map>
+#include <utility>
 #include "commands/CommandManager.h"
 #include "geometry/Geometry.h"
 #include "tools/Tool.h"
@@ -42,6 +44,7 @@ class Segmentation : public Tool {
 
     virtual void drawToSidePane(SidePane& sidePane) override;
     virtual void drawToModelView(ModelView& modelView) override;
+    virtual void onUpdate(ModelView& modelView) override;
     virtual void onModelViewMouseDown(ModelView& modelView, ci::app::MouseEvent event) override;
     virtual void onModelViewMouseMove(ModelView& modelView, ci::app::MouseEvent event) override;
     virtual void onToolDeselect(ModelView& modelView) override;
@@ -61,11 +64,29 @@ class Segmentation : public Tool {
     std::vector<glm::vec4> mSegmentationColors;
     std::optional<std::size_t> mHoveredTriangleId = {};
 
-    std::map<size_t, std::vector<size_t>> mSegmentToTriangleIds;
-    std::unordered_map<size_t, size_t> mTriangleToSegmentMap;
+    /// Segments of the computed segmentation, empty until segmented
+    SegmentMap mSegments;
+
+    /// Segment again on a worker thread whenever the settings change
+    bool mIsLivePreview = false;
+
+    /// Segmentation of the live preview running on a worker thread, cancelled by a newer request
+    struct PreviewRequest {
+        int numberOfClusters;
+        float smoothingLambda;
+        std::shared_ptr<const SdfSegmentation> sdfSegmentation;
+        std::shared_ptr<std::atomic<bool>> isCancelled;
+        std::future<std::optional<SdfSegmentation::Segments>> segments;
+    };
+    std::optional<PreviewRequest> mPreview;
+
+    /// Number of clusters and smoothing lambda of the current settings
+    std::pair<int, float> getSegmentationParameters() const;
 
     void reset();
     void computeSegmentation();
+    void requestPreview();
+    void cancelPreview();
     void cancel();
     void setSegmentColor(const size_t segmentId, const glm::vec4 newColor);
 };
@@ -19,12 +19,14 @@ void SemiautomaticSegmentation::drawToSidePane(SidePane& sidePane) {
     const bool isSdfComputed = currentGeometry->isSdfComputed();
     if(!isSdfComputed) {
         sidePane.drawText("Warning: This computation may take a long time to perform.");
+        drawSdfSettings(mApplication, sidePane);
         if(sidePane.drawButton("Compute SDF")) {
             mApplication.enqueueSlowOperation([this]() { safeComputeSdf(mApplication); }, []() {}, true);
         }
         sidePane.drawTooltipOnHover("Compute the shape diameter function of the model to enable the segmentation.");
         sidePane.drawSeparator();
     } else {
+        drawSdfRefinement(mApplication, sidePane);
         sidePane.drawColorPalette();
         sidePane.drawSeparator();
 
@@ -100,169 +102,48 @@ void SemiautomaticSegmentation::drawToSidePane(SidePane& sidePane) {
     }
 }
 
-size_t SemiautomaticSegmentation::findClosestColorFromSDF(
-    const size_t triangle, const size_t color1, const size_t color2,
-    const std::unordered_map<std::size_t, std::vector<double>>& sdfValuesPerColor) {
-    const Geometry* const currentGeometry = mApplication.getCurrentGeometry();
-    assert(currentGeometry != nullptr);
-
-    double triangleSdfValue = currentGeometry->getSdfValue(triangle);
-
-    auto findClosestSDFValue = [](double target, const std::vector<double>& values) -> double {
-        const auto initialSdfValue = std::lower_bound(values.begin(), values.end(), target);
-        double closest1 = -1;
-        double closest2 = -1;
-        if(initialSdfValue == values.end()) {
-            closest1 = closest2 = values.back();
-        } else {
-            closest1 = *initialSdfValue;
-            if(*initialSdfValue == values.front()) {
-                closest2 = *initialSdfValue;
-            } else {
-                closest2 = *(initialSdfValue - 1);
-            }
-        }
-        const double delta1 = abs(target - closest1);
-        const double delta2 = abs(target - closest2);
-        if(delta1 < delta2) {
-            return closest1;
-        } else {
-            return closest2;
-        }
-    };
-
-    const auto find1 = sdfValuesPerColor.find(color1);
-    const auto find2 = sdfValuesPerColor.find(color2);
-
-    if(find1 == sdfValuesPerColor.end() && find2 == sdfValuesPerColor.end()) {
-        assert(false);
-        return std::numeric_limits<size_t>::max();
-    } else if(find1 == sdfValuesPerColor.end() || find1->second.empty()) {
-        return color2;
-    } else if(find2 == sdfValuesPerColor.end() || find2->second.empty()) {
-        return color1;
-    } else {
-        const double closeToColor1 = findClosestSDFValue(triangleSdfValue, find1->second);
-        const double closeToColor2 = findClosestSDFValue(triangleSdfValue, find2->second);
-        const double delta1 = abs(triangleSdfValue - closeToColor1);
-        const double delta2 = abs(triangleSdfValue - closeToColor2);
-        if(delta1 < delta2) {
-            return color1;
-        } else {
-            return color2;
-        }
-    }
-}
-
-bool SemiautomaticSegmentation::postprocess(
-    const std::unordered_map<std::size_t, std::vector<double>>& sdfValuesPerColor) {
-    std::unordered_map<std::size_t, std::size_t> triangleToColor;
-    // Go through each color, create an assignment triangle->color
-    for(const auto& oneColor : mCurrentColoring) {
-        // Go through each triangle assigned to a single color
-        for(const auto& tri : oneColor.second) {
-            auto findTri = triangleToColor.find(tri);
-            // If we did not assign this triangle before, assign it to currentColor
-            if(findTri == triangleToColor.end()) {
-                triangleToColor.insert({tri, oneColor.first});
-            } else {  // If we did assign, check the SDF values and assign it to the closest color
-                const size_t oldColor = findTri->second;
-                const size_t currentColor = oneColor.first;
-                const size_t retVal = findClosestColorFromSDF(tri, oldColor, currentColor, sdfValuesPerColor);
-                if(retVal == std::numeric_limits<size_t>::max()) {
-                    return false;
-                }
-                findTri->second = retVal;
-            }
-        }
-    }
-
-    // Re-collect the triangles by colors to get the resulting
-    mCurrentColoring = collectTrianglesByColor(triangleToColor);
-    return true;
-}
-
 void SemiautomaticSegmentation::spreadColors() {
     Geometry* const currentGeometry = mApplication.getCurrentGeometry();
     assert(currentGeometry != nullptr);
 
     mCurrentColoring.clear();
-    auto& overrideBuffer = mApplication.getModelView().getOverrideColorBuffer();
-    overrideBuffer = mBackupColorBuffer;
-
-    // Collect all triangles of each color
-    const std::unordered_map<std::size_t, std::vector<std::size_t>> trianglesByColor =
-        collectTrianglesByColor(mStartingTriangles);
-
-    /// Normal stopping init, uncomment in case we want to include it as a feature
-    const Geometry* const p = const_cast<const Geometry*>(currentGeometry);
-    const double angleRads = (100.0f - mBucketSpread) / 100.0f * 180.f * glm::pi<double>() / 180.0;
-    NormalStopping stoppingFtor(p, angleRads);
-
-    // Precompute data - gather all starting triangle SDF data into sdfValuesPerColor
-    std::unordered_map<std::size_t, std::vector<double>> sdfValuesPerColor;
-    for(const auto& colorTriangles : trianglesByColor) {
-        const size_t currentColor = colorTriangles.first;
-        const std::vector<size_t>& startingTriangles = colorTriangles.second;
-
-        sdfValuesPerColor.insert({currentColor, {}});
-        assert(sdfValuesPerColor.find(currentColor) != sdfValuesPerColor.end());
-        std::vector<double>& initialValues = sdfValuesPerColor.find(currentColor)->second;
-
-        initialValues.reserve(startingTriangles.size());
-        for(size_t startI : startingTriangles) {
-            initialValues.push_back(currentGeometry->getSdfValue(startI));
-        }
-    }
+    auto& faceColors = mApplication.getModelView().getOverrideFaceColorBuffer();
+    faceColors = mBackupFaceColors;
 
-    // Compute the best region for each triangle
-    std::unordered_map<std::size_t, std::size_t> triangleToBestRegion;
-    for(size_t i = 0; i < currentGeometry->getTriangleCount(); ++i) {
-        triangleToBestRegion.insert({i, 0});
-        for(const auto& region : trianglesByColor) {
-            const size_t regionColor = region.first;
-            const std::vector<size_t>& regionTriangles = region.second;
-            auto find = triangleToBestRegion.find(i);
-            assert(find != triangleToBestRegion.end());
-            find->second = findClosestColorFromSDF(i, find->second, regionColor, sdfValuesPerColor);
+    if(mCriterionUsed == Criteria::SDF) {
+        if(!currentGeometry->isSdfComputed()) {
+            throw std::runtime_error("The SDF values are not computed.");
         }
-    }
-
-    // Bucket spread all the colors
-    for(const auto& colorTriangles : trianglesByColor) {
-        const size_t currentColor = colorTriangles.first;
-        const std::vector<size_t>& startingTriangles = colorTriangles.second;
-        if(startingTriangles.empty()) {
-            continue;
-        }
-
-        assert(sdfValuesPerColor.find(currentColor) != sdfValuesPerColor.end());
-        std::vector<double>& initialValues = sdfValuesPerColor.find(currentColor)->second;
-        std::vector<size_t> ret;
-        if(mCriterionUsed == Criteria::SDF) {
-            SDFStopping SDFStopping(currentGeometry, initialValues, mBucketSpread / 100.0f, triangleToBestRegion,
-                                    mHardEdges);
-            ret = currentGeometry->bucket(startingTriangles, SDFStopping);
-        } else {
-            assert(mCriterionUsed == Criteria::NORMAL);
-            ret = currentGeometry->bucket(startingTriangles, stoppingFtor);
+        if(mRegionFlood == nullptr || mRegionFloodSdfVersion != currentGeometry->getSdfValuesVersion()) {
+            std::vector<double> sdfValues(currentGeometry->getTriangleCount());
+            for(size_t i = 0; i < sdfValues.size(); ++i) {
+                sdfValues[i] = currentGeometry->getSdfValue(i);
+            }
+            mRegionFlood =
+                std::make_unique<SdfRegionFlood>(currentGeometry->getFaceNeighbours(), std::move(sdfValues));
+            mRegionFloodSdfVersion = currentGeometry->getSdfValuesVersion();
         }
 
-        // Remember the coloring
-        mCurrentColoring.insert({currentColor, ret});
-    }
-
-    // Postprocess the newly calculated colorings
-    if(!mRegionOverlap && mCriterionUsed == Criteria::SDF) {
-        bool isPostOk = postprocess(sdfValuesPerColor);
-        if(!isPostOk) {
-            const std::string errorCaption = "Error: Failed to spread colors";
-            const std::string errorDescription =
-                "An invalid color setup was detected and the semiautomatic segmentation will be reset. "
-                "Please report this bug to the developers.";
-            mApplication.pushDialog(Dialog(DialogType::Error, errorCaption, errorDescription, "Reset segmentation"));
-            reset();
-            return;
+        // Only the colors with new seeds are flooded further, the spread thresholds the flood
+        mRegionFlood->setSeeds(mStartingTriangles, mHardEdges);
+        mCurrentColoring = mRegionFlood->getRegions(mBucketSpread / 100.0, mRegionOverlap && !mHardEdges);
+    } else {
+        assert(mCriterionUsed == Criteria::NORMAL);
+
+        /// Normal stopping init, uncomment in case we want to include it as a feature
+        const Geometry* const p = const_cast<const Geometry*>(currentGeometry);
+        const double angleRads = (100.0f - mBucketSpread) / 100.0f * 180.f * glm::pi<double>() / 180.0;
+        NormalStopping stoppingFtor(p, angleRads);
+
+        // Bucket spread all the colors. Spreads usually cover large parts of the mesh, the criterion only reads the
+        // geometry and can be called from several threads.
+        ::ThreadPool& threadPool = MainApplication::getThreadPool();
+        for(const auto& colorTriangles : collectTrianglesByColor(mStartingTriangles)) {
+            if(colorTriangles.second.empty()) {
+                continue;
+            }
+            std::vector<size_t> ret = currentGeometry->parallelBucket(colorTriangles.second, stoppingFtor, threadPool);
+            mCurrentColoring.insert({colorTriangles.first, std::move(ret)});
         }
     }
 
@@ -270,10 +151,7 @@ void SemiautomaticSegmentation::spreadColors() {
     for(const auto& coloring : mCurrentColoring) {
         if(mApplication.getModelView().isMeshOverriden()) {
             for(const size_t tri : coloring.second) {
-                const auto rgbTriangleColor = currentGeometry->getColorManager().getColor(coloring.first);
-                overrideBuffer[3 * tri] = rgbTriangleColor;
-                overrideBuffer[3 * tri + 1] = rgbTriangleColor;
-                overrideBuffer[3 * tri + 2] = rgbTriangleColor;
+                faceColors[tri] = static_cast<Geometry::ColorIndex>(coloring.first);
             }
         }
     }
@@ -308,30 +186,24 @@ void SemiautomaticSegmentation::drawToModelView(ModelView& modelView) {
 }
 
 void SemiautomaticSegmentation::setupOverride() {
-    std::vector<glm::vec4> newOverrideBuffer;
+    // The override mesh is colored by the palette index of each face, a byte per face instead of 3 colors
+    std::vector<Geometry::ColorIndex> newFaceColors;
     const auto currentGeometry = mApplication.getCurrentGeometry();
-    newOverrideBuffer.resize(currentGeometry->getTriangleCount() * 3);
+    newFaceColors.resize(currentGeometry->getTriangleCount());
     for(size_t i = 0; i < currentGeometry->getTriangleCount(); i++) {
-        const size_t triangleColor = currentGeometry->getTriangleColor(i);
-        const auto rgbTriangleColor = currentGeometry->getColorManager().getColor(triangleColor);
-        newOverrideBuffer[3 * i] = rgbTriangleColor;
-        newOverrideBuffer[3 * i + 1] = rgbTriangleColor;
-        newOverrideBuffer[3 * i + 2] = rgbTriangleColor;
+        newFaceColors[i] = static_cast<Geometry::ColorIndex>(currentGeometry->getTriangleColor(i));
     }
 
     for(const auto& repaint : mStartingTriangles) {
-        const size_t triIndex = repaint.first;
-        const size_t colorIndex = repaint.second;
-        const auto rgbTriangleColor = currentGeometry->getColorManager().getColor(colorIndex);
-        newOverrideBuffer[3 * triIndex] = rgbTriangleColor;
-        newOverrideBuffer[3 * triIndex + 1] = rgbTriangleColor;
-        newOverrideBuffer[3 * triIndex + 2] = rgbTriangleColor;
+        newFaceColors[repaint.first] = static_cast<Geometry::ColorIndex>(repaint.second);
     }
 
-    mApplication.getModelView().toggleMeshOverride(true);
-    mApplication.getModelView().initOverrideFromBasicGeoemtry();
-    mBackupColorBuffer = newOverrideBuffer;
-    mApplication.getModelView().getOverrideColorBuffer() = newOverrideBuffer;
+    ModelView& modelView = mApplication.getModelView();
+    modelView.toggleMeshOverride(true);
+    modelView.initOverrideFromGeometry();
+    modelView.getOverridePalette() = currentGeometry->getColorManager().getColorMap();
+    mBackupFaceColors = newFaceColors;
+    modelView.getOverrideFaceColorBuffer() = std::move(newFaceColors);
 }
 
 void SemiautomaticSegmentation::setTriangleColor() {
@@ -350,14 +222,9 @@ void SemiautomaticSegmentation::setTriangleColor() {
         }
 
         if(mApplication.getModelView().isMeshOverriden()) {
-            const auto rgbTriangleColor = mApplication.getCurrentGeometry()->getColorManager().getColor(activeColor);
-            auto& overrideBuffer = mApplication.getModelView().getOverrideColorBuffer();
-            overrideBuffer[3 * triIndex] = rgbTriangleColor;
-            overrideBuffer[3 * triIndex + 1] = rgbTriangleColor;
-            overrideBuffer[3 * triIndex + 2] = rgbTriangleColor;
-            mBackupColorBuffer[3 * triIndex] = rgbTriangleColor;
-            mBackupColorBuffer[3 * triIndex + 1] = rgbTriangleColor;
-            mBackupColorBuffer[3 * triIndex + 2] = rgbTriangleColor;
+            auto& faceColors = mApplication.getModelView().getOverrideFaceColorBuffer();
+            faceColors[triIndex] = static_cast<Geometry::ColorIndex>(activeColor);
+            mBackupFaceColors[triIndex] = static_cast<Geometry::ColorIndex>(activeColor);
         }
     }
 }
@@ -403,7 +270,7 @@ void SemiautomaticSegmentation::onModelViewMouseDown(ModelView& modelView, ci::a
     if(emptyBefore && !mStartingTriangles.empty()) {
         setupOverride();
     } else if(!mDragging) {  // Restore the pre-spread buffer, reset the setting
-        mApplication.getModelView().getOverrideColorBuffer() = mBackupColorBuffer;
+        mApplication.getModelView().getOverrideFaceColorBuffer() = mBackupFaceColors;
         mBucketSpread = 0.f;
         mBucketSpreadLatest = 0.f;
 
@@ -423,7 +290,7 @@ void SemiautomaticSegmentation::onModelViewMouseDrag(ModelView& modelView, ci::a
     mDragging = false;
 
     // Restore the pre-spread buffer, reset the setting
-    mApplication.getModelView().getOverrideColorBuffer() = mBackupColorBuffer;
+    mApplication.getModelView().getOverrideFaceColorBuffer() = mBackupFaceColors;
     mBucketSpread = 0.f;
     mBucketSpreadLatest = 0.f;
 
@@ -432,13 +299,12 @@ void SemiautomaticSegmentation::onModelViewMouseDrag(ModelView& modelView, ci::a
 }
 
 void SemiautomaticSegmentation::onModelViewMouseMove(ModelView& modelView, ci::app::MouseEvent event) {
-    const auto lastRay = modelView.getRayFromWindowCoordinates(event.getPos());
     const auto geometry = mApplication.getCurrentGeometry();
     if(geometry == nullptr) {
         mHoveredTriangleId = {};
         return;
     }
-    mHoveredTriangleId = geometry->intersectMesh(lastRay);
+    mHoveredTriangleId = modelView.pickBaseTriangle(event.getPos());
 }
 
 bool SemiautomaticSegmentation::isEnabled() const {
@@ -467,10 +333,12 @@ void SemiautomaticSegmentation::reset() {
 
     mHoveredTriangleId = {};
     mStartingTriangles.clear();
-    mBackupColorBuffer.clear();
+    mBackupFaceColors.clear();
     mCurrentColoring.clear();
+    mRegionFlood.reset();
 
-    mApplication.getModelView().getOverrideColorBuffer().clear();
+    mApplication.getModelView().getOverrideFaceColorBuffer().clear();
+    mApplication.getModelView().getOverridePalette().clear();
     mApplication.getModelView().toggleMeshOverride(false);
 }
 
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 
+#include "geometry/SdfRegionFlood.h"
 #include "tools/Tool.h"
 #include "ui/IconsMaterialDesign.h"
 #include "ui/MainApplication.h"
@@ -43,9 +44,15 @@ class SemiautomaticSegmentation : public Tool {
 
     std::optional<std::size_t> mHoveredTriangleId = {};
     std::unordered_map<std::size_t, std::size_t> mStartingTriangles;
-    std::vector<glm::vec4> mBackupColorBuffer = {};
+    /// Override face colors with the seeds but without the spread
+    std::vector<Geometry::ColorIndex> mBackupFaceColors = {};
     std::unordered_map<std::size_t, std::vector<std::size_t>> mCurrentColoring = {};
 
+    /// Flood of the SDF values from mStartingTriangles, kept while the seeds are added so the spread only
+    /// thresholds it. Built again when the SDF values of the geometry change.
+    std::unique_ptr<SdfRegionFlood> mRegionFlood;
+    size_t mRegionFloodSdfVersion = 0;
+
     float mBucketSpread = 0.0f;
     float mBucketSpreadLatest = 0.0f;
 
@@ -71,9 +78,6 @@ class SemiautomaticSegmentation : public Tool {
     std::unordered_map<std::size_t, std::vector<std::size_t>> collectTrianglesByColor(
         const std::unordered_map<std::size_t, std::size_t>& sourceTriangles);
     void spreadColors();
-    bool postprocess(const std::unordered_map<std::size_t, std::vector<double>>& sdfValuesPerColor);
-    size_t findClosestColorFromSDF(const size_t triangle, const size_t color1, const size_t color2,
-                                   const std::unordered_map<std::size_t, std::vector<double>>& sdfValuesPerColor);
 
     /// A segmentation criterion that stops when angles of normals are too different
     struct NormalStopping {
@@ -83,10 +87,7 @@ class SemiautomaticSegmentation : public Tool {
         NormalStopping(const Geometry* g, const double thresh) : geo(g), threshold(thresh) {}
 
         bool operator()(const size_t a, const size_t b) const {
-            double cosAngle = 0.0;
-            const auto& newNormal1 = geo->getTriangle(a).getNormal();
-            const auto& newNormal2 = geo->getTriangle(b).getNormal();
-            cosAngle = glm::dot(glm::normalize(newNormal1), glm::normalize(newNormal2));
+            const double cosAngle = geo->getNeighbourCosine(a, b);
 
             if(cosAngle < threshold) {
                 return false;
@@ -95,62 +96,5 @@ class SemiautomaticSegmentation : public Tool {
             }
         }
     };
-
-    /// A segmentation criterion that stops when SDF values are too different
-    struct SDFStopping {
-        const Geometry* const geo;
-        double maximumDifference;
-        bool areEdgesHard;
-        std::vector<double> initialValues;
-        std::unordered_map<std::size_t, std::size_t> triangleToBestRegion;
-
-        SDFStopping(const Geometry* const g, const std::vector<double> initialVals, const double maxDiff,
-                    const std::unordered_map<std::size_t, std::size_t> triangleToRegion, bool hardEdges)
-            : geo(g),
-              maximumDifference(maxDiff),
-              areEdgesHard(hardEdges),
-              initialValues(initialVals),
-              triangleToBestRegion(triangleToRegion) {
-            std::sort(initialValues.begin(), initialValues.end());
-        }
-
-        bool operator()(const size_t neighbour, const size_t current) const {
-            assert(geo->isSdfComputed());
-            if(!geo->isSdfComputed()) {
-                return false;
-            }
-
-            if(areEdgesHard) {
-                auto findCurrent = triangleToBestRegion.find(current);
-                assert(findCurrent != triangleToBestRegion.end());
-                auto findNeighbour = triangleToBestRegion.find(neighbour);
-                assert(findNeighbour != triangleToBestRegion.end());
-                if(findCurrent->second != findNeighbour->second) {
-                    return false;
-                }
-            }
-
-            const double sdfNeighbour = geo->getSdfValue(neighbour);
-            const auto initialSdfValue = std::lower_bound(initialValues.begin(), initialValues.end(), sdfNeighbour);
-            double closest1 = -1;
-            double closest2 = -1;
-            if(initialSdfValue == initialValues.end()) {
-                closest1 = closest2 = initialValues.back();
-            } else {
-                closest1 = *initialSdfValue;
-                if(*initialSdfValue == initialValues.front()) {
-                    closest2 = *initialSdfValue;
-                } else {
-                    closest2 = *(initialSdfValue - 1);
-                }
-            }
-            if((abs(sdfNeighbour - closest1) < maximumDifference) ||
-               (abs(sdfNeighbour - closest2) < maximumDifference)) {
-                return true;
-            } else {
-                return false;
-            }
-        }
-    };
 };
 }  // namespace pepr3d
\ No newline at end of file
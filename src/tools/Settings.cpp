@@ -1,5 +1,11 @@
 #include "Settings.h"
 
+#include <algorithm>
+#include <fstream>
+
+#include "Profiler.h"
+#include "commands/SessionRecording.h"
+#include "geometry/ImportCache.h"
 #include "ui/MainApplication.h"
 #include "ui/ModelView.h"
 
@@ -8,6 +14,8 @@ namespace pepr3d {
 void Settings::drawToSidePane(SidePane& sidePane) {
     mColorPaletteCategory.draw(sidePane, [&sidePane, this]() { sidePane.drawColorPalette("", true); });
     mUiCategory.draw(sidePane, [&sidePane, this]() { drawUiSettings(sidePane); });
+    mImportCacheCategory.draw(sidePane, [&sidePane, this]() { drawImportCacheSettings(sidePane); });
+    mDiagnosticsCategory.draw(sidePane, [&sidePane, this]() { drawDiagnosticsSettings(sidePane); });
 }
 
 void Settings::drawUiSettings(SidePane& sidePane) {
@@ -18,6 +26,148 @@ void Settings::drawUiSettings(SidePane& sidePane) {
         mApplication.resize();
     }
     sidePane.drawTooltipOnHover("Adjust the width of the side pane.");
+
+    int idleFrameRate = mApplication.getIdleFrameRate();
+    if(sidePane.drawIntDragger("Idle frame rate", idleFrameRate, 0.1f, 0, 60, idleFrameRate > 0 ? "%.0f fps" : "Off",
+                               60.0f)) {
+        mApplication.setIdleFrameRate(idleFrameRate);
+    }
+    sidePane.drawTooltipOnHover(
+        "Limit the frame rate while nothing changes, to lower the load of the computer. Off renders continuously.");
+
+    ::ThreadPool& threadPool = MainApplication::getThreadPool();
+    const int workerCount = static_cast<int>(std::max<size_t>(1, threadPool.size()));
+    int backgroundThreads = static_cast<int>(std::min<size_t>(threadPool.get_background_limit(), workerCount));
+    if(sidePane.drawIntDragger("Background threads", backgroundThreads, 0.05f, 1, workerCount, "%.0f", 60.0f)) {
+        threadPool.set_background_limit(static_cast<size_t>(backgroundThreads));
+    }
+    sidePane.drawTooltipOnHover(
+        "Limit the threads used by long jobs, like saving, loading or computing the SDF, so that painting stays "
+        "responsive while they run. Painting always goes before them.");
+
+    sidePane.drawCheckbox("Precompute while idle", mApplication.isWarmUpEnabled(),
+                          [this](const bool isChecked) { mApplication.setWarmUpEnabled(isChecked); });
+    sidePane.drawTooltipOnHover(
+        "Build the detailed mesh for the bucket painting and the export in the background threads once nothing "
+        "happens for a few seconds, so that the tools are ready when selected. Any input pauses it, but a click "
+        "or a stroke is ignored if a step takes longer than a moment to pause.");
+
+    if(mApplication.isWarmUpEnabled()) {
+        sidePane.drawCheckbox("Precompute the SDF while idle", mApplication.isSdfWarmUpEnabled(),
+                              [this](const bool isChecked) { mApplication.setSdfWarmUpEnabled(isChecked); });
+        sidePane.drawTooltipOnHover(
+            "Compute the shape diameter function for the segmentation as well. It cannot be paused, the tools "
+            "ignore any input until it finishes.");
+    }
+
+    if(mApplication.isSdfGpuAvailable()) {
+        sidePane.drawCheckbox("Compute the SDF on the GPU", mApplication.isSdfComputedOnGpu(),
+                              [this](const bool isChecked) { mApplication.setSdfComputedOnGpu(isChecked); });
+        sidePane.drawTooltipOnHover(
+            "Trace the rays of the shape diameter function with compute shaders, which is faster on most "
+            "graphics cards. Without them, the rays are traced by the background threads.");
+    }
+}
+
+void Settings::drawImportCacheSettings(SidePane& sidePane) {
+    ImportCache& importCache = *mApplication.getImportCache();
+    int maxMegabytes = static_cast<int>(importCache.getMaxBytes() >> 20);
+    if(sidePane.drawIntDragger("Cache size", maxMegabytes, 16.0f, 0, 65536, maxMegabytes > 0 ? "%.0f MB" : "Off",
+                               60.0f)) {
+        importCache.setMaxBytes(static_cast<uint64_t>(maxMegabytes) << 20);
+    }
+    sidePane.drawTooltipOnHover(
+        "Imported models are stored with their computed data, importing the same file again skips the import and "
+        "the computations. Once the cache is larger, the models stored first are removed. Off imports every time.");
+
+    if(sidePane.drawButton("Clear import cache")) {
+        importCache.clear();
+    }
+    sidePane.drawTooltipOnHover("Remove all models stored in " + importCache.getDirectory().string() + ".");
+}
+
+void Settings::drawDiagnosticsSettings(SidePane& sidePane) {
+    sidePane.drawCheckbox("Record performance trace", Profiler::isTracing(), [this](bool isChecked) {
+        if(isChecked) {
+            Profiler::startTrace();
+        } else {
+            Profiler::stopTrace();
+            saveTrace();
+        }
+    });
+    sidePane.drawTooltipOnHover(
+        "Record the timeline of the operations and background threads. When the recording is stopped, it can be "
+        "saved and opened in Perfetto or chrome://tracing.");
+
+    sidePane.drawCheckbox("Record painting session", mApplication.isRecordingSession(), [this](bool isChecked) {
+        // Commands of a running operation may be executed on a worker thread
+        if(mApplication.isOperationInProgress()) {
+            return;
+        }
+        if(isChecked) {
+            mApplication.startSessionRecording();
+        } else {
+            saveSessionRecording(mApplication.stopSessionRecording());
+        }
+    });
+    sidePane.drawTooltipOnHover(
+        "Record the painting commands, undos and redos on the current model. When the recording is stopped, it can "
+        "be saved and replayed on the same model with pepr3d_bench --replay, which measures each command.");
+}
+
+void Settings::saveTrace() {
+    mApplication.dispatchAsync([this]() {
+        cinder::fs::path initialPath = ci::getDocumentsDirectory();
+        auto path = mApplication.getSaveFilePath(initialPath.append("trace.json"), {"json"});
+        if(path.empty()) {
+            return;
+        }
+        if(path.extension() == "") {
+            path.replace_extension(".json");
+        }
+
+        std::ofstream os(path.string());
+        if(!os.is_open()) {
+            const std::string errorCaption = "Error: Failed to save the performance trace";
+            const std::string errorDescription =
+                "The file you selected to save into could not be opened for saving. Make sure you have write "
+                "permissions to the directory or files you are saving to.\n";
+            mApplication.pushDialog(Dialog(DialogType::Error, errorCaption, errorDescription, "OK"));
+            return;
+        }
+        Profiler::writeTrace(os);
+        CI_LOG_I("Saved a performance trace into " + path.string());
+    });
+}
+
+void Settings::saveSessionRecording(std::shared_ptr<SessionRecorder> recorder) {
+    if(recorder == nullptr) {
+        return;
+    }
+    mApplication.dispatchAsync([recorder, this]() {
+        cinder::fs::path initialPath = ci::getDocumentsDirectory();
+        auto path = mApplication.getSaveFilePath(initialPath.append("session.json"), {"json"});
+        if(path.empty()) {
+            return;
+        }
+        if(path.extension() == "") {
+            path.replace_extension(".json");
+        }
+
+        std::ofstream os(path.string());
+        if(!os.is_open()) {
+            const std::string errorCaption = "Error: Failed to save the painting session";
+            const std::string errorDescription =
+                "The file you selected to save into could not be opened for saving. Make sure you have write "
+                "permissions to the directory or files you are saving to.\n";
+            mApplication.pushDialog(Dialog(DialogType::Error, errorCaption, errorDescription, "OK"));
+            return;
+        }
+        const SessionRecording recording = recorder->getRecording();
+        recording.save(os);
+        CI_LOG_I("Saved a painting session of " + std::to_string(recording.getEntries().size()) + " commands into " +
+                 path.string());
+    });
 }
 
 }  // namespace pepr3d
\ No newline at end of file
@@ -1,19 +1,27 @@
 #pragma once
+#include <memory>
 #include "tools/Tool.h"
 #include "ui/IconsMaterialDesign.h"
 #include "ui/SidePane.h"
 
 namespace pepr3d {
+class SessionRecorder;
 
 /// Tool used for configuring the color palette and application
 class Settings : public Tool {
     MainApplication& mApplication;
     SidePane::Category mColorPaletteCategory;
     SidePane::Category mUiCategory;
+    SidePane::Category mImportCacheCategory;
+    SidePane::Category mDiagnosticsCategory;
 
    public:
     Settings(MainApplication& app)
-        : mApplication(app), mColorPaletteCategory("Edit Color Palette", true), mUiCategory("User Interface", true) {}
+        : mApplication(app),
+          mColorPaletteCategory("Edit Color Palette", true),
+          mUiCategory("User Interface", true),
+          mImportCacheCategory("Import Cache"),
+          mDiagnosticsCategory("Diagnostics") {}
 
     virtual std::string getName() const override {
         return "Settings";
@@ -34,5 +42,16 @@ class Settings : public Tool {
     virtual void drawToSidePane(SidePane& sidePane) override;
 
     void drawUiSettings(SidePane& sidePane);
+
+    void drawImportCacheSettings(SidePane& sidePane);
+
+    void drawDiagnosticsSettings(SidePane& sidePane);
+
+   private:
+    /// Asks for a file to save the last recorded performance trace into
+    void saveTrace();
+
+    /// Asks for a file to save the recorded painting session into
+    void saveSessionRecording(std::shared_ptr<SessionRecorder> recorder);
 };
 }  // namespace pepr3d
@@ -1,58 +1,98 @@
 #include "tools/TextEditor.h"
 
 #include <exception>
-#include <glm/gtx/rotate_vector.hpp>
+#include <numeric>
+#include <stdexcept>
 #include "commands/CmdPaintText.h"
 #include "imgui_stdlib.h"
 
 namespace pepr3d {
 
 void TextEditor::createPreviewMesh() const {
-    auto& modelView = mApplication.getModelView();
-    modelView.resetPreview();
-
+    std::vector<glm::vec3> vertices;
     for(auto& letter : mRenderedText) {
         for(auto& t : letter) {
-            modelView.previewTriangles.push_back(glm::vec3(t.a.x, t.a.y, t.a.z));
-            modelView.previewTriangles.push_back(glm::vec3(t.b.x, t.b.y, t.b.z));
-            modelView.previewTriangles.push_back(glm::vec3(t.c.x, t.c.y, t.c.z));
+            vertices.push_back(glm::vec3(t.a.x, t.a.y, t.a.z));
+            vertices.push_back(glm::vec3(t.b.x, t.b.y, t.b.z));
+            vertices.push_back(glm::vec3(t.c.x, t.c.y, t.c.z));
         }
     }
 
-    const size_t triangleCount = static_cast<uint32_t>(modelView.previewTriangles.size());
+    const size_t vertexCount = vertices.size();
 
-    for(size_t i = 0; i < triangleCount; ++i) {
-        modelView.previewIndices.push_back(static_cast<uint32_t>(i));
-    }
+    std::vector<uint32_t> indices(vertexCount);
+    std::iota(indices.begin(), indices.end(), 0);
 
-    for(size_t i = 0; i < triangleCount; ++i) {
-        modelView.previewNormals.push_back(glm::vec3(1, 1, 0));
-    }
+    std::vector<glm::vec3> normals(vertexCount, glm::vec3(1, 1, 0));
 
     const auto currentColor = mApplication.getCurrentGeometry()->getColorManager().getActiveColor();
+    std::vector<glm::vec4> colors(vertexCount, currentColor);
 
-    for(uint32_t i = 0; i < triangleCount; ++i) {
-        modelView.previewColors.push_back(currentColor);
-    }
+    mApplication.getModelView().setPreview(std::move(vertices), std::move(normals), std::move(indices),
+                                           std::move(colors));
 }
 
-std::vector<std::vector<FontRasterizer::Tri>> TextEditor::triangulateText() const {
-    try {
-        if(mFontPath == "") {
-            return {};
+TextEditor::TextSettings TextEditor::getTextSettings() const {
+    return {mFontPath, mText, mFontSize, mBezierSteps};
+}
+
+void TextEditor::requestTriangulation() {
+    const TextSettings settings = getTextSettings();
+    if(mTriangulation) {
+        // The rasterizer is in use, the current settings are requested again once the worker stops
+        if(!(mTriangulation->settings == settings)) {
+            *mTriangulation->isCancelled = true;
         }
+        return;
+    }
+    if(mTriangulatedSettings && *mTriangulatedSettings == settings) {
+        return;
+    }
+    if(settings.fontPath == "") {
+        mTriangulatedText.clear();
+        mTriangulatedSettings = settings;
+        return;
+    }
+
+    if(!mFontRasterizer || mFontRasterizer->getCurrentFont() != settings.fontPath) {
+        mFontRasterizer = std::make_shared<FontRasterizer>(settings.fontPath);
+    }
+    auto isCancelled = std::make_shared<std::atomic<bool>>(false);
+    auto triangles =
+        MainApplication::getThreadPool().enqueue([fontRasterizer = mFontRasterizer, settings, isCancelled]() {
+            if(!fontRasterizer->isValid()) {
+                throw std::runtime_error("Failed to load the font " + settings.fontPath);
+            }
+            return fontRasterizer->rasterizeText(settings.text, settings.fontSize, settings.bezierSteps,
+                                                 isCancelled.get(), &MainApplication::getThreadPool());
+        });
+    mTriangulation = TriangulationRequest{settings, std::move(isCancelled), std::move(triangles)};
+}
 
-        FontRasterizer fontTriangulate(mFontPath);
-        P_ASSERT(fontTriangulate.isValid());
+void TextEditor::finishTriangulation() {
+    P_ASSERT(mTriangulation);
+    TriangulationRequest triangulation = std::move(*mTriangulation);
+    mTriangulation.reset();
 
-        std::vector<std::vector<pepr3d::FontRasterizer::Tri>> result =
-            fontTriangulate.rasterizeText(mText, mFontSize, mBezierSteps);
+    if(*triangulation.isCancelled) {
+        requestTriangulation();
+        return;
+    }
 
-        CI_LOG_I("Text triangulated, " + std::to_string(result.size()) + " letters.");
-        return result;
+    try {
+        mTriangulatedText = triangulation.triangles.get();
+        CI_LOG_I("Text triangulated, " + std::to_string(mTriangulatedText.size()) + " letters.");
     } catch(const std::exception& e) {
         CI_LOG_E(e.what());
-        return {};
+        mTriangulatedText.clear();
+    }
+    mTriangulatedSettings = triangulation.settings;
+    updateTextPreview();
+}
+
+void TextEditor::onUpdate(ModelView& modelView) {
+    if(mTriangulation && mTriangulation->triangles.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        finishTriangulation();
     }
 }
 
@@ -64,24 +104,12 @@ void TextEditor::rotateText(std::vector<std::vector<FontRasterizer::Tri>>& text)
     Geometry* geometry = mApplication.getCurrentGeometry();
 
     const glm::vec3 direction = glm::normalize(-geometry->getTriangle(*mSelectedIntersection).getNormal());
-    const glm::vec3 origin = getPreviewOrigin(direction);
-    const glm::vec3 planeBase1 = getPlaneBaseVector(direction);
-    const glm::vec3 planeBase2 = glm::cross(planeBase1, direction);
-
-    glm::mat3 rotationMat(planeBase1, planeBase2, direction);
-
-    for(auto& letter : text) {
-        for(auto& tri : letter) {
-            tri.a = origin + rotationMat * tri.a;
-            tri.b = origin + rotationMat * tri.b;
-            tri.c = origin + rotationMat * tri.c;
-        }
-    }
+    FontRasterizer::placeText(text, getPreviewOrigin(direction), direction, mTextRotation);
 }
 
 void TextEditor::generateAndUpdate() {
-    mTriangulatedText = triangulateText();
     updateTextPreview();
+    requestTriangulation();
 }
 
 void TextEditor::updateTextPreview() {
@@ -96,78 +124,11 @@ void TextEditor::updateTextPreview() {
 }
 
 void TextEditor::rescaleText(std::vector<std::vector<FontRasterizer::Tri>>& result) {
-    for(auto& letter : result) {
-        for(auto& t : letter) {
-            t.a *= mFontScale;
-            t.b *= mFontScale;
-            t.c *= mFontScale;
-        }
-    }
-
-    std::pair<float, float> max = {std::numeric_limits<float>::min(), std::numeric_limits<float>::min()};
-    std::pair<float, float> min = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
-
-    auto updateMinMax = [&min, &max](glm::vec3 pt) {
-        if(pt.x > max.first) {
-            max.first = pt.x;
-        }
-        if(pt.y > max.second) {
-            max.second = pt.y;
-        }
-
-        if(pt.x < min.first) {
-            min.first = pt.x;
-        }
-        if(pt.y < min.second) {
-            min.second = pt.y;
-        }
-    };
-
-    for(auto& letter : result) {
-        for(auto& t : letter) {
-            updateMinMax(t.a);
-            updateMinMax(t.b);
-            updateMinMax(t.c);
-        }
-    }
-
-    for(auto& letter : result) {
-        for(auto& t : letter) {
-            t.a.x = t.a.x - min.first - max.first / 2.f;
-            t.a.y = t.a.y - min.second - max.second / 2.f;
-            t.a.z = 0.f;
-
-            t.b.x = t.b.x - min.first - max.first / 2.f;
-            t.b.y = t.b.y - min.second - max.second / 2.f;
-            t.b.z = 0.f;
-
-            t.c.x = t.c.x - min.first - max.first / 2.f;
-            t.c.y = t.c.y - min.second - max.second / 2.f;
-            t.c.z = 0.f;
-
-            t.a.y *= -1;
-            t.b.y *= -1;
-            t.c.y *= -1;
-        }
-    }
+    FontRasterizer::centerText(result, mFontScale);
 }
 
 glm::vec3 TextEditor::getPlaneBaseVector(const glm::vec3& direction) const {
-    P_ASSERT(glm::abs(glm::length(direction) - 1) < 0.01);  // Is normalized
-
-    const glm::vec3 upVector(0.f, 0.f, 1.f);
-
-    glm::vec3 otherDirection{};
-
-    // Test if direction is already pointing upwards or downwards
-    if(glm::abs(glm::dot(direction, upVector)) > 0.98) {
-        otherDirection = glm::vec3(1.f, 0.f, 0.f);  // World right vector
-    } else {
-        otherDirection = upVector;
-    }
-
-    const auto baseVector = glm::cross(direction, otherDirection);
-    return glm::normalize(glm::rotate(baseVector, glm::radians(mTextRotation), direction));
+    return FontRasterizer::getPlaneBaseVector(direction, mTextRotation);
 }
 
 glm::vec3 TextEditor::getPreviewOrigin(const glm::vec3& direction) const {
@@ -203,18 +164,18 @@ void TextEditor::drawToSidePane(SidePane& sidePane) {
     // -- Text settings --
 
     if(sidePane.drawIntDragger("Font size", mFontSize, 1, 10, 200, "%i", 50.f)) {
-        generateAndUpdate();
+        requestTriangulation();
     }
     sidePane.drawTooltipOnHover("Base font size in font-units.");
 
     if(sidePane.drawIntDragger("Bezier steps", mBezierSteps, 1, 1, 8, "%i", 50.f)) {
-        generateAndUpdate();
+        requestTriangulation();
     }
     sidePane.drawTooltipOnHover("\"Smoothness\" of text curves. High number of steps will increase painting times.");
 
     if(ImGui::InputText("Text", &mText)) {
         if(mSelectedIntersection) {
-            generateAndUpdate();
+            requestTriangulation();
         }
     }
     sidePane.drawTooltipOnHover("Text to paint.", "", "Click to edit.");
@@ -259,6 +220,13 @@ void TextEditor::onModelViewMouseDown(ModelView& modelView, ci::app::MouseEvent
 }
 
 void TextEditor::paintText() {
+    // Paint the text of the current settings
+    requestTriangulation();
+    while(mTriangulation) {
+        mTriangulation->triangles.wait();
+        finishTriangulation();
+    }
+
     if(mRenderedText.empty() || !mSelectedIntersection)
         return;
 
@@ -268,8 +236,8 @@ void TextEditor::paintText() {
     ci::Ray ray = mSelectedRay;
     ray.setDirection(-geometry->getTriangle(*mSelectedIntersection).getNormal());
     mApplication.enqueueSlowOperation(
-        [ray, color, this]() {
-            mApplication.getCommandManager()->execute(std::make_unique<CmdPaintText>(ray, mRenderedText, color));
+        [ray, color, renderedText = mRenderedText, this]() {
+            mApplication.getCommandManager()->execute(std::make_unique<CmdPaintText>(ray, renderedText, color));
         },
         [this]() {
             mRenderedText.clear();  // Hide the preview
@@ -280,8 +248,7 @@ void TextEditor::paintText() {
 
 void TextEditor::onModelViewMouseMove(ModelView& modelView, ci::app::MouseEvent event) {
     mCurrentRay = modelView.getRayFromWindowCoordinates(event.getPos());
-    Geometry* geometry = mApplication.getCurrentGeometry();
-    mCurrentIntersection = geometry->intersectMesh(mCurrentRay, mCurrentIntersectionPoint);
+    mCurrentIntersection = modelView.pickBaseTriangle(event.getPos(), &mCurrentIntersectionPoint);
 }
 
 void TextEditor::drawToModelView(ModelView& modelView) {
@@ -1,4 +1,8 @@
 #pragma once
+#include <atomic>
+#include <future>
+#include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -38,6 +42,7 @@ class TextEditor : public Tool {
     virtual void onModelViewMouseDown(ModelView& modelView, ci::app::MouseEvent event) override;
     virtual void onModelViewMouseMove(ModelView& modelView, ci::app::MouseEvent event) override;
     virtual void drawToModelView(ModelView& modelView) override;
+    virtual void onUpdate(ModelView& modelView) override;
 
     virtual void onToolSelect(ModelView& modelView) override {
         if(!mTriangulatedText.empty() && mSelectedIntersection) {
@@ -86,12 +91,47 @@ class TextEditor : public Tool {
     std::vector<std::vector<FontRasterizer::Tri>> mTriangulatedText;
     std::vector<std::vector<FontRasterizer::Tri>> mRenderedText;
 
-    std::vector<std::vector<FontRasterizer::Tri>> triangulateText() const;
+    /// Font, text, font size and bezier steps of a triangulation
+    struct TextSettings {
+        std::string fontPath;
+        std::string text;
+        int fontSize;
+        int bezierSteps;
+
+        bool operator==(const TextSettings& other) const {
+            return fontPath == other.fontPath && text == other.text && fontSize == other.fontSize &&
+                   bezierSteps == other.bezierSteps;
+        }
+    };
+
+    /// Triangulation of the text running on a worker thread. Newer settings cancel it, they are triangulated once the
+    /// worker stops, and the preview of the previous triangulation stays until then.
+    struct TriangulationRequest {
+        TextSettings settings;
+        std::shared_ptr<std::atomic<bool>> isCancelled;
+        std::future<std::vector<std::vector<FontRasterizer::Tri>>> triangles;
+    };
+    std::optional<TriangulationRequest> mTriangulation;
+
+    /// Settings of mTriangulatedText
+    std::optional<TextSettings> mTriangulatedSettings;
+
+    /// Rasterizer of the font, kept between the triangulations so its glyphs are triangulated only once.
+    /// Used by at most one worker at a time.
+    std::shared_ptr<FontRasterizer> mFontRasterizer;
+
+    TextSettings getTextSettings() const;
+
+    /// Triangulate the current settings on a worker thread, unless they are triangulated already
+    void requestTriangulation();
+
+    /// Take over the result of the finished mTriangulation, or request the newer settings if it was cancelled
+    void finishTriangulation();
 
     /// Update modelView's preview data with new triangles to render
     void createPreviewMesh() const;
 
-    /// Generate text and update preview
+    /// Update the preview at once and triangulate the text again if its settings changed
     void generateAndUpdate();
 
     /// Update text preview without generating again
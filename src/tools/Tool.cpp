@@ -1,6 +1,7 @@
 #include "tools/Tool.h"
 #include "geometry/SdfValuesException.h"
 #include "ui/MainApplication.h"
+#include "ui/SidePane.h"
 
 namespace pepr3d {
 
@@ -42,6 +43,86 @@ std::optional<DetailedTriangleId> Tool::safeIntersectDetailedMesh(MainApplicatio
     return hoveredTriangleId;
 }
 
+std::optional<std::size_t> Tool::safePickMesh(MainApplication& mainApplication, ModelView& modelView,
+                                              glm::ivec2 windowCoords, glm::vec3* outPosition) {
+    std::optional<std::size_t> hoveredTriangleId;
+
+    try {
+        hoveredTriangleId = modelView.pickBaseTriangle(windowCoords, outPosition);
+    } catch(...) {
+        CI_LOG_E("Mesh intersection failed.");
+        hoveredTriangleId = {};
+        pushErrorDialogCorruptedFile(mainApplication);
+    }
+    return hoveredTriangleId;
+}
+
+std::optional<DetailedTriangleId> Tool::safePickDetailedMesh(MainApplication& mainApplication, ModelView& modelView,
+                                                           glm::ivec2 windowCoords) {
+    std::optional<DetailedTriangleId> hoveredTriangleId;
+
+    try {
+        hoveredTriangleId = modelView.pickDetailedTriangle(windowCoords);
+    } catch(...) {
+        CI_LOG_E("Mesh detailed intersection failed.");
+        hoveredTriangleId = {};
+        pushErrorDialogCorruptedFile(mainApplication);
+    }
+    return hoveredTriangleId;
+}
+
+void Tool::drawSdfSettings(MainApplication& mainApplication, SidePane& sidePane) {
+    Geometry* const geometry = mainApplication.getCurrentGeometry();
+    if(geometry == nullptr) {
+        return;
+    }
+
+    SdfSettings settings = geometry->getSdfSettings();
+    float coneAngleDegrees = glm::degrees(settings.coneAngle);
+    bool hasChanged = sidePane.drawIntDragger("Rays", settings.rayCount, 0.25f, 1, 100, "%d", 70.0f);
+    sidePane.drawTooltipOnHover(
+        "Number of rays cast from each triangle. More rays give smoother results, but take longer to compute.");
+    hasChanged |= sidePane.drawFloatDragger("Cone angle", coneAngleDegrees, 0.25f, 10.0f, 170.0f, "%.0f deg", 70.0f);
+    sidePane.drawTooltipOnHover("Opening angle of the cone of rays cast from each triangle.");
+
+    // Large meshes can be computed on a simplified proxy, the values and segments are transferred back
+    if(geometry->getTriangleCount() >= Geometry::SDF_PROXY_MIN_TRIANGLES || settings.proxyTriangleCount > 0) {
+        sidePane.drawCheckbox("Simplified proxy", settings.proxyTriangleCount > 0, [&](const bool isChecked) {
+            settings.proxyTriangleCount = isChecked ? Geometry::SDF_PROXY_TRIANGLES : 0;
+            hasChanged = true;
+        });
+        sidePane.drawTooltipOnHover(
+            "Compute the SDF and the segmentation on a simplified copy of the model, much faster for large models. "
+            "The segments are refined along their borders on the full model.");
+        if(settings.proxyTriangleCount > 0) {
+            int proxyThousands = static_cast<int>(settings.proxyTriangleCount / 1000);
+            if(sidePane.drawIntDragger("Proxy size", proxyThousands, 1.0f, 10, 2000, "%dk triangles", 70.0f)) {
+                settings.proxyTriangleCount = static_cast<size_t>(proxyThousands) * 1000;
+                hasChanged = true;
+            }
+            sidePane.drawTooltipOnHover("Rough number of triangles of the simplified copy.");
+        }
+    }
+    if(hasChanged) {
+        settings.coneAngle = glm::radians(coneAngleDegrees);
+        geometry->setSdfSettings(settings);
+    }
+}
+
+void Tool::drawSdfRefinement(MainApplication& mainApplication, SidePane& sidePane) {
+    Geometry* const geometry = mainApplication.getCurrentGeometry();
+    if(geometry == nullptr || !geometry->isSdfRefining()) {
+        return;
+    }
+
+    const int percentage = static_cast<int>(100.0f * geometry->getSdfRefinementProgress());
+    sidePane.drawText("Refining SDF... " + std::to_string(percentage) + " %");
+    if(sidePane.drawButton("Stop refining")) {
+        geometry->cancelSdfRefinement();
+    }
+    sidePane.drawTooltipOnHover("Keep using the coarse SDF values computed first.");
+}
+
 bool Tool::safeComputeSdf(MainApplication& mainApplication) {
     try {
         mainApplication.getCurrentGeometry()->computeSdfValues();
@@ -51,6 +51,10 @@ class Tool {
     /// Draw to ModelView from inside this method
     virtual void drawToModelView(ModelView& modelView){};
 
+    /// Called every frame on a currently active Tool, before anything is drawn.
+    /// Not called while a slow operation is in progress, the Geometry may be changed from inside this method.
+    virtual void onUpdate(ModelView& modelView){};
+
     /// Called on a currently active Tool when users presses a mouse button over a ModelView.
     virtual void onModelViewMouseDown(ModelView& modelView, ci::app::MouseEvent event){};
 
@@ -86,7 +90,25 @@ class Tool {
     /// This method is safe and if an exception occurs, an error dialog is automatically shown.
     virtual std::optional<DetailedTriangleId> safeIntersectDetailedMesh(MainApplication& mainApplication,
                                                                         const ci::Ray ray) final;
+
+    /// Returns the base triangle under the window coordinates of the ModelView, the hit point is written to
+    /// outPosition if there is a hit and it is not null. Shares the hit with the other callers in the same frame,
+    /// see ModelView::pickBaseTriangle(). Safe like safeIntersectMesh().
+    virtual std::optional<std::size_t> safePickMesh(MainApplication& mainApplication, ModelView& modelView,
+                                                    glm::ivec2 windowCoords, glm::vec3* outPosition = nullptr) final;
+
+    /// Returns the DetailedTriangleId rendered under the window coordinates of the ModelView.
+    /// Reads the picking buffer of the ModelView when possible, falls back to a ray cast, and shares the result with
+    /// the other callers in the same frame, see ModelView::pickDetailedTriangle(). Safe like safeIntersectMesh().
+    virtual std::optional<DetailedTriangleId> safePickDetailedMesh(MainApplication& mainApplication,
+                                                                   ModelView& modelView, glm::ivec2 windowCoords) final;
     virtual bool safeComputeSdf(MainApplication& mainApplication) final;
+
+    /// Draws the quality settings of the SDF computation of the current Geometry to the SidePane
+    virtual void drawSdfSettings(MainApplication& mainApplication, SidePane& sidePane) final;
+
+    /// Draws the progress of the background refinement of the SDF values with a button to stop it, if running
+    virtual void drawSdfRefinement(MainApplication& mainApplication, SidePane& sidePane) final;
 };
 
 }  // namespace pepr3d
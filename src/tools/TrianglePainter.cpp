@@ -23,6 +23,10 @@ void TrianglePainter::onModelViewMouseDown(ModelView& modelView, ci::app::MouseE
         return;
     }
     mLastClick = event.getPos();
+    paintHoveredTriangle();
+}
+
+void TrianglePainter::paintHoveredTriangle() {
     if(!mHoveredTriangleId) {
         return;
     }
@@ -35,18 +39,22 @@ void TrianglePainter::onModelViewMouseDown(ModelView& modelView, ci::app::MouseE
     const auto activeColor = geometry->getColorManager().getActiveColorIndex();
     if(geometry->getTriangleColor(*mHoveredTriangleId) != activeColor ||
        !geometry->isSimpleTriangle(*mHoveredTriangleId)) {
-        CommandManager<Geometry>* const commandManager = mApplication.getCommandManager();
-        commandManager->execute(std::make_unique<CmdPaintSingleColor>(*mHoveredTriangleId, activeColor),
-                                mGroupCommands);
-        mGroupCommands = true;
+        paintInStroke(*geometry, *mHoveredTriangleId, activeColor);
     }
 }
 
 void TrianglePainter::onModelViewMouseUp(ModelView& modelView, ci::app::MouseEvent event) {
-    mGroupCommands = false;
+    endStroke();
 }
 
 void TrianglePainter::onModelViewMouseDrag(ModelView& modelView, ci::app::MouseEvent event) {
+    // Triangles under the drags coalesced into this one are painted as well, the stroke has no gaps
+    if(event.isLeftDown() && mApplication.getCurrentGeometry() != nullptr) {
+        for(const glm::ivec2 position : modelView.getCoalescedDragPositions()) {
+            mHoveredTriangleId = safePickMesh(mApplication, modelView, position);
+            paintHoveredTriangle();
+        }
+    }
     onModelViewMouseMove(modelView, event);
     onModelViewMouseDown(modelView, event);
 }
@@ -58,11 +66,50 @@ void TrianglePainter::onModelViewMouseMove(ModelView& modelView, ci::app::MouseE
         mHoveredTriangleId = {};
         return;
     }
-    mHoveredTriangleId = safeIntersectMesh(mApplication, mLastRay);
+    mHoveredTriangleId = safePickMesh(mApplication, modelView, event.getPos());
+}
+
+void TrianglePainter::onToolDeselect(ModelView& modelView) {
+    endStroke();
 }
 
 void TrianglePainter::onNewGeometryLoaded(ModelView& modelView) {
     mHoveredTriangleId = {};
+    // The stroke was made on the previous geometry, it is discarded with its command manager
+    mStrokeTriangleIds.clear();
+    mStrokeColorId = {};
+}
+
+void TrianglePainter::paintInStroke(Geometry& geometry, const size_t triangleId, const size_t colorId) {
+    CommandManager<Geometry>* const commandManager = mApplication.getCommandManager();
+    if(mStrokeColorId && (*mStrokeColorId != colorId || !commandManager->isStrokeInProgress())) {
+        endStroke();
+    }
+    if(!mStrokeColorId) {
+        mStrokeColorId = colorId;
+        // Also called by the command manager when it executes, undoes or redoes a command during the stroke
+        commandManager->beginStroke([this, &geometry]() {
+            // Only after all triangles are painted, as CmdPaintSingleColor does
+            geometry.compactTriangleDetails();
+            std::vector<size_t> triangleIds;
+            triangleIds.swap(mStrokeTriangleIds);
+            const size_t strokeColorId = *mStrokeColorId;
+            mStrokeColorId = {};
+            return std::make_unique<CmdPaintSingleColor>(std::move(triangleIds), strokeColorId);
+        });
+    }
+
+    geometry.setTriangleColor(triangleId, colorId);
+    mStrokeTriangleIds.push_back(triangleId);
+}
+
+void TrianglePainter::endStroke() {
+    CommandManager<Geometry>* const commandManager = mApplication.getCommandManager();
+    if(mStrokeColorId && commandManager != nullptr && commandManager->isStrokeInProgress()) {
+        commandManager->endStroke();
+    }
+    mStrokeTriangleIds.clear();
+    mStrokeColorId = {};
 }
 
 }  // namespace pepr3d
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include <optional>
+#include <vector>
 #include "commands/CommandManager.h"
 #include "tools/Tool.h"
 #include "ui/IconsMaterialDesign.h"
@@ -37,14 +38,27 @@ class TrianglePainter : public Tool {
     virtual void onModelViewMouseUp(ModelView& modelView, ci::app::MouseEvent event) override;
     virtual void onModelViewMouseDrag(ModelView& modelView, ci::app::MouseEvent event) override;
     virtual void onModelViewMouseMove(ModelView& modelView, ci::app::MouseEvent event) override;
+    virtual void onToolDeselect(ModelView& modelView) override;
     virtual void onNewGeometryLoaded(ModelView& modelView) override;
 
    private:
+    /// Paint mHoveredTriangleId with the active color in the stroke, if it is set and not painted with it yet
+    void paintHoveredTriangle();
+
+    /// Paint the triangle in the stroke of this color, beginning a new stroke if there is none.
+    /// The stroke only patches the color buffers, it is saved as a single command by endStroke().
+    void paintInStroke(Geometry& geometry, size_t triangleId, size_t colorId);
+
+    /// Save the triangles painted by the stroke as a single command, if there is a stroke
+    void endStroke();
+
     MainApplication& mApplication;
     glm::vec2 mLastClick;
     ci::Ray mLastRay;
 
-    bool mGroupCommands = false;
+    /// Triangles painted by the current stroke and their color, empty if there is no stroke
+    std::vector<size_t> mStrokeTriangleIds;
+    std::optional<size_t> mStrokeColorId;
     std::optional<std::size_t> mHoveredTriangleId = {};
 };
 }  // namespace pepr3d
@@ -0,0 +1,63 @@
+#include "GpuTimer.h"
+
+#include <cinder/gl/Context.h>
+
+namespace pepr3d {
+
+GpuTimer::~GpuTimer() {
+    // The queries are gone with the context
+    if(ci::gl::context() == nullptr) {
+        return;
+    }
+    end();
+    for(const Query& query : mPendingQueries) {
+        mFreeQueries.push_back(query.id);
+    }
+    if(!mFreeQueries.empty()) {
+        glDeleteQueries(static_cast<GLsizei>(mFreeQueries.size()), mFreeQueries.data());
+    }
+}
+
+void GpuTimer::begin(const Profiler::Zone zone) {
+    end();
+    if(mPendingQueries.size() >= MAX_PENDING_QUERIES) {
+        return;
+    }
+
+    if(mFreeQueries.empty()) {
+        GLuint id = 0;
+        glGenQueries(1, &id);
+        mFreeQueries.push_back(id);
+    }
+    mActiveQuery = Query{mFreeQueries.back(), zone};
+    mFreeQueries.pop_back();
+    glBeginQuery(GL_TIME_ELAPSED, mActiveQuery->id);
+}
+
+void GpuTimer::end() {
+    if(!mActiveQuery) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    mPendingQueries.push_back(*mActiveQuery);
+    mActiveQuery.reset();
+}
+
+void GpuTimer::collectResults() {
+    while(!mPendingQueries.empty()) {
+        const Query& query = mPendingQueries.front();
+        GLint isAvailable = GL_FALSE;
+        glGetQueryObjectiv(query.id, GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+        if(isAvailable == GL_FALSE) {
+            return;
+        }
+
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &nanoseconds);
+        Profiler::record(query.zone, static_cast<double>(nanoseconds) / 1e6);
+        mFreeQueries.push_back(query.id);
+        mPendingQueries.pop_front();
+    }
+}
+
+}  // namespace pepr3d
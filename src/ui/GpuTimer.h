@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cinder/gl/gl.h>
+
+#include <deque>
+#include <optional>
+#include <vector>
+
+#include "Profiler.h"
+
+namespace pepr3d {
+
+/// Measures the GPU time of the drawing passes with GL_TIME_ELAPSED queries and records it into the Profiler zones.
+/// The results are collected frames later, once the GPU has finished the passes, so the measurement never waits for
+/// the GPU. The queries cannot nest, only one pass is measured at a time.
+class GpuTimer {
+   public:
+    /// Measures the commands issued during its lifetime
+    class Scope {
+       public:
+        Scope(GpuTimer& timer, Profiler::Zone zone) : mTimer(timer) {
+            mTimer.begin(zone);
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        ~Scope() {
+            mTimer.end();
+        }
+
+       private:
+        GpuTimer& mTimer;
+    };
+
+    GpuTimer() = default;
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+    ~GpuTimer();
+
+    /// Starts measuring the zone, a pass already being measured is ended first
+    void begin(Profiler::Zone zone);
+
+    /// Ends the measured pass, if any
+    void end();
+
+    /// Records the results of the finished passes into their zones, once per frame with the context current
+    void collectResults();
+
+    /// Passes waiting for their results, later passes are not measured until the GPU catches up
+    static constexpr size_t MAX_PENDING_QUERIES = 64;
+
+   private:
+    struct Query {
+        GLuint id;
+        Profiler::Zone zone;
+    };
+
+    /// Queries whose results were read, reused by begin()
+    std::vector<GLuint> mFreeQueries;
+
+    /// Ended queries in the order of their passes, the GPU finishes them in the same order
+    std::deque<Query> mPendingQueries;
+
+    std::optional<Query> mActiveQuery;
+};
+
+}  // namespace pepr3d
@@ -9,6 +9,9 @@
 #pragma warning(pop)
 #endif
 #include <cereal/types/memory.hpp>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
 
 #include "ui/MainApplication.h"
 
@@ -16,8 +19,13 @@
 #include "IconsMaterialDesign.h"
 #include "LightTheme.h"
 
+#include "commands/Autosave.h"
 #include "commands/ExampleCommand.h"
+#include "commands/SessionRecording.h"
 #include "geometry/Geometry.h"
+#include "geometry/ImportCache.h"
+#include "geometry/ProjectFile.h"
+#include "geometry/SdfGpuCalculator.h"
 
 #include "tools/Brush.h"
 #include "tools/DisplayOptions.h"
@@ -41,12 +49,55 @@ using namespace ci::app;
 using namespace std;
 
 namespace pepr3d {
-// At least 2 threads in thread pool must be created!
-// There are several occasions in which we enqueue a new task from inside a thread pool.
-// If there was only 1 thread in the pool, the tasks would never finish causing a deadlock.
+// We enqueue new tasks from inside the thread pool on several occasions. Waiting for them through
+// ThreadPool::wait() or parallel_for() executes pending tasks meanwhile, so even a single thread cannot deadlock.
+// Keep at least 2 threads, so that a slow operation does not stall the short tasks enqueued from the main thread.
 // Note: std::thread::hardware_concurrency() may return 0
 ::ThreadPool MainApplication::sThreadPool(std::max<size_t>(3, std::thread::hardware_concurrency()) - 1);
 
+namespace {
+/// Seconds of the full frame rate after a redraw request, so that ImGui settles and the input feels responsive
+const double REDRAW_DURATION = 1.0;
+
+/// Limit of the frame rate while the window is not focused
+const float UNFOCUSED_FRAME_RATE = 24.0f;
+
+/// Input wakes the application up before ImGui or the ModelView handle the event and stop its propagation
+const int REDRAW_SIGNAL_PRIORITY = 1;
+
+/// Seconds without any input before the warm-up starts computing the derived data of the Geometry
+const double WARM_UP_IDLE_DELAY = 3.0;
+
+/// Longest wait of an input for the cancelled warm-up, a warm-up step that does not stop by then finishes on its own
+/// and the tools ignore the input until it does
+const std::chrono::milliseconds WARM_UP_PREEMPTION_TIMEOUT(100);
+
+/// Default size limit of the import cache
+const uint64_t IMPORT_CACHE_MAX_BYTES = uint64_t(2) << 30;
+
+/// Writes the project into a temporary file next to the path first and then replaces the file by it, so that a failed
+/// save keeps the previous project. Throws if it fails.
+void writeProjectFile(const std::shared_ptr<const Geometry::ProjectSnapshot>& snapshot, const fs::path& path) {
+    fs::path temporaryPath = path;
+    temporaryPath += ".saving";
+    try {
+        std::ofstream os(temporaryPath.string(), std::ios::binary);
+        if(!os.is_open()) {
+            throw std::runtime_error("Could not open " + temporaryPath.string());
+        }
+        ProjectFile::write(os, *snapshot, MainApplication::getThreadPool());
+        os.close();
+        if(!os) {
+            throw std::runtime_error("Could not write " + temporaryPath.string());
+        }
+        fs::rename(temporaryPath, path);
+    } catch(const std::exception&) {
+        std::remove(temporaryPath.string().c_str());
+        throw;
+    }
+}
+}  // namespace
+
 MainApplication::MainApplication() : mFontStorage{}, mToolbar(*this), mSidePane(*this), mModelView(*this) {}
 
 void MainApplication::setup() {
@@ -63,33 +114,44 @@ void MainApplication::setup() {
     getSignalWillResignActive().connect(bind(&MainApplication::willResignActive, this));
     getSignalDidBecomeActive().connect(bind(&MainApplication::didBecomeActive, this));
 
+    const auto window = getWindow();
+    const auto onMouseEvent = [this](MouseEvent&) { onInput(); };
+    const auto onKeyEvent = [this](KeyEvent&) { onInput(); };
+    window->getSignalMouseDown().connect(REDRAW_SIGNAL_PRIORITY, onMouseEvent);
+    window->getSignalMouseUp().connect(REDRAW_SIGNAL_PRIORITY, onMouseEvent);
+    window->getSignalMouseDrag().connect(REDRAW_SIGNAL_PRIORITY, onMouseEvent);
+    window->getSignalMouseMove().connect(REDRAW_SIGNAL_PRIORITY, onMouseEvent);
+    window->getSignalMouseWheel().connect(REDRAW_SIGNAL_PRIORITY, onMouseEvent);
+    window->getSignalKeyDown().connect(REDRAW_SIGNAL_PRIORITY, onKeyEvent);
+    window->getSignalKeyUp().connect(REDRAW_SIGNAL_PRIORITY, onKeyEvent);
+    window->getSignalFileDrop().connect(REDRAW_SIGNAL_PRIORITY, [this](FileDropEvent&) { onInput(); });
+    window->getSignalResize().connect(REDRAW_SIGNAL_PRIORITY, [this]() { onInput(); });
+
     mImGui.setup(this, getWindow());
     mFramebuffer = ci::gl::Fbo::create(initialResolution.x, initialResolution.y);
     mImGui.useFramebuffer(mFramebuffer);
+    mImGui.setRenderObserver([this](const bool started) {
+        if(started) {
+            mGpuTimer.begin(Profiler::Zone::GpuImGui);
+        } else {
+            mGpuTimer.end();
+        }
+    });
 
     applyLightTheme(ImGui::GetStyle());
 
-    // Uncomment the following lines to save mHotkeys on startup
-    // (only useful for updating the .json file after a change in hotkeys):
-    // mHotkeys.loadDefaults();
-    // saveHotkeysToFile((getAssetPath("") / "hotkeys.json").string());
-    try {
-        loadHotkeysFromFile(getAssetPath("hotkeys.json").string());
-    } catch(const cereal::Exception&) {
-        CI_LOG_I("Failed to load hotkeys from hotkeys.json, using default hotkeys");
-        mHotkeys.loadDefaults();
-    }
-
-    mGeometry = std::make_shared<Geometry>();
+    Geometry::setThreadPool(sThreadPool);
+    // Work started by the UI thread, e.g., painting, goes before the background jobs, which are enqueued as such
+    ::ThreadPool::set_thread_priority(::ThreadPool::priority::interactive);
 
+    // The SDF rays are traced with compute shaders on a context shared with the window, if it supports them
     try {
-        mGeometry->loadNewGeometry(getRequiredAssetPath("models/defaultcube.stl").string());
+        mSdfGpuCalculator = SdfGpuCalculator::create(loadString(loadRequiredAsset("shaders/SdfRays.comp")));
+        Geometry::setSdfGpuCalculator(mSdfGpuCalculator);
     } catch(const AssetNotFoundException&) {
         // do nothing, a Fatal Error dialog has already been created
     }
 
-    mCommandManager = std::make_unique<CommandManager<Geometry>>(*mGeometry);
-
     mTools.emplace_back(make_unique<TrianglePainter>(*this));
     mTools.emplace_back(make_unique<PaintBucket>(*this));
     mTools.emplace_back(make_unique<Brush>(*this));
@@ -98,24 +160,74 @@ void MainApplication::setup() {
     mTools.emplace_back(make_unique<SemiautomaticSegmentation>(*this));
     mTools.emplace_back(make_unique<DisplayOptions>(*this));
     mTools.emplace_back(make_unique<pepr3d::Settings>(*this));
-    mTools.emplace_back(make_unique<Information>());
+    mTools.emplace_back(make_unique<Information>(*this));
     mTools.emplace_back(make_unique<ExportAssistant>(*this));
 #if !defined(NDEBUG)
     mTools.emplace_back(make_unique<LiveDebug>(*this));
 #endif
     mCurrentToolIterator = mTools.begin();
 
+    // Reading the hotkeys and building the font atlas do not need the GL context, they run on the workers while
+    // the default model is loaded and the shaders are compiled
+    const std::string hotkeysPath = getAssetPath("hotkeys.json").string();
+    auto hotkeysFuture = sThreadPool.enqueue([this, hotkeysPath]() {
+        // Uncomment the following lines to save mHotkeys on startup
+        // (only useful for updating the .json file after a change in hotkeys):
+        // mHotkeys.loadDefaults();
+        // saveHotkeysToFile((getAssetPath("") / "hotkeys.json").string());
+        try {
+            loadHotkeysFromFile(hotkeysPath);
+        } catch(const cereal::Exception&) {
+            CI_LOG_I("Failed to load hotkeys from hotkeys.json, using default hotkeys");
+            mHotkeys.loadDefaults();
+        }
+    });
+    std::future<void> fontsFuture;
+    try {
+        fontsFuture = buildFontAtlas();
+    } catch(const AssetNotFoundException&) {
+        // do nothing, a Fatal Error dialog has already been created
+    }
+
+    // A model given on the command line is opened instead of the default one, which is not loaded at all then
+    const std::vector<std::string>& arguments = getCommandLineArgs();
+    const std::optional<std::string> commandLineModel =
+        arguments.size() > 1 ? std::optional<std::string>(arguments[1]) : std::nullopt;
+
+    mImportCache =
+        std::make_shared<ImportCache>(ci::fs::temp_directory_path() / "pepr3d_import_cache", IMPORT_CACHE_MAX_BYTES);
+
+    mGeometry = std::make_shared<Geometry>();
+    if(!commandLineModel) {
+        try {
+            mGeometry->loadNewGeometry(getRequiredAssetPath("models/defaultcube.stl").string());
+        } catch(const AssetNotFoundException&) {
+            // do nothing, a Fatal Error dialog has already been created
+        }
+    }
+
+    mCommandManager = std::make_unique<CommandManager<Geometry>>(*mGeometry);
+
     try {
-        setupFonts();
         mModelView.setup();
     } catch(const AssetNotFoundException&) {
         // do nothing, a Fatal Error dialog has already been created
     }
 
+    sThreadPool.wait(hotkeysFuture);
+    if(fontsFuture.valid()) {
+        sThreadPool.wait(fontsFuture);
+        mImGui.refreshFontTexture();
+    }
+
     mModelView.onNewGeometryLoaded();
     for(auto& tool : mTools) {
         tool->onNewGeometryLoaded(mModelView);
     }
+    if(commandLineModel) {
+        openFile(*commandLineModel);
+    }
+    requestRedraw();
 }
 
 void MainApplication::setupLogging() {
@@ -196,8 +308,8 @@ void MainApplication::keyDown(KeyEvent event) {
     case HotkeyAction::Save: saveProject(); break;
     case HotkeyAction::Import: showImportDialog(supportedImportExtensions); break;
     case HotkeyAction::Export: setCurrentTool<ExportAssistant>(); break;
-    case HotkeyAction::Undo: enqueueSlowOperation([this]() { mCommandManager->undo(); }, []() {}); break;
-    case HotkeyAction::Redo: enqueueSlowOperation([this]() { mCommandManager->redo(); }, []() {}); break;
+    case HotkeyAction::Undo: undo(); break;
+    case HotkeyAction::Redo: redo(); break;
     case HotkeyAction::SelectTrianglePainter: setCurrentTool<TrianglePainter>(); break;
     case HotkeyAction::SelectPaintBucket: setCurrentTool<PaintBucket>(); break;
     case HotkeyAction::SelectBrush: setCurrentTool<Brush>(); break;
@@ -215,11 +327,15 @@ void MainApplication::keyDown(KeyEvent event) {
         std::size_t colorId = actionId - static_cast<std::size_t>(HotkeyAction::SelectColor1);
         ColorManager& colorManager = mGeometry->getColorManager();
         if(colorId < colorManager.size()) {
-            colorManager.setActiveColorIndex(colorId);
+            colorManager.setActiveColorIndex(colorManager.getColorIndexAt(colorId));
         }
     }
 }
 
+bool MainApplication::isGeometryPreviewShown() const {
+    return mGeometryInProgress != nullptr && mGeometryInProgress->getProgress().buffersPercentage >= 1.0f;
+}
+
 bool MainApplication::showLoadingErrorDialog() {
     const GeometryProgress& progress = mGeometryInProgress->getProgress();
 
@@ -297,9 +413,17 @@ void MainApplication::openFile(const std::string& path) {
     fs::path fsPath(path);
     fs::path ext = fsPath.extension();
 
+    // The autosave of a crash is loaded instead of the file, the autosave of this session is not a crash
+    std::shared_ptr<const Autosave::Recovery> recovery;
+    if(mAutosave == nullptr || mAutosave->getProjectPath() != fsPath) {
+        if(std::optional<Autosave::Recovery> foundRecovery = Autosave::findRecovery(fsPath)) {
+            recovery = std::make_shared<const Autosave::Recovery>(std::move(*foundRecovery));
+        }
+    }
+
     // Lambda that will be called once the loading finishes.
     // Put all updates to saved states here.
-    auto onLoadingComplete = [path, this]() {
+    auto onLoadingComplete = [path, recovery, this]() {
         // Handle errors
         const bool isLoadedCorrectly = showLoadingErrorDialog();
         if(!isLoadedCorrectly) {
@@ -312,7 +436,33 @@ void MainApplication::openFile(const std::string& path) {
         mGeometryFileName = path;
         mShouldSaveAs = true;
         mIsGeometryDirty = false;
+        if(mAutosave != nullptr) {
+            // Before its CommandManager is destroyed, its checkpoint may still be written
+            mAutosave->removeFiles();
+        }
         mCommandManager = std::make_unique<CommandManager<Geometry>>(*mGeometry);
+        mAutosave = std::make_shared<Autosave>(path, *mCommandManager, mCommandManager->getVersionNumber());
+        if(recovery != nullptr) {
+            // The journal replays only on the model of its checkpoint, otherwise the checkpoint alone is recovered
+            if(recovery->modelHash == mGeometry->getModelHash()) {
+                try {
+                    for(const SessionRecording::Entry& entry : recovery->entries) {
+                        SessionRecording::applyEntry(entry, *mCommandManager);
+                    }
+                } catch(const std::exception& e) {
+                    CI_LOG_E("Replaying the autosave journal failed: " << e.what());
+                }
+            } else if(!recovery->entries.empty()) {
+                CI_LOG_W("The autosave journal is of a different model, only its checkpoint is recovered.");
+            }
+            // The recovered changes are not in the file
+            mLastVersionSaved = std::numeric_limits<std::size_t>::max();
+            const std::string caption = "Recovered unsaved changes";
+            const std::string description =
+                "Pepr3D was not closed properly, the unsaved changes of this file were recovered from its autosave. "
+                "Save the project to keep them.";
+            pushDialog(Dialog(DialogType::Information, caption, description, "Continue"));
+        }
         fs::path fsPath(path);
         getWindow()->setTitle(fsPath.stem().string() + std::string(" - Pepr3D"));
         mProgressIndicator.setGeometryInProgress(nullptr);
@@ -323,15 +473,33 @@ void MainApplication::openFile(const std::string& path) {
         CI_LOG_I("Loading complete.");
     };
 
-    if(ext == ".p3d" || ext == ".P3D" || ext == ".p3D" || ext == ".P3d") {
-        CI_LOG_I("Loading project from " + path);
+    if(recovery != nullptr || ext == ".p3d" || ext == ".P3D" || ext == ".p3D" || ext == ".P3d") {
+        const std::string projectPath = recovery != nullptr ? recovery->checkpointPath.string() : path;
+        CI_LOG_I("Loading project from " + projectPath);
         {
-            std::ifstream is(path, std::ios::binary);
-            cereal::BinaryInputArchive loadArchive(is);
-            // CAREFUL! Replaces the shared_ptr in mGeometryInProgress!
+            std::ifstream is(projectPath, std::ios::binary);
             try {
-                loadArchive(mGeometryInProgress);
-            } catch(const cereal::Exception&) {
+                if(ProjectFile::isProjectFile(is)) {
+                    mGeometryInProgress = std::make_shared<Geometry>();
+                    mGeometryInProgress->loadProjectSnapshot(ProjectFile::read(is, sThreadPool));
+                } else {
+                    // Project saved before the container, a single archive of the Geometry
+                    cereal::BinaryInputArchive loadArchive(is);
+                    // CAREFUL! Replaces the shared_ptr in mGeometryInProgress!
+                    loadArchive(mGeometryInProgress);
+                }
+            } catch(const std::exception&) {
+                if(recovery != nullptr) {
+                    Autosave::discard(fsPath);
+                    const std::string errorCaption = "Error: Autosave corrupted";
+                    const std::string errorDescription =
+                        "The unsaved changes of this file could not be recovered, their autosave is corrupted and "
+                        "was removed. Open the file again to load it without them.";
+                    pushDialog(Dialog(DialogType::Error, errorCaption, errorDescription, "Cancel import"));
+                    mGeometryInProgress = nullptr;
+                    mProgressIndicator.setGeometryInProgress(nullptr);
+                    return;
+                }
                 const std::string errorCaption = "Error: Pepr3D project file (.p3d) corrupted";
                 const std::string errorDescription =
                     "The project file you attempted to open is corrupted and cannot be loaded. "
@@ -356,16 +524,37 @@ void MainApplication::openFile(const std::string& path) {
             // onLoadingComplete Gets called at the beginning of the next draw() cycle.
             dispatchAsync(onLoadingComplete);
         };
-        sThreadPool.enqueue(asyncCalculation);
+        sThreadPool.enqueue(::ThreadPool::priority::background, asyncCalculation);
     } else {
         CI_LOG_I("Importing a new model from " + path);
 
         // Queue the loading of the new geometry
-        auto importNewModel = [onLoadingComplete, path, this]() {
-            // Load the geometry
-
+        const std::shared_ptr<ImportCache> importCache = mImportCache;
+        auto importNewModel = [onLoadingComplete, path, importCache, this]() {
+            // Load the geometry, from the cache if the same file was imported before
             try {
-                mGeometryInProgress->loadNewGeometry(path);
+                const std::optional<uint64_t> cacheKey =
+                    importCache->isEnabled() ? ImportCache::computeKey(path) : std::nullopt;
+                std::optional<Geometry::ProjectSnapshot> cached;
+                if(cacheKey) {
+                    cached = importCache->read(*cacheKey, sThreadPool);
+                }
+                if(cached) {
+                    CI_LOG_I("Imported model found in the import cache");
+                    mGeometryInProgress->loadProjectSnapshot(std::move(*cached));
+                    mGeometryInProgress->recomputeFromData();
+                } else {
+                    mGeometryInProgress->loadNewGeometry(path);
+                    if(cacheKey) {
+                        // Stored in the background, the Geometry is not shared with the main thread yet
+                        const auto snapshot = std::make_shared<const Geometry::ProjectSnapshot>(
+                            mGeometryInProgress->createProjectSnapshot());
+                        sThreadPool.enqueue([importCache, snapshot, key = *cacheKey]() {
+                            const Profiler::TraceScope traceScope("SaveProject", "Import cache entry");
+                            importCache->write(key, *snapshot, sThreadPool);
+                        });
+                    }
+                }
             } catch(const std::exception& e) {
                 // ignore the exception as we will detect the loading failed in the onLoadingComplete
                 CI_LOG_E("exception occured while loading geometry: " << e.what());
@@ -375,16 +564,34 @@ void MainApplication::openFile(const std::string& path) {
             // onLoadingComplete Gets called at the beginning of the next draw() cycle.
             dispatchAsync(onLoadingComplete);
         };
-        sThreadPool.enqueue(importNewModel);
+        sThreadPool.enqueue(::ThreadPool::priority::background, importNewModel);
     }
 }
 
 void MainApplication::update() {
+    mFrameTimer = std::make_unique<Profiler::ScopedTimer>(Profiler::Zone::Frame);
+
+    // The counters of the previous frame are complete, the GPU timings come in once the GPU finishes the passes
+    Profiler::endFrame();
+    mGpuTimer.collectResults();
+
     // verify that a selected tool is enabled, otherwise select Triangle Painter, which is always enabled:
     if(!(*mCurrentToolIterator)->isEnabled()) {
         mCurrentToolIterator = mTools.begin();
     }
 
+    // Mouse moves and drags since the last frame reach the tool at once, before it is updated
+    mModelView.dispatchMouseEvents();
+
+    // The warm-up modifies the details the tools read, they wait for it like for an operation with an indicator
+    if(mGeometryInProgress == nullptr && !mProgressIndicator.isInProgress() && !isWarmUpRunning()) {
+        // Slow operations may use the SDF values, they are replaced only in between them
+        if(mGeometry != nullptr) {
+            mGeometry->updateSdfRefinement();
+        }
+        (*mCurrentToolIterator)->onUpdate(mModelView);
+    }
+
 #if defined(CINDER_MSW_DESKTOP)
     // on Microsoft Windows, when window is not focused, periodically check
     // if it is obscured (not visible) every 2 seconds
@@ -397,6 +604,14 @@ void MainApplication::update() {
         }
     }
 #endif
+    // Measuring undo snapshots is left for idle frames, so that it does not delay commands.
+    // Slow operations may be running a command on a worker thread, the snapshots can be finalized after them.
+    if(!mProgressIndicator.isInProgress()) {
+        mCommandManager->finalizeSnapshots();
+    }
+    updateAutosave();
+    updateWarmUp();
+
     if(!mIsGeometryDirty && mLastVersionSaved != mCommandManager->getVersionNumber()) {
         mIsGeometryDirty = true;
         fs::path path(mGeometryFileName);
@@ -405,9 +620,112 @@ void MainApplication::update() {
         title += std::string("* - Pepr3D");
         getWindow()->setTitle(title);
     }
+
+    detectRedraw();
+    updateFrameRate();
+}
+
+void MainApplication::cleanup() {
+    if(mAutosave != nullptr) {
+        mAutosave->removeFiles();
+    }
+    // The GPU thread is stopped while the context it shares with still exists
+    Geometry::setSdfGpuCalculator(nullptr);
+    mSdfGpuCalculator.reset();
+}
+
+void MainApplication::setSdfComputedOnGpu(const bool isComputedOnGpu) {
+    mIsSdfComputedOnGpu = isComputedOnGpu;
+    Geometry::setSdfGpuCalculator(isComputedOnGpu ? mSdfGpuCalculator : nullptr);
+}
+
+void MainApplication::requestRedraw() {
+    mLastRedrawRequestTime = getElapsedSeconds();
+    if(mIsIdle) {
+        mIsIdle = false;
+        applyFrameRate();
+    }
+}
+
+void MainApplication::onInput() {
+    mLastInputTime = getElapsedSeconds();
+    preemptWarmUp();
+    requestRedraw();
+}
+
+void MainApplication::setWarmUpEnabled(const bool isEnabled) {
+    mIsWarmUpEnabled = isEnabled;
+    if(!isEnabled) {
+        preemptWarmUp();
+    }
+}
+
+void MainApplication::setIdleFrameRate(const int frameRate) {
+    P_ASSERT(frameRate >= 0);
+    mIdleFrameRate = frameRate;
+    if(mIsIdle) {
+        applyFrameRate();
+    }
+}
+
+void MainApplication::detectRedraw() {
+    // Loading and slow operations animate the ProgressIndicator, the Geometry may be in use by a worker meanwhile.
+    // The warm-up shows no indicator, it keeps the idle frame rate.
+    if(isOperationInProgress()) {
+        if(!isWarmUpRunning()) {
+            requestRedraw();
+        }
+        return;
+    }
+    if(mGeometry == nullptr) {
+        return;
+    }
+
+    // ModelView resets the flags when it uploads the data
+    const auto& glData = mGeometry->getOpenGlData();
+    if(glData.isDirty || glData.info.didColorUpdate || glData.info.didHighlightUpdate ||
+       glData.info.didLayoutChange) {
+        requestRedraw();
+    }
+
+    const GeometryProgress::Percentages progress = mGeometry->getProgress().getPercentages();
+    const std::optional<float> sdfRefinementProgress =
+        mGeometry->isSdfRefining() ? mGeometry->getSdfRefinementProgress() : std::optional<float>();
+    if(progress != mLastProgress || sdfRefinementProgress != mLastSdfRefinementProgress) {
+        mLastProgress = progress;
+        mLastSdfRefinementProgress = sdfRefinementProgress;
+        requestRedraw();
+    }
+}
+
+void MainApplication::updateFrameRate() {
+    // An obscured window keeps its minimal frame rate until it becomes active
+    if(mIsIdle || mShouldSkipDraw || mIdleFrameRate == 0) {
+        return;
+    }
+    if(getElapsedSeconds() - mLastRedrawRequestTime > REDRAW_DURATION) {
+        mIsIdle = true;
+        applyFrameRate();
+    }
+}
+
+void MainApplication::applyFrameRate() {
+    if(mShouldSkipDraw) {
+        return;
+    }
+    if(mIsIdle && mIdleFrameRate > 0) {
+        const float idleFrameRate = static_cast<float>(mIdleFrameRate);
+        setFrameRate(mIsFocused ? idleFrameRate : std::min(idleFrameRate, UNFOCUSED_FRAME_RATE));
+    } else if(mIsFocused) {
+        disableFrameRate();
+    } else {
+        setFrameRate(UNFOCUSED_FRAME_RATE);
+    }
 }
 
 void MainApplication::draw() {
+    const std::unique_ptr<Profiler::ScopedTimer> frameTimer = std::move(mFrameTimer);
+
     if(mShouldSkipDraw) {
         return;
     }
@@ -434,7 +752,7 @@ void MainApplication::draw() {
         ImGui::ShowDemoWindow();
     }
 
-    if(mGeometryInProgress == nullptr && !mProgressIndicator.isInProgress()) {
+    if(mGeometryInProgress == nullptr && !mProgressIndicator.isInProgress() && !isWarmUpRunning()) {
         // if there is no operation in progress, we simply draw everything to a framebuffer:
         mImGui.useFramebuffer(mFramebuffer);  // force ImGui to draw to this framebuffer
         mFramebuffer->bindFramebuffer();
@@ -449,48 +767,69 @@ void MainApplication::draw() {
         // ProgressIndicator):
         gl::clear(ColorA::hex(0xFCFCFC));
         ci::gl::draw(mFramebuffer->getTexture2d(GL_COLOR_ATTACHMENT0));  // draw the cached framebuffer
-        mImGui.useFramebuffer(nullptr);                                  // force ImGui to draw directly to screen
-        mProgressIndicator.draw();  // draw animated ProgressIndicator via ImGui directly to screen (as an overlay)
+
+        // a geometry being loaded is shown as soon as its buffers exist, the camera can be used while the polyhedron
+        // and the AABB tree are built
+        const bool isPreviewReady = isGeometryPreviewShown();
+        // the current geometry modified by a slow operation is shown from its GPU buffers, as it was before
+        const bool isSnapshotShown =
+            !isPreviewReady && mGeometryInProgress == nullptr && mModelView.hasRenderSnapshot();
+        if(isPreviewReady) {
+            mModelView.drawPreview(*mGeometryInProgress);
+        } else if(isSnapshotShown) {
+            mModelView.drawSnapshot();
+        }
+
+        mImGui.useFramebuffer(nullptr);  // force ImGui to draw directly to screen
+        // draw animated ProgressIndicator via ImGui directly to screen (as an overlay)
+        mProgressIndicator.draw(!isPreviewReady && !isSnapshotShown);
     }
 }
 
-void MainApplication::setupFonts() {
+std::future<void> MainApplication::buildFontAtlas() {
     ImFontAtlas* fontAtlas = ImGui::GetIO().Fonts;
 
     // if the following fonts are not found, exception is thrown, font atlas is not cleared and a default font is used:
-    ci::fs::path sourceSansProSemiBoldPath = getRequiredAssetPath("fonts/SourceSansPro-SemiBold.ttf");
-    ci::fs::path materialIconsRegularPath = getRequiredAssetPath("fonts/MaterialIcons-Regular.ttf");
-
-    fontAtlas->Clear();
+    const std::string sourceSansProSemiBoldPath = getRequiredAssetPath("fonts/SourceSansPro-SemiBold.ttf").string();
+    const std::string materialIconsRegularPath = getRequiredAssetPath("fonts/MaterialIcons-Regular.ttf").string();
 
-    std::vector<ImWchar> textRange = {0x0001, 0x00FF, 0};
-    ImFontConfig fontConfig;
-    fontConfig.GlyphExtraSpacing.x = -0.2f;
-    mFontStorage.mRegularFont =
-        fontAtlas->AddFontFromFileTTF(sourceSansProSemiBoldPath.string().c_str(), 18.0f, &fontConfig, textRange.data());
-    mFontStorage.mSmallFont =
-        fontAtlas->AddFontFromFileTTF(sourceSansProSemiBoldPath.string().c_str(), 16.0f, &fontConfig, textRange.data());
-
-    ImVector<ImWchar> iconsRange;
-    ImFontAtlas::GlyphRangesBuilder iconsRangeBuilder;
+    std::string icons;
     for(auto& tool : mTools) {
-        iconsRangeBuilder.AddText(tool->getIcon().c_str());
+        icons += tool->getIcon();
     }
-    iconsRangeBuilder.AddText(ICON_MD_ARROW_DROP_DOWN);
-    iconsRangeBuilder.AddText(ICON_MD_KEYBOARD_ARROW_RIGHT);
-    iconsRangeBuilder.AddText(ICON_MD_KEYBOARD_ARROW_DOWN);
-    iconsRangeBuilder.AddText(ICON_MD_FOLDER_OPEN);
-    iconsRangeBuilder.AddText(ICON_MD_UNDO);
-    iconsRangeBuilder.AddText(ICON_MD_REDO);
-    iconsRangeBuilder.AddText(ICON_MD_CHILD_FRIENDLY);
-    iconsRangeBuilder.AddText(ICON_MD_ARCHIVE);
-    iconsRangeBuilder.BuildRanges(&iconsRange);
-    fontConfig.GlyphExtraSpacing.x = 0.0f;
-    mFontStorage.mRegularIcons =
-        fontAtlas->AddFontFromFileTTF(materialIconsRegularPath.string().c_str(), 24.0f, &fontConfig, iconsRange.Data);
-    mFontStorage.mRegularIcons->DisplayOffset.y = -1.0f;
 
-    mImGui.refreshFontTexture();
+    // Nothing else uses the atlas until the texture is created from it
+    return sThreadPool.enqueue([this, fontAtlas, sourceSansProSemiBoldPath, materialIconsRegularPath, icons]() {
+        fontAtlas->Clear();
+
+        std::vector<ImWchar> textRange = {0x0001, 0x00FF, 0};
+        ImFontConfig fontConfig;
+        fontConfig.GlyphExtraSpacing.x = -0.2f;
+        mFontStorage.mRegularFont =
+            fontAtlas->AddFontFromFileTTF(sourceSansProSemiBoldPath.c_str(), 18.0f, &fontConfig, textRange.data());
+        mFontStorage.mSmallFont =
+            fontAtlas->AddFontFromFileTTF(sourceSansProSemiBoldPath.c_str(), 16.0f, &fontConfig, textRange.data());
+
+        ImVector<ImWchar> iconsRange;
+        ImFontAtlas::GlyphRangesBuilder iconsRangeBuilder;
+        iconsRangeBuilder.AddText(icons.c_str());
+        iconsRangeBuilder.AddText(ICON_MD_ARROW_DROP_DOWN);
+        iconsRangeBuilder.AddText(ICON_MD_KEYBOARD_ARROW_RIGHT);
+        iconsRangeBuilder.AddText(ICON_MD_KEYBOARD_ARROW_DOWN);
+        iconsRangeBuilder.AddText(ICON_MD_FOLDER_OPEN);
+        iconsRangeBuilder.AddText(ICON_MD_UNDO);
+        iconsRangeBuilder.AddText(ICON_MD_REDO);
+        iconsRangeBuilder.AddText(ICON_MD_CHILD_FRIENDLY);
+        iconsRangeBuilder.AddText(ICON_MD_ARCHIVE);
+        iconsRangeBuilder.BuildRanges(&iconsRange);
+        fontConfig.GlyphExtraSpacing.x = 0.0f;
+        mFontStorage.mRegularIcons =
+            fontAtlas->AddFontFromFileTTF(materialIconsRegularPath.c_str(), 24.0f, &fontConfig, iconsRange.Data);
+        mFontStorage.mRegularIcons->DisplayOffset.y = -1.0f;
+
+        // The glyph ranges are only read by the build
+        fontAtlas->Build();
+    });
 }
 
 void MainApplication::setupIcon() {
@@ -586,14 +925,16 @@ void MainApplication::drawTooltipOnHover(const std::string& label, const std::st
 }
 
 void MainApplication::willResignActive() {
-    setFrameRate(24.0f);
     mIsFocused = false;
+    applyFrameRate();
 }
 
 void MainApplication::didBecomeActive() {
-    disableFrameRate();
     mIsFocused = true;
     mShouldSkipDraw = false;
+    mIsIdle = false;
+    mLastRedrawRequestTime = getElapsedSeconds();
+    applyFrameRate();
 }
 
 bool MainApplication::isWindowObscured() {
@@ -655,30 +996,282 @@ void MainApplication::saveProjectAs() {
             path.replace_extension(".p3d");
         }
 
-        std::string finalPath = path.string();
-        CI_LOG_I("Saving project into " + finalPath);
-        {
-            std::ofstream os(finalPath, std::ios::binary);
-            if(!os.is_open()) {
-                const std::string errorCaption = "Error: Failed to save project";
-                const std::string errorDescription =
-                    "The file you selected to save into could not be opened for saving. Your project was NOT saved. "
-                    "Make sure you have write permissions to the directory or files you are saving to.\n";
-                pushDialog(Dialog(DialogType::Error, errorCaption, errorDescription, "OK"));
-                return;
-            }
-            cereal::BinaryOutputArchive saveArchive(os);
-            saveArchive(mGeometry);
+        saveProjectInBackground(path);
+    });
+}
+
+void MainApplication::saveProjectInBackground(const fs::path& path) {
+    if(isOperationInProgress()) {
+        // The snapshot is taken once the operations using the Geometry are finished
+        enqueueSlowOperation([]() {}, [path, this]() { startProjectSave(path); }, false);
+        return;
+    }
+    startProjectSave(path);
+}
+
+void MainApplication::startProjectSave(const fs::path& path) {
+    if(mGeometry == nullptr || mCommandManager == nullptr) {
+        return;
+    }
+    if(mIsSavingProject) {
+        // Saved after the running save, with the state at that time
+        mPendingProjectSavePath = path;
+        return;
+    }
+
+    CI_LOG_I("Saving project into " + path.string());
+    mIsSavingProject = true;
+    const std::shared_ptr<Geometry> geometry = mGeometry;
+    const std::size_t version = mCommandManager->getVersionNumber();
+    const auto snapshot = std::make_shared<const Geometry::ProjectSnapshot>(geometry->createProjectSnapshot());
+    geometry->getProgress().saveProjectPercentage = 0.0f;
+
+    sThreadPool.enqueue(::ThreadPool::priority::background, [snapshot, geometry, path, version, this]() {
+        std::string error;
+        try {
+            const Profiler::TraceScope traceScope("SaveProject", "Save project");
+            writeProjectFile(snapshot, path);
+        } catch(const std::exception& e) {
+            error = e.what();
         }
+        geometry->getProgress().saveProjectPercentage = error.empty() ? 1.0f : -1.0f;
+        dispatchAsync([geometry, path, version, error, this]() { finishProjectSave(*geometry, path, version, error); });
+    });
+}
 
-        mGeometryFileName = finalPath;
-        mLastVersionSaved = mCommandManager->getVersionNumber();
+void MainApplication::finishProjectSave(const Geometry& geometry, const fs::path& path, const std::size_t version,
+                                        const std::string& error) {
+    mIsSavingProject = false;
+    if(!error.empty()) {
+        CI_LOG_E("Saving project failed: " << error);
+        const std::string errorCaption = "Error: Failed to save project";
+        const std::string errorDescription =
+            "The file you selected to save into could not be written. Your project was NOT saved. "
+            "Make sure you have write permissions to the directory or files you are saving to.\n";
+        pushDialog(Dialog(DialogType::Error, errorCaption, errorDescription, "OK"));
+    } else if(mGeometry.get() == &geometry) {
+        // Changes made while saving mark the project dirty again in the next update
+        mGeometryFileName = path.string();
+        mLastVersionSaved = version;
         mIsGeometryDirty = false;
         getWindow()->setTitle(path.stem().string() + std::string(" - Pepr3D"));
         mShouldSaveAs = false;
+        if(mAutosave == nullptr || mAutosave->getProjectPath() != path) {
+            resetAutosave(path, version);
+        }
+    }
+
+    if(mPendingProjectSavePath) {
+        const fs::path pendingPath = std::move(*mPendingProjectSavePath);
+        mPendingProjectSavePath.reset();
+        saveProjectInBackground(pendingPath);
+    }
+}
+
+void MainApplication::updateAutosave() {
+    if(mAutosave == nullptr || isOperationInProgress() || !mAutosave->needsCheckpoint()) {
+        return;
+    }
+
+    // The journal of the checkpoint records the commands from the moment of the snapshot
+    const std::shared_ptr<Autosave> autosave = mAutosave;
+    fs::path checkpointPath;
+    try {
+        checkpointPath = autosave->beginCheckpoint(mGeometry->getModelHash());
+    } catch(const std::exception& e) {
+        CI_LOG_E("The autosave is stopped: " << e.what());
+        return;
+    }
+    const auto snapshot = std::make_shared<const Geometry::ProjectSnapshot>(mGeometry->createProjectSnapshot());
+
+    sThreadPool.enqueue(::ThreadPool::priority::background, [snapshot, autosave, checkpointPath, this]() {
+        bool isWritten = true;
+        try {
+            const Profiler::TraceScope traceScope("SaveProject", "Autosave checkpoint");
+            writeProjectFile(snapshot, checkpointPath);
+        } catch(const std::exception& e) {
+            CI_LOG_E("Writing the autosave checkpoint failed: " << e.what());
+            isWritten = false;
+        }
+        dispatchAsync([autosave, isWritten]() { autosave->finishCheckpoint(isWritten); });
     });
 }
 
+void MainApplication::resetAutosave(const fs::path& path, const std::size_t savedVersion) {
+    if(mAutosave != nullptr) {
+        mAutosave->removeFiles();
+    }
+    mAutosave = std::make_shared<Autosave>(path, *mCommandManager, savedVersion);
+}
+
+void MainApplication::pushSlowOperation(SlowOperation&& slowOperation) {
+    const SlowOperationKind kind = slowOperation.kind;
+    // The warm-up gives way to any other operation
+    mPendingSlowOperations.erase(
+        std::remove_if(mPendingSlowOperations.begin(), mPendingSlowOperations.end(),
+                       [kind](const SlowOperation& pending) {
+                           return (kind != SlowOperationKind::Other && pending.kind == kind) ||
+                                  pending.kind == SlowOperationKind::WarmUp;
+                       }),
+        mPendingSlowOperations.end());
+    if(mRunningSlowOperation && ((kind == SlowOperationKind::ExportPreview && mRunningSlowOperation->kind == kind) ||
+                                 (kind != SlowOperationKind::WarmUp && isWarmUpRunning()))) {
+        *mRunningSlowOperation->isCancelled = true;
+    }
+    mPendingSlowOperations.push_back(std::move(slowOperation));
+
+    // Started in the next update, the caller may be drawing with the Geometry the operation modifies
+    if(!mRunningSlowOperation) {
+        dispatchAsync([this]() { startNextSlowOperation(); });
+    }
+}
+
+void MainApplication::startNextSlowOperation() {
+    if(mRunningSlowOperation || mPendingSlowOperations.empty()) {
+        return;
+    }
+    mRunningSlowOperation = std::move(mPendingSlowOperations.front());
+    mPendingSlowOperations.pop_front();
+    mProgressIndicator.setGeometryInProgress(mRunningSlowOperation->showIndicator ? mGeometry : nullptr);
+    mProgressIndicator.setCancellation(mRunningSlowOperation->isCancelled);
+
+    mRunningSlowOperation->task = sThreadPool.enqueue(
+        ::ThreadPool::priority::background,
+        [operation = mRunningSlowOperation->operation, isCancelled = mRunningSlowOperation->isCancelled, this]() {
+            try {
+                const Profiler::TraceScope traceScope("SlowOperation", "Slow operation");
+                operation(isCancelled.get());
+            } catch(const std::exception& e) {
+                CI_LOG_E("Slow operation failed: " << e.what());
+            }
+            dispatchAsync([isCancelled, this]() {
+                // A preempted warm-up is already finished, the token tells it apart from the next operation
+                if(mRunningSlowOperation && mRunningSlowOperation->isCancelled == isCancelled) {
+                    finishSlowOperation();
+                }
+            });
+        });
+}
+
+void MainApplication::finishSlowOperation() {
+    P_ASSERT(mRunningSlowOperation);
+    const SlowOperation finished = std::move(*mRunningSlowOperation);
+    mRunningSlowOperation.reset();
+    if(finished.isCancelled == nullptr || !*finished.isCancelled) {
+        const Profiler::TraceScope traceScope("SlowOperation", "Post operation");
+        finished.postOperation();
+    }
+    mProgressIndicator.setCancellation(nullptr);
+    if(mPendingSlowOperations.empty()) {
+        mProgressIndicator.setGeometryInProgress(nullptr);
+    } else {
+        startNextSlowOperation();
+    }
+}
+
+void MainApplication::updateWarmUp() {
+    if(!mIsWarmUpEnabled || mGeometry == nullptr || isOperationInProgress() || !mDialogQueue.empty() ||
+       getElapsedSeconds() - mLastInputTime < WARM_UP_IDLE_DELAY) {
+        return;
+    }
+    const std::shared_ptr<Geometry> geometry = mGeometry;
+    if(!geometry->polyhedronValid() || mWarmUpFailedGeometry.lock() == geometry) {
+        return;
+    }
+
+    // The cheapest step first, each one is a chance to preempt the warm-up
+    std::function<void(const std::atomic<bool>*)> step;
+    if(!geometry->isDetailedMeshValid()) {
+        step = [geometry](const std::atomic<bool>* isCancelled) { geometry->updateDetailedMesh(isCancelled); };
+    } else if(!geometry->areDetailedNormalsAndBordersValid()) {
+        step = [geometry](const std::atomic<bool>* isCancelled) {
+            geometry->updateDetailedNormalsAndBorders(isCancelled);
+        };
+    } else if(mIsSdfWarmUpEnabled && !geometry->isSdfComputed()) {
+        step = [geometry](const std::atomic<bool>*) { geometry->computeSdfValues(); };
+    } else {
+        return;
+    }
+
+    // A failed step would fail again, e.g., the SDF of a flat model, its tool reports the error once it is used
+    const auto hasFailed = std::make_shared<std::atomic<bool>>(false);
+    enqueueSlowOperation(
+        [step, hasFailed](const std::atomic<bool>* isCancelled) {
+            try {
+                const Profiler::TraceScope traceScope("SlowOperation", "Warm-up");
+                step(isCancelled);
+            } catch(const std::exception& e) {
+                CI_LOG_W("The warm-up of the geometry is stopped: " << e.what());
+                *hasFailed = true;
+            }
+        },
+        [geometry, hasFailed, this]() {
+            if(*hasFailed) {
+                mWarmUpFailedGeometry = geometry;
+            }
+        },
+        false, SlowOperationKind::WarmUp);
+}
+
+void MainApplication::preemptWarmUp() {
+    mPendingSlowOperations.erase(
+        std::remove_if(mPendingSlowOperations.begin(), mPendingSlowOperations.end(),
+                       [](const SlowOperation& pending) { return pending.kind == SlowOperationKind::WarmUp; }),
+        mPendingSlowOperations.end());
+    // The input waits only once, for the first event after the warm-up started
+    if(!isWarmUpRunning() || *mRunningSlowOperation->isCancelled) {
+        return;
+    }
+    *mRunningSlowOperation->isCancelled = true;
+    if(mRunningSlowOperation->task.valid() &&
+       mRunningSlowOperation->task.wait_for(WARM_UP_PREEMPTION_TIMEOUT) == std::future_status::ready) {
+        finishSlowOperation();
+    } else {
+        // The user waits for the step now, e.g., for the SDF, which cannot stop early
+        mProgressIndicator.setGeometryInProgress(mGeometry);
+    }
+}
+
+void MainApplication::enqueueHistoryMove(const long steps) {
+    const bool isHistoryPending =
+        std::any_of(mPendingSlowOperations.begin(), mPendingSlowOperations.end(),
+                    [](const SlowOperation& pending) { return pending.kind == SlowOperationKind::History; });
+    if(isHistoryPending) {
+        *mPendingHistorySteps += steps;
+        return;
+    }
+
+    mPendingHistorySteps = std::make_shared<long>(steps);
+    enqueueSlowOperation(
+        [pendingSteps = mPendingHistorySteps, this]() {
+            // Undoing and redoing several commands replays them only once from the closest snapshot
+            if(*pendingSteps < 0) {
+                mCommandManager->undo(static_cast<size_t>(-*pendingSteps));
+            } else {
+                mCommandManager->redo(static_cast<size_t>(*pendingSteps));
+            }
+        },
+        []() {}, true, SlowOperationKind::History);
+}
+
+void MainApplication::startSessionRecording() {
+    P_ASSERT(!isOperationInProgress());
+    P_ASSERT(mGeometry != nullptr && mCommandManager != nullptr);
+    mSessionRecorder = std::make_shared<SessionRecorder>(mGeometry->getModelHash());
+    mCommandManager->addObserver(mSessionRecorder.get());
+    CI_LOG_I("Started recording the painting session.");
+}
+
+std::shared_ptr<SessionRecorder> MainApplication::stopSessionRecording() {
+    P_ASSERT(!isOperationInProgress());
+    if(mCommandManager != nullptr) {
+        mCommandManager->removeObserver(mSessionRecorder.get());
+    }
+    std::shared_ptr<SessionRecorder> recorder = std::move(mSessionRecorder);
+    mSessionRecorder = nullptr;
+    return recorder;
+}
+
 void MainApplication::saveProject() {
     if(mGeometryFileName == "" || mShouldSaveAs) {
         saveProjectAs();
@@ -686,23 +1279,7 @@ void MainApplication::saveProject() {
     }
     fs::path dirToSave = mGeometryFileName;
     dirToSave.replace_extension(".p3d");
-    std::string finalPath = dirToSave.string();
-    CI_LOG_I("Saving project into " + finalPath);
-    {
-        std::ofstream os(finalPath, std::ios::binary);
-        if(!os.is_open()) {
-            const std::string errorCaption = "Error: Failed to open the file";
-            const std::string errorDescription =
-                "The file you selected to save into could not be opened. Your project was NOT saved.\n";
-            pushDialog(Dialog(DialogType::Error, errorCaption, errorDescription, "OK"));
-            return;
-        }
-        cereal::BinaryOutputArchive saveArchive(os);
-        saveArchive(mGeometry);
-    }
-    mLastVersionSaved = mCommandManager->getVersionNumber();
-    mIsGeometryDirty = false;
-    getWindow()->setTitle(dirToSave.stem().string() + std::string(" - Pepr3D"));
+    saveProjectInBackground(dirToSave);
 }
 
 }  // namespace pepr3d
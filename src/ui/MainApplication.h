@@ -5,7 +5,14 @@
 //#endif
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
 #include <queue>
+#include <type_traits>
 
 #include "cinder/app/App.h"
 #include "cinder/app/RendererGl.h"
@@ -14,11 +21,13 @@
 
 #include "peprimgui.h"
 
+#include "Profiler.h"
 #include "ThreadPool.h"
 
 #include "AssetNotFoundException.h"
 #include "Dialog.h"
 #include "FontStorage.h"
+#include "GpuTimer.h"
 #include "Hotkeys.h"
 #include "ModelView.h"
 #include "ProgressIndicator.h"
@@ -26,10 +35,15 @@
 #include "Toolbar.h"
 #include "commands/CommandManager.h"
 #include "geometry/ExportType.h"
+#include "geometry/GeometryProgress.h"
 
 namespace pepr3d {
 class Tool;
 class Geometry;
+class SessionRecorder;
+class Autosave;
+class ImportCache;
+class SdfGpuCalculator;
 using cinder::app::FileDropEvent;
 using cinder::app::KeyEvent;
 using cinder::app::MouseEvent;
@@ -37,6 +51,21 @@ using cinder::app::MouseEvent;
 /// The main Cinder-based application, represents a window, handles events, thread pool, active tools, geometry, etc.
 class MainApplication : public cinder::app::App {
    public:
+    /// Slow operations of a kind other than Other replace the pending operation of the same kind, see
+    /// enqueueSlowOperation()
+    enum class SlowOperationKind {
+        Other,
+        /// Undo and redo, see undo()
+        History,
+        /// Building the detailed mesh for the tools
+        DetailedMesh,
+        /// The preview of an export, a newer one also cancels the running one, whose result would be stale
+        ExportPreview,
+        /// Precomputing the derived data of the Geometry while the user is idle, any other operation or an input
+        /// cancels it, see setWarmUpEnabled()
+        WarmUp
+    };
+
     /// Called by Cinder.
     /// Perform any application setup after the Renderer has been initialized.
     void setup() override;
@@ -49,6 +78,10 @@ class MainApplication : public cinder::app::App {
     /// Perform any rendering once-per-loop or in response to OS-prompted requests for refreshes.
     void draw() override;
 
+    /// Called by Cinder.
+    /// Removes the autosave of the project, the application was not closed by a crash.
+    void cleanup() override;
+
     /// Called by Cinder.
     /// Receive window resize events.
     void resize() override;
@@ -97,6 +130,11 @@ class MainApplication : public cinder::app::App {
         return sThreadPool;
     }
 
+    /// Returns the timer of the GPU passes of the frame.
+    GpuTimer& getGpuTimer() {
+        return mGpuTimer;
+    }
+
     /// Returns a reference to the Toolbar.
     Toolbar& getToolbar() {
         return mToolbar;
@@ -122,9 +160,60 @@ class MainApplication : public cinder::app::App {
         mShowDemoWindow = show;
     }
 
+    /// Renders at the full frame rate for a while, e.g., after an input or a change of the displayed data.
+    /// Otherwise the application renders at the idle frame rate, see setIdleFrameRate().
+    void requestRedraw();
+
+    /// Returns the frame rate while nothing changes, 0 if the application always renders at the full frame rate.
+    int getIdleFrameRate() const {
+        return mIdleFrameRate;
+    }
+
+    /// Set the frame rate while nothing changes, 0 to always render at the full frame rate.
+    void setIdleFrameRate(int frameRate);
+
+    /// Returns true if the OpenGL context supports tracing the SDF rays with compute shaders.
+    bool isSdfGpuAvailable() const {
+        return mSdfGpuCalculator != nullptr;
+    }
+
+    /// Returns true if the SDF rays are traced on the GPU, false if on the CPU.
+    bool isSdfComputedOnGpu() const {
+        return mIsSdfComputedOnGpu && isSdfGpuAvailable();
+    }
+
+    /// Trace the SDF rays with compute shaders if they are available, otherwise on the CPU.
+    void setSdfComputedOnGpu(bool isComputedOnGpu);
+
+    /// Returns true if the data the tools build on their first use is computed ahead while the user is idle.
+    bool isWarmUpEnabled() const {
+        return mIsWarmUpEnabled;
+    }
+
+    /// Build the detailed mesh and its normals and borders in the background once the user is idle for a while,
+    /// so that the tools needing them do not wait. Any input or operation preempts it. Off by default: the tools
+    /// ignore the input that arrives while a step is still finishing, see preemptWarmUp().
+    void setWarmUpEnabled(bool isEnabled);
+
+    /// Returns true if the idle warm-up computes the SDF values as well.
+    bool isSdfWarmUpEnabled() const {
+        return mIsSdfWarmUpEnabled;
+    }
+
+    /// Compute the SDF values in the idle warm-up too. The computation cannot stop early, the tools ignore the input
+    /// until it finishes.
+    void setSdfWarmUpEnabled(bool isEnabled) {
+        mIsSdfWarmUpEnabled = isEnabled;
+    }
+
     /// Tries to open a file in the specified path and use it as the new Geometry.
     void openFile(const std::string& path);
 
+    /// Cache of the imported models, shared with the workers importing and storing them
+    const std::shared_ptr<ImportCache>& getImportCache() const {
+        return mImportCache;
+    }
+
     using ToolsVector = std::vector<std::unique_ptr<Tool>>;
 
     /// Get the begin iterator of the current vector of Tool.
@@ -178,11 +267,35 @@ class MainApplication : public cinder::app::App {
         return mGeometry.get();
     }
 
+    /// Returns true if a Geometry is being loaded or a slow operation is running, either may be using the current
+    /// Geometry and CommandManager on a worker thread.
+    bool isOperationInProgress() {
+        return mGeometryInProgress != nullptr || mProgressIndicator.isInProgress() || mRunningSlowOperation ||
+               !mPendingSlowOperations.empty();
+    }
+
+    /// Returns true if a Geometry is being loaded and its buffers are already shown in the ModelView, while the
+    /// rest of it is built. The tools and their input wait for the loading to finish.
+    bool isGeometryPreviewShown() const;
+
     /// Returns a pointer to the current CommandManager.
     CommandManager<Geometry>* getCommandManager() {
         return mCommandManager.get();
     }
 
+    /// Starts recording the commands of the current Geometry, see SessionRecording.
+    /// Must not be called while an operation is in progress.
+    void startSessionRecording();
+
+    /// Stops recording and returns the recorder, nullptr if no session is being recorded.
+    /// Loading another model ends the recording on the previous one, it can still be returned and replayed.
+    /// Must not be called while an operation is in progress.
+    std::shared_ptr<SessionRecorder> stopSessionRecording();
+
+    bool isRecordingSession() const {
+        return mSessionRecorder != nullptr;
+    }
+
     const std::vector<std::string> supportedImportExtensions = {"stl", "obj", "ply"};
     const std::vector<std::string> supportedOpenExtensions = {"p3d"};
     /// Opens the file dialog for import.
@@ -221,6 +334,7 @@ class MainApplication : public cinder::app::App {
 
     /// Saves the .p3d serialized file of the current Geometry to the same file as was used previously.
     /// If it was not saved yet, behaves the same as saveProjectAs.
+    /// The file is written on a worker from a snapshot of the Geometry, which can be painted on meanwhile.
     void saveProject();
 
     /// Opens a file dialog to save the .p3d serialized file of the current Geometry.
@@ -250,24 +364,44 @@ class MainApplication : public cinder::app::App {
         return loadAsset(relativePath);
     }
 
-    /// Schedules `operation` to be executed in a separate thread in a thread pool.
+    /// Schedules `operation` to be executed in a separate thread in a thread pool, after the operations scheduled
+    /// before it, as they all use the current Geometry. Must be called from the main thread.
     /// If `showIndicator` is true, displays a progress indicator, which disables user interaction with the application.
     /// After the `operation` is finished, `postOperation` is executed in the main thread of the application.
     /// Finally, the progress indicator is hidden.
+    /// An `operation` taking a `const std::atomic<bool>*` can be cancelled by a button of the progress indicator, or
+    /// by a newer operation of the kind ExportPreview, it should check the token and stop early. The `postOperation`
+    /// of a cancelled operation is not executed.
+    /// A pending operation of a kind other than Other is dropped without its `postOperation` when another operation
+    /// of the same kind is scheduled, e.g., a pending preview is not computed when its settings change again.
     template <typename OperationFunc, typename PostOperationFunc>
-    void enqueueSlowOperation(OperationFunc operation, PostOperationFunc postOperation, bool showIndicator = true) {
+    void enqueueSlowOperation(OperationFunc operation, PostOperationFunc postOperation, bool showIndicator = true,
+                              SlowOperationKind kind = SlowOperationKind::Other) {
+        SlowOperation slowOperation;
+        slowOperation.kind = kind;
+        slowOperation.showIndicator = showIndicator;
+        if constexpr(std::is_invocable_v<OperationFunc, const std::atomic<bool>*>) {
+            slowOperation.operation = std::move(operation);
+            slowOperation.isCancelled = std::make_shared<std::atomic<bool>>(false);
+        } else {
+            slowOperation.operation = [operation](const std::atomic<bool>*) { operation(); };
+        }
+        slowOperation.postOperation = std::move(postOperation);
         if(showIndicator) {
             mProgressIndicator.setGeometryInProgress(mGeometry);
         }
-        dispatchAsync([operation, postOperation, this]() {
-            sThreadPool.enqueue([operation, postOperation, this]() {
-                operation();
-                dispatchAsync([postOperation, this]() {
-                    postOperation();
-                    mProgressIndicator.setGeometryInProgress(nullptr);
-                });
-            });
-        });
+        pushSlowOperation(std::move(slowOperation));
+    }
+
+    /// Undoes the last command in a slow operation. Presses while an undo or redo is waiting for another operation
+    /// are added to it, so the CommandManager replays the commands only once up to the final state.
+    void undo() {
+        enqueueHistoryMove(-1);
+    }
+
+    /// Redoes the next command in a slow operation, see undo()
+    void redo() {
+        enqueueHistoryMove(1);
     }
 
     /// Returns the path to the current Geometry file.
@@ -276,11 +410,69 @@ class MainApplication : public cinder::app::App {
     }
 
    private:
+    struct SlowOperation {
+        SlowOperationKind kind = SlowOperationKind::Other;
+        bool showIndicator = true;
+        std::function<void(const std::atomic<bool>*)> operation;
+        std::function<void()> postOperation;
+
+        /// Set to cancel the operation, null if it cannot be cancelled
+        std::shared_ptr<std::atomic<bool>> isCancelled;
+
+        /// Ready once the operation returns, set when it starts
+        std::future<void> task;
+    };
+
+    /// Drops the pending operation replaced by the new one and starts the new one once the others are finished
+    void pushSlowOperation(SlowOperation&& slowOperation);
+
+    /// Starts the first pending operation, unless an operation is running
+    void startNextSlowOperation();
+
+    /// Runs the post operation of the running operation unless it is cancelled and starts the next one
+    void finishSlowOperation();
+
+    bool isWarmUpRunning() const {
+        return mRunningSlowOperation && mRunningSlowOperation->kind == SlowOperationKind::WarmUp;
+    }
+
+    /// Starts the next step of the warm-up once the user is idle for a while and no operation is in progress.
+    /// The steps check whether their data is valid, so the data changed by a command is computed again.
+    void updateWarmUp();
+
+    /// Cancels the warm-up and waits for it shortly, so that the input reaches the tools. A step that does not stop
+    /// in time shows the progress indicator, and the tools ignore the input until it finishes, as during any other
+    /// operation.
+    void preemptWarmUp();
+
+    /// Wakes the application up and preempts the warm-up, before any handler of an input event
+    void onInput();
+
+    /// Moves in the history by steps, negative for undo, in a pending History operation if there is one
+    void enqueueHistoryMove(long steps);
+
+    /// Saves the project into the path once the running slow operations are finished, see startProjectSave()
+    void saveProjectInBackground(const ci::fs::path& path);
+
+    /// Takes a snapshot of the current Geometry and writes it into the path on a worker, after the running save
+    void startProjectSave(const ci::fs::path& path);
+
+    /// Called in the main thread once the save of the Geometry finished, the error is empty if it succeeded
+    void finishProjectSave(const Geometry& geometry, const ci::fs::path& path, std::size_t version,
+                           const std::string& error);
+
+    /// Writes a checkpoint of the autosave on a worker if it needs one and the Geometry is not in use, see Autosave
+    void updateAutosave();
+
+    /// Replaces the autosave by one of the project path, the CommandManager is in the state of the savedVersion there
+    void resetAutosave(const ci::fs::path& path, std::size_t savedVersion);
+
     /// Setups Cinder logging (warnings and errors in Release) and FatalLogger.
     void setupLogging();
 
-    /// Setups ImGui fonts and FontStorage.
-    void setupFonts();
+    /// Setups ImGui fonts and FontStorage, building the font atlas on a worker.
+    /// The font texture has to be refreshed once the returned future is ready.
+    std::future<void> buildFontAtlas();
 
     /// Setups a WinAPI icon of the main window (only on Windows).
     void setupIcon();
@@ -291,6 +483,17 @@ class MainApplication : public cinder::app::App {
     /// Called when the main window becomes focused.
     void didBecomeActive();
 
+    /// Calls requestRedraw() if the Geometry has data to upload to the ModelView, an operation is in progress,
+    /// or a progress changed since the last frame.
+    void detectRedraw();
+
+    /// Switches to the idle frame rate when no redraw was requested for a while.
+    void updateFrameRate();
+
+    /// Sets the frame rate of the current state, the idle frame rate or the full frame rate, which is limited while
+    /// the window is not focused.
+    void applyFrameRate();
+
     /// Returns true if the main window is obscured by another window or windows (only on Windows).
     /// Window is obscured if one of the following is true:
     /// 1) if the window is minimized, and/or
@@ -310,6 +513,31 @@ class MainApplication : public cinder::app::App {
     bool mShouldSkipDraw = false;
     bool mIsFocused = true;
 
+    /// Started by update(), records the frame when draw() ends
+    std::unique_ptr<Profiler::ScopedTimer> mFrameTimer;
+
+    /// Measures the passes of ModelView and the rendering of ImGui
+    GpuTimer mGpuTimer;
+
+    int mIdleFrameRate = 5;
+    bool mIsIdle = false;
+    double mLastRedrawRequestTime = 0.0;
+    double mLastInputTime = 0.0;
+
+    bool mIsWarmUpEnabled = false;
+    bool mIsSdfWarmUpEnabled = false;
+
+    /// A step of the warm-up failed on this Geometry, it is not warmed up anymore
+    std::weak_ptr<Geometry> mWarmUpFailedGeometry;
+
+    /// Progress of the Geometry in the last frame, to request a redraw when it changes
+    GeometryProgress::Percentages mLastProgress{};
+    std::optional<float> mLastSdfRefinementProgress;
+
+    /// Null if the context has no compute shaders, set to Geometry while mIsSdfComputedOnGpu
+    std::shared_ptr<SdfGpuCalculator> mSdfGpuCalculator;
+    bool mIsSdfComputedOnGpu = true;
+
     ci::gl::FboRef mFramebuffer;  // we render Toolbar, ModelView, and SidePane to a framebuffer so that we can use it
                                   // in multithreading
 
@@ -336,11 +564,34 @@ class MainApplication : public cinder::app::App {
         mGeometryInProgress;  // used for async loading of Geometry, is nullptr if nothing is being loaded
     std::unique_ptr<CommandManager<Geometry>> mCommandManager;
 
+    /// Slow operations waiting for the running one, in the order they were scheduled
+    std::deque<SlowOperation> mPendingSlowOperations;
+    std::optional<SlowOperation> mRunningSlowOperation;
+
+    /// Steps of the pending History operation, changed only while it is pending
+    std::shared_ptr<long> mPendingHistorySteps;
+
+    /// Observer of mCommandManager while a session is being recorded
+    std::shared_ptr<SessionRecorder> mSessionRecorder;
+
+    /// Autosave of the project or the imported model, null for a model without a file.
+    /// Shared with the worker writing its checkpoint.
+    std::shared_ptr<Autosave> mAutosave;
+
+    /// Imported models stored with their derived data, see ImportCache
+    std::shared_ptr<ImportCache> mImportCache;
+
     std::string mGeometryFileName;
     bool mShouldSaveAs = true;
     std::size_t mLastVersionSaved = std::numeric_limits<std::size_t>::max();
     bool mIsGeometryDirty = false;
 
+    /// A project is being written on a worker, see startProjectSave()
+    bool mIsSavingProject = false;
+
+    /// Path of the save requested while another was running, the latest request wins
+    std::optional<ci::fs::path> mPendingProjectSavePath;
+
     static ::ThreadPool sThreadPool;
 };
 
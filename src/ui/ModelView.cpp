@@ -1,23 +1,43 @@
 #include "ModelView.h"
 #include "MainApplication.h"
+#include "Profiler.h"
 #include "geometry/Geometry.h"
 #include "tools/Tool.h"
 
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+
 namespace pepr3d {
 using namespace ci;
 
+namespace {
+/// Seconds after the last camera movement until large meshes are drawn in full resolution again
+const double CAMERA_MOVE_DURATION = 0.25;
+}  // namespace
+
 void ModelView::setup() {
     resetCamera();
     mCameraUi = pepr3d::CameraUi(&mCamera);
     resize();
 
-    mModelShader =
-        ci::gl::GlslProg::create(ci::gl::GlslProg::Format()
-                                     .vertex(ci::loadString(mApplication.loadRequiredAsset("shaders/ModelView.vert")))
-                                     .fragment(ci::loadString(mApplication.loadRequiredAsset("shaders/ModelView.frag")))
-                                     .attrib(Attributes::COLOR_IDX, "aColorIndex")
-                                     .attrib(Attributes::HIGHLIGHT_MASK, "aAreaHighlightMask"));
+    mModelShader = ci::gl::GlslProg::create(
+        ci::gl::GlslProg::Format()
+            .vertex(ci::loadString(mApplication.loadRequiredAsset("shaders/ModelView.vert")))
+            .geometry(ci::loadString(mApplication.loadRequiredAsset("shaders/ModelView.geom")))
+            .fragment(ci::loadString(mApplication.loadRequiredAsset("shaders/ModelView.frag"))));
     mModelShader->uniform("uPreviewMinMaxHeight", mPreviewMinMaxHeight);
+    mModelShader->uniform("uFaceColorIndices", static_cast<int>(TextureUnits::FACE_COLOR));
+    mModelShader->uniform("uFaceTriangles", static_cast<int>(TextureUnits::FACE_TRIANGLE));
+    mModelShader->uniform("uTriangleHighlightMask", static_cast<int>(TextureUnits::TRIANGLE_HIGHLIGHT));
+
+    mPickingShader = ci::gl::GlslProg::create(
+        ci::gl::GlslProg::Format()
+            .vertex(ci::loadString(mApplication.loadRequiredAsset("shaders/ModelViewPicking.vert")))
+            .fragment(ci::loadString(mApplication.loadRequiredAsset("shaders/ModelViewPicking.frag"))));
 }
 
 void ModelView::resize() {
@@ -37,44 +57,18 @@ void ModelView::draw() {
 
     updateModelMatrix();
 
-    drawGeometry();
-
-    if(!previewTriangles.empty()) {
-        // Create buffer layout
-        const std::vector<cinder::gl::VboMesh::Layout> layout = {
-            cinder::gl::VboMesh::Layout().usage(GL_STATIC_DRAW).attrib(ci::geom::Attrib::POSITION, 3),
-            cinder::gl::VboMesh::Layout().usage(GL_STATIC_DRAW).attrib(ci::geom::Attrib::NORMAL, 3),
-            cinder::gl::VboMesh::Layout().usage(GL_STATIC_DRAW).attrib(ci::geom::Attrib::COLOR, 4)};  // color index
-
-        // Create elementary buffer of indices
-        const cinder::gl::VboRef ibo = cinder::gl::Vbo::create(GL_ELEMENT_ARRAY_BUFFER, previewIndices, GL_STATIC_DRAW);
-
-        // Create the VBO mesh
-        auto myVboMesh = ci::gl::VboMesh::create(static_cast<uint32_t>(previewTriangles.size()), GL_TRIANGLES, {layout},
-                                                 static_cast<uint32_t>(previewIndices.size()), GL_UNSIGNED_INT, ibo);
-
-        // Assign the buffers to the attributes
-        myVboMesh->bufferAttrib<glm::vec3>(ci::geom::Attrib::POSITION, previewTriangles);
-        myVboMesh->bufferAttrib<glm::vec3>(ci::geom::Attrib::NORMAL, previewNormals);
-        myVboMesh->bufferAttrib<glm::vec4>(ci::geom::Attrib::COLOR, previewColors);
-
-        const ci::gl::ScopedModelMatrix scopedModelMatrix;
-        ci::gl::multModelMatrix(mModelMatrix);
-
-        // Create batch and draw
-        auto myBatch = ci::gl::Batch::create(myVboMesh, ci::gl::getStockShader(ci::gl::ShaderDef().color()));
-        myBatch->draw();
+    GpuTimer& gpuTimer = mApplication.getGpuTimer();
+    {
+        const GpuTimer::Scope gpuScope(gpuTimer, Profiler::Zone::GpuModel);
+        drawGeometry();
     }
-
-    if(mIsGridEnabled) {
-        ci::gl::ScopedModelMatrix modelScope;
-        ci::gl::multModelMatrix(glm::translate(glm::vec3(0.0f, mGridOffset, 0.0f)) *
-                                glm::scale(glm::vec3(0.9f)));  // i.e., new size is 2.0f * 0.9f = 1.8f
-        ci::gl::ScopedColor colorScope(ci::ColorA::black());
-        ci::gl::ScopedLineWidth widthScope(1.0f);
-        auto plane = ci::gl::Batch::create(ci::geom::WirePlane().subdivisions(glm::ivec2(18)),  // i.e., 1 cell = 0.1f
-                                           ci::gl::getStockShader(ci::gl::ShaderDef().color()));
-        plane->draw();
+    {
+        const GpuTimer::Scope gpuScope(gpuTimer, Profiler::Zone::GpuToolPreview);
+        drawToolPreview();
+    }
+    {
+        const GpuTimer::Scope gpuScope(gpuTimer, Profiler::Zone::GpuGrid);
+        drawGrid();
     }
 
     {
@@ -95,7 +89,10 @@ void ModelView::draw() {
 
         // let the active tool draw to the model view:
         auto& currentTool = **mApplication.getCurrentToolIterator();
-        currentTool.drawToModelView(*this);
+        {
+            const GpuTimer::Scope gpuScope(gpuTimer, Profiler::Zone::GpuToolOverlay);
+            currentTool.drawToModelView(*this);
+        }
 
         // end the dummy window:
         ImGui::End();
@@ -103,8 +100,170 @@ void ModelView::draw() {
     }
 }
 
+void ModelView::drawPreview(Geometry& geometry) {
+    // Override meshes are not the previewed geometry, keep the cached rendering
+    if(isMeshOverriden()) {
+        return;
+    }
+
+    {
+        const ci::gl::ScopedScissor scissor(mViewport.first, mViewport.second);
+        gl::clear(ColorA::hex(0xFCFCFC));
+    }
+
+    mPreviewGeometry = &geometry;
+    {
+        ci::gl::ScopedViewport viewport(mViewport.first, mViewport.second);
+        gl::ScopedMatrices push;
+        ci::gl::setMatrices(mCamera);
+        gl::ScopedDepth depth(true);
+
+        updateModelMatrix();
+        {
+            const GpuTimer::Scope gpuScope(mApplication.getGpuTimer(), Profiler::Zone::GpuModel);
+            drawGeometry();
+        }
+        {
+            const GpuTimer::Scope gpuScope(mApplication.getGpuTimer(), Profiler::Zone::GpuGrid);
+            drawGrid();
+        }
+    }
+    mPreviewGeometry = nullptr;
+
+    // Tools keep casting rays into the current geometry
+    updateModelMatrix();
+}
+
+bool ModelView::hasRenderSnapshot() const {
+    const Geometry* const geometry = mApplication.getCurrentGeometry();
+    return geometry != nullptr && mRenderSnapshot.geometry == geometry && mBufferedGeometry == geometry && mBatch &&
+           !isMeshOverriden();
+}
+
+void ModelView::drawSnapshot() {
+    assert(hasRenderSnapshot());
+    {
+        const ci::gl::ScopedScissor scissor(mViewport.first, mViewport.second);
+        gl::clear(ColorA::hex(0xFCFCFC));
+    }
+
+    ci::gl::ScopedViewport viewport(mViewport.first, mViewport.second);
+    gl::ScopedMatrices push;
+    ci::gl::setMatrices(mCamera);
+    gl::ScopedDepth depth(true);
+    updateModelMatrix(mRenderSnapshot.boundingBoxMin, mRenderSnapshot.boundingBoxMax);
+
+    // The area highlight belongs to the tools, which wait for the operation
+    const auto& colorMap = mRenderSnapshot.colorMap;
+    mModelShader->uniform("uColorPalette", &colorMap[0], static_cast<int>(colorMap.size()));
+    mModelShader->uniform("uShowWireframe", mIsWireframeEnabled);
+    mModelShader->uniform("uOverrideNormals", false);
+    mModelShader->uniform("uFaceColorsPerTriangle", false);
+    mModelShader->uniform("uAreaHighlightEnabled", false);
+
+    // The colors of the proxy are only up to date if the Geometry did not change since it was drawn
+    const bool isSimplifiedBatchValid = mSimplifiedBatch.batch && mSimplifiedBatch.geometry == mBufferedGeometry &&
+                                        !mSimplifiedBatch.areColorsDirty;
+    GpuTimer& gpuTimer = mApplication.getGpuTimer();
+    gpuTimer.begin(Profiler::Zone::GpuModel);
+    if(isSimplifiedBatchValid && isCameraMoving()) {
+        const ci::gl::ScopedModelMatrix scopedModelMatrix;
+        ci::gl::multModelMatrix(mModelMatrix);
+        mSimplifiedBatch.batch->draw();
+    } else {
+        const ci::gl::ScopedModelMatrix scopedModelMatrix;
+        ci::gl::multModelMatrix(mModelMatrix);
+        mFaceColorTexture->bindTexture(TextureUnits::FACE_COLOR);
+        mFaceTriangleTexture->bindTexture(TextureUnits::FACE_TRIANGLE);
+        mTriangleHighlightTexture->bindTexture(TextureUnits::TRIANGLE_HIGHLIGHT);
+        drawVisibleFaces(mRenderSnapshot.faceCount);
+        mFaceColorTexture->unbindTexture(TextureUnits::FACE_COLOR);
+        mFaceTriangleTexture->unbindTexture(TextureUnits::FACE_TRIANGLE);
+        mTriangleHighlightTexture->unbindTexture(TextureUnits::TRIANGLE_HIGHLIGHT);
+    }
+
+    gpuTimer.end();
+
+    // E.g., the text being painted
+    {
+        const GpuTimer::Scope gpuScope(gpuTimer, Profiler::Zone::GpuToolPreview);
+        drawToolPreview();
+    }
+    {
+        const GpuTimer::Scope gpuScope(gpuTimer, Profiler::Zone::GpuGrid);
+        drawGrid();
+    }
+}
+
+void ModelView::drawToolPreview() {
+    if(mToolPreview.vertexBuffer.empty()) {
+        return;
+    }
+
+    if(!mToolPreview.batch) {
+        // Create buffer layout
+        const std::vector<cinder::gl::VboMesh::Layout> layout = {
+            cinder::gl::VboMesh::Layout().usage(GL_STATIC_DRAW).attrib(ci::geom::Attrib::POSITION, 3),
+            cinder::gl::VboMesh::Layout().usage(GL_STATIC_DRAW).attrib(ci::geom::Attrib::NORMAL, 3),
+            cinder::gl::VboMesh::Layout().usage(GL_STATIC_DRAW).attrib(ci::geom::Attrib::COLOR, 4)};  // color index
+
+        // Create elementary buffer of indices
+        const cinder::gl::VboRef ibo =
+            cinder::gl::Vbo::create(GL_ELEMENT_ARRAY_BUFFER, mToolPreview.indexBuffer, GL_STATIC_DRAW);
+
+        // Create the VBO mesh
+        auto vboMesh = ci::gl::VboMesh::create(static_cast<uint32_t>(mToolPreview.vertexBuffer.size()), GL_TRIANGLES,
+                                               {layout}, static_cast<uint32_t>(mToolPreview.indexBuffer.size()),
+                                               GL_UNSIGNED_INT, ibo);
+
+        // Assign the buffers to the attributes
+        vboMesh->bufferAttrib<glm::vec3>(ci::geom::Attrib::POSITION, mToolPreview.vertexBuffer);
+        vboMesh->bufferAttrib<glm::vec3>(ci::geom::Attrib::NORMAL, mToolPreview.normalBuffer);
+        vboMesh->bufferAttrib<glm::vec4>(ci::geom::Attrib::COLOR, mToolPreview.colorBuffer);
+        countUpload(mToolPreview.indexBuffer);
+        countUpload(mToolPreview.vertexBuffer);
+        countUpload(mToolPreview.normalBuffer);
+        countUpload(mToolPreview.colorBuffer);
+
+        mToolPreview.batch = ci::gl::Batch::create(vboMesh, ci::gl::getStockShader(ci::gl::ShaderDef().color()));
+    }
+
+    const ci::gl::ScopedModelMatrix scopedModelMatrix;
+    ci::gl::multModelMatrix(mModelMatrix);
+    mToolPreview.batch->draw();
+}
+
+void ModelView::drawGrid() {
+    if(mIsGridEnabled) {
+        if(!mGridBatch) {
+            mGridBatch = ci::gl::Batch::create(ci::geom::WirePlane().subdivisions(glm::ivec2(18)),  // 1 cell = 0.1f
+                                               ci::gl::getStockShader(ci::gl::ShaderDef().color()));
+        }
+
+        ci::gl::ScopedModelMatrix modelScope;
+        ci::gl::multModelMatrix(glm::translate(glm::vec3(0.0f, mGridOffset, 0.0f)) *
+                                glm::scale(glm::vec3(0.9f)));  // i.e., new size is 2.0f * 0.9f = 1.8f
+        ci::gl::ScopedColor colorScope(ci::ColorA::black());
+        ci::gl::ScopedLineWidth widthScope(1.0f);
+        mGridBatch->draw();
+    }
+}
+
+Tool* ModelView::getInputTool() {
+    // The camera can be used with a previewed geometry or a snapshot, but the tools wait for the operation
+    if(mApplication.isOperationInProgress()) {
+        return nullptr;
+    }
+    return mApplication.getCurrentTool();
+}
+
+Geometry* ModelView::getDisplayedGeometry() const {
+    return mPreviewGeometry != nullptr ? mPreviewGeometry : mApplication.getCurrentGeometry();
+}
+
 void ModelView::onMouseDown(MouseEvent event) {
-    auto* tool = mApplication.getCurrentTool();
+    dispatchMouseEvents();
+    auto* tool = getInputTool();
     if(tool) {
         tool->onModelViewMouseDown(*this, event);
     }
@@ -113,17 +272,24 @@ void ModelView::onMouseDown(MouseEvent event) {
 }
 
 void ModelView::onMouseDrag(MouseEvent event) {
-    auto* tool = mApplication.getCurrentTool();
-    if(tool) {
-        tool->onModelViewMouseDrag(*this, event);
+    // The Tool gets the latest drag once per frame, the camera follows every event
+    if(mPendingDragEvent &&
+       (mPendingDragPositions.empty() || mPendingDragPositions.back() != mPendingDragEvent->getPos())) {
+        mPendingDragPositions.push_back(mPendingDragEvent->getPos());
     }
+    mPendingDragEvent = event;
+
     bool shouldPan = event.isMiddleDown() || (event.isControlDown() && event.isRightDown());
     bool shouldTumble = !shouldPan && event.isRightDown();
     mCameraUi.mouseDrag(event.getPos(), shouldTumble, shouldPan, false /* should zoom */);
+    if(shouldTumble || shouldPan) {
+        mLastCameraMoveTime = mApplication.getElapsedSeconds();
+    }
 }
 
 void ModelView::onMouseUp(MouseEvent event) {
-    auto* tool = mApplication.getCurrentTool();
+    dispatchMouseEvents();
+    auto* tool = getInputTool();
     if(tool) {
         tool->onModelViewMouseUp(*this, event);
     }
@@ -131,18 +297,38 @@ void ModelView::onMouseUp(MouseEvent event) {
 }
 
 void ModelView::onMouseWheel(MouseEvent event) {
-    auto* tool = mApplication.getCurrentTool();
+    dispatchMouseEvents();
+    auto* tool = getInputTool();
     if(tool) {
         tool->onModelViewMouseWheel(*this, event);
     }
     mCameraUi.mouseWheel(-event.getWheelIncrement());
+    mLastCameraMoveTime = mApplication.getElapsedSeconds();
 }
 
 void ModelView::onMouseMove(MouseEvent event) {
-    auto* tool = mApplication.getCurrentTool();
+    mPendingMoveEvent = event;
+}
+
+void ModelView::dispatchMouseEvents() {
+    // Taken first, the Tool may send events to itself
+    const std::optional<MouseEvent> moveEvent = std::move(mPendingMoveEvent);
+    const std::optional<MouseEvent> dragEvent = std::move(mPendingDragEvent);
+    mPendingMoveEvent.reset();
+    mPendingDragEvent.reset();
+    mCoalescedDragPositions.swap(mPendingDragPositions);
+    mPendingDragPositions.clear();
+
+    auto* tool = getInputTool();
     if(tool) {
-        tool->onModelViewMouseMove(*this, event);
+        if(moveEvent) {
+            tool->onModelViewMouseMove(*this, *moveEvent);
+        }
+        if(dragEvent) {
+            tool->onModelViewMouseDrag(*this, *dragEvent);
+        }
     }
+    mCoalescedDragPositions.clear();
 }
 
 void ModelView::resetCamera() {
@@ -150,38 +336,9 @@ void ModelView::resetCamera() {
     mCamera.setFov(35.0f);
 }
 
-void ModelView::initOverrideFromBasicGeoemtry() {
-    const Geometry* geometry = mApplication.getCurrentGeometry();
-    assert(geometry);
-
-    auto& overrideVertexBuffer = getOverrideVertexBuffer();
-    auto& overrideNormalBuffer = getOverrideNormalBuffer();
-    auto& overrideIndexBuffer = getOverrideIndexBuffer();
-    auto& overrideColorBuffer = getOverrideColorBuffer();
-
-    overrideVertexBuffer.clear();
-    overrideNormalBuffer.clear();
-    overrideIndexBuffer.clear();
-    const size_t triCount = geometry->getTriangleCount();
-    for(size_t i = 0; i < triCount; ++i) {
-        const DataTriangle& tri = geometry->getTriangle(i);
-        overrideVertexBuffer.push_back(tri.getVertex(0));
-        overrideVertexBuffer.push_back(tri.getVertex(1));
-        overrideVertexBuffer.push_back(tri.getVertex(2));
-
-        overrideNormalBuffer.push_back(tri.getNormal());
-        overrideNormalBuffer.push_back(tri.getNormal());
-        overrideNormalBuffer.push_back(tri.getNormal());
-
-        const glm::vec4 triColor = geometry->getColorManager().getColor(geometry->getTriangle(i).getColor());
-        overrideColorBuffer.push_back(triColor);
-        overrideColorBuffer.push_back(triColor);
-        overrideColorBuffer.push_back(triColor);
-
-        overrideIndexBuffer.push_back(static_cast<uint32_t>(overrideIndexBuffer.size()));
-        overrideIndexBuffer.push_back(static_cast<uint32_t>(overrideIndexBuffer.size()));
-        overrideIndexBuffer.push_back(static_cast<uint32_t>(overrideIndexBuffer.size()));
-    }
+void ModelView::initOverrideFromGeometry() {
+    setOverrideMesh(nullptr);
+    getOverrideFaceColorBuffer().clear();
 }
 
 void ModelView::onNewGeometryLoaded() {
@@ -196,57 +353,279 @@ void ModelView::onNewGeometryLoaded() {
     const glm::vec3 aabbSize = aabbMax - aabbMin;
     const float maxSize = glm::max(glm::max(aabbSize.x, aabbSize.y), aabbSize.z);
     mMaxSize = maxSize;
+
+    mSimplifiedBatch = {};
+    mRenderSnapshot = {};
+    mPickCache = {};
 }
 
 void ModelView::updateVboAndBatch() {
-    const Geometry::OpenGlData& glData = mApplication.getCurrentGeometry()->getOpenGlData();
-    assert(isMeshOverriden() || !glData.isDirty);
+    const Geometry::OpenGlData& glData = getDisplayedGeometry()->getOpenGlData();
+    assert(hasOverrideMesh() || !glData.isDirty);
 
-    if(isMeshOverriden()) {
-        // All override buffer sizes must match
-        assert(mMeshOverride.overrideVertexBuffer.size() == mMeshOverride.overrideColorBuffer.size());
-        assert(mMeshOverride.overrideVertexBuffer.size() == mMeshOverride.overrideNormalBuffer.size());
-        assert(mMeshOverride.overrideVertexBuffer.size() == mMeshOverride.overrideIndexBuffer.size());
+    if(hasOverrideMesh()) {
+        // All override buffer sizes must match, the faces are colored through the override palette
+        const OverrideMesh& mesh = *mMeshOverride.mesh;
+        assert(mesh.vertexBuffer.size() == mesh.normalBuffer.size());
+        assert(3 * mMeshOverride.overrideFaceColorBuffer.size() == mesh.indexBuffer.size());
+
+        // Create buffer layout, override meshes come with their own normals
+        const std::vector<cinder::gl::VboMesh::Layout> layout = {
+            cinder::gl::VboMesh::Layout().usage(GL_STATIC_DRAW).attrib(ci::geom::Attrib::POSITION, 3),
+            cinder::gl::VboMesh::Layout().usage(GL_STATIC_DRAW).attrib(ci::geom::Attrib::NORMAL, 3)};
+
+        // Create elementary buffer of indices
+        const cinder::gl::VboRef ibo =
+            cinder::gl::Vbo::create(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer, GL_STATIC_DRAW);
+
+        // Create the VBO mesh
+        mVboMesh = ci::gl::VboMesh::create(static_cast<uint32_t>(mesh.vertexBuffer.size()), GL_TRIANGLES, {layout},
+                                           static_cast<uint32_t>(mesh.indexBuffer.size()), GL_UNSIGNED_INT, ibo);
+
+        // Assign the buffers to the attributes
+        mVboMesh->bufferAttrib<glm::vec3>(ci::geom::Attrib::POSITION, mesh.vertexBuffer);
+        mVboMesh->bufferAttrib<glm::vec3>(ci::geom::Attrib::NORMAL, mesh.normalBuffer);
+        countUpload(mesh.indexBuffer);
+        countUpload(mesh.vertexBuffer);
+        countUpload(mesh.normalBuffer);
+        mMeshOverride.isDirty = false;
+        mVboCapacity = 0;  // override buffers cannot be reused by the geometry
+    } else {
+        const size_t vertexCount = glData.vertexBuffer.size();
+        const size_t faceCount = glData.colorBuffer.size();
+        allocateGeometryBuffers(vertexCount, faceCount);
+        uploadGeometryVertices({0, vertexCount});
+        uploadGeometryFaces({0, faceCount});
+        updateHighlightTextureCapacity();
+        glData.info.unsetColorFlag();
+        glData.info.unsetHighlightFlag();
     }
 
-    // Create buffer layout
+    createBatches();
+}
+
+void ModelView::allocateGeometryBuffers(const size_t vertexCount, const size_t faceCount) {
+    // Leave space for the geometry to grow while painting, so that the buffers can stay alive
+    mVboCapacity = vertexCount + vertexCount / 4;
+    mFaceCapacity = faceCount + faceCount / 4;
+
+    // Only positions are per vertex, normals are computed and colors fetched per face in the geometry shader
     const std::vector<cinder::gl::VboMesh::Layout> layout = {
-        cinder::gl::VboMesh::Layout().usage(GL_STATIC_DRAW).attrib(ci::geom::Attrib::POSITION, 3),
-        cinder::gl::VboMesh::Layout().usage(GL_STATIC_DRAW).attrib(ci::geom::Attrib::NORMAL, 3),
-        cinder::gl::VboMesh::Layout().usage(GL_STATIC_DRAW).attrib(ci::geom::Attrib::COLOR, 4),
-        cinder::gl::VboMesh::Layout().usage(GL_STATIC_DRAW).attrib(Attributes::COLOR_IDX, 1),
-        cinder::gl::VboMesh::Layout().usage(GL_STATIC_DRAW).attrib(Attributes::HIGHLIGHT_MASK, 1)};
+        cinder::gl::VboMesh::Layout().usage(GL_DYNAMIC_DRAW).attrib(ci::geom::Attrib::POSITION, 3)};
 
     // Create elementary buffer of indices
     const cinder::gl::VboRef ibo = cinder::gl::Vbo::create(
-        GL_ELEMENT_ARRAY_BUFFER, isMeshOverriden() ? getOverrideIndexBuffer() : glData.indexBuffer, GL_STATIC_DRAW);
+        GL_ELEMENT_ARRAY_BUFFER, 3 * mFaceCapacity * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
 
     // Create the VBO mesh
-    mVboMesh = ci::gl::VboMesh::create(
-        static_cast<uint32_t>(isMeshOverriden() ? getOverrideVertexBuffer().size() : glData.vertexBuffer.size()),
-        GL_TRIANGLES, {layout},
-        static_cast<uint32_t>(isMeshOverriden() ? getOverrideVertexBuffer().size() : glData.vertexBuffer.size()),
-        GL_UNSIGNED_INT, ibo);
-
-    // Assign the buffers to the attributes
-    mVboMesh->bufferAttrib<glm::vec3>(ci::geom::Attrib::POSITION,
-                                      isMeshOverriden() ? getOverrideVertexBuffer() : glData.vertexBuffer);
-    mVboMesh->bufferAttrib<glm::vec3>(ci::geom::Attrib::NORMAL,
-                                      isMeshOverriden() ? getOverrideNormalBuffer() : glData.normalBuffer);
-    mVboMesh->bufferAttrib<glm::vec4>(ci::geom::Attrib::COLOR, mMeshOverride.overrideColorBuffer);
-    mVboMesh->bufferAttrib<Geometry::ColorIndex>(Attributes::COLOR_IDX, glData.colorBuffer);
-    mVboMesh->bufferAttrib<GLint>(Attributes::HIGHLIGHT_MASK, glData.highlightMask);
+    mVboMesh = ci::gl::VboMesh::create(static_cast<uint32_t>(mVboCapacity), GL_TRIANGLES, {layout},
+                                       static_cast<uint32_t>(3 * mFaceCapacity), GL_UNSIGNED_INT, ibo);
+
+    // Per-face data is indexed by gl_PrimitiveIDIn
+    mFaceColorTexture = ci::gl::BufferTexture::create(nullptr, mFaceCapacity * sizeof(Geometry::ColorIndex),
+                                                      GL_R8UI, GL_DYNAMIC_DRAW);
+    mFaceTriangleTexture =
+        ci::gl::BufferTexture::create(nullptr, mFaceCapacity * sizeof(GLuint), GL_R32UI, GL_DYNAMIC_DRAW);
+
+    // The highlight is allocated by updateHighlightTextureCapacity()
+    mTriangleHighlightTexture = nullptr;
+    mHighlightCapacity = 0;
+}
+
+void ModelView::updateHighlightTextureCapacity() {
+    // The highlight is indexed by base triangles, their number does not change while painting
+    const Geometry::OpenGlData& glData = getDisplayedGeometry()->getOpenGlData();
+    if(mTriangleHighlightTexture && glData.highlightMask.size() <= mHighlightCapacity) {
+        return;
+    }
+    mHighlightCapacity = std::max<size_t>(glData.highlightMask.size(), 1);
+    mTriangleHighlightTexture =
+        ci::gl::BufferTexture::create(nullptr, mHighlightCapacity * sizeof(GLuint), GL_R32UI, GL_DYNAMIC_DRAW);
+    bufferRange(mTriangleHighlightTexture->getBufferObj(), glData.highlightMask, {0, glData.highlightMask.size()});
+}
 
+void ModelView::createBatches() {
+    mBufferedGeometry = getDisplayedGeometry();
     mBatch = ci::gl::Batch::create(mVboMesh, mModelShader);
+    mPickingBatch = hasOverrideMesh() ? nullptr : ci::gl::Batch::create(mVboMesh, mPickingShader);
+    mIsPickingBufferDirty = true;
+}
+
+bool ModelView::MappedGeometryBuffers::map(const size_t vertexCount, const size_t faceCount) {
+    ModelView& view = mModelView;
+    // Mapped again while the buffers are written, e.g., when the Geometry regenerates them after they had to grow
+    const bool fits = vertexCount <= view.mVboCapacity && faceCount <= view.mFaceCapacity;
+    if(mVertices != nullptr && fits) {
+        return true;
+    }
+    unmapBuffers();
+
+    // Override meshes leave no capacity for the Geometry
+    const bool isKept = view.mVboMesh && view.mVboCapacity > 0 && fits;
+    if(!isKept) {
+        view.allocateGeometryBuffers(vertexCount, faceCount);
+        mWereAllocated = true;
+    }
+
+    // The Geometry rewrites only parts of the buffers, the rest has to be kept, and only those parts are flushed
+    const GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT;
+    mVertices = static_cast<glm::vec3*>(view.getAttribVbo(ci::geom::Attrib::POSITION)
+                                            ->mapBufferRange(0, view.mVboCapacity * sizeof(glm::vec3), access));
+    mIndices = static_cast<uint32_t*>(
+        view.mVboMesh->getIndexVbo()->mapBufferRange(0, 3 * view.mFaceCapacity * sizeof(uint32_t), access));
+    mFaceTriangles = static_cast<GLuint*>(
+        view.mFaceTriangleTexture->getBufferObj()->mapBufferRange(0, view.mFaceCapacity * sizeof(GLuint), access));
+    if(mVertices == nullptr || mIndices == nullptr || mFaceTriangles == nullptr) {
+        unmapBuffers();
+        throw std::runtime_error("Could not map the GPU buffers of the model.");
+    }
+    return isKept;
+}
+
+void ModelView::MappedGeometryBuffers::unmap(const std::vector<std::pair<size_t, size_t>>& vertexRanges,
+                                             const std::vector<std::pair<size_t, size_t>>& faceRanges) {
+    if(mVertices == nullptr) {
+        return;
+    }
+
+    using Ranges = std::vector<std::pair<size_t, size_t>>;
+    const auto flushRanges = [](const ci::gl::BufferObjRef& buffer, const Ranges& ranges, const size_t elementSize) {
+        const ci::gl::ScopedBuffer scopedBuffer(buffer);
+        for(const auto& range : ranges) {
+            if(range.first < range.second) {
+                glFlushMappedBufferRange(buffer->getTarget(), range.first * elementSize,
+                                         (range.second - range.first) * elementSize);
+                Profiler::count(Profiler::Counter::UploadedBytes, (range.second - range.first) * elementSize);
+            }
+        }
+    };
+    Ranges indexRanges;
+    for(const auto& range : faceRanges) {
+        indexRanges.emplace_back(3 * range.first, 3 * range.second);
+    }
+    ModelView& view = mModelView;
+    flushRanges(view.getAttribVbo(ci::geom::Attrib::POSITION), vertexRanges, sizeof(glm::vec3));
+    flushRanges(view.mVboMesh->getIndexVbo(), indexRanges, sizeof(uint32_t));
+    flushRanges(view.mFaceTriangleTexture->getBufferObj(), faceRanges, sizeof(GLuint));
+    unmapBuffers();
+}
+
+void ModelView::MappedGeometryBuffers::unmapBuffers() {
+    if(mVertices != nullptr) {
+        mModelView.getAttribVbo(ci::geom::Attrib::POSITION)->unmap();
+    }
+    if(mIndices != nullptr) {
+        mModelView.mVboMesh->getIndexVbo()->unmap();
+    }
+    if(mFaceTriangles != nullptr) {
+        mModelView.mFaceTriangleTexture->getBufferObj()->unmap();
+    }
+    mVertices = nullptr;
+    mIndices = nullptr;
+    mFaceTriangles = nullptr;
+}
+
+void ModelView::uploadOverrideFaceColors() {
+    const std::vector<Geometry::ColorIndex>& faceColors = mMeshOverride.overrideFaceColorBuffer;
+    if(!mOverrideFaceColorTexture || faceColors.size() > mOverrideFaceCapacity) {
+        mOverrideFaceCapacity = std::max<size_t>(faceColors.size(), 1);
+        mOverrideFaceColorTexture = ci::gl::BufferTexture::create(
+            nullptr, mOverrideFaceCapacity * sizeof(Geometry::ColorIndex), GL_R8UI, GL_DYNAMIC_DRAW);
+    }
+    bufferRange(mOverrideFaceColorTexture->getBufferObj(), faceColors, {0, faceColors.size()});
+    mMeshOverride.areFaceColorsDirty = false;
+}
+
+void ModelView::uploadGeometryFaces(const std::pair<size_t, size_t>& range) {
+    const Geometry::OpenGlData& glData = getDisplayedGeometry()->getOpenGlData();
+    assert(mVboMesh && mFaceColorTexture && mFaceTriangleTexture);
+    assert(!hasOverrideMesh());
+    assert(range.second <= mFaceCapacity);
+
+    if(!glData.isMapped) {
+        bufferRange(mVboMesh->getIndexVbo(), glData.indexBuffer, {3 * range.first, 3 * range.second});
+        bufferRange(mFaceTriangleTexture->getBufferObj(), glData.faceTriangles, range);
+    }
+    bufferRange(mFaceColorTexture->getBufferObj(), glData.colorBuffer, range);
+    updateFaceChunkBounds(range);
+}
+
+void ModelView::updateFaceChunkBounds(const std::pair<size_t, size_t>& range) {
+    // The bounds come from the triangles, the vertices and indices may be only in the GPU buffers
+    const Geometry* const geometry = getDisplayedGeometry();
+    const size_t faceCount = geometry->getOpenGlData().faceCount;
+    mFaceChunkBounds.resize((faceCount + FACE_CHUNK_SIZE - 1) / FACE_CHUNK_SIZE);
+
+    const size_t chunkEnd = std::min((range.second + FACE_CHUNK_SIZE - 1) / FACE_CHUNK_SIZE, mFaceChunkBounds.size());
+    for(size_t chunk = range.first / FACE_CHUNK_SIZE; chunk < chunkEnd; ++chunk) {
+        // An empty box is never visible, unused faces are degenerate and do not enlarge the box
+        const size_t faceEnd = std::min(faceCount, (chunk + 1) * FACE_CHUNK_SIZE);
+        mFaceChunkBounds[chunk] = geometry->getOpenGlFaceBounds(chunk * FACE_CHUNK_SIZE, faceEnd);
+    }
+}
+
+std::vector<std::pair<size_t, size_t>> ModelView::getVisibleFaceRanges(const size_t faceCount) const {
+    const glm::mat4 modelViewProjection = getModelViewProjection();
+    const auto isVisible = [&modelViewProjection](const std::pair<glm::vec3, glm::vec3>& box) {
+        if(box.first.x > box.second.x) {
+            return false;
+        }
+        // The box is outside if all of its corners are outside of the same clipping plane
+        std::array<int, 6> outsideCorners{};
+        for(int corner = 0; corner < 8; ++corner) {
+            const glm::vec4 clip = modelViewProjection * glm::vec4((corner & 1) ? box.second.x : box.first.x,
+                                                                   (corner & 2) ? box.second.y : box.first.y,
+                                                                   (corner & 4) ? box.second.z : box.first.z, 1.0f);
+            for(int axis = 0; axis < 3; ++axis) {
+                outsideCorners[2 * axis] += clip[axis] < -clip.w ? 1 : 0;
+                outsideCorners[2 * axis + 1] += clip[axis] > clip.w ? 1 : 0;
+            }
+        }
+        return std::none_of(outsideCorners.begin(), outsideCorners.end(), [](int count) { return count == 8; });
+    };
+
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for(size_t chunk = 0; chunk * FACE_CHUNK_SIZE < faceCount; ++chunk) {
+        // Faces without bounds yet are drawn
+        if(chunk < mFaceChunkBounds.size() && !isVisible(mFaceChunkBounds[chunk])) {
+            continue;
+        }
+        const size_t begin = chunk * FACE_CHUNK_SIZE;
+        const size_t end = std::min(faceCount, begin + FACE_CHUNK_SIZE);
+        if(!ranges.empty() && ranges.back().second == begin) {
+            ranges.back().second = end;
+        } else {
+            ranges.emplace_back(begin, end);
+        }
+    }
+    return ranges;
+}
+
+void ModelView::uploadGeometryVertices(const std::pair<size_t, size_t>& range) {
+    const Geometry::OpenGlData& glData = getDisplayedGeometry()->getOpenGlData();
+    assert(mVboMesh);
+    assert(!hasOverrideMesh() && !glData.isMapped);
+    assert(range.second <= mVboCapacity);
+
+    bufferRange(getAttribVbo(ci::geom::Attrib::POSITION), glData.vertexBuffer, range);
+}
+
+ci::gl::VboRef ModelView::getAttribVbo(ci::geom::Attrib attrib) const {
+    assert(mVboMesh);
+    const auto* layoutVbo = mVboMesh->findAttrib(attrib);
+    assert(layoutVbo != nullptr);
+    return layoutVbo->second;
 }
 
 void ModelView::updateModelMatrix() {
-    const Geometry* const geometry = mApplication.getCurrentGeometry();
+    const Geometry* const geometry = getDisplayedGeometry();
     if(!geometry) {
         return;
     }
-    const glm::vec3 aabbMin = geometry->getBoundingBoxMin();
-    const glm::vec3 aabbMax = geometry->getBoundingBoxMax();
+    updateModelMatrix(geometry->getBoundingBoxMin(), geometry->getBoundingBoxMax());
+}
+
+void ModelView::updateModelMatrix(const glm::vec3& aabbMin, const glm::vec3& aabbMax) {
     const glm::vec3 aabbSize = aabbMax - aabbMin;
     const float maxSize = glm::max(glm::max(aabbSize.x, aabbSize.y), aabbSize.z);
     mMaxSize = maxSize;
@@ -293,59 +672,388 @@ ci::Ray ModelView::getRayFromWindowCoordinates(glm::ivec2 windowCoords) const {
     return ray;
 }
 
+float ModelView::getPixelsPerUnit(const glm::vec3& point) const {
+    // The model matrix scales uniformly, the height of the view grows with the depth of the point
+    const glm::mat4 modelView = mCamera.getViewMatrix() * mModelMatrix;
+    const float depth = std::max(-(modelView * glm::vec4(point, 1)).z, mCamera.getNearClip());
+    const float viewHeight = 2.f * depth * std::tan(glm::radians(mCamera.getFov()) / 2.f);
+    return glm::length(glm::vec3(modelView[0])) * static_cast<float>(mViewport.second.y) / viewHeight;
+}
+
+size_t ModelView::getGpuMemorySize() const {
+    size_t memorySize = 0;
+    for(const ci::gl::VboMeshRef& vboMesh : {mVboMesh, mSimplifiedBatch.vboMesh}) {
+        if(!vboMesh) {
+            continue;
+        }
+        for(const auto& layoutVbo : vboMesh->getVertexArrayLayoutVbos()) {
+            memorySize += layoutVbo.second->getSize();
+        }
+        if(vboMesh->getIndexVbo()) {
+            memorySize += vboMesh->getIndexVbo()->getSize();
+        }
+    }
+    for(const ci::gl::BufferTextureRef& texture :
+        {mFaceColorTexture, mFaceTriangleTexture, mTriangleHighlightTexture}) {
+        if(texture) {
+            memorySize += texture->getBufferObj()->getSize();
+        }
+    }
+    return memorySize;
+}
+
+bool ModelView::canPickTriangles() const {
+    const Geometry* const geometry = mApplication.getCurrentGeometry();
+    // The GPU buffers of a dirty geometry show its previous state
+    return mIsPickingEnabled && geometry != nullptr && mPickingBatch && !hasOverrideMesh() &&
+           mBufferedGeometry == geometry && !geometry->getOpenGlData().isDirty;
+}
+
+std::optional<DetailedTriangleId> ModelView::pickTriangle(glm::ivec2 windowCoords) {
+    assert(canPickTriangles());
+    const Profiler::ScopedTimer timer(Profiler::Zone::Picking);
+
+    // Framebuffer rows go from the bottom, the viewport is below the toolbar
+    const glm::ivec2 pixel(windowCoords.x,
+                           mViewport.second.y - 1 - (windowCoords.y - mApplication.getToolbar().getHeight()));
+    if(pixel.x < 0 || pixel.y < 0 || pixel.x >= mViewport.second.x || pixel.y >= mViewport.second.y) {
+        return {};
+    }
+
+    if(mIsPickingBufferDirty || !mPickingFbo || mPickingFbo->getSize() != mViewport.second ||
+       mPickingMatrix != getModelViewProjection()) {
+        updatePickingBuffer();
+    }
+
+    GLuint faceId = 0;
+    const ci::gl::ScopedFramebuffer scopedFramebuffer(mPickingFbo);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glReadPixels(pixel.x, pixel.y, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, &faceId);
+    if(faceId == 0) {
+        return {};
+    }
+    return mApplication.getCurrentGeometry()->getTriangleIdOfFace(faceId - 1);
+}
+
+ModelView::PickCache& ModelView::getPickCache(const ci::Ray& ray) {
+    const Geometry* const geometry = mApplication.getCurrentGeometry();
+    const CommandManager<Geometry>* const commandManager = mApplication.getCommandManager();
+    const size_t geometryVersion = commandManager != nullptr ? commandManager->getVersionNumber() : 0;
+    const uint32_t frame = mApplication.getElapsedFrames();
+    if(mPickCache.frame != frame || mPickCache.geometry != geometry || mPickCache.geometryVersion != geometryVersion ||
+       mPickCache.rayOrigin != ray.getOrigin() || mPickCache.rayDirection != ray.getDirection()) {
+        mPickCache = {};
+        mPickCache.frame = frame;
+        mPickCache.geometry = geometry;
+        mPickCache.geometryVersion = geometryVersion;
+        mPickCache.rayOrigin = ray.getOrigin();
+        mPickCache.rayDirection = ray.getDirection();
+    }
+    return mPickCache;
+}
+
+std::optional<size_t> ModelView::pickBaseTriangle(glm::ivec2 windowCoords, glm::vec3* outPosition) {
+    const Geometry* const geometry = mApplication.getCurrentGeometry();
+    assert(geometry != nullptr);
+    const ci::Ray ray = getRayFromWindowCoordinates(windowCoords);
+    PickCache& cache = getPickCache(ray);
+    if(!cache.hasBaseTriangle) {
+        glm::vec3 position(0.0f);
+        cache.baseTriangle = geometry->intersectMesh(ray, position);
+        cache.basePosition = position;
+        cache.hasBaseTriangle = true;
+    }
+    if(cache.baseTriangle && outPosition != nullptr) {
+        *outPosition = cache.basePosition;
+    }
+    return cache.baseTriangle;
+}
+
+std::optional<DetailedTriangleId> ModelView::pickDetailedTriangle(glm::ivec2 windowCoords) {
+    Geometry* const geometry = mApplication.getCurrentGeometry();
+    assert(geometry != nullptr);
+    const ci::Ray ray = getRayFromWindowCoordinates(windowCoords);
+    PickCache& cache = getPickCache(ray);
+    const CommandManager<Geometry>* const commandManager = mApplication.getCommandManager();
+    const bool isStrokeInProgress = commandManager != nullptr && commandManager->isStrokeInProgress();
+    if(!cache.hasDetailedTriangle || isStrokeInProgress) {
+        cache.detailedTriangle = canPickTriangles() ? pickTriangle(windowCoords) : geometry->intersectDetailedMesh(ray);
+        cache.hasDetailedTriangle = true;
+    }
+    return cache.detailedTriangle;
+}
+
+void ModelView::updatePickingBuffer() {
+    assert(mPickingBatch);
+    if(!mPickingFbo || mPickingFbo->getSize() != mViewport.second) {
+        const auto idBuffer = ci::gl::Renderbuffer::create(mViewport.second.x, mViewport.second.y, GL_R32UI);
+        const auto format = ci::gl::Fbo::Format().disableColor().attachment(GL_COLOR_ATTACHMENT0, idBuffer);
+        mPickingFbo = ci::gl::Fbo::create(mViewport.second.x, mViewport.second.y, format);
+    }
+
+    const ci::gl::ScopedFramebuffer scopedFramebuffer(mPickingFbo);
+    const ci::gl::ScopedViewport scopedViewport(glm::ivec2(0), mPickingFbo->getSize());
+    const ci::gl::ScopedMatrices scopedMatrices;
+    ci::gl::setMatrices(mCamera);
+    ci::gl::multModelMatrix(mModelMatrix);
+    const ci::gl::ScopedDepth scopedDepth(true);
+
+    // Integer buffers cannot be cleared by glClearColor
+    const GLuint noFace[4] = {0, 0, 0, 0};
+    glClearBufferuiv(GL_COLOR, 0, noFace);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    const size_t indexCount = 3 * mApplication.getCurrentGeometry()->getOpenGlData().faceCount;
+    mPickingBatch->draw(0, static_cast<GLsizei>(indexCount));
+
+    mPickingMatrix = getModelViewProjection();
+    mIsPickingBufferDirty = false;
+}
+
 void ModelView::drawGeometry() {
-    if(mApplication.getCurrentGeometry() == nullptr) {
+    Geometry* const geometry = getDisplayedGeometry();
+    if(geometry == nullptr) {
         return;
     }
 
-    const Geometry::OpenGlData& glData = mApplication.getCurrentGeometry()->getOpenGlData();
-    if(glData.isDirty || !mBatch || isMeshOverriden()) {
-        if(glData.isDirty && !isMeshOverriden()) {
-            // attention! do not update geometry buffers if isMeshOverriden() is true,
+    // The GPU buffers hold another geometry after a new one was loaded or previewed
+    const bool isOtherGeometry = mBufferedGeometry != geometry;
+    const Geometry::OpenGlData& glData = geometry->getOpenGlData();
+    if(glData.isDirty || glData.info.didColorUpdate || glData.info.didLayoutChange) {
+        mSimplifiedBatch.areColorsDirty = true;
+    }
+    const bool isOverrideDirty = hasOverrideMesh() && mMeshOverride.isDirty;
+
+    // The current geometry writes its buffers straight into the mapped GPU buffers. A geometry being loaded is
+    // still built by other threads, so it is uploaded from its own buffers.
+    const bool isMappingUsed = mIsBufferMappingEnabled && mPreviewGeometry == nullptr;
+    // Override meshes leave no capacity for the geometry
+    const bool areMappedBuffersLost = !mBatch || isOtherGeometry || mVboCapacity == 0;
+    if(!hasOverrideMesh() && (glData.isMapped != isMappingUsed || (glData.isMapped && areMappedBuffersLost))) {
+        // The buffers were written to the other storage, or the GPU buffers hold another geometry or mesh now
+        geometry->invalidateOpenGlBuffers();
+    }
+
+    if(glData.isDirty || !mBatch || isOverrideDirty || isOtherGeometry) {
+        if(glData.isDirty && !hasOverrideMesh()) {
+            // attention! do not update geometry buffers if hasOverrideMesh() is true,
             // because ExportAssistant could be modifying the geometry in a background thread
             // and the operations are not thread-safe!
-            mApplication.getCurrentGeometry()->updateOpenGlBuffers();
+            geometry->updateOpenGlBuffers(isMappingUsed ? &mMappedBuffers : nullptr);
             CI_LOG_I("Geometry buffers updated");
         }
-        updateVboAndBatch();
+        const Profiler::ScopedTimer uploadTimer(Profiler::Zone::BufferUpload);
+
+        // Keep the GPU buffers alive as long as the geometry fits into them, upload only what changed.
+        // The override mesh is only created again once its buffers are written.
+        if(hasOverrideMesh()) {
+            if(!mBatch || isOverrideDirty || isOtherGeometry) {
+                updateVboAndBatch();
+            }
+        } else if(glData.isMapped) {
+            // The vertices, indices and face triangles are in the GPU buffers already, only the colors are uploaded
+            if(glData.info.didLayoutChange) {
+                mMappedBuffers.unmap({{0, glData.vertexCount}}, {{0, glData.faceCount}});
+                uploadGeometryFaces({0, glData.faceCount});
+            } else {
+                mMappedBuffers.unmap(glData.info.dirtyVertexRanges.ranges, glData.info.dirtyFaceRanges.ranges);
+                for(const auto& range : glData.info.dirtyFaceRanges.ranges) {
+                    uploadGeometryFaces(range);
+                }
+            }
+            updateHighlightTextureCapacity();
+            if(mMappedBuffers.takeAllocated() || !mBatch || isOtherGeometry) {
+                createBatches();
+            }
+        } else if(!mBatch || isOtherGeometry || glData.vertexCount > mVboCapacity ||
+                  glData.faceCount > mFaceCapacity || glData.highlightMask.size() > mHighlightCapacity) {
+            updateVboAndBatch();
+        } else if(glData.info.didLayoutChange) {
+            uploadGeometryVertices({0, glData.vertexCount});
+            uploadGeometryFaces({0, glData.faceCount});
+        } else {
+            for(const auto& range : glData.info.dirtyVertexRanges.ranges) {
+                uploadGeometryVertices(range);
+            }
+            for(const auto& range : glData.info.dirtyFaceRanges.ranges) {
+                uploadGeometryFaces(range);
+            }
+        }
+        glData.info.unsetBufferFlags();
+        mIsPickingBufferDirty = true;
     }
 
-    // Pass new highlight data if required
-    if(glData.info.didHighlightUpdate) {
-        mVboMesh->bufferAttrib<GLint>(Attributes::HIGHLIGHT_MASK, glData.highlightMask);
+    if(hasOverrideMesh()) {
+        // Geometry buffers are uploaded once the override mesh is not displayed
+        glData.info.unsetHighlightFlag();
+        glData.info.unsetColorFlag();
+    }
+
+    // In-place updates of the colors and the highlight are uploads as well
+    std::optional<Profiler::ScopedTimer> inPlaceUploadTimer;
+    if((glData.info.didHighlightUpdate && mTriangleHighlightTexture) || glData.info.didColorUpdate) {
+        inPlaceUploadTimer.emplace(Profiler::Zone::BufferUpload);
+    }
+
+    // Pass new highlight data if required, a full rebuild of the buffers regenerates the highlight too
+    if(glData.info.didHighlightUpdate && mTriangleHighlightTexture) {
+        glData.info.highlightRanges.merge();
+        for(const auto& range : glData.info.highlightRanges.ranges) {
+            bufferRange(mTriangleHighlightTexture->getBufferObj(), glData.highlightMask, range);
+        }
         glData.info.unsetHighlightFlag();
     }
 
     // Pass new color data if required
     if(glData.info.didColorUpdate) {
-        mVboMesh->bufferAttrib<Geometry::ColorIndex>(Attributes::COLOR_IDX, glData.colorBuffer);
+        glData.info.colorRanges.merge();
+        for(const auto& range : glData.info.colorRanges.ranges) {
+            bufferRange(mFaceColorTexture->getBufferObj(), glData.colorBuffer, range);
+        }
         glData.info.unsetColorFlag();
     }
+    inPlaceUploadTimer.reset();
 
-    // Pass overriden colors if required
-    if(isMeshOverriden()) {
-        assert(mMeshOverride.overrideColorBuffer.size() == mMeshOverride.overrideVertexBuffer.size());
-        mVboMesh->bufferAttrib<glm::vec4>(ci::geom::Attrib::COLOR, mMeshOverride.overrideColorBuffer);
+    // Pass overriden face colors if required, recoloring through the palette alone uploads nothing
+    const bool hasOverrideFaceColors = isMeshOverriden() && !mMeshOverride.overrideFaceColorBuffer.empty();
+    if(hasOverrideFaceColors && (mMeshOverride.areFaceColorsDirty || !mOverrideFaceColorTexture)) {
+        uploadOverrideFaceColors();
     }
-    // Assign color palette
-    auto& colorMap = mApplication.getCurrentGeometry()->getColorManager().getColorMap();
-    mModelShader->uniform("uColorPalette", &colorMap[0], static_cast<int>(colorMap.size()));
+
+    // Assign color palette, override face colors index their own palette
+    auto& colorMap = geometry->getColorManager().getColorMap();
+    const std::vector<glm::vec4>& facePalette = hasOverrideFaceColors ? mMeshOverride.overridePalette : colorMap;
+    assert(!facePalette.empty() && facePalette.size() <= PEPR3D_MAX_PALETTE_COLORS);
+    mModelShader->uniform("uColorPalette", &facePalette[0], static_cast<int>(facePalette.size()));
     mModelShader->uniform("uShowWireframe", mIsWireframeEnabled);
-    mModelShader->uniform("uOverridePalette", mMeshOverride.isOverriden);
+    mModelShader->uniform("uOverrideNormals", hasOverrideMesh());
+    mModelShader->uniform("uFaceColorsPerTriangle", hasOverrideFaceColors && !hasOverrideMesh());
+
+    // The GPU buffers are up to date, remember the rest of the state drawn with them
+    if(!isMeshOverriden() && mPreviewGeometry == nullptr) {
+        mRenderSnapshot.geometry = geometry;
+        mRenderSnapshot.faceCount = glData.colorBuffer.size();
+        mRenderSnapshot.colorMap = colorMap;
+        mRenderSnapshot.boundingBoxMin = geometry->getBoundingBoxMin();
+        mRenderSnapshot.boundingBoxMax = geometry->getBoundingBoxMax();
+    }
+
+    // Large meshes are drawn as their simplified proxy while the camera moves, the buffers above stay up to date
+    const MeshSimplifier::Mesh* const simplifiedMesh = geometry->getSimplifiedMesh();
+    if(simplifiedMesh != nullptr && !isMeshOverriden() && mPreviewGeometry == nullptr && isCameraMoving()) {
+        drawSimplifiedGeometry(*geometry, *simplifiedMesh);
+        return;
+    }
 
     const ci::gl::ScopedModelMatrix scopedModelMatrix;
     ci::gl::multModelMatrix(mModelMatrix);
 
     // Assign highlight uniforms
-    auto& areaHighlight = mApplication.getCurrentGeometry()->getAreaHighlight();
-    size_t activeColorIdx = mApplication.getCurrentGeometry()->getColorManager().getActiveColorIndex();
+    auto& areaHighlight = geometry->getAreaHighlight();
+    size_t activeColorIdx = geometry->getColorManager().getActiveColorIndex();
     auto activeColor = colorMap[activeColorIdx];
     mModelShader->uniform("uAreaHighlightEnabled", areaHighlight.enabled);
+    mModelShader->uniform("uAreaHighlightContinuous", areaHighlight.settings.continuous);
     mModelShader->uniform("uAreaHighlightOrigin", areaHighlight.origin - mModelTranslate);
     mModelShader->uniform("uAreaHighlightSize", static_cast<float>(areaHighlight.size));
     mModelShader->uniform("uAreaHighlightColor", vec3(activeColor.x, activeColor.y, activeColor.z));
 
-    mBatch->draw();
+    // Override meshes draw their own colors, but the highlight of the geometry faces is still fetched
+    const ci::gl::BufferTextureRef faceColorTexture =
+        hasOverrideFaceColors ? mOverrideFaceColorTexture : mFaceColorTexture;
+    if(faceColorTexture && mFaceTriangleTexture && mTriangleHighlightTexture) {
+        faceColorTexture->bindTexture(TextureUnits::FACE_COLOR);
+        mFaceTriangleTexture->bindTexture(TextureUnits::FACE_TRIANGLE);
+        mTriangleHighlightTexture->bindTexture(TextureUnits::TRIANGLE_HIGHLIGHT);
+    }
+
+    // Buffers may be larger than the geometry, draw only the used part, and only the chunks inside the frustum.
+    // A draw call numbers its faces from 0, the shader gets the number of the first face of each call.
+    if(hasOverrideMesh()) {
+        mModelShader->uniform("uFirstFace", 0);
+        mBatch->draw(0, static_cast<GLsizei>(mMeshOverride.mesh->indexBuffer.size()));
+    } else {
+        drawVisibleFaces(glData.colorBuffer.size());
+    }
+
+    if(faceColorTexture && mFaceTriangleTexture && mTriangleHighlightTexture) {
+        faceColorTexture->unbindTexture(TextureUnits::FACE_COLOR);
+        mFaceTriangleTexture->unbindTexture(TextureUnits::FACE_TRIANGLE);
+        mTriangleHighlightTexture->unbindTexture(TextureUnits::TRIANGLE_HIGHLIGHT);
+    }
+}
+
+void ModelView::drawVisibleFaces(const size_t faceCount) {
+    for(const auto& range : getVisibleFaceRanges(faceCount)) {
+        mModelShader->uniform("uFirstFace", static_cast<int>(range.first));
+        mBatch->draw(static_cast<GLint>(3 * range.first), static_cast<GLsizei>(3 * (range.second - range.first)));
+    }
+}
+
+bool ModelView::isCameraMoving() const {
+    return mLastCameraMoveTime && mApplication.getElapsedSeconds() - *mLastCameraMoveTime < CAMERA_MOVE_DURATION;
+}
+
+void ModelView::drawSimplifiedGeometry(const Geometry& geometry, const MeshSimplifier::Mesh& mesh) {
+    const size_t vertexCount = 3 * mesh.indices.size();
+    if(!mSimplifiedBatch.batch || mSimplifiedBatch.geometry != &geometry) {
+        // Each triangle has its own vertices, so that it is flat shaded in a single color like the Geometry faces
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> normals;
+        positions.reserve(vertexCount);
+        normals.reserve(vertexCount);
+        for(const auto& triangle : mesh.indices) {
+            const glm::vec3 cross = glm::cross(mesh.vertices[triangle[1]] - mesh.vertices[triangle[0]],
+                                               mesh.vertices[triangle[2]] - mesh.vertices[triangle[0]]);
+            const float length = glm::length(cross);
+            const glm::vec3 normal = length > 0.f ? cross * (1.f / length) : glm::vec3(0.f);
+            for(const size_t vertex : triangle) {
+                positions.push_back(mesh.vertices[vertex]);
+                normals.push_back(normal);
+            }
+        }
+        std::vector<uint32_t> indices(vertexCount);
+        std::iota(indices.begin(), indices.end(), 0);
+
+        // Create buffer layout, the colors change with the Geometry
+        const std::vector<cinder::gl::VboMesh::Layout> layout = {
+            cinder::gl::VboMesh::Layout().usage(GL_STATIC_DRAW).attrib(ci::geom::Attrib::POSITION, 3),
+            cinder::gl::VboMesh::Layout().usage(GL_STATIC_DRAW).attrib(ci::geom::Attrib::NORMAL, 3),
+            cinder::gl::VboMesh::Layout().usage(GL_DYNAMIC_DRAW).attrib(ci::geom::Attrib::COLOR, 4)};
+
+        const cinder::gl::VboRef ibo = cinder::gl::Vbo::create(GL_ELEMENT_ARRAY_BUFFER, indices, GL_STATIC_DRAW);
+        auto vboMesh = ci::gl::VboMesh::create(static_cast<uint32_t>(vertexCount), GL_TRIANGLES, {layout},
+                                               static_cast<uint32_t>(vertexCount), GL_UNSIGNED_INT, ibo);
+        vboMesh->bufferAttrib<glm::vec3>(ci::geom::Attrib::POSITION, positions);
+        vboMesh->bufferAttrib<glm::vec3>(ci::geom::Attrib::NORMAL, normals);
+        countUpload(indices);
+        countUpload(positions);
+        countUpload(normals);
+
+        mSimplifiedBatch.geometry = &geometry;
+        mSimplifiedBatch.vboMesh = vboMesh;
+        mSimplifiedBatch.batch =
+            ci::gl::Batch::create(vboMesh, ci::gl::getStockShader(ci::gl::ShaderDef().color().lambert()));
+        mSimplifiedBatch.areColorsDirty = true;
+    }
+
+    // Only the colors of the proxy are uploaded again, when the triangles or the palette change
+    const ColorManager::ColorMap& colorMap = geometry.getColorManager().getColorMap();
+    if(mSimplifiedBatch.areColorsDirty || mSimplifiedBatch.colorMap != colorMap) {
+        std::vector<glm::vec4> colors;
+        colors.reserve(vertexCount);
+        for(const size_t sourceTriangle : mesh.sourceTriangles) {
+            colors.insert(colors.end(), 3, colorMap[geometry.getTriangleColor(sourceTriangle)]);
+        }
+        mSimplifiedBatch.vboMesh->bufferAttrib<glm::vec4>(ci::geom::Attrib::COLOR, colors);
+        countUpload(colors);
+        mSimplifiedBatch.colorMap = colorMap;
+        mSimplifiedBatch.areColorsDirty = false;
+    }
+
+    const ci::gl::ScopedModelMatrix scopedModelMatrix;
+    ci::gl::multModelMatrix(mModelMatrix);
+    mSimplifiedBatch.batch->draw();
 }
 
 void ModelView::drawTriangleHighlight(const DetailedTriangleId triangleId) {
@@ -362,7 +1070,7 @@ void ModelView::drawTriangleHighlight(const DetailedTriangleId triangleId) {
     const ci::gl::ScopedModelMatrix scopedModelMatrix;
     ci::gl::multModelMatrix(mModelMatrix);
 
-    const DataTriangle& triangle = geometry->getTriangle(triangleId);
+    const TriangleView triangle = geometry->getTriangle(triangleId);
     const glm::vec4 color = geometry->getColorManager().getColor(geometry->getTriangleColor(triangleId));
     const float brightness = 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b;
     const bool isDarkHighlight = mIsWireframeEnabled ? (brightness <= 0.75f) : (brightness > 0.75f);
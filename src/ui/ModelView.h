@@ -1,36 +1,50 @@
 #pragma once
 
 #include "cinder/Utilities.h"
+#include "cinder/gl/BufferTexture.h"
+#include "cinder/gl/Fbo.h"
 #include "cinder/gl/gl.h"
 #include "glm/glm.hpp"
 
 #include "peprimgui.h"
 
+#include "Profiler.h"
 #include "ui/CameraUi.h"
 
 #include <chrono>
+#include <memory>
+#include <optional>
+#include <vector>
+#include "geometry/MappedBufferStorage.h"
+#include "geometry/MeshSimplifier.h"
+#include "geometry/Triangle.h"
 #include "geometry/TrianglePrimitive.h"
 
 namespace pepr3d {
 
 class MainApplication;
+class Geometry;
+class Tool;
 
 /// The main part of the user interface, shows the geometry to the user
 class ModelView {
    public:
     explicit ModelView(MainApplication& app) : mApplication(app) {}
 
-    // TODO: Hide this behind some api
-    std::vector<glm::vec3> previewTriangles;
-    std::vector<uint32_t> previewIndices;
-    std::vector<glm::vec4> previewColors;
-    std::vector<glm::vec3> previewNormals;
+    /// Set the triangles drawn over the Geometry by a tool, e.g., a preview of a text.
+    /// The buffers are uploaded once, when the preview is drawn for the first time.
+    void setPreview(std::vector<glm::vec3> vertices, std::vector<glm::vec3> normals, std::vector<uint32_t> indices,
+                    std::vector<glm::vec4> colors) {
+        mToolPreview.vertexBuffer = std::move(vertices);
+        mToolPreview.normalBuffer = std::move(normals);
+        mToolPreview.indexBuffer = std::move(indices);
+        mToolPreview.colorBuffer = std::move(colors);
+        mToolPreview.batch = nullptr;
+    }
 
+    /// Stop drawing the triangles of setPreview()
     void resetPreview() {
-        previewTriangles.clear();
-        previewIndices.clear();
-        previewColors.clear();
-        previewNormals.clear();
+        mToolPreview = {};
     }
 
     /// Setups the camera and shaders. Call only once!
@@ -45,6 +59,19 @@ class ModelView {
     /// Draws the Geometry.
     void drawGeometry();
 
+    /// Draws a Geometry that is still being loaded in place of the cached rendering of the ModelView, once its
+    /// buffers exist. Only the camera can be used with it, the tools keep working with the current Geometry.
+    void drawPreview(Geometry& geometry);
+
+    /// Returns true if drawSnapshot() can draw the current Geometry, i.e. its GPU buffers are uploaded and the mesh is
+    /// not overriden
+    bool hasRenderSnapshot() const;
+
+    /// Draws the current Geometry as it was last uploaded to the GPU in place of the cached rendering of the
+    /// ModelView, while a slow operation modifies it on a worker thread. The Geometry is not read, only the camera
+    /// can be used meanwhile.
+    void drawSnapshot();
+
     /// On mouse-down event over the ModelView area.
     void onMouseDown(ci::app::MouseEvent event);
 
@@ -60,9 +87,57 @@ class ModelView {
     /// On mouse-move event over the ModelView area.
     void onMouseMove(ci::app::MouseEvent event);
 
+    /// Forwards the mouse move and drag events received since the last call to the current Tool. Called once per
+    /// frame before the Tool is updated, and before any other mouse event to keep their order.
+    /// A high polling rate mouse sends several events per frame, only the latest move and drag are forwarded, so
+    /// that the Tool picks and highlights once per frame.
+    void dispatchMouseEvents();
+
+    /// Returns the positions of the drag events skipped before the one being forwarded to the Tool, oldest first,
+    /// e.g., to paint a continuous stroke through them. Empty outside of Tool::onModelViewMouseDrag().
+    const std::vector<glm::ivec2>& getCoalescedDragPositions() const {
+        return mCoalescedDragPositions;
+    }
+
     /// Returns a 3D ray in the Geometry scene computed from window coordinates.
     ci::Ray getRayFromWindowCoordinates(glm::ivec2 windowCoords) const;
 
+    /// Returns the length of a unit of the Geometry in pixels at a point of the Geometry, e.g., to size the brush
+    float getPixelsPerUnit(const glm::vec3& point) const;
+
+    /// Returns true if pickTriangle() can be used instead of a ray cast, i.e. picking is enabled and the geometry
+    /// buffers on the GPU match the current Geometry.
+    bool canPickTriangles() const;
+
+    /// Returns the triangle rendered at window coordinates, read back from the picking buffer.
+    /// The picking buffer is rendered again only if the geometry or the camera changed since the last pick.
+    /// Call only when canPickTriangles() is true.
+    std::optional<DetailedTriangleId> pickTriangle(glm::ivec2 windowCoords);
+
+    /// Returns the base triangle of the current Geometry under the window coordinates, the hit point is written to
+    /// outPosition if there is a hit and it is not null.
+    /// The hit is computed once per frame for the same ray and version of the Geometry, so that the mouse events of
+    /// the tools and their drawToModelView() share one ray cast. Call only while there is a current Geometry.
+    std::optional<size_t> pickBaseTriangle(glm::ivec2 windowCoords, glm::vec3* outPosition = nullptr);
+
+    /// Returns the DetailedTriangleId under the window coordinates, read back from the picking buffer when
+    /// canPickTriangles() is true, otherwise from a ray cast. Cached like pickBaseTriangle(), except during strokes,
+    /// which change the detail triangles before the version of the Geometry.
+    std::optional<DetailedTriangleId> pickDetailedTriangle(glm::ivec2 windowCoords);
+
+    /// Returns the size of the GPU buffers allocated for the Geometry and its simplified proxy in bytes.
+    size_t getGpuMemorySize() const;
+
+    /// Returns true if triangles are picked from a rendered buffer of triangle IDs.
+    bool isPickingEnabled() const {
+        return mIsPickingEnabled;
+    }
+
+    /// Sets whether triangles are picked from a rendered buffer of triangle IDs.
+    void enablePicking(bool enable = true) {
+        mIsPickingEnabled = enable;
+    }
+
     /// Draws a highlight (3 lines with a contrasting color) of a specified DetailedTriangleId.
     void drawTriangleHighlight(const DetailedTriangleId triangleId);
 
@@ -89,6 +164,18 @@ class ModelView {
         mIsWireframeEnabled = enable;
     }
 
+    /// Returns true if the current Geometry writes its vertices, indices and face triangles straight into the mapped
+    /// GPU buffers, instead of keeping them on the CPU and uploading them.
+    bool isBufferMappingEnabled() const {
+        return mIsBufferMappingEnabled;
+    }
+
+    /// Sets whether the current Geometry writes its buffers straight into the mapped GPU buffers, switching
+    /// generates all of its buffers again.
+    void enableBufferMapping(bool enable = true) {
+        mIsBufferMappingEnabled = enable;
+    }
+
     /// Returns true if the grid below the Geometry is rendered.
     bool isGridEnabled() const {
         return mIsGridEnabled;
@@ -135,44 +222,63 @@ class ModelView {
         return mCameraUi.isFovZoomEnabled();
     }
 
-    /// Enables or disables vertex, normal, and index buffer override (all at once)
+    /// Vertices, normals and indices of a mesh displayed instead of the geometry, see setOverrideMesh().
+    /// Its faces are colored by getOverrideFaceColorBuffer().
+    struct OverrideMesh {
+        std::vector<glm::vec3> vertexBuffer;
+        std::vector<glm::vec3> normalBuffer;
+        std::vector<uint32_t> indexBuffer;
+    };
+
+    /// Enables or disables the override of the displayed mesh and its colors
     void toggleMeshOverride(bool newState) {
         mMeshOverride.isOverriden = newState;
-        forceBatchRefresh();
+        mMeshOverride.isDirty = true;
+        // The geometry buffers stay alive while only their colors are overriden
+        if(mMeshOverride.mesh) {
+            forceBatchRefresh();
+        }
     }
 
     /// Batch data is going to be created again before rendering new frame. This will apply the overriden mesh.
     void forceBatchRefresh() {
         mBatch = nullptr;  // reset batch to force update
+        mPickingBatch = nullptr;
     }
 
-    /// Returns a reference to the override color buffer, so you can read it or write to it.
-    std::vector<glm::vec4>& getOverrideColorBuffer() {
-        return mMeshOverride.overrideColorBuffer;
-    }
-
-    /// Returns true if the mesh data is overriden. (A mesh different from the geometry is being displayed)
-    bool isMeshOverriden() const {
-        return mMeshOverride.isOverriden;
+    /// Display the mesh instead of the geometry while the mesh is overriden. The mesh is shared, not copied, and it
+    /// must not change while it is set. Null displays the GPU buffers of the geometry with the override colors.
+    void setOverrideMesh(std::shared_ptr<const OverrideMesh> mesh) {
+        if(mesh != mMeshOverride.mesh && (mesh || mMeshOverride.mesh)) {
+            forceBatchRefresh();
+        }
+        mMeshOverride.mesh = std::move(mesh);
+        mMeshOverride.isDirty = true;
     }
 
-    /// Returns a reference to the override vertex buffer, so you can read it or write to it.
-    std::vector<glm::vec3>& getOverrideVertexBuffer() {
-        return mMeshOverride.overrideVertexBuffer;
+    /// Returns a reference to the palette index of each face, so you can read it or write to it. Faces of the mesh
+    /// set by setOverrideMesh() are indexed by their order, the geometry is colored by its base triangles.
+    /// While it is not empty, the faces are colored by getOverridePalette(), so recoloring uploads a byte per face,
+    /// or only the palette if the indices stay.
+    std::vector<ColorIndex>& getOverrideFaceColorBuffer() {
+        mMeshOverride.areFaceColorsDirty = true;
+        return mMeshOverride.overrideFaceColorBuffer;
     }
 
-    /// Returns a reference to the override normal buffer, so you can read it or write to it.
-    std::vector<glm::vec3>& getOverrideNormalBuffer() {
-        return mMeshOverride.overrideNormalBuffer;
+    /// Returns a reference to the colors of the override face color buffer, at most PEPR3D_MAX_PALETTE_COLORS.
+    /// They are passed to the shader with each frame.
+    std::vector<glm::vec4>& getOverridePalette() {
+        return mMeshOverride.overridePalette;
     }
 
-    /// Returns a reference to the override index buffer, so you can read it or write to it.
-    std::vector<uint32_t>& getOverrideIndexBuffer() {
-        return mMeshOverride.overrideIndexBuffer;
+    /// Returns true if the mesh data is overriden. (A mesh different from the geometry is being displayed)
+    bool isMeshOverriden() const {
+        return mMeshOverride.isOverriden;
     }
 
-    /// Initialize override buffer to data from non-detailed geometry.
-    void initOverrideFromBasicGeoemtry();
+    /// Initialize the override to the geometry itself, its base triangles colored by the override face color buffer.
+    /// Nothing is copied, the geometry is drawn from its own GPU buffers.
+    void initOverrideFromGeometry();
 
     /// Returns the minimum (first) and maximum (second) height that is rendered in the ModelView.
     glm::vec2 getPreviewMinMaxHeight() const {
@@ -206,6 +312,141 @@ class ModelView {
     ci::gl::VboMeshRef mVboMesh;
     ci::gl::BatchRef mBatch;
 
+    /// Geometry drawn by drawPreview(), nullptr outside of it
+    Geometry* mPreviewGeometry = nullptr;
+
+    /// Geometry whose buffers are uploaded in mVboMesh, the GPU buffers are rebuilt when another one is drawn
+    const Geometry* mBufferedGeometry = nullptr;
+
+    /// The rest of the state of the Geometry drawn from the GPU buffers, captured whenever the current Geometry is
+    /// drawn. The GPU buffers are not uploaded during slow operations, so together they stay consistent and can be
+    /// drawn without the Geometry, see drawSnapshot().
+    struct RenderSnapshot {
+        const Geometry* geometry = nullptr;
+        size_t faceCount = 0;
+        std::vector<glm::vec4> colorMap;
+        glm::vec3 boundingBoxMin = glm::vec3(0.0f);
+        glm::vec3 boundingBoxMax = glm::vec3(0.0f);
+    } mRenderSnapshot;
+
+    /// The vertex, index and face triangle buffers of mVboMesh mapped for the Geometry to write to, see
+    /// Geometry::updateOpenGlBuffers(). The ranges the Geometry rewrote are flushed when they are unmapped.
+    class MappedGeometryBuffers : public MappedBufferStorage {
+       public:
+        explicit MappedGeometryBuffers(ModelView& modelView) : mModelView(modelView) {}
+
+        bool map(size_t vertexCount, size_t faceCount) override;
+
+        glm::vec3* getVertices() override {
+            return mVertices;
+        }
+
+        uint32_t* getIndices() override {
+            return mIndices;
+        }
+
+        GLuint* getFaceTriangles() override {
+            return mFaceTriangles;
+        }
+
+        /// Flushes the vertex and face ranges written since map() and unmaps the buffers, if they are mapped
+        void unmap(const std::vector<std::pair<size_t, size_t>>& vertexRanges,
+                   const std::vector<std::pair<size_t, size_t>>& faceRanges);
+
+        /// Returns true once after map() allocated the buffers again, the batches have to be created for them
+        bool takeAllocated() {
+            const bool wereAllocated = mWereAllocated;
+            mWereAllocated = false;
+            return wereAllocated;
+        }
+
+       private:
+        ModelView& mModelView;
+        glm::vec3* mVertices = nullptr;
+        uint32_t* mIndices = nullptr;
+        GLuint* mFaceTriangles = nullptr;
+        bool mWereAllocated = false;
+
+        void unmapBuffers();
+    } mMappedBuffers{*this};
+
+    /// The current Geometry writes its buffers straight into mMappedBuffers
+    bool mIsBufferMappingEnabled = true;
+
+    /// Number of vertices allocated in the GPU buffers of mVboMesh for the Geometry
+    size_t mVboCapacity = 0;
+
+    /// Number of faces allocated in the index buffer and in the per-face buffer textures
+    size_t mFaceCapacity = 0;
+
+    /// Color index of each face of the Geometry, read by the geometry shader
+    ci::gl::BufferTextureRef mFaceColorTexture;
+
+    /// Base triangle of each face of the Geometry, read by the geometry shader
+    ci::gl::BufferTextureRef mFaceTriangleTexture;
+
+    /// Highlight bitset of the base triangles of the Geometry, read by the geometry shader
+    ci::gl::BufferTextureRef mTriangleHighlightTexture;
+
+    /// Override face color buffer, read by the geometry shader instead of mFaceColorTexture
+    ci::gl::BufferTextureRef mOverrideFaceColorTexture;
+
+    /// Number of elements allocated in mOverrideFaceColorTexture
+    size_t mOverrideFaceCapacity = 0;
+
+    /// Number of elements allocated in mTriangleHighlightTexture
+    size_t mHighlightCapacity = 0;
+
+    /// Bounding box of each chunk of FACE_CHUNK_SIZE faces of the uploaded Geometry, in model coordinates.
+    /// The faces of the Geometry are spatially ordered, chunks outside of the camera frustum are not drawn.
+    std::vector<std::pair<glm::vec3, glm::vec3>> mFaceChunkBounds;
+    static const size_t FACE_CHUNK_SIZE = 4096;
+
+    /// Offscreen buffer with the face number + 1 rendered to each pixel, 0 where there is no face
+    ci::gl::FboRef mPickingFbo;
+
+    /// Renders mVboMesh into mPickingFbo
+    ci::gl::BatchRef mPickingBatch;
+    ci::gl::GlslProgRef mPickingShader;
+    bool mIsPickingEnabled = true;
+
+    /// Geometry buffers were uploaded since mPickingFbo was rendered
+    bool mIsPickingBufferDirty = true;
+
+    /// Model view projection matrix mPickingFbo was rendered with
+    glm::mat4 mPickingMatrix;
+
+    /// Latest mouse move and drag events not forwarded to the Tool yet, see dispatchMouseEvents()
+    std::optional<ci::app::MouseEvent> mPendingMoveEvent;
+    std::optional<ci::app::MouseEvent> mPendingDragEvent;
+
+    /// Positions of the drag events replaced by mPendingDragEvent, a repeated position is stored once
+    std::vector<glm::ivec2> mPendingDragPositions;
+
+    /// Positions skipped before the drag event being forwarded, see getCoalescedDragPositions()
+    std::vector<glm::ivec2> mCoalescedDragPositions;
+
+    /// Hits of the last ray picked by pickBaseTriangle() and pickDetailedTriangle()
+    struct PickCache {
+        /// Frame of the application, Geometry and CommandManager version number of the hits
+        uint32_t frame = 0;
+        const Geometry* geometry = nullptr;
+        size_t geometryVersion = 0;
+
+        glm::vec3 rayOrigin = glm::vec3(0.0f);
+        glm::vec3 rayDirection = glm::vec3(0.0f);
+
+        bool hasBaseTriangle = false;
+        std::optional<size_t> baseTriangle;
+        glm::vec3 basePosition = glm::vec3(0.0f);
+
+        bool hasDetailedTriangle = false;
+        std::optional<DetailedTriangleId> detailedTriangle;
+    } mPickCache;
+
+    /// Returns mPickCache, emptied first unless it holds the hits of the ray in this frame and Geometry version
+    PickCache& getPickCache(const ci::Ray& ray);
+
     std::pair<glm::ivec2, glm::ivec2> mViewport;
     ci::CameraPersp mCamera;
     pepr3d::CameraUi mCameraUi;
@@ -223,24 +464,148 @@ class ModelView {
     /// without chaning the geometry itself
     struct MeshDataOverride {
         bool isOverriden = false;
-        std::vector<glm::vec3> overrideVertexBuffer;
-        std::vector<glm::vec3> overrideNormalBuffer;
-        std::vector<uint32_t> overrideIndexBuffer;
-        std::vector<glm::vec4> overrideColorBuffer;
+
+        /// Displayed instead of the geometry if not null
+        std::shared_ptr<const OverrideMesh> mesh;
+        std::vector<ColorIndex> overrideFaceColorBuffer;
+        std::vector<glm::vec4> overridePalette;
+
+        /// The mesh was set since mVboMesh was created from it
+        bool isDirty = true;
+
+        /// The face colors were handed out for writing since they were uploaded to mOverrideFaceColorTexture
+        bool areFaceColorsDirty = true;
     } mMeshOverride;
 
+    /// Triangles drawn over the Geometry, see setPreview()
+    struct ToolPreview {
+        std::vector<glm::vec3> vertexBuffer;
+        std::vector<glm::vec3> normalBuffer;
+        std::vector<uint32_t> indexBuffer;
+        std::vector<glm::vec4> colorBuffer;
+
+        /// Batch of the buffers, created again only after they change
+        ci::gl::BatchRef batch;
+    } mToolPreview;
+
+    /// Batch of the grid, created once
+    ci::gl::BatchRef mGridBatch;
+
+    /// Simplified proxy of a large Geometry drawn while the camera moves, see Geometry::getSimplifiedMesh()
+    struct SimplifiedBatch {
+        /// Geometry whose proxy is uploaded
+        const Geometry* geometry = nullptr;
+        ci::gl::VboMeshRef vboMesh;
+        ci::gl::BatchRef batch;
+
+        /// Palette of the uploaded colors
+        std::vector<glm::vec4> colorMap;
+
+        /// Triangle colors of the Geometry changed since the colors were uploaded
+        bool areColorsDirty = true;
+    } mSimplifiedBatch;
+
+    /// Elapsed seconds of the application when the camera was last moved by the mouse
+    std::optional<double> mLastCameraMoveTime;
+
+    /// Returns true if the camera moved a moment ago, so that a simplified proxy can be drawn
+    bool isCameraMoving() const;
+
+    /// Draws the simplified proxy of the Geometry, in the current colors of its source triangles
+    void drawSimplifiedGeometry(const Geometry& geometry, const MeshSimplifier::Mesh& mesh);
+
+    /// Draws the triangles of setPreview()
+    void drawToolPreview();
+
+    /// Returns the current Tool if it receives the mouse input, nullptr otherwise
+    Tool* getInputTool();
+
+    /// Returns the Geometry being drawn, the previewed one or the current one
+    Geometry* getDisplayedGeometry() const;
+
+    /// Draws the grid below the Geometry
+    void drawGrid();
+
     /// Recalculates the model matrix of the current Geometry object.
     /// The model matrix ensures that the object's maximum displayed size is 1.0 and it is centered above the grid,
     /// touching it on the bottom.
     void updateModelMatrix();
 
+    /// Recalculates the model matrix of an object with the bounding box, see updateModelMatrix()
+    void updateModelMatrix(const glm::vec3& aabbMin, const glm::vec3& aabbMax);
+
+    /// Draws the faces of the uploaded Geometry inside the camera frustum
+    void drawVisibleFaces(size_t faceCount);
+
+    /// Renders the face numbers of the Geometry into mPickingFbo
+    void updatePickingBuffer();
+
+    /// Returns the model view projection matrix of the Geometry
+    glm::mat4 getModelViewProjection() const {
+        return mCamera.getProjectionMatrix() * mCamera.getViewMatrix() * mModelMatrix;
+    }
+
     /// Recalculates the OpenGL vertex buffer object and the Cinder batch.
     void updateVboAndBatch();
 
-    /// Custom OpenGL attributes
-    struct Attributes {
-        static const cinder::geom::Attrib COLOR_IDX = cinder::geom::Attrib::CUSTOM_0;
-        static const cinder::geom::Attrib HIGHLIGHT_MASK = cinder::geom::Attrib::CUSTOM_1;
+    /// Allocates the GPU buffers of the Geometry with some space to grow, without uploading anything
+    void allocateGeometryBuffers(size_t vertexCount, size_t faceCount);
+
+    /// Allocates mTriangleHighlightTexture again and uploads the whole highlight mask, if the mask does not fit
+    void updateHighlightTextureCapacity();
+
+    /// Creates the batches drawing mVboMesh, which holds the displayed geometry now
+    void createBatches();
+
+    /// Uploads faces [range.first, range.second) of the Geometry index, color and face triangle buffers to the GPU.
+    /// Only the colors are uploaded if the other buffers were written to mMappedBuffers.
+    void uploadGeometryFaces(const std::pair<size_t, size_t>& range);
+
+    /// Recomputes mFaceChunkBounds of the chunks overlapping faces [range.first, range.second) of the Geometry.
+    void updateFaceChunkBounds(const std::pair<size_t, size_t>& range);
+
+    /// Returns the ranges of the first faceCount faces in the chunks that may be visible by the camera, neighbouring
+    /// chunks joined into a single range.
+    std::vector<std::pair<size_t, size_t>> getVisibleFaceRanges(size_t faceCount) const;
+
+    /// Uploads vertices [range.first, range.second) of the Geometry vertex buffer to the already allocated VBO.
+    void uploadGeometryVertices(const std::pair<size_t, size_t>& range);
+
+    /// Uploads the override face color buffer to mOverrideFaceColorTexture, allocated again if it does not fit
+    void uploadOverrideFaceColors();
+
+    /// Returns true if the mesh set by setOverrideMesh() is displayed instead of the GPU buffers of the geometry
+    bool hasOverrideMesh() const {
+        return mMeshOverride.isOverriden && mMeshOverride.mesh != nullptr;
+    }
+
+    /// Returns the VBO of the attribute in the current VboMesh.
+    ci::gl::VboRef getAttribVbo(ci::geom::Attrib attrib) const;
+
+    /// Uploads elements [range.first, range.second) of the data to the same place in the buffer.
+    template <typename T>
+    static void bufferRange(const ci::gl::BufferObjRef& buffer, const std::vector<T>& data,
+                            const std::pair<size_t, size_t>& range) {
+        assert(range.first <= range.second && range.second <= data.size());
+        if(range.first == range.second) {
+            return;
+        }
+        buffer->bufferSubData(range.first * sizeof(T), (range.second - range.first) * sizeof(T),
+                              data.data() + range.first);
+        Profiler::count(Profiler::Counter::UploadedBytes, (range.second - range.first) * sizeof(T));
+    }
+
+    /// Counts the data uploaded by creating or filling a whole buffer
+    template <typename T>
+    static void countUpload(const std::vector<T>& data) {
+        Profiler::count(Profiler::Counter::UploadedBytes, data.size() * sizeof(T));
+    }
+
+    /// Texture units of the per-face buffer textures
+    struct TextureUnits {
+        static const uint8_t FACE_COLOR = 0;
+        static const uint8_t FACE_TRIANGLE = 1;
+        static const uint8_t TRIANGLE_HIGHLIGHT = 2;
     };
 };
 
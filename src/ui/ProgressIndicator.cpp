@@ -2,13 +2,10 @@
 
 namespace pepr3d {
 
-void ProgressIndicator::draw() {
+void ProgressIndicator::draw(const bool isBlocking) {
     if(mGeometry == nullptr) {
         return;
     }
-    if(!ImGui::IsPopupOpen("##progressindicator")) {
-        ImGui::OpenPopup("##progressindicator");
-    }
     ImGuiWindowFlags window_flags = 0;
     window_flags |= ImGuiWindowFlags_NoTitleBar;
     window_flags |= ImGuiWindowFlags_NoMove;
@@ -16,8 +13,17 @@ void ProgressIndicator::draw() {
     window_flags |= ImGuiWindowFlags_NoCollapse;
     window_flags |= ImGuiWindowFlags_NoNav;
     const ImGuiIO& io = ImGui::GetIO();
-    ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x / 2.0f, io.DisplaySize.y / 2.0f), ImGuiCond_Always,
-                            ImVec2(0.5f, 0.5f));
+    if(isBlocking) {
+        if(!ImGui::IsPopupOpen("##progressindicator")) {
+            ImGui::OpenPopup("##progressindicator");
+        }
+        ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x / 2.0f, io.DisplaySize.y / 2.0f), ImGuiCond_Always,
+                                ImVec2(0.5f, 0.5f));
+    } else {
+        // Leave the mouse outside of the indicator to the camera, its Cancel buttons can still be used
+        window_flags |= ImGuiWindowFlags_NoSavedSettings;
+        ImGui::SetNextWindowPos(ImVec2(12.0f, io.DisplaySize.y - 12.0f), ImGuiCond_Always, ImVec2(0.0f, 1.0f));
+    }
     ImGui::SetNextWindowSize(ImVec2(400.0f, -1.0f));
     ImGui::SetNextWindowBgAlpha(1.0f);
     ImGui::PushStyleColor(ImGuiCol_WindowBg, ci::ColorA::hex(0xFFFFFF));
@@ -27,32 +33,55 @@ void ProgressIndicator::draw() {
     ImGui::PushStyleVar(ImGuiStyleVar_WindowRounding, 0.0f);
     ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, glm::vec2(12.0f));
     ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, glm::vec2(8.0f, 6.0f));
-    if(ImGui::BeginPopupModal("##progressindicator", nullptr, window_flags)) {
-        drawSpinner("##progressindicator#spinner");
-        ImGui::SameLine();
-        ImGui::Text("Please wait, Pepr3D is processing the geometry...");
+    if(isBlocking) {
+        if(ImGui::BeginPopupModal("##progressindicator", nullptr, window_flags)) {
+            drawContent();
+            ImGui::EndPopup();
+        }
+    } else {
+        if(ImGui::Begin("##progressindicator-preview", nullptr, window_flags)) {
+            drawContent();
+        }
+        ImGui::End();
+    }
+    ImGui::PopStyleVar(3);
+    ImGui::PopStyleColor(4);
+}
+
+void ProgressIndicator::drawContent() {
+    drawSpinner("##progressindicator#spinner");
+    ImGui::SameLine();
+    ImGui::Text("Please wait, Pepr3D is processing the geometry...");
 
-        ImGui::Separator();
+    ImGui::Separator();
 
-        const auto& progress = mGeometry->getProgress();
+    auto& progress = mGeometry->getProgress();
 
-        drawStatus("Importing render geometry...", progress.importRenderPercentage, false);
-        drawStatus("Importing compute geometry...", progress.importComputePercentage, false);
-        drawStatus("Generating buffers...", progress.buffersPercentage, false);
-        drawStatus("Building AABB tree...", progress.aabbTreePercentage, true);
-        drawStatus("Building polyhedron...", progress.polyhedronPercentage, true);
+    drawStatus("Importing geometry...", progress.importRenderPercentage, false);
+    drawStatus("Welding vertices...", progress.importComputePercentage, false);
+    drawStatus("Generating buffers...", progress.buffersPercentage, false);
+    drawStatus("Building AABB tree...", progress.aabbTreePercentage, true);
+    drawStatus("Building polyhedron...", progress.polyhedronPercentage, true);
 
-        drawStatus("Creating scene...", progress.createScenePercentage, true);
-        drawStatus("Exporting geometry...", progress.exportFilePercentage, false);
+    drawStatus("Creating scene...", progress.createScenePercentage, true);
+    drawStatus("Exporting geometry...", progress.exportFilePercentage, false);
 
-        drawStatus("Computing SDF...", progress.sdfPercentage, true);
+    drawStatus("Computing SDF...", progress.sdfPercentage, false);
+    if(progress.sdfPercentage >= 0.0f && progress.sdfPercentage < 1.0f && !progress.isSdfCancelled) {
+        if(ImGui::Button("Cancel")) {
+            progress.isSdfCancelled = true;
+        }
+    }
 
-        drawStatus("Painting text...", progress.paintTextPercentage, false);
+    drawStatus("Painting text...", progress.paintTextPercentage, false);
+    drawStatus("Saving project...", progress.saveProjectPercentage, true);
+    drawStatus("Exporting files in the background...", progress.backgroundExportPercentage, true);
 
-        ImGui::EndPopup();
+    if(mIsCancelled != nullptr && !*mIsCancelled) {
+        if(ImGui::Button("Cancel##operation")) {
+            *mIsCancelled = true;
+        }
     }
-    ImGui::PopStyleVar(3);
-    ImGui::PopStyleColor(4);
 }
 
 void ProgressIndicator::drawSpinner(const char* label) {
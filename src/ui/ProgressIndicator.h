@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 
 #include "IconsMaterialDesign.h"
@@ -26,11 +27,20 @@ class ProgressIndicator {
         return mGeometry != nullptr;
     }
 
+    /// Sets the token of the running operation, which a Cancel button sets, or null if it cannot be cancelled.
+    void setCancellation(std::shared_ptr<std::atomic<bool>> isCancelled) {
+        mIsCancelled = std::move(isCancelled);
+    }
+
     /// Renders the progress indicator.
-    void draw();
+    /// @param isBlocking Whether the indicator is a modal popup, otherwise it is shown in a corner and leaves the
+    /// mouse to the ModelView
+    void draw(bool isBlocking = true);
 
    private:
     std::shared_ptr<Geometry> mGeometry;
+    std::shared_ptr<std::atomic<bool>> mIsCancelled;
+    void drawContent();
     void drawSpinner(const char* label);
     void drawStatus(const std::string& label, float progress, bool isIndeterminate);
 };
@@ -207,7 +207,9 @@ void SidePane::drawColorPaletteColorBoxes(ColorManager& colorManager, CommandMan
             leftCornerX = 0;
         }
 
-        const bool isSelected = i == colorManager.getActiveColorIndex();
+        // Boxes follow the palette positions, the active color is a color index
+        const size_t colorIdx = colorManager.getColorIndexAt(i);
+        const bool isSelected = colorIdx == colorManager.getActiveColorIndex();
         const std::string colorEditPopupId = std::string("##colorPaletteEditPopup") + std::to_string(i);
         const std::string colorPickerId = std::string("##colorPalettePicker") + std::to_string(i);
 
@@ -217,7 +219,7 @@ void SidePane::drawColorPaletteColorBoxes(ColorManager& colorManager, CommandMan
             if(isEditable) {
                 ImGui::OpenPopup(colorEditPopupId.c_str());
             } else {
-                colorManager.setActiveColorIndex(i);
+                colorManager.setActiveColorIndex(colorIdx);
             }
         }
         const bool isHovered = ImGui::IsItemHovered();
@@ -245,7 +247,7 @@ void SidePane::drawColorPaletteColorBoxes(ColorManager& colorManager, CommandMan
                 const glm::vec2 tooltipCursorPos = ImGui::GetCursorScreenPos();
                 const glm::vec2 tooltipSize(boxWidth, boxHeight);
                 tooltipDrawList->AddRectFilled(tooltipCursorPos, tooltipCursorPos + tooltipSize,
-                                               (ImColor)colorManager.getColor(i));
+                                               (ImColor)colorManager.getColor(colorIdx));
                 ImGui::SetCursorScreenPos(tooltipCursorPos + tooltipSize);
                 ImGui::EndDragDropSource();
             }
@@ -275,7 +277,7 @@ void SidePane::drawColorPaletteColorBoxes(ColorManager& colorManager, CommandMan
             cursorPos + glm::ivec2(static_cast<int>(leftCornerX + boxWidth + 2), static_cast<int>(boxHeight + 2)),
             (ImColor)ci::ColorA::hex(0xE5E5E5));
 
-        glm::vec4 color = colorManager.getColor(i);
+        glm::vec4 color = colorManager.getColor(colorIdx);
         const float boxAlpha = (isHovered || isHeld) ? (isHeld ? 0.8f : 0.9f) : 1.0f;
         const glm::vec4 boxColor(color.r, color.g, color.b, boxAlpha);
         drawList->AddRectFilled(